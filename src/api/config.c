@@ -23,6 +23,7 @@
  * outside of the core library.
  */
 
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -43,6 +44,9 @@
 
 #define SECTION_MAGIC 0xDBDC0580
 
+/* number of buckets of the hashed index of the variables in a section */
+#define SECTION_HASH_SIZE 32
+
 typedef struct _config_var {
   char                 *name;
   m64p_type             type;
@@ -53,12 +57,14 @@ typedef struct _config_var {
   } val;
   char                 *comment;
   struct _config_var   *next;
+  struct _config_var   *hash_next;
   } config_var;
 
 typedef struct _config_section {
   unsigned int            magic;
   char                   *name;
   struct _config_var     *first_var;
+  struct _config_var     *hash[SECTION_HASH_SIZE];
   struct _config_section *next;
   } config_section;
 
@@ -72,6 +78,9 @@ static char       *l_ConfigDirOverride = NULL;
 static config_list l_ConfigListActive = NULL;
 static config_list l_ConfigListSaved = NULL;
 
+/* global variables */
+unsigned int g_ConfigGeneration = 1;
+
 /* --------------- */
 /* local functions */
 /* --------------- */
@@ -130,6 +139,24 @@ static config_section *find_section(config_list list, const char *ParamName)
     return *find_section_link(&list, ParamName);
 }
 
+/* invalidates the values cached by the config_param handles */
+static void config_changed(void)
+{
+    if (++g_ConfigGeneration == 0)
+        g_ConfigGeneration = 1;
+}
+
+/* case-insensitive hash of a variable name, see find_section_var() */
+static unsigned int var_name_hash(const char *ParamName)
+{
+    unsigned int hash = 0;
+
+    while (*ParamName != '\0')
+        hash = hash * 31 + (unsigned int) tolower((unsigned char) *ParamName++);
+
+    return hash & (SECTION_HASH_SIZE - 1);
+}
+
 static config_var *config_var_create(const char *ParamName, const char *ParamHelp)
 {
     config_var *var = (config_var *) malloc(sizeof(config_var));
@@ -163,14 +190,15 @@ static config_var *config_var_create(const char *ParamName, const char *ParamHel
         var->comment = NULL;
 
     var->next = NULL;
+    var->hash_next = NULL;
     return var;
 }
 
 static config_var *find_section_var(config_section *section, const char *ParamName)
 {
-    /* walk through the linked list of variables in the section */
+    /* walk through the variables of the section with the same name hash */
     config_var *curr_var;
-    for (curr_var = section->first_var; curr_var != NULL; curr_var = curr_var->next)
+    for (curr_var = section->hash[var_name_hash(ParamName)]; curr_var != NULL; curr_var = curr_var->hash_next)
     {
         if (osal_insensitive_strcmp(ParamName, curr_var->name) == 0)
             return curr_var;
@@ -180,6 +208,14 @@ static config_var *find_section_var(config_section *section, const char *ParamNa
     return NULL;
 }
 
+static void hash_var_in_section(config_section *section, config_var *var)
+{
+    config_var **bucket = &section->hash[var_name_hash(var->name)];
+
+    var->hash_next = *bucket;
+    *bucket = var;
+}
+
 static void append_var_to_section(config_section *section, config_var *var)
 {
     config_var *last_var;
@@ -187,6 +223,8 @@ static void append_var_to_section(config_section *section, config_var *var)
     if (section == NULL || var == NULL || section->magic != SECTION_MAGIC)
         return;
 
+    hash_var_in_section(section, var);
+
     if (section->first_var == NULL)
     {
         section->first_var = var;
@@ -262,6 +300,7 @@ static config_section *config_section_create(const char *ParamName)
         return NULL;
     }
     sec->first_var = NULL;
+    memset(sec->hash, 0, sizeof(sec->hash));
     sec->next = NULL;
     return sec;
 }
@@ -321,6 +360,7 @@ static config_section * section_deepcopy(config_section *orig_section)
         }
 
         /* add the new variable to the new section */
+        hash_var_in_section(new_section, new_var);
         if (last_new_var == NULL)
             new_section->first_var = new_var;
         else
@@ -600,10 +640,34 @@ m64p_error ConfigShutdown(void)
     /* free all of the memory in the 2 lists */
     delete_list(&l_ConfigListActive);
     delete_list(&l_ConfigListSaved);
+    config_changed();
 
     return M64ERR_SUCCESS;
 }
 
+/* reads again the value of a config_param handle after a config change.  The
+ * generation is taken before the read and only stored after the value, so a
+ * change made meanwhile is read again at the next use of the handle. */
+int ConfigParamRefreshInt(config_param *param)
+{
+    unsigned int generation = g_ConfigGeneration;
+    m64p_handle section = (m64p_handle) find_section(l_ConfigListActive, param->section);
+
+    param->value = ConfigGetParamInt(section, param->name);
+    param->generation = generation;
+    return param->value;
+}
+
+int ConfigParamRefreshBool(config_param *param)
+{
+    unsigned int generation = g_ConfigGeneration;
+    m64p_handle section = (m64p_handle) find_section(l_ConfigListActive, param->section);
+
+    param->value = ConfigGetParamBool(section, param->name);
+    param->generation = generation;
+    return param->value;
+}
+
 /* ------------------------------------------------ */
 /* Selector functions, exported outside of the Core */
 /* ------------------------------------------------ */
@@ -819,6 +883,7 @@ EXPORT m64p_error CALL ConfigDeleteSection(const char *SectionName)
 
     /* fix the pointer to point to the next section after the deleted one */
     *curr_section_link = next_section;
+    config_changed();
 
     return M64ERR_SUCCESS;
 }
@@ -910,6 +975,7 @@ EXPORT m64p_error CALL ConfigRevertChanges(const char *SectionName)
 
     /* release memory associated with active_section */
     delete_section(active_section);
+    config_changed();
 
     return M64ERR_SUCCESS;
 }
@@ -970,12 +1036,17 @@ EXPORT m64p_error CALL ConfigSetParameter(m64p_handle ConfigSectionHandle, const
         case M64TYPE_STRING:
             var->val.string = strdup((char *)ParamValue);
             if (var->val.string == NULL)
+            {
+                /* the old value is gone anyway */
+                config_changed();
                 return M64ERR_NO_MEMORY;
+            }
             break;
         default:
             /* this is logically impossible because of the ParamType check at the top of this function */
             break;
     }
+    config_changed();
 
     return M64ERR_SUCCESS;
 }
@@ -1141,6 +1212,7 @@ EXPORT m64p_error CALL ConfigSetDefaultInt(m64p_handle ConfigSectionHandle, cons
     var->type = M64TYPE_INT;
     var->val.integer = ParamValue;
     append_var_to_section(section, var);
+    config_changed();
 
     return M64ERR_SUCCESS;
 }
@@ -1172,6 +1244,7 @@ EXPORT m64p_error CALL ConfigSetDefaultFloat(m64p_handle ConfigSectionHandle, co
     var->type = M64TYPE_FLOAT;
     var->val.number = ParamValue;
     append_var_to_section(section, var);
+    config_changed();
 
     return M64ERR_SUCCESS;
 }
@@ -1203,6 +1276,7 @@ EXPORT m64p_error CALL ConfigSetDefaultBool(m64p_handle ConfigSectionHandle, con
     var->type = M64TYPE_BOOL;
     var->val.integer = ParamValue ? 1 : 0;
     append_var_to_section(section, var);
+    config_changed();
 
     return M64ERR_SUCCESS;
 }
@@ -1239,6 +1313,7 @@ EXPORT m64p_error CALL ConfigSetDefaultString(m64p_handle ConfigSectionHandle, c
         return M64ERR_NO_MEMORY;
     }
     append_var_to_section(section, var);
+    config_changed();
 
     return M64ERR_SUCCESS;
 }
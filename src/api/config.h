@@ -22,9 +22,48 @@
 /* This file contains the Core configuration functions
  */
 
+#if !defined(API_CONFIG_H)
+#define API_CONFIG_H
+
 #include "m64p_types.h"
+#include "osal/preproc.h"
 
 /* these functions are only to be used within the Core library */
 
 m64p_error ConfigInit(const char *ConfigDirOverride, const char *DataDirOverride);
 m64p_error ConfigShutdown(void);
+
+/* A config_param is a handle on a parameter read on a hot path.  It is
+ * resolved by name on its first read and after any change of the config
+ * (which increments g_ConfigGeneration), the other reads return the value
+ * cached in the handle.  Declare it with CONFIG_PARAM("Section", "Name"). */
+typedef struct
+{
+    const char   *section;
+    const char   *name;
+    unsigned int  generation;
+    int           value;
+} config_param;
+
+#define CONFIG_PARAM(section, name) { section, name, 0, 0 }
+
+extern unsigned int g_ConfigGeneration;
+
+int ConfigParamRefreshInt(config_param *param);
+int ConfigParamRefreshBool(config_param *param);
+
+static osal_inline int ConfigParamInt(config_param *param)
+{
+    if (param->generation != g_ConfigGeneration)
+        return ConfigParamRefreshInt(param);
+    return param->value;
+}
+
+static osal_inline int ConfigParamBool(config_param *param)
+{
+    if (param->generation != g_ConfigGeneration)
+        return ConfigParamRefreshBool(param);
+    return param->value;
+}
+
+#endif /* API_CONFIG_H */
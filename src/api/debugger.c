@@ -37,6 +37,7 @@
 #include "debugger/dbg_memory.h"
 #include "debugger/debugger.h"
 #include "memory/memory.h"
+#include "r4300/block_profiler.h"
 #include "r4300/r4300.h"
 #include "r4300/cp0.h"
 #include "r4300/cp1.h"
@@ -391,3 +392,23 @@ EXPORT int CALL DebugBreakpointCommand(m64p_dbg_bkp_command command, unsigned in
 #endif
 }
 
+EXPORT m64p_error CALL DebugProfilerStart(unsigned int SamplePeriod)
+{
+    return block_profiler_start(SamplePeriod);
+}
+
+EXPORT m64p_error CALL DebugProfilerStop(void)
+{
+    block_profiler_stop();
+    return M64ERR_SUCCESS;
+}
+
+EXPORT int CALL DebugProfilerGetTop(m64p_profile_block *Blocks, int Count)
+{
+    return block_profiler_get_top(Blocks, Count);
+}
+
+EXPORT m64p_error CALL DebugProfilerDump(const char *FilePath)
+{
+    return block_profiler_dump(FilePath);
+}
@@ -37,20 +37,33 @@
 #include "config.h"
 #include "vidext.h"
 
+#ifdef DBG
+#include "debugger/dbg_types.h"
+#include "debugger/dbg_breakpoints.h"
+#endif
+
 #include "main/cheat.h"
 #include "main/eventloop.h"
 #include "main/main.h"
 #include "main/rom.h"
+#include "main/savemedia.h"
 #include "main/savestates.h"
 #include "main/version.h"
 #include "main/util.h"
 #include "main/workqueue.h"
+#include "osal/dynamiclib.h"
 #include "osd/screenshot.h"
 #include "plugin/plugin.h"
+#include "r4300/block_profiler.h"
+#include "r4300/tlb.h"
 
 /* some local state variables */
 static int l_CoreInit = 0;
 static int l_ROMOpen = 0;
+static int l_InstanceCount = 0;     /* core instances created by this one and not yet destroyed */
+static int l_CoreInstance = 0;      /* this library is a copy loaded by CoreCreateInstance() */
+
+typedef void (*ptr_CoreInstanceShareData)(const void *);
 
 /* functions exported outside of libmupen64plus to front-end application */
 EXPORT m64p_error CALL CoreStartup(int APIVersion, const char *ConfigPath, const char *DataPath, void *Context,
@@ -79,6 +92,8 @@ EXPORT m64p_error CALL CoreStartup(int APIVersion, const char *ConfigPath, const
     plugin_connect(M64PLUGIN_CORE, NULL);
 
     savestates_init();
+    savemedia_init();
+    tlb_LUT_reset();
 
     /* next, start up the configuration handling code by loading and parsing the config file */
     if (ConfigInit(ConfigPath, DataPath) != M64ERR_SUCCESS)
@@ -104,20 +119,85 @@ EXPORT m64p_error CALL CoreShutdown(void)
 {
     if (!l_CoreInit)
         return M64ERR_NOT_INIT;
+    /* other instances may still be reading our rom database */
+    if (l_InstanceCount > 0)
+    {
+        DebugMessage(M64MSG_ERROR, "CoreShutdown(): %i core instance(s) created by this one must be destroyed first", l_InstanceCount);
+        return M64ERR_INVALID_STATE;
+    }
 
     /* close down some core sub-systems */
     romdatabase_close();
     ConfigShutdown();
     workqueue_shutdown();
+    savemedia_deinit();
     savestates_deinit();
-
-    /* tell SDL to shut down */
-    SDL_Quit();
+    block_profiler_shutdown();
+    tlb_LUT_reset();
+#ifdef DBG
+    free_breakpoints();
+#endif
+
+    /* SDL is shared by all the core instances of the process: a created
+     * instance only releases the subsystems it initialized, the creating
+     * instance, which is shut down last, shuts SDL down */
+    if (l_CoreInstance)
+        event_quit();
+    else
+        SDL_Quit();
 
     l_CoreInit = 0;
     return M64ERR_SUCCESS;
 }
 
+EXPORT m64p_error CALL CoreCreateInstance(m64p_dynlib_handle *InstanceHandle)
+{
+    ptr_CoreInstanceShareData share_data;
+    m64p_error rval;
+
+    if (!l_CoreInit)
+        return M64ERR_NOT_INIT;
+    if (InstanceHandle == NULL)
+        return M64ERR_INPUT_ASSERT;
+
+    rval = osal_dynlib_open_copy(InstanceHandle, (const void *) CoreCreateInstance);
+    if (rval != M64ERR_SUCCESS)
+        return rval;
+
+    /* hand our read-only data to the new instance before it is started up */
+    share_data = (ptr_CoreInstanceShareData) osal_dynlib_getproc(*InstanceHandle, "CoreInstanceShareData");
+    if (share_data != NULL)
+        (*share_data)(romdatabase_get());
+
+    l_InstanceCount++;
+    return M64ERR_SUCCESS;
+}
+
+EXPORT m64p_error CALL CoreDestroyInstance(m64p_dynlib_handle InstanceHandle)
+{
+    m64p_error rval;
+
+    if (InstanceHandle == NULL || l_InstanceCount == 0)
+        return M64ERR_INPUT_ASSERT;
+
+    rval = osal_dynlib_close_copy(InstanceHandle);
+    if (rval != M64ERR_SUCCESS)
+        return rval;
+
+    l_InstanceCount--;
+    return M64ERR_SUCCESS;
+}
+
+/* internal: called by CoreCreateInstance() on the instance it has just loaded */
+EXPORT void CALL CoreInstanceShareData(const void *RomDatabase)
+{
+    if (!l_CoreInit)
+    {
+        l_CoreInstance = 1;
+        romdatabase_share((const _romdatabase *) RomDatabase);
+    }
+}
+
 EXPORT m64p_error CALL CoreAttachPlugin(m64p_plugin_type PluginType, m64p_dynlib_handle PluginLibHandle)
 {
     m64p_error rval;
@@ -173,6 +253,19 @@ EXPORT m64p_error CALL CoreDoCommand(m64p_command Command, int ParamInt, void *P
                 cheat_init();
             }
             return rval;
+        case M64CMD_ROM_OPEN_FILE:
+            if (g_EmulatorRunning || l_ROMOpen)
+                return M64ERR_INVALID_STATE;
+            if (ParamPtr == NULL)
+                return M64ERR_INPUT_ASSERT;
+            rval = open_rom_file((const char *) ParamPtr);
+            if (rval == M64ERR_SUCCESS)
+            {
+                l_ROMOpen = 1;
+                ScreenshotRomOpen();
+                cheat_init();
+            }
+            return rval;
         case M64CMD_ROM_CLOSE:
             if (g_EmulatorRunning || !l_ROMOpen)
                 return M64ERR_INVALID_STATE;
@@ -291,6 +384,10 @@ EXPORT m64p_error CALL CoreDoCommand(m64p_command Command, int ParamInt, void *P
                 return M64ERR_INVALID_STATE;
             main_advance_one();
             return M64ERR_SUCCESS;
+        case M64CMD_REWIND:
+            if (!g_EmulatorRunning)
+                return M64ERR_INVALID_STATE;
+            return main_rewind();
         default:
             return M64ERR_INPUT_INVALID;
     }
@@ -194,6 +194,47 @@ typedef int (*ptr_DebugBreakpointCommand)(m64p_dbg_bkp_command, unsigned int, m6
 EXPORT int CALL DebugBreakpointCommand(m64p_dbg_bkp_command, unsigned int, m64p_breakpoint *);
 #endif
 
+/* DebugProfilerStart()
+ *
+ * This function clears the block profiler counters and starts sampling one
+ * block entry out of every SamplePeriod entries into blocks of R4300 code.
+ */
+typedef m64p_error (*ptr_DebugProfilerStart)(unsigned int);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT m64p_error CALL DebugProfilerStart(unsigned int);
+#endif
+
+/* DebugProfilerStop()
+ *
+ * This function stops the block profiler. The counters can still be read
+ * until the profiler is started again.
+ */
+typedef m64p_error (*ptr_DebugProfilerStop)(void);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT m64p_error CALL DebugProfilerStop(void);
+#endif
+
+/* DebugProfilerGetTop()
+ *
+ * This function copies the counters of the blocks with the most cycles into
+ * the given array, sorted by decreasing cycles, and returns how many blocks
+ * were copied.
+ */
+typedef int (*ptr_DebugProfilerGetTop)(m64p_profile_block *, int);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT int CALL DebugProfilerGetTop(m64p_profile_block *, int);
+#endif
+
+/* DebugProfilerDump()
+ *
+ * This function writes the cycles of every profiled block to a file, in the
+ * folded stack format used by flame graph tools.
+ */
+typedef m64p_error (*ptr_DebugProfilerDump)(const char *);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT m64p_error CALL DebugProfilerDump(const char *);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -61,6 +61,37 @@ typedef m64p_error (*ptr_CoreShutdown)(void);
 EXPORT m64p_error CALL CoreShutdown(void);
 #endif
 
+/* CoreCreateInstance()
+ *
+ * This function loads a new, independent instance of the core library, with
+ * its own copy of all emulator state. The front-end looks up the Core functions
+ * of the new instance in the returned handle, starts it up with CoreStartup(),
+ * and may run it on its own thread alongside this one. Read-only data, such as
+ * the ROM database, is shared with the instance it was created from. All
+ * instances must be shut down and destroyed before the creating instance is
+ * shut down.
+ *
+ * Plugins stay global to the process, not to an instance: a plugin library
+ * is not duplicated, so instances running concurrently should use the dummy
+ * plugins or plugins which support several users. SDL is shared too; the
+ * CoreShutdown() of a created instance only releases the SDL subsystems it
+ * initialized, the creating instance shuts SDL down.
+ */
+typedef m64p_error (*ptr_CoreCreateInstance)(m64p_dynlib_handle *);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT m64p_error CALL CoreCreateInstance(m64p_dynlib_handle *);
+#endif
+
+/* CoreDestroyInstance()
+ *
+ * This function unloads a core instance created by CoreCreateInstance(). The
+ * instance must have been shut down with its own CoreShutdown() function.
+ */
+typedef m64p_error (*ptr_CoreDestroyInstance)(m64p_dynlib_handle);
+#if defined(M64P_CORE_PROTOTYPES)
+EXPORT m64p_error CALL CoreDestroyInstance(m64p_dynlib_handle);
+#endif
+
 /* CoreAttachPlugin()
  *
  * This function attaches the given plugin to the emulator core. There can only
@@ -131,7 +131,11 @@ typedef enum {
   M64CORE_AUDIO_MUTE,
   M64CORE_INPUT_GAMESHARK,
   M64CORE_STATE_LOADCOMPLETE,
-  M64CORE_STATE_SAVECOMPLETE
+  M64CORE_STATE_SAVECOMPLETE,
+  M64CORE_FRAME_TIME,
+  M64CORE_FRAME_JITTER,
+  M64CORE_BATCH_MODE,
+  M64CORE_VI_RATE
 } m64p_core_param;
 
 typedef enum {
@@ -155,7 +159,9 @@ typedef enum {
   M64CMD_CORE_STATE_SET,
   M64CMD_READ_SCREEN,
   M64CMD_RESET,
-  M64CMD_ADVANCE_FRAME
+  M64CMD_ADVANCE_FRAME,
+  M64CMD_ROM_OPEN_FILE,
+  M64CMD_REWIND
 } m64p_command;
 
 typedef struct {
@@ -288,7 +294,7 @@ typedef enum {
 
 #define M64P_MEM_INVALID        0xFFFFFFFF  /* invalid memory read will return this */
 
-#define BREAKPOINTS_MAX_NUMBER  128
+#define BREAKPOINTS_MAX_NUMBER  128  /* no longer a limit, the core makes room for more */
 
 typedef enum {
   M64P_BKP_FLAG_ENABLED = 0x01,
@@ -309,6 +315,12 @@ typedef struct {
   unsigned int flags;
 } m64p_breakpoint;
 
+typedef struct {
+  unsigned int address;        /* R4300 address at which the block is entered */
+  unsigned long long entries;  /* estimated number of entries into the block */
+  unsigned long long cycles;   /* estimated CP0 Count cycles spent in the block */
+} m64p_profile_block;
+
 /* ------------------------------------------------- */
 /* Structures and Types for Core Video Extension API */
 /* ------------------------------------------------- */
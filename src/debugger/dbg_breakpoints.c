@@ -19,6 +19,9 @@
  *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
+#include <stdlib.h>
+#include <string.h>
+
 #include <SDL.h>
 #include <SDL_thread.h>
 
@@ -31,39 +34,275 @@
 #include "api/callbacks.h"
 
 int g_NumBreakpoints=0;
-m64p_breakpoint g_Breakpoints[BREAKPOINTS_MAX_NUMBER];
+m64p_breakpoint *g_Breakpoints=NULL;
+
+static int l_MaxBreakpoints=0;
+
+/* The enabled breakpoints are indexed again each time a breakpoint changes,
+ * as they're checked on every instruction and on every hooked memory access:
+ *  - a bitmap of the 4 KB pages holding an execution breakpoint, so that an
+ *    instruction outside of them is checked with a single bit test, and the
+ *    list of the execution breakpoints to scan for the others;
+ *  - the read and write ranges sorted by their start address, each with the
+ *    highest end address of the ranges up to it, so that the ranges holding
+ *    an access are found by a binary search and a short walk back.
+ * A range wrapping around the address space is split in two.
+ *
+ * The emulation thread reads the index while the front-end changes the
+ * breakpoints, so a new index is built aside and swapped in, and the old
+ * one is only freed once no check is using it.  The breakpoint array is
+ * grown the same way. */
+typedef struct {
+    uint32 address;
+    uint32 endaddr;
+    uint32 maxend;
+    uint32 flags;
+    int bpt;
+} bpt_range;
+
+typedef struct {
+    unsigned char exec_pages[0x100000 / 8];
+    bpt_range *exec;
+    bpt_range *read;
+    bpt_range *write;
+    int num_exec;
+    int num_read;
+    int num_write;
+} bpt_index;
+
+static bpt_index *l_Index=NULL;
+static SDL_atomic_t l_IndexReaders; /* checks running on the index */
+
+static const bpt_index *acquire_index(void)
+{
+    /* full barrier, so that a swap either waits for this check or is seen by it */
+    SDL_AtomicAdd(&l_IndexReaders, 1);
+    return (const bpt_index *) SDL_AtomicGetPtr((void **) &l_Index);
+}
+
+static void release_index(void)
+{
+    SDL_AtomicAdd(&l_IndexReaders, -1);
+}
+
+static void wait_for_readers(void)
+{
+    while (SDL_AtomicAdd(&l_IndexReaders, 0) != 0)
+        SDL_Delay(0);
+}
+
+static int grow_breakpoints(void)
+{
+    int max = (l_MaxBreakpoints == 0) ? BREAKPOINTS_MAX_NUMBER : 2 * l_MaxBreakpoints;
+    m64p_breakpoint *bpts, *old;
+
+    if (g_NumBreakpoints < l_MaxBreakpoints)
+        return 1;
+
+    bpts = (m64p_breakpoint *) malloc(max * sizeof(m64p_breakpoint));
+    if (bpts == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Couldn't allocate more than %i breakpoints.", l_MaxBreakpoints);
+        return 0;
+    }
+    if (g_NumBreakpoints > 0)
+        memcpy(bpts, g_Breakpoints, g_NumBreakpoints * sizeof(m64p_breakpoint));
+
+    old = g_Breakpoints;
+    SDL_AtomicSetPtr((void **) &g_Breakpoints, bpts);
+    wait_for_readers();
+    free(old);
+
+    l_MaxBreakpoints = max;
+    return 1;
+}
+
+static int breakpoint_overlaps(const m64p_breakpoint *bpt, uint32 address, uint64 endaddr)
+{
+    if(bpt->endaddr < bpt->address)
+        return (endaddr >= bpt->address) || (address <= bpt->endaddr);
+    else // endaddr >= address
+        return (endaddr >= bpt->address) && (address <= bpt->endaddr);
+}
+
+static void index_exec_pages(bpt_index *index, uint32 first, uint32 last)
+{
+    uint32 page;
+
+    for (page = first; page <= last; page++)
+        index->exec_pages[page >> 3] |= 1 << (page & 7);
+}
+
+static void index_range(bpt_range *ranges, int *count, uint32 address, uint32 endaddr, uint32 flags, int bpt)
+{
+    ranges[*count].address = address;
+    ranges[*count].endaddr = endaddr;
+    ranges[*count].flags = flags;
+    ranges[*count].bpt = bpt;
+    (*count)++;
+}
+
+static int compare_ranges(const void *a, const void *b)
+{
+    uint32 address_a = ((const bpt_range *) a)->address;
+    uint32 address_b = ((const bpt_range *) b)->address;
+
+    return (address_a > address_b) - (address_a < address_b);
+}
+
+static void sort_ranges(bpt_range *ranges, int count)
+{
+    int i;
+
+    qsort(ranges, count, sizeof(bpt_range), compare_ranges);
+    for (i = 0; i < count; i++)
+        ranges[i].maxend = (i > 0 && ranges[i-1].maxend > ranges[i].endaddr) ? ranges[i-1].maxend : ranges[i].endaddr;
+}
+
+static void index_breakpoints(void)
+{
+    int i, num_exec = 0, num_read = 0, num_write = 0;
+    bpt_index *index, *old;
+
+    /* wrapping ranges take two entries */
+    for (i = 0; i < g_NumBreakpoints; i++)
+    {
+        m64p_breakpoint *bpt = &g_Breakpoints[i];
+        int entries = (bpt->endaddr < bpt->address) ? 2 : 1;
+
+        if (!BPT_CHECK_FLAG((*bpt), M64P_BKP_FLAG_ENABLED))
+            continue;
+        if (BPT_CHECK_FLAG((*bpt), M64P_BKP_FLAG_EXEC))
+            num_exec++;
+        if (BPT_CHECK_FLAG((*bpt), M64P_BKP_FLAG_READ))
+            num_read += entries;
+        if (BPT_CHECK_FLAG((*bpt), M64P_BKP_FLAG_WRITE))
+            num_write += entries;
+    }
+
+    index = (bpt_index *) malloc(sizeof(bpt_index) + (num_exec + num_read + num_write) * sizeof(bpt_range));
+    if (index == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Couldn't allocate the breakpoint index.");
+        return;
+    }
+    memset(index->exec_pages, 0, sizeof(index->exec_pages));
+    index->exec = (bpt_range *) (index + 1);
+    index->read = index->exec + num_exec;
+    index->write = index->read + num_read;
+    index->num_exec = index->num_read = index->num_write = 0;
+
+    for (i = 0; i < g_NumBreakpoints; i++)
+    {
+        m64p_breakpoint *bpt = &g_Breakpoints[i];
+        int wraps = bpt->endaddr < bpt->address;
+
+        if (!BPT_CHECK_FLAG((*bpt), M64P_BKP_FLAG_ENABLED))
+            continue;
+
+        if (BPT_CHECK_FLAG((*bpt), M64P_BKP_FLAG_EXEC)) {
+            index_range(index->exec, &index->num_exec, bpt->address, bpt->endaddr, bpt->flags, i);
+            index_exec_pages(index, bpt->address >> 12, wraps ? 0xFFFFF : bpt->endaddr >> 12);
+            if (wraps)
+                index_exec_pages(index, 0, bpt->endaddr >> 12);
+        }
+
+        if (BPT_CHECK_FLAG((*bpt), M64P_BKP_FLAG_READ)) {
+            index_range(index->read, &index->num_read, bpt->address, wraps ? 0xFFFFFFFF : bpt->endaddr, bpt->flags, i);
+            if (wraps)
+                index_range(index->read, &index->num_read, 0, bpt->endaddr, bpt->flags, i);
+        }
+
+        if (BPT_CHECK_FLAG((*bpt), M64P_BKP_FLAG_WRITE)) {
+            index_range(index->write, &index->num_write, bpt->address, wraps ? 0xFFFFFFFF : bpt->endaddr, bpt->flags, i);
+            if (wraps)
+                index_range(index->write, &index->num_write, 0, bpt->endaddr, bpt->flags, i);
+        }
+    }
+
+    sort_ranges(index->read, index->num_read);
+    sort_ranges(index->write, index->num_write);
+
+    old = (bpt_index *) SDL_AtomicSetPtr((void **) &l_Index, index);
+    wait_for_readers();
+    free(old);
+}
+
+/* returns the range of the first breakpoint overlapping [address, endaddr] */
+static const bpt_range *lookup_range(const bpt_range *ranges, int count, uint32 address, uint64 endaddr)
+{
+    const bpt_range *found = NULL;
+    int low = 0, high = count;
+
+    /* the ranges from high on start after endaddr */
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        if (ranges[mid].address <= endaddr)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    while (--high >= 0 && ranges[high].maxend >= address)
+    {
+        if (ranges[high].endaddr >= address && (found == NULL || ranges[high].bpt < found->bpt))
+            found = &ranges[high];
+    }
+
+    return found;
+}
+
+/* returns the first execution breakpoint holding address */
+static const bpt_range *lookup_exec(const bpt_index *index, uint32 address)
+{
+    int i;
+
+    if (index == NULL || !(index->exec_pages[address >> 15] & (1 << ((address >> 12) & 7))))
+        return NULL;
+
+    for (i = 0; i < index->num_exec; i++)
+    {
+        const bpt_range *range = &index->exec[i];
+        int wraps = range->endaddr < range->address;
+
+        if (wraps ? (address >= range->address || address <= range->endaddr)
+                  : (address >= range->address && address <= range->endaddr))
+            return range;
+    }
+    return NULL;
+}
 
 
 int add_breakpoint( uint32 address )
 {
-    if( g_NumBreakpoints == BREAKPOINTS_MAX_NUMBER ) {
-        DebugMessage(M64MSG_ERROR, "BREAKPOINTS_MAX_NUMBER have been reached.");
+    if (!grow_breakpoints())
         return -1;
-    }
+
     g_Breakpoints[g_NumBreakpoints].address=address;
     g_Breakpoints[g_NumBreakpoints].endaddr=address;
+    g_Breakpoints[g_NumBreakpoints].flags=0;
     BPT_SET_FLAG(g_Breakpoints[g_NumBreakpoints], M64P_BKP_FLAG_EXEC);
 
-    enable_breakpoint(g_NumBreakpoints);
+    enable_breakpoint(g_NumBreakpoints++);
 
-    return g_NumBreakpoints++;
+    return g_NumBreakpoints - 1;
 }
 
 int add_breakpoint_struct(m64p_breakpoint *newbp)
 {
-     if( g_NumBreakpoints == BREAKPOINTS_MAX_NUMBER ) {
-        DebugMessage(M64MSG_ERROR, "BREAKPOINTS_MAX_NUMBER have been reached.");
+    if (!grow_breakpoints())
         return -1;
-    }
 
     memcpy(&g_Breakpoints[g_NumBreakpoints], newbp, sizeof(m64p_breakpoint));
+    g_NumBreakpoints++;
 
-    if (BPT_CHECK_FLAG(g_Breakpoints[g_NumBreakpoints], M64P_BKP_FLAG_ENABLED)) {
-        BPT_CLEAR_FLAG(g_Breakpoints[g_NumBreakpoints], M64P_BKP_FLAG_ENABLED);
-        enable_breakpoint( g_NumBreakpoints );
+    if (BPT_CHECK_FLAG(g_Breakpoints[g_NumBreakpoints - 1], M64P_BKP_FLAG_ENABLED)) {
+        BPT_CLEAR_FLAG(g_Breakpoints[g_NumBreakpoints - 1], M64P_BKP_FLAG_ENABLED);
+        enable_breakpoint( g_NumBreakpoints - 1 );
     }
     
-    return g_NumBreakpoints++;
+    return g_NumBreakpoints - 1;
 }
 
 void enable_breakpoint( int bpt)
@@ -84,6 +323,7 @@ void enable_breakpoint( int bpt)
     }
     
     BPT_SET_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_ENABLED);
+    index_breakpoints();
 }
 
 void disable_breakpoint( int bpt )
@@ -106,6 +346,7 @@ void disable_breakpoint( int bpt )
     }
 
     BPT_CLEAR_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_ENABLED);
+    index_breakpoints();
 }
 
 void remove_breakpoint_by_num( int bpt )
@@ -119,6 +360,7 @@ void remove_breakpoint_by_num( int bpt )
         g_Breakpoints[curBpt-1]=g_Breakpoints[curBpt];
     
     g_NumBreakpoints--;
+    index_breakpoints();
 }
 
 void remove_breakpoint_by_address( uint32 address )
@@ -143,6 +385,8 @@ void replace_breakpoint_num( int bpt, m64p_breakpoint *copyofnew )
         BPT_CLEAR_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_ENABLED);
         enable_breakpoint(bpt);
     }
+    else
+        index_breakpoints();
 }
 
 int lookup_breakpoint( uint32 address, uint32 size, uint32 flags)
@@ -152,28 +396,41 @@ int lookup_breakpoint( uint32 address, uint32 size, uint32 flags)
     
     for( i=0; i < g_NumBreakpoints; i++)
     {
-        if((g_Breakpoints[i].flags & flags) == flags)
-        {
-            if(g_Breakpoints[i].endaddr < g_Breakpoints[i].address)
-            {
-                if((endaddr >= g_Breakpoints[i].address) || 
-                    (address <= g_Breakpoints[i].endaddr))
-                        return i;
-            }
-            else // endaddr >= address
-            {
-                if((endaddr >= g_Breakpoints[i].address) && 
-                    (address <= g_Breakpoints[i].endaddr))
-                        return i;
-            }
-        }
+        if((g_Breakpoints[i].flags & flags) == flags &&
+            breakpoint_overlaps(&g_Breakpoints[i], address, endaddr))
+                return i;
     }
     return -1;
 }
 
 int check_breakpoints( uint32 address )
 {
-    return lookup_breakpoint(address, 1, M64P_BKP_FLAG_ENABLED | M64P_BKP_FLAG_EXEC);
+    const bpt_range *range;
+    int bpt;
+
+    range = lookup_exec(acquire_index(), address);
+    bpt = (range != NULL) ? range->bpt : -1;
+    release_index();
+
+    return bpt;
+}
+
+int check_breakpoints_on_exec( uint32 pc )
+{
+    const bpt_range *range;
+    int bpt = -1, log = 0;
+
+    range = lookup_exec(acquire_index(), pc);
+    if (range != NULL)
+    {
+        bpt = range->bpt;
+        log = range->flags & M64P_BKP_FLAG_LOG;
+    }
+    release_index();
+
+    if (log)
+        log_breakpoint(pc, M64P_BKP_FLAG_EXEC, 0);
+    return bpt;
 }
 
 
@@ -183,13 +440,33 @@ int check_breakpoints_on_mem_access( uint32 pc, uint32 address, uint32 size, uin
     //range to check, flags specifies the flags that all need to be set.
     //It automatically stops and updates the debugger on hit, so the memory access
     //functions only need to call it and can discard the result.
-    int bpt;
+    int bpt = -1, log = 0;
     if(run == 2)
     {
-        bpt=lookup_breakpoint( address, size, flags );
+        uint64 endaddr = ((uint64)address) + ((uint64)size) - 1;
+        const bpt_index *index = acquire_index();
+        const bpt_range *range = NULL;
+
+        if (index != NULL && flags == (M64P_BKP_FLAG_ENABLED | M64P_BKP_FLAG_READ))
+            range=lookup_range( index->read, index->num_read, address, endaddr );
+        else if (index != NULL && flags == (M64P_BKP_FLAG_ENABLED | M64P_BKP_FLAG_WRITE))
+            range=lookup_range( index->write, index->num_write, address, endaddr );
+        else
+        {
+            bpt=lookup_breakpoint( address, size, flags );
+            if (bpt != -1)
+                log = g_Breakpoints[bpt].flags & M64P_BKP_FLAG_LOG;
+        }
+        if (range != NULL)
+        {
+            bpt = range->bpt;
+            log = range->flags & M64P_BKP_FLAG_LOG;
+        }
+        release_index();
+
         if(bpt != -1)
         {
-            if (BPT_CHECK_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_LOG))
+            if (log)
                 log_breakpoint(pc, flags, address);
             
             run = 0;
@@ -201,6 +478,16 @@ int check_breakpoints_on_mem_access( uint32 pc, uint32 address, uint32 size, uin
     return -1;
 }
 
+void free_breakpoints(void)
+{
+    free(l_Index);
+    l_Index = NULL;
+    free(g_Breakpoints);
+    g_Breakpoints = NULL;
+    g_NumBreakpoints = 0;
+    l_MaxBreakpoints = 0;
+}
+
 int log_breakpoint(uint32 PC, uint32 Flag, uint32 Access)
 {
     char msg[32];
@@ -25,7 +25,7 @@
 #include "../api/m64p_types.h"
 
 extern int g_NumBreakpoints;
-extern m64p_breakpoint g_Breakpoints[];
+extern m64p_breakpoint *g_Breakpoints;
 
 int add_breakpoint( uint32 address );
 int add_breakpoint_struct(m64p_breakpoint *newbp);
@@ -34,10 +34,12 @@ void remove_breakpoint_by_num( int bpt );
 void enable_breakpoint( int breakpoint );
 void disable_breakpoint( int breakpoint );
 int check_breakpoints( uint32 address );
+int check_breakpoints_on_exec( uint32 pc );
 int check_breakpoints_on_mem_access( uint32 pc, uint32 address, uint32 size, uint32 flags );
 int lookup_breakpoint( uint32 address, uint32 size, uint32 flags );
 int log_breakpoint(uint32 PC, uint32 Flag, uint32 Access);
 void replace_breakpoint_num( int, m64p_breakpoint * );
+void free_breakpoints(void);
 
 #endif  /* __BREAKPOINTS_H__ */
 
@@ -155,7 +155,7 @@ static void decode_recompiled(uint32 addr)
 
     lines_recompiled=0;
 
-    if(blocks[addr>>12] == NULL)
+    if(blocks[addr>>12] == NULL || blocks[addr>>12]->infos == NULL)
         return;
 
     if(blocks[addr>>12]->block[(addr&0xFFF)/4].ops == current_instruction_table.NOTCOMPILED)
@@ -170,14 +170,14 @@ static void decode_recompiled(uint32 addr)
       }
 
     assemb = (blocks[addr>>12]->code) + 
-      (blocks[addr>>12]->block[(addr&0xFFF)/4].local_addr);
+      (blocks[addr>>12]->infos[(addr&0xFFF)/4].local_addr);
 
     end_addr = blocks[addr>>12]->code;
 
     if( (addr & 0xFFF) >= 0xFFC)
         end_addr += blocks[addr>>12]->code_length;
     else
-        end_addr += blocks[addr>>12]->block[(addr&0xFFF)/4+1].local_addr;
+        end_addr += blocks[addr>>12]->infos[(addr&0xFFF)/4+1].local_addr;
 
     while(assemb < end_addr)
       {
@@ -241,14 +241,14 @@ int get_has_recompiled(uint32 addr)
         return FALSE;
 
     assemb = (blocks[addr>>12]->code) + 
-      (blocks[addr>>12]->block[(addr&0xFFF)/4].local_addr);
+      (blocks[addr>>12]->infos[(addr&0xFFF)/4].local_addr);
 
     end_addr = blocks[addr>>12]->code;
 
     if( (addr & 0xFFF) >= 0xFFC)
         end_addr += blocks[addr>>12]->code_length;
     else
-        end_addr += blocks[addr>>12]->block[(addr&0xFFF)/4+1].local_addr;
+        end_addr += blocks[addr>>12]->infos[(addr&0xFFF)/4+1].local_addr;
     if(assemb==end_addr)
       return FALSE;
 
@@ -323,8 +323,8 @@ uint32 read_memory_32(uint32 addr){
   switch(get_memory_type(addr))
     {
     case M64P_MEM_NOMEM:
-      if(tlb_LUT_r[addr>>12])
-        return read_memory_32((tlb_LUT_r[addr>>12]&0xFFFFF000)|(addr&0xFFF));
+      if(tlb_LUT_r(addr>>12))
+        return read_memory_32((tlb_LUT_r(addr>>12)&0xFFFFF000)|(addr&0xFFF));
       return M64P_MEM_INVALID;
     case M64P_MEM_RDRAM:
       return *((uint32 *)(rdramb + (addr & 0xFFFFFF)));
@@ -457,7 +457,7 @@ uint32 get_memory_flags(uint32 addr)
   switch(type)
   {
     case M64P_MEM_NOMEM:
-      if(tlb_LUT_r[addr>>12])
+      if(tlb_LUT_r(addr>>12))
         flags = M64P_MEM_FLAG_READABLE | M64P_MEM_FLAG_WRITABLE_EMUONLY;
       break;
     case M64P_MEM_NOTHING:
@@ -580,6 +580,9 @@ int get_memory_type(uint32 addr){
 void activate_memory_break_read(uint32 addr) {
     void (*readfunc)() = readmem[addr >> 16];
 
+    /* the memory accessors must go through the handler tables from now on */
+    fast_memory = 0;
+
     if(readfunc == read_nomem) {
         readmem[addr >> 16]  = read_nomem_break;
         readmemb[addr >> 16] = read_nomemb_break;
@@ -822,6 +825,9 @@ void deactivate_memory_break_read(uint32 addr) {
 void activate_memory_break_write(uint32 addr) {
     void (*writefunc)() = writemem[addr >> 16];
 
+    /* the memory accessors must go through the handler tables from now on */
+    fast_memory = 0;
+
     if(writefunc == write_nomem) {
         writemem[addr >> 16]  = write_nomem_break;
         writememb[addr >> 16] = write_nomemb_break;
@@ -71,12 +71,9 @@ void update_debugger(uint32 pc)
     int bpt;
 
     if(run!=0) {//check if we hit a breakpoint
-        bpt = check_breakpoints(pc);
+        bpt = check_breakpoints_on_exec(pc);
         if( bpt!=-1 ) {
             run = 0;
-
-            if (BPT_CHECK_FLAG(g_Breakpoints[bpt], M64P_BKP_FLAG_LOG))
-                log_breakpoint(pc, M64P_BKP_FLAG_EXEC, 0);
         }
     }
 
@@ -47,100 +47,304 @@
 typedef struct cheat_code {
     unsigned int address;
     int value;
-    int old_value;
     struct list_head list;
 } cheat_code_t;
 
 typedef struct cheat {
     char *name;
     int enabled;
-    int was_enabled;
+    unsigned int serial; /* changes when the codes are replaced */
     struct list_head cheat_codes;
     struct list_head list;
 } cheat_t;
 
+/* The cheats are compiled into a program each time one is added, toggled or
+ * deleted, so that they are applied at each VI without any lock and without
+ * decoding the codes again.  A program is a flat array of operations, with
+ * the range of each cheat in a second array.
+ *
+ * The compiled program is handed to the emulation thread through
+ * l_PendingProgram, which it swaps for its own program at the next VI.  Only
+ * the emulation thread writes to its program: it carries the values saved
+ * before the first writes of each cheat over from the previous program, to
+ * restore them when the cheat is disabled. */
+enum {
+    CHEAT_OP_WRITE8,    /* 80, A0: write, saving the old value */
+    CHEAT_OP_WRITE16,   /* 81, A1 */
+    CHEAT_OP_BOOT8,     /* F0: write once at boot, saving the old value */
+    CHEAT_OP_BOOT16,    /* F1 */
+    CHEAT_OP_GS_WRITE8, /* 88, A8: write while the GS button is pressed */
+    CHEAT_OP_GS_WRITE16,/* 89, A9 */
+    CHEAT_OP_EXPANSION, /* EE: disable the expansion pak */
+    CHEAT_OP_NONE,      /* any other code, which only uses up a condition */
+    /* the conditions, from here on */
+    CHEAT_OP_EQUAL8,    /* D0, D8 */
+    CHEAT_OP_EQUAL16,   /* D1, D9 */
+    CHEAT_OP_DIFFER8,   /* D2, DB */
+    CHEAT_OP_DIFFER16,  /* D3, DA */
+    CHEAT_OP_TRUE       /* any other Dx */
+};
+
+typedef struct cheat_op {
+    unsigned char kind;
+    unsigned char gs;       /* condition which needs the GS button pressed */
+    unsigned short value;
+    unsigned int offset;    /* in rdramb, byte swapped */
+    int old_value;          /* CHEAT_CODE_MAGIC_VALUE until saved */
+} cheat_op_t;
+
+typedef struct compiled_cheat {
+    unsigned int serial;
+    int enabled;
+    int was_enabled;
+    int first_op;
+    int num_ops;
+} compiled_cheat_t;
+
+typedef struct cheat_program {
+    int num_cheats;
+    compiled_cheat_t *cheats;
+    cheat_op_t *ops;
+} cheat_program_t;
+
 // local variables
 static LIST_HEAD(active_cheats);
 static SDL_mutex *cheat_mutex = NULL;
+static unsigned int l_NextSerial = 0;
 
-// private functions
-static unsigned short read_address_16bit(unsigned int address)
-{
-    return *(unsigned short *)((rdramb + ((address & 0xFFFFFF)^S16)));
-}
+static cheat_program_t *l_Program = NULL;   /* emulation thread only */
+static void *l_PendingProgram = NULL;
 
-static unsigned char read_address_8bit(unsigned int address)
+// private functions
+static unsigned short read_16bit(unsigned int offset)
 {
-    return *(unsigned char *)((rdramb + ((address & 0xFFFFFF)^S8)));
+    return *(unsigned short *)(rdramb + offset);
 }
 
-static void update_address_16bit(unsigned int address, unsigned short new_value)
+static unsigned char read_8bit(unsigned int offset)
 {
-    *(unsigned short *)((rdramb + ((address & 0xFFFFFF)^S16))) = new_value;
+    return *(unsigned char *)(rdramb + offset);
 }
 
-static void update_address_8bit(unsigned int address, unsigned char new_value)
+static void update_16bit(unsigned int offset, unsigned short new_value)
 {
-    *(unsigned char *)((rdramb + ((address & 0xFFFFFF)^S8))) = new_value;
+    *(unsigned short *)(rdramb + offset) = new_value;
 }
 
-static int address_equal_to_8bit(unsigned int address, unsigned char value)
+static void update_8bit(unsigned int offset, unsigned char new_value)
 {
-    unsigned char value_read;
-    value_read = *(unsigned char *)((rdramb + ((address & 0xFFFFFF)^S8)));
-    return value_read == value;
+    *(unsigned char *)(rdramb + offset) = new_value;
 }
 
-static int address_equal_to_16bit(unsigned int address, unsigned short value)
+static void compile_code(cheat_op_t *op, unsigned int address, int value)
 {
-    unsigned short value_read;
-    value_read = *(unsigned short *)((rdramb + ((address & 0xFFFFFF)^S16)));
-    return value_read == value;
-}
+    op->gs = 0;
+    op->value = (unsigned short) value;
+    op->offset = (address & 0xFFFFFF) ^ S8;
+    op->old_value = CHEAT_CODE_MAGIC_VALUE;
 
-// individual application - returns 0 if we are supposed to skip the next cheat
-// (only really used on conditional codes)
-static int execute_cheat(unsigned int address, unsigned short value, int *old_value)
-{
     switch (address & 0xFF000000)
     {
         case 0x80000000:
-        case 0x88000000:
         case 0xA0000000:
-        case 0xA8000000:
-        case 0xF0000000:
-            // if pointer to old value is valid and uninitialized, write current value to it
-            if(old_value && (*old_value == CHEAT_CODE_MAGIC_VALUE))
-                *old_value = (int) read_address_8bit(address);
-            update_address_8bit(address,(unsigned char) value);
-            return 1;
+            op->kind = CHEAT_OP_WRITE8;
+            break;
         case 0x81000000:
-        case 0x89000000:
         case 0xA1000000:
-        case 0xA9000000:
+            op->kind = CHEAT_OP_WRITE16;
+            break;
+        case 0xF0000000:
+            op->kind = CHEAT_OP_BOOT8;
+            break;
         case 0xF1000000:
-            // if pointer to old value is valid and uninitialized, write current value to it
-            if(old_value && (*old_value == CHEAT_CODE_MAGIC_VALUE))
-                *old_value = (int) read_address_16bit(address);
-            update_address_16bit(address,value);
-            return 1;
-        case 0xD0000000:
+            op->kind = CHEAT_OP_BOOT16;
+            break;
+        case 0x88000000:
+        case 0xA8000000:
+            op->kind = CHEAT_OP_GS_WRITE8;
+            break;
+        case 0x89000000:
+        case 0xA9000000:
+            op->kind = CHEAT_OP_GS_WRITE16;
+            break;
+        case 0xEE000000:
+            op->kind = CHEAT_OP_EXPANSION;
+            break;
         case 0xD8000000:
-            return address_equal_to_8bit(address,(unsigned char) value);
-        case 0xD1000000:
+        case 0xD0000000:
+            op->kind = CHEAT_OP_EQUAL8;
+            break;
         case 0xD9000000:
-            return address_equal_to_16bit(address,value);
-        case 0xD2000000:
+        case 0xD1000000:
+            op->kind = CHEAT_OP_EQUAL16;
+            break;
         case 0xDB000000:
-            return !(address_equal_to_8bit(address,(unsigned char) value));
+        case 0xD2000000:
+            op->kind = CHEAT_OP_DIFFER8;
+            break;
+        case 0xDA000000:
         case 0xD3000000:
+            op->kind = CHEAT_OP_DIFFER16;
+            break;
+        default:
+            op->kind = ((address & 0xF0000000) == 0xD0000000) ? CHEAT_OP_TRUE : CHEAT_OP_NONE;
+            break;
+    }
+
+    switch (address & 0xFF000000)
+    {
+        case 0xD8000000:
+        case 0xD9000000:
         case 0xDA000000:
-            return !(address_equal_to_16bit(address,value));
-        case 0xEE000000:
+        case 0xDB000000:
+            op->gs = 1;
+            break;
+    }
+
+    if (op->kind == CHEAT_OP_WRITE16 || op->kind == CHEAT_OP_BOOT16 || op->kind == CHEAT_OP_GS_WRITE16 ||
+        op->kind == CHEAT_OP_EQUAL16 || op->kind == CHEAT_OP_DIFFER16)
+        op->offset = (address & 0xFFFFFF) ^ S16;
+}
+
+/* compiles the cheats, with cheat_mutex held */
+static cheat_program_t *compile_cheats(void)
+{
+    cheat_program_t *program;
+    cheat_t *cheat;
+    cheat_code_t *code;
+    int num_cheats = 0, num_ops = 0;
+
+    list_for_each_entry_t(cheat, &active_cheats, cheat_t, list) {
+        num_cheats++;
+        list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list)
+            num_ops++;
+    }
+
+    program = malloc(sizeof(*program) + num_cheats * sizeof(compiled_cheat_t) + num_ops * sizeof(cheat_op_t));
+    if (program == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Couldn't allocate the compiled cheats, they are left unchanged");
+        return NULL;
+    }
+    program->num_cheats = 0;
+    program->cheats = (compiled_cheat_t *) (program + 1);
+    program->ops = (cheat_op_t *) (program->cheats + num_cheats);
+
+    num_ops = 0;
+    list_for_each_entry_t(cheat, &active_cheats, cheat_t, list) {
+        compiled_cheat_t *compiled = &program->cheats[program->num_cheats++];
+        compiled->serial = cheat->serial;
+        compiled->enabled = cheat->enabled;
+        compiled->was_enabled = 0;
+        compiled->first_op = num_ops;
+        list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list)
+            compile_code(&program->ops[num_ops++], code->address, code->value);
+        compiled->num_ops = num_ops - compiled->first_op;
+    }
+
+    return program;
+}
+
+/* hands the compiled cheats over to the emulation thread, with cheat_mutex held */
+static void publish_cheats(void)
+{
+    cheat_program_t *program = compile_cheats();
+    void *unused;
+
+    if (program == NULL)
+        return;
+
+#if SDL_VERSION_ATLEAST(2,0,2)
+    unused = SDL_AtomicSetPtr(&l_PendingProgram, program);
+#else
+    unused = l_PendingProgram;
+    l_PendingProgram = program;
+#endif
+    /* a program never taken by the emulation thread is still ours */
+    free(unused);
+}
+
+/* swaps the program of the emulation thread for the pending one, if any */
+static void take_cheats(void)
+{
+    cheat_program_t *program;
+    int i, j, k, n;
+
+#if SDL_VERSION_ATLEAST(2,0,2)
+    program = (cheat_program_t *) SDL_AtomicSetPtr(&l_PendingProgram, NULL);
+#else
+    if (l_PendingProgram == NULL || cheat_mutex == NULL || SDL_LockMutex(cheat_mutex) != 0)
+        return;
+    program = (cheat_program_t *) l_PendingProgram;
+    l_PendingProgram = NULL;
+    SDL_UnlockMutex(cheat_mutex);
+#endif
+    if (program == NULL)
+        return;
+
+    /* the cheats keep their order, so the search resumes after the last match */
+    if (l_Program != NULL)
+    {
+        for (i = 0, j = 0; i < program->num_cheats && l_Program->num_cheats > 0; i++)
+        {
+            compiled_cheat_t *cheat = &program->cheats[i];
+            for (k = 0; k < l_Program->num_cheats; k++, j = (j + 1) % l_Program->num_cheats)
+            {
+                compiled_cheat_t *old = &l_Program->cheats[j];
+                if (old->serial != cheat->serial)
+                    continue;
+                cheat->was_enabled = old->was_enabled;
+                for (n = 0; n < cheat->num_ops; n++)
+                    program->ops[cheat->first_op + n].old_value = l_Program->ops[old->first_op + n].old_value;
+                break;
+            }
+        }
+    }
+
+    free(l_Program);
+    l_Program = program;
+}
+
+static void write_op(cheat_op_t *op, int value, int save)
+{
+    switch (op->kind)
+    {
+        case CHEAT_OP_WRITE8:
+        case CHEAT_OP_BOOT8:
+        case CHEAT_OP_GS_WRITE8:
+            // if the old value is to be saved and isn't yet, save the current value
+            if (save && op->old_value == CHEAT_CODE_MAGIC_VALUE)
+                op->old_value = (int) read_8bit(op->offset);
+            update_8bit(op->offset, (unsigned char) value);
+            break;
+        case CHEAT_OP_WRITE16:
+        case CHEAT_OP_BOOT16:
+        case CHEAT_OP_GS_WRITE16:
+            if (save && op->old_value == CHEAT_CODE_MAGIC_VALUE)
+                op->old_value = (int) read_16bit(op->offset);
+            update_16bit(op->offset, (unsigned short) value);
+            break;
+        case CHEAT_OP_EXPANSION:
             // most likely, this doesnt do anything.
-            execute_cheat(0xF1000318, 0x0040, NULL);
-            execute_cheat(0xF100031A, 0x0000, NULL);
-            return 1;
+            update_16bit(0x318 ^ S16, 0x0040);
+            update_16bit(0x31A ^ S16, 0x0000);
+            break;
+    }
+}
+
+// returns 0 if we are supposed to skip the next code
+static int test_op(const cheat_op_t *op)
+{
+    switch (op->kind)
+    {
+        case CHEAT_OP_EQUAL8:
+            return read_8bit(op->offset) == (unsigned char) op->value;
+        case CHEAT_OP_EQUAL16:
+            return read_16bit(op->offset) == op->value;
+        case CHEAT_OP_DIFFER8:
+            return read_8bit(op->offset) != (unsigned char) op->value;
+        case CHEAT_OP_DIFFER16:
+            return read_16bit(op->offset) != op->value;
         default:
             return 1;
     }
@@ -169,14 +373,14 @@ static cheat_t *find_or_create_cheat(const char *name)
         }
 
         cheat->enabled = 0;
-        cheat->was_enabled = 0;
+        cheat->serial = l_NextSerial++;
     }
     else
     {
         cheat = malloc(sizeof(*cheat));
         cheat->name = strdup(name);
         cheat->enabled = 0;
-        cheat->was_enabled = 0;
+        cheat->serial = l_NextSerial++;
         INIT_LIST_HEAD(&cheat->cheat_codes);
         list_add_tail(&cheat->list, &active_cheats);
     }
@@ -196,55 +400,53 @@ void cheat_uninit(void)
     if (cheat_mutex != NULL)
         SDL_DestroyMutex(cheat_mutex);
     cheat_mutex = NULL;
+
+    /* the emulation has stopped */
+    free(l_PendingProgram);
+    l_PendingProgram = NULL;
+    free(l_Program);
+    l_Program = NULL;
 }
 
 void cheat_apply_cheats(int entry)
 {
-    cheat_t *cheat;
-    cheat_code_t *code;
-    int cond_failed;
+    int i, cond_failed, gs_active;
 
-    if (list_empty(&active_cheats))
-        return;
+    take_cheats();
 
-    if (cheat_mutex == NULL || SDL_LockMutex(cheat_mutex) != 0)
-    {
-        DebugMessage(M64MSG_ERROR, "Internal error: failed to lock mutex in cheat_apply_cheats()");
+    if (l_Program == NULL || l_Program->num_cheats == 0)
         return;
-    }
 
-    list_for_each_entry_t(cheat, &active_cheats, cheat_t, list) {
+    gs_active = event_gameshark_active();
+
+    for (i = 0; i < l_Program->num_cheats; i++) {
+        compiled_cheat_t *cheat = &l_Program->cheats[i];
+        cheat_op_t *op = l_Program->ops + cheat->first_op;
+        cheat_op_t *end = op + cheat->num_ops;
+
         if (cheat->enabled)
         {
             cheat->was_enabled = 1;
             switch(entry)
             {
                 case ENTRY_BOOT:
-                    list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
+                    for (; op < end; op++) {
                         // code should only be written once at boot time
-                        if((code->address & 0xF0000000) == 0xF0000000)
-                            execute_cheat(code->address, code->value, &code->old_value);
+                        if (op->kind == CHEAT_OP_BOOT8 || op->kind == CHEAT_OP_BOOT16)
+                            write_op(op, op->value, 1);
                     }
                     break;
                 case ENTRY_VI:
                     /* a cheat starts without failed preconditions */
                     cond_failed = 0;
 
-                    list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
+                    for (; op < end; op++) {
                         /* conditional cheat codes */
-                        if((code->address & 0xF0000000) == 0xD0000000)
+                        if (op->kind >= CHEAT_OP_EQUAL8)
                         {
-                            /* if code needs GS button pressed and it's not, skip it */
-                            if(((code->address & 0xFF000000) == 0xD8000000 ||
-                                (code->address & 0xFF000000) == 0xD9000000 ||
-                                (code->address & 0xFF000000) == 0xDA000000 ||
-                                (code->address & 0xFF000000) == 0xDB000000) &&
-                               !event_gameshark_active())
-                                /* if condition false, skip next code non-test code */
-                                cond_failed = 1;
-
-                            /* if condition false, skip next code non-test code */
-                            if (!execute_cheat(code->address, code->value, NULL))
+                            /* if code needs GS button pressed and it's not,
+                             * or if condition false, skip next non-test code */
+                            if ((op->gs && !gs_active) || !test_op(op))
                                 cond_failed = 1;
                         }
                         else {
@@ -256,20 +458,23 @@ void cheat_apply_cheats(int entry)
                                 continue;
                             }
 
-                            switch (code->address & 0xFF000000) {
+                            switch (op->kind) {
                             /* GS button triggers cheat code */
-                            case 0x88000000:
-                            case 0x89000000:
-                            case 0xA8000000:
-                            case 0xA9000000:
-                                if(event_gameshark_active())
-                                    execute_cheat(code->address, code->value, NULL);
+                            case CHEAT_OP_GS_WRITE8:
+                            case CHEAT_OP_GS_WRITE16:
+                                if (gs_active)
+                                    write_op(op, op->value, 0);
                                 break;
                             /* normal cheat code */
+                            case CHEAT_OP_WRITE8:
+                            case CHEAT_OP_WRITE16:
+                                write_op(op, op->value, 1);
+                                break;
+                            case CHEAT_OP_EXPANSION:
+                                write_op(op, op->value, 0);
+                                break;
+                            /* boot-time cheat codes are excluded */
                             default:
-                                /* exclude boot-time cheat codes */
-                                if((code->address & 0xF0000000) != 0xF0000000)
-                                    execute_cheat(code->address, code->value, &code->old_value);
                                 break;
                             }
                         }
@@ -286,12 +491,12 @@ void cheat_apply_cheats(int entry)
             switch(entry)
             {
                 case ENTRY_VI:
-                    list_for_each_entry_t(code, &cheat->cheat_codes, cheat_code_t, list) {
+                    for (; op < end; op++) {
                         // set memory back to old value and clear saved copy of old value
-                        if(code->old_value != CHEAT_CODE_MAGIC_VALUE)
+                        if (op->old_value != CHEAT_CODE_MAGIC_VALUE)
                         {
-                            execute_cheat(code->address, code->old_value, NULL);
-                            code->old_value = CHEAT_CODE_MAGIC_VALUE;
+                            write_op(op, op->old_value, 0);
+                            op->old_value = CHEAT_CODE_MAGIC_VALUE;
                         }
                     }
                     break;
@@ -300,8 +505,6 @@ void cheat_apply_cheats(int entry)
             }
         }
     }
-
-    SDL_UnlockMutex(cheat_mutex);
 }
 
 
@@ -330,6 +533,7 @@ void cheat_delete_all(void)
         free(cheat);
     }
 
+    publish_cheats();
     SDL_UnlockMutex(cheat_mutex);
 }
 
@@ -349,7 +553,11 @@ int cheat_set_enabled(const char *name, int enabled)
     list_for_each_entry_t(cheat, &active_cheats, cheat_t, list) {
         if (strcmp(name, cheat->name) == 0)
         {
-            cheat->enabled = enabled;
+            if (cheat->enabled != enabled)
+            {
+                cheat->enabled = enabled;
+                publish_cheats();
+            }
             SDL_UnlockMutex(cheat_mutex);
             return 1;
         }
@@ -396,7 +604,6 @@ int cheat_add_new(const char *name, m64p_cheat_code *code_list, int num_codes)
                 cheat_code_t *code = malloc(sizeof(*code));
                 code->address = cur_addr;
                 code->value = cur_value;
-                code->old_value = CHEAT_CODE_MAGIC_VALUE;
                 list_add_tail(&code->list, &cheat->cheat_codes);
                 cur_addr += incr_addr;
                 cur_value += incr_value;
@@ -407,11 +614,11 @@ int cheat_add_new(const char *name, m64p_cheat_code *code_list, int num_codes)
             cheat_code_t *code = malloc(sizeof(*code));
             code->address = code_list[i].address;
             code->value = code_list[i].value;
-            code->old_value = CHEAT_CODE_MAGIC_VALUE;
             list_add_tail(&code->list, &cheat->cheat_codes);
         }
     }
 
+    publish_cheats();
     SDL_UnlockMutex(cheat_mutex);
     return 1;
 }
@@ -127,6 +127,25 @@ static const int NumJoyCommands = sizeof(JoyCmdName) / sizeof(const char *);
 static int JoyCmdActive[16];  /* if extra joystick commands are added above, make sure there is enough room in this array */
 
 static int GamesharkActive = 0;
+static int l_JoystickInit = 0; /* this instance holds a reference on the SDL joystick subsystem */
+
+/* keyboard mappings, read on each key event */
+static config_param l_KbdFullscreen = CONFIG_PARAM("CoreEvents", kbdFullscreen);
+static config_param l_KbdStop = CONFIG_PARAM("CoreEvents", kbdStop);
+static config_param l_KbdPause = CONFIG_PARAM("CoreEvents", kbdPause);
+static config_param l_KbdSave = CONFIG_PARAM("CoreEvents", kbdSave);
+static config_param l_KbdLoad = CONFIG_PARAM("CoreEvents", kbdLoad);
+static config_param l_KbdIncrement = CONFIG_PARAM("CoreEvents", kbdIncrement);
+static config_param l_KbdReset = CONFIG_PARAM("CoreEvents", kbdReset);
+static config_param l_KbdSpeeddown = CONFIG_PARAM("CoreEvents", kbdSpeeddown);
+static config_param l_KbdSpeedup = CONFIG_PARAM("CoreEvents", kbdSpeedup);
+static config_param l_KbdScreenshot = CONFIG_PARAM("CoreEvents", kbdScreenshot);
+static config_param l_KbdMute = CONFIG_PARAM("CoreEvents", kbdMute);
+static config_param l_KbdIncrease = CONFIG_PARAM("CoreEvents", kbdIncrease);
+static config_param l_KbdDecrease = CONFIG_PARAM("CoreEvents", kbdDecrease);
+static config_param l_KbdForward = CONFIG_PARAM("CoreEvents", kbdForward);
+static config_param l_KbdAdvance = CONFIG_PARAM("CoreEvents", kbdAdvance);
+static config_param l_KbdGameshark = CONFIG_PARAM("CoreEvents", kbdGameshark);
 
 /*********************************************************************************************************
 * static functions for eventloop.c
@@ -363,8 +382,10 @@ void event_initialize(void)
         if (event_str != NULL && strlen(event_str) >= 4 && event_str[0] == 'J' && event_str[1] >= '0' && event_str[1] <= '9')
         {
             int device = event_str[1] - '0';
-            if (!SDL_WasInit(SDL_INIT_JOYSTICK))
-                SDL_InitSubSystem(SDL_INIT_JOYSTICK);
+            /* SDL counts the initializations of a subsystem, take our own
+             * reference even if another core instance already holds one */
+            if (!l_JoystickInit && SDL_InitSubSystem(SDL_INIT_JOYSTICK) == 0)
+                l_JoystickInit = 1;
 #if SDL_VERSION_ATLEAST(2,0,0)
             SDL_JoystickOpen(device);
 #else
@@ -381,6 +402,16 @@ void event_initialize(void)
     SDL_SetEventFilter(event_sdl_filter, NULL);
 }
 
+/* releases the SDL subsystems initialized by event_initialize() */
+void event_quit(void)
+{
+    if (l_JoystickInit)
+    {
+        SDL_QuitSubSystem(SDL_INIT_JOYSTICK);
+        l_JoystickInit = 0;
+    }
+}
+
 int event_set_core_defaults(void)
 {
     float fConfigParamsVersion;
@@ -495,37 +526,37 @@ void event_sdl_keydown(int keysym, int keymod)
     else if ((slot = get_saveslot_from_keysym(keysym)) >= 0)
         main_state_set_slot(slot);
     /* check all of the configurable commands */
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdStop)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdStop)))
         main_stop();
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdFullscreen)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdFullscreen)))
         gfx.changeWindow();
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdSave)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdSave)))
         main_state_save(0, NULL); /* save in mupen64plus format using current slot */
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdLoad)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdLoad)))
         main_state_load(NULL); /* load using current slot */
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdIncrement)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdIncrement)))
         main_state_inc_slot();
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdReset)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdReset)))
         reset_soft();
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdSpeeddown)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdSpeeddown)))
         main_speeddown(5);
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdSpeedup)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdSpeedup)))
         main_speedup(5);
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdScreenshot)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdScreenshot)))
         main_take_next_screenshot();    /* screenshot will be taken at the end of frame rendering */
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdPause)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdPause)))
         main_toggle_pause();
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdMute)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdMute)))
         main_volume_mute();
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdIncrease)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdIncrease)))
         main_volume_up();
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdDecrease)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdDecrease)))
         main_volume_down();
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdForward)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdForward)))
         main_set_fastforward(1);
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdAdvance)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdAdvance)))
         main_advance_one();
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdGameshark)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdGameshark)))
         event_set_gameshark(1);
     else
     {
@@ -537,15 +568,15 @@ void event_sdl_keydown(int keysym, int keymod)
 
 void event_sdl_keyup(int keysym, int keymod)
 {
-    if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdStop)))
+    if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdStop)))
     {
         return;
     }
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdForward)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdForward)))
     {
         main_set_fastforward(0);
     }
-    else if (keysym == sdl_keysym2native(ConfigGetParamInt(l_CoreEventsConfig, kbdGameshark)))
+    else if (keysym == sdl_keysym2native(ConfigParamInt(&l_KbdGameshark)))
     {
         event_set_gameshark(0);
     }
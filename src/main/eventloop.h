@@ -24,6 +24,7 @@
 
 extern int event_set_core_defaults(void);
 extern void event_initialize(void);
+extern void event_quit(void);
 extern void event_sdl_keydown(int keysym, int keymod);
 extern void event_sdl_keyup(int keysym, int keymod);
 extern int event_gameshark_active(void);
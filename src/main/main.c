@@ -44,18 +44,26 @@
 #include "main.h"
 #include "cheat.h"
 #include "eventloop.h"
+#include "pacer.h"
 #include "profile.h"
+#include "rewind.h"
 #include "rom.h"
+#include "savemedia.h"
 #include "savestates.h"
+#include "trace.h"
 #include "util.h"
 
+#include "memory/dma.h"
+#include "memory/flashram.h"
 #include "memory/memory.h"
+#include "memory/pif.h"
 #include "osal/files.h"
 #include "osal/preproc.h"
 #include "osd/osd.h"
 #include "osd/screenshot.h"
 #include "plugin/plugin.h"
 #include "r4300/r4300.h"
+#include "r4300/idle_loop.h"
 #include "r4300/interupt.h"
 #include "r4300/reset.h"
 
@@ -78,6 +86,7 @@ m64p_frame_callback g_FrameCallback = NULL;
 
 int         g_MemHasBeenBSwapped = 0;   // store byte-swapped flag so we don't swap twice when re-playing game
 int         g_EmulatorRunning = 0;      // need separate boolean to tell if emulator is running, since --nogui doesn't use a thread
+unsigned int g_ViCount = 0;             // number of vertical interrupts since the emulator was started
 
 /** static (local) variables **/
 static int   l_CurrentFrame = 0;         // frame counter
@@ -85,6 +94,11 @@ static int   l_TakeScreenshot = 0;       // Tell OSD Rendering callback to take
 static int   l_SpeedFactor = 100;        // percentage of nominal game speed at which emulator is running
 static int   l_FrameAdvance = 0;         // variable to check if we pause on next frame
 static int   l_MainSpeedLimit = 1;       // insert delay during vi_interrupt to keep speed at real-time
+static int   l_BatchMode = 0;            // render every Nth VI (N > 0), only on demand (-1), or every VI (0)
+static int   l_BatchSpeedLimit = 1;      // speed limiter to restore when leaving the batch mode
+static int   l_BatchSkipped = 0;         // VIs not rendered since the last rendered one
+static int   l_RenderRequested = 0;      // render the next VI in batch mode
+static config_param l_OnScreenDisplay = CONFIG_PARAM("Core", "OnScreenDisplay"); // read on each rendered frame
 
 static osd_message_t *l_msgVol = NULL;
 static osd_message_t *l_msgFF = NULL;
@@ -140,7 +154,7 @@ void main_message(m64p_msg_level level, unsigned int corner, const char *format,
     va_end(ap);
 
     /* send message to on-screen-display if enabled */
-    if (ConfigGetParamBool(g_CoreConfig, "OnScreenDisplay"))
+    if (ConfigParamBool(&l_OnScreenDisplay))
         osd_new_message((enum osd_corner) corner, "%s", buffer);
     /* send message to front-end */
     DebugMessage(level, "%s", buffer);
@@ -188,16 +202,28 @@ int main_set_core_defaults(void)
     ConfigSetDefaultInt(g_CoreConfig, "R4300Emulator", 1, "Use Pure Interpreter if 0, Cached Interpreter if 1, or Dynamic Recompiler if 2 or more");
 #endif
     ConfigSetDefaultBool(g_CoreConfig, "NoCompiledJump", 0, "Disable compiled jump commands in dynamic recompiler (should be set to False) ");
+    ConfigSetDefaultBool(g_CoreConfig, "SSE2FPU", 0, "Use SSE2 instead of x87 instructions for floating point operations in the 64-bit dynamic recompiler");
+    ConfigSetDefaultBool(g_CoreConfig, "TranslationCache", 0, "Keep the code compiled by the 64-bit dynamic recompiler in the user cache directory and reuse it in later sessions");
+    ConfigSetDefaultInt(g_CoreConfig, "TranslationCacheSize", 64, "Maximum size in MB of the translation cache of each ROM. The least recently used pages are dropped first");
+    ConfigSetDefaultBool(g_CoreConfig, "BackgroundCompilation", 0, "Compile new code pages of the 64-bit dynamic recompiler on a worker thread and interpret them meanwhile");
     ConfigSetDefaultBool(g_CoreConfig, "DisableExtraMem", 0, "Disable 4MB expansion RAM pack. May be necessary for some games");
     ConfigSetDefaultBool(g_CoreConfig, "AutoStateSlotIncrement", 0, "Increment the save state slot after each save operation");
     ConfigSetDefaultBool(g_CoreConfig, "EnableDebugger", 0, "Activate the R4300 debugger when ROM execution begins, if core was built with Debugger support");
     ConfigSetDefaultInt(g_CoreConfig, "CurrentStateSlot", 0, "Save state slot (0-9) to use when saving/loading the emulator state");
     ConfigSetDefaultString(g_CoreConfig, "ScreenshotPath", "", "Path to directory where screenshots are saved. If this is blank, the default value of ${UserConfigPath}/screenshot will be used");
     ConfigSetDefaultString(g_CoreConfig, "SaveStatePath", "", "Path to directory where emulator save states (snapshots) are saved. If this is blank, the default value of ${UserConfigPath}/save will be used");
+    ConfigSetDefaultInt(g_CoreConfig, "SaveStateCompression", 6, "Compression level (1-9) of the save states, or 0 to store them uncompressed so that they load faster at the expense of disk space");
     ConfigSetDefaultString(g_CoreConfig, "SaveSRAMPath", "", "Path to directory where SRAM/EEPROM data (in-game saves) are stored. If this is blank, the default value of ${UserConfigPath}/save will be used");
     ConfigSetDefaultString(g_CoreConfig, "SharedDataPath", "", "Path to a directory to search when looking for shared data files");
     ConfigSetDefaultBool(g_CoreConfig, "DelaySI", 1, "Delay interrupt after DMA SI read/write");
     ConfigSetDefaultInt(g_CoreConfig, "CountPerOp", 0, "Force number of cycles per emulated instruction");
+    ConfigSetDefaultBool(g_CoreConfig, "IdleLoopDetection", 0, "Skip to the next interrupt in the short polling loops of the games, besides the jumps to themselves. Can be disabled per ROM with IdleLoops=No in the ROM database");
+    ConfigSetDefaultInt(g_CoreConfig, "RewindBufferSize", 0, "Size in MB of the in-memory rewind buffer, or 0 to disable rewinding");
+    ConfigSetDefaultInt(g_CoreConfig, "RewindInterval", 10, "Number of VIs between two rewind snapshots");
+    ConfigSetDefaultBool(g_CoreConfig, "Trace", 0, "Record a trace of the core subsystems while True, it is written to TraceFile when set back to False or when the emulation stops");
+    ConfigSetDefaultInt(g_CoreConfig, "FramePacerSpin", 1000, "Microseconds before each frame deadline spent yielding the CPU instead of sleeping, to make up for the oversleeping of the OS");
+    ConfigSetDefaultBool(g_CoreConfig, "FramePacerAudioSync", 0, "Pace the emulation to the audio given to the audio plugin instead of the VI rate of the game");
+    ConfigSetDefaultString(g_CoreConfig, "TraceFile", "", "Path of the Chrome trace JSON file written by Trace. If this is blank, the default value of ${UserCachePath}/mupen64plus_trace.json will be used");
 
     /* handle upgrades */
     if (bUpgrade)
@@ -290,6 +316,53 @@ static void main_set_speedlimiter(int enable)
     l_MainSpeedLimit = enable ? 1 : 0;
 }
 
+/* In batch mode, the speed limiter is off and the screen is only updated at
+ * some of the VIs.  The VIs are still emulated the same. */
+static m64p_error main_set_batch_mode(int mode)
+{
+    if (mode < -1)
+        return M64ERR_INPUT_INVALID;
+
+    if (mode != 0 && l_BatchMode == 0)
+    {
+        l_BatchSpeedLimit = l_MainSpeedLimit;
+        main_set_speedlimiter(0);
+        StateChanged(M64CORE_SPEED_LIMITER, 0);
+    }
+    else if (mode == 0 && l_BatchMode != 0)
+    {
+        main_set_speedlimiter(l_BatchSpeedLimit);
+        StateChanged(M64CORE_SPEED_LIMITER, l_MainSpeedLimit);
+    }
+
+    l_BatchMode = mode;
+    l_BatchSkipped = 0;
+    StateChanged(M64CORE_BATCH_MODE, l_BatchMode);
+    return M64ERR_SUCCESS;
+}
+
+/* whether the screen is to be updated at this VI */
+int main_render_vi(void)
+{
+    if (l_BatchMode == 0)
+        return 1;
+
+    if (l_RenderRequested || l_TakeScreenshot != 0)
+    {
+        l_RenderRequested = 0;
+        l_BatchSkipped = 0;
+        return 1;
+    }
+
+    if (l_BatchMode > 0 && ++l_BatchSkipped >= l_BatchMode)
+    {
+        l_BatchSkipped = 0;
+        return 1;
+    }
+
+    return 0;
+}
+
 static int main_is_paused(void)
 {
     return (g_EmulatorRunning && rompause);
@@ -401,6 +474,15 @@ void main_state_load(const char *filename)
         savestates_set_job(savestates_job_load, savestates_type_unknown, filename);
 }
 
+m64p_error main_rewind(void)
+{
+    if (!rewind_enabled())
+        return M64ERR_INVALID_STATE;
+
+    rewind_request_step();
+    return M64ERR_SUCCESS;
+}
+
 void main_state_save(int format, const char *filename)
 {
     if (filename == NULL) // Save to slot
@@ -459,6 +541,18 @@ m64p_error main_core_state_query(m64p_core_param param, int *rval)
         case M64CORE_INPUT_GAMESHARK:
             *rval = event_gameshark_active();
             break;
+        case M64CORE_FRAME_TIME:
+            *rval = pacer_frame_time();
+            break;
+        case M64CORE_FRAME_JITTER:
+            *rval = pacer_frame_jitter();
+            break;
+        case M64CORE_BATCH_MODE:
+            *rval = l_BatchMode;
+            break;
+        case M64CORE_VI_RATE:
+            *rval = pacer_vi_rate();
+            break;
         // these are only used for callbacks; they cannot be queried or set
         case M64CORE_STATE_LOADCOMPLETE:
         case M64CORE_STATE_SAVECOMPLETE:
@@ -523,7 +617,11 @@ m64p_error main_core_state_set(m64p_core_param param, int val)
             main_speedset(val);
             return M64ERR_SUCCESS;
         case M64CORE_SPEED_LIMITER:
-            main_set_speedlimiter(val);
+            // the speed limiter stays off in batch mode, until main_set_batch_mode(0) restores this one
+            if (l_BatchMode != 0)
+                l_BatchSpeedLimit = val ? 1 : 0;
+            else
+                main_set_speedlimiter(val);
             return M64ERR_SUCCESS;
         case M64CORE_VIDEO_SIZE:
         {
@@ -554,10 +652,17 @@ m64p_error main_core_state_set(m64p_core_param param, int val)
                 return M64ERR_INVALID_STATE;
             event_set_gameshark(val);
             return M64ERR_SUCCESS;
+        case M64CORE_BATCH_MODE:
+            return main_set_batch_mode(val);
         // these are only used for callbacks; they cannot be queried or set
         case M64CORE_STATE_LOADCOMPLETE:
         case M64CORE_STATE_SAVECOMPLETE:
             return M64ERR_INPUT_INVALID;
+        // these can only be queried
+        case M64CORE_FRAME_TIME:
+        case M64CORE_FRAME_JITTER:
+        case M64CORE_VI_RATE:
+            return M64ERR_INPUT_INVALID;
         default:
             return M64ERR_INPUT_INVALID;
     }
@@ -572,6 +677,8 @@ m64p_error main_get_screen_size(int *width, int *height)
 m64p_error main_read_screen(void *pixels, int bFront)
 {
     int width_trash, height_trash;
+    // in batch mode, this reads the last rendered VI, render the next one for the next read
+    l_RenderRequested = 1;
     gfx.readScreen(pixels, &width_trash, &height_trash, bFront);
     return M64ERR_SUCCESS;
 }
@@ -639,7 +746,7 @@ m64p_error main_reset(int do_hard_reset)
 
 static void video_plugin_render_callback(int bScreenRedrawn)
 {
-    int bOSD = ConfigGetParamBool(g_CoreConfig, "OnScreenDisplay");
+    int bOSD = ConfigParamBool(&l_OnScreenDisplay);
 
     // if the flag is set to take a screenshot, then grab it now
     if (l_TakeScreenshot != 0)
@@ -683,61 +790,16 @@ void new_frame(void)
 
 void new_vi(void)
 {
-    int FrameDuration;
-    unsigned int CurrentFPSTime;
-    static unsigned int LastFPSTime = 0;
-    static int VIDeltas[64];
-    static unsigned int VIDeltasIndex;
-    static int VITotalDelta;
-
-    double VILimitMilliseconds = 1000.0 / ROM_PARAMS.vilimit;
-    double AdjustedLimit = VILimitMilliseconds * 100.0 / l_SpeedFactor;  // adjust for selected emulator speed
-    int ThisFrameDelta, IntegratedDelta, TimeToWait;
-
     timed_section_start(TIMED_SECTION_IDLE);
+    g_ViCount++;
+    rewind_new_vi();
+    trace_update();
 
 #ifdef DBG
     if(g_DebuggerActive) DebuggerCallback(DEBUG_UI_VI, 0);
 #endif
 
-    // if this is the first frame, the initialize our data structures
-    if(LastFPSTime == 0)
-    {
-        LastFPSTime = SDL_GetTicks();
-        memset(VIDeltas, 0, sizeof(VIDeltas));
-        VITotalDelta = 0;
-        VIDeltasIndex = 0;
-        return;
-    }
-
-    // calculate # of milliseconds that have passed since the last video interrupt
-    CurrentFPSTime = SDL_GetTicks();
-    FrameDuration = CurrentFPSTime - LastFPSTime;
-    ThisFrameDelta = FrameDuration - AdjustedLimit;
-
-    // are we too fast?
-    if (ThisFrameDelta < 0)
-    {
-        // calculate the total time error over the last 64 frames
-        IntegratedDelta = VITotalDelta  + ThisFrameDelta;
-        // if we are still too fast, and then speed limiter is on, then we should wait
-        if (IntegratedDelta < 0 && l_MainSpeedLimit)
-        {
-            TimeToWait = (IntegratedDelta > ThisFrameDelta) ? -IntegratedDelta : -ThisFrameDelta;
-            DebugMessage(M64MSG_VERBOSE, "    new_vi(): Waiting %ims", TimeToWait);
-            SDL_Delay(TimeToWait);
-            // update our time delta for this frame, taking into account the time we just waited
-            ThisFrameDelta = (SDL_GetTicks() - LastFPSTime) - AdjustedLimit;
-        }
-    }
-
-    // update our data structures
-    VITotalDelta -= VIDeltas[VIDeltasIndex];
-    VIDeltas[VIDeltasIndex] = ThisFrameDelta;
-    VIDeltasIndex = (VIDeltasIndex + 1) & 63;
-    VITotalDelta += ThisFrameDelta;
-
-    LastFPSTime = CurrentFPSTime ;
+    pacer_new_vi(ROM_PARAMS.vilimit, l_SpeedFactor, l_MainSpeedLimit);
     timed_section_end(TIMED_SECTION_IDLE);
 }
 
@@ -748,15 +810,19 @@ m64p_error main_run(void)
 {
     /* take the r4300 emulator mode from the config file at this point and cache it in a global variable */
     r4300emu = ConfigGetParamInt(g_CoreConfig, "R4300Emulator");
+    g_ViCount = 0;
 
     /* set some other core parameters based on the config file values */
     savestates_set_autoinc_slot(ConfigGetParamBool(g_CoreConfig, "AutoStateSlotIncrement"));
     savestates_select_slot(ConfigGetParamInt(g_CoreConfig, "CurrentStateSlot"));
     no_compiled_jump = ConfigGetParamBool(g_CoreConfig, "NoCompiledJump");
+    sse2_fpu = ConfigGetParamBool(g_CoreConfig, "SSE2FPU");
     delay_si = ConfigGetParamBool(g_CoreConfig, "DelaySI");
     count_per_op = ConfigGetParamInt(g_CoreConfig, "CountPerOp");
     if (count_per_op <= 0)
         count_per_op = ROM_PARAMS.countperop;
+    g_IdleLoopDetection = ConfigGetParamBool(g_CoreConfig, "IdleLoopDetection") && ROM_PARAMS.idleloops;
+    pacer_init();
     cheat_add_hacks();
 
     // initialize memory, and do byte-swapping if it's not been done yet
@@ -788,7 +854,7 @@ m64p_error main_run(void)
     event_initialize();
 
     /* initialize the on-screen display */
-    if (ConfigGetParamBool(g_CoreConfig, "OnScreenDisplay"))
+    if (ConfigParamBool(&l_OnScreenDisplay))
     {
         // init on-screen display
         int width = 640, height = 480;
@@ -808,6 +874,16 @@ m64p_error main_run(void)
         init_debugger();
 #endif
 
+    /* load the game's save media once; in-game saves are written back in the background */
+    sram_open();
+    flashram_open();
+    eeprom_open();
+    mempack_open();
+    savemedia_start();
+
+    rewind_open();
+    trace_update();
+
     /* Startup message on the OSD */
     osd_new_message(OSD_MIDDLE_CENTER, "Mupen64Plus Started...");
 
@@ -820,6 +896,13 @@ m64p_error main_run(void)
     r4300_execute();
 
     /* now begin to shut down */
+    if (l_BatchMode != 0)
+        pacer_report();
+    dma_report();
+    trace_close();
+    rewind_close();
+    savemedia_stop();
+
 #ifdef WITH_LIRC
     lircStop();
 #endif // WITH_LIRC
@@ -829,7 +912,7 @@ m64p_error main_run(void)
         destroy_debugger();
 #endif
 
-    if (ConfigGetParamBool(g_CoreConfig, "OnScreenDisplay"))
+    if (ConfigParamBool(&l_OnScreenDisplay))
     {
         osd_exit();
     }
@@ -30,6 +30,7 @@ extern m64p_handle g_CoreConfig;
 
 extern int g_MemHasBeenBSwapped;
 extern int g_EmulatorRunning;
+extern unsigned int g_ViCount;
 
 extern m64p_frame_callback g_FrameCallback;
 
@@ -40,6 +41,7 @@ const char* get_savesrampath(void);
 
 void new_frame(void);
 void new_vi(void);
+int  main_render_vi(void);
 
 int  main_set_core_defaults(void);
 void main_message(m64p_msg_level level, unsigned int osd_corner, const char *format, ...);
@@ -59,6 +61,7 @@ void main_state_set_slot(int slot);
 void main_state_inc_slot(void);
 void main_state_load(const char *filename);
 void main_state_save(int format, const char *filename);
+m64p_error main_rewind(void);
 
 m64p_error main_core_state_query(m64p_core_param param, int *rval);
 m64p_error main_core_state_set(m64p_core_param param, int val);
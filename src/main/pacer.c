@@ -0,0 +1,282 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - pacer.c                                                 *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Pacing of the emulation to the VI rate of the game.
+ *
+ * At each VI, pacer_new_vi() waits until the deadline of the VI, which moves
+ * by one VI period (at the selected speed) from the previous one.  The time
+ * is taken from a monotonic clock in nanoseconds.  The wait sleeps with
+ * SDL_Delay() until "FramePacerSpin" microseconds before the deadline, and
+ * yields for the rest of it, as the sleep of the OS may oversleep by a
+ * millisecond or more.  When the emulation falls behind by more than
+ * PACER_MAX_LAG VIs, as after a pause or a slow frame, the deadline is moved
+ * to the current time instead of running fast until it has caught up.
+ *
+ * With "FramePacerAudioSync", the deadline follows the audio given to the
+ * audio plugin instead: each AI_LEN write adds the duration of its samples,
+ * and the emulation waits while more than PACER_AUDIO_QUEUE VIs worth of
+ * them are left to play, as the plugin plays them at real time.  The VI
+ * deadline is used until the game starts its audio and while it stops
+ * giving any.
+ *
+ * The durations of the last PACER_FRAMES VIs are kept for the frame time
+ * statistics of main_core_state_query(), as well as the number of VIs per
+ * second, measured over a second and over the whole run.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <SDL.h>
+
+#define M64P_CORE_PROTOTYPES 1
+#include "api/m64p_types.h"
+#include "api/m64p_config.h"
+#include "api/callbacks.h"
+#include "api/config.h"
+#include "memory/memory.h"
+
+#include "pacer.h"
+#include "main.h"
+#include "rom.h"
+#include "trace.h"
+
+#define PACER_MAX_LAG 8
+#define PACER_AUDIO_QUEUE 2
+#define PACER_FRAMES 64 /* power of two */
+
+static long long int l_SpinTime = 0;
+static int l_AudioSync = 0;
+
+static long long int l_Deadline = 0;
+static long long int l_LastVI = 0;
+static int l_SpeedFactor = 100;
+
+static int l_AudioStarted = 0;
+static long long int l_AudioStart = 0;
+static long long int l_AudioTime = 0;
+
+/* in microseconds, read by the front-end thread, see pacer_frames() */
+static int l_FrameTimes[PACER_FRAMES];
+static unsigned int l_FrameIndex = 0;
+static unsigned int l_FrameCount = 0;
+
+static long long int l_RateStart = 0;
+static unsigned int l_RateVIs = 0;
+static int l_ViRate = 0;
+static long long int l_RunStart = 0;
+static unsigned int l_RunVIs = 0;
+
+#if defined(WIN32) && !defined(__MINGW32__)
+  #include <windows.h>
+  /* in nanoseconds */
+  static long long int pacer_time(void)
+  {
+      static LARGE_INTEGER freq = { 0 };
+      LARGE_INTEGER counter;
+      if (freq.QuadPart == 0)
+          QueryPerformanceFrequency(&freq);
+      QueryPerformanceCounter(&counter);
+      return counter.QuadPart / freq.QuadPart * 1000000000 +
+             counter.QuadPart % freq.QuadPart * 1000000000 / freq.QuadPart;
+  }
+#else
+  #include <time.h>
+  /* in nanoseconds */
+  static long long int pacer_time(void)
+  {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (long long int)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  }
+#endif
+
+static void pacer_wait(long long int deadline)
+{
+    long long int remaining = deadline - pacer_time();
+
+    if (remaining > l_SpinTime + 1000000)
+    {
+        DebugMessage(M64MSG_VERBOSE, "    new_vi(): Waiting %ims", (int) (remaining / 1000000));
+        SDL_Delay((Uint32) ((remaining - l_SpinTime) / 1000000));
+    }
+
+    while (pacer_time() < deadline)
+        SDL_Delay(0);
+}
+
+/* Global Functions */
+
+void pacer_init(void)
+{
+    int spin = ConfigGetParamInt(g_CoreConfig, "FramePacerSpin");
+
+    l_SpinTime = (spin > 0) ? (long long int) spin * 1000 : 0;
+    l_AudioSync = ConfigGetParamBool(g_CoreConfig, "FramePacerAudioSync");
+
+    l_Deadline = l_LastVI = 0;
+    l_SpeedFactor = 100;
+    l_AudioStarted = 0;
+    memset(l_FrameTimes, 0, sizeof(l_FrameTimes));
+    l_FrameIndex = l_FrameCount = 0;
+    l_RateVIs = l_RunVIs = 0;
+    l_ViRate = 0;
+}
+
+void pacer_new_vi(int vilimit, int speed_factor, int speed_limit)
+{
+    long long int period = 1000000000LL * 100 / ((long long int) vilimit * speed_factor);
+    long long int now = pacer_time();
+
+    l_SpeedFactor = speed_factor;
+
+    // if this is the first frame, start the deadlines from it
+    if (l_LastVI == 0)
+    {
+        l_Deadline = l_LastVI = l_RateStart = l_RunStart = now;
+        return;
+    }
+
+    l_Deadline += period;
+    if (l_AudioSync && l_AudioStarted)
+    {
+        long long int audio = l_AudioStart + l_AudioTime - PACER_AUDIO_QUEUE * period;
+        /* unless the game has stopped giving audio for a while */
+        if (now - audio <= PACER_MAX_LAG * period)
+            l_Deadline = audio;
+    }
+
+    if (!speed_limit || now - l_Deadline > PACER_MAX_LAG * period)
+        l_Deadline = now;
+    else if (now < l_Deadline)
+    {
+        trace_begin("new_vi.sleep");
+        pacer_wait(l_Deadline);
+        trace_end("new_vi.sleep");
+        now = pacer_time();
+    }
+
+    l_FrameTimes[l_FrameIndex] = (int) ((now - l_LastVI) / 1000);
+    l_FrameIndex = (l_FrameIndex + 1) & (PACER_FRAMES - 1);
+    if (l_FrameCount < PACER_FRAMES)
+        l_FrameCount++;
+    l_LastVI = now;
+
+    l_RunVIs++;
+    if (++l_RateVIs >= 4 && now - l_RateStart >= 1000000000)
+    {
+        l_ViRate = (int) ((l_RateVIs * 1000000000LL + (now - l_RateStart) / 2) / (now - l_RateStart));
+        l_RateStart = now;
+        l_RateVIs = 0;
+    }
+}
+
+/* called when the game gives AI_LEN bytes of samples to the audio plugin */
+void pacer_ai_len_changed(void)
+{
+    unsigned int freq = ROM_PARAMS.aidacrate / (ai_register.ai_dacrate + 1);
+    long long int now;
+
+    if (!l_AudioSync || freq == 0)
+        return;
+
+    now = pacer_time();
+    if (!l_AudioStarted)
+    {
+        l_AudioStart = now;
+        l_AudioTime = 0;
+        l_AudioStarted = 1;
+    }
+    /* once the plugin has played every sample, it starts again from now */
+    else if (l_AudioStart + l_AudioTime < now)
+        l_AudioStart = now - l_AudioTime;
+
+    /* 4 bytes per stereo sample, played faster at a higher speed */
+    l_AudioTime += (long long int) ai_register.ai_len * 1000000000 / (freq * 4) * 100 / l_SpeedFactor;
+}
+
+/* copies the durations of the last VIs, and returns how many of them are
+ * filled.  The copy is taken without a lock while the emulation thread goes
+ * on, so it is best-effort: it may already hold the duration of the next VI
+ * in place of the oldest one, which the statistics hardly see. */
+static int pacer_frames(int *times)
+{
+    int count = (int) l_FrameCount;
+
+    memcpy(times, l_FrameTimes, sizeof(l_FrameTimes));
+    return count;
+}
+
+static long long int pacer_frames_mean(const int *times, int count)
+{
+    long long int sum = 0;
+    int i;
+
+    for (i = 0; i < count; i++)
+        sum += times[i];
+
+    return sum / count;
+}
+
+/* mean duration of the last VIs, in microseconds */
+int pacer_frame_time(void)
+{
+    int times[PACER_FRAMES];
+    int count = pacer_frames(times);
+
+    if (count == 0)
+        return 0;
+
+    return (int) pacer_frames_mean(times, count);
+}
+
+/* standard deviation of the duration of the last VIs, in microseconds */
+int pacer_frame_jitter(void)
+{
+    int times[PACER_FRAMES];
+    int count = pacer_frames(times);
+    long long int mean, sum = 0;
+    int i;
+
+    if (count == 0)
+        return 0;
+
+    mean = pacer_frames_mean(times, count);
+    for (i = 0; i < count; i++)
+        sum += (times[i] - mean) * (times[i] - mean);
+
+    return (int) sqrt((double) (sum / count));
+}
+
+/* VIs per second over the last second */
+int pacer_vi_rate(void)
+{
+    return l_ViRate;
+}
+
+void pacer_report(void)
+{
+    long long int time = l_LastVI - l_RunStart;
+
+    if (l_RunVIs == 0 || time <= 0)
+        return;
+
+    DebugMessage(M64MSG_INFO, "Emulated %u VIs in %.2f s, %.1f VI/s", l_RunVIs, time / 1e9, l_RunVIs * 1e9 / time);
+}
@@ -26,9 +26,12 @@
 
 #include "api/m64p_types.h"
 #include "api/callbacks.h"
+#include "osal/preproc.h"
 
 static long long int time_in_section[NUM_TIMED_SECTIONS];
-static long long int last_start[NUM_TIMED_SECTIONS];
+/* the compiler section is also timed on the background compilation thread */
+static osal_thread_local long long int last_start[NUM_TIMED_SECTIONS];
+static long long int total_in_section[NUM_TIMED_SECTIONS];
 
 #if defined(WIN32) && !defined(__MINGW32__)
   // timing
@@ -71,6 +74,13 @@ void timed_section_end(enum timed_section section)
 {
    long long int end = get_time();
    time_in_section[section] += end - last_start[section];
+   total_in_section[section] += end - last_start[section];
+}
+
+// Total time (in ns) spent in a section since the core was loaded
+long long int timed_section_get_total(enum timed_section section)
+{
+   return time_to_nsec(total_in_section[section]);
 }
 
 void timed_sections_refresh()
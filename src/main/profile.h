@@ -38,6 +38,7 @@ enum timed_section
   void timed_section_start(enum timed_section section);
   void timed_section_end(enum timed_section section);
   void timed_sections_refresh(void);
+  long long int timed_section_get_total(enum timed_section section);
 #else
   #define timed_section_start(a)
   #define timed_section_end(a)
@@ -0,0 +1,416 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - rewind.c                                                *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* In-memory rewind buffer.
+ *
+ * Every RewindInterval VIs the emulation thread captures a raw state (see
+ * savestates_save_raw()).  The newest snapshot is kept uncompressed in the
+ * head buffer; older ones are stored as backward deltas in a fixed-size ring
+ * of RewindBufferSize megabytes.  A delta lists the 4 KB pages of the raw
+ * state which changed between two snapshots, XORed with each other and with
+ * the zero runs removed, and is then deflated.  All of this is done by the
+ * work queue, off the emulation thread.
+ *
+ * Stepping back loads the head, then applies the newest delta to it so that
+ * the next step goes one snapshot further back.  When the ring is full the
+ * oldest deltas are dropped.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <SDL_thread.h>
+
+#define M64P_CORE_PROTOTYPES 1
+#include "api/m64p_types.h"
+#include "api/m64p_config.h"
+#include "api/callbacks.h"
+#include "api/config.h"
+
+#include "rewind.h"
+#include "main.h"
+#include "savestates.h"
+#include "util.h"
+#include "workqueue.h"
+
+#include "osd/osd.h"
+
+#define REWIND_PAGE_SIZE 4096
+#define REWIND_PAGE_COUNT ((SAVESTATES_RAW_SIZE + REWIND_PAGE_SIZE - 1) / REWIND_PAGE_SIZE)
+#define REWIND_MAX_SNAPSHOTS 4096
+
+/* a literal run is only interrupted by at least this many zero bytes, so the
+   encoding of a page never grows by more than one token header */
+#define REWIND_MIN_ZERO_RUN 8
+
+/* worst case delta: every page with its index, a token header and an end marker */
+#define REWIND_ENCODE_SIZE (REWIND_PAGE_COUNT * (REWIND_PAGE_SIZE + 12) + 4)
+
+struct rewind_snapshot {
+    size_t offset;
+    size_t size;
+};
+
+static int l_Enabled = 0;
+static unsigned int l_Interval = 0;
+static unsigned int l_ViCounter = 0;
+static rewind_job l_Job = rewind_job_nothing;
+
+/* raw state of the newest snapshot */
+static unsigned char *l_Head = NULL;
+static int l_HaveHead = 0;
+/* state being captured; reused for the deflated delta once it is encoded */
+static unsigned char *l_Capture = NULL;
+static uLongf l_CaptureSize = 0;
+/* uncompressed delta */
+static unsigned char *l_Encode = NULL;
+
+static unsigned char *l_Ring = NULL;
+static size_t l_RingSize = 0;
+static size_t l_WritePos = 0;
+static struct rewind_snapshot l_Snapshots[REWIND_MAX_SNAPSHOTS];
+static unsigned int l_First = 0;
+static unsigned int l_Count = 0;
+
+static struct work_struct l_Work;
+static SDL_mutex *l_Lock = NULL;
+static SDL_cond *l_Idle = NULL;
+static int l_Busy = 0;
+
+static void rewind_wait_idle(void)
+{
+    SDL_LockMutex(l_Lock);
+    while (l_Busy)
+        SDL_CondWait(l_Idle, l_Lock);
+    SDL_UnlockMutex(l_Lock);
+}
+
+static void rewind_drop_oldest(void)
+{
+    l_First = (l_First + 1) % REWIND_MAX_SNAPSHOTS;
+    if (--l_Count == 0)
+        l_WritePos = 0;
+}
+
+static void rewind_drop_all(void)
+{
+    l_First = 0;
+    l_Count = 0;
+    l_WritePos = 0;
+}
+
+static void rewind_push(const unsigned char *data, size_t size)
+{
+    struct rewind_snapshot *snapshot;
+    size_t pos;
+
+    if (size > l_RingSize)
+    {
+        /* older deltas are useless once the chain from the head is broken */
+        DebugMessage(M64MSG_WARNING, "Rewind snapshot of %u bytes doesn't fit in the rewind buffer", (unsigned int) size);
+        rewind_drop_all();
+        return;
+    }
+
+    if (l_Count == REWIND_MAX_SNAPSHOTS)
+        rewind_drop_oldest();
+
+    /* snapshots are laid out in order, so the oldest ones are always right after the write position */
+    pos = l_WritePos;
+    if (pos + size > l_RingSize)
+    {
+        while (l_Count > 0 && l_Snapshots[l_First].offset >= l_WritePos)
+            rewind_drop_oldest();
+        pos = 0;
+    }
+    while (l_Count > 0 && l_Snapshots[l_First].offset >= pos && l_Snapshots[l_First].offset < pos + size)
+        rewind_drop_oldest();
+
+    snapshot = &l_Snapshots[(l_First + l_Count) % REWIND_MAX_SNAPSHOTS];
+    snapshot->offset = pos;
+    snapshot->size = size;
+    memcpy(l_Ring + pos, data, size);
+    l_WritePos = pos + size;
+    l_Count++;
+}
+
+static unsigned char *rewind_encode_page(unsigned char *out, const unsigned char *in, size_t len)
+{
+    size_t pos = 0, zeros, literals, run;
+    unsigned short header[2];
+
+    while (pos < len)
+    {
+        for (zeros = 0; pos + zeros < len && in[pos + zeros] == 0; zeros++);
+        pos += zeros;
+
+        literals = 0;
+        while (pos + literals < len)
+        {
+            for (run = 0; run < REWIND_MIN_ZERO_RUN && pos + literals + run < len && in[pos + literals + run] == 0; run++);
+            if (run == REWIND_MIN_ZERO_RUN)
+                break;
+            literals += (run > 0) ? run : 1;
+        }
+
+        header[0] = (unsigned short) zeros;
+        header[1] = (unsigned short) literals;
+        memcpy(out, header, 4);
+        memcpy(out + 4, in + pos, literals);
+        out += 4 + literals;
+        pos += literals;
+    }
+
+    return out;
+}
+
+static const unsigned char *rewind_apply_page(const unsigned char *in, unsigned char *dst, size_t len)
+{
+    size_t pos = 0, i;
+    unsigned short header[2];
+
+    while (pos < len)
+    {
+        memcpy(header, in, 4);
+        in += 4;
+        pos += header[0];
+        for (i = 0; i < header[1]; i++)
+            dst[pos + i] ^= in[i];
+        in += header[1];
+        pos += header[1];
+    }
+
+    return in;
+}
+
+static void rewind_encode_work(struct work_struct *work)
+{
+    unsigned char *out = l_Encode;
+    unsigned int page, i, end = 0xFFFFFFFF;
+    size_t offset, len;
+    uLongf size;
+
+    if (!l_HaveHead)
+    {
+        memcpy(l_Head, l_Capture, SAVESTATES_RAW_SIZE);
+        l_HaveHead = 1;
+    }
+    else
+    {
+        for (page = 0; page < REWIND_PAGE_COUNT; page++)
+        {
+            offset = (size_t) page * REWIND_PAGE_SIZE;
+            len = (SAVESTATES_RAW_SIZE - offset < REWIND_PAGE_SIZE) ? SAVESTATES_RAW_SIZE - offset : REWIND_PAGE_SIZE;
+            if (memcmp(l_Capture + offset, l_Head + offset, len) == 0)
+                continue;
+
+            /* the capture becomes the delta, and the head the captured state */
+            for (i = 0; i < len; i++)
+            {
+                l_Capture[offset + i] ^= l_Head[offset + i];
+                l_Head[offset + i] ^= l_Capture[offset + i];
+            }
+
+            memcpy(out, &page, 4);
+            out = rewind_encode_page(out + 4, l_Capture + offset, len);
+        }
+        memcpy(out, &end, 4);
+        out += 4;
+
+        size = l_CaptureSize;
+        if (compress2(l_Capture, &size, l_Encode, out - l_Encode, Z_BEST_SPEED) == Z_OK)
+            rewind_push(l_Capture, size);
+        else
+        {
+            DebugMessage(M64MSG_WARNING, "Couldn't compress rewind snapshot");
+            rewind_drop_all();
+        }
+    }
+
+    SDL_LockMutex(l_Lock);
+    l_Busy = 0;
+    SDL_CondSignal(l_Idle);
+    SDL_UnlockMutex(l_Lock);
+}
+
+int rewind_open(void)
+{
+    int size = ConfigGetParamInt(g_CoreConfig, "RewindBufferSize");
+    int interval = ConfigGetParamInt(g_CoreConfig, "RewindInterval");
+
+    l_Enabled = 0;
+    l_Job = rewind_job_nothing;
+    l_ViCounter = 0;
+    l_HaveHead = 0;
+    rewind_drop_all();
+
+    if (size <= 0)
+        return 1;
+
+    l_Interval = (interval > 0) ? interval : 1;
+    l_RingSize = (size_t) size * 1024 * 1024;
+    l_CaptureSize = compressBound(REWIND_ENCODE_SIZE);
+    if (l_CaptureSize < SAVESTATES_RAW_SIZE)
+        l_CaptureSize = SAVESTATES_RAW_SIZE;
+
+    l_Head = malloc(SAVESTATES_RAW_SIZE);
+    l_Capture = malloc(l_CaptureSize);
+    l_Encode = malloc(REWIND_ENCODE_SIZE);
+    l_Ring = malloc(l_RingSize);
+    l_Lock = SDL_CreateMutex();
+    l_Idle = SDL_CreateCond();
+    if (l_Head == NULL || l_Capture == NULL || l_Encode == NULL || l_Ring == NULL || l_Lock == NULL || l_Idle == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Couldn't allocate %i MB rewind buffer", size);
+        rewind_close();
+        return 0;
+    }
+
+    l_Busy = 0;
+    l_Enabled = 1;
+    DebugMessage(M64MSG_VERBOSE, "Rewind buffer of %i MB, snapshot every %u VIs", size, l_Interval);
+    return 1;
+}
+
+void rewind_close(void)
+{
+    if (l_Lock != NULL)
+        rewind_wait_idle();
+
+    free(l_Head);
+    free(l_Capture);
+    free(l_Encode);
+    free(l_Ring);
+    l_Head = l_Capture = l_Encode = l_Ring = NULL;
+    if (l_Idle != NULL)
+        SDL_DestroyCond(l_Idle);
+    if (l_Lock != NULL)
+        SDL_DestroyMutex(l_Lock);
+    l_Idle = NULL;
+    l_Lock = NULL;
+
+    l_Enabled = 0;
+    l_HaveHead = 0;
+    l_Job = rewind_job_nothing;
+    rewind_drop_all();
+}
+
+int rewind_enabled(void)
+{
+    return l_Enabled;
+}
+
+void rewind_new_vi(void)
+{
+    if (!l_Enabled)
+        return;
+
+    if (++l_ViCounter >= l_Interval)
+    {
+        l_ViCounter = 0;
+        if (l_Job == rewind_job_nothing)
+            l_Job = rewind_job_capture;
+    }
+}
+
+void rewind_request_step(void)
+{
+    if (l_Enabled)
+        l_Job = rewind_job_step;
+}
+
+rewind_job rewind_get_job(void)
+{
+    return l_Job;
+}
+
+void rewind_capture(void)
+{
+    int busy;
+
+    l_Job = rewind_job_nothing;
+
+    /* skip this snapshot if the previous one is still being encoded */
+    SDL_LockMutex(l_Lock);
+    busy = l_Busy;
+    l_Busy = 1;
+    SDL_UnlockMutex(l_Lock);
+    if (busy)
+        return;
+
+    savestates_save_raw(l_Capture);
+
+    init_work(&l_Work, rewind_encode_work);
+    queue_work(&l_Work);
+}
+
+int rewind_step(void)
+{
+    struct rewind_snapshot *snapshot;
+    const unsigned char *in;
+    unsigned int page;
+    size_t offset, len;
+    uLongf size;
+
+    l_Job = rewind_job_nothing;
+    rewind_wait_idle();
+
+    if (!l_HaveHead)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Nothing to rewind");
+        return 0;
+    }
+
+    /* the head must survive loading it */
+    memcpy(l_Capture, l_Head, SAVESTATES_RAW_SIZE);
+    savestates_load_raw(l_Capture);
+    l_ViCounter = 0;
+
+    if (l_Count > 0)
+    {
+        snapshot = &l_Snapshots[(l_First + l_Count - 1) % REWIND_MAX_SNAPSHOTS];
+        size = REWIND_ENCODE_SIZE;
+        if (uncompress(l_Encode, &size, l_Ring + snapshot->offset, snapshot->size) != Z_OK)
+        {
+            DebugMessage(M64MSG_ERROR, "Corrupted rewind snapshot");
+            rewind_drop_all();
+        }
+        else
+        {
+            in = l_Encode;
+            memcpy(&page, in, 4);
+            while (page != 0xFFFFFFFF)
+            {
+                offset = (size_t) page * REWIND_PAGE_SIZE;
+                len = (SAVESTATES_RAW_SIZE - offset < REWIND_PAGE_SIZE) ? SAVESTATES_RAW_SIZE - offset : REWIND_PAGE_SIZE;
+                in = rewind_apply_page(in + 4, l_Head + offset, len);
+                memcpy(&page, in, 4);
+            }
+
+            l_WritePos = snapshot->offset;
+            if (--l_Count == 0)
+                l_WritePos = 0;
+        }
+    }
+
+    main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Rewound (%u snapshots left)", l_Count);
+    return 1;
+}
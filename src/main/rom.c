@@ -25,6 +25,8 @@
 #include <string.h>
 #include <ctype.h>
 #include <stddef.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #define M64P_CORE_PROTOTYPES 1
 #include "api/m64p_types.h"
@@ -39,6 +41,7 @@
 
 #include "memory/memory.h"
 #include "r4300/r4300.h"
+#include "osal/files.h"
 #include "osal/preproc.h"
 #include "osd/osd.h"
 
@@ -46,9 +49,26 @@
 
 #define CHUNKSIZE 1024*128 /* Read files 128KB at a time. */
 
+#define MD5_CACHE_FILENAME "rommd5.cache"
+#define MD5_CACHE_MAX_ENTRIES 256 /* most recently hashed roms kept in the cache */
+
+#define ROMDB_INDEX_FILENAME "romdatabase.cache"
+#define ROMDB_INDEX_MAGIC 0x4244524D
+#define ROMDB_INDEX_VERSION 1
+#define ROMDB_NO_STRING 0xFFFFFFFF
+
+/* Image type whose layout matches the word order the core keeps the rom in. */
+#ifdef M64P_BIG_ENDIAN
+#define HOST_IMAGETYPE Z64IMAGE
+#else
+#define HOST_IMAGETYPE N64IMAGE
+#endif
+
 static romdatabase_entry* ini_search_by_md5(md5_byte_t* md5);
 
 static _romdatabase g_romdatabase;
+/* Set when g_romdatabase is borrowed from the core instance which created this one. */
+static int l_RomDatabaseShared = 0;
 
 /* Global loaded rom memory space. */
 unsigned char* rom = NULL;
@@ -57,6 +77,9 @@ int rom_size = 0;
 
 unsigned char isGoldeneyeRom = 0;
 
+/* Set when rom points into a read-only file mapping instead of a malloc'd buffer. */
+static int l_RomMapped = 0;
+
 m64p_rom_header   ROM_HEADER;
 rom_params        ROM_PARAMS;
 m64p_rom_settings ROM_SETTINGS;
@@ -81,19 +104,26 @@ static int is_valid_rom(const unsigned char *buffer)
         return 0;
 }
 
-/* If rom is a .v64 or .n64 image, byteswap or wordswap loadlength amount of
- * rom data to native .z64 before forwarding. Makes sure that data extraction
- * and MD5ing routines always deal with a .z64 image.
- */
-static void swap_rom(unsigned char* localrom, unsigned char* imagetype, int loadlength)
+/* Returns the image type of a valid rom from its first byte. */
+static unsigned char rom_image_type(const unsigned char *buffer)
+{
+    if (buffer[0] == 0x37)
+        return V64IMAGE;
+    else if (buffer[0] == 0x40)
+        return N64IMAGE;
+    else
+        return Z64IMAGE;
+}
+
+/* Byteswap or wordswap loadlength bytes of imagetype rom data to .z64 order. */
+static void swap_rom_data(unsigned char* localrom, unsigned char imagetype, int loadlength)
 {
     unsigned char temp;
     int i;
 
     /* Btyeswap if .v64 image. */
-    if(localrom[0]==0x37)
+    if(imagetype==V64IMAGE)
         {
-        *imagetype = V64IMAGE;
         for (i = 0; i < loadlength; i+=2)
             {
             temp=localrom[i];
@@ -102,9 +132,8 @@ static void swap_rom(unsigned char* localrom, unsigned char* imagetype, int load
             }
         }
     /* Wordswap if .n64 image. */
-    else if(localrom[0]==0x40)
+    else if(imagetype==N64IMAGE)
         {
-        *imagetype = N64IMAGE;
         for (i = 0; i < loadlength; i+=4)
             {
             temp=localrom[i];
@@ -115,18 +144,162 @@ static void swap_rom(unsigned char* localrom, unsigned char* imagetype, int load
             localrom[i+2]=temp;
             }
         }
-    else
-        *imagetype = Z64IMAGE;
 }
 
+/* If rom is a .v64 or .n64 image, byteswap or wordswap loadlength amount of
+ * rom data to native .z64 before forwarding. Makes sure that data extraction
+ * and MD5ing routines always deal with a .z64 image.
+ */
+static void swap_rom(unsigned char* localrom, unsigned char* imagetype, int loadlength)
+{
+    *imagetype = rom_image_type(localrom);
+    swap_rom_data(localrom, *imagetype, loadlength);
+}
+
+/* Converts length bytes of rom data between .z64 order and the host word
+ * order used by the memory subsystem (see init_memory). The conversion is
+ * its own inverse.
+ */
+static void swap_rom_host_order(void* data, int length)
+{
+    uint32_t* words = (uint32_t*) data;
+    int i;
+
+    for (i = 0; i < length / 4; i++)
+        words[i] = sl(words[i]);
+}
+
+/* MD5 hashes of rom files are cached in the user cache directory, keyed by
+ * path, file size and modification time, so that reopening a large image
+ * does not need to read it entirely before the game can start.
+ */
+static char* get_md5_cache_path(void)
+{
+    const char* cachepath = ConfigGetUserCachePath();
+
+    if (cachepath == NULL)
+        return NULL;
+    osal_mkdirp(cachepath, 0700);
+
+    return combinepath(cachepath, MD5_CACHE_FILENAME);
+}
+
+static int md5_cache_lookup(const char* filepath, const struct stat* fileinfo, md5_byte_t digest[16])
+{
+    char line[PATH_MAX + 128];
+    char md5[33];
+    long long size, mtime;
+    int found = 0, pathstart;
+    char* cachefile;
+    FILE* f;
+
+    cachefile = get_md5_cache_path();
+    if (cachefile == NULL)
+        return 0;
+    f = fopen(cachefile, "r");
+    free(cachefile);
+    if (f == NULL)
+        return 0;
+
+    while (!found && fgets(line, sizeof(line), f) != NULL)
+    {
+        if (sscanf(line, "%32s %lld %lld %n", md5, &size, &mtime, &pathstart) != 3)
+            continue;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (size == (long long) fileinfo->st_size && mtime == (long long) fileinfo->st_mtime &&
+            strcmp(line + pathstart, filepath) == 0)
+            found = parse_hex(md5, digest, 16);
+    }
+
+    fclose(f);
+    return found;
+}
+
+/* Rewrites the cache with the new entry last, after the most recent entries
+ * of the other paths, so that the stale entries of a path and the roms not
+ * opened in a long time don't pile up. */
+static void md5_cache_store(const char* filepath, const struct stat* fileinfo, const md5_byte_t digest[16])
+{
+    char line[PATH_MAX + 128];
+    char* kept[MD5_CACHE_MAX_ENTRIES - 1];
+    char md5[33];
+    long long size, mtime;
+    unsigned int i, count = 0, first = 0;
+    int pathstart;
+    size_t length;
+    char *cachefile, *entry, *data, *curr;
+    FILE* f;
+
+    cachefile = get_md5_cache_path();
+    if (cachefile == NULL)
+        return;
+
+    for (i = 0; i < 16; ++i)
+        sprintf(md5 + 2 * i, "%02X", digest[i]);
+    entry = formatstr("%s %lld %lld %s\n", md5, (long long) fileinfo->st_size, (long long) fileinfo->st_mtime, filepath);
+    if (entry == NULL)
+    {
+        free(cachefile);
+        return;
+    }
+
+    /* the entries are kept in a ring, the oldest ones are overwritten */
+    f = fopen(cachefile, "r");
+    if (f != NULL)
+    {
+        while (fgets(line, sizeof(line), f) != NULL)
+        {
+            if (sscanf(line, "%32s %lld %lld %n", md5, &size, &mtime, &pathstart) != 3)
+                continue;
+            line[strcspn(line, "\r\n")] = '\0';
+            if (strcmp(line + pathstart, filepath) == 0)
+                continue;
+            if (count < MD5_CACHE_MAX_ENTRIES - 1)
+                kept[count++] = strdup(line);
+            else
+            {
+                free(kept[first]);
+                kept[first] = strdup(line);
+                first = (first + 1) % (MD5_CACHE_MAX_ENTRIES - 1);
+            }
+        }
+        fclose(f);
+    }
+
+    length = strlen(entry);
+    for (i = 0; i < count; i++)
+    {
+        if (kept[i] != NULL)
+            length += strlen(kept[i]) + 1;
+    }
+
+    data = curr = (char*) malloc(length + 1);
+    if (data != NULL)
+    {
+        for (i = 0; i < count; i++)
+        {
+            const char* kept_entry = kept[(first + i) % (MD5_CACHE_MAX_ENTRIES - 1)];
+            if (kept_entry != NULL)
+                curr += sprintf(curr, "%s\n", kept_entry);
+        }
+        strcpy(curr, entry);
+        write_to_file_atomic(cachefile, data, length);
+        free(data);
+    }
+
+    for (i = 0; i < count; i++)
+        free(kept[i]);
+    free(entry);
+    free(cachefile);
+}
+
+static void finish_open_rom(const md5_byte_t digest[16], unsigned char imagetype);
+
 m64p_error open_rom(const unsigned char* romimage, unsigned int size)
 {
     md5_state_t state;
     md5_byte_t digest[16];
-    romdatabase_entry* entry;
-    char buffer[256];
     unsigned char imagetype;
-    int i;
 
     /* check input requirements */
     if (rom != NULL)
@@ -156,6 +329,146 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
     md5_init(&state);
     md5_append(&state, (const md5_byte_t*)rom, rom_size);
     md5_finish(&state, digest);
+
+    finish_open_rom(digest, imagetype);
+
+    return M64ERR_SUCCESS;
+}
+
+m64p_error open_rom_file(const char* filepath)
+{
+    struct stat fileinfo;
+    md5_state_t state;
+    md5_byte_t digest[16];
+    unsigned char* chunk;
+    unsigned char imagetype = Z64IMAGE;
+    int hashed, offset, length;
+    size_t mapsize;
+    FILE* f;
+
+    /* check input requirements */
+    if (rom != NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "open_rom_file(): previous ROM image was not freed");
+        return M64ERR_INTERNAL;
+    }
+    if (stat(filepath, &fileinfo) != 0)
+    {
+        DebugMessage(M64MSG_ERROR, "open_rom_file(): couldn't open ROM file '%s'", filepath);
+        return M64ERR_FILES;
+    }
+    if (fileinfo.st_size < 4096 || fileinfo.st_size > 0x4000000 || (fileinfo.st_size & 3) != 0)
+    {
+        DebugMessage(M64MSG_ERROR, "open_rom_file(): not a valid ROM image");
+        return M64ERR_INPUT_INVALID;
+    }
+
+    hashed = md5_cache_lookup(filepath, &fileinfo, digest);
+    if (!hashed)
+        md5_init(&state);
+
+    /* Images already laid out in host word order are used straight from the
+     * page cache, shared with any other process running the same rom. */
+    rom = (unsigned char *) osal_map_file(filepath, &mapsize);
+    if (rom != NULL && (mapsize != (size_t) fileinfo.st_size || !is_valid_rom(rom) ||
+                        rom_image_type(rom) != HOST_IMAGETYPE))
+    {
+        osal_unmap_file(rom, mapsize);
+        rom = NULL;
+    }
+
+    if (rom != NULL)
+    {
+        l_RomMapped = 1;
+        rom_size = (int) mapsize;
+        imagetype = HOST_IMAGETYPE;
+        DebugMessage(M64MSG_VERBOSE, "ROM file '%s' mapped read-only", filepath);
+
+        /* hash through a small bounce buffer, the mapping itself is read-only */
+        if (!hashed)
+        {
+            chunk = (unsigned char *) malloc(CHUNKSIZE);
+            if (chunk == NULL)
+            {
+                osal_unmap_file(rom, mapsize);
+                rom = NULL;
+                l_RomMapped = 0;
+                return M64ERR_NO_MEMORY;
+            }
+            for (offset = 0; offset < rom_size; offset += length)
+            {
+                length = (rom_size - offset < CHUNKSIZE) ? rom_size - offset : CHUNKSIZE;
+                memcpy(chunk, rom + offset, length);
+                swap_rom_data(chunk, imagetype, length);
+                md5_append(&state, (const md5_byte_t*)chunk, length);
+            }
+            free(chunk);
+        }
+    }
+    else
+    {
+        /* Otherwise read a private copy, converting it to host word order
+         * (and hashing it) one chunk at a time. */
+        f = fopen(filepath, "rb");
+        if (f == NULL)
+        {
+            DebugMessage(M64MSG_ERROR, "open_rom_file(): couldn't open ROM file '%s'", filepath);
+            return M64ERR_FILES;
+        }
+        rom_size = (int) fileinfo.st_size;
+        rom = (unsigned char *) malloc(rom_size);
+        if (rom == NULL)
+        {
+            fclose(f);
+            return M64ERR_NO_MEMORY;
+        }
+
+        for (offset = 0; offset < rom_size; offset += length)
+        {
+            length = (rom_size - offset < CHUNKSIZE) ? rom_size - offset : CHUNKSIZE;
+            if (fread(rom + offset, 1, length, f) != (size_t) length ||
+                (offset == 0 && !is_valid_rom(rom)))
+            {
+                DebugMessage(M64MSG_ERROR, "open_rom_file(): not a valid ROM image");
+                fclose(f);
+                free(rom);
+                rom = NULL;
+                return M64ERR_INPUT_INVALID;
+            }
+            if (offset == 0)
+                imagetype = rom_image_type(rom);
+
+            swap_rom_data(rom + offset, imagetype, length);
+            if (!hashed)
+                md5_append(&state, (const md5_byte_t*)(rom + offset), length);
+            swap_rom_host_order(rom + offset, length);
+        }
+        fclose(f);
+    }
+
+    /* The rom is already in host word order, so init_memory must leave it alone. */
+    g_MemHasBeenBSwapped = 1;
+
+    memcpy(&ROM_HEADER, rom, sizeof(m64p_rom_header));
+    swap_rom_host_order(&ROM_HEADER, sizeof(m64p_rom_header));
+
+    if (!hashed)
+    {
+        md5_finish(&state, digest);
+        md5_cache_store(filepath, &fileinfo, digest);
+    }
+
+    finish_open_rom(digest, imagetype);
+
+    return M64ERR_SUCCESS;
+}
+
+static void finish_open_rom(const md5_byte_t digest[16], unsigned char imagetype)
+{
+    romdatabase_entry* entry;
+    char buffer[256];
+    int i;
+
     for ( i = 0; i < 16; ++i )
         sprintf(buffer+i*2, "%02X", digest[i]);
     buffer[32] = '\0';
@@ -166,6 +479,7 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
     ROM_PARAMS.vilimit = rom_system_type_to_vi_limit(ROM_PARAMS.systemtype);
     ROM_PARAMS.aidacrate = rom_system_type_to_ai_dac_rate(ROM_PARAMS.systemtype);
     ROM_PARAMS.countperop = COUNT_PER_OP_DEFAULT;
+    ROM_PARAMS.idleloops = 1;
     ROM_PARAMS.cheats = NULL;
 
     memcpy(ROM_PARAMS.headername, ROM_HEADER.Name, 20);
@@ -173,7 +487,7 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
     trim(ROM_PARAMS.headername); /* Remove trailing whitespace from ROM name. */
 
     /* Look up this ROM in the .ini file and fill in goodname, etc */
-    if ((entry=ini_search_by_md5(digest)) != NULL ||
+    if ((entry=ini_search_by_md5((md5_byte_t*)digest)) != NULL ||
         (entry=ini_search_by_crc(sl(ROM_HEADER.CRC1),sl(ROM_HEADER.CRC2))) != NULL)
     {
         strncpy(ROM_SETTINGS.goodname, entry->goodname, 255);
@@ -183,6 +497,7 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
         ROM_SETTINGS.players = entry->players;
         ROM_SETTINGS.rumble = entry->rumble;
         ROM_PARAMS.countperop = entry->countperop;
+        ROM_PARAMS.idleloops = entry->idleloops;
         ROM_PARAMS.cheats = entry->cheats;
     }
     else
@@ -194,6 +509,7 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
         ROM_SETTINGS.players = 0;
         ROM_SETTINGS.rumble = 0;
         ROM_PARAMS.countperop = COUNT_PER_OP_DEFAULT;
+        ROM_PARAMS.idleloops = 1;
         ROM_PARAMS.cheats = NULL;
     }
 
@@ -221,8 +537,6 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
     isGoldeneyeRom = 0;
     if(strcmp(ROM_PARAMS.headername, "GOLDENEYE") == 0)
        isGoldeneyeRom = 1;
-
-    return M64ERR_SUCCESS;
 }
 
 m64p_error close_rom(void)
@@ -230,8 +544,12 @@ m64p_error close_rom(void)
     if (rom == NULL)
         return M64ERR_INVALID_STATE;
 
-    free(rom);
+    if (l_RomMapped)
+        osal_unmap_file(rom, rom_size);
+    else
+        free(rom);
     rom = NULL;
+    l_RomMapped = 0;
 
     /* Clear Byte-swapped flag, since ROM is now deleted. */
     g_MemHasBeenBSwapped = 0;
@@ -298,6 +616,87 @@ static int rom_system_type_to_ai_dac_rate(m64p_system_type system_type)
     }
 }
 
+/********************************************************************************************/
+/* INI Rom database functions */
+
+/* The rom database is parsed from mupen64plus.ini only when the ini has
+ * changed.  The parsed entries are then compiled into a binary index which is
+ * kept in the user cache directory and mapped read-only on the next starts:
+ *
+ *   romdatabase_index_header
+ *   romdatabase_index_entry[entry_count]   sorted by MD5
+ *   romdatabase_index_crc[crc_count]       sorted by CRC1, CRC2
+ *   string pool                            goodnames and cheats, each stored once
+ *
+ * The index is in the byte order of the host and records the size,
+ * modification time and MD5 of the ini it was built from; an index which
+ * doesn't match the ini is rebuilt.  A lookup is a binary search in the index.
+ */
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    int64_t ini_size;
+    int64_t ini_mtime;
+    md5_byte_t ini_md5[16];
+    uint32_t index_size;
+    uint32_t entry_count;
+    uint32_t crc_count;
+    uint32_t strings_size;
+} romdatabase_index_header;
+
+typedef struct
+{
+    md5_byte_t md5[16];
+    uint32_t goodname; /* offsets in the string pool */
+    uint32_t cheats;
+    uint32_t crc1;
+    uint32_t crc2;
+    uint32_t set_flags;
+    unsigned char status;
+    unsigned char savetype;
+    unsigned char players;
+    unsigned char rumble;
+    unsigned char countperop;
+    unsigned char idleloops;
+    unsigned char padding[2];
+} romdatabase_index_entry;
+
+typedef struct
+{
+    uint32_t crc1;
+    uint32_t crc2;
+    uint32_t entry;
+} romdatabase_index_crc;
+
+/* Entries of mupen64plus.ini while the index is built. */
+typedef struct _romdatabase_search
+{
+    romdatabase_entry entry;
+    unsigned int order; /* position in the ini */
+    unsigned int position; /* in the MD5 table of the index */
+    int has_crc; /* the CRC is given by the entry itself, not by its RefMD5 */
+    struct _romdatabase_search* next_entry;
+    struct _romdatabase_search* next_md5;
+} romdatabase_search;
+
+static romdatabase_search* l_ParsedList = NULL;
+static romdatabase_search* l_ParsedMd5[256];
+
+/* Returned by the lookups, its strings point into the index. */
+static romdatabase_entry l_SearchResult;
+
+static romdatabase_entry* romdatabase_find_parsed(const md5_byte_t* md5)
+{
+    romdatabase_search* search = l_ParsedMd5[md5[0]];
+
+    while (search != NULL && memcmp(search->entry.md5, md5, 16) != 0)
+        search = search->next_md5;
+
+    return search != NULL ? &search->entry : NULL;
+}
+
 static size_t romdatabase_resolve_round(void)
 {
     romdatabase_search *entry;
@@ -305,11 +704,11 @@ static size_t romdatabase_resolve_round(void)
     size_t skipped = 0;
 
     /* Resolve RefMD5 references */
-    for (entry = g_romdatabase.list; entry; entry = entry->next_entry) {
+    for (entry = l_ParsedList; entry; entry = entry->next_entry) {
         if (!entry->entry.refmd5)
             continue;
 
-        ref = ini_search_by_md5(entry->entry.refmd5);
+        ref = romdatabase_find_parsed(entry->entry.refmd5);
         if (!ref) {
             DebugMessage(M64MSG_WARNING, "ROM Database: Error solving RefMD5s");
             continue;
@@ -365,6 +764,12 @@ static size_t romdatabase_resolve_round(void)
             entry->entry.set_flags |= ROMDATABASE_ENTRY_COUNTEROP;
         }
 
+        if (!isset_bitmask(entry->entry.set_flags, ROMDATABASE_ENTRY_IDLELOOPS) &&
+            isset_bitmask(ref->set_flags, ROMDATABASE_ENTRY_IDLELOOPS)) {
+            entry->entry.idleloops = ref->idleloops;
+            entry->entry.set_flags |= ROMDATABASE_ENTRY_IDLELOOPS;
+        }
+
         if (!isset_bitmask(entry->entry.set_flags, ROMDATABASE_ENTRY_CHEATS) &&
             isset_bitmask(ref->set_flags, ROMDATABASE_ENTRY_CHEATS)) {
             if (ref->cheats)
@@ -394,10 +799,7 @@ static void romdatabase_resolve(void)
     } while (skipped > 0);
 }
 
-/********************************************************************************************/
-/* INI Rom database functions */
-
-void romdatabase_open(void)
+static int romdatabase_parse(const char* pathname)
 {
     FILE *fPtr;
     char buffer[256];
@@ -405,29 +807,19 @@ void romdatabase_open(void)
     romdatabase_search** next_search;
 
     int counter, value, lineno;
+    unsigned int order = 0;
     unsigned char index;
-    const char *pathname = ConfigGetSharedDataFilepath("mupen64plus.ini");
-
-    if(g_romdatabase.have_database)
-        return;
 
     /* Open romdatabase. */
-    if (pathname == NULL || (fPtr = fopen(pathname, "rb")) == NULL)
-    {
-        DebugMessage(M64MSG_ERROR, "Unable to open rom database file '%s'.", pathname);
-        return;
-    }
-
-    g_romdatabase.have_database = 1;
+    if ((fPtr = fopen(pathname, "rb")) == NULL)
+        return 0;
 
     /* Clear premade indices. */
-    for(counter = 0; counter < 255; ++counter)
-        g_romdatabase.crc_lists[counter] = NULL;
-    for(counter = 0; counter < 255; ++counter)
-        g_romdatabase.md5_lists[counter] = NULL;
-    g_romdatabase.list = NULL;
+    for(counter = 0; counter < 256; ++counter)
+        l_ParsedMd5[counter] = NULL;
+    l_ParsedList = NULL;
 
-    next_search = &g_romdatabase.list;
+    next_search = &l_ParsedList;
 
     /* Parse ROM database file */
     for (lineno = 1; fgets(buffer, 255, fPtr) != NULL; lineno++)
@@ -460,15 +852,17 @@ void romdatabase_open(void)
             search->entry.players = DEFAULT;
             search->entry.rumble = DEFAULT; 
             search->entry.countperop = COUNT_PER_OP_DEFAULT;
+            search->entry.idleloops = 1;
             search->entry.cheats = NULL;
             search->entry.set_flags = ROMDATABASE_ENTRY_NONE;
 
+            search->order = order++;
+            search->has_crc = 0;
             search->next_entry = NULL;
-            search->next_crc = NULL;
             /* Index MD5s by first 8 bits. */
             index = search->entry.md5[0];
-            search->next_md5 = g_romdatabase.md5_lists[index];
-            g_romdatabase.md5_lists[index] = search;
+            search->next_md5 = l_ParsedMd5[index];
+            l_ParsedMd5[index] = search;
 
             break;
         }
@@ -491,10 +885,7 @@ void romdatabase_open(void)
                 if (sscanf(l.value, "%X %X%c", &search->entry.crc1,
                     &search->entry.crc2, &garbage_sweeper) == 2)
                 {
-                    /* Index CRCs by first 8 bits. */
-                    index = search->entry.crc1 >> 24;
-                    search->next_crc = g_romdatabase.crc_lists[index];
-                    g_romdatabase.crc_lists[index] = search;
+                    search->has_crc = 1;
                     search->entry.set_flags |= ROMDATABASE_ENTRY_CRC;
                 }
                 else
@@ -577,6 +968,18 @@ void romdatabase_open(void)
                     DebugMessage(M64MSG_WARNING, "ROM Database: Invalid CountPerOp on line %i", lineno);
                 }
             }
+            else if(!strcmp(l.name, "IdleLoops"))
+            {
+                if(!strcmp(l.value, "Yes")) {
+                    search->entry.idleloops = 1;
+                    search->entry.set_flags |= ROMDATABASE_ENTRY_IDLELOOPS;
+                } else if(!strcmp(l.value, "No")) {
+                    search->entry.idleloops = 0;
+                    search->entry.set_flags |= ROMDATABASE_ENTRY_IDLELOOPS;
+                } else {
+                    DebugMessage(M64MSG_WARNING, "ROM Database: Invalid IdleLoops string on line %i", lineno);
+                }
+            }
             else if(!strncmp(l.name, "Cheat", 5))
             {
                 size_t len1 = 0, len2 = 0;
@@ -617,8 +1020,361 @@ void romdatabase_open(void)
         }
     }
 
+
     fclose(fPtr);
     romdatabase_resolve();
+    return 1;
+}
+
+static void romdatabase_free_parsed(void)
+{
+    while (l_ParsedList != NULL)
+    {
+        romdatabase_search* search = l_ParsedList->next_entry;
+        free(l_ParsedList->entry.goodname);
+        free(l_ParsedList->entry.refmd5);
+        free(l_ParsedList->entry.cheats);
+        free(l_ParsedList);
+        l_ParsedList = search;
+    }
+}
+
+static char* get_romdatabase_index_path(void)
+{
+    const char* cachepath = ConfigGetUserCachePath();
+
+    if (cachepath == NULL)
+        return NULL;
+    osal_mkdirp(cachepath, 0700);
+
+    return combinepath(cachepath, ROMDB_INDEX_FILENAME);
+}
+
+static int romdatabase_hash_ini(const char* pathname, md5_byte_t digest[16])
+{
+    md5_state_t state;
+    unsigned char* chunk;
+    size_t length;
+    FILE* f;
+
+    f = fopen(pathname, "rb");
+    if (f == NULL)
+        return 0;
+    chunk = (unsigned char*) malloc(CHUNKSIZE);
+    if (chunk == NULL)
+    {
+        fclose(f);
+        return 0;
+    }
+
+    md5_init(&state);
+    while ((length = fread(chunk, 1, CHUNKSIZE, f)) > 0)
+        md5_append(&state, (const md5_byte_t*) chunk, (int) length);
+    md5_finish(&state, digest);
+
+    free(chunk);
+    fclose(f);
+    return 1;
+}
+
+static const romdatabase_index_header* romdatabase_index(void)
+{
+    return (const romdatabase_index_header*) g_romdatabase.index;
+}
+
+static const romdatabase_index_entry* romdatabase_index_entries(const romdatabase_index_header* header)
+{
+    return (const romdatabase_index_entry*) (header + 1);
+}
+
+static const romdatabase_index_crc* romdatabase_index_crcs(const romdatabase_index_header* header)
+{
+    return (const romdatabase_index_crc*) (romdatabase_index_entries(header) + header->entry_count);
+}
+
+static const char* romdatabase_index_strings(const romdatabase_index_header* header)
+{
+    return (const char*) (romdatabase_index_crcs(header) + header->crc_count);
+}
+
+/* Checks that the index is consistent and has been built from the ini. */
+static int romdatabase_check_index(const void* index, size_t size, const struct stat* iniinfo, const md5_byte_t ini_md5[16])
+{
+    const romdatabase_index_header* header = (const romdatabase_index_header*) index;
+    const romdatabase_index_entry* entries;
+    const romdatabase_index_crc* crcs;
+    uint32_t i;
+
+    if (size < sizeof(romdatabase_index_header) ||
+        header->magic != ROMDB_INDEX_MAGIC || header->version != ROMDB_INDEX_VERSION ||
+        header->ini_size != (int64_t) iniinfo->st_size || header->ini_mtime != (int64_t) iniinfo->st_mtime ||
+        memcmp(header->ini_md5, ini_md5, 16) != 0 || header->index_size != size)
+        return 0;
+
+    if (header->entry_count > size / sizeof(romdatabase_index_entry) ||
+        header->crc_count > size / sizeof(romdatabase_index_crc) ||
+        sizeof(romdatabase_index_header) + header->entry_count * sizeof(romdatabase_index_entry) +
+        header->crc_count * sizeof(romdatabase_index_crc) + header->strings_size != size ||
+        header->strings_size == 0 || romdatabase_index_strings(header)[header->strings_size - 1] != '\0')
+        return 0;
+
+    entries = romdatabase_index_entries(header);
+    for (i = 0; i < header->entry_count; ++i)
+    {
+        if ((entries[i].goodname != ROMDB_NO_STRING && entries[i].goodname >= header->strings_size) ||
+            (entries[i].cheats != ROMDB_NO_STRING && entries[i].cheats >= header->strings_size))
+            return 0;
+    }
+    crcs = romdatabase_index_crcs(header);
+    for (i = 0; i < header->crc_count; ++i)
+    {
+        if (crcs[i].entry >= header->entry_count)
+            return 0;
+    }
+
+    return 1;
+}
+
+static int romdatabase_map_index(const char* indexpath, const struct stat* iniinfo, const md5_byte_t ini_md5[16])
+{
+    size_t size;
+    void* index = osal_map_file(indexpath, &size);
+
+    if (index == NULL)
+        return 0;
+    if (!romdatabase_check_index(index, size, iniinfo, ini_md5))
+    {
+        osal_unmap_file(index, size);
+        return 0;
+    }
+
+    g_romdatabase.index = index;
+    g_romdatabase.index_size = size;
+    g_romdatabase.index_mapped = 1;
+    return 1;
+}
+
+/* String pool of the index being built, each string is stored once. */
+typedef struct
+{
+    char* data;
+    uint32_t size;
+    uint32_t capacity;
+    uint32_t* slots; /* open addressing hash table of offsets + 1 */
+    uint32_t slot_mask;
+} romdatabase_strings;
+
+static uint32_t romdatabase_intern(romdatabase_strings* pool, const char* string)
+{
+    uint32_t hash = 0, slot, length;
+    const char* c;
+
+    if (string == NULL)
+        return ROMDB_NO_STRING;
+
+    for (c = string; *c != '\0'; ++c)
+        hash = hash * 31 + (unsigned char) *c;
+    length = (uint32_t) (c - string) + 1;
+
+    for (slot = hash & pool->slot_mask; pool->slots[slot] != 0; slot = (slot + 1) & pool->slot_mask)
+    {
+        if (strcmp(pool->data + pool->slots[slot] - 1, string) == 0)
+            return pool->slots[slot] - 1;
+    }
+
+    if (pool->size + length > pool->capacity)
+    {
+        uint32_t capacity = 2 * pool->capacity + length;
+        char* data = (char*) realloc(pool->data, capacity);
+        if (data == NULL)
+            return ROMDB_NO_STRING;
+        pool->data = data;
+        pool->capacity = capacity;
+    }
+
+    memcpy(pool->data + pool->size, string, length);
+    pool->slots[slot] = pool->size + 1;
+    pool->size += length;
+    return pool->slots[slot] - 1;
+}
+
+/* later entries of the ini take precedence, as the ini is read in order */
+static int romdatabase_compare_md5(const void* a, const void* b)
+{
+    const romdatabase_search* x = *(const romdatabase_search* const*) a;
+    const romdatabase_search* y = *(const romdatabase_search* const*) b;
+    int order = memcmp(x->entry.md5, y->entry.md5, 16);
+
+    if (order != 0)
+        return order;
+    return x->order < y->order ? 1 : -1;
+}
+
+static int romdatabase_compare_crc(const void* a, const void* b)
+{
+    const romdatabase_search* x = *(const romdatabase_search* const*) a;
+    const romdatabase_search* y = *(const romdatabase_search* const*) b;
+
+    if (x->entry.crc1 != y->entry.crc1)
+        return x->entry.crc1 < y->entry.crc1 ? -1 : 1;
+    if (x->entry.crc2 != y->entry.crc2)
+        return x->entry.crc2 < y->entry.crc2 ? -1 : 1;
+    return x->order < y->order ? 1 : -1;
+}
+
+/* Compiles the parsed entries into a malloc'd index, see above. */
+static int romdatabase_build_index(const struct stat* iniinfo, const md5_byte_t ini_md5[16])
+{
+    romdatabase_search** sorted = NULL;
+    romdatabase_search** with_crc = NULL;
+    romdatabase_search* search;
+    romdatabase_strings pool;
+    romdatabase_index_header header;
+    romdatabase_index_entry* entries = NULL;
+    romdatabase_index_crc* crcs = NULL;
+    unsigned char* index = NULL;
+    uint32_t count = 0, entry_count = 0, crc_count = 0, i, slots;
+    size_t size;
+
+    memset(&pool, 0, sizeof(pool));
+
+    for (search = l_ParsedList; search != NULL; search = search->next_entry)
+        count++;
+    for (slots = 64; slots < 4 * count; slots *= 2)
+        ;
+
+    sorted = (romdatabase_search**) malloc((count + 1) * sizeof(romdatabase_search*));
+    with_crc = (romdatabase_search**) malloc((count + 1) * sizeof(romdatabase_search*));
+    entries = (romdatabase_index_entry*) malloc((count + 1) * sizeof(romdatabase_index_entry));
+    crcs = (romdatabase_index_crc*) malloc((count + 1) * sizeof(romdatabase_index_crc));
+    pool.slots = (uint32_t*) calloc(slots, sizeof(uint32_t));
+    pool.slot_mask = slots - 1;
+    if (sorted == NULL || with_crc == NULL || entries == NULL || crcs == NULL || pool.slots == NULL)
+        goto out;
+
+    /* the MD5 table, without the entries overridden by a later one */
+    i = 0;
+    for (search = l_ParsedList; search != NULL; search = search->next_entry)
+        sorted[i++] = search;
+    qsort(sorted, count, sizeof(romdatabase_search*), romdatabase_compare_md5);
+
+    for (i = 0; i < count; ++i)
+    {
+        romdatabase_index_entry* entry = &entries[entry_count];
+
+        search = sorted[i];
+        if (i > 0 && memcmp(sorted[i - 1]->entry.md5, search->entry.md5, 16) == 0)
+            continue;
+
+        memset(entry, 0, sizeof(romdatabase_index_entry));
+        memcpy(entry->md5, search->entry.md5, 16);
+        entry->goodname = romdatabase_intern(&pool, search->entry.goodname);
+        entry->cheats = romdatabase_intern(&pool, search->entry.cheats);
+        if ((search->entry.goodname != NULL && entry->goodname == ROMDB_NO_STRING) ||
+            (search->entry.cheats != NULL && entry->cheats == ROMDB_NO_STRING))
+            goto out;
+        entry->crc1 = search->entry.crc1;
+        entry->crc2 = search->entry.crc2;
+        entry->set_flags = search->entry.set_flags;
+        entry->status = search->entry.status;
+        entry->savetype = search->entry.savetype;
+        entry->players = search->entry.players;
+        entry->rumble = search->entry.rumble;
+        entry->countperop = search->entry.countperop;
+        entry->idleloops = search->entry.idleloops;
+
+        search->position = entry_count++;
+        if (search->has_crc)
+            with_crc[crc_count++] = search;
+    }
+
+    /* the CRC table, only with the entries giving their own CRC */
+    qsort(with_crc, crc_count, sizeof(romdatabase_search*), romdatabase_compare_crc);
+    for (i = 0; i < crc_count; ++i)
+    {
+        crcs[i].crc1 = with_crc[i]->entry.crc1;
+        crcs[i].crc2 = with_crc[i]->entry.crc2;
+        crcs[i].entry = with_crc[i]->position;
+    }
+
+    /* the pool always holds at least the terminating empty string */
+    if (romdatabase_intern(&pool, "") == ROMDB_NO_STRING)
+        goto out;
+
+    size = sizeof(header) + entry_count * sizeof(romdatabase_index_entry) +
+           crc_count * sizeof(romdatabase_index_crc) + pool.size;
+    index = (unsigned char*) malloc(size);
+    if (index == NULL)
+        goto out;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = ROMDB_INDEX_MAGIC;
+    header.version = ROMDB_INDEX_VERSION;
+    header.ini_size = (int64_t) iniinfo->st_size;
+    header.ini_mtime = (int64_t) iniinfo->st_mtime;
+    memcpy(header.ini_md5, ini_md5, 16);
+    header.index_size = (uint32_t) size;
+    header.entry_count = entry_count;
+    header.crc_count = crc_count;
+    header.strings_size = pool.size;
+
+    memcpy(index, &header, sizeof(header));
+    memcpy(index + sizeof(header), entries, entry_count * sizeof(romdatabase_index_entry));
+    memcpy(index + sizeof(header) + entry_count * sizeof(romdatabase_index_entry), crcs, crc_count * sizeof(romdatabase_index_crc));
+    memcpy(index + size - pool.size, pool.data, pool.size);
+
+    g_romdatabase.index = index;
+    g_romdatabase.index_size = size;
+    g_romdatabase.index_mapped = 0;
+
+out:
+    free(sorted);
+    free(with_crc);
+    free(entries);
+    free(crcs);
+    free(pool.slots);
+    free(pool.data);
+    return g_romdatabase.index != NULL;
+}
+
+void romdatabase_open(void)
+{
+    const char *pathname = ConfigGetSharedDataFilepath("mupen64plus.ini");
+    struct stat fileinfo;
+    md5_byte_t md5[16];
+    char* indexpath;
+
+    if(g_romdatabase.have_database)
+        return;
+
+    if (pathname == NULL || stat(pathname, &fileinfo) != 0 || !romdatabase_hash_ini(pathname, md5))
+    {
+        DebugMessage(M64MSG_ERROR, "Unable to open rom database file '%s'.", pathname);
+        return;
+    }
+
+    indexpath = get_romdatabase_index_path();
+    if (indexpath != NULL && romdatabase_map_index(indexpath, &fileinfo, md5))
+    {
+        free(indexpath);
+        g_romdatabase.have_database = 1;
+        return;
+    }
+
+    /* the ini has changed, or this is the first start */
+    if (!romdatabase_parse(pathname))
+        DebugMessage(M64MSG_ERROR, "Unable to open rom database file '%s'.", pathname);
+    else if (!romdatabase_build_index(&fileinfo, md5))
+        DebugMessage(M64MSG_ERROR, "ROM Database: Couldn't build the index");
+    else
+    {
+        g_romdatabase.have_database = 1;
+        if (indexpath != NULL && write_to_file_atomic(indexpath, g_romdatabase.index, g_romdatabase.index_size) != file_ok)
+            DebugMessage(M64MSG_WARNING, "ROM Database: Couldn't write the index to '%s'", indexpath);
+    }
+
+    romdatabase_free_parsed();
+    free(indexpath);
 }
 
 void romdatabase_close(void)
@@ -626,53 +1382,111 @@ void romdatabase_close(void)
     if (!g_romdatabase.have_database)
         return;
 
-    while (g_romdatabase.list != NULL)
-        {
-        romdatabase_search* search = g_romdatabase.list->next_entry;
-        if(g_romdatabase.list->entry.goodname)
-            free(g_romdatabase.list->entry.goodname);
-        if(g_romdatabase.list->entry.refmd5)
-            free(g_romdatabase.list->entry.refmd5);
-        free(g_romdatabase.list->entry.cheats);
-        free(g_romdatabase.list);
-        g_romdatabase.list = search;
-        }
+    /* the index belongs to the instance we borrowed it from */
+    if (!l_RomDatabaseShared)
+    {
+        if (g_romdatabase.index_mapped)
+            osal_unmap_file((void*) g_romdatabase.index, g_romdatabase.index_size);
+        else
+            free((void*) g_romdatabase.index);
+    }
+
+    memset(&g_romdatabase, 0, sizeof(g_romdatabase));
+    l_RomDatabaseShared = 0;
 }
 
-static romdatabase_entry* ini_search_by_md5(md5_byte_t* md5)
+const _romdatabase* romdatabase_get(void)
 {
-    romdatabase_search* search;
+    return g_romdatabase.have_database ? &g_romdatabase : NULL;
+}
 
-    if(!g_romdatabase.have_database)
-        return NULL;
+void romdatabase_share(const _romdatabase* database)
+{
+    if (database == NULL || g_romdatabase.have_database)
+        return;
+
+    /* The database is never modified once loaded, so another core instance of the
+     * same process can read it concurrently instead of parsing its own copy. */
+    g_romdatabase = *database;
+    l_RomDatabaseShared = 1;
+}
 
-    search = g_romdatabase.md5_lists[md5[0]];
+static romdatabase_entry* romdatabase_search_result(const romdatabase_index_header* header, const romdatabase_index_entry* entry)
+{
+    const char* strings = romdatabase_index_strings(header);
+
+    memset(&l_SearchResult, 0, sizeof(l_SearchResult));
+    memcpy(l_SearchResult.md5, entry->md5, 16);
+    /* the strings stay in the read-only index */
+    l_SearchResult.goodname = entry->goodname != ROMDB_NO_STRING ? (char*) strings + entry->goodname : NULL;
+    l_SearchResult.cheats = entry->cheats != ROMDB_NO_STRING ? (char*) strings + entry->cheats : NULL;
+    l_SearchResult.crc1 = entry->crc1;
+    l_SearchResult.crc2 = entry->crc2;
+    l_SearchResult.status = entry->status;
+    l_SearchResult.savetype = entry->savetype;
+    l_SearchResult.players = entry->players;
+    l_SearchResult.rumble = entry->rumble;
+    l_SearchResult.countperop = entry->countperop;
+    l_SearchResult.idleloops = entry->idleloops;
+    l_SearchResult.set_flags = entry->set_flags;
+
+    return &l_SearchResult;
+}
 
-    while (search != NULL && memcmp(search->entry.md5, md5, 16) != 0)
-        search = search->next_md5;
+static romdatabase_entry* ini_search_by_md5(md5_byte_t* md5)
+{
+    const romdatabase_index_header* header = romdatabase_index();
+    const romdatabase_index_entry* entries;
+    uint32_t low, high;
 
-    if(search==NULL)
+    if(!g_romdatabase.have_database)
         return NULL;
 
-    return &(search->entry);
+    entries = romdatabase_index_entries(header);
+    low = 0;
+    high = header->entry_count;
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        int order = memcmp(entries[middle].md5, md5, 16);
+
+        if (order == 0)
+            return romdatabase_search_result(header, &entries[middle]);
+        if (order < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return NULL;
 }
 
 romdatabase_entry* ini_search_by_crc(unsigned int crc1, unsigned int crc2)
 {
-    romdatabase_search* search;
+    const romdatabase_index_header* header = romdatabase_index();
+    const romdatabase_index_crc* crcs;
+    uint32_t low, high;
 
     if(!g_romdatabase.have_database) 
         return NULL;
 
-    search = g_romdatabase.crc_lists[((crc1 >> 24) & 0xff)];
+    /* the first of the entries with these CRCs */
+    crcs = romdatabase_index_crcs(header);
+    low = 0;
+    high = header->crc_count;
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
 
-    while (search != NULL && search->entry.crc1 != crc1 && search->entry.crc2 != crc2)
-        search = search->next_crc;
+        if (crcs[middle].crc1 < crc1 || (crcs[middle].crc1 == crc1 && crcs[middle].crc2 < crc2))
+            low = middle + 1;
+        else
+            high = middle;
+    }
 
-    if(search == NULL) 
+    if (low == header->crc_count || crcs[low].crc1 != crc1 || crcs[low].crc2 != crc2)
         return NULL;
 
-    return &(search->entry);
+    return romdatabase_search_result(header, romdatabase_index_entries(header) + crcs[low].entry);
 }
 
-
@@ -25,6 +25,7 @@
 
 #include "api/m64p_types.h"
 #include "md5.h"
+#include <stddef.h>
 #include <stdint.h>
 
 #define BIT(bitnr) (1ULL << (bitnr))
@@ -38,6 +39,7 @@
 /* ROM Loading and Saving functions */
 
 m64p_error open_rom(const unsigned char* romimage, unsigned int size);
+m64p_error open_rom_file(const char* filepath);
 m64p_error close_rom(void);
 
 extern unsigned char* rom;
@@ -53,6 +55,7 @@ typedef struct _rom_params
    int aidacrate;
    char headername[21];  /* ROM Name as in the header, removing trailing whitespace */
    unsigned char countperop;
+   unsigned char idleloops; /* 0 - No, 1 - Yes boolean for the idle loop detection. */
 } rom_params;
 
 extern m64p_rom_header   ROM_HEADER;
@@ -124,6 +127,7 @@ typedef struct
    unsigned char players; /* Local players 0-4, 2/3/4 way Netplay indicated by 5/6/7. */
    unsigned char rumble; /* 0 - No, 1 - Yes boolean for rumble support. */
    unsigned char countperop;
+   unsigned char idleloops; /* 0 - No, 1 - Yes boolean for the idle loop detection. */
    uint32_t set_flags;
 } romdatabase_entry;
 
@@ -136,27 +140,22 @@ enum romdatabase_entry_set_flags {
     ROMDATABASE_ENTRY_PLAYERS = BIT(4),
     ROMDATABASE_ENTRY_RUMBLE = BIT(5),
     ROMDATABASE_ENTRY_COUNTEROP = BIT(6),
-    ROMDATABASE_ENTRY_CHEATS = BIT(7)
+    ROMDATABASE_ENTRY_CHEATS = BIT(7),
+    ROMDATABASE_ENTRY_IDLELOOPS = BIT(8)
 };
 
-typedef struct _romdatabase_search
-{
-    romdatabase_entry entry;
-    struct _romdatabase_search* next_entry;
-    struct _romdatabase_search* next_crc;
-    struct _romdatabase_search* next_md5;
-} romdatabase_search;
-
 typedef struct
 {
     int have_database;
-    romdatabase_search* crc_lists[256];
-    romdatabase_search* md5_lists[256];
-    romdatabase_search* list;
+    const void* index; /* binary index of the database, see romdatabase_open() */
+    size_t index_size;
+    int index_mapped; /* from the user cache directory, otherwise malloc'd */
 } _romdatabase;
 
 void romdatabase_open(void);
 void romdatabase_close(void);
+const _romdatabase* romdatabase_get(void);
+void romdatabase_share(const _romdatabase* database);
 /* Should be used by current cheat system (isn't), when cheat system is
  * migrated to md5s, will be fully depreciated.
  */
@@ -0,0 +1,267 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - savemedia.c                                             *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include <SDL_thread.h>
+
+#include "api/m64p_types.h"
+#include "api/callbacks.h"
+
+#include "savemedia.h"
+#include "main.h"
+#include "rom.h"
+#include "util.h"
+
+/* delay between two write-backs of the dirty media by the background flusher */
+#define SAVEMEDIA_FLUSH_INTERVAL 1000
+
+static LIST_HEAD(l_MediaList);
+
+/* protects the media list, the dirty ranges and the flusher state */
+static SDL_mutex *l_MediaLock = NULL;
+/* serializes the disk writes, so that they never block the emulation thread */
+static SDL_mutex *l_FlushLock = NULL;
+
+#ifdef M64P_PARALLEL
+static SDL_Thread *l_FlusherThread = NULL;
+static SDL_cond *l_FlusherWake = NULL;
+static int l_FlusherStop = 0;
+#endif
+
+static void savemedia_write_file(struct save_media *media)
+{
+    switch (write_to_file_atomic(media->filepath, media->shadow, media->size))
+    {
+        case file_open_error:
+            DebugMessage(M64MSG_WARNING, "couldn't open %s file '%s' for writing", media->name, media->filepath);
+            break;
+        case file_write_error:
+            DebugMessage(M64MSG_WARNING, "couldn't write %u bytes to %s file '%s'", (unsigned int) media->size, media->name, media->filepath);
+            break;
+        default:
+            DebugMessage(M64MSG_VERBOSE, "%s written back to '%s'", media->name, media->filepath);
+            break;
+    }
+}
+
+static void savemedia_flush(struct save_media *media)
+{
+    int dirty;
+
+    SDL_LockMutex(l_FlushLock);
+
+    /* take a snapshot of the dirty range only, the rest of the shadow copy
+     * already matches. A write racing with this copy marks its range dirty
+     * again afterwards, so a torn copy is always followed by another flush. */
+    SDL_LockMutex(l_MediaLock);
+    dirty = (media->dirty_end > media->dirty_start);
+    if (dirty)
+    {
+        memcpy(media->shadow + media->dirty_start,
+               media->data + media->dirty_start,
+               media->dirty_end - media->dirty_start);
+        media->dirty_start = media->size;
+        media->dirty_end = 0;
+    }
+    SDL_UnlockMutex(l_MediaLock);
+
+    if (dirty)
+        savemedia_write_file(media);
+
+    SDL_UnlockMutex(l_FlushLock);
+}
+
+void savemedia_open(struct save_media *media)
+{
+    media->filepath = formatstr("%s%s.%s", get_savesrampath(), ROM_SETTINGS.goodname, media->extension);
+
+    media->format();
+    if (media->filepath != NULL)
+    {
+        switch (read_from_file(media->filepath, media->data, media->size))
+        {
+            case file_open_error:
+                DebugMessage(M64MSG_VERBOSE, "couldn't open %s file '%s' for reading", media->name, media->filepath);
+                media->format();
+                break;
+            case file_read_error:
+                DebugMessage(M64MSG_WARNING, "couldn't read %u bytes from %s file '%s'", (unsigned int) media->size, media->name, media->filepath);
+                break;
+            default: break;
+        }
+    }
+
+    media->shadow = malloc(media->size);
+    if (media->filepath == NULL || media->shadow == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Insufficient memory to keep %s contents, changes won't be saved", media->name);
+        free(media->filepath);
+        free(media->shadow);
+        media->filepath = NULL;
+        media->shadow = NULL;
+        return;
+    }
+    memcpy(media->shadow, media->data, media->size);
+    media->dirty_start = media->size;
+    media->dirty_end = 0;
+
+    SDL_LockMutex(l_MediaLock);
+    list_add_tail(&media->list, &l_MediaList);
+    SDL_UnlockMutex(l_MediaLock);
+}
+
+void savemedia_mark_dirty(struct save_media *media, size_t offset, size_t length)
+{
+    /* callers address the data with S8 byte swizzling, so widen the range
+     * to whole 32-bit words */
+    size_t start = offset & ~(size_t)3;
+    size_t end = (offset + length + 3) & ~(size_t)3;
+
+    if (media->shadow == NULL)
+        return;
+    if (end > media->size)
+        end = media->size;
+    if (start >= end)
+        return;
+
+    SDL_LockMutex(l_MediaLock);
+    if (start < media->dirty_start)
+        media->dirty_start = start;
+    if (end > media->dirty_end)
+        media->dirty_end = end;
+    SDL_UnlockMutex(l_MediaLock);
+
+#ifndef M64P_PARALLEL
+    /* without a background flusher, write through */
+    savemedia_flush(media);
+#endif
+}
+
+void savemedia_flush_all(void)
+{
+    struct save_media *media;
+
+    if (l_MediaLock == NULL)
+        return;
+
+    /* the media list only changes on the emulation thread, while the flusher is stopped */
+    list_for_each_entry_t(media, &l_MediaList, struct save_media, list) {
+        savemedia_flush(media);
+    }
+}
+
+#ifdef M64P_PARALLEL
+static int savemedia_flusher_handler(void *data)
+{
+    SDL_LockMutex(l_MediaLock);
+    while (!l_FlusherStop) {
+        SDL_CondWaitTimeout(l_FlusherWake, l_MediaLock, SAVEMEDIA_FLUSH_INTERVAL);
+        if (l_FlusherStop)
+            break;
+
+        SDL_UnlockMutex(l_MediaLock);
+        savemedia_flush_all();
+        SDL_LockMutex(l_MediaLock);
+    }
+    SDL_UnlockMutex(l_MediaLock);
+
+    return 0;
+}
+#endif
+
+int savemedia_start(void)
+{
+#ifdef M64P_PARALLEL
+    l_FlusherStop = 0;
+#if SDL_VERSION_ATLEAST(2,0,0)
+    l_FlusherThread = SDL_CreateThread(savemedia_flusher_handler, "m64psavemedia", NULL);
+#else
+    l_FlusherThread = SDL_CreateThread(savemedia_flusher_handler, NULL);
+#endif
+    if (!l_FlusherThread) {
+        DebugMessage(M64MSG_WARNING, "Could not create save media flusher thread, save data will be written at exit only");
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+void savemedia_stop(void)
+{
+    struct save_media *media, *safe;
+
+#ifdef M64P_PARALLEL
+    if (l_FlusherThread) {
+        int status;
+
+        SDL_LockMutex(l_MediaLock);
+        l_FlusherStop = 1;
+        SDL_CondSignal(l_FlusherWake);
+        SDL_UnlockMutex(l_MediaLock);
+
+        SDL_WaitThread(l_FlusherThread, &status);
+        l_FlusherThread = NULL;
+    }
+#endif
+
+    savemedia_flush_all();
+
+    list_for_each_entry_safe_t(media, safe, &l_MediaList, struct save_media, list) {
+        list_del_init(&media->list);
+        free(media->filepath);
+        free(media->shadow);
+        media->filepath = NULL;
+        media->shadow = NULL;
+    }
+}
+
+void savemedia_init(void)
+{
+    l_MediaLock = SDL_CreateMutex();
+    l_FlushLock = SDL_CreateMutex();
+    if (!l_MediaLock || !l_FlushLock) {
+        DebugMessage(M64MSG_ERROR, "Could not create save media locks");
+        return;
+    }
+
+#ifdef M64P_PARALLEL
+    l_FlusherWake = SDL_CreateCond();
+    if (!l_FlusherWake) {
+        DebugMessage(M64MSG_ERROR, "Could not create save media flusher condition");
+        return;
+    }
+#endif
+}
+
+void savemedia_deinit(void)
+{
+#ifdef M64P_PARALLEL
+    SDL_DestroyCond(l_FlusherWake);
+    l_FlusherWake = NULL;
+#endif
+    SDL_DestroyMutex(l_FlushLock);
+    SDL_DestroyMutex(l_MediaLock);
+    l_FlushLock = NULL;
+    l_MediaLock = NULL;
+}
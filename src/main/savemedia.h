@@ -0,0 +1,69 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - savemedia.h                                             *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __SAVEMEDIA_H__
+#define __SAVEMEDIA_H__
+
+#include <stddef.h>
+
+#include "list.h"
+
+/* A save media is a cartridge or controller pak backup memory (SRAM, EEPROM,
+ * FlashRAM, mempak) which is persisted in the SaveSRAMPath directory.
+ * The image is read from disk once when the ROM is opened, then all accesses
+ * are served from memory. Writes only mark the touched range as dirty; the
+ * dirty data is written back by a background flusher. */
+struct save_media {
+    const char *name;       /* for messages, eg "sram" */
+    const char *extension;  /* file extension, eg "sra" */
+    unsigned char *data;
+    size_t size;
+    void (*format)(void);   /* fill data with the contents of a blank media */
+
+    /* private to savemedia.c */
+    char *filepath;
+    unsigned char *shadow;  /* last contents handed to the disk */
+    size_t dirty_start;
+    size_t dirty_end;
+    struct list_head list;
+};
+
+void savemedia_init(void);
+void savemedia_deinit(void);
+
+/* Loads the media image from disk (or formats it if there is no file yet)
+ * and registers it for write-back. */
+void savemedia_open(struct save_media *media);
+
+/* Marks 'length' bytes starting at 'offset' as modified. Must be called after
+ * the data has been written to media->data. */
+void savemedia_mark_dirty(struct save_media *media, size_t offset, size_t length);
+
+/* Writes all dirty media to disk now. Safe to call from any thread. */
+void savemedia_flush_all(void);
+
+/* Starts the background flusher for the media opened so far. */
+int savemedia_start(void);
+
+/* Stops the background flusher, flushes and unregisters all media. */
+void savemedia_stop(void);
+
+#endif
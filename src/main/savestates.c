@@ -25,6 +25,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <SDL_thread.h>
+#if !defined(WIN32) || defined(__MINGW32__)
+#include <unistd.h>
+#endif
 
 #define M64P_CORE_PROTOTYPES 1
 #include "api/m64p_types.h"
@@ -35,6 +38,8 @@
 #include "savestates.h"
 #include "main.h"
 #include "rom.h"
+#include "savemedia.h"
+#include "trace.h"
 #include "util.h"
 #include "workqueue.h"
 
@@ -46,6 +51,7 @@
 #include "r4300/r4300.h"
 #include "r4300/cached_interp.h"
 #include "r4300/interupt.h"
+#include "osal/files.h"
 #include "osal/preproc.h"
 #include "osd/osd.h"
 #include "r4300/new_dynarec/new_dynarec.h"
@@ -59,7 +65,7 @@
 #endif
 
 static const char* savestate_magic = "M64+SAVE";
-static const int savestate_latest_version = 0x00010000;  /* 1.0 */
+static const int savestate_latest_version = 0x00010100;  /* 1.1 */
 static const unsigned char pj64_magic[4] = { 0xC8, 0xA6, 0xD8, 0x23 };
 
 static savestates_job job = savestates_job_nothing;
@@ -71,11 +77,19 @@ static int autoinc_save_slot = 0;
 
 static SDL_mutex *savestates_lock;
 
+/* the saves are written in the order they were made by a single work item,
+   which drains this list, so they never hold more than one work queue thread */
+static LIST_HEAD(savestates_pending);
+static int savestates_writing = 0;
+static struct work_struct savestates_writer;
+
 struct savestate_work {
     char *filepath;
     char *data;
     size_t size;
-    struct work_struct work;
+    int level;
+    unsigned char header[44];
+    struct list_head list;
 };
 
 /* Returns the malloc'd full path of the currently selected savestate. */
@@ -185,91 +199,11 @@ static void savestates_clear_job(void)
 #define PUTDATA(buff, type, value) \
     do { type x = value; PUTARRAY(&x, buff, type, 1); } while(0)
 
-static int savestates_load_m64p(char *filepath)
+static void savestates_parse_m64p(unsigned char *curr, char *queue)
 {
-    unsigned char header[44];
-    gzFile f;
-    int version;
+    const unsigned int *lut_r, *lut_w;
     int i;
 
-    size_t savestateSize;
-    unsigned char *savestateData, *curr;
-    char queue[1024];
-
-    SDL_LockMutex(savestates_lock);
-
-    f = gzopen(filepath, "rb");
-    if(f==NULL)
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not open state file: %s", filepath);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
-
-    /* Read and check Mupen64Plus magic number. */
-    if (gzread(f, header, 44) != 44)
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read header from state file %s", filepath);
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
-    curr = header;
-
-    if(strncmp((char *)curr, savestate_magic, 8)!=0)
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State file: %s is not a valid Mupen64plus savestate.", filepath);
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
-    curr += 8;
-
-    version = *curr++;
-    version = (version << 8) | *curr++;
-    version = (version << 8) | *curr++;
-    version = (version << 8) | *curr++;
-    if(version != 0x00010000)
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State version (%08x) isn't compatible. Please update Mupen64Plus.", version);
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
-
-    if(memcmp((char *)curr, ROM_SETTINGS.MD5, 32))
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State ROM MD5 does not match current ROM.");
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
-    curr += 32;
-
-    /* Read the rest of the savestate */
-    savestateSize = 16788244;
-    savestateData = curr = (unsigned char *)malloc(savestateSize);
-    if (savestateData == NULL)
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Insufficient memory to load state.");
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
-    if (gzread(f, savestateData, savestateSize) != savestateSize ||
-        (gzread(f, queue, sizeof(queue)) % 4) != 0)
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate data from %s", filepath);
-        free(savestateData);
-        gzclose(f);
-        SDL_UnlockMutex(savestates_lock);
-        return 0;
-    }
-
-    gzclose(f);
-    SDL_UnlockMutex(savestates_lock);
-
-    // Parse savestate
     rdram_register.rdram_config = GETDATA(curr, unsigned int);
     rdram_register.rdram_device_id = GETDATA(curr, unsigned int);
     rdram_register.rdram_delay = GETDATA(curr, unsigned int);
@@ -389,8 +323,9 @@ static int savestates_load_m64p(char *filepath)
     flashram_info.erase_offset = GETDATA(curr, unsigned int);
     flashram_info.write_pointer = GETDATA(curr, unsigned int);
 
-    COPYARRAY(tlb_LUT_r, curr, unsigned int, 0x100000);
-    COPYARRAY(tlb_LUT_w, curr, unsigned int, 0x100000);
+    lut_r = GETARRAY(curr, unsigned int, 0x100000);
+    lut_w = GETARRAY(curr, unsigned int, 0x100000);
+    tlb_LUT_load(lut_r, lut_w);
 
     llbit = GETDATA(curr, unsigned int);
     COPYARRAY(reg, curr, long long int, 32);
@@ -403,6 +338,7 @@ static int savestates_load_m64p(char *filepath)
         shuffle_fpr_data(0x04000000, 0);
     FCR0 = GETDATA(curr, int);
     FCR31 = GETDATA(curr, int);
+    update_rounding_mxcsr();
 
     for (i = 0; i < 32; i++)
     {
@@ -457,19 +393,714 @@ static int savestates_load_m64p(char *filepath)
     next_vi = GETDATA(curr, unsigned int);
     vi_field = GETDATA(curr, unsigned int);
 
-    // assert(savestateData+savestateSize == curr)
+    to_little_endian_buffer(queue, 4, 256);
+    load_eventqueue_infos(queue);
+
+#ifdef NEW_DYNAREC
+    if (r4300emu == CORE_DYNAREC)
+        last_addr = pcaddr;
+    else
+        last_addr = PC->addr;
+#else
+    last_addr = PC->addr;
+#endif
+}
+
+static char *savestates_fill_m64p(char *curr)
+{
+    int i;
+
+    PUTDATA(curr, unsigned int, rdram_register.rdram_config);
+    PUTDATA(curr, unsigned int, rdram_register.rdram_device_id);
+    PUTDATA(curr, unsigned int, rdram_register.rdram_delay);
+    PUTDATA(curr, unsigned int, rdram_register.rdram_mode);
+    PUTDATA(curr, unsigned int, rdram_register.rdram_ref_interval);
+    PUTDATA(curr, unsigned int, rdram_register.rdram_ref_row);
+    PUTDATA(curr, unsigned int, rdram_register.rdram_ras_interval);
+    PUTDATA(curr, unsigned int, rdram_register.rdram_min_interval);
+    PUTDATA(curr, unsigned int, rdram_register.rdram_addr_select);
+    PUTDATA(curr, unsigned int, rdram_register.rdram_device_manuf);
+
+    PUTDATA(curr, unsigned int, MI_register.w_mi_init_mode_reg);
+    PUTDATA(curr, unsigned int, MI_register.mi_init_mode_reg);
+    PUTDATA(curr, unsigned char, MI_register.mi_init_mode_reg & 0x7F);
+    PUTDATA(curr, unsigned char, (MI_register.mi_init_mode_reg & 0x80) != 0);
+    PUTDATA(curr, unsigned char, (MI_register.mi_init_mode_reg & 0x100) != 0);
+    PUTDATA(curr, unsigned char, (MI_register.mi_init_mode_reg & 0x200) != 0);
+    PUTDATA(curr, unsigned int, MI_register.mi_version_reg);
+    PUTDATA(curr, unsigned int, MI_register.mi_intr_reg);
+    PUTDATA(curr, unsigned int, MI_register.mi_intr_mask_reg);
+    PUTDATA(curr, unsigned int, MI_register.w_mi_intr_mask_reg);
+    PUTDATA(curr, unsigned char, (MI_register.mi_intr_mask_reg & 0x1) != 0);
+    PUTDATA(curr, unsigned char, (MI_register.mi_intr_mask_reg & 0x2) != 0);
+    PUTDATA(curr, unsigned char, (MI_register.mi_intr_mask_reg & 0x4) != 0);
+    PUTDATA(curr, unsigned char, (MI_register.mi_intr_mask_reg & 0x8) != 0);
+    PUTDATA(curr, unsigned char, (MI_register.mi_intr_mask_reg & 0x10) != 0);
+    PUTDATA(curr, unsigned char, (MI_register.mi_intr_mask_reg & 0x20) != 0);
+    PUTDATA(curr, unsigned short, 0); // Padding from old implementation
+
+    PUTDATA(curr, unsigned int, pi_register.pi_dram_addr_reg);
+    PUTDATA(curr, unsigned int, pi_register.pi_cart_addr_reg);
+    PUTDATA(curr, unsigned int, pi_register.pi_rd_len_reg);
+    PUTDATA(curr, unsigned int, pi_register.pi_wr_len_reg);
+    PUTDATA(curr, unsigned int, pi_register.read_pi_status_reg);
+    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom1_lat_reg);
+    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom1_pwd_reg);
+    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom1_pgs_reg);
+    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom1_rls_reg);
+    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom2_lat_reg);
+    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom2_pwd_reg);
+    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom2_pgs_reg);
+    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom2_rls_reg);
+
+    PUTDATA(curr, unsigned int, sp_register.sp_mem_addr_reg);
+    PUTDATA(curr, unsigned int, sp_register.sp_dram_addr_reg);
+    PUTDATA(curr, unsigned int, sp_register.sp_rd_len_reg);
+    PUTDATA(curr, unsigned int, sp_register.sp_wr_len_reg);
+    PUTDATA(curr, unsigned int, sp_register.w_sp_status_reg);
+    PUTDATA(curr, unsigned int, sp_register.sp_status_reg);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x1) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x2) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x4) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x8) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x10) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x20) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x40) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x80) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x100) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x200) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x400) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x800) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x1000) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x2000) != 0);
+    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x4000) != 0);
+    PUTDATA(curr, unsigned char, 0);
+    PUTDATA(curr, unsigned int, sp_register.sp_dma_full_reg);
+    PUTDATA(curr, unsigned int, sp_register.sp_dma_busy_reg);
+    PUTDATA(curr, unsigned int, sp_register.sp_semaphore_reg);
+
+    PUTDATA(curr, unsigned int, rsp_register.rsp_pc);
+    PUTDATA(curr, unsigned int, rsp_register.rsp_ibist);
+
+    PUTDATA(curr, unsigned int, si_register.si_dram_addr);
+    PUTDATA(curr, unsigned int, si_register.si_pif_addr_rd64b);
+    PUTDATA(curr, unsigned int, si_register.si_pif_addr_wr64b);
+    PUTDATA(curr, unsigned int, si_register.si_stat);
+
+    PUTDATA(curr, unsigned int, vi_register.vi_status);
+    PUTDATA(curr, unsigned int, vi_register.vi_origin);
+    PUTDATA(curr, unsigned int, vi_register.vi_width);
+    PUTDATA(curr, unsigned int, vi_register.vi_v_intr);
+    PUTDATA(curr, unsigned int, vi_register.vi_current);
+    PUTDATA(curr, unsigned int, vi_register.vi_burst);
+    PUTDATA(curr, unsigned int, vi_register.vi_v_sync);
+    PUTDATA(curr, unsigned int, vi_register.vi_h_sync);
+    PUTDATA(curr, unsigned int, vi_register.vi_leap);
+    PUTDATA(curr, unsigned int, vi_register.vi_h_start);
+    PUTDATA(curr, unsigned int, vi_register.vi_v_start);
+    PUTDATA(curr, unsigned int, vi_register.vi_v_burst);
+    PUTDATA(curr, unsigned int, vi_register.vi_x_scale);
+    PUTDATA(curr, unsigned int, vi_register.vi_y_scale);
+    PUTDATA(curr, unsigned int, vi_register.vi_delay);
+
+    PUTDATA(curr, unsigned int, ri_register.ri_mode);
+    PUTDATA(curr, unsigned int, ri_register.ri_config);
+    PUTDATA(curr, unsigned int, ri_register.ri_current_load);
+    PUTDATA(curr, unsigned int, ri_register.ri_select);
+    PUTDATA(curr, unsigned int, ri_register.ri_refresh);
+    PUTDATA(curr, unsigned int, ri_register.ri_latency);
+    PUTDATA(curr, unsigned int, ri_register.ri_error);
+    PUTDATA(curr, unsigned int, ri_register.ri_werror);
+
+    PUTDATA(curr, unsigned int, ai_register.ai_dram_addr);
+    PUTDATA(curr, unsigned int, ai_register.ai_len);
+    PUTDATA(curr, unsigned int, ai_register.ai_control);
+    PUTDATA(curr, unsigned int, ai_register.ai_status);
+    PUTDATA(curr, unsigned int, ai_register.ai_dacrate);
+    PUTDATA(curr, unsigned int, ai_register.ai_bitrate);
+    PUTDATA(curr, unsigned int, ai_register.next_delay);
+    PUTDATA(curr, unsigned int, ai_register.next_len);
+    PUTDATA(curr, unsigned int, ai_register.current_delay);
+    PUTDATA(curr, unsigned int, ai_register.current_len);
+
+    PUTDATA(curr, unsigned int, dpc_register.dpc_start);
+    PUTDATA(curr, unsigned int, dpc_register.dpc_end);
+    PUTDATA(curr, unsigned int, dpc_register.dpc_current);
+    PUTDATA(curr, unsigned int, dpc_register.w_dpc_status);
+    PUTDATA(curr, unsigned int, dpc_register.dpc_status);
+    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x1) != 0);
+    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x2) != 0);
+    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x4) != 0);
+    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x8) != 0);
+    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x10) != 0);
+    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x20) != 0);
+    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x40) != 0);
+    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x80) != 0);
+    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x100) != 0);
+    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x200) != 0);
+    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x400) != 0);
+    PUTDATA(curr, unsigned char, 0);
+    PUTDATA(curr, unsigned int, dpc_register.dpc_clock);
+    PUTDATA(curr, unsigned int, dpc_register.dpc_bufbusy);
+    PUTDATA(curr, unsigned int, dpc_register.dpc_pipebusy);
+    PUTDATA(curr, unsigned int, dpc_register.dpc_tmem);
+
+    PUTDATA(curr, unsigned int, dps_register.dps_tbist);
+    PUTDATA(curr, unsigned int, dps_register.dps_test_mode);
+    PUTDATA(curr, unsigned int, dps_register.dps_buftest_addr);
+    PUTDATA(curr, unsigned int, dps_register.dps_buftest_data);
+
+    PUTARRAY(rdram, curr, unsigned int, 0x800000/4);
+    PUTARRAY(SP_DMEM, curr, unsigned int, 0x1000/4);
+    PUTARRAY(SP_IMEM, curr, unsigned int, 0x1000/4);
+    PUTARRAY(PIF_RAM, curr, unsigned char, 0x40);
+
+    PUTDATA(curr, int, flashram_info.use_flashram);
+    PUTDATA(curr, int, flashram_info.mode);
+    PUTDATA(curr, unsigned long long, flashram_info.status);
+    PUTDATA(curr, unsigned int, flashram_info.erase_offset);
+    PUTDATA(curr, unsigned int, flashram_info.write_pointer);
+
+    tlb_LUT_save((unsigned int *) curr, (unsigned int *) (curr + 0x400000));
+    to_little_endian_buffer(curr, sizeof(unsigned int), 0x200000);
+    curr += 0x800000;
+
+    PUTDATA(curr, unsigned int, llbit);
+    PUTARRAY(reg, curr, long long int, 32);
+    PUTARRAY(g_cp0_regs, curr, unsigned int, CP0_REGS_COUNT);
+    PUTDATA(curr, long long int, lo);
+    PUTDATA(curr, long long int, hi);
+
+    if ((g_cp0_regs[CP0_STATUS_REG] & 0x04000000) == 0) // FR bit == 0 means 32-bit (MIPS I) FGR mode
+        shuffle_fpr_data(0, 0x04000000);  // shuffle data into 64-bit register format for storage
+    PUTARRAY(reg_cop1_fgr_64, curr, long long int, 32);
+    if ((g_cp0_regs[CP0_STATUS_REG] & 0x04000000) == 0)
+        shuffle_fpr_data(0x04000000, 0);  // put it back in 32-bit mode
+
+    PUTDATA(curr, int, FCR0);
+    PUTDATA(curr, int, FCR31);
+    for (i = 0; i < 32; i++)
+    {
+        PUTDATA(curr, short, tlb_e[i].mask);
+        PUTDATA(curr, short, 0);
+        PUTDATA(curr, int, tlb_e[i].vpn2);
+        PUTDATA(curr, char, tlb_e[i].g);
+        PUTDATA(curr, unsigned char, tlb_e[i].asid);
+        PUTDATA(curr, short, 0);
+        PUTDATA(curr, int, tlb_e[i].pfn_even);
+        PUTDATA(curr, char, tlb_e[i].c_even);
+        PUTDATA(curr, char, tlb_e[i].d_even);
+        PUTDATA(curr, char, tlb_e[i].v_even);
+        PUTDATA(curr, char, 0);
+        PUTDATA(curr, int, tlb_e[i].pfn_odd);
+        PUTDATA(curr, char, tlb_e[i].c_odd);
+        PUTDATA(curr, char, tlb_e[i].d_odd);
+        PUTDATA(curr, char, tlb_e[i].v_odd);
+        PUTDATA(curr, char, tlb_e[i].r);
+   
+        PUTDATA(curr, unsigned int, tlb_e[i].start_even);
+        PUTDATA(curr, unsigned int, tlb_e[i].end_even);
+        PUTDATA(curr, unsigned int, tlb_e[i].phys_even);
+        PUTDATA(curr, unsigned int, tlb_e[i].start_odd);
+        PUTDATA(curr, unsigned int, tlb_e[i].end_odd);
+        PUTDATA(curr, unsigned int, tlb_e[i].phys_odd);
+    }
+#ifdef NEW_DYNAREC
+    if (r4300emu == CORE_DYNAREC)
+        PUTDATA(curr, unsigned int, pcaddr);
+    else
+        PUTDATA(curr, unsigned int, PC->addr);
+#else
+    PUTDATA(curr, unsigned int, PC->addr);
+#endif
+
+    PUTDATA(curr, unsigned int, next_interupt);
+    PUTDATA(curr, unsigned int, next_vi);
+    PUTDATA(curr, unsigned int, vi_field);
+
+    return curr;
+}
+
+/* Version 1.1 of the Mupen64Plus format isn't a GZIP stream: the state is split
+ * into chunks which are compressed independently with zlib, so that several
+ * threads of the work queue compress and inflate them at once.  After the
+ * 44 bytes of the header come, in little-endian order:
+ *
+ *   level, number of chunks
+ *   for each chunk: kind, size, stored size
+ *   the stored chunks, one after the other
+ *
+ * The chunks hold the machine state of savestates_fill_m64p(): the registers,
+ * RDRAM, SP memory, PIF RAM and the CPU state, each section in pieces of at
+ * most SAVESTATE_CHUNK_SIZE bytes, then the event queue.  A chunk whose stored
+ * size equals its size isn't compressed.  With level 0 no chunk is compressed,
+ * so the stored chunks are the machine state itself: the file is mapped and
+ * parsed in place, and RDRAM is copied straight from the mapping. */
+#define SAVESTATE_STATE_SIZE (SAVESTATES_RAW_SIZE - 1024)
+#define SAVESTATE_CHUNK_SIZE 0x40000
+#define SAVESTATE_MAX_CHUNKS 80
+
+enum savestate_chunk_kind
+{
+    SAVESTATE_CHUNK_REGISTERS = 1,
+    SAVESTATE_CHUNK_RDRAM,
+    SAVESTATE_CHUNK_SP_MEMORY,
+    SAVESTATE_CHUNK_PIF,
+    SAVESTATE_CHUNK_CPU,
+    SAVESTATE_CHUNK_EVENT_QUEUE
+};
+
+struct savestate_chunk {
+    unsigned int kind;
+    unsigned int offset; /* in the machine state */
+    unsigned int size;
+    unsigned int stored_size;
+    const unsigned char *stored;
+    unsigned char *compressed; /* owned by the chunk, if any */
+};
+
+/* the chunks of a batch are processed by the thread which runs the batch and
+   by helpers queued on the work queue.  The last one to leave frees it. */
+struct savestate_batch {
+    SDL_mutex *lock;
+    SDL_cond *finished;
+    struct savestate_chunk *chunks;
+    unsigned char *state;
+    int level; /* to compress with, or -1 to inflate */
+    int count;
+    int next;
+    int done;
+    int failed;
+    int refs;
+};
+
+struct savestate_helper {
+    struct savestate_batch *batch;
+    struct work_struct work;
+};
+
+static unsigned int savestates_read_le32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static unsigned char *savestates_write_le32(unsigned char *p, unsigned int value)
+{
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = value >> 24;
+    return p + 4;
+}
+
+static int savestates_layout_m64p(struct savestate_chunk *chunks, unsigned int queuelength)
+{
+    static const unsigned int sections[][2] = {
+        { SAVESTATE_CHUNK_REGISTERS, 400 },
+        { SAVESTATE_CHUNK_RDRAM, 0x800000 },
+        { SAVESTATE_CHUNK_SP_MEMORY, 0x2000 },
+        { SAVESTATE_CHUNK_PIF, 0x40 },
+        { SAVESTATE_CHUNK_CPU, SAVESTATE_STATE_SIZE - 400 - 0x800000 - 0x2000 - 0x40 },
+        { SAVESTATE_CHUNK_EVENT_QUEUE, 0 }
+    };
+    unsigned int i, offset = 0, size, left;
+    int count = 0;
+
+    for (i = 0; i < sizeof(sections) / sizeof(sections[0]); i++)
+    {
+        left = (sections[i][0] == SAVESTATE_CHUNK_EVENT_QUEUE) ? queuelength : sections[i][1];
+        do
+        {
+            size = (left > SAVESTATE_CHUNK_SIZE) ? SAVESTATE_CHUNK_SIZE : left;
+            memset(&chunks[count], 0, sizeof(chunks[count]));
+            chunks[count].kind = sections[i][0];
+            chunks[count].offset = offset;
+            chunks[count].size = size;
+            count++;
+            offset += size;
+            left -= size;
+        } while (left > 0);
+    }
+
+    return count;
+}
+
+static int savestates_process_chunk(struct savestate_batch *batch, struct savestate_chunk *chunk)
+{
+    unsigned char *data = batch->state + chunk->offset;
+    uLongf length;
+
+    if (batch->level < 0)
+    {
+        if (chunk->stored_size == chunk->size)
+        {
+            memcpy(data, chunk->stored, chunk->size);
+            return 1;
+        }
+        length = chunk->size;
+        return uncompress(data, &length, chunk->stored, chunk->stored_size) == Z_OK &&
+               length == chunk->size;
+    }
+
+    chunk->stored = data;
+    chunk->stored_size = chunk->size;
+
+    /* keep the chunk as it is if it doesn't shrink */
+    length = compressBound(chunk->size);
+    chunk->compressed = malloc(length);
+    if (chunk->compressed == NULL)
+        return 0;
+    if (compress2(chunk->compressed, &length, data, chunk->size, batch->level) != Z_OK)
+        return 0;
+    if (length < chunk->size)
+    {
+        chunk->stored = chunk->compressed;
+        chunk->stored_size = length;
+    }
+    return 1;
+}
+
+static void savestates_batch_work(struct savestate_batch *batch)
+{
+    int i, ok;
+
+    while (1)
+    {
+        SDL_LockMutex(batch->lock);
+        i = (batch->next < batch->count) ? batch->next++ : -1;
+        SDL_UnlockMutex(batch->lock);
+        if (i < 0)
+            break;
+
+        ok = savestates_process_chunk(batch, &batch->chunks[i]);
+
+        SDL_LockMutex(batch->lock);
+        if (!ok)
+            batch->failed = 1;
+        if (++batch->done == batch->count)
+            SDL_CondSignal(batch->finished);
+        SDL_UnlockMutex(batch->lock);
+    }
+}
+
+static void savestates_batch_release(struct savestate_batch *batch)
+{
+    int refs;
+
+    SDL_LockMutex(batch->lock);
+    refs = --batch->refs;
+    SDL_UnlockMutex(batch->lock);
+
+    if (refs == 0)
+    {
+        SDL_DestroyCond(batch->finished);
+        SDL_DestroyMutex(batch->lock);
+        free(batch);
+    }
+}
+
+static void savestates_helper_work(struct work_struct *work)
+{
+    struct savestate_helper *helper = container_of(work, struct savestate_helper, work);
+
+    savestates_batch_work(helper->batch);
+    savestates_batch_release(helper->batch);
+    free(helper);
+}
+
+/* Compresses (level >= 0) or inflates (level < 0) the chunks of a state on the
+ * calling thread and the threads of the work queue.  The calling thread works
+ * too, so that the batch completes even if the work queue is busy.  Returns 1
+ * if every chunk was processed. */
+static int savestates_run_batch(struct savestate_chunk *chunks, int count, unsigned char *state, int level)
+{
+    struct savestate_batch *batch;
+    struct savestate_helper *helper;
+    int i, helpers, failed;
+
+    batch = malloc(sizeof(*batch));
+    if (batch == NULL)
+        return 0;
+    memset(batch, 0, sizeof(*batch));
+    batch->lock = SDL_CreateMutex();
+    batch->finished = SDL_CreateCond();
+    if (batch->lock == NULL || batch->finished == NULL)
+    {
+        if (batch->lock != NULL) SDL_DestroyMutex(batch->lock);
+        if (batch->finished != NULL) SDL_DestroyCond(batch->finished);
+        free(batch);
+        return 0;
+    }
+    batch->chunks = chunks;
+    batch->state = state;
+    batch->level = level;
+    batch->count = count;
+    batch->refs = 1;
+
+    helpers = workqueue_threads();
+    if (helpers > count - 1)
+        helpers = count - 1;
+    for (i = 0; i < helpers; i++)
+    {
+        helper = malloc(sizeof(*helper));
+        if (helper == NULL)
+            break;
+        helper->batch = batch;
+        SDL_LockMutex(batch->lock);
+        batch->refs++;
+        SDL_UnlockMutex(batch->lock);
+        init_work(&helper->work, savestates_helper_work);
+        queue_work(&helper->work);
+    }
+
+    savestates_batch_work(batch);
+
+    SDL_LockMutex(batch->lock);
+    while (batch->done < batch->count)
+        SDL_CondWait(batch->finished, batch->lock);
+    failed = batch->failed;
+    SDL_UnlockMutex(batch->lock);
+
+    savestates_batch_release(batch);
+    return !failed;
+}
+
+/* Reads the chunks of a version 1.1 state from its mapped file.  Returns the
+ * machine state, which points into the mapping if it's parsed in place (*owned
+ * is 0) or is malloc'd (*owned is 1), and copies the event queue to queue. */
+static unsigned char *savestates_read_m64p_chunks(const unsigned char *file, size_t filesize,
+                                                  char *queue, int *owned)
+{
+    struct savestate_chunk chunks[SAVESTATE_MAX_CHUNKS];
+    const unsigned char *table = file + 52;
+    unsigned char *state;
+    unsigned int level, count, queuelength, i;
+    size_t stored;
+    int raw = 1;
+
+    if (filesize < 52)
+        return NULL;
+    level = savestates_read_le32(file + 44);
+    count = savestates_read_le32(file + 48);
+    if (level > 9 || count < 2 || count > SAVESTATE_MAX_CHUNKS || filesize < 52 + 12 * (size_t) count)
+        return NULL;
+
+    /* the table must match the layout, whatever the length of the event queue */
+    queuelength = savestates_read_le32(table + 12 * (count - 1) + 4);
+    if (queuelength > 1024 || (queuelength % 4) != 0 ||
+        savestates_layout_m64p(chunks, queuelength) != (int) count)
+        return NULL;
+
+    stored = 52 + 12 * (size_t) count;
+    for (i = 0; i < count; i++, table += 12)
+    {
+        if (savestates_read_le32(table) != chunks[i].kind ||
+            savestates_read_le32(table + 4) != chunks[i].size)
+            return NULL;
+        chunks[i].stored_size = savestates_read_le32(table + 8);
+        if (chunks[i].stored_size > chunks[i].size || filesize - stored < chunks[i].stored_size)
+            return NULL;
+        chunks[i].stored = file + stored;
+        stored += chunks[i].stored_size;
+        if (chunks[i].stored_size != chunks[i].size)
+            raw = 0;
+    }
+
+    memset(queue, 0, 1024);
+    memcpy(queue, chunks[count - 1].stored, queuelength);
+    if (chunks[count - 1].stored_size != queuelength)
+    {
+        uLongf length = queuelength;
+        if (uncompress((unsigned char *) queue, &length, chunks[count - 1].stored,
+                       chunks[count - 1].stored_size) != Z_OK || length != queuelength)
+            return NULL;
+    }
+
+#ifdef M64P_BIG_ENDIAN
+    /* parsing byte-swaps the state in place */
+    raw = 0;
+#endif
+    if (raw)
+    {
+        *owned = 0;
+        return (unsigned char *) chunks[0].stored;
+    }
+
+    state = malloc(SAVESTATE_STATE_SIZE);
+    if (state == NULL)
+        return NULL;
+    if (!savestates_run_batch(chunks, count - 1, state, -1))
+    {
+        free(state);
+        return NULL;
+    }
+    *owned = 1;
+    return state;
+}
+
+/* Writes a version 1.1 state next to its file, then replaces the file, so
+ * that a state being loaded from the mapped file is never truncated. */
+static int savestates_write_m64p(struct savestate_work *save)
+{
+    struct savestate_chunk chunks[SAVESTATE_MAX_CHUNKS];
+    unsigned char table[8 + 12 * SAVESTATE_MAX_CHUNKS], *curr = table;
+    unsigned char *state = (unsigned char *) save->data;
+    char *tmppath = NULL;
+    FILE *f = NULL;
+    int count, i, ok;
+
+    count = savestates_layout_m64p(chunks, save->size - SAVESTATE_STATE_SIZE);
+    for (i = 0; i < count; i++)
+    {
+        chunks[i].stored = state + chunks[i].offset;
+        chunks[i].stored_size = chunks[i].size;
+    }
+    ok = (save->level == 0) || savestates_run_batch(chunks, count, state, save->level);
+
+    curr = savestates_write_le32(curr, save->level);
+    curr = savestates_write_le32(curr, count);
+    for (i = 0; i < count; i++)
+    {
+        curr = savestates_write_le32(curr, chunks[i].kind);
+        curr = savestates_write_le32(curr, chunks[i].size);
+        curr = savestates_write_le32(curr, chunks[i].stored_size);
+    }
+
+    if (ok)
+        f = osal_create_temp_file(save->filepath, &tmppath);
+    ok = ok && f != NULL &&
+         fwrite(save->header, 1, 44, f) == 44 &&
+         fwrite(table, 1, curr - table, f) == (size_t) (curr - table);
+    for (i = 0; ok && i < count; i++)
+        ok = fwrite(chunks[i].stored, 1, chunks[i].stored_size, f) == chunks[i].stored_size;
+    if (f != NULL && fclose(f) != 0)
+        ok = 0;
+    if (f != NULL)
+    {
+        if (ok)
+            ok = osal_replace_file(tmppath, save->filepath) == 0;
+        if (!ok)
+            unlink(tmppath);
+    }
+
+    for (i = 0; i < count; i++)
+        free(chunks[i].compressed);
+    free(tmppath);
+    return ok;
+}
+
+static int savestates_load_m64p(char *filepath)
+{
+    unsigned char header[44];
+    gzFile f;
+    int version;
+
+    size_t savestateSize;
+    unsigned char *savestateData, *curr;
+    unsigned char *file = NULL;
+    size_t filesize = 0;
+    int owned = 1;
+    char queue[1024];
+
+    SDL_LockMutex(savestates_lock);
+
+    f = gzopen(filepath, "rb");
+    if(f==NULL)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not open state file: %s", filepath);
+        SDL_UnlockMutex(savestates_lock);
+        return 0;
+    }
+
+    /* Read and check Mupen64Plus magic number. */
+    if (gzread(f, header, 44) != 44)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read header from state file %s", filepath);
+        gzclose(f);
+        SDL_UnlockMutex(savestates_lock);
+        return 0;
+    }
+    curr = header;
+
+    if(strncmp((char *)curr, savestate_magic, 8)!=0)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State file: %s is not a valid Mupen64plus savestate.", filepath);
+        gzclose(f);
+        SDL_UnlockMutex(savestates_lock);
+        return 0;
+    }
+    curr += 8;
+
+    version = *curr++;
+    version = (version << 8) | *curr++;
+    version = (version << 8) | *curr++;
+    version = (version << 8) | *curr++;
+    if(version != 0x00010000 && version != savestate_latest_version)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State version (%08x) isn't compatible. Please update Mupen64Plus.", version);
+        gzclose(f);
+        SDL_UnlockMutex(savestates_lock);
+        return 0;
+    }
+
+    if(memcmp((char *)curr, ROM_SETTINGS.MD5, 32))
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State ROM MD5 does not match current ROM.");
+        gzclose(f);
+        SDL_UnlockMutex(savestates_lock);
+        return 0;
+    }
+    curr += 32;
+
+    if (version == savestate_latest_version)
+    {
+        /* chunked state, see savestates_read_m64p_chunks() */
+        gzclose(f);
+        file = (unsigned char *) osal_map_file(filepath, &filesize);
+        savestateData = (file != NULL) ? savestates_read_m64p_chunks(file, filesize, queue, &owned) : NULL;
+        SDL_UnlockMutex(savestates_lock);
+        if (savestateData == NULL)
+        {
+            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate data from %s", filepath);
+            if (file != NULL)
+                osal_unmap_file(file, filesize);
+            return 0;
+        }
+
+        savestates_parse_m64p(savestateData, queue);
+
+        if (owned)
+            free(savestateData);
+        osal_unmap_file(file, filesize);
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State loaded from: %s", namefrompath(filepath));
+        return 1;
+    }
+
+    /* Read the rest of the savestate */
+    savestateSize = SAVESTATE_STATE_SIZE;
+    savestateData = curr = (unsigned char *)malloc(savestateSize);
+    if (savestateData == NULL)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Insufficient memory to load state.");
+        gzclose(f);
+        SDL_UnlockMutex(savestates_lock);
+        return 0;
+    }
+    if (gzread(f, savestateData, savestateSize) != savestateSize ||
+        (gzread(f, queue, sizeof(queue)) % 4) != 0)
+    {
+        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not read Mupen64Plus savestate data from %s", filepath);
+        free(savestateData);
+        gzclose(f);
+        SDL_UnlockMutex(savestates_lock);
+        return 0;
+    }
 
-    to_little_endian_buffer(queue, 4, 256);
-    load_eventqueue_infos(queue);
+    gzclose(f);
+    SDL_UnlockMutex(savestates_lock);
 
-#ifdef NEW_DYNAREC
-    if (r4300emu == CORE_DYNAREC)
-        last_addr = pcaddr;
-    else
-        last_addr = PC->addr;
-#else
-    last_addr = PC->addr;
-#endif
+    // Parse savestate
+    savestates_parse_m64p(curr, queue);
 
     free(savestateData);
     main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "State loaded from: %s", namefrompath(filepath));
@@ -568,6 +1199,7 @@ static int savestates_load_pj64(char *filepath, void *handle,
     FCR0 = GETDATA(curr, int);
     curr += 30 * 4; // FCR1...FCR30 not supported
     FCR31 = GETDATA(curr, int);
+    update_rounding_mxcsr();
 
     // hi / lo
     hi = GETDATA(curr, long long int);
@@ -683,8 +1315,7 @@ static int savestates_load_pj64(char *filepath, void *handle,
     si_register.si_stat = GETDATA(curr, unsigned int);
 
     // tlb
-    memset(tlb_LUT_r, 0, 0x400000);
-    memset(tlb_LUT_w, 0, 0x400000);
+    tlb_LUT_reset();
     for (i=0; i < 32; i++)
     {
         unsigned int MyPageMask, MyEntryHi, MyEntryLo0, MyEntryLo1;
@@ -859,6 +1490,8 @@ static savestates_type savestates_detect_type(char *filepath)
 
     if (magic[0] == 0x1f && magic[1] == 0x8b) // GZIP header
         return savestates_type_m64p;
+    else if (memcmp(magic, savestate_magic, 4) == 0) // chunked M64P header
+        return savestates_type_m64p;
     else if (memcmp(magic, "PK\x03\x04", 4) == 0) // ZIP header
         return savestates_type_pj64_zip;
     else if (memcmp(magic, pj64_magic, 4) == 0) // PJ64 header
@@ -929,6 +1562,7 @@ int savestates_load(void)
 
     if (filepath != NULL)
     {
+        trace_begin("savestates.load");
         switch (type)
         {
             case savestates_type_m64p: ret = savestates_load_m64p(filepath); break;
@@ -936,6 +1570,7 @@ int savestates_load(void)
             case savestates_type_pj64_unc: ret = savestates_load_pj64_unc(filepath); break;
             default: ret = 0; break;
         }
+        trace_end("savestates.load");
         free(filepath);
         filepath = NULL;
     }
@@ -948,50 +1583,41 @@ int savestates_load(void)
     return ret;
 }
 
-static void savestates_save_m64p_work(struct work_struct *work)
+static void savestates_write_pending(struct work_struct *work)
 {
-    gzFile f;
-    struct savestate_work *save = container_of(work, struct savestate_work, work);
+    struct savestate_work *save;
 
     SDL_LockMutex(savestates_lock);
-
-    // Write the state to a GZIP file
-    f = gzopen(save->filepath, "wb");
-
-    if (f==NULL)
+    while (!list_empty(&savestates_pending))
     {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not open state file: %s", save->filepath);
-        free(save->data);
-        return;
-    }
+        save = list_first_entry(&savestates_pending, struct savestate_work, list);
+        list_del(&save->list);
+        trace_begin("savestates.write");
 
-    if (gzwrite(f, save->data, save->size) != save->size)
-    {
-        main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not write data to state file: %s", save->filepath);
-        gzclose(f);
+        if (savestates_write_m64p(save))
+            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Saved state to: %s", namefrompath(save->filepath));
+        else
+            main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Could not write data to state file: %s", save->filepath);
+
+        trace_end("savestates.write");
         free(save->data);
-        return;
+        free(save->filepath);
+        free(save);
     }
-
-    gzclose(f);
-    main_message(M64MSG_STATUS, OSD_BOTTOM_LEFT, "Saved state to: %s", namefrompath(save->filepath));
-    free(save->data);
-    free(save->filepath);
-    free(save);
-
+    savestates_writing = 0;
     SDL_UnlockMutex(savestates_lock);
 }
 
 static int savestates_save_m64p(char *filepath)
 {
     unsigned char outbuf[4];
-    int i;
 
     char queue[1024];
     int queuelength;
 
     struct savestate_work *save;
     char *curr;
+    int start;
 
     save = malloc(sizeof(*save));
     if (!save) {
@@ -1007,7 +1633,7 @@ static int savestates_save_m64p(char *filepath)
     queuelength = save_eventqueue_infos(queue);
 
     // Allocate memory for the save state data
-    save->size = 16788288 + queuelength;
+    save->size = SAVESTATE_STATE_SIZE + queuelength;
     save->data = curr = malloc(save->size);
     if (save->data == NULL)
     {
@@ -1017,7 +1643,12 @@ static int savestates_save_m64p(char *filepath)
         return 0;
     }
 
-    // Write the save state data to memory
+    save->level = ConfigGetParamInt(g_CoreConfig, "SaveStateCompression");
+    if (save->level < 0 || save->level > 9)
+        save->level = 6;
+
+    // Write the header, it's stored uncompressed in front of the chunks
+    curr = (char *) save->header;
     PUTARRAY(savestate_magic, curr, unsigned char, 8);
 
     outbuf[0] = (savestate_latest_version >> 24) & 0xff;
@@ -1028,220 +1659,25 @@ static int savestates_save_m64p(char *filepath)
 
     PUTARRAY(ROM_SETTINGS.MD5, curr, char, 32);
 
-    PUTDATA(curr, unsigned int, rdram_register.rdram_config);
-    PUTDATA(curr, unsigned int, rdram_register.rdram_device_id);
-    PUTDATA(curr, unsigned int, rdram_register.rdram_delay);
-    PUTDATA(curr, unsigned int, rdram_register.rdram_mode);
-    PUTDATA(curr, unsigned int, rdram_register.rdram_ref_interval);
-    PUTDATA(curr, unsigned int, rdram_register.rdram_ref_row);
-    PUTDATA(curr, unsigned int, rdram_register.rdram_ras_interval);
-    PUTDATA(curr, unsigned int, rdram_register.rdram_min_interval);
-    PUTDATA(curr, unsigned int, rdram_register.rdram_addr_select);
-    PUTDATA(curr, unsigned int, rdram_register.rdram_device_manuf);
-
-    PUTDATA(curr, unsigned int, MI_register.w_mi_init_mode_reg);
-    PUTDATA(curr, unsigned int, MI_register.mi_init_mode_reg);
-    PUTDATA(curr, unsigned char, MI_register.mi_init_mode_reg & 0x7F);
-    PUTDATA(curr, unsigned char, (MI_register.mi_init_mode_reg & 0x80) != 0);
-    PUTDATA(curr, unsigned char, (MI_register.mi_init_mode_reg & 0x100) != 0);
-    PUTDATA(curr, unsigned char, (MI_register.mi_init_mode_reg & 0x200) != 0);
-    PUTDATA(curr, unsigned int, MI_register.mi_version_reg);
-    PUTDATA(curr, unsigned int, MI_register.mi_intr_reg);
-    PUTDATA(curr, unsigned int, MI_register.mi_intr_mask_reg);
-    PUTDATA(curr, unsigned int, MI_register.w_mi_intr_mask_reg);
-    PUTDATA(curr, unsigned char, (MI_register.mi_intr_mask_reg & 0x1) != 0);
-    PUTDATA(curr, unsigned char, (MI_register.mi_intr_mask_reg & 0x2) != 0);
-    PUTDATA(curr, unsigned char, (MI_register.mi_intr_mask_reg & 0x4) != 0);
-    PUTDATA(curr, unsigned char, (MI_register.mi_intr_mask_reg & 0x8) != 0);
-    PUTDATA(curr, unsigned char, (MI_register.mi_intr_mask_reg & 0x10) != 0);
-    PUTDATA(curr, unsigned char, (MI_register.mi_intr_mask_reg & 0x20) != 0);
-    PUTDATA(curr, unsigned short, 0); // Padding from old implementation
-
-    PUTDATA(curr, unsigned int, pi_register.pi_dram_addr_reg);
-    PUTDATA(curr, unsigned int, pi_register.pi_cart_addr_reg);
-    PUTDATA(curr, unsigned int, pi_register.pi_rd_len_reg);
-    PUTDATA(curr, unsigned int, pi_register.pi_wr_len_reg);
-    PUTDATA(curr, unsigned int, pi_register.read_pi_status_reg);
-    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom1_lat_reg);
-    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom1_pwd_reg);
-    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom1_pgs_reg);
-    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom1_rls_reg);
-    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom2_lat_reg);
-    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom2_pwd_reg);
-    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom2_pgs_reg);
-    PUTDATA(curr, unsigned int, pi_register.pi_bsd_dom2_rls_reg);
-
-    PUTDATA(curr, unsigned int, sp_register.sp_mem_addr_reg);
-    PUTDATA(curr, unsigned int, sp_register.sp_dram_addr_reg);
-    PUTDATA(curr, unsigned int, sp_register.sp_rd_len_reg);
-    PUTDATA(curr, unsigned int, sp_register.sp_wr_len_reg);
-    PUTDATA(curr, unsigned int, sp_register.w_sp_status_reg);
-    PUTDATA(curr, unsigned int, sp_register.sp_status_reg);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x1) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x2) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x4) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x8) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x10) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x20) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x40) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x80) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x100) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x200) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x400) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x800) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x1000) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x2000) != 0);
-    PUTDATA(curr, unsigned char, (sp_register.sp_status_reg & 0x4000) != 0);
-    PUTDATA(curr, unsigned char, 0);
-    PUTDATA(curr, unsigned int, sp_register.sp_dma_full_reg);
-    PUTDATA(curr, unsigned int, sp_register.sp_dma_busy_reg);
-    PUTDATA(curr, unsigned int, sp_register.sp_semaphore_reg);
-
-    PUTDATA(curr, unsigned int, rsp_register.rsp_pc);
-    PUTDATA(curr, unsigned int, rsp_register.rsp_ibist);
-
-    PUTDATA(curr, unsigned int, si_register.si_dram_addr);
-    PUTDATA(curr, unsigned int, si_register.si_pif_addr_rd64b);
-    PUTDATA(curr, unsigned int, si_register.si_pif_addr_wr64b);
-    PUTDATA(curr, unsigned int, si_register.si_stat);
-
-    PUTDATA(curr, unsigned int, vi_register.vi_status);
-    PUTDATA(curr, unsigned int, vi_register.vi_origin);
-    PUTDATA(curr, unsigned int, vi_register.vi_width);
-    PUTDATA(curr, unsigned int, vi_register.vi_v_intr);
-    PUTDATA(curr, unsigned int, vi_register.vi_current);
-    PUTDATA(curr, unsigned int, vi_register.vi_burst);
-    PUTDATA(curr, unsigned int, vi_register.vi_v_sync);
-    PUTDATA(curr, unsigned int, vi_register.vi_h_sync);
-    PUTDATA(curr, unsigned int, vi_register.vi_leap);
-    PUTDATA(curr, unsigned int, vi_register.vi_h_start);
-    PUTDATA(curr, unsigned int, vi_register.vi_v_start);
-    PUTDATA(curr, unsigned int, vi_register.vi_v_burst);
-    PUTDATA(curr, unsigned int, vi_register.vi_x_scale);
-    PUTDATA(curr, unsigned int, vi_register.vi_y_scale);
-    PUTDATA(curr, unsigned int, vi_register.vi_delay);
-
-    PUTDATA(curr, unsigned int, ri_register.ri_mode);
-    PUTDATA(curr, unsigned int, ri_register.ri_config);
-    PUTDATA(curr, unsigned int, ri_register.ri_current_load);
-    PUTDATA(curr, unsigned int, ri_register.ri_select);
-    PUTDATA(curr, unsigned int, ri_register.ri_refresh);
-    PUTDATA(curr, unsigned int, ri_register.ri_latency);
-    PUTDATA(curr, unsigned int, ri_register.ri_error);
-    PUTDATA(curr, unsigned int, ri_register.ri_werror);
-
-    PUTDATA(curr, unsigned int, ai_register.ai_dram_addr);
-    PUTDATA(curr, unsigned int, ai_register.ai_len);
-    PUTDATA(curr, unsigned int, ai_register.ai_control);
-    PUTDATA(curr, unsigned int, ai_register.ai_status);
-    PUTDATA(curr, unsigned int, ai_register.ai_dacrate);
-    PUTDATA(curr, unsigned int, ai_register.ai_bitrate);
-    PUTDATA(curr, unsigned int, ai_register.next_delay);
-    PUTDATA(curr, unsigned int, ai_register.next_len);
-    PUTDATA(curr, unsigned int, ai_register.current_delay);
-    PUTDATA(curr, unsigned int, ai_register.current_len);
-
-    PUTDATA(curr, unsigned int, dpc_register.dpc_start);
-    PUTDATA(curr, unsigned int, dpc_register.dpc_end);
-    PUTDATA(curr, unsigned int, dpc_register.dpc_current);
-    PUTDATA(curr, unsigned int, dpc_register.w_dpc_status);
-    PUTDATA(curr, unsigned int, dpc_register.dpc_status);
-    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x1) != 0);
-    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x2) != 0);
-    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x4) != 0);
-    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x8) != 0);
-    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x10) != 0);
-    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x20) != 0);
-    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x40) != 0);
-    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x80) != 0);
-    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x100) != 0);
-    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x200) != 0);
-    PUTDATA(curr, unsigned char, (dpc_register.dpc_status & 0x400) != 0);
-    PUTDATA(curr, unsigned char, 0);
-    PUTDATA(curr, unsigned int, dpc_register.dpc_clock);
-    PUTDATA(curr, unsigned int, dpc_register.dpc_bufbusy);
-    PUTDATA(curr, unsigned int, dpc_register.dpc_pipebusy);
-    PUTDATA(curr, unsigned int, dpc_register.dpc_tmem);
-
-    PUTDATA(curr, unsigned int, dps_register.dps_tbist);
-    PUTDATA(curr, unsigned int, dps_register.dps_test_mode);
-    PUTDATA(curr, unsigned int, dps_register.dps_buftest_addr);
-    PUTDATA(curr, unsigned int, dps_register.dps_buftest_data);
-
-    PUTARRAY(rdram, curr, unsigned int, 0x800000/4);
-    PUTARRAY(SP_DMEM, curr, unsigned int, 0x1000/4);
-    PUTARRAY(SP_IMEM, curr, unsigned int, 0x1000/4);
-    PUTARRAY(PIF_RAM, curr, unsigned char, 0x40);
-
-    PUTDATA(curr, int, flashram_info.use_flashram);
-    PUTDATA(curr, int, flashram_info.mode);
-    PUTDATA(curr, unsigned long long, flashram_info.status);
-    PUTDATA(curr, unsigned int, flashram_info.erase_offset);
-    PUTDATA(curr, unsigned int, flashram_info.write_pointer);
-
-    PUTARRAY(tlb_LUT_r, curr, unsigned int, 0x100000);
-    PUTARRAY(tlb_LUT_w, curr, unsigned int, 0x100000);
-
-    PUTDATA(curr, unsigned int, llbit);
-    PUTARRAY(reg, curr, long long int, 32);
-    PUTARRAY(g_cp0_regs, curr, unsigned int, CP0_REGS_COUNT);
-    PUTDATA(curr, long long int, lo);
-    PUTDATA(curr, long long int, hi);
-
-    if ((g_cp0_regs[CP0_STATUS_REG] & 0x04000000) == 0) // FR bit == 0 means 32-bit (MIPS I) FGR mode
-        shuffle_fpr_data(0, 0x04000000);  // shuffle data into 64-bit register format for storage
-    PUTARRAY(reg_cop1_fgr_64, curr, long long int, 32);
-    if ((g_cp0_regs[CP0_STATUS_REG] & 0x04000000) == 0)
-        shuffle_fpr_data(0x04000000, 0);  // put it back in 32-bit mode
-
-    PUTDATA(curr, int, FCR0);
-    PUTDATA(curr, int, FCR31);
-    for (i = 0; i < 32; i++)
-    {
-        PUTDATA(curr, short, tlb_e[i].mask);
-        PUTDATA(curr, short, 0);
-        PUTDATA(curr, int, tlb_e[i].vpn2);
-        PUTDATA(curr, char, tlb_e[i].g);
-        PUTDATA(curr, unsigned char, tlb_e[i].asid);
-        PUTDATA(curr, short, 0);
-        PUTDATA(curr, int, tlb_e[i].pfn_even);
-        PUTDATA(curr, char, tlb_e[i].c_even);
-        PUTDATA(curr, char, tlb_e[i].d_even);
-        PUTDATA(curr, char, tlb_e[i].v_even);
-        PUTDATA(curr, char, 0);
-        PUTDATA(curr, int, tlb_e[i].pfn_odd);
-        PUTDATA(curr, char, tlb_e[i].c_odd);
-        PUTDATA(curr, char, tlb_e[i].d_odd);
-        PUTDATA(curr, char, tlb_e[i].v_odd);
-        PUTDATA(curr, char, tlb_e[i].r);
-   
-        PUTDATA(curr, unsigned int, tlb_e[i].start_even);
-        PUTDATA(curr, unsigned int, tlb_e[i].end_even);
-        PUTDATA(curr, unsigned int, tlb_e[i].phys_even);
-        PUTDATA(curr, unsigned int, tlb_e[i].start_odd);
-        PUTDATA(curr, unsigned int, tlb_e[i].end_odd);
-        PUTDATA(curr, unsigned int, tlb_e[i].phys_odd);
-    }
-#ifdef NEW_DYNAREC
-    if (r4300emu == CORE_DYNAREC)
-        PUTDATA(curr, unsigned int, pcaddr);
-    else
-        PUTDATA(curr, unsigned int, PC->addr);
-#else
-    PUTDATA(curr, unsigned int, PC->addr);
-#endif
-
-    PUTDATA(curr, unsigned int, next_interupt);
-    PUTDATA(curr, unsigned int, next_vi);
-    PUTDATA(curr, unsigned int, vi_field);
+    // Write the save state data to memory
+    curr = savestates_fill_m64p(save->data);
 
     to_little_endian_buffer(queue, 4, queuelength/4);
     PUTARRAY(queue, curr, char, queuelength);
 
     // assert(curr == save->data + save->size)
 
-    init_work(&save->work, savestates_save_m64p_work);
-    queue_work(&save->work);
+    SDL_LockMutex(savestates_lock);
+    list_add_tail(&save->list, &savestates_pending);
+    start = !savestates_writing;
+    savestates_writing = 1;
+    SDL_UnlockMutex(savestates_lock);
+
+    if (start)
+    {
+        init_work(&savestates_writer, savestates_write_pending);
+        queue_work(&savestates_writer);
+    }
 
     return 1;
 }
@@ -1497,6 +1933,9 @@ int savestates_save(void)
         get_next_event_type() > COMPARE_INT)
         return 0;
 
+    /* make the in-game saves on disk consistent with the state being saved */
+    savemedia_flush_all();
+
     if (fname != NULL && type == savestates_type_unknown)
         type = savestates_type_m64p;
     else if (fname == NULL) // Always save slots in M64P format
@@ -1505,6 +1944,7 @@ int savestates_save(void)
     filepath = savestates_generate_path(type);
     if (filepath != NULL)
     {
+        trace_begin("savestates.save");
         switch (type)
         {
             case savestates_type_m64p: ret = savestates_save_m64p(filepath); break;
@@ -1512,6 +1952,7 @@ int savestates_save(void)
             case savestates_type_pj64_unc: ret = savestates_save_pj64_unc(filepath); break;
             default: ret = 0; break;
         }
+        trace_end("savestates.save");
         free(filepath);
     }
 
@@ -1522,6 +1963,22 @@ int savestates_save(void)
     return ret;
 }
 
+void savestates_save_raw(unsigned char *buffer)
+{
+    char *queue = savestates_fill_m64p((char *) buffer);
+    int queuelength;
+
+    /* zero the unused tail so that identical states produce identical buffers */
+    memset(queue, 0, 1024);
+    queuelength = save_eventqueue_infos(queue);
+    to_little_endian_buffer(queue, 4, queuelength/4);
+}
+
+void savestates_load_raw(unsigned char *buffer)
+{
+    savestates_parse_m64p(buffer, (char *) buffer + SAVESTATES_RAW_SIZE - 1024);
+}
+
 void savestates_init(void)
 {
     savestates_lock = SDL_CreateMutex();
@@ -1533,6 +1990,10 @@ void savestates_init(void)
 
 void savestates_deinit(void)
 {
+    /* the work queue is already stopped, write the saves it did not get to */
+    if (!list_empty(&savestates_pending))
+        savestates_write_pending(NULL);
+
     SDL_DestroyMutex(savestates_lock);
     savestates_clear_job();
 }
@@ -40,6 +40,11 @@ typedef enum _savestates_type
     savestates_type_pj64_unc
 } savestates_type;
 
+/* A raw state is the machine state of a Mupen64Plus savestate, without its
+   header, followed by the event queue padded to 1024 bytes.  Loading a raw
+   state may byte-swap the buffer in place on big-endian hosts. */
+#define SAVESTATES_RAW_SIZE (16788244 + 1024)
+
 savestates_job savestates_get_job(void);
 void savestates_set_job(savestates_job j, savestates_type t, const char *fn);
 void savestates_init(void);
@@ -48,6 +53,9 @@ void savestates_deinit(void);
 int savestates_load(void);
 int savestates_save(void);
 
+void savestates_save_raw(unsigned char *buffer);
+void savestates_load_raw(unsigned char *buffer);
+
 void savestates_select_slot(unsigned int s);
 unsigned int savestates_get_slot(void);
 void savestates_set_autoinc_slot(int b);
@@ -0,0 +1,321 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - trace.c                                                 *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Tracing of the core subsystems.
+ *
+ * While the "Trace" parameter of the core is set, the subsystems record
+ * begin/end and instant events with trace_begin(), trace_end() and
+ * trace_instant().  The parameter is polled at each VI by trace_update(),
+ * when it is cleared or when the emulation stops, the events are written to
+ * "TraceFile" in the Chrome trace event JSON format, which chrome://tracing
+ * and Perfetto can open.
+ *
+ * Each thread records its events in its own ring buffer, so that recording
+ * takes no lock.  The thread publishes an event by storing the new head of
+ * its buffer with release semantics, and the writer loads the heads with
+ * acquire semantics, copies the events and drops the ones that were
+ * overwritten while it copied them.  When a buffer is full, the oldest
+ * events are overwritten.
+ *
+ * The buffers are freed once the file is written.  A thread reaches its
+ * buffer through a small slot that is never freed, and marks the slot
+ * active while it records, so that a buffer is only freed when its thread
+ * is not using it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <SDL.h>
+#include <SDL_thread.h>
+
+#define M64P_CORE_PROTOTYPES 1
+#include "api/m64p_types.h"
+#include "api/m64p_config.h"
+#include "api/callbacks.h"
+#include "api/config.h"
+
+#include "trace.h"
+#include "main.h"
+#include "util.h"
+
+#define TRACE_BUFFER_SIZE 0x10000 /* events per thread, power of two */
+#define TRACE_DEFAULT_FILE "mupen64plus_trace.json"
+
+struct trace_record
+{
+    long long int time;
+    const char *name;
+    unsigned int arg;
+    char phase;
+};
+
+struct trace_buffer
+{
+    unsigned int head; /* number of events ever recorded */
+    struct trace_record records[TRACE_BUFFER_SIZE];
+};
+
+struct trace_slot
+{
+    struct trace_slot *next;
+    unsigned int tid;
+    SDL_atomic_t active; /* set while the thread records an event */
+    struct trace_buffer *buffer;
+};
+
+/* global variables */
+int g_TraceEnabled = 0;
+
+/* local variables */
+static struct trace_slot *l_Slots = NULL;
+static SDL_atomic_t l_Threads;
+static long long int l_StartTime = 0;
+static osal_thread_local struct trace_slot *l_Slot = NULL;
+
+#if defined(WIN32) && !defined(__MINGW32__)
+  #include <windows.h>
+  /* in microseconds */
+  static long long int trace_time(void)
+  {
+      static LARGE_INTEGER freq = { 0 };
+      LARGE_INTEGER counter;
+      if (freq.QuadPart == 0)
+          QueryPerformanceFrequency(&freq);
+      QueryPerformanceCounter(&counter);
+      return counter.QuadPart * 1000000 / freq.QuadPart;
+  }
+#else
+  #include <time.h>
+  /* in microseconds */
+  static long long int trace_time(void)
+  {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return (long long int)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+  }
+#endif
+
+static struct trace_slot *trace_register_thread(void)
+{
+    struct trace_slot *slot = (struct trace_slot *) malloc(sizeof(struct trace_slot));
+
+    if (slot == NULL)
+        return NULL;
+
+    slot->tid = SDL_AtomicAdd(&l_Threads, 1) + 1;
+    SDL_AtomicSet(&slot->active, 0);
+    slot->buffer = NULL;
+    do
+    {
+        slot->next = (struct trace_slot *) SDL_AtomicGetPtr((void **) &l_Slots);
+    } while (!SDL_AtomicCASPtr((void **) &l_Slots, slot->next, slot));
+
+    return slot;
+}
+
+/* called once g_TraceEnabled is cleared, so that no thread starts recording
+ * again, waits for the threads still recording an event */
+static void trace_free_buffers(void)
+{
+    struct trace_slot *slot;
+
+    for (slot = (struct trace_slot *) SDL_AtomicGetPtr((void **) &l_Slots); slot != NULL; slot = slot->next)
+    {
+        while (SDL_AtomicAdd(&slot->active, 0) != 0)
+            SDL_Delay(0);
+        free(slot->buffer);
+        slot->buffer = NULL;
+    }
+}
+
+/* copies the events of a buffer which may still be recording, returns the
+ * number of events copied to records */
+static unsigned int trace_copy_buffer(const struct trace_buffer *buffer, struct trace_record *records)
+{
+    unsigned int i, first, head, count = 0;
+
+    head = buffer->head;
+    SDL_MemoryBarrierAcquire();
+    first = (head > TRACE_BUFFER_SIZE) ? head - TRACE_BUFFER_SIZE : 0;
+    for (i = first; i != head; i++)
+        records[count++] = buffer->records[i & (TRACE_BUFFER_SIZE - 1)];
+
+    /* the events recorded meanwhile overwrote the oldest ones, and the one
+     * being recorded may overwrite the next */
+    SDL_MemoryBarrierAcquire();
+    head = buffer->head + 1;
+    if (head > first + TRACE_BUFFER_SIZE)
+    {
+        unsigned int lost = head - first - TRACE_BUFFER_SIZE;
+
+        if (lost > count)
+            lost = count;
+        memmove(records, records + lost, (count - lost) * sizeof(struct trace_record));
+        count -= lost;
+    }
+
+    return count;
+}
+
+static void trace_start(void)
+{
+    l_StartTime = trace_time();
+    g_TraceEnabled = 1;
+    DebugMessage(M64MSG_INFO, "Tracing started");
+}
+
+static void trace_write(void)
+{
+    const char *filename = ConfigGetParamString(g_CoreConfig, "TraceFile");
+    char *filepath;
+    struct trace_slot *slot;
+    struct trace_record *records;
+    unsigned int i, n, count = 0;
+    FILE *f;
+
+    if (filename != NULL && filename[0] != '\0')
+        filepath = strdup(filename);
+    else
+        filepath = combinepath(ConfigGetUserCachePath(), TRACE_DEFAULT_FILE);
+    if (filepath == NULL)
+        return;
+
+    records = (struct trace_record *) malloc(TRACE_BUFFER_SIZE * sizeof(struct trace_record));
+    f = (records != NULL) ? fopen(filepath, "w") : NULL;
+    if (f == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Couldn't open trace file '%s' for writing", filepath);
+        free(records);
+        free(filepath);
+        return;
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"mupen64plus\"}}");
+
+    for (slot = (struct trace_slot *) SDL_AtomicGetPtr((void **) &l_Slots); slot != NULL; slot = slot->next)
+    {
+        const struct trace_buffer *buffer = (const struct trace_buffer *) SDL_AtomicGetPtr((void **) &slot->buffer);
+
+        if (buffer == NULL)
+            continue;
+
+        n = trace_copy_buffer(buffer, records);
+        for (i = 0; i < n; i++)
+        {
+            const struct trace_record *record = &records[i];
+
+            if (record->time < l_StartTime)
+                continue;
+
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":1,\"tid\":%u",
+                    record->name, record->phase, record->time - l_StartTime, slot->tid);
+            if (record->phase == 'i')
+                fprintf(f, ",\"s\":\"t\",\"args\":{\"arg\":%u}", record->arg);
+            fprintf(f, "}");
+            count++;
+        }
+    }
+
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    free(records);
+
+    DebugMessage(M64MSG_INFO, "Trace of %u events written to '%s'", count, filepath);
+    free(filepath);
+}
+
+static void trace_stop(void)
+{
+    g_TraceEnabled = 0;
+    trace_write();
+    trace_free_buffers();
+}
+
+/* Global Functions */
+
+void trace_event(char phase, const char *name, unsigned int arg)
+{
+    struct trace_slot *slot = l_Slot;
+    struct trace_buffer *buffer;
+    struct trace_record *record;
+    unsigned int head;
+
+    if (slot == NULL)
+    {
+        slot = l_Slot = trace_register_thread();
+        if (slot == NULL)
+            return;
+    }
+
+    /* full barriers, so that trace_free_buffers() either sees the slot
+     * active or this thread sees that tracing stopped since the caller
+     * checked g_TraceEnabled */
+    SDL_AtomicAdd(&slot->active, 1);
+    if (!g_TraceEnabled)
+    {
+        SDL_AtomicAdd(&slot->active, -1);
+        return;
+    }
+
+    buffer = slot->buffer;
+    if (buffer == NULL)
+    {
+        buffer = (struct trace_buffer *) malloc(sizeof(struct trace_buffer));
+        if (buffer == NULL)
+        {
+            SDL_AtomicAdd(&slot->active, -1);
+            return;
+        }
+        buffer->head = 0;
+        SDL_AtomicSetPtr((void **) &slot->buffer, buffer);
+    }
+
+    head = buffer->head;
+    record = &buffer->records[head & (TRACE_BUFFER_SIZE - 1)];
+    record->time = trace_time();
+    record->name = name;
+    record->arg = arg;
+    record->phase = phase;
+    SDL_MemoryBarrierRelease();
+    buffer->head = head + 1;
+
+    SDL_AtomicAdd(&slot->active, -1);
+}
+
+/* called at each VI to follow the "Trace" parameter */
+void trace_update(void)
+{
+    int enable = ConfigGetParamBool(g_CoreConfig, "Trace");
+
+    if (enable && !g_TraceEnabled)
+        trace_start();
+    else if (!enable && g_TraceEnabled)
+        trace_stop();
+}
+
+/* called when the emulation stops */
+void trace_close(void)
+{
+    if (g_TraceEnabled)
+        trace_stop();
+}
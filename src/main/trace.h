@@ -0,0 +1,54 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - trace.h                                                 *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include "osal/preproc.h"
+
+/* Tracing of the core subsystems in the Chrome trace event format, see
+ * trace.c.  The event names must be string literals. */
+
+extern int g_TraceEnabled;
+
+void trace_event(char phase, const char *name, unsigned int arg);
+void trace_update(void);
+void trace_close(void);
+
+static osal_inline void trace_begin(const char *name)
+{
+    if (g_TraceEnabled)
+        trace_event('B', name, 0);
+}
+
+static osal_inline void trace_end(const char *name)
+{
+    if (g_TraceEnabled)
+        trace_event('E', name, 0);
+}
+
+static osal_inline void trace_instant(const char *name, unsigned int arg)
+{
+    if (g_TraceEnabled)
+        trace_event('i', name, arg);
+}
+
+#endif /* __TRACE_H__ */
@@ -79,6 +79,38 @@ file_status_t write_to_file(const char *filename, const void *data, size_t size)
     return file_ok;
 }
 
+file_status_t write_to_file_atomic(const char *filename, const void *data, size_t size)
+{
+    file_status_t status = file_ok;
+    char *tmpname;
+    FILE *f = osal_create_temp_file(filename, &tmpname);
+    if (f == NULL)
+    {
+        return file_open_error;
+    }
+
+    if (fwrite(data, 1, size, f) != size)
+    {
+        status = file_write_error;
+    }
+    if (fclose(f) != 0)
+    {
+        status = file_write_error;
+    }
+    if (status == file_ok && osal_replace_file(tmpname, filename) != 0)
+    {
+        status = file_write_error;
+    }
+
+    if (status != file_ok)
+    {
+        unlink(tmpname);
+    }
+
+    free(tmpname);
+    return status;
+}
+
 /**********************
    Byte swap utilities
  **********************/
@@ -54,6 +54,13 @@ file_status_t read_from_file(const char *filename, void *data, size_t size);
  */ 
 file_status_t write_to_file(const char *filename, const void *data, size_t size);
 
+/** write_to_file_atomic
+ *    writes the specified number of bytes to a uniquely named temporary file, then replaces
+ *    the given file with it, so that a crash never leaves a truncated file behind.
+ *    returns zero on sucess, nonzero on failure
+ */
+file_status_t write_to_file_atomic(const char *filename, const void *data, size_t size);
+
 /**********************
    Byte swap utilities
  **********************/
@@ -27,9 +27,9 @@
 #define MUPEN_CORE_NAME "Mupen64Plus Core"
 #define MUPEN_CORE_VERSION 0x020000
 
-#define FRONTEND_API_VERSION 0x020101
+#define FRONTEND_API_VERSION 0x020500
 #define CONFIG_API_VERSION   0x020300
-#define DEBUG_API_VERSION    0x020000
+#define DEBUG_API_VERSION    0x020100
 #define VIDEXT_API_VERSION   0x030000
 
 #define VERSION_PRINTF_SPLIT(x) (((x) >> 16) & 0xffff), (((x) >> 8) & 0xff), ((x) & 0xff)
@@ -25,7 +25,8 @@
 #include <SDL.h>
 #include <SDL_thread.h>
 
-#define WORKQUEUE_THREADS 1
+/* the work queue runs on one thread per spare CPU, up to this many */
+#define WORKQUEUE_MAX_THREADS 4
 
 struct workqueue_mgmt_globals {
     struct list_head work_queue;
@@ -42,6 +43,7 @@ struct workqueue_thread {
 };
 
 static struct workqueue_mgmt_globals workqueue_mgmt;
+static int workqueue_thread_count = 0;
 
 static void workqueue_dismiss(struct work_struct *work)
 {
@@ -92,7 +94,7 @@ static int workqueue_thread_handler(void *data)
 
 int workqueue_init(void)
 {
-    size_t i;
+    int i, count = 1;
     struct workqueue_thread *thread;
 
     memset(&workqueue_mgmt, 0, sizeof(workqueue_mgmt));
@@ -106,8 +108,16 @@ int workqueue_init(void)
         return -1;
     }
 
+#if SDL_VERSION_ATLEAST(2,0,0)
+    count = SDL_GetCPUCount() - 1;
+    if (count < 1)
+        count = 1;
+    else if (count > WORKQUEUE_MAX_THREADS)
+        count = WORKQUEUE_MAX_THREADS;
+#endif
+
     SDL_LockMutex(workqueue_mgmt.lock);
-    for (i = 0; i < WORKQUEUE_THREADS; i++) {
+    for (i = 0; i < count; i++) {
         thread = malloc(sizeof(*thread));
         if (!thread) {
             DebugMessage(M64MSG_ERROR, "Could not create workqueue thread management data");
@@ -135,6 +145,7 @@ int workqueue_init(void)
             SDL_UnlockMutex(workqueue_mgmt.lock);
             return -1;
         }
+        workqueue_thread_count++;
     }
     SDL_UnlockMutex(workqueue_mgmt.lock);
 
@@ -143,12 +154,12 @@ int workqueue_init(void)
 
 void workqueue_shutdown(void)
 {
-    size_t i;
+    int i;
     int status;
     struct work_struct *work;
     struct workqueue_thread *thread, *safe;
 
-    for (i = 0; i < WORKQUEUE_THREADS; i++) {
+    for (i = 0; i < workqueue_thread_count; i++) {
         work = malloc(sizeof(*work));
         init_work(work, workqueue_dismiss);
         queue_work(work);
@@ -165,6 +176,12 @@ void workqueue_shutdown(void)
         DebugMessage(M64MSG_WARNING, "Stopped workqueue with work still pending");
  
     SDL_DestroyMutex(workqueue_mgmt.lock);
+    workqueue_thread_count = 0;
+}
+
+int workqueue_threads(void)
+{
+    return workqueue_thread_count;
 }
 
 int queue_work(struct work_struct *work)
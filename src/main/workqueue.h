@@ -43,6 +43,7 @@ static osal_inline void init_work(struct work_struct *work, work_func_t func)
 int workqueue_init(void);
 void workqueue_shutdown(void);
 int queue_work(struct work_struct *work);
+int workqueue_threads(void);
 
 #else
 
@@ -61,6 +62,11 @@ static osal_inline int queue_work(struct work_struct *work)
     return 0;
 }
 
+static osal_inline int workqueue_threads(void)
+{
+    return 0;
+}
+
 #endif
 
 #endif
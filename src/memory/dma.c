@@ -43,78 +43,51 @@
 #include "api/callbacks.h"
 #include "main/main.h"
 #include "main/rom.h"
+#include "main/savemedia.h"
+#include "main/trace.h"
 #include "main/util.h"
 
 static unsigned char sram[0x8000];
-int delay_si = 0;
+static config_param l_DisableExtraMem = CONFIG_PARAM("Core", "DisableExtraMem");
 
-static char *get_sram_path(void)
-{
-    return formatstr("%s%s.sra", get_savesrampath(), ROM_SETTINGS.goodname);
-}
+/* rom to rdram dma statistics, see dma_report() */
+static unsigned int l_PiDmaWrites = 0;
+static unsigned long long l_PiDmaBytes = 0;
+static unsigned long long l_PiDmaPages = 0;
+
+int delay_si = 0;
 
 static void sram_format(void)
 {
     memset(sram, 0, sizeof(sram));
 }
 
-static void sram_read_file(void)
-{
-    char *filename = get_sram_path();
-
-    sram_format();
-    switch (read_from_file(filename, sram, sizeof(sram)))
-    {
-        case file_open_error:
-            DebugMessage(M64MSG_VERBOSE, "couldn't open sram file '%s' for reading", filename);
-            sram_format();
-            break;
-        case file_read_error:
-            DebugMessage(M64MSG_WARNING, "fread() failed on 32kb read from sram file '%s'", filename);
-            sram_format();
-            break;
-        default: break;
-    }
+static struct save_media sram_media = { "sram", "sra", sram, sizeof(sram), sram_format };
 
-    free(filename);
-}
-
-static void sram_write_file(void)
+void sram_open(void)
 {
-    char *filename = get_sram_path();
-
-    switch (write_to_file(filename, sram, sizeof(sram)))
-    {
-        case file_open_error:
-            DebugMessage(M64MSG_WARNING, "couldn't open sram file '%s' for writing.", filename);
-            break;
-        case file_write_error:
-            DebugMessage(M64MSG_WARNING, "fwrite() failed on 32kb write to sram file '%s'", filename);
-            break;
-        default: break;
-    }
-
-    free(filename);
+    savemedia_open(&sram_media);
 }
 
 void dma_pi_read(void)
 {
     unsigned int i;
 
+    trace_instant("pi.dma_read", (pi_register.pi_rd_len_reg & 0xFFFFFF) + 1);
+
     if (pi_register.pi_cart_addr_reg >= 0x08000000
             && pi_register.pi_cart_addr_reg < 0x08010000)
     {
         if (flashram_info.use_flashram != 1)
         {
-            sram_read_file();
-
             for (i=0; i < (pi_register.pi_rd_len_reg & 0xFFFFFF)+1; i++)
             {
                 sram[((pi_register.pi_cart_addr_reg-0x08000000)+i)^S8] =
                     ((unsigned char*)rdram)[(pi_register.pi_dram_addr_reg+i)^S8];
             }
 
-            sram_write_file();
+            savemedia_mark_dirty(&sram_media, pi_register.pi_cart_addr_reg-0x08000000,
+                                 (pi_register.pi_rd_len_reg & 0xFFFFFF)+1);
 
             flashram_info.use_flashram = -1;
         }
@@ -133,11 +106,85 @@ void dma_pi_read(void)
     add_interupt_event(PI_INT, 0x1000/*pi_register.pi_rd_len_reg*/);
 }
 
+/* Copies a part of the cartridge rom to rdram.  The rom is kept in the byte
+ * order of rdram, so when the source and destination have the same alignment
+ * the whole words between the unaligned head and tail are copied as they are.
+ */
+static void copy_rom_to_rdram(unsigned int dram_addr, unsigned int rom_addr, unsigned int length)
+{
+    unsigned char *dram = (unsigned char*)rdram;
+    unsigned int i = 0, words;
+
+    if (((dram_addr ^ rom_addr) & 3) == 0)
+    {
+        for (; i < length && ((dram_addr + i) & 3) != 0; i++)
+            dram[(dram_addr+i)^S8] = rom[(rom_addr+i)^S8];
+
+        words = (length - i) & ~3U;
+        memcpy(dram + dram_addr + i, rom + rom_addr + i, words);
+        i += words;
+    }
+
+    for (; i < length; i++)
+        dram[(dram_addr+i)^S8] = rom[(rom_addr+i)^S8];
+}
+
+/* Invalidates the code of a page written by a dma if any of the written
+ * instructions has been compiled. */
+static void invalidate_dma_page(unsigned int address, unsigned int length)
+{
+    unsigned int page = address >> 12;
+    unsigned int first = (address & 0xFFF) / 4;
+    unsigned int last = ((address & 0xFFF) + length - 1) / 4;
+    unsigned int i;
+
+    if (invalid_code[page])
+        return;
+
+    if (!blocks[page])
+    {
+        invalid_code[page] = 1;
+        return;
+    }
+
+    for (i = first; i <= last; i++)
+    {
+        if (blocks[page]->block[i].ops != current_instruction_table.NOTCOMPILED)
+        {
+            invalid_code[page] = 1;
+            return;
+        }
+    }
+}
+
+/* Checks each 4KB page written by a dma once, through both of its aliases. */
+static void invalidate_dma_pages(unsigned int dram_addr, unsigned int length)
+{
+    unsigned int end = dram_addr + length;
+    unsigned int addr, next;
+
+    for (addr = dram_addr; addr < end; addr = next)
+    {
+        next = (addr & ~0xFFFU) + 0x1000;
+        if (next > end)
+            next = end;
+
+#ifdef NEW_DYNAREC
+        if (!invalid_code[(addr+0x80000000)>>12])
+            invalidate_block((addr+0x80000000)>>12);
+#endif
+        invalidate_dma_page(addr+0x80000000, next - addr);
+        invalidate_dma_page(addr+0xa0000000, next - addr);
+    }
+}
+
 void dma_pi_write(void)
 {
-    unsigned int longueur;
+    unsigned int longueur, dram_addr, pages;
     int i;
 
+    trace_instant("pi.dma_write", (pi_register.pi_wr_len_reg & 0xFFFFFF) + 1);
+
     if (pi_register.pi_cart_addr_reg < 0x10000000)
     {
         if (pi_register.pi_cart_addr_reg >= 0x08000000
@@ -147,8 +194,6 @@ void dma_pi_write(void)
             {
                 int i;
 
-                sram_read_file();
-
                 for (i=0; i<(int)(pi_register.pi_wr_len_reg & 0xFFFFFF)+1; i++)
                 {
                     ((unsigned char*)rdram)[(pi_register.pi_dram_addr_reg+i)^S8]=
@@ -203,46 +248,17 @@ void dma_pi_write(void)
         return;
     }
 
+    dram_addr = pi_register.pi_dram_addr_reg;
+    copy_rom_to_rdram(dram_addr, i, longueur);
+
+    pages = (longueur == 0) ? 0 : ((dram_addr + longueur - 1) >> 12) - (dram_addr >> 12) + 1;
     if (r4300emu != CORE_PURE_INTERPRETER)
-    {
-        for (i=0; i<(int)longueur; i++)
-        {
-            unsigned long rdram_address1 = pi_register.pi_dram_addr_reg+i+0x80000000;
-            unsigned long rdram_address2 = pi_register.pi_dram_addr_reg+i+0xa0000000;
-            ((unsigned char*)rdram)[(pi_register.pi_dram_addr_reg+i)^S8]=
-                rom[(((pi_register.pi_cart_addr_reg-0x10000000)&0x3FFFFFF)+i)^S8];
+        invalidate_dma_pages(dram_addr, longueur);
 
-            if (!invalid_code[rdram_address1>>12])
-            {
-                if (!blocks[rdram_address1>>12] ||
-                    blocks[rdram_address1>>12]->block[(rdram_address1&0xFFF)/4].ops !=
-                    current_instruction_table.NOTCOMPILED)
-                {
-                    invalid_code[rdram_address1>>12] = 1;
-                }
-#ifdef NEW_DYNAREC
-                invalidate_block(rdram_address1>>12);
-#endif
-            }
-            if (!invalid_code[rdram_address2>>12])
-            {
-                if (!blocks[rdram_address1>>12] ||
-                    blocks[rdram_address2>>12]->block[(rdram_address2&0xFFF)/4].ops !=
-                    current_instruction_table.NOTCOMPILED)
-                {
-                    invalid_code[rdram_address2>>12] = 1;
-                }
-            }
-        }
-    }
-    else
-    {
-        for (i=0; i<(int)longueur; i++)
-        {
-            ((unsigned char*)rdram)[(pi_register.pi_dram_addr_reg+i)^S8]=
-                rom[(((pi_register.pi_cart_addr_reg-0x10000000)&0x3FFFFFF)+i)^S8];
-        }
-    }
+    trace_instant("pi.dma_write_pages", pages);
+    l_PiDmaWrites++;
+    l_PiDmaBytes += longueur;
+    l_PiDmaPages += pages;
 
     // Set the RDRAM memory size when copying main ROM code
     // (This is just a convenient way to run this code once at the beginning)
@@ -255,7 +271,7 @@ void dma_pi_write(void)
         case 3:
         case 6:
         {
-            if (ConfigGetParamInt(g_CoreConfig, "DisableExtraMem"))
+            if (ConfigParamInt(&l_DisableExtraMem))
             {
                 rdram[0x318/4] = 0x400000;
             }
@@ -267,7 +283,7 @@ void dma_pi_write(void)
         }
         case 5:
         {
-            if (ConfigGetParamInt(g_CoreConfig, "DisableExtraMem"))
+            if (ConfigParamInt(&l_DisableExtraMem))
             {
                 rdram[0x3F0/4] = 0x400000;
             }
@@ -287,6 +303,17 @@ void dma_pi_write(void)
     return;
 }
 
+/* logs the rom to rdram dma statistics of the run and resets them */
+void dma_report(void)
+{
+    DebugMessage(M64MSG_VERBOSE, "PI DMA: %u rom transfers, %llu bytes, %llu rdram pages",
+                 l_PiDmaWrites, l_PiDmaBytes, l_PiDmaPages);
+
+    l_PiDmaWrites = 0;
+    l_PiDmaBytes = 0;
+    l_PiDmaPages = 0;
+}
+
 void dma_sp_write(void)
 {
     unsigned int i,j;
@@ -303,6 +330,8 @@ void dma_sp_write(void)
     unsigned char *spmem = ((sp_register.sp_mem_addr_reg & 0x1000) != 0) ? (unsigned char*)SP_IMEM : (unsigned char*)SP_DMEM;
     unsigned char *dram = (unsigned char*)rdram;
 
+    trace_instant("sp.dma_write", length * count);
+
     for(j=0; j<count; j++) {
         for(i=0; i<length; i++) {
             spmem[memaddr^S8] = dram[dramaddr^S8];
@@ -329,6 +358,8 @@ void dma_sp_read(void)
     unsigned char *spmem = ((sp_register.sp_mem_addr_reg & 0x1000) != 0) ? (unsigned char*)SP_IMEM : (unsigned char*)SP_DMEM;
     unsigned char *dram = (unsigned char*)rdram;
 
+    trace_instant("sp.dma_read", length * count);
+
     for(j=0; j<count; j++) {
         for(i=0; i<length; i++) {
             dram[dramaddr^S8] = spmem[memaddr^S8];
@@ -343,6 +374,8 @@ void dma_si_write(void)
 {
     int i;
 
+    trace_instant("si.dma_write", 64);
+
     if (si_register.si_pif_addr_wr64b != 0x1FC007C0)
     {
         DebugMessage(M64MSG_ERROR, "dma_si_write(): unknown SI use");
@@ -370,6 +403,8 @@ void dma_si_read(void)
 {
     int i;
 
+    trace_instant("si.dma_read", 64);
+
     if (si_register.si_pif_addr_rd64b != 0x1FC007C0)
     {
         DebugMessage(M64MSG_ERROR, "dma_si_read(): unknown SI use");
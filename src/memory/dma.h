@@ -22,6 +22,8 @@
 #ifndef DMA_H
 #define DMA_H
 
+void sram_open(void);
+
 void dma_pi_write(void);
 void dma_pi_read(void);
 void dma_si_write(void);
@@ -29,5 +31,7 @@ void dma_si_read(void);
 void dma_sp_write(void);
 void dma_sp_read(void);
 
+void dma_report(void);
+
 #endif
 
@@ -32,6 +32,7 @@
 #include "api/callbacks.h"
 #include "main/main.h"
 #include "main/rom.h"
+#include "main/savemedia.h"
 #include "main/util.h"
 
 Flashram_info flashram_info;
@@ -47,52 +48,16 @@ typedef enum flashram_mode
 
 static unsigned char flashram[0x20000];
 
-static char *get_flashram_path(void)
-{
-    return formatstr("%s%s.fla", get_savesrampath(), ROM_SETTINGS.goodname);
-}
-
 static void flashram_format(void)
 {
     memset(flashram, 0xff, sizeof(flashram));
 }
 
-static void flashram_read_file(void)
-{
-    char *filename = get_flashram_path();
-
-    flashram_format();
-    switch (read_from_file(filename, flashram, sizeof(flashram)))
-    {
-        case file_open_error:
-            DebugMessage(M64MSG_WARNING, "couldn't open flash ram file '%s' for reading", filename);
-            flashram_format();
-            break;
-        case file_read_error:
-            DebugMessage(M64MSG_WARNING, "couldn't read 128kb flash ram file '%s'", filename);
-            break;
-        default: break;
-    }
+static struct save_media flashram_media = { "flash ram", "fla", flashram, sizeof(flashram), flashram_format };
 
-    free(filename);
-}
-
-static void flashram_write_file(void)
+void flashram_open(void)
 {
-    char *filename = get_flashram_path();
-
-    switch (write_to_file(filename, flashram, sizeof(flashram)))
-    {
-        case file_open_error:
-            DebugMessage(M64MSG_WARNING, "couldn't open flash ram file '%s' for writing", filename);
-            break;
-        case file_write_error:
-            DebugMessage(M64MSG_WARNING, "couldn't write 128kb flash ram file '%s'", filename);
-            break;
-        default: break;
-    }
-
-    free(filename);
+    savemedia_open(&flashram_media);
 }
 
 void init_flashram(void)
@@ -133,24 +98,22 @@ void flashram_command(unsigned int command)
         case ERASE_MODE:
         {
             unsigned int i;
-            flashram_read_file();
             for (i=flashram_info.erase_offset; i<(flashram_info.erase_offset+128); i++)
             {
                 flashram[i^S8] = 0xff;
             }
-            flashram_write_file();
+            savemedia_mark_dirty(&flashram_media, flashram_info.erase_offset, 128);
         }
         break;
         case WRITE_MODE:
         {
             int i;
-            flashram_read_file();
             for (i=0; i<128; i++)
             {
                 flashram[(flashram_info.erase_offset+i)^S8]=
                     ((unsigned char*)rdram)[(flashram_info.write_pointer+i)^S8];
             }
-            flashram_write_file();
+            savemedia_mark_dirty(&flashram_media, flashram_info.erase_offset, 128);
         }
         break;
         case STATUS_MODE:
@@ -187,7 +150,6 @@ void dma_read_flashram(void)
         rdram[pi_register.pi_dram_addr_reg/4+1] = (unsigned int)(flashram_info.status);
         break;
     case READ_MODE:
-        flashram_read_file();
         for (i=0; i<(pi_register.pi_wr_len_reg & 0x0FFFFFF)+1; i++)
         {
             ((unsigned char*)rdram)[(pi_register.pi_dram_addr_reg+i)^S8]=
@@ -29,6 +29,7 @@ typedef struct _flashram_info
 
 extern Flashram_info flashram_info;
 
+void flashram_open(void);
 void init_flashram(void);
 void flashram_command(unsigned int command);
 unsigned int flashram_status(void);
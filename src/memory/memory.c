@@ -46,8 +46,10 @@
 
 #include "api/callbacks.h"
 #include "main/main.h"
+#include "main/pacer.h"
 #include "main/profile.h"
 #include "main/rom.h"
+#include "main/trace.h"
 #include "osal/preproc.h"
 #include "plugin/plugin.h"
 #include "r4300/new_dynarec/new_dynarec.h"
@@ -1291,7 +1293,9 @@ static void do_SP_Task(void)
         //gfx.processDList();
         rsp_register.rsp_pc &= 0xFFF;
         timed_section_start(TIMED_SECTION_GFX);
+        trace_begin("rsp.doRspCycles gfx");
         rsp.doRspCycles(0xFFFFFFFF);
+        trace_end("rsp.doRspCycles gfx");
         timed_section_end(TIMED_SECTION_GFX);
         rsp_register.rsp_pc |= save_pc;
         new_frame();
@@ -1421,7 +1425,9 @@ static void do_SP_Task(void)
         //audio.processAList();
         rsp_register.rsp_pc &= 0xFFF;
         timed_section_start(TIMED_SECTION_AUDIO);
+        trace_begin("rsp.doRspCycles audio");
         rsp.doRspCycles(0xFFFFFFFF);
+        trace_end("rsp.doRspCycles audio");
         timed_section_end(TIMED_SECTION_AUDIO);
         rsp_register.rsp_pc |= save_pc;
 
@@ -1435,7 +1441,9 @@ static void do_SP_Task(void)
     else
     {
         rsp_register.rsp_pc &= 0xFFF;
+        trace_begin("rsp.doRspCycles");
         rsp.doRspCycles(0xFFFFFFFF);
+        trace_end("rsp.doRspCycles");
         rsp_register.rsp_pc |= save_pc;
 
         update_count();
@@ -2878,7 +2886,10 @@ void write_ai(void)
     {
     case 0x4:
         ai_register.ai_len = word;
+        trace_begin("audio.aiLenChanged");
         audio.aiLenChanged();
+        trace_end("audio.aiLenChanged");
+        pacer_ai_len_changed();
 
         freq = ROM_PARAMS.aidacrate / (ai_register.ai_dacrate+1);
         if (freq)
@@ -2936,7 +2947,10 @@ void write_aib(void)
         *((unsigned char*)&temp
           + ((*address_low&3)^S8) ) = cpu_byte;
         ai_register.ai_len = temp;
+        trace_begin("audio.aiLenChanged");
         audio.aiLenChanged();
+        trace_end("audio.aiLenChanged");
+        pacer_ai_len_changed();
 
         delay = (unsigned int) (((unsigned long long)ai_register.ai_len*(ai_register.ai_dacrate+1)*
                                     vi_register.vi_delay*ROM_PARAMS.vilimit)/ROM_PARAMS.aidacrate);
@@ -2996,7 +3010,10 @@ void write_aih(void)
         *((unsigned short*)((unsigned char*)&temp
                             + ((*address_low&3)^S16) )) = hword;
         ai_register.ai_len = temp;
+        trace_begin("audio.aiLenChanged");
         audio.aiLenChanged();
+        trace_end("audio.aiLenChanged");
+        pacer_ai_len_changed();
 
         delay = (unsigned int) (((unsigned long long)ai_register.ai_len*(ai_register.ai_dacrate+1)*
                                     vi_register.vi_delay*ROM_PARAMS.vilimit)/ROM_PARAMS.aidacrate);
@@ -3047,7 +3064,10 @@ void write_aid(void)
     case 0x0:
         ai_register.ai_dram_addr = (unsigned int) (dword >> 32);
         ai_register.ai_len = (unsigned int) (dword & 0xFFFFFFFF);
+        trace_begin("audio.aiLenChanged");
         audio.aiLenChanged();
+        trace_end("audio.aiLenChanged");
+        pacer_ai_len_changed();
 
         delay = (unsigned int) (((unsigned long long)ai_register.ai_len*(ai_register.ai_dacrate+1)*
                                     vi_register.vi_delay*ROM_PARAMS.vilimit)/ROM_PARAMS.aidacrate);
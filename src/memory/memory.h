@@ -22,18 +22,12 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+#include <stddef.h>
+
 #include "osal/preproc.h"
 
 int init_memory(int DoByteSwap);
 void free_memory(void);
-#define read_word_in_memory() readmem[address>>16]()
-#define read_byte_in_memory() readmemb[address>>16]()
-#define read_hword_in_memory() readmemh[address>>16]()
-#define read_dword_in_memory() readmemd[address>>16]()
-#define write_word_in_memory() writemem[address>>16]()
-#define write_byte_in_memory() writememb[address >>16]()
-#define write_hword_in_memory() writememh[address >>16]()
-#define write_dword_in_memory() writememd[address >>16]()
 extern unsigned int SP_DMEM[0x1000/4*2];
 extern unsigned char *SP_DMEMb;
 extern unsigned int *SP_IMEM;
@@ -43,6 +37,8 @@ extern unsigned char *PIF_RAMb;
 
 extern ALIGN(16, unsigned int rdram[0x800000/4]);
 
+extern int fast_memory;
+
 extern unsigned int address, word;
 extern unsigned char cpu_byte;
 extern unsigned short hword;
@@ -244,6 +240,98 @@ extern unsigned int CIC_Chip;
 
 #endif
 
+/* While fast_memory is set, the RDRAM and SP memory pages seen through KSEG0
+   and KSEG1 are plain memory, and the accessors below read and write them
+   directly instead of calling through the handler tables.  fast_memory is
+   cleared whenever one of these pages gets a handler which does more than
+   access memory (frame buffer tracking, debugger breakpoints). */
+static osal_inline unsigned char *fast_memory_pointer(unsigned int addr)
+{
+    if (fast_memory)
+    {
+        if ((addr & 0xDF800000) == 0x80000000)
+            return (unsigned char *) rdram + (addr & 0x7FFFFF);
+        if ((addr & 0xDFFFE000) == 0x84000000)
+            return (unsigned char *) SP_DMEM + (addr & 0x1FFF);
+    }
+    return NULL;
+}
+
+static osal_inline void read_word_in_memory(void)
+{
+    unsigned char *p = fast_memory_pointer(address);
+    if (p != NULL)
+        *rdword = *((unsigned int *) p);
+    else
+        readmem[address>>16]();
+}
+
+static osal_inline void read_byte_in_memory(void)
+{
+    unsigned char *p = fast_memory_pointer(address^S8);
+    if (p != NULL)
+        *rdword = *p;
+    else
+        readmemb[address>>16]();
+}
+
+static osal_inline void read_hword_in_memory(void)
+{
+    unsigned char *p = fast_memory_pointer(address^S16);
+    if (p != NULL)
+        *rdword = *((unsigned short *) p);
+    else
+        readmemh[address>>16]();
+}
+
+static osal_inline void read_dword_in_memory(void)
+{
+    unsigned char *p = fast_memory_pointer(address);
+    if (p != NULL)
+        *rdword = ((unsigned long long int)(*(unsigned int *) p) << 32) | *((unsigned int *)(p + 4));
+    else
+        readmemd[address>>16]();
+}
+
+static osal_inline void write_word_in_memory(void)
+{
+    unsigned char *p = fast_memory_pointer(address);
+    if (p != NULL)
+        *((unsigned int *) p) = word;
+    else
+        writemem[address>>16]();
+}
+
+static osal_inline void write_byte_in_memory(void)
+{
+    unsigned char *p = fast_memory_pointer(address^S8);
+    if (p != NULL)
+        *p = cpu_byte;
+    else
+        writememb[address>>16]();
+}
+
+static osal_inline void write_hword_in_memory(void)
+{
+    unsigned char *p = fast_memory_pointer(address^S16);
+    if (p != NULL)
+        *((unsigned short *) p) = hword;
+    else
+        writememh[address>>16]();
+}
+
+static osal_inline void write_dword_in_memory(void)
+{
+    unsigned char *p = fast_memory_pointer(address);
+    if (p != NULL)
+    {
+        *((unsigned int *) p) = (unsigned int) (dword >> 32);
+        *((unsigned int *)(p + 4)) = (unsigned int) (dword & 0xFFFFFFFF);
+    }
+    else
+        writememd[address>>16]();
+}
+
 void read_nothing(void);
 void read_nothingh(void);
 void read_nothingb(void);
@@ -36,62 +36,23 @@
 #include "api/debugger.h"
 #include "main/main.h"
 #include "main/rom.h"
+#include "main/savemedia.h"
 #include "main/util.h"
 #include "plugin/plugin.h"
 
 static unsigned char eeprom[0x800];
 static unsigned char mempack[4][0x8000];
 
-static char *get_eeprom_path(void)
-{
-    return formatstr("%s%s.eep", get_savesrampath(), ROM_SETTINGS.goodname);
-}
-
 static void eeprom_format(void)
 {
     memset(eeprom, 0xff, sizeof(eeprom));
 }
 
-static void eeprom_read_file(void)
-{
-    char *filename = get_eeprom_path();
-
-    switch (read_from_file(filename, eeprom, sizeof(eeprom)))
-    {
-        case file_open_error:
-            DebugMessage(M64MSG_VERBOSE, "couldn't open eeprom file '%s' for reading", filename);
-            eeprom_format();
-            break;
-        case file_read_error:
-            DebugMessage(M64MSG_WARNING, "fread() failed for 2kb eeprom file '%s'", filename);
-            break;
-        default: break;
-    }
-
-    free(filename);
-}
-
-static void eeprom_write_file(void)
-{
-    char *filename = get_eeprom_path();
-
-    switch (write_to_file(filename, eeprom, sizeof(eeprom)))
-    {
-        case file_open_error:
-            DebugMessage(M64MSG_WARNING, "couldn't open eeprom file '%s' for writing", filename);
-            break;
-        case file_write_error:
-            DebugMessage(M64MSG_WARNING, "fwrite() failed for 2kb eeprom file '%s'", filename);
-            break;
-        default: break;
-    }
-
-    free(filename);
-}
+static struct save_media eeprom_media = { "eeprom", "eep", eeprom, sizeof(eeprom), eeprom_format };
 
-static char *get_mempack_path(void)
+void eeprom_open(void)
 {
-    return formatstr("%s%s.mpk", get_savesrampath(), ROM_SETTINGS.goodname);
+    savemedia_open(&eeprom_media);
 }
 
 static void mempack_format(void)
@@ -128,41 +89,11 @@ static void mempack_format(void)
     }
 }
 
-static void mempack_read_file(void)
-{
-    char *filename = get_mempack_path();
-
-    switch (read_from_file(filename, mempack, sizeof(mempack)))
-    {
-        case file_open_error:
-            DebugMessage(M64MSG_VERBOSE, "couldn't open memory pack file '%s' for reading", filename);
-            mempack_format();
-            break;
-        case file_read_error:
-            DebugMessage(M64MSG_WARNING, "fread() failed for 128kb mempack file '%s'", filename);
-            break;
-        default: break;
-    }
+static struct save_media mempack_media = { "memory pack", "mpk", (unsigned char *) mempack, sizeof(mempack), mempack_format };
 
-    free(filename);
-}
-
-static void mempack_write_file(void)
+void mempack_open(void)
 {
-    char *filename = get_mempack_path();
-
-    switch (write_to_file(filename, mempack, sizeof(mempack)))
-    {
-        case file_open_error:
-            DebugMessage(M64MSG_WARNING, "couldn't open memory pack file '%s' for writing", filename);
-            break;
-        case file_write_error:
-            DebugMessage(M64MSG_WARNING, "fwrite() failed for 128kb mempack file '%s'", filename);
-            break;
-        default: break;
-    }
-
-    free(filename);
+    savemedia_open(&mempack_media);
 }
 
 //#define DEBUG_PIF
@@ -216,7 +147,6 @@ static void EepromCommand(unsigned char *Command)
 #ifdef DEBUG_PIF
         DebugMessage(M64MSG_INFO, "EepromCommand() read 8-byte block %i", Command[3]);
 #endif
-        eeprom_read_file();
         memcpy(&Command[4], eeprom + Command[3]*8, 8);
     }
     break;
@@ -225,9 +155,8 @@ static void EepromCommand(unsigned char *Command)
 #ifdef DEBUG_PIF
         DebugMessage(M64MSG_INFO, "EepromCommand() write 8-byte block %i", Command[3]);
 #endif
-        eeprom_read_file();
         memcpy(eeprom + Command[3]*8, &Command[4], 8);
-        eeprom_write_file();
+        savemedia_mark_dirty(&eeprom_media, Command[3]*8, 8);
     }
     break;
     case 6:
@@ -397,7 +326,6 @@ static void internal_ControllerCommand(int Control, unsigned char *Command)
                     address &= 0xFFE0;
                     if (address <= 0x7FE0)
                     {
-                        mempack_read_file();
                         memcpy(&Command[5], &mempack[Control][address], 0x20);
                     }
                     else
@@ -444,9 +372,8 @@ static void internal_ControllerCommand(int Control, unsigned char *Command)
                     address &= 0xFFE0;
                     if (address <= 0x7FE0)
                     {
-                        mempack_read_file();
                         memcpy(&mempack[Control][address], &Command[5], 0x20);
-                        mempack_write_file();
+                        savemedia_mark_dirty(&mempack_media, Control*0x8000 + address, 0x20);
                     }
                     Command[0x25] = mempack_crc(&Command[5]);
                 }
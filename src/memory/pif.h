@@ -22,6 +22,9 @@
 #ifndef PIF_H
 #define PIF_H
 
+void eeprom_open(void);
+void mempack_open(void);
+
 void update_pif_write(void);
 void update_pif_read(void);
 
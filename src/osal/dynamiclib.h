@@ -26,5 +26,12 @@
 
 void *     osal_dynlib_getproc(m64p_dynlib_handle LibHandle, const char *pccProcedureName);
 
+/* Load a new, independent copy of the library containing 'pSymbol', with its
+ * own copy of every global variable.  The copy is unloaded with
+ * osal_dynlib_close_copy().
+ */
+m64p_error osal_dynlib_open_copy(m64p_dynlib_handle *pLibHandle, const void *pSymbol);
+m64p_error osal_dynlib_close_copy(m64p_dynlib_handle LibHandle);
+
 #endif /* #define OSAL_DYNAMICLIB_H */
 
@@ -19,12 +19,19 @@
  *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
+#if !defined(_GNU_SOURCE)
+  #define _GNU_SOURCE  // for dladdr()
+#endif
 #include <stdlib.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <dlfcn.h>
 
 #include "api/m64p_types.h"
 #include "api/callbacks.h"
 #include "dynamiclib.h"
+#include "files.h"
 
 void * osal_dynlib_getproc(m64p_dynlib_handle LibHandle, const char *pccProcedureName)
 {
@@ -33,3 +40,70 @@ void * osal_dynlib_getproc(m64p_dynlib_handle LibHandle, const char *pccProcedur
 
     return dlsym(LibHandle, pccProcedureName);
 }
+
+m64p_error osal_dynlib_open_copy(m64p_dynlib_handle *pLibHandle, const void *pSymbol)
+{
+    char copypath[PATH_MAX], buffer[65536];
+    const char *tmpdir;
+    Dl_info info;
+    ssize_t len = 0;
+    int src, dst, failed = 0;
+
+    if (pLibHandle == NULL || pSymbol == NULL)
+        return M64ERR_INPUT_ASSERT;
+
+    if (dladdr(pSymbol, &info) == 0 || info.dli_fname == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "dladdr() couldn't find the library containing %p", pSymbol);
+        return M64ERR_SYSTEM_FAIL;
+    }
+
+    /* dlopen() returns the already loaded library for the same file, so load it from a temporary copy */
+    tmpdir = getenv("TMPDIR");
+    snprintf(copypath, PATH_MAX, "%s/libmupen64plus-XXXXXX", (tmpdir != NULL && tmpdir[0] != '\0') ? tmpdir : "/tmp");
+    src = open(info.dli_fname, O_RDONLY);
+    dst = mkstemp(copypath);
+    while (src >= 0 && dst >= 0 && (len = read(src, buffer, sizeof(buffer))) > 0)
+    {
+        if (write(dst, buffer, len) != len)
+            failed = 1;
+    }
+    if (src < 0 || dst < 0 || len < 0)
+        failed = 1;
+    if (src >= 0)
+        close(src);
+    if (dst >= 0)
+        close(dst);
+
+    if (failed)
+    {
+        DebugMessage(M64MSG_ERROR, "couldn't copy '%s' to a temporary file", info.dli_fname);
+        if (dst >= 0)
+            unlink(copypath);
+        return M64ERR_SYSTEM_FAIL;
+    }
+
+    /* the temporary file is not needed anymore once it is mapped */
+    *pLibHandle = dlopen(copypath, RTLD_NOW | RTLD_LOCAL);
+    unlink(copypath);
+    if (*pLibHandle == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "dlopen('%s') failed: %s", copypath, dlerror());
+        return M64ERR_SYSTEM_FAIL;
+    }
+
+    return M64ERR_SUCCESS;
+}
+
+m64p_error osal_dynlib_close_copy(m64p_dynlib_handle LibHandle)
+{
+    int rval = dlclose(LibHandle);
+
+    if (rval != 0)
+    {
+        DebugMessage(M64MSG_ERROR, "dlclose() failed: %s", dlerror());
+        return M64ERR_INTERNAL;
+    }
+
+    return M64ERR_SUCCESS;
+}
@@ -24,6 +24,7 @@
 #include <stdio.h>
 
 #include "api/m64p_types.h"
+#include "api/callbacks.h"
 #include "dynamiclib.h"
 
 void * osal_dynlib_getproc(m64p_dynlib_handle LibHandle, const char *pccProcedureName)
@@ -33,3 +34,52 @@ void * osal_dynlib_getproc(m64p_dynlib_handle LibHandle, const char *pccProcedur
 
     return GetProcAddress(LibHandle, pccProcedureName);
 }
+
+m64p_error osal_dynlib_open_copy(m64p_dynlib_handle *pLibHandle, const void *pSymbol)
+{
+    char libpath[MAX_PATH], tmpdir[MAX_PATH], copypath[MAX_PATH];
+    HMODULE module;
+
+    if (pLibHandle == NULL || pSymbol == NULL)
+        return M64ERR_INPUT_ASSERT;
+
+    if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                            (LPCSTR) pSymbol, &module) ||
+        GetModuleFileNameA(module, libpath, MAX_PATH) == 0)
+    {
+        DebugMessage(M64MSG_ERROR, "couldn't find the library containing %p", pSymbol);
+        return M64ERR_SYSTEM_FAIL;
+    }
+
+    /* Windows maps a module only once per file name, so load it from a temporary copy */
+    if (GetTempPathA(MAX_PATH, tmpdir) == 0 || GetTempFileNameA(tmpdir, "m64", 0, copypath) == 0 ||
+        !CopyFileA(libpath, copypath, FALSE))
+    {
+        DebugMessage(M64MSG_ERROR, "couldn't copy '%s' to a temporary file", libpath);
+        return M64ERR_SYSTEM_FAIL;
+    }
+
+    *pLibHandle = LoadLibraryA(copypath);
+    if (*pLibHandle == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "LoadLibrary('%s') error: %08lx", copypath, (unsigned long) GetLastError());
+        DeleteFileA(copypath);
+        return M64ERR_SYSTEM_FAIL;
+    }
+
+    return M64ERR_SUCCESS;
+}
+
+m64p_error osal_dynlib_close_copy(m64p_dynlib_handle LibHandle)
+{
+    char copypath[MAX_PATH];
+
+    if (GetModuleFileNameA(LibHandle, copypath, MAX_PATH) == 0 || !FreeLibrary(LibHandle))
+    {
+        DebugMessage(M64MSG_ERROR, "FreeLibrary() error: %08lx", (unsigned long) GetLastError());
+        return M64ERR_INTERNAL;
+    }
+    DeleteFileA(copypath);
+
+    return M64ERR_SUCCESS;
+}
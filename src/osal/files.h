@@ -26,6 +26,9 @@
 #if !defined (OSAL_FILES_H)
 #define OSAL_FILES_H
 
+#include <stddef.h>
+#include <stdio.h>
+
 /* some file-related preprocessor definitions */
 #if defined(WIN32) && !defined(__MINGW32__)
   #include <io.h> // For _unlink()
@@ -51,6 +54,26 @@
  */
 extern int osal_mkdirp(const char *dirpath, int mode);
 
+/* Replace the file 'dst' by the file 'src' in a single step, after making sure
+ * the contents of 'src' have reached the disk.  If this fails, 'dst' is left untouched.
+ * Returns zero on success, nonzero on failure.
+ */
+extern int osal_replace_file(const char *src, const char *dst);
+
+/* Create a new file with a unique name in the directory of 'filename', to be written
+ * and then moved over 'filename' by osal_replace_file().  On success the file is
+ * returned open for writing and its malloc'd name is stored in 'tmpname'; NULL is
+ * returned on failure.
+ */
+extern FILE * osal_create_temp_file(const char *filename, char **tmpname);
+
+/* Map the whole file 'filename' read-only into memory.  The pages are shared with
+ * every other process mapping the same file.  On success the mapping address is
+ * returned and its length stored in 'size'; NULL is returned on failure.
+ */
+extern void * osal_map_file(const char *filename, size_t *size);
+extern void osal_unmap_file(void *ptr, size_t size);
+
 extern const char * osal_get_shared_filepath(const char *filename, const char *firstsearch, const char *secondsearch);
 extern const char * osal_get_user_configpath(void);
 extern const char * osal_get_user_datapath(void);
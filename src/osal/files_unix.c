@@ -25,6 +25,8 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
@@ -177,6 +179,96 @@ int osal_mkdirp(const char *dirpath, int mode)
     return 0;
 }
 
+int osal_replace_file(const char *src, const char *dst)
+{
+    int fd;
+
+    // Flush the new contents to disk before they become visible under the final name
+    fd = open(src, O_RDONLY);
+    if (fd < 0)
+        return 1;
+    if (fsync(fd) != 0)
+    {
+        close(fd);
+        return 1;
+    }
+    close(fd);
+
+    // rename() atomically replaces an existing destination file
+    if (rename(src, dst) != 0)
+        return 1;
+
+    return 0;
+}
+
+FILE * osal_create_temp_file(const char *filename, char **tmpname)
+{
+    struct stat fileinfo;
+    char *name;
+    FILE *f;
+    int fd;
+
+    name = (char *) malloc(strlen(filename) + 8);
+    if (name == NULL)
+        return NULL;
+    sprintf(name, "%s.XXXXXX", filename);
+
+    fd = mkstemp(name);
+    if (fd < 0)
+    {
+        free(name);
+        return NULL;
+    }
+
+    // mkstemp() makes the file private: keep the permissions of the file it replaces
+    if (stat(filename, &fileinfo) == 0)
+        fchmod(fd, fileinfo.st_mode & 0777);
+    else
+        fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+    f = fdopen(fd, "wb");
+    if (f == NULL)
+    {
+        close(fd);
+        unlink(name);
+        free(name);
+        return NULL;
+    }
+
+    *tmpname = name;
+    return f;
+}
+
+void * osal_map_file(const char *filename, size_t *size)
+{
+    struct stat fileinfo;
+    void *ptr;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &fileinfo) != 0 || fileinfo.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    ptr = mmap(NULL, (size_t) fileinfo.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if (ptr == MAP_FAILED)
+        return NULL;
+
+    *size = (size_t) fileinfo.st_size;
+    return ptr;
+}
+
+void osal_unmap_file(void *ptr, size_t size)
+{
+    munmap(ptr, size);
+}
+
 const char * osal_get_shared_filepath(const char *filename, const char *firstsearch, const char *secondsearch)
 {
     static char retpath[PATH_MAX];
@@ -25,6 +25,8 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <io.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -125,6 +127,86 @@ errorexit:
 	return 1;
 }
 
+int osal_replace_file(const char *src, const char *dst)
+{
+    if (!MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        return 1;
+
+    return 0;
+}
+
+FILE * osal_create_temp_file(const char *filename, char **tmpname)
+{
+    size_t length = strlen(filename) + 8;
+    char *name;
+    FILE *f;
+    int fd = -1, tries;
+
+    name = (char *) malloc(length);
+    if (name == NULL)
+        return NULL;
+
+    // _mktemp_s() only picks a free name, _O_EXCL fails if another thread took it since
+    for (tries = 0; tries < 26 && fd < 0; tries++)
+    {
+        sprintf(name, "%s.XXXXXX", filename);
+        if (_mktemp_s(name, length) != 0)
+            break;
+        fd = _open(name, _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY, _S_IREAD | _S_IWRITE);
+    }
+    if (fd < 0)
+    {
+        free(name);
+        return NULL;
+    }
+
+    f = _fdopen(fd, "wb");
+    if (f == NULL)
+    {
+        _close(fd);
+        _unlink(name);
+        free(name);
+        return NULL;
+    }
+
+    *tmpname = name;
+    return f;
+}
+
+void * osal_map_file(const char *filename, size_t *size)
+{
+    HANDLE file, mapping;
+    LARGE_INTEGER filesize;
+    void *ptr;
+
+    file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+    if (!GetFileSizeEx(file, &filesize) || filesize.QuadPart <= 0)
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return NULL;
+    ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    /* the view keeps its own reference to the mapping object */
+    CloseHandle(mapping);
+    if (ptr == NULL)
+        return NULL;
+
+    *size = (size_t) filesize.QuadPart;
+    return ptr;
+}
+
+void osal_unmap_file(void *ptr, size_t size)
+{
+    UnmapViewOfFile(ptr);
+}
+
 const char * osal_get_shared_filepath(const char *filename, const char *firstsearch, const char *secondsearch)
 {
     static char retpath[_MAX_PATH];
@@ -30,6 +30,7 @@
   #define OSAL_BREAKPOINT_INTERRUPT __asm{ int 3 };
   #define ALIGN(BYTES,DATA) __declspec(align(BYTES)) DATA
   #define osal_inline __inline
+  #define osal_thread_local __declspec(thread)
 
   /* string functions */
   #define osal_insensitive_strcmp(x, y) _stricmp(x, y)
@@ -46,6 +47,7 @@
   #define OSAL_BREAKPOINT_INTERRUPT __asm__(" int $3; ");
   #define ALIGN(BYTES,DATA) DATA __attribute__((aligned(BYTES)))
   #define osal_inline inline
+  #define osal_thread_local __thread
 
   /* string functions */
   #define osal_insensitive_strcmp(x, y) strcasecmp(x, y)
@@ -0,0 +1,296 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - block_profiler.c                                        *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/* Sampling profiler of the guest code blocks.
+ *
+ * The cores call block_profiler_entry() each time they enter a block of
+ * guest code through their jump dispatcher:
+ *  - the cached interpreter and the old dynarec in jump_to_func(), the
+ *    dynarec doesn't link its jumps between pages while profiling so that
+ *    they all go through it,
+ *  - the new dynarec links its blocks directly, so it is sampled at each
+ *    interrupt check instead, with the address it is about to run.
+ *
+ * Only one entry out of every l_Period is sampled: its block gets l_Period
+ * entries and, at the next entry, l_Period times the CP0 Count cycles spent
+ * since the sample.  The counters are kept in an open addressing hash table
+ * keyed by the guest address of the block, blocks which don't fit anymore
+ * are counted in l_Dropped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+#include <SDL_thread.h>
+
+#include "api/m64p_types.h"
+#include "api/callbacks.h"
+#include "block_profiler.h"
+#include "cp0.h"
+
+#define BLOCK_PROFILER_SIZE 0x8000 /* power of two */
+
+struct block_profile
+{
+    unsigned int address;
+    unsigned int used;
+    unsigned long long entries;
+    unsigned long long cycles;
+};
+
+/* global variables */
+int g_BlockProfilerEnabled = 0;
+unsigned int g_BlockProfilerCountdown = 0;
+
+/* local variables */
+static SDL_mutex *l_Lock = NULL;
+static struct block_profile l_Blocks[BLOCK_PROFILER_SIZE];
+static unsigned int l_Used = 0;
+static unsigned int l_Dropped = 0;
+static unsigned int l_Period = 1;
+
+/* block of the last sample, until the next entry */
+static struct block_profile *l_Current = NULL;
+static unsigned int l_CurrentCount = 0;
+
+static struct block_profile *block_profiler_lookup(unsigned int addr)
+{
+    unsigned int i = ((addr >> 2) * 2654435761u) & (BLOCK_PROFILER_SIZE - 1);
+
+    while (l_Blocks[i].used)
+    {
+        if (l_Blocks[i].address == addr)
+            return &l_Blocks[i];
+        i = (i + 1) & (BLOCK_PROFILER_SIZE - 1);
+    }
+
+    /* keep some room free so that the probing stays short */
+    if (l_Used >= BLOCK_PROFILER_SIZE - BLOCK_PROFILER_SIZE / 4)
+    {
+        l_Dropped++;
+        return NULL;
+    }
+
+    l_Used++;
+    l_Blocks[i].used = 1;
+    l_Blocks[i].address = addr;
+    return &l_Blocks[i];
+}
+
+static int block_profiler_compare(const void *a, const void *b)
+{
+    const struct block_profile *pa = *(const struct block_profile * const *) a;
+    const struct block_profile *pb = *(const struct block_profile * const *) b;
+
+    if (pa->cycles != pb->cycles)
+        return (pa->cycles < pb->cycles) ? 1 : -1;
+    if (pa->entries != pb->entries)
+        return (pa->entries < pb->entries) ? 1 : -1;
+    return (pa->address < pb->address) ? -1 : 1;
+}
+
+/* returns the used entries sorted by decreasing cycles, to be freed by the caller */
+static struct block_profile **block_profiler_sort(void)
+{
+    struct block_profile **sorted;
+    unsigned int i, n = 0;
+
+    sorted = (struct block_profile **) malloc((l_Used + 1) * sizeof(struct block_profile *));
+    if (sorted == NULL)
+        return NULL;
+
+    for (i = 0; i < BLOCK_PROFILER_SIZE; i++)
+    {
+        if (l_Blocks[i].used)
+            sorted[n++] = &l_Blocks[i];
+    }
+    qsort(sorted, n, sizeof(struct block_profile *), block_profiler_compare);
+    return sorted;
+}
+
+/* Global Functions */
+
+/* called on the emulation thread when the countdown expires */
+void block_profiler_sample(unsigned int addr)
+{
+    unsigned int count = g_cp0_regs[CP0_COUNT_REG];
+
+    SDL_LockMutex(l_Lock);
+
+    if (!g_BlockProfilerEnabled)
+    {
+        SDL_UnlockMutex(l_Lock);
+        return;
+    }
+
+    /* the entry following a sample ends the measure of its block */
+    if (l_Current != NULL)
+    {
+        l_Current->cycles += (unsigned long long) (count - l_CurrentCount) * l_Period;
+        l_Current = NULL;
+        if (l_Period > 1)
+        {
+            g_BlockProfilerCountdown = l_Period - 1;
+            SDL_UnlockMutex(l_Lock);
+            return;
+        }
+    }
+
+    l_Current = block_profiler_lookup(addr);
+    if (l_Current != NULL)
+    {
+        l_Current->entries += l_Period;
+        l_CurrentCount = count;
+        g_BlockProfilerCountdown = 1;
+    }
+    else
+        g_BlockProfilerCountdown = l_Period;
+
+    SDL_UnlockMutex(l_Lock);
+}
+
+/* clears the counters and starts sampling one block entry out of every period */
+m64p_error block_profiler_start(unsigned int period)
+{
+    if (period == 0)
+        return M64ERR_INPUT_INVALID;
+
+    if (l_Lock == NULL)
+    {
+        l_Lock = SDL_CreateMutex();
+        if (l_Lock == NULL)
+        {
+            DebugMessage(M64MSG_ERROR, "Couldn't create the block profiler mutex: %s", SDL_GetError());
+            return M64ERR_SYSTEM_FAIL;
+        }
+    }
+
+    SDL_LockMutex(l_Lock);
+    memset(l_Blocks, 0, sizeof(l_Blocks));
+    l_Used = l_Dropped = 0;
+    l_Period = period;
+    l_Current = NULL;
+    g_BlockProfilerCountdown = period;
+    g_BlockProfilerEnabled = 1;
+    SDL_UnlockMutex(l_Lock);
+
+    DebugMessage(M64MSG_INFO, "Block profiler started, sampling 1 block entry out of %u", period);
+    return M64ERR_SUCCESS;
+}
+
+/* stops sampling, the counters stay available until the next start */
+void block_profiler_stop(void)
+{
+    if (l_Lock == NULL)
+        return;
+
+    SDL_LockMutex(l_Lock);
+    if (g_BlockProfilerEnabled)
+    {
+        g_BlockProfilerEnabled = 0;
+        l_Current = NULL;
+        DebugMessage(M64MSG_INFO, "Block profiler stopped, %u blocks profiled, %u dropped", l_Used, l_Dropped);
+    }
+    SDL_UnlockMutex(l_Lock);
+}
+
+/* copies the count blocks with the most cycles, returns how many were copied */
+int block_profiler_get_top(m64p_profile_block *blocks, int count)
+{
+    struct block_profile **sorted;
+    int i, n;
+
+    if (l_Lock == NULL || blocks == NULL || count <= 0)
+        return 0;
+
+    SDL_LockMutex(l_Lock);
+    sorted = block_profiler_sort();
+    if (sorted == NULL)
+    {
+        SDL_UnlockMutex(l_Lock);
+        return 0;
+    }
+
+    n = (count < (int) l_Used) ? count : (int) l_Used;
+    for (i = 0; i < n; i++)
+    {
+        blocks[i].address = sorted[i]->address;
+        blocks[i].entries = sorted[i]->entries;
+        blocks[i].cycles = sorted[i]->cycles;
+    }
+    SDL_UnlockMutex(l_Lock);
+
+    free(sorted);
+    return n;
+}
+
+/* Writes the cycles of every block in the folded stack format of the flame
+ * graph tools: one "r4300;<guest pc> <cycles>" line per block. */
+m64p_error block_profiler_dump(const char *filepath)
+{
+    struct block_profile **sorted;
+    unsigned int i;
+    FILE *f;
+
+    if (filepath == NULL)
+        return M64ERR_INPUT_ASSERT;
+    if (l_Lock == NULL)
+        return M64ERR_INVALID_STATE;
+
+    f = fopen(filepath, "w");
+    if (f == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Couldn't open block profile file '%s' for writing", filepath);
+        return M64ERR_FILES;
+    }
+
+    SDL_LockMutex(l_Lock);
+    sorted = block_profiler_sort();
+    if (sorted != NULL)
+    {
+        for (i = 0; i < l_Used; i++)
+            fprintf(f, "r4300;0x%08x %llu\n", sorted[i]->address, sorted[i]->cycles);
+    }
+    SDL_UnlockMutex(l_Lock);
+
+    free(sorted);
+    fclose(f);
+
+    if (sorted == NULL)
+        return M64ERR_NO_MEMORY;
+
+    DebugMessage(M64MSG_INFO, "Block profile written to '%s'", filepath);
+    return M64ERR_SUCCESS;
+}
+
+/* called by CoreShutdown() */
+void block_profiler_shutdown(void)
+{
+    if (l_Lock == NULL)
+        return;
+
+    block_profiler_stop();
+    SDL_DestroyMutex(l_Lock);
+    l_Lock = NULL;
+}
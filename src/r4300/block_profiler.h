@@ -0,0 +1,49 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - block_profiler.h                                        *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_R4300_BLOCK_PROFILER_H
+#define M64P_R4300_BLOCK_PROFILER_H
+
+#include "api/m64p_types.h"
+#include "osal/preproc.h"
+
+/* Sampling profiler of the guest code blocks, see block_profiler.c. */
+
+extern int g_BlockProfilerEnabled;
+extern unsigned int g_BlockProfilerCountdown;
+
+void block_profiler_sample(unsigned int addr);
+
+m64p_error block_profiler_start(unsigned int period);
+void block_profiler_stop(void);
+int block_profiler_get_top(m64p_profile_block *blocks, int count);
+m64p_error block_profiler_dump(const char *filepath);
+void block_profiler_shutdown(void);
+
+/* called by the cores each time a block of guest code is entered at addr */
+static osal_inline void block_profiler_entry(unsigned int addr)
+{
+    if (g_BlockProfilerEnabled && --g_BlockProfilerCountdown == 0)
+        block_profiler_sample(addr);
+}
+
+#endif /* M64P_R4300_BLOCK_PROFILER_H */
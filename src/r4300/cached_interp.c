@@ -27,13 +27,18 @@
 #include "memory/memory.h"
 
 #include "r4300.h"
+#include "block_profiler.h"
 #include "cp0.h"
 #include "cp1.h"
 #include "ops.h"
 #include "exception.h"
+#include "idle_loop.h"
 #include "interupt.h"
 #include "macros.h"
 #include "recomp.h"
+#include "recomp_async.h"
+#include "recomp_cache.h"
+#include "recomp_link.h"
 #include "tlb.h"
 
 #ifdef DBG
@@ -134,7 +139,11 @@ unsigned int jump_to_address;
       { \
          update_count(); \
          skip = next_interupt - g_cp0_regs[CP0_COUNT_REG]; \
-         if (skip > 3) g_cp0_regs[CP0_COUNT_REG] += (skip & 0xFFFFFFFC); \
+         if (skip > 3) \
+         { \
+            g_cp0_regs[CP0_COUNT_REG] += (skip & 0xFFFFFFFC); \
+            g_IdleLoopCycles += (skip & 0xFFFFFFFC); \
+         } \
          else name(); \
       } \
       else name(); \
@@ -203,7 +212,19 @@ static void NOTCOMPILED(void)
 #endif
 
    if (mem != NULL)
-      recompile_block((int *)mem, blocks[PC->addr >> 12], PC->addr);
+   {
+      /* a page restored from the translation cache may not hold this entry point yet */
+      if (!recomp_cache_restore(blocks[PC->addr >> 12]) || PC->ops == current_instruction_table.NOTCOMPILED)
+      {
+         /* a new page may be compiled in the background and interpreted meanwhile */
+         if (recomp_async_execute(blocks[PC->addr >> 12]))
+         {
+            dyna_jump();
+            return;
+         }
+         recompile_block((int *)mem, blocks[PC->addr >> 12], PC->addr);
+      }
+   }
    else
       DebugMessage(M64MSG_ERROR, "not compiled exception");
 
@@ -536,6 +557,7 @@ void jump_to_func(void)
    if (skip_jump) return;
    paddr = update_invalid_addr(addr);
    if (!paddr) return;
+   block_profiler_entry(addr);
    actual = blocks[addr>>12];
    if (invalid_code[addr>>12])
      {
@@ -545,8 +567,10 @@ void jump_to_func(void)
          actual = blocks[addr>>12];
          blocks[addr>>12]->code = NULL;
          blocks[addr>>12]->block = NULL;
+         blocks[addr>>12]->infos = NULL;
          blocks[addr>>12]->jumps_table = NULL;
          blocks[addr>>12]->riprel_table = NULL;
+         blocks[addr>>12]->imm64_table = NULL;
       }
     blocks[addr>>12]->start = addr & ~0xFFF;
     blocks[addr>>12]->end = (addr & ~0xFFF) + 0x1000;
@@ -566,15 +590,18 @@ void init_blocks(void)
       invalid_code[i] = 1;
       blocks[i] = NULL;
    }
+   save_host_mxcsr();
 }
 
 void free_blocks(void)
 {
    int i;
+   recomp_async_discard_all();
    for (i=0; i<0x100000; i++)
    {
         if (blocks[i])
         {
+            recomp_link_clear(blocks[i]);
             free_block(blocks[i]);
             free(blocks[i]);
             blocks[i] = NULL;
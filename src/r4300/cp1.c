@@ -21,6 +21,10 @@
 
 #include "new_dynarec/new_dynarec.h"
 
+#if defined(__x86_64__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
 #if NEW_DYNAREC != NEW_DYNAREC_ARM
 float *reg_cop1_simple[32];
 double *reg_cop1_double[32];
@@ -35,6 +39,15 @@ long long int reg_cop1_fgr_64[32];
 int rounding_mode = 0x33F, trunc_mode = 0xF3F, round_mode = 0x33F,
     ceil_mode = 0xB3F, floor_mode = 0x73F;
 
+/* MXCSR images for the SSE2 COP1 code: host_mxcsr is the one of the
+   emulation thread, restored after each rounding COP1 operation so that C
+   and plugin code never run with the guest rounding mode. rounding_mxcsr
+   follows the FCR31 rounding mode and is only loaded when it differs from
+   host_mxcsr, the others force one mode. */
+unsigned int host_mxcsr = 0x1F80, rounding_mxcsr = 0x1F80,
+    round_mxcsr = 0x1F80, ceil_mxcsr = 0x5F80, floor_mxcsr = 0x3F80;
+unsigned int rounding_mxcsr_differs = 0;
+
 /* Refer to Figure 6-2 on page 155 and explanation on page B-11
    of MIPS R4000 Microprocessor User's Manual (Second Edition)
    by Joe Heinrich.
@@ -118,3 +131,24 @@ void set_fpr_pointers(int newStatus)
         }
     }
 }
+
+void update_rounding_mxcsr(void)
+{
+    /* the exceptions stay masked, the MXCSR rounding control of the
+       FCR31 rounding mode m is (-m) & 3 */
+    unsigned int base = (host_mxcsr & ~0x6000) | 0x1F80;
+
+    round_mxcsr = base;
+    ceil_mxcsr = base | 0x4000;
+    floor_mxcsr = base | 0x2000;
+    rounding_mxcsr = base | (((4 - (FCR31 & 3)) & 3) << 13);
+    rounding_mxcsr_differs = (rounding_mxcsr != host_mxcsr);
+}
+
+void save_host_mxcsr(void)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    host_mxcsr = _mm_getcsr() & ~0x3F; /* without the exception flags */
+#endif
+    update_rounding_mxcsr();
+}
@@ -27,9 +27,13 @@ extern double *reg_cop1_double[32];
 extern int FCR0, FCR31;
 extern long long int reg_cop1_fgr_64[32];
 extern int rounding_mode, trunc_mode, round_mode, ceil_mode, floor_mode;
+extern unsigned int host_mxcsr, rounding_mxcsr, round_mxcsr, ceil_mxcsr, floor_mxcsr;
+extern unsigned int rounding_mxcsr_differs;
 
 void shuffle_fpr_data(int oldStatus, int newStatus);
 void set_fpr_pointers(int newStatus);
+void save_host_mxcsr(void);
+void update_rounding_mxcsr(void);
 
 #endif /* M64P_R4300_CP1_H */
 
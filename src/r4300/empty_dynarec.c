@@ -24,11 +24,11 @@
 
 /* From assemble.c */
 
-void init_assembler(void *block_jumps_table, int block_jumps_number, void *block_riprel_table, int block_riprel_number)
+void init_assembler(void *block_jumps_table, int block_jumps_number, void *block_riprel_table, int block_riprel_number, void *block_imm64_table, int block_imm64_number)
 {
 }
 
-void free_assembler(void **block_jumps_table, int *block_jumps_number, void **block_riprel_table, int *block_riprel_number)
+void free_assembler(void **block_jumps_table, int *block_jumps_number, void **block_riprel_table, int *block_riprel_number, void **block_imm64_table, int *block_imm64_number)
 {
 }
 
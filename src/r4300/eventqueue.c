@@ -0,0 +1,358 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - eventqueue.c                                            *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Interrupt event scheduler.
+ *
+ * Every interrupt type is a distinct bit flag, so at most one event of each
+ * type can be pending at any time. Instead of a sorted linked list, each type
+ * owns a fixed slot holding a sort key, and the slot of the earliest event is
+ * cached. Looking up, adding or removing an event touches its own slot and
+ * the head only; finding the new head after removing it is a branch-free
+ * minimum over the EVENT_SLOTS keys. No cost depends on the queue contents.
+ *
+ * Ordering follows the count wrap-around rules of the former list based
+ * queue: counts are extended to 64 bits when an event is scheduled, so that
+ * events scheduled after the next wrap of the count register sort after the
+ * ones scheduled before it, and an event which became overdue stays in front
+ * of everything scheduled later. Events with the same deadline are
+ * dispatched in insertion order, and a pending CHECK_INT is always first. */
+
+#include <string.h>
+
+#define M64P_CORE_PROTOTYPES 1
+#include "api/m64p_types.h"
+#include "api/callbacks.h"
+
+#include "eventqueue.h"
+#include "interupt.h"
+#include "cp0.h"
+#include "r4300.h"
+
+#define EVENT_SLOTS  11
+#define COMPARE_SLOT 1  /* slot of COMPARE_INT (0x002) */
+#define CHECK_SLOT   2  /* slot of CHECK_INT (0x004) */
+#define SPECIAL_SLOT 5  /* slot of SPECIAL_INT (0x020) */
+
+/* Sort key of an event: its deadline (the count extended to 64 bits) in the
+ * upper bits and its scheduling order in the lower RANK_BITS, so that events
+ * sharing a deadline are dispatched in the order they were scheduled. A
+ * pending CHECK_INT uses CHECK_KEY and free slots NO_EVENT. */
+#define RANK_BITS 8
+#define RANK_MASK ((1ULL << RANK_BITS) - 1)
+#define CHECK_KEY 0ULL
+#define NO_EVENT  (~0ULL)
+
+struct event_queue
+{
+    unsigned long long key[EVENT_SLOTS];
+    unsigned int count[EVENT_SLOTS];    /* 32-bit count seen by the rest of the core */
+    int first;                          /* slot of the head event, -1 if empty */
+    unsigned int rank;                  /* rank of the next scheduled event */
+    unsigned long long now;             /* count register extended to 64 bits */
+    unsigned int last_count;            /* count register when 'now' was updated */
+};
+
+static struct event_queue q =
+{
+    { NO_EVENT, NO_EVENT, NO_EVENT, NO_EVENT, NO_EVENT, NO_EVENT,
+      NO_EVENT, NO_EVENT, NO_EVENT, NO_EVENT, NO_EVENT },
+    { 0 }, -1, 0,
+    1ULL << 32, /* keeps deadlines of overdue events above CHECK_KEY */
+    0
+};
+
+
+/* Event types are single bits and 2 is a primitive root modulo 13, so each
+ * type leaves a distinct remainder; this maps it back to the bit number. */
+static const signed char slot_of_remainder[13] =
+{
+    -1, 0, 1, 4, 2, 9, 5, -1, 3, 8, 10, 7, 6
+};
+
+static int type_to_slot(int type)
+{
+    int slot;
+
+    if (type <= 0)
+        return -1;
+
+    slot = slot_of_remainder[(unsigned int)type % 13];
+
+    return (slot >= 0 && type == (1 << slot))
+        ? slot
+        : -1;
+}
+
+static void update_time(unsigned int count)
+{
+    /* the count register may also move backward (see the COMPARE_INT
+     * handler), hence the signed difference */
+    q.now += (int)(count - q.last_count);
+    q.last_count = count;
+}
+
+static void update_first(void)
+{
+    unsigned long long best = q.key[0];
+    int slot, first = 0;
+
+    for (slot = 1; slot < EVENT_SLOTS; ++slot)
+    {
+        if (q.key[slot] < best)
+        {
+            best = q.key[slot];
+            first = slot;
+        }
+    }
+
+    q.first = (best != NO_EVENT) ? first : -1;
+}
+
+/* Ranks only need to be unique among the pending events, so they are
+ * renumbered from 0 whenever the counter would overflow into the deadline. */
+static void renumber_ranks(void)
+{
+    unsigned long long keys[EVENT_SLOTS];
+    int slot, other;
+
+    memcpy(keys, q.key, sizeof(keys));
+
+    for (slot = 0; slot < EVENT_SLOTS; ++slot)
+    {
+        unsigned int rank = 0;
+
+        if (keys[slot] == NO_EVENT || keys[slot] == CHECK_KEY)
+            continue;
+
+        for (other = 0; other < EVENT_SLOTS; ++other)
+            rank += (keys[other] < keys[slot]);
+
+        q.key[slot] = (keys[slot] & ~RANK_MASK) | rank;
+    }
+
+    q.rank = EVENT_SLOTS;
+}
+
+/* key of an event due at 'deadline', after the pending ones due at the same time */
+static unsigned long long make_key(unsigned long long deadline)
+{
+    if (q.rank > RANK_MASK)
+        renumber_ranks();
+
+    return (deadline << RANK_BITS) | q.rank++;
+}
+
+static int is_pending(int slot)
+{
+    return q.key[slot] != NO_EVENT;
+}
+
+/* schedule an event at 'count' while the count register is at 'base' */
+static void insert_event(int type, unsigned int count, unsigned int base)
+{
+    unsigned long long deadline;
+    int slot = type_to_slot(type);
+
+    if (slot < 0)
+    {
+        DebugMessage(M64MSG_ERROR, "Unknown interrupt event type 0x%x", type);
+        return;
+    }
+
+    if (is_pending(slot))
+    {
+        DebugMessage(M64MSG_WARNING, "two events of type 0x%x in interrupt queue", type);
+        /* FIXME: hack-fix for freezing in Perfect Dark
+         * http://code.google.com/p/mupen64plus/issues/detail?id=553
+         * https://github.com/mupen64plus-ae/mupen64plus-ae/commit/802d8f81d46705d64694d7a34010dc5f35787c7d
+         */
+        return;
+    }
+
+    update_time(base);
+
+    /* COMPARE_INT and SPECIAL_INT fire when the count register reaches
+     * their count, so a count already passed means after the next wrap of
+     * the register. Any other event scheduled in the past is overdue, as
+     * the first VI set up by init_interupt() or events restored from a
+     * savestate can be. */
+    deadline = q.now;
+    if (slot == COMPARE_SLOT || slot == SPECIAL_SLOT
+     || (unsigned int)(count - base) < 0x80000000)
+        deadline += (unsigned int)(count - base);
+    else
+        deadline -= (unsigned int)(base - count);
+
+    q.count[slot] = count;
+    q.key[slot] = (slot == CHECK_SLOT) ? CHECK_KEY : make_key(deadline);
+
+    if (q.first < 0 || q.key[slot] < q.key[q.first])
+    {
+        q.first = slot;
+        next_interupt = count;
+    }
+}
+
+void clear_queue(void)
+{
+    int slot;
+
+    for (slot = 0; slot < EVENT_SLOTS; ++slot)
+        q.key[slot] = NO_EVENT;
+
+    q.first = -1;
+    q.last_count = g_cp0_regs[CP0_COUNT_REG];
+}
+
+void add_interupt_event(int type, unsigned int delay)
+{
+    add_interupt_event_count(type, g_cp0_regs[CP0_COUNT_REG] + delay);
+}
+
+void add_interupt_event_count(int type, unsigned int count)
+{
+    insert_event(type, count, g_cp0_regs[CP0_COUNT_REG]);
+}
+
+void schedule_check_event(void)
+{
+    /* several pending checks are redundant, keep only the latest one */
+    remove_event(CHECK_INT);
+    insert_event(CHECK_INT, g_cp0_regs[CP0_COUNT_REG], g_cp0_regs[CP0_COUNT_REG]);
+}
+
+unsigned int get_next_interupt(void)
+{
+    unsigned int count;
+
+    if (q.first < 0)
+        return 0;
+
+    count = q.count[q.first];
+
+    return (count > g_cp0_regs[CP0_COUNT_REG]
+         || (g_cp0_regs[CP0_COUNT_REG] - count) < 0x80000000)
+        ? count
+        : 0;
+}
+
+void remove_interupt_event(void)
+{
+    if (q.first < 0)
+        return;
+
+    q.key[q.first] = NO_EVENT;
+    update_first();
+
+    next_interupt = get_next_interupt();
+}
+
+unsigned int get_event(int type)
+{
+    int slot = type_to_slot(type);
+
+    return (slot >= 0 && is_pending(slot))
+        ? q.count[slot]
+        : 0;
+}
+
+int get_next_event_type(void)
+{
+    return (q.first < 0)
+        ? 0
+        : (1 << q.first);
+}
+
+void remove_event(int type)
+{
+    int slot = type_to_slot(type);
+
+    if (slot < 0 || !is_pending(slot))
+        return;
+
+    q.key[slot] = NO_EVENT;
+
+    if (slot == q.first)
+        update_first();
+}
+
+void translate_event_queue(unsigned int base)
+{
+    int slot;
+
+    remove_event(COMPARE_INT);
+    remove_event(SPECIAL_INT);
+
+    /* rebasing every count by the same amount keeps the deadlines, only
+     * the origin of the extended count changes */
+    update_time(g_cp0_regs[CP0_COUNT_REG]);
+
+    for (slot = 0; slot < EVENT_SLOTS; ++slot)
+    {
+        if (is_pending(slot))
+            q.count[slot] = (q.count[slot] - g_cp0_regs[CP0_COUNT_REG]) + base;
+    }
+    q.last_count = base;
+
+    insert_event(COMPARE_INT, g_cp0_regs[CP0_COMPARE_REG], base);
+    insert_event(SPECIAL_INT, 0, base);
+}
+
+int save_eventqueue_infos(char *buf)
+{
+    int order[EVENT_SLOTS];
+    int n = 0, len = 0, i, slot;
+
+    /* events are stored in dispatch order */
+    for (slot = 0; slot < EVENT_SLOTS; ++slot)
+    {
+        if (!is_pending(slot))
+            continue;
+
+        for (i = n++; i > 0 && q.key[slot] < q.key[order[i-1]]; --i)
+            order[i] = order[i-1];
+        order[i] = slot;
+    }
+
+    for (i = 0; i < n; ++i)
+    {
+        int type = 1 << order[i];
+        memcpy(buf + len    , &type               , 4);
+        memcpy(buf + len + 4, &q.count[order[i]]  , 4);
+        len += 8;
+    }
+
+    *((unsigned int*)&buf[len]) = 0xFFFFFFFF;
+    return len+4;
+}
+
+void load_eventqueue_infos(char *buf)
+{
+    int len = 0;
+    clear_queue();
+    while (*((unsigned int*)&buf[len]) != 0xFFFFFFFF)
+    {
+        int type = *((unsigned int*)&buf[len]);
+        unsigned int count = *((unsigned int*)&buf[len+4]);
+        add_interupt_event_count(type, count);
+        len += 8;
+    }
+}
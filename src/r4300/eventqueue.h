@@ -0,0 +1,42 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - eventqueue.h                                            *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_R4300_EVENTQUEUE_H
+#define M64P_R4300_EVENTQUEUE_H
+
+/* Interrupt event scheduler.
+ *
+ * The public scheduling functions (add_interupt_event, get_event,
+ * remove_event, ...) are declared in interupt.h; this header only exposes
+ * the few extra entry points needed by the interrupt dispatcher. */
+
+void clear_queue(void);
+
+/* Schedule a CHECK_INT at the current count. It always becomes the head. */
+void schedule_check_event(void);
+
+/* Remove the head event and update next_interupt accordingly. */
+void remove_interupt_event(void);
+
+/* next_interupt value matching the current head of the queue. */
+unsigned int get_next_interupt(void);
+
+#endif /* M64P_R4300_EVENTQUEUE_H */
@@ -0,0 +1,308 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - idle_loop.c                                             *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+/* Detection of the idle loops of the guest code.
+ *
+ * Games wait for an interrupt by spinning on a short loop which polls a flag
+ * in RAM or an interface register, such as:
+ *
+ *   loop: lui  t0, 0xA430
+ *         lw   t0, 0x0008(t0)       MI_INTR_REG
+ *         beq  t0, zero, loop
+ *         nop
+ *
+ * Nothing such a loop reads changes before the next interrupt, so all its
+ * iterations until then compute the same values and take the same branch.
+ * The decoders (recomp.c) check each backward branch within its page with
+ * idle_loop_analyse() and compile the loops it accepts with the _IDLE
+ * variant of the branch, the one of the jumps to themselves: when taken, it
+ * adds the cycles left until next_interupt to the Count register at once.
+ * The skipped cycles are counted in g_IdleLoopCycles.  The new dynarec
+ * checks the backward branches of its blocks the same way and clears its
+ * cycle counter on the taken path of the idle loops, without counting.
+ * The pure interpreter decodes each instruction again at every execution, so
+ * it keeps the result of each branch in a small cache instead, see
+ * idle_loop_analyse_cached().
+ *
+ * The loop is given as its words from the branch target up to the delay
+ * slot of the branch.  It is accepted when:
+ *  - it only holds ALU instructions and loads besides its branch, so that it
+ *    has no side effect and exits only through the branch or an exception,
+ *  - each register it reads is either never written by the loop or written
+ *    before the read in the same iteration, so that the first iteration
+ *    computes the same values as the next ones,
+ *  - each load reads RDRAM or the MI_INTR, PI_STATUS or SI_STATUS register,
+ *    which only change on a store or an interrupt, at an address built by a
+ *    lui/addiu/ori chain of the loop, or relative to $gp or $sp when the
+ *    loop doesn't write them.
+ * The loops polling VI_CURRENT or AI_LEN aren't idle: these registers follow
+ * the Count register and the loops exit on their own.
+ */
+
+#include <string.h>
+
+#include "api/m64p_types.h"
+#include "api/callbacks.h"
+#include "idle_loop.h"
+#include "r4300.h"
+
+#define IDLE_LOOP_RS(w)  (((w) >> 21) & 0x1F)
+#define IDLE_LOOP_RT(w)  (((w) >> 16) & 0x1F)
+#define IDLE_LOOP_RD(w)  (((w) >> 11) & 0x1F)
+#define IDLE_LOOP_IMM(w) ((unsigned int) (int) (short) ((w) & 0xFFFF))
+
+#define IDLE_LOOP_REG_GP 28
+#define IDLE_LOOP_REG_SP 29
+#define IDLE_LOOP_REG_RA 31
+
+#define IDLE_LOOP_CACHE_SIZE 256 /* power of two */
+
+/* a loop analysed for the pure interpreter, its words are kept to notice
+ * when the code at its address changes */
+struct idle_loop_cache_entry
+{
+    unsigned int address;
+    unsigned int length;
+    unsigned int words[IDLE_LOOP_MAX_LENGTH];
+    int idle;
+};
+
+/* global variables */
+int g_IdleLoopDetection = 0;
+unsigned long long g_IdleLoopCycles = 0;
+
+static struct idle_loop_cache_entry l_IdleLoopCache[IDLE_LOOP_CACHE_SIZE];
+
+static int idle_loop_safe_address(unsigned int address)
+{
+    if ((address & 0xC0000000) != 0x80000000)
+        return 0;
+
+    address &= 0x1FFFFFFC;
+    return address < 0x800000 ||
+           address == 0x04300008 || /* MI_INTR_REG */
+           address == 0x04600010 || /* PI_STATUS_REG */
+           address == 0x04800018;   /* SI_STATUS_REG */
+}
+
+/* Finds the registers read and written by the branch w, returns 0 if it
+ * isn't a branch with a constant target. */
+static int idle_loop_decode_branch(unsigned int w, unsigned int *reads, unsigned int *write)
+{
+    switch (w >> 26)
+    {
+    case 0x01: /* REGIMM */
+        switch (IDLE_LOOP_RT(w))
+        {
+        case 0x00: case 0x01: case 0x02: case 0x03: /* BLTZ BGEZ BLTZL BGEZL */
+            *reads = 1u << IDLE_LOOP_RS(w);
+            return 1;
+        case 0x10: case 0x11: case 0x12: case 0x13: /* BLTZAL BGEZAL BLTZALL BGEZALL */
+            *reads = 1u << IDLE_LOOP_RS(w);
+            *write = IDLE_LOOP_REG_RA;
+            return 1;
+        }
+        return 0;
+    case 0x02: /* J */
+        return 1;
+    case 0x03: /* JAL */
+        *write = IDLE_LOOP_REG_RA;
+        return 1;
+    case 0x04: case 0x05: case 0x14: case 0x15: /* BEQ BNE BEQL BNEL */
+        *reads = (1u << IDLE_LOOP_RS(w)) | (1u << IDLE_LOOP_RT(w));
+        return 1;
+    case 0x06: case 0x07: case 0x16: case 0x17: /* BLEZ BGTZ BLEZL BGTZL */
+        *reads = 1u << IDLE_LOOP_RS(w);
+        return 1;
+    case 0x11: /* BC1F BC1T BC1FL BC1TL, the loop can't change the condition */
+        return IDLE_LOOP_RS(w) == 0x08;
+    }
+    return 0;
+}
+
+/* Finds the registers read and written by the body instruction w, returns
+ * 0 if it isn't allowed in an idle loop. */
+static int idle_loop_decode(unsigned int w, unsigned int *reads, unsigned int *write, int *load)
+{
+    switch (w >> 26)
+    {
+    case 0x00: /* SPECIAL */
+        switch (w & 0x3F)
+        {
+        case 0x00: case 0x02: case 0x03: /* SLL SRL SRA */
+            *reads = 1u << IDLE_LOOP_RT(w);
+            *write = IDLE_LOOP_RD(w);
+            return 1;
+        case 0x04: case 0x06: case 0x07: /* SLLV SRLV SRAV */
+        case 0x20: case 0x21: case 0x22: case 0x23: /* ADD ADDU SUB SUBU */
+        case 0x24: case 0x25: case 0x26: case 0x27: /* AND OR XOR NOR */
+        case 0x2A: case 0x2B: /* SLT SLTU */
+            *reads = (1u << IDLE_LOOP_RS(w)) | (1u << IDLE_LOOP_RT(w));
+            *write = IDLE_LOOP_RD(w);
+            return 1;
+        }
+        return 0;
+    case 0x08: case 0x09: case 0x0A: case 0x0B: /* ADDI ADDIU SLTI SLTIU */
+    case 0x0C: case 0x0D: case 0x0E: /* ANDI ORI XORI */
+        *reads = 1u << IDLE_LOOP_RS(w);
+        *write = IDLE_LOOP_RT(w);
+        return 1;
+    case 0x0F: /* LUI */
+        *write = IDLE_LOOP_RT(w);
+        return 1;
+    case 0x20: case 0x21: case 0x23: case 0x24: /* LB LH LW LBU */
+    case 0x25: case 0x27: case 0x37: /* LHU LWU LD */
+        *reads = 1u << IDLE_LOOP_RS(w);
+        *write = IDLE_LOOP_RT(w);
+        *load = 1;
+        return 1;
+    }
+    return 0;
+}
+
+/* Global Functions */
+
+/* words[0] is the target of the branch words[length-2], words[length-1] its
+ * delay slot, returns 1 if the loop they make is idle */
+int idle_loop_analyse(const unsigned int *words, unsigned int length)
+{
+    unsigned int reads[IDLE_LOOP_MAX_LENGTH], write[IDLE_LOOP_MAX_LENGTH];
+    int load[IDLE_LOOP_MAX_LENGTH];
+    unsigned int value[32];
+    unsigned int loop_writes = 0, written = 0, known = 1;
+    unsigned int i;
+
+    if (length < 2 || length > IDLE_LOOP_MAX_LENGTH)
+        return 0;
+
+    for (i = 0; i < length; i++)
+    {
+        reads[i] = 0;
+        write[i] = 0;
+        load[i] = 0;
+        if (i == length - 2)
+        {
+            if (!idle_loop_decode_branch(words[i], &reads[i], &write[i]))
+                return 0;
+        }
+        else if (!idle_loop_decode(words[i], &reads[i], &write[i], &load[i]))
+            return 0;
+        if (write[i] != 0)
+            loop_writes |= 1u << write[i];
+    }
+
+    /* $zero reads as a known constant */
+    value[0] = 0;
+
+    for (i = 0; i < length; i++)
+    {
+        unsigned int w = words[i];
+        unsigned int rs = IDLE_LOOP_RS(w);
+
+        if (reads[i] & loop_writes & ~written)
+            return 0;
+
+        if (load[i])
+        {
+            if (known & (1u << rs))
+            {
+                if (!idle_loop_safe_address(value[rs] + IDLE_LOOP_IMM(w)))
+                    return 0;
+            }
+            else if ((rs != IDLE_LOOP_REG_GP && rs != IDLE_LOOP_REG_SP) || (loop_writes & (1u << rs)))
+                return 0;
+        }
+
+        if (write[i] == 0)
+            continue;
+
+        /* follow the constants built by lui, addiu and ori */
+        switch (w >> 26)
+        {
+        case 0x0F: /* LUI */
+            value[write[i]] = w << 16;
+            known |= 1u << write[i];
+            break;
+        case 0x09: /* ADDIU */
+            if (known & (1u << rs))
+            {
+                value[write[i]] = value[rs] + IDLE_LOOP_IMM(w);
+                known |= 1u << write[i];
+            }
+            else
+                known &= ~(1u << write[i]);
+            break;
+        case 0x0D: /* ORI */
+            if (known & (1u << rs))
+            {
+                value[write[i]] = value[rs] | (w & 0xFFFF);
+                known |= 1u << write[i];
+            }
+            else
+                known &= ~(1u << write[i]);
+            break;
+        default:
+            known &= ~(1u << write[i]);
+            break;
+        }
+        written |= 1u << write[i];
+    }
+
+    return 1;
+}
+
+/* same as idle_loop_analyse() for the branch at address, but returns the
+ * result of the last analysis of this branch while its loop is unchanged */
+int idle_loop_analyse_cached(unsigned int address, const unsigned int *words, unsigned int length)
+{
+    struct idle_loop_cache_entry *entry = &l_IdleLoopCache[(address >> 2) & (IDLE_LOOP_CACHE_SIZE - 1)];
+
+    if (length < 2 || length > IDLE_LOOP_MAX_LENGTH)
+        return 0;
+
+    if (entry->length != length || entry->address != address ||
+        memcmp(entry->words, words, length * sizeof(words[0])) != 0)
+    {
+        entry->address = address;
+        entry->length = length;
+        memcpy(entry->words, words, length * sizeof(words[0]));
+        entry->idle = idle_loop_analyse(words, length);
+    }
+
+    return entry->idle;
+}
+
+void idle_loop_open(void)
+{
+    g_IdleLoopCycles = 0;
+    memset(l_IdleLoopCache, 0, sizeof(l_IdleLoopCache));
+}
+
+void idle_loop_close(void)
+{
+#ifdef NEW_DYNAREC
+    /* the new dynarec doesn't count the cycles it skips */
+    if (r4300emu == CORE_DYNAREC)
+        return;
+#endif
+    DebugMessage(M64MSG_INFO, "Idle loops: %llu cycles skipped", g_IdleLoopCycles);
+}
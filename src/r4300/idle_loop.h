@@ -0,0 +1,40 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - idle_loop.h                                             *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+
+#ifndef M64P_R4300_IDLE_LOOP_H
+#define M64P_R4300_IDLE_LOOP_H
+
+/* Detection of the idle loops of the guest code, see idle_loop.c. */
+
+/* longest loop checked, in words from its first instruction to its delay slot */
+#define IDLE_LOOP_MAX_LENGTH 16
+
+extern int g_IdleLoopDetection;
+extern unsigned long long g_IdleLoopCycles;
+
+int idle_loop_analyse(const unsigned int *words, unsigned int length);
+int idle_loop_analyse_cached(unsigned int address, const unsigned int *words, unsigned int length);
+
+void idle_loop_open(void);
+void idle_loop_close(void);
+
+#endif /* M64P_R4300_IDLE_LOOP_H */
@@ -32,15 +32,20 @@
 #include "main/rom.h"
 #include "main/main.h"
 #include "main/profile.h"
+#include "main/rewind.h"
+#include "main/savemedia.h"
 #include "main/savestates.h"
+#include "main/trace.h"
 #include "main/cheat.h"
 #include "osd/osd.h"
 #include "plugin/plugin.h"
 
 #include "interupt.h"
 #include "r4300.h"
+#include "block_profiler.h"
 #include "cached_interp.h"
 #include "cp0.h"
+#include "eventqueue.h"
 #include "exception.h"
 #include "reset.h"
 #include "new_dynarec/new_dynarec.h"
@@ -55,302 +60,8 @@ static int vi_counter=0;
 
 int interupt_unsafe_state = 0;
 
-struct interrupt_event
-{
-    int type;
-    unsigned int count;
-};
-
-
-/***************************************************************************
- * Pool of Single Linked List Nodes
- **************************************************************************/
-#define POOL_CAPACITY 16
-
-struct node
-{
-    struct interrupt_event data;
-    struct node *next;
-};
-
-struct pool
-{
-    struct node nodes[POOL_CAPACITY];
-    struct node* stack[POOL_CAPACITY];
-    size_t index;
-};
-
-static struct node* alloc_node(struct pool* p);
-static void free_node(struct pool* p, struct node* node);
-static void clear_pool(struct pool* p);
-
-
-/* node allocation/deallocation on a given pool */
-static struct node* alloc_node(struct pool* p)
-{
-    /* return NULL if pool is too small */
-    if (p->index >= POOL_CAPACITY)
-        return NULL;
-
-    return p->stack[p->index++];
-}
-
-static void free_node(struct pool* p, struct node* node)
-{
-    if (p->index == 0 || node == NULL)
-        return;
-
-    p->stack[--p->index] = node;
-}
-
-/* release all nodes */
-static void clear_pool(struct pool* p)
-{
-    size_t i;
-
-    for(i = 0; i < POOL_CAPACITY; ++i)
-        p->stack[i] = &p->nodes[i];
-
-    p->index = 0;
-}
-
-/***************************************************************************
- * Interrupt Queue
- **************************************************************************/
-
-struct interrupt_queue
-{
-    struct pool pool;
-    struct node* first;
-};
-
-static struct interrupt_queue q;
-
-
-static void clear_queue(void)
-{
-    q.first = NULL;
-    clear_pool(&q.pool);
-}
-
-
-static int SPECIAL_done = 0;
-
-static int before_event(unsigned int evt1, unsigned int evt2, int type2)
-{
-    if(evt1 - g_cp0_regs[CP0_COUNT_REG] < 0x80000000)
-    {
-        if(evt2 - g_cp0_regs[CP0_COUNT_REG] < 0x80000000)
-        {
-            if((evt1 - g_cp0_regs[CP0_COUNT_REG]) < (evt2 - g_cp0_regs[CP0_COUNT_REG])) return 1;
-            else return 0;
-        }
-        else
-        {
-            if((g_cp0_regs[CP0_COUNT_REG] - evt2) < 0x10000000)
-            {
-                switch(type2)
-                {
-                    case SPECIAL_INT:
-                        if(SPECIAL_done) return 1;
-                        else return 0;
-                        break;
-                    default:
-                        return 0;
-                }
-            }
-            else return 1;
-        }
-    }
-    else return 0;
-}
-
-void add_interupt_event(int type, unsigned int delay)
-{
-    add_interupt_event_count(type, g_cp0_regs[CP0_COUNT_REG] + delay);
-}
-
-void add_interupt_event_count(int type, unsigned int count)
-{
-    struct node* event;
-    struct node* e;
-    int special;
-
-    special = (type == SPECIAL_INT);
-   
-    if(g_cp0_regs[CP0_COUNT_REG] > 0x80000000) SPECIAL_done = 0;
-   
-    if (get_event(type)) {
-        DebugMessage(M64MSG_WARNING, "two events of type 0x%x in interrupt queue", type);
-        /* FIXME: hack-fix for freezing in Perfect Dark
-         * http://code.google.com/p/mupen64plus/issues/detail?id=553
-         * https://github.com/mupen64plus-ae/mupen64plus-ae/commit/802d8f81d46705d64694d7a34010dc5f35787c7d
-         */
-        return;
-    }
-
-    event = alloc_node(&q.pool);
-    if (event == NULL)
-    {
-        DebugMessage(M64MSG_ERROR, "Failed to allocate node for new interrupt event");
-        return;
-    }
-
-    event->data.count = count;
-    event->data.type = type;
-
-    if (q.first == NULL)
-    {
-        q.first = event;
-        event->next = NULL;
-        next_interupt = q.first->data.count;
-    }
-    else if (before_event(count, q.first->data.count, q.first->data.type) && !special)
-    {
-        event->next = q.first;
-        q.first = event;
-        next_interupt = q.first->data.count;
-    }
-    else
-    {
-        for(e = q.first;
-            e->next != NULL &&
-            (!before_event(count, e->next->data.count, e->next->data.type) || special);
-            e = e->next);
-
-        if (e->next == NULL)
-        {
-            e->next = event;
-            event->next = NULL;
-        }
-        else
-        {
-            if (!special)
-                for(; e->next != NULL && e->next->data.count == count; e = e->next);
-
-            event->next = e->next;
-            e->next = event;
-        }
-    }
-}
-
-static void remove_interupt_event(void)
-{
-    struct node* e;
-
-    if (q.first->data.type == SPECIAL_INT)
-        SPECIAL_done = 1;
-
-    e = q.first;
-    q.first = e->next;
-    free_node(&q.pool, e);
-
-    next_interupt = (q.first != NULL
-         && (q.first->data.count > g_cp0_regs[CP0_COUNT_REG]
-         || (g_cp0_regs[CP0_COUNT_REG] - q.first->data.count) < 0x80000000))
-        ? q.first->data.count
-        : 0;
-}
-
-unsigned int get_event(int type)
-{
-    struct node* e = q.first;
-
-    if (e == NULL)
-        return 0;
-
-    if (e->data.type == type)
-        return e->data.count;
-
-    for(; e->next != NULL && e->next->data.type != type; e = e->next);
-
-    return (e->next != NULL)
-        ? e->next->data.count
-        : 0;
-}
-
-int get_next_event_type(void)
-{
-    return (q.first == NULL)
-        ? 0
-        : q.first->data.type;
-}
-
-void remove_event(int type)
-{
-    struct node* to_del;
-    struct node* e = q.first;
-
-    if (e == NULL)
-        return;
-
-    if (e->data.type == type)
-    {
-        q.first = e->next;
-        free_node(&q.pool, e);
-    }
-    else
-    {
-        for(; e->next != NULL && e->next->data.type != type; e = e->next);
-
-        if (e->next != NULL)
-        {
-            to_del = e->next;
-            e->next = to_del->next;
-            free_node(&q.pool, to_del);
-        }
-    }
-}
-
-void translate_event_queue(unsigned int base)
-{
-    struct node* e;
-
-    remove_event(COMPARE_INT);
-    remove_event(SPECIAL_INT);
-
-    for(e = q.first; e != NULL; e = e->next)
-    {
-        e->data.count = (e->data.count - g_cp0_regs[CP0_COUNT_REG]) + base;
-    }
-    add_interupt_event_count(COMPARE_INT, g_cp0_regs[CP0_COMPARE_REG]);
-    add_interupt_event_count(SPECIAL_INT, 0);
-}
-
-int save_eventqueue_infos(char *buf)
-{
-    int len;
-    struct node* e;
-
-    len = 0;
-
-    for(e = q.first; e != NULL; e = e->next)
-    {
-        memcpy(buf + len    , &e->data.type , 4);
-        memcpy(buf + len + 4, &e->data.count, 4);
-        len += 8;
-    }
-
-    *((unsigned int*)&buf[len]) = 0xFFFFFFFF;
-    return len+4;
-}
-
-void load_eventqueue_infos(char *buf)
-{
-    int len = 0;
-    clear_queue();
-    while (*((unsigned int*)&buf[len]) != 0xFFFFFFFF)
-    {
-        int type = *((unsigned int*)&buf[len]);
-        unsigned int count = *((unsigned int*)&buf[len+4]);
-        add_interupt_event_count(type, count);
-        len += 8;
-    }
-}
-
 void init_interupt(void)
 {
-    SPECIAL_done = 1;
     next_vi = next_interupt = 5000;
     vi_register.vi_delay = next_vi;
     vi_field = 0;
@@ -362,42 +73,23 @@ void init_interupt(void)
 
 void check_interupt(void)
 {
-    struct node* event;
-
     if (MI_register.mi_intr_reg & MI_register.mi_intr_mask_reg)
         g_cp0_regs[CP0_CAUSE_REG] = (g_cp0_regs[CP0_CAUSE_REG] | 0x400) & 0xFFFFFF83;
     else
         g_cp0_regs[CP0_CAUSE_REG] &= ~0x400;
     if ((g_cp0_regs[CP0_STATUS_REG] & 7) != 1) return;
     if (g_cp0_regs[CP0_STATUS_REG] & g_cp0_regs[CP0_CAUSE_REG] & 0xFF00)
-    {
-        event = alloc_node(&q.pool);
-
-        if (event == NULL)
-        {
-            DebugMessage(M64MSG_ERROR, "Failed to allocate node for new interrupt event");
-            return;
-        }
-
-        event->data.count = next_interupt = g_cp0_regs[CP0_COUNT_REG];
-        event->data.type = CHECK_INT;
-
-        if (q.first == NULL)
-        {
-            q.first = event;
-            event->next = NULL;
-        }
-        else
-        {
-            event->next = q.first;
-            q.first = event;
-
-        }
-    }
+        schedule_check_event();
 }
 
 void gen_interupt(void)
 {
+#ifdef NEW_DYNAREC
+    /* the new dynarec links its blocks directly, sample it here instead */
+    if (r4300emu == CORE_DYNAREC)
+        block_profiler_entry(pcaddr);
+#endif
+
     if (stop == 1)
     {
         vi_counter = 0; // debug
@@ -412,6 +104,16 @@ void gen_interupt(void)
             return;
         }
 
+        if (rewind_get_job() == rewind_job_step)
+        {
+            rewind_step();
+            return;
+        }
+
+        /* the pending event is still in the queue, so it is dispatched again after a rewind */
+        if (rewind_get_job() == rewind_job_capture && !skip_jump)
+            rewind_capture();
+
         if (reset_hard_job)
         {
             reset_hard();
@@ -425,17 +127,14 @@ void gen_interupt(void)
         unsigned int dest = skip_jump;
         skip_jump = 0;
 
-        next_interupt = (q.first->data.count > g_cp0_regs[CP0_COUNT_REG]
-                || (g_cp0_regs[CP0_COUNT_REG] - q.first->data.count) < 0x80000000)
-            ? q.first->data.count
-            : 0;
+        next_interupt = get_next_interupt();
 
         last_addr = dest;
         generic_jump_to(dest);
         return;
     } 
 
-    switch(q.first->data.type)
+    switch(get_next_event_type())
     {
         case SPECIAL_INT:
             if (g_cp0_regs[CP0_COUNT_REG] > 0x10000000) return;
@@ -444,6 +143,7 @@ void gen_interupt(void)
             return;
             break;
         case VI_INT:
+            trace_instant("vi", vi_counter);
             if(vi_counter < 60)
             {
                 if (vi_counter == 0)
@@ -454,7 +154,12 @@ void gen_interupt(void)
             {
                 cheat_apply_cheats(ENTRY_VI);
             }
-            gfx.updateScreen();
+            if (main_render_vi())
+            {
+                trace_begin("gfx.updateScreen");
+                gfx.updateScreen();
+                trace_end("gfx.updateScreen");
+            }
 #ifdef WITH_LIRC
             lircCheckInput();
 #endif
@@ -467,6 +172,7 @@ void gen_interupt(void)
             {
                 osd_render();  // draw Paused message in case gfx.updateScreen didn't do it
                 VidExt_GL_SwapBuffers();
+                savemedia_flush_all();
                 while(rompause)
                 {
                     SDL_Delay(10);
@@ -649,7 +355,7 @@ void gen_interupt(void)
             return;
 
         default:
-            DebugMessage(M64MSG_ERROR, "Unknown interrupt queue event type %.8X.", q.first->data.type);
+            DebugMessage(M64MSG_ERROR, "Unknown interrupt queue event type %.8X.", get_next_event_type());
             remove_interupt_event();
             break;
     }
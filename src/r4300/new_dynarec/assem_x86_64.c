@@ -0,0 +1,3902 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - assem_x86_64.c                                          *
+ *   Copyright (C) 2009-2011 Ari64                                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+int cycle_count;
+int last_count;
+int pcaddr;
+int pending_exception;
+int branch_target;
+uint64_t readmem_dword;
+static precomp_instr fake_pc;
+uintptr_t memory_map[1048576];
+static uintptr_t mini_ht[32][2]  __attribute__((aligned(16)));
+u_char restore_candidate[512]  __attribute__((aligned(4)));
+// (rdram-0x80000000)>>2, the translation of the unmapped segments,
+// in the same format as the memory_map entries
+intptr_t ram_offset;
+// The generated code can only reach invalid_code through a pointer
+static u_char *invc_ptr;
+
+void do_interrupt();
+void jump_vaddr_rax();
+void jump_vaddr_rcx();
+void jump_vaddr_rdx();
+void jump_vaddr_rbp();
+void jump_vaddr_rsi();
+void jump_vaddr_rdi();
+void jump_vaddr_r8();
+void jump_vaddr_r9();
+void jump_vaddr_r10();
+void jump_vaddr_r11();
+void jump_vaddr_r12();
+void jump_vaddr_r13();
+void jump_vaddr_r14();
+
+static const intptr_t jump_vaddr_reg[16] = {
+  (intptr_t)jump_vaddr_rax,
+  (intptr_t)jump_vaddr_rcx,
+  (intptr_t)jump_vaddr_rdx,
+  0,
+  0,
+  (intptr_t)jump_vaddr_rbp,
+  (intptr_t)jump_vaddr_rsi,
+  (intptr_t)jump_vaddr_rdi,
+  (intptr_t)jump_vaddr_r8,
+  (intptr_t)jump_vaddr_r9,
+  (intptr_t)jump_vaddr_r10,
+  (intptr_t)jump_vaddr_r11,
+  (intptr_t)jump_vaddr_r12,
+  (intptr_t)jump_vaddr_r13,
+  (intptr_t)jump_vaddr_r14,
+  0 };
+
+void invalidate_block_rax();
+void invalidate_block_rcx();
+void invalidate_block_rdx();
+void invalidate_block_rbx();
+void invalidate_block_rbp();
+void invalidate_block_rsi();
+void invalidate_block_rdi();
+void invalidate_block_r8();
+void invalidate_block_r9();
+void invalidate_block_r10();
+void invalidate_block_r11();
+void invalidate_block_r12();
+void invalidate_block_r13();
+void invalidate_block_r14();
+
+static const intptr_t invalidate_block_reg[16] = {
+  (intptr_t)invalidate_block_rax,
+  (intptr_t)invalidate_block_rcx,
+  (intptr_t)invalidate_block_rdx,
+  (intptr_t)invalidate_block_rbx,
+  0,
+  (intptr_t)invalidate_block_rbp,
+  (intptr_t)invalidate_block_rsi,
+  (intptr_t)invalidate_block_rdi,
+  (intptr_t)invalidate_block_r8,
+  (intptr_t)invalidate_block_r9,
+  (intptr_t)invalidate_block_r10,
+  (intptr_t)invalidate_block_r11,
+  (intptr_t)invalidate_block_r12,
+  (intptr_t)invalidate_block_r13,
+  (intptr_t)invalidate_block_r14,
+  0 };
+
+static const u_short rounding_modes[4] = {
+  0x33F, // round
+  0xF3F, // trunc
+  0xB3F, // ceil
+  0x73F};// floor
+
+#include "../fpu.h"
+
+// We need these for cmovcc instructions on x86
+static const u_int const_zero=0;
+static const u_int const_one=1;
+
+/* Linker */
+
+static void set_jump_target(intptr_t addr,intptr_t target)
+{
+  u_char *ptr=(u_char *)addr;
+  if(*ptr==0x0f)
+  {
+    assert(ptr[1]>=0x80&&ptr[1]<=0x8f);
+    int *ptr2=(int *)(ptr+2);
+    assert(target-(intptr_t)ptr2-4==(int)(target-(intptr_t)ptr2-4));
+    *ptr2=target-(intptr_t)ptr2-4;
+  }
+  else if(*ptr==0xe8||*ptr==0xe9) {
+    int *ptr2=(int *)(ptr+1);
+    assert(target-(intptr_t)ptr2-4==(int)(target-(intptr_t)ptr2-4));
+    *ptr2=target-(intptr_t)ptr2-4;
+  }
+  else
+  {
+    assert(ptr[0]==0x4c&&ptr[1]==0x8d&&ptr[2]==0x3d); /* lea rel32(%rip),%r15 (return address) */
+    int *ptr2=(int *)(ptr+3);
+    assert(target-(intptr_t)ptr2-4==(int)(target-(intptr_t)ptr2-4));
+    *ptr2=target-(intptr_t)ptr2-4;
+  }
+}
+
+static void *kill_pointer(void *stub)
+{
+  int *i_ptr=*((int **)((u_char *)stub+7));
+  *i_ptr=(intptr_t)stub-(intptr_t)i_ptr-4;
+  return i_ptr;
+}
+static intptr_t get_pointer(void *stub)
+{
+  int *i_ptr=*((int **)((u_char *)stub+7));
+  return *i_ptr+(intptr_t)i_ptr+4;
+}
+
+// Find the "clean" entry point from a "dirty" entry point
+// by skipping past the call to verify_code
+static uintptr_t get_clean_addr(intptr_t addr)
+{
+  u_char *ptr=(u_char *)addr;
+  assert(ptr[30]==0xE8); // call instruction
+  if(ptr[35]==0xE9) return *(int *)(ptr+36)+addr+40; // follow jmp
+  else return(addr+35);
+}
+
+static int verify_dirty(void *addr)
+{
+  u_char *ptr=(u_char *)addr;
+  assert(ptr[0]==0x48&&ptr[1]==0xBF);
+  uintptr_t source=*(uintptr_t *)(ptr+2);
+  uintptr_t copy=*(uintptr_t *)(ptr+12);
+  u_int len=*(u_int *)(ptr+21);
+  assert(ptr[30]==0xE8); // call instruction
+  uintptr_t verifier=*(int *)(ptr+31)+(uintptr_t)ptr+35;
+  if(verifier==(uintptr_t)verify_code_vm||verifier==(uintptr_t)verify_code_ds) {
+    unsigned int page=source>>12;
+    uintptr_t map_value=memory_map[page];
+    if((intptr_t)map_value<0) return 0;
+    while(page<((source+len-1)>>12)) {
+      if((memory_map[++page]<<2)!=(map_value<<2)) return 0;
+    }
+    source = source+(map_value<<2);
+  }
+  //DebugMessage(M64MSG_VERBOSE, "verify_dirty: %x %x %x",source,copy,len);
+  return !memcmp((void *)source,(void *)copy,len);
+}
+
+// This doesn't necessarily find all clean entry points, just
+// guarantees that it's not dirty
+static int isclean(intptr_t addr)
+{
+  u_char *ptr=(u_char *)addr;
+  if(ptr[0]!=0x48||ptr[1]!=0xBF) return 1; // mov imm64,%rdi
+  if(ptr[10]!=0x48||ptr[11]!=0xBE) return 1; // mov imm64,%rsi
+  if(ptr[20]!=0xBA) return 1; // mov imm,%edx
+  if(ptr[25]!=0xB9) return 1; // mov imm,%ecx
+  if(ptr[30]!=0xE8) return 1; // call instruction
+  return 0;
+}
+
+static void get_bounds(intptr_t addr,uintptr_t *start,uintptr_t *end)
+{
+  u_char *ptr=(u_char *)addr;
+  assert(ptr[0]==0x48&&ptr[1]==0xBF);
+  uintptr_t source=*(uintptr_t *)(ptr+2);
+  //uintptr_t copy=*(uintptr_t *)(ptr+12);
+  u_int len=*(u_int *)(ptr+21);
+  assert(ptr[30]==0xE8); // call instruction
+  uintptr_t verifier=*(int *)(ptr+31)+(uintptr_t)ptr+35;
+  if(verifier==(uintptr_t)verify_code_vm||verifier==(uintptr_t)verify_code_ds) {
+    if((intptr_t)memory_map[source>>12]<0) source = 0;
+    else source = source+(memory_map[source>>12]<<2);
+  }
+  if(start) *start=source;
+  if(end) *end=source+len;
+}
+
+/* Register allocation */
+
+// Note: registers are allocated clean (unmodified state)
+// if you intend to modify the register, you must call dirty_reg().
+static void alloc_reg(struct regstat *cur,int i,signed char reg)
+{
+  int r,hr;
+  // Spread the registers over %rax-%r14, skipping %rbx (cycle count)
+  // and %rsp
+  int preferred_reg = reg%13;
+  if(preferred_reg>=HOST_CCREG) preferred_reg++;
+  if(preferred_reg>=EXCLUDE_REG) preferred_reg++;
+  if(reg==CCREG) preferred_reg=HOST_CCREG;
+
+  // Don't allocate unused registers
+  if((cur->u>>reg)&1) return;
+
+  // see if it's already allocated
+  for(hr=0;hr<HOST_REGS;hr++)
+  {
+    if(cur->regmap[hr]==reg) return;
+  }
+
+  // Keep the same mapping if the register was already allocated in a loop
+  preferred_reg = loop_reg(i,reg,preferred_reg);
+
+  // Try to allocate the preferred register
+  if(cur->regmap[preferred_reg]==-1) {
+    cur->regmap[preferred_reg]=reg;
+    cur->dirty&=~(1<<preferred_reg);
+    cur->isconst&=~(1<<preferred_reg);
+    return;
+  }
+  r=cur->regmap[preferred_reg];
+  if(r<64&&((cur->u>>r)&1)) {
+    cur->regmap[preferred_reg]=reg;
+    cur->dirty&=~(1<<preferred_reg);
+    cur->isconst&=~(1<<preferred_reg);
+    return;
+  }
+  if(r>=64&&((cur->uu>>(r&63))&1)) {
+    cur->regmap[preferred_reg]=reg;
+    cur->dirty&=~(1<<preferred_reg);
+    cur->isconst&=~(1<<preferred_reg);
+    return;
+  }
+
+  // Clear any unneeded registers
+  // We try to keep the mapping consistent, if possible, because it
+  // makes branches easier (especially loops).  So we try to allocate
+  // first (see above) before removing old mappings.  If this is not
+  // possible then go ahead and clear out the registers that are no
+  // longer needed.
+  for(hr=0;hr<HOST_REGS;hr++)
+  {
+    r=cur->regmap[hr];
+    if(r>=0) {
+      if(r<64) {
+        if((cur->u>>r)&1)
+          if(i==0||(unneeded_reg[i-1]>>r)&1) {cur->regmap[hr]=-1;break;}
+      }
+      else
+      {
+        if((cur->uu>>(r&63))&1)
+          if(i==0||(unneeded_reg_upper[i-1]>>(r&63))&1) {cur->regmap[hr]=-1;break;}
+      }
+    }
+  }
+  // Try to allocate any available register, but prefer
+  // registers that have not been used recently.
+  if(i>0) {
+    for(hr=0;hr<HOST_REGS;hr++) {
+      if(hr!=EXCLUDE_REG&&cur->regmap[hr]==-1) {
+        if(regs[i-1].regmap[hr]!=rs1[i-1]&&regs[i-1].regmap[hr]!=rs2[i-1]&&regs[i-1].regmap[hr]!=rt1[i-1]&&regs[i-1].regmap[hr]!=rt2[i-1]) {
+          cur->regmap[hr]=reg;
+          cur->dirty&=~(1<<hr);
+          cur->isconst&=~(1<<hr);
+          return;
+        }
+      }
+    }
+  }
+  // Try to allocate any available register
+  for(hr=0;hr<HOST_REGS;hr++) {
+    if(hr!=EXCLUDE_REG&&cur->regmap[hr]==-1) {
+      cur->regmap[hr]=reg;
+      cur->dirty&=~(1<<hr);
+      cur->isconst&=~(1<<hr);
+      return;
+    }
+  }
+
+  // Ok, now we have to evict someone
+  // Pick a register we hopefully won't need soon
+  u_char hsn[MAXREG+1];
+  memset(hsn,10,sizeof(hsn));
+  int j;
+  lsn(hsn,i,&preferred_reg);
+  if(i>0) {
+    // Don't evict the cycle count at entry points, otherwise the entry
+    // stub will have to write it.
+    if(bt[i]&&hsn[CCREG]>2) hsn[CCREG]=2;
+    if(i>1&&hsn[CCREG]>2&&(itype[i-2]==RJUMP||itype[i-2]==UJUMP||itype[i-2]==CJUMP||itype[i-2]==SJUMP||itype[i-2]==FJUMP)) hsn[CCREG]=2;
+    for(j=10;j>=3;j--)
+    {
+      // Alloc preferred register if available
+      if(hsn[r=cur->regmap[preferred_reg]&63]==j) {
+        for(hr=0;hr<HOST_REGS;hr++) {
+          // Evict both parts of a 64-bit register
+          if((cur->regmap[hr]&63)==r) {
+            cur->regmap[hr]=-1;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+          }
+        }
+        cur->regmap[preferred_reg]=reg;
+        return;
+      }
+      for(r=1;r<=MAXREG;r++)
+      {
+        if(hsn[r]==j&&r!=rs1[i-1]&&r!=rs2[i-1]&&r!=rt1[i-1]&&r!=rt2[i-1]) {
+          for(hr=0;hr<HOST_REGS;hr++) {
+            if(hr!=HOST_CCREG||j<hsn[CCREG]) {
+              if(cur->regmap[hr]==r+64) {
+                cur->regmap[hr]=reg;
+                cur->dirty&=~(1<<hr);
+                cur->isconst&=~(1<<hr);
+                return;
+              }
+            }
+          }
+          for(hr=0;hr<HOST_REGS;hr++) {
+            if(hr!=HOST_CCREG||j<hsn[CCREG]) {
+              if(cur->regmap[hr]==r) {
+                cur->regmap[hr]=reg;
+                cur->dirty&=~(1<<hr);
+                cur->isconst&=~(1<<hr);
+                return;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  for(j=10;j>=0;j--)
+  {
+    for(r=1;r<=MAXREG;r++)
+    {
+      if(hsn[r]==j) {
+        for(hr=0;hr<HOST_REGS;hr++) {
+          if(cur->regmap[hr]==r+64) {
+            cur->regmap[hr]=reg;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+        for(hr=0;hr<HOST_REGS;hr++) {
+          if(cur->regmap[hr]==r) {
+            cur->regmap[hr]=reg;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+      }
+    }
+  }
+  DebugMessage(M64MSG_ERROR, "This shouldn't happen (alloc_reg)");exit(1);
+}
+
+static void alloc_reg64(struct regstat *cur,int i,signed char reg)
+{
+  // Upper halves go to %r8-%r14 by default
+  int preferred_reg = 14-reg%7;
+  int r,hr;
+
+  // allocate the lower 32 bits
+  alloc_reg(cur,i,reg);
+
+  // Don't allocate unused registers
+  if((cur->uu>>reg)&1) return;
+
+  // see if the upper half is already allocated
+  for(hr=0;hr<HOST_REGS;hr++)
+  {
+    if(cur->regmap[hr]==reg+64) return;
+  }
+
+  // Keep the same mapping if the register was already allocated in a loop
+  preferred_reg = loop_reg(i,reg,preferred_reg);
+
+  // Try to allocate the preferred register
+  if(cur->regmap[preferred_reg]==-1) {
+    cur->regmap[preferred_reg]=reg|64;
+    cur->dirty&=~(1<<preferred_reg);
+    cur->isconst&=~(1<<preferred_reg);
+    return;
+  }
+  r=cur->regmap[preferred_reg];
+  if(r<64&&((cur->u>>r)&1)) {
+    cur->regmap[preferred_reg]=reg|64;
+    cur->dirty&=~(1<<preferred_reg);
+    cur->isconst&=~(1<<preferred_reg);
+    return;
+  }
+  if(r>=64&&((cur->uu>>(r&63))&1)) {
+    cur->regmap[preferred_reg]=reg|64;
+    cur->dirty&=~(1<<preferred_reg);
+    cur->isconst&=~(1<<preferred_reg);
+    return;
+  }
+
+  // Clear any unneeded registers
+  // We try to keep the mapping consistent, if possible, because it
+  // makes branches easier (especially loops).  So we try to allocate
+  // first (see above) before removing old mappings.  If this is not
+  // possible then go ahead and clear out the registers that are no
+  // longer needed.
+  for(hr=HOST_REGS-1;hr>=0;hr--)
+  {
+    r=cur->regmap[hr];
+    if(r>=0) {
+      if(r<64) {
+        if((cur->u>>r)&1) {cur->regmap[hr]=-1;break;}
+      }
+      else
+      {
+        if((cur->uu>>(r&63))&1) {cur->regmap[hr]=-1;break;}
+      }
+    }
+  }
+  // Try to allocate any available register, but prefer
+  // registers that have not been used recently.
+  if(i>0) {
+    for(hr=0;hr<HOST_REGS;hr++) {
+      if(hr!=EXCLUDE_REG&&cur->regmap[hr]==-1) {
+        if(regs[i-1].regmap[hr]!=rs1[i-1]&&regs[i-1].regmap[hr]!=rs2[i-1]&&regs[i-1].regmap[hr]!=rt1[i-1]&&regs[i-1].regmap[hr]!=rt2[i-1]) {
+          cur->regmap[hr]=reg|64;
+          cur->dirty&=~(1<<hr);
+          cur->isconst&=~(1<<hr);
+          return;
+        }
+      }
+    }
+  }
+  // Try to allocate any available register
+  for(hr=0;hr<HOST_REGS;hr++) {
+    if(hr!=EXCLUDE_REG&&cur->regmap[hr]==-1) {
+      cur->regmap[hr]=reg|64;
+      cur->dirty&=~(1<<hr);
+      cur->isconst&=~(1<<hr);
+      return;
+    }
+  }
+
+  // Ok, now we have to evict someone
+  // Pick a register we hopefully won't need soon
+  u_char hsn[MAXREG+1];
+  memset(hsn,10,sizeof(hsn));
+  int j;
+  lsn(hsn,i,&preferred_reg);
+  if(i>0) {
+    // Don't evict the cycle count at entry points, otherwise the entry
+    // stub will have to write it.
+    if(bt[i]&&hsn[CCREG]>2) hsn[CCREG]=2;
+    if(i>1&&hsn[CCREG]>2&&(itype[i-2]==RJUMP||itype[i-2]==UJUMP||itype[i-2]==CJUMP||itype[i-2]==SJUMP||itype[i-2]==FJUMP)) hsn[CCREG]=2;
+    for(j=10;j>=3;j--)
+    {
+      // Alloc preferred register if available
+      if(hsn[r=cur->regmap[preferred_reg]&63]==j) {
+        for(hr=0;hr<HOST_REGS;hr++) {
+          // Evict both parts of a 64-bit register
+          if((cur->regmap[hr]&63)==r) {
+            cur->regmap[hr]=-1;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+          }
+        }
+        cur->regmap[preferred_reg]=reg|64;
+        return;
+      }
+      for(r=1;r<=MAXREG;r++)
+      {
+        if(hsn[r]==j&&r!=rs1[i-1]&&r!=rs2[i-1]&&r!=rt1[i-1]&&r!=rt2[i-1]) {
+          for(hr=0;hr<HOST_REGS;hr++) {
+            if(hr!=HOST_CCREG||j<hsn[CCREG]) {
+              if(cur->regmap[hr]==r+64) {
+                cur->regmap[hr]=reg|64;
+                cur->dirty&=~(1<<hr);
+                cur->isconst&=~(1<<hr);
+                return;
+              }
+            }
+          }
+          for(hr=0;hr<HOST_REGS;hr++) {
+            if(hr!=HOST_CCREG||j<hsn[CCREG]) {
+              if(cur->regmap[hr]==r) {
+                cur->regmap[hr]=reg|64;
+                cur->dirty&=~(1<<hr);
+                cur->isconst&=~(1<<hr);
+                return;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  for(j=10;j>=0;j--)
+  {
+    for(r=1;r<=MAXREG;r++)
+    {
+      if(hsn[r]==j) {
+        for(hr=0;hr<HOST_REGS;hr++) {
+          if(cur->regmap[hr]==r+64) {
+            cur->regmap[hr]=reg|64;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+        for(hr=0;hr<HOST_REGS;hr++) {
+          if(cur->regmap[hr]==r) {
+            cur->regmap[hr]=reg|64;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+      }
+    }
+  }
+  DebugMessage(M64MSG_ERROR, "This shouldn't happen");exit(1);
+}
+
+// Allocate a temporary register.  This is done without regard to
+// dirty status or whether the register we request is on the unneeded list
+// Note: This will only allocate one register, even if called multiple times
+static void alloc_reg_temp(struct regstat *cur,int i,signed char reg)
+{
+  int r,hr;
+  int preferred_reg = -1;
+
+  // see if it's already allocated
+  for(hr=0;hr<HOST_REGS;hr++)
+  {
+    if(hr!=EXCLUDE_REG&&cur->regmap[hr]==reg) return;
+  }
+
+  // Try to allocate any available register, starting with R14, R13, R12...
+  for(hr=HOST_REGS-1;hr>=0;hr--) {
+    if(hr!=EXCLUDE_REG&&cur->regmap[hr]==-1) {
+      cur->regmap[hr]=reg;
+      cur->dirty&=~(1<<hr);
+      cur->isconst&=~(1<<hr);
+      return;
+    }
+  }
+
+  // Find an unneeded register
+  for(hr=HOST_REGS-1;hr>=0;hr--)
+  {
+    r=cur->regmap[hr];
+    if(r>=0) {
+      if(r<64) {
+        if((cur->u>>r)&1) {
+          if(i==0||((unneeded_reg[i-1]>>r)&1)) {
+            cur->regmap[hr]=reg;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+      }
+      else
+      {
+        if((cur->uu>>(r&63))&1) {
+          if(i==0||((unneeded_reg_upper[i-1]>>(r&63))&1)) {
+            cur->regmap[hr]=reg;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+      }
+    }
+  }
+
+  // Ok, now we have to evict someone
+  // Pick a register we hopefully won't need soon
+  // TODO: we might want to follow unconditional jumps here
+  // TODO: get rid of dupe code and make this into a function
+  u_char hsn[MAXREG+1];
+  memset(hsn,10,sizeof(hsn));
+  int j;
+  lsn(hsn,i,&preferred_reg);
+  if(i>0) {
+    // Don't evict the cycle count at entry points, otherwise the entry
+    // stub will have to write it.
+    if(bt[i]&&hsn[CCREG]>2) hsn[CCREG]=2;
+    if(i>1&&hsn[CCREG]>2&&(itype[i-2]==RJUMP||itype[i-2]==UJUMP||itype[i-2]==CJUMP||itype[i-2]==SJUMP||itype[i-2]==FJUMP)) hsn[CCREG]=2;
+    for(j=10;j>=3;j--)
+    {
+      for(r=1;r<=MAXREG;r++)
+      {
+        if(hsn[r]==j&&r!=rs1[i-1]&&r!=rs2[i-1]&&r!=rt1[i-1]&&r!=rt2[i-1]) {
+          for(hr=0;hr<HOST_REGS;hr++) {
+            if(hr!=HOST_CCREG||hsn[CCREG]>2) {
+              if(cur->regmap[hr]==r+64) {
+                cur->regmap[hr]=reg;
+                cur->dirty&=~(1<<hr);
+                cur->isconst&=~(1<<hr);
+                return;
+              }
+            }
+          }
+          for(hr=0;hr<HOST_REGS;hr++) {
+            if(hr!=HOST_CCREG||hsn[CCREG]>2) {
+              if(cur->regmap[hr]==r) {
+                cur->regmap[hr]=reg;
+                cur->dirty&=~(1<<hr);
+                cur->isconst&=~(1<<hr);
+                return;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  for(j=10;j>=0;j--)
+  {
+    for(r=1;r<=MAXREG;r++)
+    {
+      if(hsn[r]==j) {
+        for(hr=0;hr<HOST_REGS;hr++) {
+          if(cur->regmap[hr]==r+64) {
+            cur->regmap[hr]=reg;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+        for(hr=0;hr<HOST_REGS;hr++) {
+          if(cur->regmap[hr]==r) {
+            cur->regmap[hr]=reg;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+      }
+    }
+  }
+  DebugMessage(M64MSG_ERROR, "This shouldn't happen");exit(1);
+}
+// Allocate a specific x86 register.
+static void alloc_x86_reg(struct regstat *cur,int i,signed char reg,int hr)
+{
+  int n;
+  int dirty=0;
+
+  // see if it's already allocated (and dealloc it)
+  for(n=0;n<HOST_REGS;n++)
+  {
+    if(n!=ESP&&cur->regmap[n]==reg) {
+      dirty=(cur->dirty>>n)&1;
+      cur->regmap[n]=-1;
+    }
+  }
+
+  cur->regmap[hr]=reg;
+  cur->dirty&=~(1<<hr);
+  cur->dirty|=dirty<<hr;
+  cur->isconst&=~(1<<hr);
+}
+
+// Alloc cycle count into dedicated register
+static void alloc_cc(struct regstat *cur,int i)
+{
+  alloc_x86_reg(cur,i,CCREG,HOST_CCREG);
+}
+
+/* Special alloc */
+
+static void multdiv_alloc_x86(struct regstat *current,int i)
+{
+  //  case 0x18: MULT
+  //  case 0x19: MULTU
+  //  case 0x1A: DIV
+  //  case 0x1B: DIVU
+  //  case 0x1C: DMULT
+  //  case 0x1D: DMULTU
+  //  case 0x1E: DDIV
+  //  case 0x1F: DDIVU
+  clear_const(current,rs1[i]);
+  clear_const(current,rs2[i]);
+  if(rs1[i]&&rs2[i])
+  {
+    if((opcode2[i]&4)==0) // 32-bit
+    {
+      current->u&=~(1LL<<HIREG);
+      current->u&=~(1LL<<LOREG);
+      alloc_x86_reg(current,i,HIREG,EDX);
+      alloc_x86_reg(current,i,LOREG,EAX);
+      alloc_reg(current,i,rs1[i]);
+      alloc_reg(current,i,rs2[i]);
+      current->is32|=1LL<<HIREG;
+      current->is32|=1LL<<LOREG;
+      dirty_reg(current,HIREG);
+      dirty_reg(current,LOREG);
+    }
+    else // 64-bit
+    {
+      alloc_x86_reg(current,i,HIREG|64,EDX);
+      alloc_x86_reg(current,i,HIREG,EAX);
+      alloc_reg64(current,i,rs1[i]);
+      alloc_reg64(current,i,rs2[i]);
+      alloc_all(current,i);
+      current->is32&=~(1LL<<HIREG);
+      current->is32&=~(1LL<<LOREG);
+      dirty_reg(current,HIREG);
+      dirty_reg(current,LOREG);
+    }
+  }
+  else
+  {
+    // Multiply by zero is zero.
+    // MIPS does not have a divide by zero exception.
+    // The result is undefined, we return zero.
+    alloc_reg(current,i,HIREG);
+    alloc_reg(current,i,LOREG);
+    current->is32|=1LL<<HIREG;
+    current->is32|=1LL<<LOREG;
+    dirty_reg(current,HIREG);
+    dirty_reg(current,LOREG);
+  }
+}
+#define multdiv_alloc multdiv_alloc_x86
+
+/* Assembler */
+
+static const char regname[16][5] = {
+ "eax",
+ "ecx",
+ "edx",
+ "ebx",
+ "esp",
+ "ebp",
+ "esi",
+ "edi",
+ "r8d",
+ "r9d",
+ "r10d",
+ "r11d",
+ "r12d",
+ "r13d",
+ "r14d",
+ "r15d"};
+
+static void output_byte(u_char byte)
+{
+  *(out++)=byte;
+}
+static void output_modrm(u_char mod,u_char rm,u_char ext)
+{
+  assert(mod<4);
+  assert(rm<16);
+  assert(ext<16);
+  u_char byte=(mod<<6)|((ext&7)<<3)|(rm&7);
+  *(out++)=byte;
+}
+static void output_sib(u_char scale,u_char index,u_char base)
+{
+  assert(scale<4);
+  assert(index<16);
+  assert(base<16);
+  u_char byte=(scale<<6)|((index&7)<<3)|(base&7);
+  *(out++)=byte;
+}
+static void output_w32(u_int word)
+{
+  *((u_int *)out)=word;
+  out+=4;
+}
+static void output_w64(uint64_t dword)
+{
+  *((uint64_t *)out)=dword;
+  out+=8;
+}
+
+// REX prefix, only emitted if one of the fields needs it.
+// w selects a 64-bit operation, r, x and b are the registers
+// encoded in the modrm reg, sib index and modrm rm/sib base fields.
+static void output_rex(int w,int r,int x,int b)
+{
+  u_char rex=0x40|(w<<3)|(((r>>3)&1)<<2)|(((x>>3)&1)<<1)|((b>>3)&1);
+  if(rex!=0x40) output_byte(rex);
+}
+// Byte operations need a REX prefix to access %spl, %bpl, %sil and %dil
+// instead of %ah, %ch, %dh and %bh.
+static void output_rex_byte(int r,int x,int b,int byte_reg)
+{
+  u_char rex=0x40|(((r>>3)&1)<<2)|(((x>>3)&1)<<1)|((b>>3)&1);
+  if(rex!=0x40||(byte_reg>=4&&byte_reg<8)) output_byte(rex);
+}
+// disp(base)
+static void output_mem(int ext,int base,int disp)
+{
+  if(disp==0&&(base&7)!=EBP) {
+    output_modrm(0,base,ext);
+    if((base&7)==ESP) output_sib(0,4,base);
+  }
+  else if(disp<128&&disp>=-128) {
+    output_modrm(1,base,ext);
+    if((base&7)==ESP) output_sib(0,4,base);
+    output_byte(disp);
+  }
+  else
+  {
+    output_modrm(2,base,ext);
+    if((base&7)==ESP) output_sib(0,4,base);
+    output_w32(disp);
+  }
+}
+// disp(base,index,1<<scale)
+static void output_mem_indexed(int ext,int base,int index,int scale,int disp)
+{
+  assert(index!=ESP);
+  if(disp==0&&(base&7)!=EBP) {
+    output_modrm(0,4,ext);
+    output_sib(scale,index,base);
+  }
+  else if(disp<128&&disp>=-128) {
+    output_modrm(1,4,ext);
+    output_sib(scale,index,base);
+    output_byte(disp);
+  }
+  else
+  {
+    output_modrm(2,4,ext);
+    output_sib(scale,index,base);
+    output_w32(disp);
+  }
+}
+// addr(%rip), imm_size is the size of any immediate following the
+// displacement, since the offset is relative to the next instruction
+static void output_riprel(int ext,intptr_t addr,int imm_size)
+{
+  output_modrm(0,5,ext);
+  intptr_t offset=addr-((intptr_t)out+4+imm_size);
+  assert(offset==(int)offset);
+  output_w32(offset);
+}
+static void output_rel32(intptr_t addr)
+{
+  // Small targets are placeholders to be patched by set_jump_target
+  intptr_t offset=addr<4?0:addr-((intptr_t)out+4);
+  assert(offset==(int)offset);
+  output_w32(offset);
+}
+
+static void emit_mov(int rs,int rt)
+{
+  // 64-bit, since registers may hold host pointers (see emit_loadreg)
+  assem_debug("mov %%%s,%%%s",regname[rs],regname[rt]);
+  output_rex(1,rs,0,rt);
+  output_byte(0x89);
+  output_modrm(3,rt,rs);
+}
+
+static void emit_add(int rs1,int rs2,int rt)
+{
+  if(rs1==rt) {
+    assem_debug("add %%%s,%%%s",regname[rs2],regname[rs1]);
+    output_rex(0,rs2,0,rs1);
+    output_byte(0x01);
+    output_modrm(3,rs1,rs2);
+  }else if(rs2==rt) {
+    assem_debug("add %%%s,%%%s",regname[rs1],regname[rs2]);
+    output_rex(0,rs1,0,rs2);
+    output_byte(0x01);
+    output_modrm(3,rs2,rs1);
+  }else {
+    emit_mov(rs1,rt);
+    emit_add(rt,rs2,rt);
+  }
+}
+
+static void emit_adc(int rs1,int rs2,int rt)
+{
+  if(rs1==rt) {
+    assem_debug("adc %%%s,%%%s",regname[rs2],regname[rs1]);
+    output_rex(0,rs2,0,rs1);
+    output_byte(0x11);
+    output_modrm(3,rs1,rs2);
+  }else if(rs2==rt) {
+    assem_debug("adc %%%s,%%%s",regname[rs1],regname[rs2]);
+    output_rex(0,rs1,0,rs2);
+    output_byte(0x11);
+    output_modrm(3,rs2,rs1);
+  }else {
+    emit_mov(rs1,rt);
+    emit_adc(rt,rs2,rt);
+  }
+}
+
+static void emit_adds(int rs1,int rs2,int rt)
+{
+  emit_add(rs1,rs2,rt);
+}
+
+static void emit_lea8(int rs1,int rt)
+{
+  assem_debug("lea 0(%%%s,8),%%%s",regname[rs1],regname[rt]);
+  output_rex(0,rt,rs1,0);
+  output_byte(0x8D);
+  output_modrm(0,4,rt);
+  output_sib(3,rs1,5);
+  output_w32(0);
+}
+
+static void emit_neg(int rs, int rt)
+{
+  if(rs!=rt) emit_mov(rs,rt);
+  assem_debug("neg %%%s",regname[rt]);
+  output_rex(0,0,0,rt);
+  output_byte(0xF7);
+  output_modrm(3,rt,3);
+}
+
+static void emit_negs(int rs, int rt)
+{
+  emit_neg(rs,rt);
+}
+
+static void emit_sub(int rs1,int rs2,int rt)
+{
+  if(rs1==rt) {
+    assem_debug("sub %%%s,%%%s",regname[rs2],regname[rs1]);
+    output_rex(0,rs2,0,rs1);
+    output_byte(0x29);
+    output_modrm(3,rs1,rs2);
+  } else if(rs2==rt) {
+    emit_neg(rs2,rs2);
+    emit_add(rs2,rs1,rs2);
+  } else {
+    emit_mov(rs1,rt);
+    emit_sub(rt,rs2,rt);
+  }
+}
+
+static void emit_subs(int rs1,int rs2,int rt)
+{
+  emit_sub(rs1,rs2,rt);
+}
+
+static void emit_zeroreg(int rt)
+{
+  output_rex(0,rt,0,rt);
+  output_byte(0x31);
+  output_modrm(3,rt,rt);
+  assem_debug("xor %%%s,%%%s",regname[rt],regname[rt]);
+}
+
+// Load a host pointer
+static void emit_readptr(intptr_t addr, int rt)
+{
+  assem_debug("mov %x,%%%s",(int)addr,regname[rt]);
+  output_rex(1,rt,0,0);
+  output_byte(0x8B);
+  output_riprel(rt,addr,0);
+}
+static void emit_leaptr(intptr_t addr, int rt)
+{
+  assem_debug("lea %x,%%%s",(int)addr,regname[rt]);
+  output_rex(1,rt,0,0);
+  output_byte(0x8D);
+  output_riprel(rt,addr,0);
+}
+
+static void emit_loadreg(int r, int hr)
+{
+  if((r&63)==0)
+    emit_zeroreg(hr);
+  else if(r==MMREG)
+    emit_leaptr((intptr_t)memory_map,hr);
+  else if(r==ROREG)
+    emit_readptr((intptr_t)&ram_offset,hr);
+  else if(r==INVCP)
+    emit_readptr((intptr_t)&invc_ptr,hr);
+  else {
+    intptr_t addr=((intptr_t)reg)+((r&63)<<3)+((r&64)>>4);
+    if((r&63)==HIREG) addr=(intptr_t)&hi+((r&64)>>4);
+    if((r&63)==LOREG) addr=(intptr_t)&lo+((r&64)>>4);
+    if(r==CCREG) addr=(intptr_t)&cycle_count;
+    if(r==CSREG) addr=(intptr_t)&g_cp0_regs[CP0_STATUS_REG];
+    if(r==FSREG) addr=(intptr_t)&FCR31;
+    assem_debug("mov %x+%d,%%%s",(int)addr,r,regname[hr]);
+    output_rex(0,hr,0,0);
+    output_byte(0x8B);
+    output_riprel(hr,addr,0);
+  }
+}
+static void emit_storereg(int r, int hr)
+{
+  intptr_t addr=((intptr_t)reg)+((r&63)<<3)+((r&64)>>4);
+  if((r&63)==HIREG) addr=(intptr_t)&hi+((r&64)>>4);
+  if((r&63)==LOREG) addr=(intptr_t)&lo+((r&64)>>4);
+  if(r==CCREG) addr=(intptr_t)&cycle_count;
+  if(r==FSREG) addr=(intptr_t)&FCR31;
+  assem_debug("mov %%%s,%x+%d",regname[hr],(int)addr,r);
+  output_rex(0,hr,0,0);
+  output_byte(0x89);
+  output_riprel(hr,addr,0);
+}
+
+static void emit_test(int rs, int rt)
+{
+  assem_debug("test %%%s,%%%s",regname[rs],regname[rt]);
+  output_rex(0,rt,0,rs);
+  output_byte(0x85);
+  output_modrm(3,rs,rt);
+}
+
+static void emit_testimm(int rs,int imm)
+{
+  assem_debug("test $0x%x,%%%s",imm,regname[rs]);
+  if(imm<128&&imm>=0) {
+    output_rex_byte(0,0,rs,rs);
+    output_byte(0xF6);
+    output_modrm(3,rs,0);
+    output_byte(imm);
+  }
+  else
+  {
+    output_rex(0,0,0,rs);
+    output_byte(0xF7);
+    output_modrm(3,rs,0);
+    output_w32(imm);
+  }
+}
+
+static void emit_not(int rs,int rt)
+{
+  if(rs!=rt) emit_mov(rs,rt);
+  assem_debug("not %%%s",regname[rt]);
+  output_rex(0,0,0,rt);
+  output_byte(0xF7);
+  output_modrm(3,rt,2);
+}
+
+// Two operand ALU operation (op %rs2,%rs1), 32-bit
+static void emit_alu(u_char op,u_int rs1,u_int rs2,u_int rt)
+{
+  assert(rs1<16);
+  assert(rs2<16);
+  assert(rt<16);
+  if(rs1==rt) {
+    output_rex(0,rs2,0,rs1);
+    output_byte(op);
+    output_modrm(3,rs1,rs2);
+  }
+  else
+  if(rs2==rt) {
+    output_rex(0,rs1,0,rs2);
+    output_byte(op);
+    output_modrm(3,rs2,rs1);
+  }
+  else {
+    emit_mov(rs1,rt);
+    emit_alu(op,rt,rs2,rt);
+  }
+}
+
+static void emit_and(u_int rs1,u_int rs2,u_int rt)
+{
+  assem_debug("and %%%s,%%%s,%%%s",regname[rs1],regname[rs2],regname[rt]);
+  emit_alu(0x21,rs1,rs2,rt);
+}
+
+static void emit_or(u_int rs1,u_int rs2,u_int rt)
+{
+  assem_debug("or %%%s,%%%s,%%%s",regname[rs1],regname[rs2],regname[rt]);
+  emit_alu(0x09,rs1,rs2,rt);
+}
+static void emit_or_and_set_flags(int rs1,int rs2,int rt)
+{
+  emit_or(rs1,rs2,rt);
+}
+
+static void emit_xor(u_int rs1,u_int rs2,u_int rt)
+{
+  assem_debug("xor %%%s,%%%s,%%%s",regname[rs1],regname[rs2],regname[rt]);
+  emit_alu(0x31,rs1,rs2,rt);
+}
+
+static void emit_movimm(int imm,u_int rt)
+{
+  assem_debug("mov $%d,%%%s",imm,regname[rt]);
+  assert(rt<16);
+  output_rex(0,0,0,rt);
+  output_byte(0xB8+(rt&7));
+  output_w32(imm);
+}
+
+// Immediate ALU operation (group 1, ext selects the operation)
+static void emit_aluimm(int w,int ext,int imm,int rt)
+{
+  output_rex(w,0,0,rt);
+  if(imm<128&&imm>=-128) {
+    output_byte(0x83);
+    output_modrm(3,rt,ext);
+    output_byte(imm);
+  }
+  else
+  {
+    output_byte(0x81);
+    output_modrm(3,rt,ext);
+    output_w32(imm);
+  }
+}
+
+static void emit_addimm(int rs,int imm,int rt)
+{
+  if(rs==rt) {
+    if(imm!=0) {
+      assem_debug("add $%d,%%%s",imm,regname[rt]);
+      emit_aluimm(rt==ESP,0,imm,rt);
+    }
+  }
+  else {
+    if(imm!=0) {
+      assem_debug("lea %d(%%%s),%%%s",imm,regname[rs],regname[rt]);
+      output_rex(0,rt,0,rs);
+      output_byte(0x8D);
+      output_mem(rt,rs,imm);
+    }else{
+      emit_mov(rs,rt);
+    }
+  }
+}
+
+static void emit_addimm_and_set_flags(int imm,int rt)
+{
+  assem_debug("add $%d,%%%s",imm,regname[rt]);
+  emit_aluimm(0,0,imm,rt);
+}
+
+static void emit_adcimm(int imm,u_int rt)
+{
+  assem_debug("adc $%d,%%%s",imm,regname[rt]);
+  assert(rt<16);
+  emit_aluimm(0,2,imm,rt);
+}
+static void emit_sbbimm(int imm,u_int rt)
+{
+  assem_debug("sbb $%d,%%%s",imm,regname[rt]);
+  assert(rt<16);
+  emit_aluimm(0,3,imm,rt);
+}
+
+static void emit_addimm64_32(int rsh,int rsl,int imm,int rth,int rtl)
+{
+  if(rsh==rth&&rsl==rtl) {
+    assem_debug("add $%d,%%%s",imm,regname[rtl]);
+    emit_aluimm(0,0,imm,rtl);
+    assem_debug("adc $%d,%%%s",imm>>31,regname[rth]);
+    output_rex(0,0,0,rth);
+    output_byte(0x83);
+    output_modrm(3,rth,2);
+    output_byte(imm>>31);
+  }
+  else {
+    emit_mov(rsh,rth);
+    emit_mov(rsl,rtl);
+    emit_addimm64_32(rth,rtl,imm,rth,rtl);
+  }
+}
+
+static void emit_sbb(int rs1,int rs2)
+{
+  assem_debug("sbb %%%s,%%%s",regname[rs1],regname[rs2]);
+  output_rex(0,rs1,0,rs2);
+  output_byte(0x19);
+  output_modrm(3,rs2,rs1);
+}
+
+static void emit_andimm(int rs,int imm,int rt)
+{
+  if(imm==0) {
+    emit_zeroreg(rt);
+  }
+  else if(rs==rt) {
+    assem_debug("and $%d,%%%s",imm,regname[rt]);
+    // A negative mask is sign extended to 64 bits, so that it can be
+    // applied to host pointers (see storelr_assemble)
+    emit_aluimm(imm<0||rt==ESP,4,imm,rt);
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_andimm(rt,imm,rt);
+  }
+}
+
+static void emit_orimm(int rs,int imm,int rt)
+{
+  if(rs==rt) {
+    if(imm!=0) {
+      assem_debug("or $%d,%%%s",imm,regname[rt]);
+      emit_aluimm(0,1,imm,rt);
+    }
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_orimm(rt,imm,rt);
+  }
+}
+
+static void emit_xorimm(int rs,int imm,int rt)
+{
+  if(rs==rt) {
+    if(imm!=0) {
+      assem_debug("xor $%d,%%%s",imm,regname[rt]);
+      emit_aluimm(0,6,imm,rt);
+    }
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_xorimm(rt,imm,rt);
+  }
+}
+
+// Shift or rotate by an immediate (group 2, ext selects the operation)
+static void emit_shiftimm(int w,int ext,u_int imm,int rt)
+{
+  assert(imm>0);
+  output_rex(w,0,0,rt);
+  if(imm==1) output_byte(0xD1);
+  else output_byte(0xC1);
+  output_modrm(3,rt,ext);
+  if(imm>1) output_byte(imm);
+}
+
+static void emit_shlimm(int rs,u_int imm,int rt)
+{
+  if(rs==rt) {
+    assem_debug("shl %%%s,%d",regname[rt],imm);
+    emit_shiftimm(0,4,imm,rt);
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_shlimm(rt,imm,rt);
+  }
+}
+
+static void emit_shrimm(int rs,u_int imm,int rt)
+{
+  if(rs==rt) {
+    assem_debug("shr %%%s,%d",regname[rt],imm);
+    emit_shiftimm(0,5,imm,rt);
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_shrimm(rt,imm,rt);
+  }
+}
+
+static void emit_sarimm(int rs,u_int imm,int rt)
+{
+  if(rs==rt) {
+    assem_debug("sar %%%s,%d",regname[rt],imm);
+    emit_shiftimm(0,7,imm,rt);
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_sarimm(rt,imm,rt);
+  }
+}
+
+static void emit_rorimm(int rs,u_int imm,int rt)
+{
+  if(rs==rt) {
+    assem_debug("ror %%%s,%d",regname[rt],imm);
+    emit_shiftimm(0,1,imm,rt);
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_rorimm(rt,imm,rt);
+  }
+}
+
+static void emit_shldimm(int rs,int rs2,u_int imm,int rt)
+{
+  if(rs==rt) {
+    assem_debug("shld %%%s,%%%s,%d",regname[rt],regname[rs2],imm);
+    assert(imm>0);
+    output_rex(0,rs2,0,rt);
+    output_byte(0x0F);
+    output_byte(0xA4);
+    output_modrm(3,rt,rs2);
+    output_byte(imm);
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_shldimm(rt,rs2,imm,rt);
+  }
+}
+
+static void emit_shrdimm(int rs,int rs2,u_int imm,int rt)
+{
+  if(rs==rt) {
+    assem_debug("shrd %%%s,%%%s,%d",regname[rt],regname[rs2],imm);
+    assert(imm>0);
+    output_rex(0,rs2,0,rt);
+    output_byte(0x0F);
+    output_byte(0xAC);
+    output_modrm(3,rt,rs2);
+    output_byte(imm);
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_shrdimm(rt,rs2,imm,rt);
+  }
+}
+
+static void emit_shlcl(int r)
+{
+  assem_debug("shl %%%s,%%cl",regname[r]);
+  output_rex(0,0,0,r);
+  output_byte(0xD3);
+  output_modrm(3,r,4);
+}
+static void emit_shrcl(int r)
+{
+  assem_debug("shr %%%s,%%cl",regname[r]);
+  output_rex(0,0,0,r);
+  output_byte(0xD3);
+  output_modrm(3,r,5);
+}
+static void emit_sarcl(int r)
+{
+  assem_debug("sar %%%s,%%cl",regname[r]);
+  output_rex(0,0,0,r);
+  output_byte(0xD3);
+  output_modrm(3,r,7);
+}
+
+static void emit_shldcl(int r1,int r2)
+{
+  assem_debug("shld %%%s,%%%s,%%cl",regname[r1],regname[r2]);
+  output_rex(0,r2,0,r1);
+  output_byte(0x0F);
+  output_byte(0xA5);
+  output_modrm(3,r1,r2);
+}
+static void emit_shrdcl(int r1,int r2)
+{
+  assem_debug("shrd %%%s,%%%s,%%cl",regname[r1],regname[r2]);
+  output_rex(0,r2,0,r1);
+  output_byte(0x0F);
+  output_byte(0xAD);
+  output_modrm(3,r1,r2);
+}
+
+static void emit_cmpimm(int rs,int imm)
+{
+  assem_debug("cmp $%d,%%%s",imm,regname[rs]);
+  emit_aluimm(0,7,imm,rs);
+}
+
+// cmovcc with a constant in memory
+static void emit_cmov_mem(u_char cc,const u_int *addr,int rt)
+{
+  if(addr==&const_zero) assem_debug(" [zero]");
+  else if(addr==&const_one) assem_debug(" [one]");
+  else assem_debug("");
+  output_rex(0,rt,0,0);
+  output_byte(0x0F);
+  output_byte(0x40+cc);
+  output_riprel(rt,(intptr_t)addr,0);
+}
+static void emit_cmovne(const u_int *addr,int rt)
+{
+  assem_debug("cmovne %x,%%%s",(int)(intptr_t)addr,regname[rt]);
+  emit_cmov_mem(0x5,addr,rt);
+}
+static void emit_cmovl(const u_int *addr,int rt)
+{
+  assem_debug("cmovl %x,%%%s",(int)(intptr_t)addr,regname[rt]);
+  emit_cmov_mem(0xC,addr,rt);
+}
+static void emit_cmovs(const u_int *addr,int rt)
+{
+  assem_debug("cmovs %x,%%%s",(int)(intptr_t)addr,regname[rt]);
+  emit_cmov_mem(0x8,addr,rt);
+}
+static void emit_cmov_reg(u_char cc,int rs,int rt)
+{
+  output_rex(0,rt,0,rs);
+  output_byte(0x0F);
+  output_byte(0x40+cc);
+  output_modrm(3,rs,rt);
+}
+static void emit_cmovne_reg(int rs,int rt)
+{
+  assem_debug("cmovne %%%s,%%%s",regname[rs],regname[rt]);
+  emit_cmov_reg(0x5,rs,rt);
+}
+static void emit_cmovl_reg(int rs,int rt)
+{
+  assem_debug("cmovl %%%s,%%%s",regname[rs],regname[rt]);
+  emit_cmov_reg(0xC,rs,rt);
+}
+static void emit_cmovs_reg(int rs,int rt)
+{
+  assem_debug("cmovs %%%s,%%%s",regname[rs],regname[rt]);
+  emit_cmov_reg(0x8,rs,rt);
+}
+static void emit_cmovnc_reg(int rs,int rt)
+{
+  assem_debug("cmovae %%%s,%%%s",regname[rs],regname[rt]);
+  emit_cmov_reg(0x3,rs,rt);
+}
+static void emit_cmova_reg(int rs,int rt)
+{
+  assem_debug("cmova %%%s,%%%s",regname[rs],regname[rt]);
+  emit_cmov_reg(0x7,rs,rt);
+}
+static void emit_cmovp_reg(int rs,int rt)
+{
+  assem_debug("cmovp %%%s,%%%s",regname[rs],regname[rt]);
+  emit_cmov_reg(0xA,rs,rt);
+}
+static void emit_cmovnp_reg(int rs,int rt)
+{
+  assem_debug("cmovnp %%%s,%%%s",regname[rs],regname[rt]);
+  emit_cmov_reg(0xB,rs,rt);
+}
+static void emit_setl(int rt)
+{
+  assem_debug("setl %%%s",regname[rt]);
+  output_rex_byte(0,0,rt,rt);
+  output_byte(0x0F);
+  output_byte(0x9C);
+  output_modrm(3,rt,2);
+}
+static void emit_movzbl_reg(int rs, int rt)
+{
+  assem_debug("movzbl %%%s,%%%s",regname[rs],regname[rt]);
+  output_rex_byte(rt,0,rs,rs);
+  output_byte(0x0F);
+  output_byte(0xB6);
+  output_modrm(3,rs,rt);
+}
+
+static void emit_slti32(int rs,int imm,int rt)
+{
+  if(rs!=rt) emit_zeroreg(rt);
+  emit_cmpimm(rs,imm);
+  emit_setl(rt);
+  if(rs==rt) emit_movzbl_reg(rt,rt);
+}
+static void emit_sltiu32(int rs,int imm,int rt)
+{
+  if(rs!=rt) emit_zeroreg(rt);
+  emit_cmpimm(rs,imm);
+  if(rs==rt) emit_movimm(0,rt);
+  emit_adcimm(0,rt);
+}
+static void emit_slti64_32(int rsh,int rsl,int imm,int rt)
+{
+  assert(rsh!=rt);
+  emit_slti32(rsl,imm,rt);
+  if(imm>=0)
+  {
+    emit_test(rsh,rsh);
+    emit_cmovne(&const_zero,rt);
+    emit_cmovs(&const_one,rt);
+  }
+  else
+  {
+    emit_cmpimm(rsh,-1);
+    emit_cmovne(&const_zero,rt);
+    emit_cmovl(&const_one,rt);
+  }
+}
+static void emit_sltiu64_32(int rsh,int rsl,int imm,int rt)
+{
+  assert(rsh!=rt);
+  emit_sltiu32(rsl,imm,rt);
+  if(imm>=0)
+  {
+    emit_test(rsh,rsh);
+    emit_cmovne(&const_zero,rt);
+  }
+  else
+  {
+    emit_cmpimm(rsh,-1);
+    emit_cmovne(&const_one,rt);
+  }
+}
+
+static void emit_cmp(int rs,int rt)
+{
+  assem_debug("cmp %%%s,%%%s",regname[rt],regname[rs]);
+  output_rex(0,rt,0,rs);
+  output_byte(0x39);
+  output_modrm(3,rs,rt);
+}
+static void emit_set_gz32(int rs, int rt)
+{
+  //assem_debug("set_gz32");
+  emit_cmpimm(rs,1);
+  emit_movimm(1,rt);
+  emit_cmovl(&const_zero,rt);
+}
+static void emit_set_nz32(int rs, int rt)
+{
+  //assem_debug("set_nz32");
+  emit_cmpimm(rs,1);
+  emit_movimm(1,rt);
+  emit_sbbimm(0,rt);
+}
+static void emit_set_gz64_32(int rsh, int rsl, int rt)
+{
+  //assem_debug("set_gz64");
+  emit_set_gz32(rsl,rt);
+  emit_test(rsh,rsh);
+  emit_cmovne(&const_one,rt);
+  emit_cmovs(&const_zero,rt);
+}
+static void emit_set_nz64_32(int rsh, int rsl, int rt)
+{
+  //assem_debug("set_nz64");
+  emit_or_and_set_flags(rsh,rsl,rt);
+  emit_cmovne(&const_one,rt);
+}
+static void emit_set_if_less32(int rs1, int rs2, int rt)
+{
+  //assem_debug("set if less (%%%s,%%%s),%%%s",regname[rs1],regname[rs2],regname[rt]);
+  if(rs1!=rt&&rs2!=rt) emit_zeroreg(rt);
+  emit_cmp(rs1,rs2);
+  if(rs1==rt||rs2==rt) emit_movimm(0,rt);
+  emit_cmovl(&const_one,rt);
+}
+static void emit_set_if_carry32(int rs1, int rs2, int rt)
+{
+  //assem_debug("set if carry (%%%s,%%%s),%%%s",regname[rs1],regname[rs2],regname[rt]);
+  if(rs1!=rt&&rs2!=rt) emit_zeroreg(rt);
+  emit_cmp(rs1,rs2);
+  if(rs1==rt||rs2==rt) emit_movimm(0,rt);
+  emit_adcimm(0,rt);
+}
+static void emit_set_if_less64_32(int u1, int l1, int u2, int l2, int rt)
+{
+  //assem_debug("set if less64 (%%%s,%%%s,%%%s,%%%s),%%%s",regname[u1],regname[l1],regname[u2],regname[l2],regname[rt]);
+  assert(u1!=rt);
+  assert(u2!=rt);
+  emit_cmp(l1,l2);
+  emit_mov(u1,rt);
+  emit_sbb(u2,rt);
+  emit_movimm(0,rt);
+  emit_cmovl(&const_one,rt);
+}
+static void emit_set_if_carry64_32(int u1, int l1, int u2, int l2, int rt)
+{
+  //assem_debug("set if carry64 (%%%s,%%%s,%%%s,%%%s),%%%s",regname[u1],regname[l1],regname[u2],regname[l2],regname[rt]);
+  assert(u1!=rt);
+  assert(u2!=rt);
+  emit_cmp(l1,l2);
+  emit_mov(u1,rt);
+  emit_sbb(u2,rt);
+  emit_movimm(0,rt);
+  emit_adcimm(0,rt);
+}
+
+static void emit_call(intptr_t a)
+{
+  assem_debug("call %x (%x+%x)",(int)a,(int)(intptr_t)out+5,(int)(a-(intptr_t)out-5));
+  output_byte(0xe8);
+  output_rel32(a);
+}
+static void emit_jmp(intptr_t a)
+{
+  assem_debug("jmp %x (%x+%x)",(int)a,(int)(intptr_t)out+5,(int)(a-(intptr_t)out-5));
+  output_byte(0xe9);
+  output_rel32(a);
+}
+static void emit_jcc(u_char cc,intptr_t a)
+{
+  output_byte(0x0f);
+  output_byte(0x80+cc);
+  output_rel32(a);
+}
+static void emit_jne(intptr_t a)
+{
+  assem_debug("jne %x",(int)a);
+  emit_jcc(0x5,a);
+}
+static void emit_jeq(intptr_t a)
+{
+  assem_debug("jeq %x",(int)a);
+  emit_jcc(0x4,a);
+}
+static void emit_js(intptr_t a)
+{
+  assem_debug("js %x",(int)a);
+  emit_jcc(0x8,a);
+}
+static void emit_jns(intptr_t a)
+{
+  assem_debug("jns %x",(int)a);
+  emit_jcc(0x9,a);
+}
+static void emit_jl(intptr_t a)
+{
+  assem_debug("jl %x",(int)a);
+  emit_jcc(0xc,a);
+}
+static void emit_jge(intptr_t a)
+{
+  assem_debug("jge %x",(int)a);
+  emit_jcc(0xd,a);
+}
+static void emit_jno(intptr_t a)
+{
+  assem_debug("jno %x",(int)a);
+  emit_jcc(0x1,a);
+}
+static void emit_jc(intptr_t a)
+{
+  assem_debug("jc %x",(int)a);
+  emit_jcc(0x2,a);
+}
+static void emit_jae(intptr_t a)
+{
+  assem_debug("jae %x",(int)a);
+  emit_jcc(0x3,a);
+}
+static void emit_jb(intptr_t a)
+{
+  assem_debug("jb %x",(int)a);
+  emit_jcc(0x2,a);
+}
+
+static void emit_pushreg(u_int r)
+{
+  assem_debug("push %%%s",regname[r]);
+  assert(r<16);
+  output_rex(0,0,0,r);
+  output_byte(0x50+(r&7));
+}
+static void emit_popreg(u_int r)
+{
+  assem_debug("pop %%%s",regname[r]);
+  assert(r<16);
+  output_rex(0,0,0,r);
+  output_byte(0x58+(r&7));
+}
+// There is no pusha on x86-64.  Save the caller-saved registers and
+// %rbx (the cycle count), which keeps the stack 16-byte aligned.
+static void emit_pusha()
+{
+  assem_debug("pusha");
+  emit_pushreg(EAX);
+  emit_pushreg(ECX);
+  emit_pushreg(EDX);
+  emit_pushreg(EBX);
+  emit_pushreg(ESI);
+  emit_pushreg(EDI);
+  emit_pushreg(8);
+  emit_pushreg(9);
+  emit_pushreg(10);
+  emit_pushreg(11);
+}
+static void emit_popa()
+{
+  assem_debug("popa");
+  emit_popreg(11);
+  emit_popreg(10);
+  emit_popreg(9);
+  emit_popreg(8);
+  emit_popreg(EDI);
+  emit_popreg(ESI);
+  emit_popreg(EBX);
+  emit_popreg(EDX);
+  emit_popreg(ECX);
+  emit_popreg(EAX);
+}
+// Size of the frame pushed by emit_pusha
+#define PUSHA_SIZE 80
+static void emit_callreg(u_int r)
+{
+  assem_debug("call *%%%s",regname[r]);
+  assert(r<16);
+  output_rex(0,0,0,r);
+  output_byte(0xFF);
+  output_modrm(3,r,2);
+}
+
+static void emit_readword(intptr_t addr, int rt)
+{
+  assem_debug("mov %x,%%%s",(int)addr,regname[rt]);
+  output_rex(0,rt,0,0);
+  output_byte(0x8B);
+  output_riprel(rt,addr,0);
+}
+static void emit_readword_indexed(int addr, int rs, int rt)
+{
+  assem_debug("mov %x+%%%s,%%%s",addr,regname[rs],regname[rt]);
+  output_rex(0,rt,0,rs);
+  output_byte(0x8B);
+  output_mem(rt,rs,addr);
+}
+// Constant addresses in the unmapped segments have no map register,
+// load the ram offset into the temporary register instead.
+static int get_map(int map)
+{
+  if(map<0) {
+    emit_readptr((intptr_t)&ram_offset,HOST_TEMPREG);
+    map=HOST_TEMPREG;
+  }
+  return map;
+}
+static void emit_readword_indexed_tlb(int addr, int rs, int map, int rt)
+{
+  map=get_map(map);
+  assem_debug("mov %x(%%%s,%%%s,4),%%%s",addr,regname[rs],regname[map],regname[rt]);
+  output_rex(0,rt,map,rs);
+  output_byte(0x8B);
+  output_mem_indexed(rt,rs,map,2,addr);
+}
+static void emit_readdword_indexed_tlb(int addr, int rs, int map, int rh, int rl)
+{
+  assert(rh!=rs);
+  if(rh>=0) emit_readword_indexed_tlb(addr, rs, map, rh);
+  emit_readword_indexed_tlb(addr+4, rs, map, rl);
+}
+// movsbl, movswl, movzbl and movzwl
+static void emit_movx(u_char op,intptr_t addr,int rt)
+{
+  output_rex(0,rt,0,0);
+  output_byte(0x0F);
+  output_byte(op);
+  output_riprel(rt,addr,0);
+}
+static void emit_movx_indexed(u_char op,int addr,int rs,int rt)
+{
+  output_rex(0,rt,0,rs);
+  output_byte(0x0F);
+  output_byte(op);
+  output_mem(rt,rs,addr);
+}
+static void emit_movx_indexed_tlb(u_char op,int addr,int rs,int map,int rt)
+{
+  map=get_map(map);
+  output_rex(0,rt,map,rs);
+  output_byte(0x0F);
+  output_byte(op);
+  output_mem_indexed(rt,rs,map,2,addr);
+}
+static void emit_movsbl(intptr_t addr, int rt)
+{
+  assem_debug("movsbl %x,%%%s",(int)addr,regname[rt]);
+  emit_movx(0xBE,addr,rt);
+}
+static void emit_movsbl_indexed_tlb(int addr, int rs, int map, int rt)
+{
+  assem_debug("movsbl %x(%%%s,%%%s,4),%%%s",addr,regname[rs],regname[map<0?HOST_TEMPREG:map],regname[rt]);
+  emit_movx_indexed_tlb(0xBE,addr,rs,map,rt);
+}
+static void emit_movswl(intptr_t addr, int rt)
+{
+  assem_debug("movswl %x,%%%s",(int)addr,regname[rt]);
+  emit_movx(0xBF,addr,rt);
+}
+static void emit_movswl_indexed(int addr, int rs, int rt)
+{
+  assem_debug("movswl %x+%%%s,%%%s",addr,regname[rs],regname[rt]);
+  emit_movx_indexed(0xBF,addr,rs,rt);
+}
+static void emit_movzbl(intptr_t addr, int rt)
+{
+  assem_debug("movzbl %x,%%%s",(int)addr,regname[rt]);
+  emit_movx(0xB6,addr,rt);
+}
+static void emit_movzbl_indexed_tlb(int addr, int rs, int map, int rt)
+{
+  assem_debug("movzbl %x(%%%s,%%%s,4),%%%s",addr,regname[rs],regname[map<0?HOST_TEMPREG:map],regname[rt]);
+  emit_movx_indexed_tlb(0xB6,addr,rs,map,rt);
+}
+static void emit_movzwl(intptr_t addr, int rt)
+{
+  assem_debug("movzwl %x,%%%s",(int)addr,regname[rt]);
+  emit_movx(0xB7,addr,rt);
+}
+static void emit_movzwl_indexed(int addr, int rs, int rt)
+{
+  assem_debug("movzwl %x+%%%s,%%%s",addr,regname[rs],regname[rt]);
+  emit_movx_indexed(0xB7,addr,rs,rt);
+}
+
+static void emit_writeword(int rt, intptr_t addr)
+{
+  assem_debug("movl %%%s,%x",regname[rt],(int)addr);
+  output_rex(0,rt,0,0);
+  output_byte(0x89);
+  output_riprel(rt,addr,0);
+}
+static void emit_writeword_indexed(int rt, int addr, int rs)
+{
+  assem_debug("mov %%%s,%x+%%%s",regname[rt],addr,regname[rs]);
+  output_rex(0,rt,0,rs);
+  output_byte(0x89);
+  output_mem(rt,rs,addr);
+}
+static void emit_writeword_indexed_tlb(int rt, int addr, int rs, int map, int temp)
+{
+  map=get_map(map);
+  assem_debug("mov %%%s,%x(%%%s,%%%s,4)",regname[rt],addr,regname[rs],regname[map]);
+  output_rex(0,rt,map,rs);
+  output_byte(0x89);
+  output_mem_indexed(rt,rs,map,2,addr);
+}
+static void emit_writedword_indexed_tlb(int rh, int rl, int addr, int rs, int map, int temp)
+{
+  assert(rh>=0);
+  emit_writeword_indexed_tlb(rh, addr, rs, map, temp);
+  emit_writeword_indexed_tlb(rl, addr+4, rs, map, temp);
+}
+static void emit_writehword(int rt, intptr_t addr)
+{
+  assem_debug("movw %%%s,%x",regname[rt],(int)addr);
+  output_byte(0x66);
+  output_rex(0,rt,0,0);
+  output_byte(0x89);
+  output_riprel(rt,addr,0);
+}
+static void emit_writehword_indexed(int rt, int addr, int rs)
+{
+  assem_debug("movw %%%s,%x+%%%s",regname[rt],addr,regname[rs]);
+  output_byte(0x66);
+  output_rex(0,rt,0,rs);
+  output_byte(0x89);
+  output_mem(rt,rs,addr);
+}
+static void emit_writehword_indexed_tlb(int rt, int addr, int rs, int map, int temp)
+{
+  map=get_map(map);
+  assem_debug("movw %%%s,%x(%%%s,%%%s,4)",regname[rt],addr,regname[rs],regname[map]);
+  output_byte(0x66);
+  output_rex(0,rt,map,rs);
+  output_byte(0x89);
+  output_mem_indexed(rt,rs,map,2,addr);
+}
+static void emit_writebyte(int rt, intptr_t addr)
+{
+  assem_debug("movb %%%s,%x",regname[rt],(int)addr);
+  output_rex_byte(rt,0,0,rt);
+  output_byte(0x88);
+  output_riprel(rt,addr,0);
+}
+static void emit_writebyte_indexed(int rt, int addr, int rs)
+{
+  assem_debug("movb %%%s,%x+%%%s",regname[rt],addr,regname[rs]);
+  output_rex_byte(rt,0,rs,rt);
+  output_byte(0x88);
+  output_mem(rt,rs,addr);
+}
+static void emit_writebyte_indexed_tlb(int rt, int addr, int rs, int map, int temp)
+{
+  map=get_map(map);
+  assem_debug("movb %%%s,%x(%%%s,%%%s,4)",regname[rt],addr,regname[rs],regname[map]);
+  output_rex_byte(rt,map,rs,rt);
+  output_byte(0x88);
+  output_mem_indexed(rt,rs,map,2,addr);
+}
+static void emit_writeword_imm(int imm, intptr_t addr)
+{
+  assem_debug("movl $%x,%x",imm,(int)addr);
+  output_byte(0xC7);
+  output_riprel(0,addr,4);
+  output_w32(imm);
+}
+static void emit_writeword_imm_esp(int imm, int addr)
+{
+  assem_debug("mov $%x,%x(%%rsp)",imm,addr);
+  assert(addr>=-128&&addr<128);
+  output_byte(0xC7);
+  output_mem(0,ESP,addr);
+  output_w32(imm);
+}
+static void emit_writebyte_imm(int imm, intptr_t addr)
+{
+  assem_debug("movb $%x,%x",imm,(int)addr);
+  assert(imm>=-128&&imm<128);
+  output_byte(0xC6);
+  output_riprel(0,addr,1);
+  output_byte(imm);
+}
+// Store a host pointer
+static void emit_writeptr(int rt, intptr_t addr)
+{
+  assem_debug("mov %%%s,%x",regname[rt],(int)addr);
+  output_rex(1,rt,0,0);
+  output_byte(0x89);
+  output_riprel(rt,addr,0);
+}
+
+static void emit_mul(int rs)
+{
+  assem_debug("mul %%%s",regname[rs]);
+  output_rex(0,0,0,rs);
+  output_byte(0xF7);
+  output_modrm(3,rs,4);
+}
+static void emit_imul(int rs)
+{
+  assem_debug("imul %%%s",regname[rs]);
+  output_rex(0,0,0,rs);
+  output_byte(0xF7);
+  output_modrm(3,rs,5);
+}
+static void emit_div(int rs)
+{
+  assem_debug("div %%%s",regname[rs]);
+  output_rex(0,0,0,rs);
+  output_byte(0xF7);
+  output_modrm(3,rs,6);
+}
+static void emit_idiv(int rs)
+{
+  assem_debug("idiv %%%s",regname[rs]);
+  output_rex(0,0,0,rs);
+  output_byte(0xF7);
+  output_modrm(3,rs,7);
+}
+static void emit_cdq()
+{
+  assem_debug("cdq");
+  output_byte(0x99);
+}
+
+// Load 2 immediates optimizing for small code size
+static void emit_mov2imm_compact(int imm1,u_int rt1,int imm2,u_int rt2)
+{
+  emit_movimm(imm1,rt1);
+  if(imm2-imm1<128&&imm2-imm1>=-128) emit_addimm(rt1,imm2-imm1,rt2);
+  else emit_movimm(imm2,rt2);
+}
+
+// special case for checking pending_exception
+static void emit_cmpmem_imm_byte(intptr_t addr,int imm)
+{
+  assert(imm<128&&imm>=-127);
+  assem_debug("cmpb $%d,%x",imm,(int)addr);
+  output_byte(0x80);
+  output_riprel(7,addr,1);
+  output_byte(imm);
+}
+
+// special case for checking invalid_code
+static void emit_cmpmem_indexedsr12_imm(intptr_t addr,int r,int imm)
+{
+  assert(imm<128&&imm>=-127);
+  assert(r>=0&&r<16);
+  assert(addr==(intptr_t)invalid_code);
+  emit_shrimm(r,12,r);
+  // invalid_code may be out of 32-bit reach, go through invc_ptr
+  assem_debug("mov %%%s,%%%s",regname[r],regname[HOST_TEMPREG]);
+  output_rex(0,r,0,HOST_TEMPREG);
+  output_byte(0x89);
+  output_modrm(3,HOST_TEMPREG,r);
+  assem_debug("add %x,%%%s",(int)(intptr_t)&invc_ptr,regname[HOST_TEMPREG]);
+  output_rex(1,HOST_TEMPREG,0,0);
+  output_byte(0x03);
+  output_riprel(HOST_TEMPREG,(intptr_t)&invc_ptr,0);
+  assem_debug("cmpb $%d,(%%%s)",imm,regname[HOST_TEMPREG]);
+  output_rex(0,0,0,HOST_TEMPREG);
+  output_byte(0x80);
+  output_mem(7,HOST_TEMPREG,0);
+  output_byte(imm);
+}
+
+// x87 instruction with a (%r) memory operand
+static void emit_x87_mem(u_char op,int ext,int r)
+{
+  output_rex(0,0,0,r);
+  output_byte(op);
+  output_mem(ext,r,0);
+}
+static void emit_flds(int r)
+{
+  assem_debug("flds (%%%s)",regname[r]);
+  emit_x87_mem(0xd9,0,r);
+}
+static void emit_fldl(int r)
+{
+  assem_debug("fldl (%%%s)",regname[r]);
+  emit_x87_mem(0xdd,0,r);
+}
+static void emit_fucomip(u_int r)
+{
+  assem_debug("fucomip %d",r);
+  assert(r<8);
+  output_byte(0xdf);
+  output_byte(0xe8+r);
+}
+static void emit_fchs()
+{
+  assem_debug("fchs");
+  output_byte(0xd9);
+  output_byte(0xe0);
+}
+static void emit_fabs()
+{
+  assem_debug("fabs");
+  output_byte(0xd9);
+  output_byte(0xe1);
+}
+static void emit_fsqrt()
+{
+  assem_debug("fsqrt");
+  output_byte(0xd9);
+  output_byte(0xfa);
+}
+static void emit_fadds(int r)
+{
+  assem_debug("fadds (%%%s)",regname[r]);
+  emit_x87_mem(0xd8,0,r);
+}
+static void emit_faddl(int r)
+{
+  assem_debug("faddl (%%%s)",regname[r]);
+  emit_x87_mem(0xdc,0,r);
+}
+static void emit_fadd(int r)
+{
+  assem_debug("fadd st%d",r);
+  output_byte(0xd8);
+  output_byte(0xc0+r);
+}
+static void emit_fsubs(int r)
+{
+  assem_debug("fsubs (%%%s)",regname[r]);
+  emit_x87_mem(0xd8,4,r);
+}
+static void emit_fsubl(int r)
+{
+  assem_debug("fsubl (%%%s)",regname[r]);
+  emit_x87_mem(0xdc,4,r);
+}
+static void emit_fsub(int r)
+{
+  assem_debug("fsub st%d",r);
+  output_byte(0xd8);
+  output_byte(0xe0+r);
+}
+static void emit_fmuls(int r)
+{
+  assem_debug("fmuls (%%%s)",regname[r]);
+  emit_x87_mem(0xd8,1,r);
+}
+static void emit_fmull(int r)
+{
+  assem_debug("fmull (%%%s)",regname[r]);
+  emit_x87_mem(0xdc,1,r);
+}
+static void emit_fmul(int r)
+{
+  assem_debug("fmul st%d",r);
+  output_byte(0xd8);
+  output_byte(0xc8+r);
+}
+static void emit_fdivs(int r)
+{
+  assem_debug("fdivs (%%%s)",regname[r]);
+  emit_x87_mem(0xd8,6,r);
+}
+static void emit_fdivl(int r)
+{
+  assem_debug("fdivl (%%%s)",regname[r]);
+  emit_x87_mem(0xdc,6,r);
+}
+static void emit_fdiv(int r)
+{
+  assem_debug("fdiv st%d",r);
+  output_byte(0xd8);
+  output_byte(0xf0+r);
+}
+static void emit_fpop()
+{
+  // fstp st(0)
+  assem_debug("fpop");
+  output_byte(0xdd);
+  output_byte(0xd8);
+}
+static void emit_fildl(int r)
+{
+  assem_debug("fildl (%%%s)",regname[r]);
+  emit_x87_mem(0xdb,0,r);
+}
+static void emit_fildll(int r)
+{
+  assem_debug("fildll (%%%s)",regname[r]);
+  emit_x87_mem(0xdf,5,r);
+}
+static void emit_fistpl(int r)
+{
+  assem_debug("fistpl (%%%s)",regname[r]);
+  emit_x87_mem(0xdb,3,r);
+}
+static void emit_fistpll(int r)
+{
+  assem_debug("fistpll (%%%s)",regname[r]);
+  emit_x87_mem(0xdf,7,r);
+}
+static void emit_fstps(int r)
+{
+  assem_debug("fstps (%%%s)",regname[r]);
+  emit_x87_mem(0xd9,3,r);
+}
+static void emit_fstpl(int r)
+{
+  assem_debug("fstpl (%%%s)",regname[r]);
+  emit_x87_mem(0xdd,3,r);
+}
+static void emit_fnstcw_stack()
+{
+  assem_debug("fnstcw (%%rsp)");
+  emit_x87_mem(0xd9,7,ESP);
+}
+static void emit_fldcw_stack()
+{
+  assem_debug("fldcw (%%rsp)");
+  emit_x87_mem(0xd9,5,ESP);
+}
+static void emit_fldcw_indexed(intptr_t addr,int r)
+{
+  emit_leaptr(addr,HOST_TEMPREG);
+  assem_debug("fldcw (%%%s,%%%s,2)",regname[HOST_TEMPREG],regname[r]);
+  output_rex(0,0,r,HOST_TEMPREG);
+  output_byte(0xd9);
+  output_mem_indexed(5,HOST_TEMPREG,r,1,0);
+}
+static void emit_fldcw(intptr_t addr)
+{
+  assem_debug("fldcw %x",(int)addr);
+  output_byte(0xd9);
+  output_riprel(5,addr,0);
+}
+#ifdef __SSE__
+static void emit_movss_load(u_int addr,u_int ssereg)
+{
+  assem_debug("movss (%%%s),xmm%d",regname[addr],ssereg);
+  assert(ssereg<8);
+  output_byte(0xf3);
+  output_rex(0,ssereg,0,addr);
+  output_byte(0x0f);
+  output_byte(0x10);
+  output_mem(ssereg,addr,0);
+}
+static void emit_movsd_load(u_int addr,u_int ssereg)
+{
+  assem_debug("movsd (%%%s),xmm%d",regname[addr],ssereg);
+  assert(ssereg<8);
+  output_byte(0xf2);
+  output_rex(0,ssereg,0,addr);
+  output_byte(0x0f);
+  output_byte(0x10);
+  output_mem(ssereg,addr,0);
+}
+static void emit_movd_store(u_int ssereg,u_int addr)
+{
+  assem_debug("movd xmm%d,(%%%s)",ssereg,regname[addr]);
+  assert(ssereg<8);
+  output_byte(0x66);
+  output_rex(0,ssereg,0,addr);
+  output_byte(0x0f);
+  output_byte(0x7e);
+  output_mem(ssereg,addr,0);
+}
+static void emit_cvttps2dq(u_int ssereg1,u_int ssereg2)
+{
+  assem_debug("cvttps2dq xmm%d,xmm%d",ssereg1,ssereg2);
+  assert(ssereg1<8);
+  assert(ssereg2<8);
+  output_byte(0xf3);
+  output_byte(0x0f);
+  output_byte(0x5b);
+  output_modrm(3,ssereg1,ssereg2);
+}
+static void emit_cvttpd2dq(u_int ssereg1,u_int ssereg2)
+{
+  assem_debug("cvttpd2dq xmm%d,xmm%d",ssereg1,ssereg2);
+  assert(ssereg1<8);
+  assert(ssereg2<8);
+  output_byte(0x66);
+  output_byte(0x0f);
+  output_byte(0xe6);
+  output_modrm(3,ssereg1,ssereg2);
+}
+#endif
+
+static void emit_movimm64(uint64_t imm,u_int rt)
+{
+  assem_debug("mov $%llx,%%%s",(unsigned long long)imm,regname[rt]);
+  assert(rt<16);
+  output_rex(1,0,0,rt);
+  output_byte(0xB8+(rt&7));
+  output_w64(imm);
+}
+static void emit_xchg(int rs, int rt)
+{
+  assem_debug("xchg %%%s,%%%s",regname[rs],regname[rt]);
+  output_rex(1,rs,0,rt);
+  output_byte(0x87);
+  output_modrm(3,rt,rs);
+}
+static void emit_neg64(int rt)
+{
+  assem_debug("neg %%%s (64-bit)",regname[rt]);
+  output_rex(1,0,0,rt);
+  output_byte(0xF7);
+  output_modrm(3,rt,3);
+}
+// Load a pointer from a table of pointers
+static void emit_movmem_indexedx8(intptr_t addr, int rs, int rt)
+{
+  emit_leaptr(addr,HOST_TEMPREG);
+  assem_debug("mov (%%%s,%%%s,8),%%%s",regname[HOST_TEMPREG],regname[rs],regname[rt]);
+  output_rex(1,rt,rs,HOST_TEMPREG);
+  output_byte(0x8B);
+  output_mem_indexed(rt,HOST_TEMPREG,rs,3,0);
+}
+// lea (rs,map,4),rt for host addresses
+static void emit_leaptr_rrx4(int rs, int map, int rt)
+{
+  assem_debug("lea (%%%s,%%%s,4),%%%s",regname[rs],regname[map],regname[rt]);
+  output_rex(1,rt,map,rs);
+  output_byte(0x8D);
+  output_mem_indexed(rt,rs,map,2,0);
+}
+static void emit_jmpmem_indexed(intptr_t addr, int r)
+{
+  emit_leaptr(addr,HOST_TEMPREG);
+  assem_debug("jmp *(%%%s,%%%s,2)",regname[HOST_TEMPREG],regname[r]);
+  output_rex(0,0,r,HOST_TEMPREG);
+  output_byte(0xFF);
+  output_mem_indexed(4,HOST_TEMPREG,r,1,8);
+}
+static void emit_cmpmem_indexed(intptr_t addr, int rs, int rt)
+{
+  emit_leaptr(addr,HOST_TEMPREG);
+  assem_debug("cmp (%%%s,%%%s,2),%%%s",regname[HOST_TEMPREG],regname[rs],regname[rt]);
+  output_rex(0,rt,rs,HOST_TEMPREG);
+  output_byte(0x39);
+  output_mem_indexed(rt,HOST_TEMPREG,rs,1,0);
+}
+
+/* Stubs/epilogue */
+
+static void emit_extjump2(intptr_t addr, int target, intptr_t linker)
+{
+  u_char *ptr=(u_char *)addr;
+  if(*ptr==0x0f)
+  {
+    assert(ptr[1]>=0x80&&ptr[1]<=0x8f);
+    addr+=2;
+  }
+  else
+  {
+    assert(*ptr==0xe8||*ptr==0xe9);
+    addr++;
+  }
+  emit_movimm(target,EDI);
+  emit_movimm64(addr,ESI);
+  //assert(addr>=0x7000000&&addr<0x7FFFFFF);
+  //assert((target>=0x80000000&&target<0x80800000)||(target>0xA4000000&&target<0xA4001000));
+//DEBUG >
+#ifdef DEBUG_CYCLE_COUNT
+  emit_readword((intptr_t)&last_count,ECX);
+  emit_add(HOST_CCREG,ECX,HOST_CCREG);
+  emit_readword((intptr_t)&next_interupt,ECX);
+  emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+  emit_sub(HOST_CCREG,ECX,HOST_CCREG);
+  emit_writeword(ECX,(intptr_t)&last_count);
+#endif
+//DEBUG <
+  emit_jmp(linker);
+}
+
+static void emit_extjump(intptr_t addr, int target)
+{
+  emit_extjump2(addr, target, (intptr_t)dyna_linker);
+}
+static void emit_extjump_ds(intptr_t addr, int target)
+{
+  emit_extjump2(addr, target, (intptr_t)dyna_linker_ds);
+}
+
+static void do_readstub(int n)
+{
+  assem_debug("do_readstub %x",start+stubs[n][3]*4);
+  set_jump_target(stubs[n][1],(intptr_t)out);
+  int type=stubs[n][0];
+  int i=stubs[n][3];
+  int rs=stubs[n][4];
+  struct regstat *i_regs=(struct regstat *)stubs[n][5];
+  signed char *i_regmap=i_regs->regmap;
+  int addr=get_reg(i_regmap,AGEN1+(i&1));
+  int rth,rt;
+  int ds;
+  if(itype[i]==C1LS||itype[i]==LOADLR) {
+    rth=get_reg(i_regmap,FTEMP|64);
+    rt=get_reg(i_regmap,FTEMP);
+  }else{
+    rth=get_reg(i_regmap,rt1[i]|64);
+    rt=get_reg(i_regmap,rt1[i]);
+  }
+  assert(rs>=0);
+  if(addr<0) addr=rt;
+  if(addr<0&&itype[i]!=C1LS&&itype[i]!=LOADLR) addr=get_reg(i_regmap,-1);
+  assert(addr>=0);
+  intptr_t ftable=0;
+  if(type==LOADB_STUB||type==LOADBU_STUB)
+    ftable=(intptr_t)readmemb;
+  if(type==LOADH_STUB||type==LOADHU_STUB)
+    ftable=(intptr_t)readmemh;
+  if(type==LOADW_STUB)
+    ftable=(intptr_t)readmem;
+  if(type==LOADD_STUB)
+    ftable=(intptr_t)readmemd;
+  emit_writeword(rs,(intptr_t)&address);
+  emit_shrimm(rs,16,addr);
+  emit_movmem_indexedx8(ftable,addr,addr);
+  emit_pusha();
+  ds=i_regs!=&regs[i];
+  int real_rs=(itype[i]==LOADLR)?-1:get_reg(i_regmap,rs1[i]);
+  if(!ds) load_all_consts(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty&~(1<<addr)&(real_rs<0?-1:~(1<<real_rs)),i);
+  wb_dirtys(i_regs->regmap_entry,i_regs->was32,i_regs->wasdirty&~(1<<addr)&(real_rs<0?-1:~(1<<real_rs)));
+
+  int temp;
+  int cc=get_reg(i_regmap,CCREG);
+  if(cc<0) {
+    if(addr==HOST_CCREG)
+    {
+      cc=0;temp=1;
+      assert(cc!=HOST_CCREG);
+      assert(temp!=HOST_CCREG);
+      emit_loadreg(CCREG,cc);
+    }
+    else
+    {
+      cc=HOST_CCREG;
+      emit_loadreg(CCREG,cc);
+      temp=!addr;
+    }
+  }
+  else
+  {
+    temp=!addr;
+  }
+  emit_readword((intptr_t)&last_count,temp);
+  emit_addimm(cc,CLOCK_DIVIDER*(stubs[n][6]+1),cc);
+  emit_writeword_imm_esp(start+i*4+(((regs[i].was32>>rs1[i])&1)<<1)+ds,PUSHA_SIZE);
+  emit_add(cc,temp,cc);
+  emit_writeword(cc,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+  emit_callreg(addr);
+  // We really shouldn't need to update the count here,
+  // but not doing so causes random crashes...
+  emit_readword((intptr_t)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
+  emit_readword((intptr_t)&next_interupt,ECX);
+  emit_addimm(HOST_CCREG,-CLOCK_DIVIDER*(stubs[n][6]+1),HOST_CCREG);
+  emit_sub(HOST_CCREG,ECX,HOST_CCREG);
+  emit_writeword(ECX,(intptr_t)&last_count);
+  emit_storereg(CCREG,HOST_CCREG);
+  emit_popa();
+  if((cc=get_reg(i_regmap,CCREG))>=0) {
+    emit_loadreg(CCREG,cc);
+  }
+  if(rt>=0) {
+    if(type==LOADB_STUB)
+      emit_movsbl((intptr_t)&readmem_dword,rt);
+    if(type==LOADBU_STUB)
+      emit_movzbl((intptr_t)&readmem_dword,rt);
+    if(type==LOADH_STUB)
+      emit_movswl((intptr_t)&readmem_dword,rt);
+    if(type==LOADHU_STUB)
+      emit_movzwl((intptr_t)&readmem_dword,rt);
+    if(type==LOADW_STUB)
+      emit_readword((intptr_t)&readmem_dword,rt);
+    if(type==LOADD_STUB) {
+      emit_readword((intptr_t)&readmem_dword,rt);
+      if(rth>=0) emit_readword(((intptr_t)&readmem_dword)+4,rth);
+    }
+  }
+  emit_jmp(stubs[n][2]); // return address
+}
+
+static void inline_readstub(int type, int i, u_int addr, signed char regmap[], int target, int adj, u_int reglist)
+{
+  assem_debug("inline_readstub");
+  int rs=get_reg(regmap,target);
+  int rth=get_reg(regmap,target|64);
+  int rt=get_reg(regmap,target);
+  if(rs<0) rs=get_reg(regmap,-1);
+  assert(rs>=0);
+  intptr_t ftable=0;
+  if(type==LOADB_STUB||type==LOADBU_STUB)
+    ftable=(intptr_t)readmemb;
+  if(type==LOADH_STUB||type==LOADHU_STUB)
+    ftable=(intptr_t)readmemh;
+  if(type==LOADW_STUB)
+    ftable=(intptr_t)readmem;
+  if(type==LOADD_STUB)
+    ftable=(intptr_t)readmemd;
+  #ifdef HOST_IMM_ADDR32
+  emit_writeword_imm(addr,(intptr_t)&address);
+  #else
+  emit_writeword(rs,(intptr_t)&address);
+  #endif
+  emit_pusha();
+  if((signed int)addr>=(signed int)0xC0000000) {
+    // Theoretically we can have a pagefault here, if the TLB has never
+    // been enabled and the address is outside the range 80000000..BFFFFFFF
+    // Write out the registers so the pagefault can be handled.  This is
+    // a very rare case and likely represents a bug.
+    int ds=regmap!=regs[i].regmap;
+    if(!ds) load_all_consts(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty,i);
+    if(!ds) wb_dirtys(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty);
+    else wb_dirtys(branch_regs[i-1].regmap_entry,branch_regs[i-1].was32,branch_regs[i-1].wasdirty);
+  }
+  int cc=get_reg(regmap,CCREG);
+  int temp;
+  if(cc<0) {
+    if(rs==HOST_CCREG)
+    {
+      cc=0;temp=1;
+      assert(cc!=HOST_CCREG);
+      assert(temp!=HOST_CCREG);
+      emit_loadreg(CCREG,cc);
+    }
+    else
+    {
+      cc=HOST_CCREG;
+      emit_loadreg(CCREG,cc);
+      temp=!rs;
+    }
+  }
+  else
+  {
+    temp=!rs;
+  }
+  emit_readword((intptr_t)&last_count,temp);
+  emit_addimm(cc,CLOCK_DIVIDER*(adj+1),cc);
+  emit_add(cc,temp,cc);
+  emit_writeword(cc,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+  if((signed int)addr>=(signed int)0xC0000000) {
+    // Pagefault address
+    int ds=regmap!=regs[i].regmap;
+    emit_writeword_imm_esp(start+i*4+(((regs[i].was32>>rs1[i])&1)<<1)+ds,PUSHA_SIZE);
+  }
+  emit_call(((intptr_t *)ftable)[addr>>16]);
+  // We really shouldn't need to update the count here,
+  // but not doing so causes random crashes...
+  emit_readword((intptr_t)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
+  emit_readword((intptr_t)&next_interupt,ECX);
+  emit_addimm(HOST_CCREG,-CLOCK_DIVIDER*(adj+1),HOST_CCREG);
+  emit_sub(HOST_CCREG,ECX,HOST_CCREG);
+  emit_writeword(ECX,(intptr_t)&last_count);
+  emit_storereg(CCREG,HOST_CCREG);
+  emit_popa();
+  if((cc=get_reg(regmap,CCREG))>=0) {
+    emit_loadreg(CCREG,cc);
+  }
+  if(rt>=0) {
+    if(type==LOADB_STUB)
+      emit_movsbl((intptr_t)&readmem_dword,rt);
+    if(type==LOADBU_STUB)
+      emit_movzbl((intptr_t)&readmem_dword,rt);
+    if(type==LOADH_STUB)
+      emit_movswl((intptr_t)&readmem_dword,rt);
+    if(type==LOADHU_STUB)
+      emit_movzwl((intptr_t)&readmem_dword,rt);
+    if(type==LOADW_STUB)
+      emit_readword((intptr_t)&readmem_dword,rt);
+    if(type==LOADD_STUB) {
+      emit_readword((intptr_t)&readmem_dword,rt);
+      if(rth>=0) emit_readword(((intptr_t)&readmem_dword)+4,rth);
+    }
+  }
+}
+
+static void do_writestub(int n)
+{
+  assem_debug("do_writestub %x",start+stubs[n][3]*4);
+  set_jump_target(stubs[n][1],(intptr_t)out);
+  int type=stubs[n][0];
+  int i=stubs[n][3];
+  int rs=stubs[n][4];
+  struct regstat *i_regs=(struct regstat *)stubs[n][5];
+  signed char *i_regmap=i_regs->regmap;
+  int addr=get_reg(i_regmap,AGEN1+(i&1));
+  int rth,rt,r;
+  int ds;
+  if(itype[i]==C1LS) {
+    rth=get_reg(i_regmap,FTEMP|64);
+    rt=get_reg(i_regmap,r=FTEMP);
+  }else{
+    rth=get_reg(i_regmap,rs2[i]|64);
+    rt=get_reg(i_regmap,r=rs2[i]);
+  }
+  assert(rs>=0);
+  assert(rt>=0);
+  if(addr<0) addr=get_reg(i_regmap,-1);
+  assert(addr>=0);
+  intptr_t ftable=0;
+  if(type==STOREB_STUB)
+    ftable=(intptr_t)writememb;
+  if(type==STOREH_STUB)
+    ftable=(intptr_t)writememh;
+  if(type==STOREW_STUB)
+    ftable=(intptr_t)writemem;
+  if(type==STORED_STUB)
+    ftable=(intptr_t)writememd;
+  emit_writeword(rs,(intptr_t)&address);
+  emit_shrimm(rs,16,addr);
+  emit_movmem_indexedx8(ftable,addr,addr);
+  if(type==STOREB_STUB)
+    emit_writebyte(rt,(intptr_t)&cpu_byte);
+  if(type==STOREH_STUB)
+    emit_writehword(rt,(intptr_t)&hword);
+  if(type==STOREW_STUB)
+    emit_writeword(rt,(intptr_t)&word);
+  if(type==STORED_STUB) {
+    emit_writeword(rt,(intptr_t)&dword);
+    emit_writeword(r?rth:rt,(intptr_t)&dword+4);
+  }
+  emit_pusha();
+  ds=i_regs!=&regs[i];
+  int real_rs=get_reg(i_regmap,rs1[i]);
+  if(!ds) load_all_consts(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty&~(1<<addr)&(real_rs<0?-1:~(1<<real_rs)),i);
+  wb_dirtys(i_regs->regmap_entry,i_regs->was32,i_regs->wasdirty&~(1<<addr)&(real_rs<0?-1:~(1<<real_rs)));
+
+  int temp;
+  int cc=get_reg(i_regmap,CCREG);
+  if(cc<0) {
+    if(addr==HOST_CCREG)
+    {
+      cc=0;temp=1;
+      assert(cc!=HOST_CCREG);
+      assert(temp!=HOST_CCREG);
+      emit_loadreg(CCREG,cc);
+    }
+    else
+    {
+      cc=HOST_CCREG;
+      emit_loadreg(CCREG,cc);
+      temp=!addr;
+    }
+  }
+  else
+  {
+    temp=!addr;
+  }
+  emit_readword((intptr_t)&last_count,temp);
+  emit_addimm(cc,CLOCK_DIVIDER*(stubs[n][6]+1),cc);
+  emit_writeword_imm_esp(start+i*4+(((regs[i].was32>>rs1[i])&1)<<1)+ds,PUSHA_SIZE);
+  emit_add(cc,temp,cc);
+  emit_writeword(cc,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+  emit_callreg(addr);
+  emit_readword((intptr_t)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
+  emit_readword((intptr_t)&next_interupt,ECX);
+  emit_addimm(HOST_CCREG,-CLOCK_DIVIDER*(stubs[n][6]+1),HOST_CCREG);
+  emit_sub(HOST_CCREG,ECX,HOST_CCREG);
+  emit_writeword(ECX,(intptr_t)&last_count);
+  emit_storereg(CCREG,HOST_CCREG);
+  emit_popa();
+  if((cc=get_reg(i_regmap,CCREG))>=0) {
+    emit_loadreg(CCREG,cc);
+  }
+  emit_jmp(stubs[n][2]); // return address
+}
+
+static void inline_writestub(int type, int i, u_int addr, signed char regmap[], int target, int adj, u_int reglist)
+{
+  assem_debug("inline_writestub");
+  int rs=get_reg(regmap,-1);
+  int rth=get_reg(regmap,target|64);
+  int rt=get_reg(regmap,target);
+  assert(rs>=0);
+  assert(rt>=0);
+  intptr_t ftable=0;
+  if(type==STOREB_STUB)
+    ftable=(intptr_t)writememb;
+  if(type==STOREH_STUB)
+    ftable=(intptr_t)writememh;
+  if(type==STOREW_STUB)
+    ftable=(intptr_t)writemem;
+  if(type==STORED_STUB)
+    ftable=(intptr_t)writememd;
+  emit_writeword(rs,(intptr_t)&address);
+  if(type==STOREB_STUB)
+    emit_writebyte(rt,(intptr_t)&cpu_byte);
+  if(type==STOREH_STUB)
+    emit_writehword(rt,(intptr_t)&hword);
+  if(type==STOREW_STUB)
+    emit_writeword(rt,(intptr_t)&word);
+  if(type==STORED_STUB) {
+    emit_writeword(rt,(intptr_t)&dword);
+    emit_writeword(target?rth:rt,(intptr_t)&dword+4);
+  }
+  emit_pusha();
+  if((signed int)addr>=(signed int)0xC0000000) {
+    // Theoretically we can have a pagefault here, if the TLB has never
+    // been enabled and the address is outside the range 80000000..BFFFFFFF
+    // Write out the registers so the pagefault can be handled.  This is
+    // a very rare case and likely represents a bug.
+    int ds=regmap!=regs[i].regmap;
+    if(!ds) load_all_consts(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty,i);
+    if(!ds) wb_dirtys(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty);
+    else wb_dirtys(branch_regs[i-1].regmap_entry,branch_regs[i-1].was32,branch_regs[i-1].wasdirty);
+  }
+  int cc=get_reg(regmap,CCREG);
+  int temp;
+  if(cc<0) {
+    if(rs==HOST_CCREG)
+    {
+      cc=0;temp=1;
+      assert(cc!=HOST_CCREG);
+      assert(temp!=HOST_CCREG);
+      emit_loadreg(CCREG,cc);
+    }
+    else
+    {
+      cc=HOST_CCREG;
+      emit_loadreg(CCREG,cc);
+      temp=!rs;
+    }
+  }
+  else
+  {
+    temp=!rs;
+  }
+  emit_readword((intptr_t)&last_count,temp);
+  emit_addimm(cc,CLOCK_DIVIDER*(adj+1),cc);
+  emit_add(cc,temp,cc);
+  emit_writeword(cc,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+  if((signed int)addr>=(signed int)0xC0000000) {
+    // Pagefault address
+    int ds=regmap!=regs[i].regmap;
+    emit_writeword_imm_esp(start+i*4+(((regs[i].was32>>rs1[i])&1)<<1)+ds,PUSHA_SIZE);
+  }
+  emit_call(((intptr_t *)ftable)[addr>>16]);
+  emit_readword((intptr_t)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
+  emit_readword((intptr_t)&next_interupt,ECX);
+  emit_addimm(HOST_CCREG,-CLOCK_DIVIDER*(adj+1),HOST_CCREG);
+  emit_sub(HOST_CCREG,ECX,HOST_CCREG);
+  emit_writeword(ECX,(intptr_t)&last_count);
+  emit_storereg(CCREG,HOST_CCREG);
+  emit_popa();
+  if((cc=get_reg(regmap,CCREG))>=0) {
+    emit_loadreg(CCREG,cc);
+  }
+}
+
+static void do_unalignedwritestub(int n)
+{
+  set_jump_target(stubs[n][1],(intptr_t)out);
+  output_byte(0xCC);
+  emit_jmp(stubs[n][2]); // return address
+}
+
+static void do_invstub(int n)
+{
+  set_jump_target(stubs[n][1],(intptr_t)out);
+  emit_call(invalidate_block_reg[stubs[n][4]]);
+  emit_jmp(stubs[n][2]); // return address
+}
+
+// The dirty stub passes the arguments to verify_code in registers:
+// %rdi=source, %rsi=copy, %edx=length, %ecx=pc
+static intptr_t do_dirty_stub(int i)
+{
+  assem_debug("do_dirty_stub %x",start+i*4);
+  emit_movimm64((int)start<(int)0xC0000000?(uintptr_t)source:(uintptr_t)start,EDI);
+  emit_movimm64((uintptr_t)copy,ESI);
+  emit_movimm(slen*4,EDX);
+  emit_movimm(start+i*4,ECX);
+  emit_call((int)start<(int)0xC0000000?(intptr_t)&verify_code:(intptr_t)&verify_code_vm);
+  intptr_t entry=(intptr_t)out;
+  load_regs_entry(i);
+  if(entry==(intptr_t)out) entry=instr_addr[i];
+  emit_jmp(instr_addr[i]);
+  return entry;
+}
+
+static void do_dirty_stub_ds()
+{
+  emit_movimm64((int)start<(int)0xC0000000?(uintptr_t)source:(uintptr_t)start,EDI);
+  emit_movimm64((uintptr_t)copy,ESI);
+  emit_movimm(slen*4,EDX);
+  emit_movimm(start+1,ECX);
+  emit_call((intptr_t)&verify_code_ds);
+}
+
+static void do_cop1stub(int n)
+{
+  assem_debug("do_cop1stub %x",start+stubs[n][3]*4);
+  set_jump_target(stubs[n][1],(intptr_t)out);
+  int i=stubs[n][3];
+  struct regstat *i_regs=(struct regstat *)stubs[n][5];
+  int ds=stubs[n][6];
+  if(!ds) {
+    load_all_consts(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty,i);
+    //if(i_regs!=&regs[i]) DebugMessage(M64MSG_VERBOSE, "oops: regs[i]=%x i_regs=%x",(int)&regs[i],(int)i_regs);
+  }
+  //else {DebugMessage(M64MSG_VERBOSE, "fp exception in delay slot");}
+  wb_dirtys(i_regs->regmap_entry,i_regs->was32,i_regs->wasdirty);
+  if(regs[i].regmap_entry[HOST_CCREG]!=CCREG) emit_loadreg(CCREG,HOST_CCREG);
+  emit_movimm(start+(i-ds)*4,EAX); // Get PC
+  emit_addimm(HOST_CCREG,CLOCK_DIVIDER*ccadj[i],HOST_CCREG); // CHECK: is this right?  There should probably be an extra cycle...
+  emit_jmp(ds?(intptr_t)fp_exception_ds:(intptr_t)fp_exception);
+}
+
+/* TLB */
+
+// The memory_map entries are 64 bits wide, load them with
+// mov (memory_map,page,8),map
+static void emit_readmap(int cache, int page, int map)
+{
+  int base=cache;
+  if(base<0) {
+    emit_leaptr((intptr_t)memory_map,HOST_TEMPREG);
+    base=HOST_TEMPREG;
+  }
+  assem_debug("mov (%%%s,%%%s,8),%%%s",regname[base],regname[page],regname[map]);
+  output_rex(1,map,page,base);
+  output_byte(0x8B);
+  output_mem_indexed(map,base,page,3,0);
+}
+
+static int do_tlb_r(int s,int ar,int map,int cache,int x,int a,int shift,int c,u_int addr)
+{
+  if(c) {
+    if((signed int)addr>=(signed int)0xC0000000) {
+      emit_readptr((intptr_t)(memory_map+(addr>>12)),map);
+    }
+    else
+      return -1; // No mapping
+  }
+  else {
+    if(s!=map) emit_mov(s,map);
+    emit_shrimm(map,12,map);
+    // Schedule this while we wait on the load
+    //if(x) emit_xorimm(addr,x,addr);
+    if(shift>=0) emit_lea8(s,shift);
+    if(~a) emit_andimm(s,a,ar);
+    emit_readmap(cache,map,map);
+  }
+  return map;
+}
+static int do_tlb_r_branch(int map, int c, u_int addr, intptr_t *jaddr)
+{
+  if(!c||(signed int)addr>=(signed int)0xC0000000) {
+    assem_debug("test %%%s,%%%s",regname[map],regname[map]);
+    output_rex(1,map,0,map);
+    output_byte(0x85);
+    output_modrm(3,map,map);
+    *jaddr=(intptr_t)out;
+    emit_js(0);
+  }
+  return map;
+}
+
+static void gen_tlb_addr_r(int ar, int map) {
+  if(map>=0) {
+    emit_leaptr_rrx4(ar,map,ar);
+  }
+}
+
+static int do_tlb_w(int s,int ar,int map,int cache,int x,int c,u_int addr)
+{
+  if(c) {
+    if(addr<0x80800000||addr>=0xC0000000) {
+      emit_readptr((intptr_t)(memory_map+(addr>>12)),map);
+    }
+    else
+      return -1; // No mapping
+  }
+  else {
+    if(s!=map) emit_mov(s,map);
+    //if(s!=ar) emit_mov(s,ar);
+    emit_shrimm(map,12,map);
+    // Schedule this while we wait on the load
+    //if(x) emit_xorimm(s,x,addr);
+    emit_readmap(cache,map,map);
+  }
+  // Test the WRITE_PROTECT bit
+  assem_debug("bt $62,%%%s",regname[map]);
+  output_rex(1,0,0,map);
+  output_byte(0x0F);
+  output_byte(0xBA);
+  output_modrm(3,map,4);
+  output_byte(62);
+  return map;
+}
+static void do_tlb_w_branch(int map, int c, u_int addr, intptr_t *jaddr)
+{
+  if(!c||addr<0x80800000||addr>=0xC0000000) {
+    *jaddr=(intptr_t)out;
+    emit_jc(0);
+  }
+}
+
+static void gen_tlb_addr_w(int ar, int map) {
+  if(map>=0) {
+    emit_leaptr_rrx4(ar,map,ar);
+  }
+}
+
+// Undo gen_tlb_addr_w: ar=ar-map*4
+static void gen_orig_addr_w(int ar, int map) {
+  emit_neg64(ar);
+  emit_leaptr_rrx4(ar,map,ar);
+  emit_neg64(ar);
+}
+
+// We don't need this for x86
+static void generate_map_const(u_int addr,int reg) {
+  // void *mapaddr=memory_map+(addr>>12);
+}
+
+/* Special assem */
+
+static void shift_assemble_x86_64(int i,struct regstat *i_regs)
+{
+  if(rt1[i]) {
+    if(opcode2[i]<=0x07) // SLLV/SRLV/SRAV
+    {
+      char s,t,shift;
+      t=get_reg(i_regs->regmap,rt1[i]);
+      s=get_reg(i_regs->regmap,rs1[i]);
+      shift=get_reg(i_regs->regmap,rs2[i]);
+      if(t>=0){
+        if(rs1[i]==0)
+        {
+          emit_zeroreg(t);
+        }
+        else if(rs2[i]==0)
+        {
+          assert(s>=0);
+          if(s!=t) emit_mov(s,t);
+        }
+        else
+        {
+          char temp=get_reg(i_regs->regmap,-1);
+          assert(s>=0);
+          if(t==ECX&&s!=ECX) {
+            if(shift!=ECX) emit_mov(shift,ECX);
+            if(rt1[i]==rs2[i]) {shift=temp;}
+            if(s!=shift) emit_mov(s,shift);
+          }
+          else
+          {
+            if(rt1[i]==rs2[i]) {emit_mov(shift,temp);shift=temp;}
+            if(s!=t) emit_mov(s,t);
+            if(shift!=ECX) {
+              if(i_regs->regmap[ECX]<0)
+                emit_mov(shift,ECX);
+              else
+                emit_xchg(shift,ECX);
+            }
+          }
+          if(opcode2[i]==4) // SLLV
+          {
+            emit_shlcl(t==ECX?shift:t);
+          }
+          if(opcode2[i]==6) // SRLV
+          {
+            emit_shrcl(t==ECX?shift:t);
+          }
+          if(opcode2[i]==7) // SRAV
+          {
+            emit_sarcl(t==ECX?shift:t);
+          }
+          if(shift!=ECX&&i_regs->regmap[ECX]>=0) emit_xchg(shift,ECX);
+        }
+      }
+    } else { // DSLLV/DSRLV/DSRAV
+      char sh,sl,th,tl,shift;
+      th=get_reg(i_regs->regmap,rt1[i]|64);
+      tl=get_reg(i_regs->regmap,rt1[i]);
+      sh=get_reg(i_regs->regmap,rs1[i]|64);
+      sl=get_reg(i_regs->regmap,rs1[i]);
+      shift=get_reg(i_regs->regmap,rs2[i]);
+      if(tl>=0){
+        if(rs1[i]==0)
+        {
+          emit_zeroreg(tl);
+          if(th>=0) emit_zeroreg(th);
+        }
+        else if(rs2[i]==0)
+        {
+          assert(sl>=0);
+          if(sl!=tl) emit_mov(sl,tl);
+          if(th>=0&&sh!=th) emit_mov(sh,th);
+        }
+        else
+        {
+          // FIXME: What if shift==tl ?
+          assert(shift!=tl);
+          int temp=get_reg(i_regs->regmap,-1);
+          int real_th=th;
+          if(th<0&&opcode2[i]!=0x14) {th=temp;} // DSLLV doesn't need a temporary register
+          assert(sl>=0);
+          assert(sh>=0);
+          if(tl==ECX&&sl!=ECX) {
+            if(shift!=ECX) emit_mov(shift,ECX);
+            if(sl!=shift) emit_mov(sl,shift);
+            if(th>=0 && sh!=th) emit_mov(sh,th);
+          }
+          else if(th==ECX&&sh!=ECX) {
+            if(shift!=ECX) emit_mov(shift,ECX);
+            if(sh!=shift) emit_mov(sh,shift);
+            if(sl!=tl) emit_mov(sl,tl);
+          }
+          else
+          {
+            if(sl!=tl) emit_mov(sl,tl);
+            if(th>=0 && sh!=th) emit_mov(sh,th);
+            if(shift!=ECX) {
+              if(i_regs->regmap[ECX]<0)
+                emit_mov(shift,ECX);
+              else
+                emit_xchg(shift,ECX);
+            }
+          }
+          if(opcode2[i]==0x14) // DSLLV
+          {
+            if(th>=0) emit_shldcl(th==ECX?shift:th,tl==ECX?shift:tl);
+            emit_shlcl(tl==ECX?shift:tl);
+            emit_testimm(ECX,32);
+            if(th>=0) emit_cmovne_reg(tl==ECX?shift:tl,th==ECX?shift:th);
+            emit_cmovne(&const_zero,tl==ECX?shift:tl);
+          }
+          if(opcode2[i]==0x16) // DSRLV
+          {
+            assert(th>=0);
+            emit_shrdcl(tl==ECX?shift:tl,th==ECX?shift:th);
+            emit_shrcl(th==ECX?shift:th);
+            emit_testimm(ECX,32);
+            emit_cmovne_reg(th==ECX?shift:th,tl==ECX?shift:tl);
+            if(real_th>=0) emit_cmovne(&const_zero,th==ECX?shift:th);
+          }
+          if(opcode2[i]==0x17) // DSRAV
+          {
+            assert(th>=0);
+            emit_shrdcl(tl==ECX?shift:tl,th==ECX?shift:th);
+            if(real_th>=0) {
+              assert(temp>=0);
+              emit_mov(th==ECX?shift:th,temp==ECX?shift:temp);
+            }
+            emit_sarcl(th==ECX?shift:th);
+            if(real_th>=0) emit_sarimm(temp==ECX?shift:temp,31,temp==ECX?shift:temp);
+            emit_testimm(ECX,32);
+            emit_cmovne_reg(th==ECX?shift:th,tl==ECX?shift:tl);
+            if(real_th>=0) emit_cmovne_reg(temp==ECX?shift:temp,th==ECX?shift:th);
+          }
+          if(shift!=ECX&&(i_regs->regmap[ECX]>=0||temp==ECX)) emit_xchg(shift,ECX);
+        }
+      }
+    }
+  }
+}
+#define shift_assemble shift_assemble_x86_64
+
+// Caller-saved registers which ldl_merge/ldr_merge may clobber
+#define CALLER_SAVED_REGS 0xfc7
+
+static void loadlr_assemble_x86_64(int i,struct regstat *i_regs)
+{
+  int s,th,tl,temp,temp2,addr,map=-1;
+  int offset;
+  intptr_t jaddr=0;
+  int memtarget=0,c=0;
+  u_int hr,reglist=0;
+  th=get_reg(i_regs->regmap,rt1[i]|64);
+  tl=get_reg(i_regs->regmap,rt1[i]);
+  s=get_reg(i_regs->regmap,rs1[i]);
+  temp=get_reg(i_regs->regmap,-1);
+  temp2=get_reg(i_regs->regmap,FTEMP);
+  addr=get_reg(i_regs->regmap,AGEN1+(i&1));
+  assert(addr<0);
+  offset=imm[i];
+  for(hr=0;hr<HOST_REGS;hr++) {
+    if(i_regs->regmap[hr]>=0) reglist|=1<<hr;
+  }
+  reglist|=1<<temp;
+  if(offset||s<0||c) addr=temp2;
+  else addr=s;
+  if(s>=0) {
+    c=(i_regs->wasconst>>s)&1;
+    memtarget=((signed int)(constmap[i][s]+offset))<(signed int)0x80800000;
+    if(using_tlb&&((signed int)(constmap[i][s]+offset))>=(signed int)0xC0000000) memtarget=1;
+  }
+  if(!using_tlb) {
+    if(!c) {
+      emit_lea8(addr,temp);
+      if (opcode[i]==0x22||opcode[i]==0x26) {
+        emit_andimm(addr,0xFFFFFFFC,temp2); // LWL/LWR
+      }else{
+        emit_andimm(addr,0xFFFFFFF8,temp2); // LDL/LDR
+      }
+      emit_cmpimm(addr,0x800000);
+      jaddr=(intptr_t)out;
+      emit_jno(0);
+    }
+    else {
+      if (opcode[i]==0x22||opcode[i]==0x26) {
+        emit_movimm(((constmap[i][s]+offset)<<3)&24,temp); // LWL/LWR
+      }else{
+        emit_movimm(((constmap[i][s]+offset)<<3)&56,temp); // LDL/LDR
+      }
+    }
+  }else{ // using tlb
+    int a;
+    if(c) {
+      a=-1;
+    }else if (opcode[i]==0x22||opcode[i]==0x26) {
+      a=0xFFFFFFFC; // LWL/LWR
+    }else{
+      a=0xFFFFFFF8; // LDL/LDR
+    }
+    map=get_reg(i_regs->regmap,TLREG);
+    assert(map>=0);
+    reglist&=~(1<<map);
+    map=do_tlb_r(addr,temp2,map,-1,0,a,c?-1:temp,c,constmap[i][s]+offset);
+    if(c) {
+      if (opcode[i]==0x22||opcode[i]==0x26) {
+        emit_movimm(((constmap[i][s]+offset)<<3)&24,temp); // LWL/LWR
+      }else{
+        emit_movimm(((constmap[i][s]+offset)<<3)&56,temp); // LDL/LDR
+      }
+    }
+    do_tlb_r_branch(map,c,constmap[i][s]+offset,&jaddr);
+  }
+  if (opcode[i]==0x22||opcode[i]==0x26) { // LWL/LWR
+    if(!c||memtarget) {
+      emit_readword_indexed_tlb(0,temp2,map,temp2);
+      if(jaddr) add_stub(LOADW_STUB,jaddr,(intptr_t)out,i,temp2,(intptr_t)i_regs,ccadj[i],reglist);
+    }
+    else
+      inline_readstub(LOADW_STUB,i,(constmap[i][s]+offset)&0xFFFFFFFC,i_regs->regmap,FTEMP,ccadj[i],reglist);
+    if(rt1[i]) {
+      assert(tl>=0);
+      emit_andimm(temp,24,temp);
+      if (opcode[i]==0x26) emit_xorimm(temp,24,temp); // LWR
+      if(temp==ECX)
+      {
+        int temp3=EDX;
+        if(temp3==temp2) temp3++;
+        emit_pushreg(temp3);
+        emit_movimm(-1,temp3);
+        if (opcode[i]==0x26) {
+          emit_shrcl(temp3);
+          emit_shrcl(temp2);
+        }else{
+          emit_shlcl(temp3);
+          emit_shlcl(temp2);
+        }
+        emit_mov(temp3,ECX);
+        emit_not(ECX,ECX);
+        emit_popreg(temp3);
+      }
+      else
+      {
+        int temp3=EBP;
+        if(temp3==temp) temp3++;
+        if(temp3==temp2) temp3++;
+        if(temp3==temp) temp3++;
+        emit_xchg(ECX,temp);
+        emit_pushreg(temp3);
+        emit_movimm(-1,temp3);
+        if (opcode[i]==0x26) {
+          emit_shrcl(temp3);
+          emit_shrcl(temp2==ECX?temp:temp2);
+        }else{
+          emit_shlcl(temp3);
+          emit_shlcl(temp2==ECX?temp:temp2);
+        }
+        emit_not(temp3,temp3);
+        emit_mov(temp,ECX);
+        emit_mov(temp3,temp);
+        emit_popreg(temp3);
+      }
+      emit_and(temp,tl,tl);
+      emit_or(temp2,tl,tl);
+    }
+  }
+  if (opcode[i]==0x1A||opcode[i]==0x1B) { // LDL/LDR
+    if(s>=0)
+      if((i_regs->wasdirty>>s)&1)
+        emit_storereg(rs1[i],s);
+    if(get_reg(i_regs->regmap,rs1[i]|64)>=0)
+      if((i_regs->wasdirty>>get_reg(i_regs->regmap,rs1[i]|64))&1)
+        emit_storereg(rs1[i]|64,get_reg(i_regs->regmap,rs1[i]|64));
+    int temp2h=get_reg(i_regs->regmap,FTEMP|64);
+    if(!c||memtarget) {
+      emit_readdword_indexed_tlb(0,temp2,map,temp2h,temp2);
+      if(jaddr) add_stub(LOADD_STUB,jaddr,(intptr_t)out,i,temp2,(intptr_t)i_regs,ccadj[i],reglist);
+    }
+    else
+      inline_readstub(LOADD_STUB,i,(constmap[i][s]+offset)&0xFFFFFFF8,i_regs->regmap,FTEMP,ccadj[i],reglist);
+    if(rt1[i]) {
+      assert(th>=0);
+      assert(tl>=0);
+      emit_andimm(temp,56,temp);
+      // Save the live caller-saved registers, keeping the stack aligned
+      u_int save=reglist&CALLER_SAVED_REGS&~(1<<tl)&~(1<<th);
+      int pushed=0;
+      for(hr=0;hr<HOST_REGS;hr++) {
+        if((save>>hr)&1) {emit_pushreg(hr);pushed++;}
+      }
+      emit_addimm(ESP,(pushed&1)?-40:-32,ESP);
+      emit_writeword_indexed(tl,0,ESP);
+      emit_writeword_indexed(th,4,ESP);
+      emit_writeword_indexed(temp2,8,ESP);
+      emit_writeword_indexed(temp2h,12,ESP);
+      emit_writeword_indexed(temp,16,ESP);
+      // original=%rdi, loaded=%rsi, bits=%edx
+      output_rex(1,EDI,0,ESP);output_byte(0x8B);output_mem(EDI,ESP,0);
+      output_rex(1,ESI,0,ESP);output_byte(0x8B);output_mem(ESI,ESP,8);
+      emit_readword_indexed(16,ESP,EDX);
+      if(opcode[i]==0x1A) emit_call((intptr_t)ldl_merge);
+      if(opcode[i]==0x1B) emit_call((intptr_t)ldr_merge);
+      emit_mov(EAX,HOST_TEMPREG);
+      emit_addimm(ESP,(pushed&1)?40:32,ESP);
+      for(hr=HOST_REGS;hr>0;hr--) {
+        if((save>>(hr-1))&1) emit_popreg(hr-1);
+      }
+      emit_mov(HOST_TEMPREG,th);
+      emit_mov(HOST_TEMPREG,tl);
+      assem_debug("shr $32,%%%s",regname[th]);
+      output_rex(1,0,0,th);
+      output_byte(0xC1);
+      output_modrm(3,th,5);
+      output_byte(32);
+      assem_debug("mov %%%s,%%%s",regname[tl],regname[tl]);
+      output_rex(0,tl,0,tl);
+      output_byte(0x89);
+      output_modrm(3,tl,tl);
+      if(s>=0) emit_loadreg(rs1[i],s);
+      if(get_reg(i_regs->regmap,rs1[i]|64)>=0)
+        emit_loadreg(rs1[i]|64,get_reg(i_regs->regmap,rs1[i]|64));
+    }
+  }
+}
+#define loadlr_assemble loadlr_assemble_x86_64
+
+static void cop0_assemble(int i,struct regstat *i_regs)
+{
+  if(opcode2[i]==0) // MFC0
+  {
+    if(rt1[i]) {
+      signed char t=get_reg(i_regs->regmap,rt1[i]);
+      char copr=(source[i]>>11)&0x1f;
+      if(t>=0) {
+        emit_leaptr((intptr_t)&fake_pc,HOST_TEMPREG);
+        emit_writeptr(HOST_TEMPREG,(intptr_t)&PC);
+        emit_writebyte_imm((source[i]>>11)&0x1f,(intptr_t)&(fake_pc.f.r.nrd));
+        if(copr==9) {
+          emit_readword((intptr_t)&last_count,ECX);
+          emit_loadreg(CCREG,HOST_CCREG); // TODO: do proper reg alloc
+          emit_add(HOST_CCREG,ECX,HOST_CCREG);
+          emit_addimm(HOST_CCREG,CLOCK_DIVIDER*ccadj[i],HOST_CCREG);
+          emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+        }
+        emit_call((intptr_t)cached_interpreter_table.MFC0);
+        emit_readword((intptr_t)&readmem_dword,t);
+      }
+    }
+  }
+  else if(opcode2[i]==4) // MTC0
+  {
+    signed char s=get_reg(i_regs->regmap,rs1[i]);
+    char copr=(source[i]>>11)&0x1f;
+    assert(s>=0);
+    emit_writeword(s,(intptr_t)&readmem_dword);
+    emit_pusha();
+    emit_leaptr((intptr_t)&fake_pc,HOST_TEMPREG);
+    emit_writeptr(HOST_TEMPREG,(intptr_t)&PC);
+    emit_writebyte_imm((source[i]>>11)&0x1f,(intptr_t)&(fake_pc.f.r.nrd));
+    if(copr==9||copr==11||copr==12) {
+      if(copr==12&&!is_delayslot) {
+        wb_register(rs1[i],i_regs->regmap,i_regs->dirty,i_regs->is32);
+      }
+      emit_readword((intptr_t)&last_count,ECX);
+      emit_loadreg(CCREG,HOST_CCREG); // TODO: do proper reg alloc
+      emit_add(HOST_CCREG,ECX,HOST_CCREG);
+      emit_addimm(HOST_CCREG,CLOCK_DIVIDER*ccadj[i],HOST_CCREG);
+      emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+    }
+    // What a mess.  The status register (12) can enable interrupts,
+    // so needs a special case to handle a pending interrupt.
+    // The interrupt must be taken immediately, because a subsequent
+    // instruction might disable interrupts again.
+    if(copr==12&&!is_delayslot) {
+      emit_writeword_imm(start+i*4+4,(intptr_t)&pcaddr);
+      emit_writebyte_imm(0,(intptr_t)&pending_exception);
+    }
+    //else if(copr==12&&is_delayslot) emit_call((int)MTC0_R12);
+    //else
+    emit_call((intptr_t)cached_interpreter_table.MTC0);
+    if(copr==9||copr==11||copr==12) {
+      emit_readword((intptr_t)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
+      emit_readword((intptr_t)&next_interupt,ECX);
+      emit_addimm(HOST_CCREG,-CLOCK_DIVIDER*ccadj[i],HOST_CCREG);
+      emit_sub(HOST_CCREG,ECX,HOST_CCREG);
+      emit_writeword(ECX,(intptr_t)&last_count);
+      emit_storereg(CCREG,HOST_CCREG);
+    }
+    emit_popa();
+    if(copr==12) {
+      assert(!is_delayslot);
+      //if(is_delayslot) output_byte(0xcc);
+      emit_cmpmem_imm_byte((intptr_t)&pending_exception,0);
+      emit_jne((intptr_t)&do_interrupt);
+    }
+    cop1_usable=0;
+  }
+  else
+  {
+    assert(opcode2[i]==0x10);
+    if((source[i]&0x3f)==0x01) // TLBR
+      emit_call((intptr_t)cached_interpreter_table.TLBR);
+    if((source[i]&0x3f)==0x02) // TLBWI
+      emit_call((intptr_t)TLBWI_new);
+    if((source[i]&0x3f)==0x06) { // TLBWR
+      // The TLB entry written by TLBWR is dependent on the count,
+      // so update the cycle count
+      emit_readword((intptr_t)&last_count,ECX);
+      if(i_regs->regmap[HOST_CCREG]!=CCREG) emit_loadreg(CCREG,HOST_CCREG);
+      emit_add(HOST_CCREG,ECX,HOST_CCREG);
+      emit_addimm(HOST_CCREG,CLOCK_DIVIDER*ccadj[i],HOST_CCREG);
+      emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+      emit_call((intptr_t)TLBWR_new);
+    }
+    if((source[i]&0x3f)==0x08) // TLBP
+      emit_call((intptr_t)cached_interpreter_table.TLBP);
+    if((source[i]&0x3f)==0x18) // ERET
+    {
+      int count=ccadj[i];
+      if(i_regs->regmap[HOST_CCREG]!=CCREG) emit_loadreg(CCREG,HOST_CCREG);
+      emit_addimm_and_set_flags(CLOCK_DIVIDER*count,HOST_CCREG); // TODO: Should there be an extra cycle here?
+      emit_jmp((intptr_t)jump_eret);
+    }
+  }
+}
+
+static void cop1_assemble(int i,struct regstat *i_regs)
+{
+  // Check cop1 unusable
+  if(!cop1_usable) {
+    signed char rs=get_reg(i_regs->regmap,CSREG);
+    assert(rs>=0);
+    emit_testimm(rs,0x20000000);
+    intptr_t jaddr=(intptr_t)out;
+    emit_jeq(0);
+    add_stub(FP_STUB,jaddr,(intptr_t)out,i,rs,(intptr_t)i_regs,is_delayslot,0);
+    cop1_usable=1;
+  }
+  if (opcode2[i]==0) { // MFC1
+    signed char tl=get_reg(i_regs->regmap,rt1[i]);
+    if(tl>=0) {
+      emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],tl);
+      emit_readword_indexed(0,tl,tl);
+    }
+  }
+  else if (opcode2[i]==1) { // DMFC1
+    signed char tl=get_reg(i_regs->regmap,rt1[i]);
+    signed char th=get_reg(i_regs->regmap,rt1[i]|64);
+    if(tl>=0) {
+      emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],tl);
+      if(th>=0) emit_readword_indexed(4,tl,th);
+      emit_readword_indexed(0,tl,tl);
+    }
+  }
+  else if (opcode2[i]==4) { // MTC1
+    signed char sl=get_reg(i_regs->regmap,rs1[i]);
+    signed char temp=get_reg(i_regs->regmap,-1);
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_writeword_indexed(sl,0,temp);
+  }
+  else if (opcode2[i]==5) { // DMTC1
+    signed char sl=get_reg(i_regs->regmap,rs1[i]);
+    signed char sh=rs1[i]>0?get_reg(i_regs->regmap,rs1[i]|64):sl;
+    signed char temp=get_reg(i_regs->regmap,-1);
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_writeword_indexed(sh,4,temp);
+    emit_writeword_indexed(sl,0,temp);
+  }
+  else if (opcode2[i]==2) // CFC1
+  {
+    signed char tl=get_reg(i_regs->regmap,rt1[i]);
+    if(tl>=0) {
+      u_int copr=(source[i]>>11)&0x1f;
+      if(copr==0) emit_readword((intptr_t)&FCR0,tl);
+      if(copr==31) {
+        // The compare flags may still be held in a register
+        signed char fs=get_reg(i_regs->regmap,FSREG);
+        if(fs>=0) emit_mov(fs,tl);
+        else emit_readword((intptr_t)&FCR31,tl);
+      }
+    }
+  }
+  else if (opcode2[i]==6) // CTC1
+  {
+    signed char sl=get_reg(i_regs->regmap,rs1[i]);
+    u_int copr=(source[i]>>11)&0x1f;
+    assert(sl>=0);
+    if(copr==31)
+    {
+      emit_writeword(sl,(intptr_t)&FCR31);
+      signed char fs=get_reg(i_regs->regmap,FSREG);
+      if(fs>=0) emit_mov(sl,fs);
+      // Set the rounding mode
+      char temp=get_reg(i_regs->regmap,-1);
+      emit_movimm(3,temp);
+      emit_and(sl,temp,temp);
+      emit_fldcw_indexed((intptr_t)&rounding_modes,temp);
+    }
+  }
+}
+
+static void fconv_assemble_x86_64(int i,struct regstat *i_regs)
+{
+  signed char temp=get_reg(i_regs->regmap,-1);
+  assert(temp>=0);
+  // Check cop1 unusable
+  if(!cop1_usable) {
+    signed char rs=get_reg(i_regs->regmap,CSREG);
+    assert(rs>=0);
+    emit_testimm(rs,0x20000000);
+    intptr_t jaddr=(intptr_t)out;
+    emit_jeq(0);
+    add_stub(FP_STUB,jaddr,(intptr_t)out,i,rs,(intptr_t)i_regs,is_delayslot,0);
+    cop1_usable=1;
+  }
+#ifdef __SSE__
+  if(opcode2[i]==0x10&&(source[i]&0x3f)==0x0d) { // trunc_w_s
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_movss_load(temp,0);
+    emit_cvttps2dq(0,0); // float->int, truncate
+    if(((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f))
+      emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+    emit_movd_store(0,temp);
+    return;
+  }
+  if(opcode2[i]==0x11&&(source[i]&0x3f)==0x0d) { // trunc_w_d
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_movsd_load(temp,0);
+    emit_cvttpd2dq(0,0); // double->int, truncate
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+    emit_movd_store(0,temp);
+    return;
+  }
+#endif
+
+  if(opcode2[i]==0x14&&(source[i]&0x3f)==0x20) { // cvt_s_w
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_fildl(temp);
+    if(((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f))
+      emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+    emit_fstps(temp);
+    return;
+  }
+  if(opcode2[i]==0x14&&(source[i]&0x3f)==0x21) { // cvt_d_w
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_fildl(temp);
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+    emit_fstpl(temp);
+    return;
+  }
+  if(opcode2[i]==0x15&&(source[i]&0x3f)==0x20) { // cvt_s_l
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_fildll(temp);
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+    emit_fstps(temp);
+    return;
+  }
+  if(opcode2[i]==0x15&&(source[i]&0x3f)==0x21) { // cvt_d_l
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_fildll(temp);
+    if(((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f))
+      emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+    emit_fstpl(temp);
+    return;
+  }
+
+  if(opcode2[i]==0x10&&(source[i]&0x3f)==0x21) { // cvt_d_s
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_flds(temp);
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+    emit_fstpl(temp);
+    return;
+  }
+  if(opcode2[i]==0x11&&(source[i]&0x3f)==0x20) { // cvt_s_d
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_fldl(temp);
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+    emit_fstps(temp);
+    return;
+  }
+
+  if(opcode2[i]==0x10) { // cvt_*_s
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_flds(temp);
+  }
+  if(opcode2[i]==0x11) { // cvt_*_d
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_fldl(temp);
+  }
+  if((source[i]&0x3f)<0x10) {
+    emit_fnstcw_stack();
+    if((source[i]&3)==0) emit_fldcw((intptr_t)&round_mode); //DebugMessage(M64MSG_VERBOSE, "round");
+    if((source[i]&3)==1) emit_fldcw((intptr_t)&trunc_mode); //DebugMessage(M64MSG_VERBOSE, "trunc");
+    if((source[i]&3)==2) emit_fldcw((intptr_t)&ceil_mode); //DebugMessage(M64MSG_VERBOSE, "ceil");
+    if((source[i]&3)==3) emit_fldcw((intptr_t)&floor_mode); //DebugMessage(M64MSG_VERBOSE, "floor");
+  }
+  if((source[i]&0x3f)==0x24||(source[i]&0x3c)==0x0c) { // cvt_w_*
+    if(opcode2[i]!=0x10||((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f))
+      emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+    emit_fistpl(temp);
+  }
+  if((source[i]&0x3f)==0x25||(source[i]&0x3c)==0x08) { // cvt_l_*
+    if(opcode2[i]!=0x11||((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f))
+      emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+    emit_fistpll(temp);
+  }
+  if((source[i]&0x3f)<0x10) {
+    emit_fldcw_stack();
+  }
+}
+#define fconv_assemble fconv_assemble_x86_64
+
+static void fcomp_assemble(int i,struct regstat *i_regs)
+{
+  signed char fs=get_reg(i_regs->regmap,FSREG);
+  signed char temp=get_reg(i_regs->regmap,-1);
+  assert(temp>=0);
+  // Check cop1 unusable
+  if(!cop1_usable) {
+    signed char cs=get_reg(i_regs->regmap,CSREG);
+    assert(cs>=0);
+    emit_testimm(cs,0x20000000);
+    intptr_t jaddr=(intptr_t)out;
+    emit_jeq(0);
+    add_stub(FP_STUB,jaddr,(intptr_t)out,i,cs,(intptr_t)i_regs,is_delayslot,0);
+    cop1_usable=1;
+  }
+
+  if((source[i]&0x3f)==0x30) {
+    emit_andimm(fs,~0x800000,fs);
+    return;
+  }
+
+  if((source[i]&0x3e)==0x38) {
+    // sf/ngle - these should throw exceptions for NaNs
+    emit_andimm(fs,~0x800000,fs);
+    return;
+  }
+
+  if(opcode2[i]==0x10) {
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>16)&0x1f],temp);
+    emit_flds(temp);
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_flds(temp);
+    emit_movimm(0x800000,temp);
+    emit_or(fs,temp,fs);
+    emit_xor(temp,fs,temp);
+    emit_fucomip(1);
+    emit_fpop();
+    if((source[i]&0x3f)==0x31) emit_cmovnp_reg(temp,fs); // c_un_s
+    if((source[i]&0x3f)==0x32) {emit_cmovne_reg(temp,fs);emit_cmovp_reg(temp,fs);} // c_eq_s
+    if((source[i]&0x3f)==0x33) emit_cmovne_reg(temp,fs); // c_ueq_s
+    if((source[i]&0x3f)==0x34) {emit_cmovnc_reg(temp,fs);emit_cmovp_reg(temp,fs);} // c_olt_s
+    if((source[i]&0x3f)==0x35) emit_cmovnc_reg(temp,fs); // c_ult_s
+    if((source[i]&0x3f)==0x36) {emit_cmova_reg(temp,fs);emit_cmovp_reg(temp,fs);} // c_ole_s
+    if((source[i]&0x3f)==0x37) emit_cmova_reg(temp,fs); // c_ule_s
+    if((source[i]&0x3f)==0x3a) emit_cmovne_reg(temp,fs); // c_seq_s
+    if((source[i]&0x3f)==0x3b) emit_cmovne_reg(temp,fs); // c_ngl_s
+    if((source[i]&0x3f)==0x3c) emit_cmovnc_reg(temp,fs); // c_lt_s
+    if((source[i]&0x3f)==0x3d) emit_cmovnc_reg(temp,fs); // c_nge_s
+    if((source[i]&0x3f)==0x3e) emit_cmova_reg(temp,fs); // c_le_s
+    if((source[i]&0x3f)==0x3f) emit_cmova_reg(temp,fs); // c_ngt_s
+    return;
+  }
+  if(opcode2[i]==0x11) {
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>16)&0x1f],temp);
+    emit_fldl(temp);
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_fldl(temp);
+    emit_movimm(0x800000,temp);
+    emit_or(fs,temp,fs);
+    emit_xor(temp,fs,temp);
+    emit_fucomip(1);
+    emit_fpop();
+    if((source[i]&0x3f)==0x31) emit_cmovnp_reg(temp,fs); // c_un_d
+    if((source[i]&0x3f)==0x32) {emit_cmovne_reg(temp,fs);emit_cmovp_reg(temp,fs);} // c_eq_d
+    if((source[i]&0x3f)==0x33) emit_cmovne_reg(temp,fs); // c_ueq_d
+    if((source[i]&0x3f)==0x34) {emit_cmovnc_reg(temp,fs);emit_cmovp_reg(temp,fs);} // c_olt_d
+    if((source[i]&0x3f)==0x35) emit_cmovnc_reg(temp,fs); // c_ult_d
+    if((source[i]&0x3f)==0x36) {emit_cmova_reg(temp,fs);emit_cmovp_reg(temp,fs);} // c_ole_d
+    if((source[i]&0x3f)==0x37) emit_cmova_reg(temp,fs); // c_ule_d
+    if((source[i]&0x3f)==0x3a) emit_cmovne_reg(temp,fs); // c_seq_d
+    if((source[i]&0x3f)==0x3b) emit_cmovne_reg(temp,fs); // c_ngl_d
+    if((source[i]&0x3f)==0x3c) emit_cmovnc_reg(temp,fs); // c_lt_d
+    if((source[i]&0x3f)==0x3d) emit_cmovnc_reg(temp,fs); // c_nge_d
+    if((source[i]&0x3f)==0x3e) emit_cmova_reg(temp,fs); // c_le_d
+    if((source[i]&0x3f)==0x3f) emit_cmova_reg(temp,fs); // c_ngt_d
+    return;
+  }
+}
+
+static void float_assemble(int i,struct regstat *i_regs)
+{
+  signed char temp=get_reg(i_regs->regmap,-1);
+  assert(temp>=0);
+  // Check cop1 unusable
+  if(!cop1_usable) {
+    signed char cs=get_reg(i_regs->regmap,CSREG);
+    assert(cs>=0);
+    emit_testimm(cs,0x20000000);
+    intptr_t jaddr=(intptr_t)out;
+    emit_jeq(0);
+    add_stub(FP_STUB,jaddr,(intptr_t)out,i,cs,(intptr_t)i_regs,is_delayslot,0);
+    cop1_usable=1;
+  }
+
+  if((source[i]&0x3f)==6) // mov
+  {
+    if(((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f)) {
+      if(opcode2[i]==0x10) {
+        emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+        emit_flds(temp);
+        emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+        emit_fstps(temp);
+      }
+      if(opcode2[i]==0x11) {
+        emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+        emit_fldl(temp);
+        emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+        emit_fstpl(temp);
+      }
+    }
+    return;
+  }
+
+  if((source[i]&0x3f)>3)
+  {
+    if(opcode2[i]==0x10) {
+      emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+      emit_flds(temp);
+      if(((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f)) {
+        emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+      }
+    }
+    if(opcode2[i]==0x11) {
+      emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+      emit_fldl(temp);
+      if(((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f)) {
+        emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+      }
+    }
+    if((source[i]&0x3f)==4) // sqrt
+      emit_fsqrt();
+    if((source[i]&0x3f)==5) // abs
+      emit_fabs();
+    if((source[i]&0x3f)==7) // neg
+      emit_fchs();
+    if(opcode2[i]==0x10) {
+      emit_fstps(temp);
+    }
+    if(opcode2[i]==0x11) {
+      emit_fstpl(temp);
+    }
+    return;
+  }
+  if((source[i]&0x3f)<4)
+  {
+    if(opcode2[i]==0x10) {
+      emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+      emit_flds(temp);
+    }
+    if(opcode2[i]==0x11) {
+      emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+      emit_fldl(temp);
+    }
+    if(((source[i]>>11)&0x1f)!=((source[i]>>16)&0x1f)) {
+      if(opcode2[i]==0x10) {
+        emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>16)&0x1f],temp);
+        if((source[i]&0x3f)==0) emit_fadds(temp);
+        if((source[i]&0x3f)==1) emit_fsubs(temp);
+        if((source[i]&0x3f)==2) emit_fmuls(temp);
+        if((source[i]&0x3f)==3) emit_fdivs(temp);
+      }
+      else if(opcode2[i]==0x11) {
+        emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>16)&0x1f],temp);
+        if((source[i]&0x3f)==0) emit_faddl(temp);
+        if((source[i]&0x3f)==1) emit_fsubl(temp);
+        if((source[i]&0x3f)==2) emit_fmull(temp);
+        if((source[i]&0x3f)==3) emit_fdivl(temp);
+      }
+    }
+    else {
+      if((source[i]&0x3f)==0) emit_fadd(0);
+      if((source[i]&0x3f)==1) emit_fsub(0);
+      if((source[i]&0x3f)==2) emit_fmul(0);
+      if((source[i]&0x3f)==3) emit_fdiv(0);
+    }
+    if(opcode2[i]==0x10) {
+      if(((source[i]>>16)&0x1f)!=((source[i]>>6)&0x1f)) {
+        emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+      }
+      emit_fstps(temp);
+    }
+    if(opcode2[i]==0x11) {
+      if(((source[i]>>16)&0x1f)!=((source[i]>>6)&0x1f)) {
+        emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+      }
+      emit_fstpl(temp);
+    }
+    return;
+  }
+}
+
+// Call a helper taking two 64-bit arguments, which are passed
+// through the stack so the halves can be reloaded afterwards.
+// Any other live caller-saved register is preserved around the call.
+static void emit_call64(intptr_t func,int r1h,int r1l,int r2h,int r2l,signed char regmap[])
+{
+  u_int hr,save=0;
+  int pushed=0;
+  for(hr=0;hr<HOST_REGS;hr++) {
+    if(regmap[hr]>=0) save|=1<<hr;
+  }
+  save&=CALLER_SAVED_REGS&~(1<<r1h)&~(1<<r1l)&~(1<<r2h)&~(1<<r2l);
+  for(hr=0;hr<HOST_REGS;hr++) {
+    if((save>>hr)&1) {emit_pushreg(hr);pushed++;}
+  }
+  emit_addimm(ESP,(pushed&1)?-24:-16,ESP);
+  emit_writeword_indexed(r2h,12,ESP);
+  emit_writeword_indexed(r2l,8,ESP);
+  emit_writeword_indexed(r1h,4,ESP);
+  emit_writeword_indexed(r1l,0,ESP);
+  output_rex(1,EDI,0,ESP);output_byte(0x8B);output_mem(EDI,ESP,0);
+  output_rex(1,ESI,0,ESP);output_byte(0x8B);output_mem(ESI,ESP,8);
+  emit_call(func);
+  emit_readword_indexed(0,ESP,r1l);
+  emit_readword_indexed(4,ESP,r1h);
+  emit_readword_indexed(8,ESP,r2l);
+  emit_readword_indexed(12,ESP,r2h);
+  emit_addimm(ESP,(pushed&1)?24:16,ESP);
+  for(hr=HOST_REGS;hr>0;hr--) {
+    if((save>>(hr-1))&1) emit_popreg(hr-1);
+  }
+}
+
+static void multdiv_assemble_x86_64(int i,struct regstat *i_regs)
+{
+  //  case 0x18: MULT
+  //  case 0x19: MULTU
+  //  case 0x1A: DIV
+  //  case 0x1B: DIVU
+  //  case 0x1C: DMULT
+  //  case 0x1D: DMULTU
+  //  case 0x1E: DDIV
+  //  case 0x1F: DDIVU
+  if(rs1[i]&&rs2[i])
+  {
+    if((opcode2[i]&4)==0) // 32-bit
+    {
+      if(opcode2[i]==0x18) // MULT
+      {
+        char m1=get_reg(i_regs->regmap,rs1[i]);
+        char m2=get_reg(i_regs->regmap,rs2[i]);
+        assert(m1>=0);
+        assert(m2>=0);
+        emit_mov(m1,EAX);
+        emit_imul(m2);
+      }
+      if(opcode2[i]==0x19) // MULTU
+      {
+        char m1=get_reg(i_regs->regmap,rs1[i]);
+        char m2=get_reg(i_regs->regmap,rs2[i]);
+        assert(m1>=0);
+        assert(m2>=0);
+        emit_mov(m1,EAX);
+        emit_mul(m2);
+      }
+      if(opcode2[i]==0x1A) // DIV
+      {
+        char d1=get_reg(i_regs->regmap,rs1[i]);
+        char d2=get_reg(i_regs->regmap,rs2[i]);
+        assert(d1>=0);
+        assert(d2>=0);
+        emit_mov(d1,EAX);
+        emit_cdq();
+        emit_test(d2,d2);
+        emit_jeq((intptr_t)out+((d2>=8)?9:8));
+        emit_idiv(d2);
+      }
+      if(opcode2[i]==0x1B) // DIVU
+      {
+        char d1=get_reg(i_regs->regmap,rs1[i]);
+        char d2=get_reg(i_regs->regmap,rs2[i]);
+        assert(d1>=0);
+        assert(d2>=0);
+        emit_mov(d1,EAX);
+        emit_zeroreg(EDX);
+        emit_test(d2,d2);
+        emit_jeq((intptr_t)out+((d2>=8)?9:8));
+        emit_div(d2);
+      }
+    }
+    else // 64-bit
+    {
+      if(opcode2[i]==0x1C) // DMULT
+      {
+        char m1h=get_reg(i_regs->regmap,rs1[i]|64);
+        char m1l=get_reg(i_regs->regmap,rs1[i]);
+        char m2h=get_reg(i_regs->regmap,rs2[i]|64);
+        char m2l=get_reg(i_regs->regmap,rs2[i]);
+        assert(m1h>=0);
+        assert(m2h>=0);
+        assert(m1l>=0);
+        assert(m2l>=0);
+        emit_call64((intptr_t)&mult64,m1h,m1l,m2h,m2l,i_regs->regmap);
+        char hih=get_reg(i_regs->regmap,HIREG|64);
+        char hil=get_reg(i_regs->regmap,HIREG);
+        if(hih>=0) emit_loadreg(HIREG|64,hih);
+        if(hil>=0) emit_loadreg(HIREG,hil);
+        char loh=get_reg(i_regs->regmap,LOREG|64);
+        char lol=get_reg(i_regs->regmap,LOREG);
+        if(loh>=0) emit_loadreg(LOREG|64,loh);
+        if(lol>=0) emit_loadreg(LOREG,lol);
+      }
+      if(opcode2[i]==0x1D) // DMULTU
+      {
+        char m1h=get_reg(i_regs->regmap,rs1[i]|64);
+        char m1l=get_reg(i_regs->regmap,rs1[i]);
+        char m2h=get_reg(i_regs->regmap,rs2[i]|64);
+        char m2l=get_reg(i_regs->regmap,rs2[i]);
+        char temp=get_reg(i_regs->regmap,-1);
+        assert(m1h>=0);
+        assert(m2h>=0);
+        assert(m1l>=0);
+        assert(m2l>=0);
+        assert(temp>=0);
+        emit_mov(m1l,EAX);
+        emit_mul(m2l);
+        emit_storereg(LOREG,EAX);
+        emit_mov(EDX,temp);
+        emit_mov(m1h,EAX);
+        emit_mul(m2l);
+        emit_add(EAX,temp,temp);
+        emit_adcimm(0,EDX);
+        emit_storereg(HIREG,EDX);
+        emit_mov(m2h,EAX);
+        emit_mul(m1l);
+        emit_add(EAX,temp,temp);
+        emit_adcimm(0,EDX);
+        emit_storereg(LOREG|64,temp);
+        emit_mov(EDX,temp);
+        emit_mov(m2h,EAX);
+        emit_mul(m1h);
+        emit_add(EAX,temp,EAX);
+        emit_loadreg(HIREG,temp);
+        emit_adcimm(0,EDX);
+        emit_add(EAX,temp,EAX);
+        emit_adcimm(0,EDX);
+      }
+      if(opcode2[i]==0x1E) // DDIV
+      {
+        char d1h=get_reg(i_regs->regmap,rs1[i]|64);
+        char d1l=get_reg(i_regs->regmap,rs1[i]);
+        char d2h=get_reg(i_regs->regmap,rs2[i]|64);
+        char d2l=get_reg(i_regs->regmap,rs2[i]);
+        assert(d1h>=0);
+        assert(d2h>=0);
+        assert(d1l>=0);
+        assert(d2l>=0);
+        emit_call64((intptr_t)&div64,d1h,d1l,d2h,d2l,i_regs->regmap);
+        char hih=get_reg(i_regs->regmap,HIREG|64);
+        char hil=get_reg(i_regs->regmap,HIREG);
+        char loh=get_reg(i_regs->regmap,LOREG|64);
+        char lol=get_reg(i_regs->regmap,LOREG);
+        if(hih>=0) emit_loadreg(HIREG|64,hih);
+        if(hil>=0) emit_loadreg(HIREG,hil);
+        if(loh>=0) emit_loadreg(LOREG|64,loh);
+        if(lol>=0) emit_loadreg(LOREG,lol);
+      }
+      if(opcode2[i]==0x1F) // DDIVU
+      {
+        char d1h=get_reg(i_regs->regmap,rs1[i]|64);
+        char d1l=get_reg(i_regs->regmap,rs1[i]);
+        char d2h=get_reg(i_regs->regmap,rs2[i]|64);
+        char d2l=get_reg(i_regs->regmap,rs2[i]);
+        assert(d1h>=0);
+        assert(d2h>=0);
+        assert(d1l>=0);
+        assert(d2l>=0);
+        emit_call64((intptr_t)&divu64,d1h,d1l,d2h,d2l,i_regs->regmap);
+        char hih=get_reg(i_regs->regmap,HIREG|64);
+        char hil=get_reg(i_regs->regmap,HIREG);
+        char loh=get_reg(i_regs->regmap,LOREG|64);
+        char lol=get_reg(i_regs->regmap,LOREG);
+        if(hih>=0) emit_loadreg(HIREG|64,hih);
+        if(hil>=0) emit_loadreg(HIREG,hil);
+        if(loh>=0) emit_loadreg(LOREG|64,loh);
+        if(lol>=0) emit_loadreg(LOREG,lol);
+      }
+    }
+  }
+  else
+  {
+    // Multiply by zero is zero.
+    // MIPS does not have a divide by zero exception.
+    // The result is undefined, we return zero.
+    char hr=get_reg(i_regs->regmap,HIREG);
+    char lr=get_reg(i_regs->regmap,LOREG);
+    if(hr>=0) emit_zeroreg(hr);
+    if(lr>=0) emit_zeroreg(lr);
+  }
+}
+#define multdiv_assemble multdiv_assemble_x86_64
+
+static void do_preload_rhash(int r) {
+  emit_movimm(0xf8,r);
+}
+
+static void do_preload_rhtbl(int r) {
+  // Don't need this for x86-64, mini_ht is addressed through HOST_TEMPREG
+}
+
+static void do_rhash(int rs,int rh) {
+  emit_and(rs,rh,rh);
+}
+
+static void do_miniht_load(int ht,int rh) {
+  // Don't need this for x86.  The load and compare can be combined into
+  // a single instruction (below)
+}
+
+// mini_ht entries are 16 bytes and rh is a multiple of 8,
+// so the table is indexed with a scale of 2
+static void do_miniht_jump(int rs,int rh,int ht) {
+  emit_cmpmem_indexed((intptr_t)mini_ht,rh,rs);
+  emit_jne(jump_vaddr_reg[rs]);
+  emit_jmpmem_indexed((intptr_t)mini_ht,rh);
+}
+
+static void do_miniht_insert(int return_address,int rt,int temp) {
+  emit_movimm(return_address,rt); // PC into link register
+  emit_writeword(rt,(intptr_t)&mini_ht[(return_address&0xFF)>>3][0]);
+  // lea rel32(%rip),%r15, the target is filled in by the linker
+  add_to_linker((intptr_t)out,return_address,1);
+  output_byte(0x4c);
+  output_byte(0x8d);
+  output_byte(0x3d);
+  output_w32(0);
+  emit_writeptr(HOST_TEMPREG,(intptr_t)&mini_ht[(return_address&0xFF)>>3][1]);
+}
+
+// We don't need this for x86
+static void literal_pool(int n) {}
+static void literal_pool_jumpover(int n) {}
+
+// CPU-architecture-specific initialization
+static void arch_init() {
+  ram_offset=((uintptr_t)rdram-0x80000000)>>2;
+  invc_ptr=(u_char *)invalid_code;
+}
@@ -0,0 +1,40 @@
+#ifndef M64P_R4300_ASSEM_X86_64_H
+#define M64P_R4300_ASSEM_X86_64_H
+
+#define HOST_REGS 15
+#define HOST_CCREG 3
+#define HOST_BTREG 5
+#define EXCLUDE_REG 4
+
+// %r15 is never allocated, it is used as a scratch register
+#define HOST_TEMPREG 15
+
+//#define IMM_PREFETCH 1
+#define INVERTED_CARRY 1
+#define DESTRUCTIVE_WRITEBACK 1
+#define DESTRUCTIVE_SHIFT 1
+
+#define USE_MINI_HT 1
+
+// Code and data are not within 32-bit reach of each other, so
+// memory accesses use the offset of rdram held in a register
+// and host pointers are 64 bits wide
+#define RAM_OFFSET 1
+#define HOST_PTR64 1
+
+// The translation cache is reserved in the library's own .bss so
+// that generated code can reach all globals with RIP-relative
+// addressing and rel32 calls
+extern char extra_memory[];
+#define BASE_ADDR ((intptr_t)extra_memory)
+
+extern void *base_addr; // Code generator target address
+#define TARGET_SIZE_2 25 // 2^25 = 32 megabytes
+#define JUMP_TABLE_SIZE 0 // Not needed for x86-64
+
+/* x86-64 calling convention (System V):
+   caller-save: %rax %rcx %rdx %rsi %rdi %r8 %r9 %r10 %r11
+   callee-save: %rbx %rbp %r12 %r13 %r14 %r15
+   arguments: %rdi %rsi %rdx %rcx %r8 %r9 */
+
+#endif /* M64P_R4300_ASSEM_X86_64_H */
@@ -34,15 +34,19 @@
 #include "../tlb.h"
 #include "../interupt.h"
 #include "../cached_interp.h"
+#include "../idle_loop.h"
 #include "new_dynarec.h"
 
 #include "../../memory/memory.h"
 #include "../../main/rom.h"
+#include "../../main/trace.h"
 
 #include <sys/mman.h>
 
 #if NEW_DYNAREC == NEW_DYNAREC_X86
 #include "assem_x86.h"
+#elif NEW_DYNAREC == NEW_DYNAREC_AMD64
+#include "assem_x86_64.h"
 #elif NEW_DYNAREC == NEW_DYNAREC_ARM
 #include "assem_arm.h"
 #else
@@ -121,10 +125,10 @@ static u_int wont_dirty[MAXBLOCK];
 static u_int will_dirty[MAXBLOCK];
 static int ccadj[MAXBLOCK];
 static int slen;
-static u_int instr_addr[MAXBLOCK];
-static u_int link_addr[MAXBLOCK][3];
+static uintptr_t instr_addr[MAXBLOCK];
+static uintptr_t link_addr[MAXBLOCK][3];
 static int linkcount;
-static u_int stubs[MAXBLOCK*3][8];
+static uintptr_t stubs[MAXBLOCK*3][8];
 static int stubcount;
 static int literalcount;
 static int is_delayslot;
@@ -133,7 +137,7 @@ u_char *out;
 struct ll_entry *jump_in[4096];
 static struct ll_entry *jump_out[4096];
 struct ll_entry *jump_dirty[4096];
-u_int hash_table[65536][4]  __attribute__((aligned(16)));
+uintptr_t hash_table[65536][4]  __attribute__((aligned(16)));
 static char shadow[2097152]  __attribute__((aligned(16)));
 static void *copy;
 static int expirep;
@@ -224,7 +228,7 @@ void __clear_cache_bugfix(char* begin, char *end);
 // asm linkage
 int new_recompile_block(int addr);
 void *get_addr_ht(u_int vaddr);
-static void remove_hash(int vaddr);
+static void remove_hash(u_int vaddr);
 void dyna_linker();
 void dyna_linker_ds();
 void verify_code();
@@ -254,7 +258,11 @@ void write_rdram_new();
 void write_rdramb_new();
 void write_rdramh_new();
 void write_rdramd_new();
-extern u_int memory_map[1048576];
+extern uintptr_t memory_map[1048576];
+// memory_map holds (host address - virtual address)>>2 for each 4K page.
+// The sign bit is set for unmapped pages, the bit below it for pages
+// which are write-protected because they contain compiled code.
+#define WRITE_PROTECT ((uintptr_t)1<<(sizeof(uintptr_t)*8-2))
 
 // Needed by assembler
 static void wb_register(signed char r,signed char regmap[],uint64_t dirty,uint64_t is32);
@@ -265,8 +273,8 @@ static void load_needed_regs(signed char i_regmap[],signed char next_regmap[]);
 static void load_regs_entry(int t);
 static void load_all_consts(signed char regmap[],int is32,u_int dirty,int i);
 
-static void add_stub(int type,int addr,int retaddr,int a,int b,int c,int d,int e);
-static void add_to_linker(int addr,int target,int ext);
+static void add_stub(int type,intptr_t addr,intptr_t retaddr,intptr_t a,intptr_t b,intptr_t c,intptr_t d,intptr_t e);
+static void add_to_linker(intptr_t addr,u_int target,int ext);
 static int verify_dirty(void *addr);
 
 //static int tracedebug=0;
@@ -321,7 +329,7 @@ static void tlb_hacks()
         addr=0;
         break;
     }
-    u_int rom_addr=(u_int)rom;
+    uintptr_t rom_addr=(uintptr_t)rom;
     #ifdef ROM_COPY
     // Since memory_map is 32-bit, on 64-bit systems the rom needs to be
     // in the lower 4G of memory to use this hack.  Copy it if necessary.
@@ -332,12 +340,12 @@ static void tlb_hacks()
               MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS,
               -1, 0) <= 0) {DebugMessage(M64MSG_ERROR, "mmap() failed");}
       memcpy(ROM_COPY,rom,12582912);
-      rom_addr=(u_int)ROM_COPY;
+      rom_addr=(uintptr_t)ROM_COPY;
     }
     #endif
     if(addr) {
       for(n=0x7F000;n<0x80000;n++) {
-        memory_map[n]=(((u_int)(rom_addr+addr-0x7F000000))>>2)|0x40000000;
+        memory_map[n]=((rom_addr+addr-0x7F000000)>>2)|WRITE_PROTECT;
       }
     }
   }
@@ -349,20 +357,20 @@ void *get_addr(u_int vaddr)
 {
   u_int page=(vaddr^0x80000000)>>12;
   u_int vpage=page;
-  if(page>262143&&tlb_LUT_r[vaddr>>12]) page=(tlb_LUT_r[vaddr>>12]^0x80000000)>>12;
+  if(page>262143&&tlb_LUT_r(vaddr>>12)) page=(tlb_LUT_r(vaddr>>12)^0x80000000)>>12;
   if(page>2048) page=2048+(page&2047);
-  if(vpage>262143&&tlb_LUT_r[vaddr>>12]) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
+  if(vpage>262143&&tlb_LUT_r(vaddr>>12)) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
   if(vpage>2048) vpage=2048+(vpage&2047);
   struct ll_entry *head;
   //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr %x,page %d)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,page);
   head=jump_in[page];
   while(head!=NULL) {
     if(head->vaddr==vaddr&&head->reg32==0) {
-  //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
-      u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(intptr_t)head->addr);
+      uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
       ht_bin[3]=ht_bin[1];
       ht_bin[2]=ht_bin[0];
-      ht_bin[1]=(int)head->addr;
+      ht_bin[1]=(intptr_t)head->addr;
       ht_bin[0]=vaddr;
       return head->addr;
     }
@@ -371,30 +379,30 @@ void *get_addr(u_int vaddr)
   head=jump_dirty[vpage];
   while(head!=NULL) {
     if(head->vaddr==vaddr&&head->reg32==0) {
-      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
+      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(intptr_t)head->addr);
       // Don't restore blocks which are about to expire from the cache
-      if((((u_int)head->addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
+      if(((u_int)((uintptr_t)head->addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
       if(verify_dirty(head->addr)) {
         //DebugMessage(M64MSG_VERBOSE, "restore candidate: %x (%d) d=%d",vaddr,page,invalid_code[vaddr>>12]);
         invalid_code[vaddr>>12]=0;
-        memory_map[vaddr>>12]|=0x40000000;
+        memory_map[vaddr>>12]|=WRITE_PROTECT;
         if(vpage<2048) {
-          if(tlb_LUT_r[vaddr>>12]) {
-            invalid_code[tlb_LUT_r[vaddr>>12]>>12]=0;
-            memory_map[tlb_LUT_r[vaddr>>12]>>12]|=0x40000000;
+          if(tlb_LUT_r(vaddr>>12)) {
+            invalid_code[tlb_LUT_r(vaddr>>12)>>12]=0;
+            memory_map[tlb_LUT_r(vaddr>>12)>>12]|=WRITE_PROTECT;
           }
           restore_candidate[vpage>>3]|=1<<(vpage&7);
         }
         else restore_candidate[page>>3]|=1<<(page&7);
-        u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+        uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
         if(ht_bin[0]==vaddr) {
-          ht_bin[1]=(int)head->addr; // Replace existing entry
+          ht_bin[1]=(intptr_t)head->addr; // Replace existing entry
         }
         else
         {
           ht_bin[3]=ht_bin[1];
           ht_bin[2]=ht_bin[0];
-          ht_bin[1]=(int)head->addr;
+          ht_bin[1]=(intptr_t)head->addr;
           ht_bin[0]=vaddr;
         }
         return head->addr;
@@ -403,7 +411,9 @@ void *get_addr(u_int vaddr)
     head=head->next;
   }
   //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr no-match %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr);
+  trace_begin("new_dynarec.recompile_block");
   int r=new_recompile_block(vaddr);
+  trace_end("new_dynarec.recompile_block");
   if(r==0) return get_addr(vaddr);
   // Execute in unmapped page, generate pagefault execption
   g_cp0_regs[CP0_STATUS_REG]|=2;
@@ -418,7 +428,7 @@ void *get_addr(u_int vaddr)
 void *get_addr_ht(u_int vaddr)
 {
   //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr_ht %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr);
-  u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
   if(ht_bin[0]==vaddr) return (void *)ht_bin[1];
   if(ht_bin[2]==vaddr) return (void *)ht_bin[3];
   return get_addr(vaddr);
@@ -427,32 +437,32 @@ void *get_addr_ht(u_int vaddr)
 void *get_addr_32(u_int vaddr,u_int flags)
 {
   //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr_32 %x,flags %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,flags);
-  u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
   if(ht_bin[0]==vaddr) return (void *)ht_bin[1];
   if(ht_bin[2]==vaddr) return (void *)ht_bin[3];
   u_int page=(vaddr^0x80000000)>>12;
   u_int vpage=page;
-  if(page>262143&&tlb_LUT_r[vaddr>>12]) page=(tlb_LUT_r[vaddr>>12]^0x80000000)>>12;
+  if(page>262143&&tlb_LUT_r(vaddr>>12)) page=(tlb_LUT_r(vaddr>>12)^0x80000000)>>12;
   if(page>2048) page=2048+(page&2047);
-  if(vpage>262143&&tlb_LUT_r[vaddr>>12]) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
+  if(vpage>262143&&tlb_LUT_r(vaddr>>12)) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
   if(vpage>2048) vpage=2048+(vpage&2047);
   struct ll_entry *head;
   head=jump_in[page];
   while(head!=NULL) {
     if(head->vaddr==vaddr&&(head->reg32&flags)==0) {
-      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr_32 match %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
+      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr_32 match %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(intptr_t)head->addr);
       if(head->reg32==0) {
-        u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+        uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
         if(ht_bin[0]==-1) {
-          ht_bin[1]=(int)head->addr;
+          ht_bin[1]=(intptr_t)head->addr;
           ht_bin[0]=vaddr;
         }else if(ht_bin[2]==-1) {
-          ht_bin[3]=(int)head->addr;
+          ht_bin[3]=(intptr_t)head->addr;
           ht_bin[2]=vaddr;
         }
         //ht_bin[3]=ht_bin[1];
         //ht_bin[2]=ht_bin[0];
-        //ht_bin[1]=(int)head->addr;
+        //ht_bin[1]=(intptr_t)head->addr;
         //ht_bin[0]=vaddr;
       }
       return head->addr;
@@ -462,33 +472,33 @@ void *get_addr_32(u_int vaddr,u_int flags)
   head=jump_dirty[vpage];
   while(head!=NULL) {
     if(head->vaddr==vaddr&&(head->reg32&flags)==0) {
-      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr_32 match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
+      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr_32 match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(intptr_t)head->addr);
       // Don't restore blocks which are about to expire from the cache
-      if((((u_int)head->addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
+      if(((u_int)((uintptr_t)head->addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
       if(verify_dirty(head->addr)) {
         //DebugMessage(M64MSG_VERBOSE, "restore candidate: %x (%d) d=%d",vaddr,page,invalid_code[vaddr>>12]);
         invalid_code[vaddr>>12]=0;
-        memory_map[vaddr>>12]|=0x40000000;
+        memory_map[vaddr>>12]|=WRITE_PROTECT;
         if(vpage<2048) {
-          if(tlb_LUT_r[vaddr>>12]) {
-            invalid_code[tlb_LUT_r[vaddr>>12]>>12]=0;
-            memory_map[tlb_LUT_r[vaddr>>12]>>12]|=0x40000000;
+          if(tlb_LUT_r(vaddr>>12)) {
+            invalid_code[tlb_LUT_r(vaddr>>12)>>12]=0;
+            memory_map[tlb_LUT_r(vaddr>>12)>>12]|=WRITE_PROTECT;
           }
           restore_candidate[vpage>>3]|=1<<(vpage&7);
         }
         else restore_candidate[page>>3]|=1<<(page&7);
         if(head->reg32==0) {
-          u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+          uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
           if(ht_bin[0]==-1) {
-            ht_bin[1]=(int)head->addr;
+            ht_bin[1]=(intptr_t)head->addr;
             ht_bin[0]=vaddr;
           }else if(ht_bin[2]==-1) {
-            ht_bin[3]=(int)head->addr;
+            ht_bin[3]=(intptr_t)head->addr;
             ht_bin[2]=vaddr;
           }
           //ht_bin[3]=ht_bin[1];
           //ht_bin[2]=ht_bin[0];
-          //ht_bin[1]=(int)head->addr;
+          //ht_bin[1]=(intptr_t)head->addr;
           //ht_bin[0]=vaddr;
         }
         return head->addr;
@@ -497,7 +507,9 @@ void *get_addr_32(u_int vaddr,u_int flags)
     head=head->next;
   }
   //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr_32 no-match %x,flags %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,flags);
+  trace_begin("new_dynarec.recompile_block");
   int r=new_recompile_block(vaddr);
+  trace_end("new_dynarec.recompile_block");
   if(r==0) return get_addr(vaddr);
   // Execute in unmapped page, generate pagefault execption
   g_cp0_regs[CP0_STATUS_REG]|=2;
@@ -860,7 +872,7 @@ static void divu64(uint64_t dividend,uint64_t divisor)
   //                                     ,(int)reg[LOREG],(int)(reg[LOREG]>>32));
 }
 
-static void mult64(uint64_t m1,uint64_t m2)
+static void mult64(int64_t m1,int64_t m2)
 {
    unsigned long long int op1, op2, op3, op4;
    unsigned long long int result1, result2, result3, result4;
@@ -960,12 +972,19 @@ static uint64_t ldr_merge(uint64_t original,uint64_t loaded,u_int bits)
 
 #if NEW_DYNAREC == NEW_DYNAREC_X86
 #include "assem_x86.c"
+#elif NEW_DYNAREC == NEW_DYNAREC_AMD64
+#include "assem_x86_64.c"
 #elif NEW_DYNAREC == NEW_DYNAREC_ARM
 #include "assem_arm.c"
 #else
 #error Unsupported dynarec architecture
 #endif
 
+// Host pointers are the same size as a word, except on 64-bit hosts
+#ifndef HOST_PTR64
+#define emit_readptr emit_readword
+#endif
+
 // Add virtual address mapping to linked list
 static void ll_add(struct ll_entry **head,int vaddr,void *addr)
 {
@@ -996,40 +1015,40 @@ static void ll_add_32(struct ll_entry **head,int vaddr,u_int reg32,void *addr)
 // but don't return addresses which are about to expire from the cache
 static void *check_addr(u_int vaddr)
 {
-  u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
   if(ht_bin[0]==vaddr) {
-    if(((ht_bin[1]-MAX_OUTPUT_BLOCK_SIZE-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
+    if(((u_int)(ht_bin[1]-MAX_OUTPUT_BLOCK_SIZE-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
       if(isclean(ht_bin[1])) return (void *)ht_bin[1];
   }
   if(ht_bin[2]==vaddr) {
-    if(((ht_bin[3]-MAX_OUTPUT_BLOCK_SIZE-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
+    if(((u_int)(ht_bin[3]-MAX_OUTPUT_BLOCK_SIZE-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
       if(isclean(ht_bin[3])) return (void *)ht_bin[3];
   }
   u_int page=(vaddr^0x80000000)>>12;
-  if(page>262143&&tlb_LUT_r[vaddr>>12]) page=(tlb_LUT_r[vaddr>>12]^0x80000000)>>12;
+  if(page>262143&&tlb_LUT_r(vaddr>>12)) page=(tlb_LUT_r(vaddr>>12)^0x80000000)>>12;
   if(page>2048) page=2048+(page&2047);
   struct ll_entry *head;
   head=jump_in[page];
   while(head!=NULL) {
     if(head->vaddr==vaddr&&head->reg32==0) {
-      if((((u_int)head->addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+      if(((u_int)((uintptr_t)head->addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
         // Update existing entry with current address
         if(ht_bin[0]==vaddr) {
-          ht_bin[1]=(int)head->addr;
+          ht_bin[1]=(intptr_t)head->addr;
           return head->addr;
         }
         if(ht_bin[2]==vaddr) {
-          ht_bin[3]=(int)head->addr;
+          ht_bin[3]=(intptr_t)head->addr;
           return head->addr;
         }
         // Insert into hash table with low priority.
         // Don't evict existing entries, as they are probably
         // addresses that are being accessed frequently.
         if(ht_bin[0]==-1) {
-          ht_bin[1]=(int)head->addr;
+          ht_bin[1]=(intptr_t)head->addr;
           ht_bin[0]=vaddr;
         }else if(ht_bin[2]==-1) {
-          ht_bin[3]=(int)head->addr;
+          ht_bin[3]=(intptr_t)head->addr;
           ht_bin[2]=vaddr;
         }
         return head->addr;
@@ -1040,10 +1059,10 @@ static void *check_addr(u_int vaddr)
   return 0;
 }
 
-static void remove_hash(int vaddr)
+static void remove_hash(u_int vaddr)
 {
   //DebugMessage(M64MSG_VERBOSE, "remove hash: %x",vaddr);
-  u_int *ht_bin=hash_table[(((vaddr)>>16)^vaddr)&0xFFFF];
+  uintptr_t *ht_bin=hash_table[(((vaddr)>>16)^vaddr)&0xFFFF];
   if(ht_bin[2]==vaddr) {
     ht_bin[2]=ht_bin[3]=-1;
   }
@@ -1054,14 +1073,14 @@ static void remove_hash(int vaddr)
   }
 }
 
-static void ll_remove_matching_addrs(struct ll_entry **head,int addr,int shift)
+static void ll_remove_matching_addrs(struct ll_entry **head,intptr_t addr,int shift)
 {
   struct ll_entry *next;
   while(*head) {
-    if((((u_int)((*head)->addr)-(u_int)base_addr)>>shift)==((addr-(u_int)base_addr)>>shift) ||
-       (((u_int)((*head)->addr)-(u_int)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((addr-(u_int)base_addr)>>shift))
+    if((((uintptr_t)((*head)->addr)-(uintptr_t)base_addr)>>shift)==((addr-(uintptr_t)base_addr)>>shift) ||
+       (((uintptr_t)((*head)->addr)-(uintptr_t)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((addr-(uintptr_t)base_addr)>>shift))
     {
-      inv_debug("EXP: Remove pointer to %x (%x)\n",(int)(*head)->addr,(*head)->vaddr);
+      inv_debug("EXP: Remove pointer to %x (%x)\n",(intptr_t)(*head)->addr,(*head)->vaddr);
       remove_hash((*head)->vaddr);
       next=(*head)->next;
       free(*head);
@@ -1090,18 +1109,20 @@ static void ll_clear(struct ll_entry **head)
 }
 
 // Dereference the pointers and remove if it matches
-static void ll_kill_pointers(struct ll_entry *head,int addr,int shift)
+static void ll_kill_pointers(struct ll_entry *head,intptr_t addr,int shift)
 {
   while(head) {
-    u_int ptr=get_pointer(head->addr);
-    inv_debug("EXP: Lookup pointer to %x at %x (%x)\n",(int)ptr,(int)head->addr,head->vaddr);
-    if((((ptr-(u_int)base_addr)>>shift)==((addr-(u_int)base_addr)>>shift)) ||
-       (((ptr-(u_int)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((addr-(u_int)base_addr)>>shift)))
+    uintptr_t ptr=get_pointer(head->addr);
+    inv_debug("EXP: Lookup pointer to %x at %x (%x)\n",(int)ptr,(intptr_t)head->addr,head->vaddr);
+    if((((ptr-(uintptr_t)base_addr)>>shift)==((addr-(uintptr_t)base_addr)>>shift)) ||
+       (((ptr-(uintptr_t)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((addr-(uintptr_t)base_addr)>>shift)))
     {
-      inv_debug("EXP: Kill pointer at %x (%x)\n",(int)head->addr,head->vaddr);
-      u_int host_addr=(int)kill_pointer(head->addr);
+      inv_debug("EXP: Kill pointer at %x (%x)\n",(intptr_t)head->addr,head->vaddr);
       #if NEW_DYNAREC == NEW_DYNAREC_ARM
-        needs_clear_cache[(host_addr-(u_int)base_addr)>>17]|=1<<(((host_addr-(u_int)base_addr)>>12)&31);
+        uintptr_t host_addr=(uintptr_t)kill_pointer(head->addr);
+        needs_clear_cache[(host_addr-(uintptr_t)base_addr)>>17]|=1<<(((host_addr-(uintptr_t)base_addr)>>12)&31);
+      #else
+        kill_pointer(head->addr);
       #endif
     }
     head=head->next;
@@ -1125,10 +1146,12 @@ static void invalidate_page(u_int page)
   head=jump_out[page];
   jump_out[page]=0;
   while(head!=NULL) {
-    inv_debug("INVALIDATE: kill pointer to %x (%x)\n",head->vaddr,(int)head->addr);
-    u_int host_addr=(int)kill_pointer(head->addr);
+    inv_debug("INVALIDATE: kill pointer to %x (%x)\n",head->vaddr,(intptr_t)head->addr);
     #if NEW_DYNAREC == NEW_DYNAREC_ARM
-      needs_clear_cache[(host_addr-(u_int)base_addr)>>17]|=1<<(((host_addr-(u_int)base_addr)>>12)&31);
+      uintptr_t host_addr=(uintptr_t)kill_pointer(head->addr);
+      needs_clear_cache[(host_addr-(uintptr_t)base_addr)>>17]|=1<<(((host_addr-(uintptr_t)base_addr)>>12)&31);
+    #else
+      kill_pointer(head->addr);
     #endif
     next=head->next;
     free(head);
@@ -1139,11 +1162,12 @@ void invalidate_block(u_int block)
 {
   u_int page,vpage;
   page=vpage=block^0x80000;
-  if(page>262143&&tlb_LUT_r[block]) page=(tlb_LUT_r[block]^0x80000000)>>12;
+  if(page>262143&&tlb_LUT_r(block)) page=(tlb_LUT_r(block)^0x80000000)>>12;
   if(page>2048) page=2048+(page&2047);
-  if(vpage>262143&&tlb_LUT_r[block]) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
+  if(vpage>262143&&tlb_LUT_r(block)) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
   if(vpage>2048) vpage=2048+(vpage&2047);
   inv_debug("INVALIDATE: %x (%d)\n",block<<12,page);
+  trace_instant("new_dynarec.invalidate",block<<12);
   //inv_debug("invalid_code[block]=%d\n",invalid_code[block]);
   u_int first,last;
   first=last=page;
@@ -1151,20 +1175,15 @@ void invalidate_block(u_int block)
   head=jump_dirty[vpage];
   //DebugMessage(M64MSG_VERBOSE, "page=%d vpage=%d",page,vpage);
   while(head!=NULL) {
-    u_int start,end;
+    uintptr_t start,end;
     if(vpage>2047||(head->vaddr>>12)==block) { // Ignore vaddr hash collision
-      get_bounds((int)head->addr,&start,&end);
+      get_bounds((intptr_t)head->addr,&start,&end);
       //DebugMessage(M64MSG_VERBOSE, "start: %x end: %x",start,end);
-      if(page<2048&&start>=0x80000000&&end<0x80800000) {
-        if(((start-(u_int)rdram)>>12)<=page&&((end-1-(u_int)rdram)>>12)>=page) {
-          if((((start-(u_int)rdram)>>12)&2047)<first) first=((start-(u_int)rdram)>>12)&2047;
-          if((((end-1-(u_int)rdram)>>12)&2047)>last) last=((end-1-(u_int)rdram)>>12)&2047;
-        }
-      }
-      if(page<2048&&(signed int)start>=(signed int)0xC0000000&&(signed int)end>=(signed int)0xC0000000) {
-        if(((start+memory_map[start>>12]-(u_int)rdram)>>12)<=page&&((end-1+memory_map[(end-1)>>12]-(u_int)rdram)>>12)>=page) {
-          if((((start+memory_map[start>>12]-(u_int)rdram)>>12)&2047)<first) first=((start+memory_map[start>>12]-(u_int)rdram)>>12)&2047;
-          if((((end-1+memory_map[(end-1)>>12]-(u_int)rdram)>>12)&2047)>last) last=((end-1+memory_map[(end-1)>>12]-(u_int)rdram)>>12)&2047;
+      // get_bounds returns host addresses, also for blocks in TLB-mapped pages
+      if(page<2048&&start>=(uintptr_t)rdram&&end<=(uintptr_t)rdram+0x800000) {
+        if(((start-(uintptr_t)rdram)>>12)<=page&&((end-1-(uintptr_t)rdram)>>12)>=page) {
+          if((((start-(uintptr_t)rdram)>>12)&2047)<first) first=((start-(uintptr_t)rdram)>>12)&2047;
+          if((((end-1-(uintptr_t)rdram)>>12)&2047)>last) last=((end-1-(uintptr_t)rdram)>>12)&2047;
         }
       }
     }
@@ -1189,15 +1208,15 @@ void invalidate_block(u_int block)
   // Don't trap writes
   invalid_code[block]=1;
   // If there is a valid TLB entry for this page, remove write protect
-  if(tlb_LUT_w[block]) {
-    assert(tlb_LUT_r[block]==tlb_LUT_w[block]);
+  if(tlb_LUT_w(block)) {
+    assert(tlb_LUT_r(block)==tlb_LUT_w(block));
     // CHECK: Is this right?
-    memory_map[block]=((tlb_LUT_w[block]&0xFFFFF000)-(block<<12)+(unsigned int)rdram-0x80000000)>>2;
-    u_int real_block=tlb_LUT_w[block]>>12;
+    memory_map[block]=((uintptr_t)(tlb_LUT_w(block)&0xFFFFF000)-(block<<12)+(uintptr_t)rdram-0x80000000)>>2;
+    u_int real_block=tlb_LUT_w(block)>>12;
     invalid_code[real_block]=1;
-    if(real_block>=0x80000&&real_block<0x80800) memory_map[real_block]=((u_int)rdram-0x80000000)>>2;
+    if(real_block>=0x80000&&real_block<0x80800) memory_map[real_block]=((uintptr_t)rdram-0x80000000)>>2;
   }
-  else if(block>=0x80000&&block<0x80800) memory_map[block]=((u_int)rdram-0x80000000)>>2;
+  else if(block>=0x80000&&block<0x80800) memory_map[block]=((uintptr_t)rdram-0x80000000)>>2;
   #ifdef USE_MINI_HT
   memset(mini_ht,-1,sizeof(mini_ht));
   #endif
@@ -1231,10 +1250,10 @@ void invalidate_all_pages()
   #endif
   // TLB
   for(page=0;page<0x100000;page++) {
-    if(tlb_LUT_r[page]) {
-      memory_map[page]=((tlb_LUT_r[page]&0xFFFFF000)-(page<<12)+(unsigned int)rdram-0x80000000)>>2;
-      if(!tlb_LUT_w[page]||!invalid_code[page])
-        memory_map[page]|=0x40000000; // Write protect
+    if(tlb_LUT_r(page)) {
+      memory_map[page]=((uintptr_t)(tlb_LUT_r(page)&0xFFFFF000)-(page<<12)+(uintptr_t)rdram-0x80000000)>>2;
+      if(!tlb_LUT_w(page)||!invalid_code[page])
+        memory_map[page]|=WRITE_PROTECT; // Write protect
     }
     else memory_map[page]=-1;
     if(page==0x80000) page=0xC0000;
@@ -1246,9 +1265,9 @@ void invalidate_all_pages()
 void add_link(u_int vaddr,void *src)
 {
   u_int page=(vaddr^0x80000000)>>12;
-  if(page>262143&&tlb_LUT_r[vaddr>>12]) page=(tlb_LUT_r[vaddr>>12]^0x80000000)>>12;
+  if(page>262143&&tlb_LUT_r(vaddr>>12)) page=(tlb_LUT_r(vaddr>>12)^0x80000000)>>12;
   if(page>4095) page=2048+(page&2047);
-  inv_debug("add_link: %x -> %x (%d)\n",(int)src,vaddr,page);
+  inv_debug("add_link: %x -> %x (%d)\n",(int)(intptr_t)src,vaddr,page);
   ll_add(jump_out+page,vaddr,src);
   //int ptr=get_pointer(src);
   //inv_debug("add_link: Pointer is to %x\n",(int)ptr);
@@ -1266,20 +1285,20 @@ void clean_blocks(u_int page)
   while(head!=NULL) {
     if(!invalid_code[head->vaddr>>12]) {
       // Don't restore blocks which are about to expire from the cache
-      if((((u_int)head->addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
-        u_int start,end;
+      if(((u_int)((uintptr_t)head->addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+        uintptr_t start,end;
         if(verify_dirty(head->addr)) {
-          //DebugMessage(M64MSG_VERBOSE, "Possibly Restore %x (%x)",head->vaddr, (int)head->addr);
+          //DebugMessage(M64MSG_VERBOSE, "Possibly Restore %x (%x)",head->vaddr, (intptr_t)head->addr);
           u_int i;
           u_int inv=0;
-          get_bounds((int)head->addr,&start,&end);
-          if(start-(u_int)rdram<0x800000) {
-            for(i=(start-(u_int)rdram+0x80000000)>>12;i<=(end-1-(u_int)rdram+0x80000000)>>12;i++) {
+          get_bounds((intptr_t)head->addr,&start,&end);
+          if(start-(uintptr_t)rdram<0x800000) {
+            for(i=(start-(uintptr_t)rdram+0x80000000)>>12;i<=(end-1-(uintptr_t)rdram+0x80000000)>>12;i++) {
               inv|=invalid_code[i];
             }
           }
           if((signed int)head->vaddr>=(signed int)0xC0000000) {
-            u_int addr = (head->vaddr+(memory_map[head->vaddr>>12]<<2));
+            uintptr_t addr = (head->vaddr+(memory_map[head->vaddr>>12]<<2));
             //DebugMessage(M64MSG_VERBOSE, "addr=%x start=%x end=%x",addr,start,end);
             if(addr<start||addr>=end) inv=1;
           }
@@ -1287,21 +1306,21 @@ void clean_blocks(u_int page)
             inv=1;
           }
           if(!inv) {
-            void * clean_addr=(void *)get_clean_addr((int)head->addr);
-            if((((u_int)clean_addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+            void * clean_addr=(void *)get_clean_addr((intptr_t)head->addr);
+            if(((u_int)((uintptr_t)clean_addr-(uintptr_t)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
               u_int ppage=page;
-              if(page<2048&&tlb_LUT_r[head->vaddr>>12]) ppage=(tlb_LUT_r[head->vaddr>>12]^0x80000000)>>12;
-              inv_debug("INV: Restored %x (%x/%x)\n",head->vaddr, (int)head->addr, (int)clean_addr);
+              if(page<2048&&tlb_LUT_r(head->vaddr>>12)) ppage=(tlb_LUT_r(head->vaddr>>12)^0x80000000)>>12;
+              inv_debug("INV: Restored %x (%x/%x)\n",head->vaddr, (intptr_t)head->addr, (intptr_t)clean_addr);
               //DebugMessage(M64MSG_VERBOSE, "page=%x, addr=%x",page,head->vaddr);
               //assert(head->vaddr>>12==(page|0x80000));
               ll_add_32(jump_in+ppage,head->vaddr,head->reg32,clean_addr);
-              u_int *ht_bin=hash_table[((head->vaddr>>16)^head->vaddr)&0xFFFF];
+              uintptr_t *ht_bin=hash_table[((head->vaddr>>16)^head->vaddr)&0xFFFF];
               if(!head->reg32) {
                 if(ht_bin[0]==head->vaddr) {
-                  ht_bin[1]=(int)clean_addr; // Replace existing entry
+                  ht_bin[1]=(intptr_t)clean_addr; // Replace existing entry
                 }
                 if(ht_bin[2]==head->vaddr) {
-                  ht_bin[3]=(int)clean_addr; // Replace existing entry
+                  ht_bin[3]=(intptr_t)clean_addr; // Replace existing entry
                 }
               }
             }
@@ -1967,7 +1986,7 @@ static void pagespan_alloc(struct regstat *current,int i)
   //else ...
 }
 
-static void add_stub(int type,int addr,int retaddr,int a,int b,int c,int d,int e)
+static void add_stub(int type,intptr_t addr,intptr_t retaddr,intptr_t a,intptr_t b,intptr_t c,intptr_t d,intptr_t e)
 {
   stubs[stubcount][0]=type;
   stubs[stubcount][1]=addr;
@@ -2127,7 +2146,7 @@ static void alu_assemble(int i,struct regstat *i_regs)
           else emit_adds(s1l,s2l,tl);
           if(th>=0) {
             #ifdef INVERTED_CARRY
-            if(opcode2[i]&2) {if(s1h!=th) emit_mov(s1h,th);emit_sbb(th,s2h);}
+            if(opcode2[i]&2) {if(s1h!=th) emit_mov(s1h,th);emit_sbb(s2h,th);}
             #else
             if(opcode2[i]&2) emit_sbc(s1h,s2h,th);
             #endif
@@ -2744,8 +2763,8 @@ static void load_assemble(int i,struct regstat *i_regs)
 {
   int s,th,tl,addr,map=-1,cache=-1;
   int offset;
-  int jaddr=0;
-  int memtarget,c=0;
+  intptr_t jaddr=0;
+  int memtarget=0,c=0;
   u_int hr,reglist=0;
   th=get_reg(i_regs->regmap,rt1[i]|64);
   tl=get_reg(i_regs->regmap,rt1[i]);
@@ -2781,7 +2800,7 @@ static void load_assemble(int i,struct regstat *i_regs)
       #endif
       {
         emit_cmpimm(addr,0x800000);
-        jaddr=(int)out;
+        jaddr=(intptr_t)out;
         #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
         // Hint to branch predictor that the branch is unlikely to be taken
         if(rs1[i]>=28)
@@ -2822,7 +2841,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         }
       }
       if(jaddr)
-        add_stub(LOADB_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADB_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else
       inline_readstub(LOADB_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -2846,16 +2865,20 @@ static void load_assemble(int i,struct regstat *i_regs)
             gen_tlb_addr_r(tl,map);
             emit_movswl_indexed(x,tl,tl);
           }else{
-            #ifdef RAM_OFFSET
+            #if defined(RAM_OFFSET)&&defined(HOST_PTR64)
+            emit_loadreg(ROREG,HOST_TEMPREG);
+            gen_tlb_addr_r(tl,HOST_TEMPREG);
+            emit_movswl_indexed(x,tl,tl);
+            #elif defined(RAM_OFFSET)
             emit_movswl_indexed(x,tl,tl);
             #else
-            emit_movswl_indexed((int)rdram-0x80000000+x,tl,tl);
+            emit_movswl_indexed((intptr_t)rdram-0x80000000+x,tl,tl);
             #endif
           }
         }
       }
       if(jaddr)
-        add_stub(LOADH_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADH_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else
       inline_readstub(LOADH_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -2872,7 +2895,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         emit_readword_indexed_tlb(0,addr,map,tl);
       }
       if(jaddr)
-        add_stub(LOADW_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADW_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else
       inline_readstub(LOADW_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -2896,7 +2919,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         }
       }
       if(jaddr)
-        add_stub(LOADBU_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADBU_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else
       inline_readstub(LOADBU_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -2920,16 +2943,20 @@ static void load_assemble(int i,struct regstat *i_regs)
             gen_tlb_addr_r(tl,map);
             emit_movzwl_indexed(x,tl,tl);
           }else{
-            #ifdef RAM_OFFSET
+            #if defined(RAM_OFFSET)&&defined(HOST_PTR64)
+            emit_loadreg(ROREG,HOST_TEMPREG);
+            gen_tlb_addr_r(tl,HOST_TEMPREG);
+            emit_movzwl_indexed(x,tl,tl);
+            #elif defined(RAM_OFFSET)
             emit_movzwl_indexed(x,tl,tl);
             #else
-            emit_movzwl_indexed((int)rdram-0x80000000+x,tl,tl);
+            emit_movzwl_indexed((intptr_t)rdram-0x80000000+x,tl,tl);
             #endif
           }
         }
       }
       if(jaddr)
-        add_stub(LOADHU_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADHU_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else
       inline_readstub(LOADHU_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -2947,7 +2974,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         emit_readword_indexed_tlb(0,addr,map,tl);
       }
       if(jaddr)
-        add_stub(LOADW_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADW_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else {
       inline_readstub(LOADW_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -2968,7 +2995,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         emit_readdword_indexed_tlb(0,addr,map,th,tl);
       }
       if(jaddr)
-        add_stub(LOADD_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADD_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else
       inline_readstub(LOADD_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -2981,13 +3008,13 @@ static void load_assemble(int i,struct regstat *i_regs)
   {
     //emit_pusha();
     save_regs(0x100f);
-        emit_readword((int)&last_count,ECX);
+        emit_readword((intptr_t)&last_count,ECX);
         #if NEW_DYNAREC == NEW_DYNAREC_X86
         if(get_reg(i_regs->regmap,CCREG)<0)
           emit_loadreg(CCREG,HOST_CCREG);
         emit_add(HOST_CCREG,ECX,HOST_CCREG);
         emit_addimm(HOST_CCREG,2*ccadj[i],HOST_CCREG);
-        emit_writeword(HOST_CCREG,(int)&g_cp0_regs[CP0_COUNT_REG]);
+        emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
         #endif
         #if NEW_DYNAREC == NEW_DYNAREC_ARM
         if(get_reg(i_regs->regmap,CCREG)<0)
@@ -2996,9 +3023,9 @@ static void load_assemble(int i,struct regstat *i_regs)
           emit_mov(HOST_CCREG,0);
         emit_add(0,ECX,0);
         emit_addimm(0,2*ccadj[i],0);
-        emit_writeword(0,(int)&g_cp0_regs[CP0_COUNT_REG]);
+        emit_writeword(0,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
         #endif
-    emit_call((int)memdebug);
+    emit_call((intptr_t)memdebug);
     //emit_popa();
     restore_regs(0x100f);
   }*/
@@ -3017,8 +3044,9 @@ static void store_assemble(int i,struct regstat *i_regs)
   int s,th,tl,map=-1,cache=-1;
   int addr,temp;
   int offset;
-  int jaddr=0,jaddr2,type;
-  int memtarget,c=0;
+  intptr_t jaddr=0,jaddr2;
+  int type;
+  int memtarget=0,c=0;
   int agr=AGEN1+(i&1);
   u_int hr,reglist=0;
   th=get_reg(i_regs->regmap,rs2[i]|64);
@@ -3059,7 +3087,7 @@ static void store_assemble(int i,struct regstat *i_regs)
       if(rs1[i]!=29||start<0x80001000||start>=0x80800000)
       #endif
       {
-        jaddr=(int)out;
+        jaddr=(intptr_t)out;
         #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
         // Hint to branch predictor that the branch is unlikely to be taken
         if(rs1[i]>=28)
@@ -3097,14 +3125,16 @@ static void store_assemble(int i,struct regstat *i_regs)
       int x=0;
       if(!c) emit_xorimm(addr,2,temp);
       else x=((constmap[i][s]+offset)^2)-(constmap[i][s]+offset);
-      //#ifdef
-      //emit_writehword_indexed_tlb(tl,x,temp,map,temp);
-      //#else
+      #ifdef HOST_PTR64
+      // temp must remain a guest address for the invalid_code check
+      emit_writehword_indexed_tlb(tl,x,temp,map,temp);
+      #else
       if(map>=0) {
         gen_tlb_addr_w(temp,map);
         emit_writehword_indexed(tl,x,temp);
       }else
-        emit_writehword_indexed(tl,(int)rdram-0x80000000+x,temp);
+        emit_writehword_indexed(tl,(intptr_t)rdram-0x80000000+x,temp);
+      #endif
     }
     type=STOREH_STUB;
   }
@@ -3142,19 +3172,19 @@ static void store_assemble(int i,struct regstat *i_regs)
       assert(ir>=0);
       emit_cmpmem_indexedsr12_reg(ir,addr,1);
       #else
-      emit_cmpmem_indexedsr12_imm((int)invalid_code,addr,1);
+      emit_cmpmem_indexedsr12_imm((intptr_t)invalid_code,addr,1);
       #endif
       #if defined(HAVE_CONDITIONAL_CALL) && !defined(DESTRUCTIVE_SHIFT)
       emit_callne(invalidate_addr_reg[addr]);
       #else
-      jaddr2=(int)out;
+      jaddr2=(intptr_t)out;
       emit_jne(0);
-      add_stub(INVCODE_STUB,jaddr2,(int)out,reglist|(1<<HOST_CCREG),addr,0,0,0);
+      add_stub(INVCODE_STUB,jaddr2,(intptr_t)out,reglist|(1<<HOST_CCREG),addr,0,0,0);
       #endif
     }
   }
   if(jaddr) {
-    add_stub(type,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+    add_stub(type,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
   } else if(c&&!memtarget) {
     inline_writestub(type,i,constmap[i][s]+offset,i_regs->regmap,rs2[i],ccadj[i],reglist);
   }
@@ -3173,13 +3203,13 @@ static void store_assemble(int i,struct regstat *i_regs)
     #if NEW_DYNAREC == NEW_DYNAREC_ARM
     save_regs(0x100f);
     #endif
-        emit_readword((int)&last_count,ECX);
+        emit_readword((intptr_t)&last_count,ECX);
         #if NEW_DYNAREC == NEW_DYNAREC_X86
         if(get_reg(i_regs->regmap,CCREG)<0)
           emit_loadreg(CCREG,HOST_CCREG);
         emit_add(HOST_CCREG,ECX,HOST_CCREG);
         emit_addimm(HOST_CCREG,2*ccadj[i],HOST_CCREG);
-        emit_writeword(HOST_CCREG,(int)&g_cp0_regs[CP0_COUNT_REG]);
+        emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
         #endif
         #if NEW_DYNAREC == NEW_DYNAREC_ARM
         if(get_reg(i_regs->regmap,CCREG)<0)
@@ -3188,9 +3218,9 @@ static void store_assemble(int i,struct regstat *i_regs)
           emit_mov(HOST_CCREG,0);
         emit_add(0,ECX,0);
         emit_addimm(0,2*ccadj[i],0);
-        emit_writeword(0,(int)&g_cp0_regs[CP0_COUNT_REG]);
+        emit_writeword(0,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
         #endif
-    emit_call((int)memdebug);
+    emit_call((intptr_t)memdebug);
     #if NEW_DYNAREC == NEW_DYNAREC_X86
     emit_popa();
     #endif
@@ -3205,12 +3235,12 @@ static void storelr_assemble(int i,struct regstat *i_regs)
 {
   int s,th,tl;
   int temp;
-  int temp2;
+  int temp2=-1;
   int offset;
-  int jaddr=0,jaddr2;
-  int case1,case2,case3;
-  int done0,done1,done2;
-  int memtarget,c=0;
+  intptr_t jaddr=0,jaddr2;
+  intptr_t case1,case2,case3;
+  intptr_t done0,done1,done2;
+  int memtarget=0,c=0;
   int agr=AGEN1+(i&1);
   u_int hr,reglist=0;
   th=get_reg(i_regs->regmap,rs2[i]|64);
@@ -3233,13 +3263,13 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     if(!c) {
       emit_cmpimm(s<0||offset?temp:s,0x800000);
       if(!offset&&s!=temp) emit_mov(s,temp);
-      jaddr=(int)out;
+      jaddr=(intptr_t)out;
       emit_jno(0);
     }
     else
     {
       if(!memtarget||!rs1[i]) {
-        jaddr=(int)out;
+        jaddr=(intptr_t)out;
         emit_jmp(0);
       }
     }
@@ -3256,11 +3286,11 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     int cache=get_reg(i_regs->regmap,MMREG);
     assert(map>=0);
     reglist&=~(1<<map);
-    map=do_tlb_w(c||s<0||offset?temp:s,temp,map,cache,0,c,constmap[i][s]+offset);
+    map=do_tlb_w(c||s<0||offset?temp:s,temp,map,cache,0,c,c?constmap[i][s]+offset:0);
     if(!c&&!offset&&s>=0) emit_mov(s,temp);
-    do_tlb_w_branch(map,c,constmap[i][s]+offset,&jaddr);
+    do_tlb_w_branch(map,c,c?constmap[i][s]+offset:0,&jaddr);
     if(!jaddr&&!memtarget) {
-      jaddr=(int)out;
+      jaddr=(intptr_t)out;
       emit_jmp(0);
     }
     gen_tlb_addr_w(temp,map);
@@ -3272,10 +3302,10 @@ static void storelr_assemble(int i,struct regstat *i_regs)
   }
 
   emit_testimm(temp,2);
-  case2=(int)out;
+  case2=(intptr_t)out;
   emit_jne(0);
   emit_testimm(temp,1);
-  case1=(int)out;
+  case1=(intptr_t)out;
   emit_jne(0);
   // 0
   if (opcode[i]==0x2A) { // SWL
@@ -3292,10 +3322,10 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     emit_writebyte_indexed(tl,3,temp);
     if(rs2[i]) emit_shldimm(th,tl,24,temp2);
   }
-  done0=(int)out;
+  done0=(intptr_t)out;
   emit_jmp(0);
   // 1
-  set_jump_target(case1,(int)out);
+  set_jump_target(case1,(intptr_t)out);
   if (opcode[i]==0x2A) { // SWL
     // Write 3 msb into three least significant bytes
     if(rs2[i]) emit_rorimm(tl,8,tl);
@@ -3322,12 +3352,12 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     // Write two lsb into two most significant bytes
     emit_writehword_indexed(tl,1,temp);
   }
-  done1=(int)out;
+  done1=(intptr_t)out;
   emit_jmp(0);
   // 2
-  set_jump_target(case2,(int)out);
+  set_jump_target(case2,(intptr_t)out);
   emit_testimm(temp,1);
-  case3=(int)out;
+  case3=(intptr_t)out;
   emit_jne(0);
   if (opcode[i]==0x2A) { // SWL
     // Write two msb into two least significant bytes
@@ -3357,10 +3387,10 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     emit_writehword_indexed(tl,0,temp);
     if(rs2[i]) emit_rorimm(tl,24,tl);
   }
-  done2=(int)out;
+  done2=(intptr_t)out;
   emit_jmp(0);
   // 3
-  set_jump_target(case3,(int)out);
+  set_jump_target(case3,(intptr_t)out);
   if (opcode[i]==0x2A) { // SWL
     // Write msb into least significant byte
     if(rs2[i]) emit_rorimm(tl,24,tl);
@@ -3383,27 +3413,27 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     // Write entire word
     emit_writeword_indexed(tl,-3,temp);
   }
-  set_jump_target(done0,(int)out);
-  set_jump_target(done1,(int)out);
-  set_jump_target(done2,(int)out);
+  set_jump_target(done0,(intptr_t)out);
+  set_jump_target(done1,(intptr_t)out);
+  set_jump_target(done2,(intptr_t)out);
   if (opcode[i]==0x2C) { // SDL
     emit_testimm(temp,4);
-    done0=(int)out;
+    done0=(intptr_t)out;
     emit_jne(0);
     emit_andimm(temp,~3,temp);
     emit_writeword_indexed(temp2,4,temp);
-    set_jump_target(done0,(int)out);
+    set_jump_target(done0,(intptr_t)out);
   }
   if (opcode[i]==0x2D) { // SDR
     emit_testimm(temp,4);
-    done0=(int)out;
+    done0=(intptr_t)out;
     emit_jeq(0);
     emit_andimm(temp,~3,temp);
     emit_writeword_indexed(temp2,-4,temp);
-    set_jump_target(done0,(int)out);
+    set_jump_target(done0,(intptr_t)out);
   }
   if(!c||!memtarget)
-    add_stub(STORELR_STUB,jaddr,(int)out,0,(int)i_regs,rs2[i],ccadj[i],reglist);
+    add_stub(STORELR_STUB,jaddr,(intptr_t)out,0,(intptr_t)i_regs,rs2[i],ccadj[i],reglist);
   if(!using_tlb) {
     #ifdef RAM_OFFSET
     int map=get_reg(i_regs->regmap,ROREG);
@@ -3417,26 +3447,26 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     assert(ir>=0);
     emit_cmpmem_indexedsr12_reg(ir,temp,1);
     #else
-    emit_cmpmem_indexedsr12_imm((int)invalid_code,temp,1);
+    emit_cmpmem_indexedsr12_imm((intptr_t)invalid_code,temp,1);
     #endif
     #if defined(HAVE_CONDITIONAL_CALL) && !defined(DESTRUCTIVE_SHIFT)
     emit_callne(invalidate_addr_reg[temp]);
     #else
-    jaddr2=(int)out;
+    jaddr2=(intptr_t)out;
     emit_jne(0);
-    add_stub(INVCODE_STUB,jaddr2,(int)out,reglist|(1<<HOST_CCREG),temp,0,0,0);
+    add_stub(INVCODE_STUB,jaddr2,(intptr_t)out,reglist|(1<<HOST_CCREG),temp,0,0,0);
     #endif
   }
   /*
     emit_pusha();
     //save_regs(0x100f);
-        emit_readword((int)&last_count,ECX);
+        emit_readword((intptr_t)&last_count,ECX);
         if(get_reg(i_regs->regmap,CCREG)<0)
           emit_loadreg(CCREG,HOST_CCREG);
         emit_add(HOST_CCREG,ECX,HOST_CCREG);
         emit_addimm(HOST_CCREG,2*ccadj[i],HOST_CCREG);
-        emit_writeword(HOST_CCREG,(int)&g_cp0_regs[CP0_COUNT_REG]);
-    emit_call((int)memdebug);
+        emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+    emit_call((intptr_t)memdebug);
     emit_popa();
     //restore_regs(0x100f);
   */
@@ -3449,7 +3479,8 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
   int map=-1;
   int offset;
   int c=0;
-  int jaddr,jaddr2=0,jaddr3,type;
+  intptr_t jaddr,jaddr2=0,jaddr3;
+  int type;
   int agr=AGEN1+(i&1);
   u_int hr,reglist=0;
   th=get_reg(i_regs->regmap,FTEMP|64);
@@ -3482,16 +3513,16 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
     signed char rs=get_reg(i_regs->regmap,CSREG);
     assert(rs>=0);
     emit_testimm(rs,0x20000000);
-    jaddr=(int)out;
+    jaddr=(intptr_t)out;
     emit_jeq(0);
-    add_stub(FP_STUB,jaddr,(int)out,i,rs,(int)i_regs,is_delayslot,0);
+    add_stub(FP_STUB,jaddr,(intptr_t)out,i,rs,(intptr_t)i_regs,is_delayslot,0);
     cop1_usable=1;
   }
   if (opcode[i]==0x39) { // SWC1 (get float address)
-    emit_readword((int)&reg_cop1_simple[(source[i]>>16)&0x1f],tl);
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>16)&0x1f],tl);
   }
   if (opcode[i]==0x3D) { // SDC1 (get double address)
-    emit_readword((int)&reg_cop1_double[(source[i]>>16)&0x1f],tl);
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>16)&0x1f],tl);
   }
   // Generate address + offset
   if(!using_tlb) {
@@ -3526,18 +3557,18 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
     emit_readword_indexed(0,tl,tl);
   }
   if (opcode[i]==0x31) { // LWC1 (get target address)
-    emit_readword((int)&reg_cop1_simple[(source[i]>>16)&0x1f],temp);
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>16)&0x1f],temp);
   }
   if (opcode[i]==0x35) { // LDC1 (get target address)
-    emit_readword((int)&reg_cop1_double[(source[i]>>16)&0x1f],temp);
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>16)&0x1f],temp);
   }
   if(!using_tlb) {
     if(!c) {
-      jaddr2=(int)out;
+      jaddr2=(intptr_t)out;
       emit_jno(0);
     }
     else if(((signed int)(constmap[i][s]+offset))>=(signed int)0x80800000) {
-      jaddr2=(int)out;
+      jaddr2=(intptr_t)out;
       emit_jmp(0); // inline_readstub/inline_writestub?  Very rare case
     }
     #ifdef DESTRUCTIVE_SHIFT
@@ -3599,18 +3630,18 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
       assert(ir>=0);
       emit_cmpmem_indexedsr12_reg(ir,temp,1);
       #else
-      emit_cmpmem_indexedsr12_imm((int)invalid_code,temp,1);
+      emit_cmpmem_indexedsr12_imm((intptr_t)invalid_code,temp,1);
       #endif
       #if defined(HAVE_CONDITIONAL_CALL) && !defined(DESTRUCTIVE_SHIFT)
       emit_callne(invalidate_addr_reg[temp]);
       #else
-      jaddr3=(int)out;
+      jaddr3=(intptr_t)out;
       emit_jne(0);
-      add_stub(INVCODE_STUB,jaddr3,(int)out,reglist|(1<<HOST_CCREG),temp,0,0,0);
+      add_stub(INVCODE_STUB,jaddr3,(intptr_t)out,reglist|(1<<HOST_CCREG),temp,0,0,0);
       #endif
     }
   }
-  if(jaddr2) add_stub(type,jaddr2,(int)out,i,offset||c||s<0?ar:s,(int)i_regs,ccadj[i],reglist);
+  if(jaddr2) add_stub(type,jaddr2,(intptr_t)out,i,offset||c||s<0?ar:s,(intptr_t)i_regs,ccadj[i],reglist);
   if (opcode[i]==0x31) { // LWC1 (write float)
     emit_writeword_indexed(tl,0,temp);
   }
@@ -3622,13 +3653,13 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
   /*if(opcode[i]==0x39||opcode[i]==0x31)
   {
     emit_pusha();
-        emit_readword((int)&last_count,ECX);
+        emit_readword((intptr_t)&last_count,ECX);
         if(get_reg(i_regs->regmap,CCREG)<0)
           emit_loadreg(CCREG,HOST_CCREG);
         emit_add(HOST_CCREG,ECX,HOST_CCREG);
         emit_addimm(HOST_CCREG,2*ccadj[i],HOST_CCREG);
-        emit_writeword(HOST_CCREG,(int)&g_cp0_regs[CP0_COUNT_REG]);
-    emit_call((int)memdebug);
+        emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+    emit_call((intptr_t)memdebug);
     emit_popa();
   }*/
 }
@@ -3686,7 +3717,7 @@ static void syscall_assemble(int i,struct regstat *i_regs)
   assert(!is_delayslot);
   emit_movimm(start+i*4,EAX); // Get PC
   emit_addimm(HOST_CCREG,CLOCK_DIVIDER*ccadj[i],HOST_CCREG); // CHECK: is this right?  There should probably be an extra cycle...
-  emit_jmp((int)jump_syscall);
+  emit_jmp((intptr_t)jump_syscall);
 }
 
 static void ds_assemble(int i,struct regstat *i_regs)
@@ -3886,7 +3917,7 @@ static void loop_preload(signed char pre[],signed char entry[])
 static void address_generation(int i,struct regstat *i_regs,signed char entry[])
 {
   if(itype[i]==LOAD||itype[i]==LOADLR||itype[i]==STORE||itype[i]==STORELR||itype[i]==C1LS) {
-    int ra;
+    int ra=-1;
     int agr=AGEN1+(i&1);
     int mgr=MGEN1+(i&1);
     if(itype[i]==LOAD) {
@@ -3955,14 +3986,14 @@ static void address_generation(int i,struct regstat *i_regs,signed char entry[])
         if(rs1[i]!=rt1[i]||itype[i]!=LOAD) {
           if(!entry||entry[ra]!=agr) {
             if (opcode[i]==0x22||opcode[i]==0x26) { // LWL/LWR
-              #ifdef RAM_OFFSET
+              #if defined(RAM_OFFSET) && !defined(HOST_PTR64)
               if((signed int)constmap[i][rs]+offset<(signed int)0x80800000) 
                 emit_movimm(((constmap[i][rs]+offset)&0xFFFFFFFC)+(int)rdram-0x80000000,ra);
               else
               #endif
               emit_movimm((constmap[i][rs]+offset)&0xFFFFFFFC,ra);
             }else if (opcode[i]==0x1a||opcode[i]==0x1b) { // LDL/LDR
-              #ifdef RAM_OFFSET
+              #if defined(RAM_OFFSET) && !defined(HOST_PTR64)
               if((signed int)constmap[i][rs]+offset<(signed int)0x80800000) 
                 emit_movimm(((constmap[i][rs]+offset)&0xFFFFFFF8)+(int)rdram-0x80000000,ra);
               else
@@ -3973,7 +4004,7 @@ static void address_generation(int i,struct regstat *i_regs,signed char entry[])
               if((itype[i]!=LOAD&&opcode[i]!=0x31&&opcode[i]!=0x35) ||
                  (using_tlb&&((signed int)constmap[i][rs]+offset)>=(signed int)0xC0000000))
               #endif
-              #ifdef RAM_OFFSET
+              #if defined(RAM_OFFSET) && !defined(HOST_PTR64)
               if((itype[i]==LOAD||opcode[i]==0x31||opcode[i]==0x35)&&(signed int)constmap[i][rs]+offset<(signed int)0x80800000) 
                 emit_movimm(constmap[i][rs]+offset+(int)rdram-0x80000000,ra);
               else
@@ -4029,14 +4060,14 @@ static void address_generation(int i,struct regstat *i_regs,signed char entry[])
       int c=(regs[i+1].wasconst>>rs)&1;
       if(c&&(rs1[i+1]!=rt1[i+1]||itype[i+1]!=LOAD)) {
         if (opcode[i+1]==0x22||opcode[i+1]==0x26) { // LWL/LWR
-          #ifdef RAM_OFFSET
+          #if defined(RAM_OFFSET) && !defined(HOST_PTR64)
           if((signed int)constmap[i+1][rs]+offset<(signed int)0x80800000) 
             emit_movimm(((constmap[i+1][rs]+offset)&0xFFFFFFFC)+(int)rdram-0x80000000,ra);
           else
           #endif
           emit_movimm((constmap[i+1][rs]+offset)&0xFFFFFFFC,ra);
         }else if (opcode[i+1]==0x1a||opcode[i+1]==0x1b) { // LDL/LDR
-          #ifdef RAM_OFFSET
+          #if defined(RAM_OFFSET) && !defined(HOST_PTR64)
           if((signed int)constmap[i+1][rs]+offset<(signed int)0x80800000) 
             emit_movimm(((constmap[i+1][rs]+offset)&0xFFFFFFF8)+(int)rdram-0x80000000,ra);
           else
@@ -4047,7 +4078,7 @@ static void address_generation(int i,struct regstat *i_regs,signed char entry[])
           if((itype[i+1]!=LOAD&&opcode[i+1]!=0x31&&opcode[i+1]!=0x35) ||
              (using_tlb&&((signed int)constmap[i+1][rs]+offset)>=(signed int)0xC0000000))
           #endif
-          #ifdef RAM_OFFSET
+          #if defined(RAM_OFFSET) && !defined(HOST_PTR64)
           if((itype[i+1]==LOAD||opcode[i+1]==0x31||opcode[i+1]==0x35)&&(signed int)constmap[i+1][rs]+offset<(signed int)0x80800000) 
             emit_movimm(constmap[i+1][rs]+offset+(int)rdram-0x80000000,ra);
           else
@@ -4091,7 +4122,7 @@ static int get_final_value(int hr, int i, int *value)
           #ifdef HOST_IMM_ADDR32
           if(!using_tlb||((signed int)constmap[i][hr]+imm[i+2])<(signed int)0xC0000000) return 0;
           #endif
-          #ifdef RAM_OFFSET
+          #if defined(RAM_OFFSET) && !defined(HOST_PTR64)
           if((signed int)constmap[i][hr]+imm[i+2]<(signed int)0x80800000)
             *value=constmap[i][hr]+imm[i+2]+(int)rdram-0x80000000;
           else
@@ -4106,7 +4137,7 @@ static int get_final_value(int hr, int i, int *value)
         #ifdef HOST_IMM_ADDR32
         if(!using_tlb||((signed int)constmap[i][hr]+imm[i+1])<(signed int)0xC0000000) return 0;
         #endif
-        #ifdef RAM_OFFSET
+        #if defined(RAM_OFFSET) && !defined(HOST_PTR64)
         if((signed int)constmap[i][hr]+imm[i+1]<(signed int)0x80800000)
           *value=constmap[i][hr]+imm[i+1]+(int)rdram-0x80000000;
         else
@@ -4562,7 +4593,7 @@ static int match_bt(signed char i_regmap[],uint64_t i_is32,uint64_t i_dirty,int
 static void ds_assemble_entry(int i)
 {
   int t=(ba[i]-start)>>2;
-  if(!instr_addr[t]) instr_addr[t]=(u_int)out;
+  if(!instr_addr[t]) instr_addr[t]=(intptr_t)out;
   assem_debug("Assemble delay slot at %x",ba[i]);
   assem_debug("<->");
   if(regs[t].regmap_entry[HOST_CCREG]==CCREG&&regs[t].regmap[HOST_CCREG]!=CCREG)
@@ -4624,15 +4655,24 @@ static void ds_assemble_entry(int i)
   else
     assem_debug("branch: external");
   assert(internal_branch(regs[t].is32,ba[i]+4));
-  add_to_linker((int)out,ba[i]+4,internal_branch(regs[t].is32,ba[i]+4));
+  add_to_linker((intptr_t)out,ba[i]+4,internal_branch(regs[t].is32,ba[i]+4));
   emit_jmp(0);
 }
 
+// Backward branch closing an idle loop of the block (see idle_loop.c), the
+// jumps to themselves are handled by do_cc
+static int is_idle_loop(int i)
+{
+  int t=(ba[i]-start)>>2;
+  if(!g_IdleLoopDetection||ba[i]<start||t>=i) return 0;
+  return idle_loop_analyse(source+t,i+2-t);
+}
+
 static void do_cc(int i,signed char i_regmap[],int *adj,int addr,int taken,int invert)
 {
   int count;
-  int jaddr;
-  int idle=0;
+  intptr_t jaddr;
+  intptr_t idle=0;
   if(itype[i]==RJUMP)
   {
     *adj=0;
@@ -4649,34 +4689,38 @@ static void do_cc(int i,signed char i_regmap[],int *adj,int addr,int taken,int i
     *adj=0;
   }
   count=ccadj[i];
+  if(taken==TAKEN && is_idle_loop(i)) {
+    // Longer idle loop, skip to the next interrupt and check it below
+    emit_andimm(HOST_CCREG,3,HOST_CCREG);
+  }
   if(taken==TAKEN && i==(ba[i]-start)>>2 && source[i+1]==0) {
     // Idle loop
     if(count&1) emit_addimm_and_set_flags(2*(count+2),HOST_CCREG);
-    idle=(int)out;
+    idle=(intptr_t)out;
     //emit_subfrommem(&idlecount,HOST_CCREG); // Count idle cycles
     emit_andimm(HOST_CCREG,3,HOST_CCREG);
-    jaddr=(int)out;
+    jaddr=(intptr_t)out;
     emit_jmp(0);
   }
   else if(*adj==0||invert) {
     emit_addimm_and_set_flags(CLOCK_DIVIDER*(count+2),HOST_CCREG);
-    jaddr=(int)out;
+    jaddr=(intptr_t)out;
     emit_jns(0);
   }
   else
   {
     emit_cmpimm(HOST_CCREG,-CLOCK_DIVIDER*(count+2));
-    jaddr=(int)out;
+    jaddr=(intptr_t)out;
     emit_jns(0);
   }
-  add_stub(CC_STUB,jaddr,idle?idle:(int)out,(*adj==0||invert||idle)?0:(count+2),i,addr,taken,0);
+  add_stub(CC_STUB,jaddr,idle?idle:(intptr_t)out,(*adj==0||invert||idle)?0:(count+2),i,addr,taken,0);
 }
 
 static void do_ccstub(int n)
 {
   literal_pool(256);
   assem_debug("do_ccstub %x",start+stubs[n][4]*4);
-  set_jump_target(stubs[n][1],(int)out);
+  set_jump_target(stubs[n][1],(intptr_t)out);
   int i=stubs[n][4];
   if(stubs[n][6]==NULLDS) {
     // Delay slot instruction is nullified ("likely" branch)
@@ -4693,7 +4737,7 @@ static void do_ccstub(int n)
   {
     // Save PC as return address
     emit_movimm(stubs[n][5],EAX);
-    emit_writeword(EAX,(int)&pcaddr);
+    emit_writeword(EAX,(intptr_t)&pcaddr);
   }
   else
   {
@@ -4731,7 +4775,7 @@ static void do_ccstub(int n)
           emit_loadreg(rs2[i],s2l);
       #endif
       int hr=0;
-      int addr,alt,ntaddr;
+      int addr=-1,alt=-1,ntaddr=-1;
       while(hr<HOST_REGS)
       {
         if(hr!=EXCLUDE_REG && hr!=HOST_CCREG &&
@@ -4874,7 +4918,7 @@ static void do_ccstub(int n)
           emit_cmovne_reg(alt,addr);
         }
       }
-      emit_writeword(addr,(int)&pcaddr);
+      emit_writeword(addr,(intptr_t)&pcaddr);
     }
     else
     if(itype[i]==RJUMP)
@@ -4883,21 +4927,21 @@ static void do_ccstub(int n)
       if(rs1[i]==rt1[i+1]||rs1[i]==rt2[i+1]) {
         r=get_reg(branch_regs[i].regmap,RTEMP);
       }
-      emit_writeword(r,(int)&pcaddr);
+      emit_writeword(r,(intptr_t)&pcaddr);
     }
     else {DebugMessage(M64MSG_ERROR, "Unknown branch type in do_ccstub");exit(1);}
   }
   // Update cycle count
   assert(branch_regs[i].regmap[HOST_CCREG]==CCREG||branch_regs[i].regmap[HOST_CCREG]==-1);
   if(stubs[n][3]) emit_addimm(HOST_CCREG,CLOCK_DIVIDER*stubs[n][3],HOST_CCREG);
-  emit_call((int)cc_interrupt);
+  emit_call((intptr_t)cc_interrupt);
   if(stubs[n][3]) emit_addimm(HOST_CCREG,-CLOCK_DIVIDER*stubs[n][3],HOST_CCREG);
   if(stubs[n][6]==TAKEN) {
     if(internal_branch(branch_regs[i].is32,ba[i]))
       load_needed_regs(branch_regs[i].regmap,regs[(ba[i]-start)>>2].regmap_entry);
     else if(itype[i]==RJUMP) {
       if(get_reg(branch_regs[i].regmap,RTEMP)>=0)
-        emit_readword((int)&pcaddr,get_reg(branch_regs[i].regmap,RTEMP));
+        emit_readword((intptr_t)&pcaddr,get_reg(branch_regs[i].regmap,RTEMP));
       else
         emit_loadreg(rs1[i],get_reg(branch_regs[i].regmap,rs1[i]));
     }
@@ -4914,35 +4958,35 @@ static void do_ccstub(int n)
   emit_jmp(stubs[n][2]); // return address
   
   /* This works but uses a lot of memory...
-  emit_readword((int)&last_count,ECX);
+  emit_readword((intptr_t)&last_count,ECX);
   emit_add(HOST_CCREG,ECX,EAX);
-  emit_writeword(EAX,(int)&g_cp0_regs[CP0_COUNT_REG]);
-  emit_call((int)gen_interupt);
-  emit_readword((int)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
-  emit_readword((int)&next_interupt,EAX);
-  emit_readword((int)&pending_exception,EBX);
-  emit_writeword(EAX,(int)&last_count);
+  emit_writeword(EAX,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+  emit_call((intptr_t)gen_interupt);
+  emit_readword((intptr_t)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
+  emit_readword((intptr_t)&next_interupt,EAX);
+  emit_readword((intptr_t)&pending_exception,EBX);
+  emit_writeword(EAX,(intptr_t)&last_count);
   emit_sub(HOST_CCREG,EAX,HOST_CCREG);
   emit_test(EBX,EBX);
-  int jne_instr=(int)out;
+  intptr_t jne_instr=(intptr_t)out;
   emit_jne(0);
   if(stubs[n][3]) emit_addimm(HOST_CCREG,-2*stubs[n][3],HOST_CCREG);
   load_all_regs(branch_regs[i].regmap);
   emit_jmp(stubs[n][2]); // return address
-  set_jump_target(jne_instr,(int)out);
-  emit_readword((int)&pcaddr,EAX);
+  set_jump_target(jne_instr,(intptr_t)out);
+  emit_readword((intptr_t)&pcaddr,EAX);
   // Call get_addr_ht instead of doing the hash table here.
   // This code is executed infrequently and takes up a lot of space
   // so smaller is better.
   emit_storereg(CCREG,HOST_CCREG);
   emit_pushreg(EAX);
-  emit_call((int)get_addr_ht);
+  emit_call((intptr_t)get_addr_ht);
   emit_loadreg(CCREG,HOST_CCREG);
   emit_addimm(ESP,4,ESP);
   emit_jmpreg(EAX);*/
 }
 
-static void add_to_linker(int addr,int target,int ext)
+static void add_to_linker(intptr_t addr,u_int target,int ext)
 {
   link_addr[linkcount][0]=addr;
   link_addr[linkcount][1]=target;
@@ -4963,7 +5007,7 @@ static void ujump_assemble(int i,struct regstat *i_regs)
   {
     int return_address=start+i*4+8;
     if(get_reg(branch_regs[i].regmap,31)>0) 
-    if(i_regmap[temp]==PTEMP) emit_movimm((int)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
+    if(i_regmap[temp]==PTEMP) emit_movimm((intptr_t)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
   }
   #endif
   ds_assemble(i+1,i_regs);
@@ -5004,7 +5048,7 @@ static void ujump_assemble(int i,struct regstat *i_regs)
         #ifdef REG_PREFETCH
         if(temp>=0) 
         {
-          if(i_regmap[temp]!=PTEMP) emit_movimm((int)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
+          if(i_regmap[temp]!=PTEMP) emit_movimm((intptr_t)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
         }
         #endif
         emit_movimm(return_address,rt); // PC into link register
@@ -5032,7 +5076,7 @@ static void ujump_assemble(int i,struct regstat *i_regs)
     ds_assemble_entry(i);
   }
   else {
-    add_to_linker((int)out,ba[i],internal_branch(branch_regs[i].is32,ba[i]));
+    add_to_linker((intptr_t)out,ba[i],internal_branch(branch_regs[i].is32,ba[i]));
     emit_jmp(0);
   }
 }
@@ -5060,7 +5104,7 @@ static void rjump_assemble(int i,struct regstat *i_regs)
   {
     if((temp=get_reg(branch_regs[i].regmap,PTEMP))>=0) {
       int return_address=start+i*4+8;
-      if(i_regmap[temp]==PTEMP) emit_movimm((int)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
+      if(i_regmap[temp]==PTEMP) emit_movimm((intptr_t)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
     }
   }
   #endif
@@ -5090,7 +5134,7 @@ static void rjump_assemble(int i,struct regstat *i_regs)
     #ifdef REG_PREFETCH
     if(temp>=0) 
     {
-      if(i_regmap[temp]!=PTEMP) emit_movimm((int)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
+      if(i_regmap[temp]!=PTEMP) emit_movimm((intptr_t)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
     }
     #endif
     emit_movimm(return_address,rt); // PC into link register
@@ -5129,7 +5173,7 @@ static void rjump_assemble(int i,struct regstat *i_regs)
   //if(adj) emit_addimm(cc,2*(ccadj[i]+2-adj),cc); // ??? - Shouldn't happen
   //assert(adj==0);
   emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),HOST_CCREG);
-  add_stub(CC_STUB,(int)out,jump_vaddr_reg[rs],0,i,-1,TAKEN,0);
+  add_stub(CC_STUB,(intptr_t)out,jump_vaddr_reg[rs],0,i,-1,TAKEN,0);
   emit_jns(0);
   //load_regs_bt(branch_regs[i].regmap,branch_regs[i].is32,branch_regs[i].dirty,-1);
   #ifdef USE_MINI_HT
@@ -5140,7 +5184,7 @@ static void rjump_assemble(int i,struct regstat *i_regs)
   #endif
   {
     //if(rs!=EAX) emit_mov(rs,EAX);
-    //emit_jmp((int)jump_vaddr_eax);
+    //emit_jmp((intptr_t)jump_vaddr_eax);
     emit_jmp(jump_vaddr_reg[rs]);
   }
   /* Check hash table
@@ -5150,32 +5194,32 @@ static void rjump_assemble(int i,struct regstat *i_regs)
   emit_xor(temp,rs,rs);
   emit_movzwl_reg(rs,rs);
   emit_shlimm(rs,4,rs);
-  emit_cmpmem_indexed((int)hash_table,rs,temp);
-  emit_jne((int)out+14);
-  emit_readword_indexed((int)hash_table+4,rs,rs);
+  emit_cmpmem_indexed((intptr_t)hash_table,rs,temp);
+  emit_jne((intptr_t)out+14);
+  emit_readword_indexed((intptr_t)hash_table+4,rs,rs);
   emit_jmpreg(rs);
-  emit_cmpmem_indexed((int)hash_table+8,rs,temp);
+  emit_cmpmem_indexed((intptr_t)hash_table+8,rs,temp);
   emit_addimm_no_flags(8,rs);
-  emit_jeq((int)out-17);
+  emit_jeq((intptr_t)out-17);
   // No hit on hash table, call compiler
   emit_pushreg(temp);
 //DEBUG >
 #ifdef DEBUG_CYCLE_COUNT
-  emit_readword((int)&last_count,ECX);
+  emit_readword((intptr_t)&last_count,ECX);
   emit_add(HOST_CCREG,ECX,HOST_CCREG);
-  emit_readword((int)&next_interupt,ECX);
-  emit_writeword(HOST_CCREG,(int)&g_cp0_regs[CP0_COUNT_REG]);
+  emit_readword((intptr_t)&next_interupt,ECX);
+  emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
   emit_sub(HOST_CCREG,ECX,HOST_CCREG);
-  emit_writeword(ECX,(int)&last_count);
+  emit_writeword(ECX,(intptr_t)&last_count);
 #endif
 //DEBUG <
   emit_storereg(CCREG,HOST_CCREG);
-  emit_call((int)get_addr);
+  emit_call((intptr_t)get_addr);
   emit_loadreg(CCREG,HOST_CCREG);
   emit_addimm(ESP,4,ESP);
   emit_jmpreg(EAX);*/
   #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
-  if(rt1[i]!=31&&i<slen-2&&(((u_int)out)&7)) emit_mov(13,13);
+  if(rt1[i]!=31&&i<slen-2&&(((intptr_t)out)&7)) emit_mov(13,13);
   #endif
 }
 
@@ -5269,22 +5313,22 @@ static void cjump_assemble(int i,struct regstat *i_regs)
           ds_assemble_entry(i);
         }
         else {
-          add_to_linker((int)out,ba[i],internal);
+          add_to_linker((intptr_t)out,ba[i],internal);
           emit_jmp(0);
         }
         #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
-        if(((u_int)out)&7) emit_addnop(0);
+        if(((intptr_t)out)&7) emit_addnop(0);
         #endif
       }
     }
     else if(nop) {
       emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),cc);
-      int jaddr=(int)out;
+      intptr_t jaddr=(intptr_t)out;
       emit_jns(0);
-      add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,NOTTAKEN,0);
+      add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,NOTTAKEN,0);
     }
     else {
-      int taken=0,nottaken=0,nottaken1=0;
+      intptr_t taken=0,nottaken=0,nottaken1=0;
       do_cc(i,branch_regs[i].regmap,&adj,-1,0,invert);
       if(adj&&!invert) emit_addimm(cc,CLOCK_DIVIDER*(ccadj[i]+2-adj),cc);
       if(!only32)
@@ -5294,33 +5338,33 @@ static void cjump_assemble(int i,struct regstat *i_regs)
         {
           if(s2h>=0) emit_cmp(s1h,s2h);
           else emit_test(s1h,s1h);
-          nottaken1=(int)out;
+          nottaken1=(intptr_t)out;
           emit_jne(1);
         }
         if(opcode[i]==5) // BNE
         {
           if(s2h>=0) emit_cmp(s1h,s2h);
           else emit_test(s1h,s1h);
-          if(invert) taken=(int)out;
-          else add_to_linker((int)out,ba[i],internal);
+          if(invert) taken=(intptr_t)out;
+          else add_to_linker((intptr_t)out,ba[i],internal);
           emit_jne(0);
         }
         if(opcode[i]==6) // BLEZ
         {
           emit_test(s1h,s1h);
-          if(invert) taken=(int)out;
-          else add_to_linker((int)out,ba[i],internal);
+          if(invert) taken=(intptr_t)out;
+          else add_to_linker((intptr_t)out,ba[i],internal);
           emit_js(0);
-          nottaken1=(int)out;
+          nottaken1=(intptr_t)out;
           emit_jne(1);
         }
         if(opcode[i]==7) // BGTZ
         {
           emit_test(s1h,s1h);
-          nottaken1=(int)out;
+          nottaken1=(intptr_t)out;
           emit_js(1);
-          if(invert) taken=(int)out;
-          else add_to_linker((int)out,ba[i],internal);
+          if(invert) taken=(intptr_t)out;
+          else add_to_linker((intptr_t)out,ba[i],internal);
           emit_jne(0);
         }
       } // if(!only32)
@@ -5332,10 +5376,10 @@ static void cjump_assemble(int i,struct regstat *i_regs)
         if(s2l>=0) emit_cmp(s1l,s2l);
         else emit_test(s1l,s1l);
         if(invert){
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_jne(1);
         }else{
-          add_to_linker((int)out,ba[i],internal);
+          add_to_linker((intptr_t)out,ba[i],internal);
           emit_jeq(0);
         }
       }
@@ -5344,10 +5388,10 @@ static void cjump_assemble(int i,struct regstat *i_regs)
         if(s2l>=0) emit_cmp(s1l,s2l);
         else emit_test(s1l,s1l);
         if(invert){
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_jeq(1);
         }else{
-          add_to_linker((int)out,ba[i],internal);
+          add_to_linker((intptr_t)out,ba[i],internal);
           emit_jne(0);
         }
       }
@@ -5355,11 +5399,11 @@ static void cjump_assemble(int i,struct regstat *i_regs)
       {
         emit_cmpimm(s1l,1);
         if(invert){
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           if(only32) emit_jge(1);
           else emit_jae(1);
         }else{
-          add_to_linker((int)out,ba[i],internal);
+          add_to_linker((intptr_t)out,ba[i],internal);
           if(only32) emit_jl(0);
           else emit_jb(0); 
         }
@@ -5368,25 +5412,25 @@ static void cjump_assemble(int i,struct regstat *i_regs)
       {
         emit_cmpimm(s1l,1);
         if(invert){
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           if(only32) emit_jl(1);
           else emit_jb(1);
         }else{
-          add_to_linker((int)out,ba[i],internal);
+          add_to_linker((intptr_t)out,ba[i],internal);
           if(only32) emit_jge(0);
           else emit_jae(0);
         }
       }
       if(invert) {
-        if(taken) set_jump_target(taken,(int)out);
+        if(taken) set_jump_target(taken,(intptr_t)out);
         #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
         if(match&&(!internal||!is_ds[(ba[i]-start)>>2])) {
           if(adj) {
             emit_addimm(cc,-CLOCK_DIVIDER*adj,cc);
-            add_to_linker((int)out,ba[i],internal);
+            add_to_linker((intptr_t)out,ba[i],internal);
           }else{
             emit_addnop(13);
-            add_to_linker((int)out,ba[i],internal*2);
+            add_to_linker((intptr_t)out,ba[i],internal*2);
           }
           emit_jmp(0);
         }else
@@ -5403,14 +5447,14 @@ static void cjump_assemble(int i,struct regstat *i_regs)
             ds_assemble_entry(i);
           }
           else {
-            add_to_linker((int)out,ba[i],internal);
+            add_to_linker((intptr_t)out,ba[i],internal);
             emit_jmp(0);
           }
         }
-        set_jump_target(nottaken,(int)out);
+        set_jump_target(nottaken,(intptr_t)out);
       }
 
-      if(nottaken1) set_jump_target(nottaken1,(int)out);
+      if(nottaken1) set_jump_target(nottaken1,(intptr_t)out);
       if(adj) {
         if(!invert) emit_addimm(cc,CLOCK_DIVIDER*adj,cc);
       }
@@ -5422,7 +5466,7 @@ static void cjump_assemble(int i,struct regstat *i_regs)
     //if(likely[i]) DebugMessage(M64MSG_VERBOSE, "IOL");
     //else
     //DebugMessage(M64MSG_VERBOSE, "IOE");
-    int taken=0,nottaken=0,nottaken1=0;
+    intptr_t taken=0,nottaken=0,nottaken1=0;
     if(!unconditional&&!nop) {
       if(!only32)
       {
@@ -5431,30 +5475,30 @@ static void cjump_assemble(int i,struct regstat *i_regs)
         {
           if(s2h>=0) emit_cmp(s1h,s2h);
           else emit_test(s1h,s1h);
-          nottaken1=(int)out;
+          nottaken1=(intptr_t)out;
           emit_jne(2);
         }
         if((opcode[i]&0x2f)==5) // BNE
         {
           if(s2h>=0) emit_cmp(s1h,s2h);
           else emit_test(s1h,s1h);
-          taken=(int)out;
+          taken=(intptr_t)out;
           emit_jne(1);
         }
         if((opcode[i]&0x2f)==6) // BLEZ
         {
           emit_test(s1h,s1h);
-          taken=(int)out;
+          taken=(intptr_t)out;
           emit_js(1);
-          nottaken1=(int)out;
+          nottaken1=(intptr_t)out;
           emit_jne(2);
         }
         if((opcode[i]&0x2f)==7) // BGTZ
         {
           emit_test(s1h,s1h);
-          nottaken1=(int)out;
+          nottaken1=(intptr_t)out;
           emit_js(2);
-          taken=(int)out;
+          taken=(intptr_t)out;
           emit_jne(1);
         }
       } // if(!only32)
@@ -5465,27 +5509,27 @@ static void cjump_assemble(int i,struct regstat *i_regs)
       {
         if(s2l>=0) emit_cmp(s1l,s2l);
         else emit_test(s1l,s1l);
-        nottaken=(int)out;
+        nottaken=(intptr_t)out;
         emit_jne(2);
       }
       if((opcode[i]&0x2f)==5) // BNE
       {
         if(s2l>=0) emit_cmp(s1l,s2l);
         else emit_test(s1l,s1l);
-        nottaken=(int)out;
+        nottaken=(intptr_t)out;
         emit_jeq(2);
       }
       if((opcode[i]&0x2f)==6) // BLEZ
       {
         emit_cmpimm(s1l,1);
-        nottaken=(int)out;
+        nottaken=(intptr_t)out;
         if(only32) emit_jge(2);
         else emit_jae(2);
       }
       if((opcode[i]&0x2f)==7) // BGTZ
       {
         emit_cmpimm(s1l,1);
-        nottaken=(int)out;
+        nottaken=(intptr_t)out;
         if(only32) emit_jl(2);
         else emit_jb(2);
       }
@@ -5500,7 +5544,7 @@ static void cjump_assemble(int i,struct regstat *i_regs)
     ds_unneeded_upper|=1;
     // branch taken
     if(!nop) {
-      if(taken) set_jump_target(taken,(int)out);
+      if(taken) set_jump_target(taken,(intptr_t)out);
       assem_debug("1:");
       wb_invalidate(regs[i].regmap,branch_regs[i].regmap,regs[i].dirty,regs[i].is32,
                     ds_unneeded,ds_unneeded_upper);
@@ -5528,15 +5572,15 @@ static void cjump_assemble(int i,struct regstat *i_regs)
         ds_assemble_entry(i);
       }
       else {
-        add_to_linker((int)out,ba[i],internal);
+        add_to_linker((intptr_t)out,ba[i],internal);
         emit_jmp(0);
       }
     }
     // branch not taken
     cop1_usable=prev_cop1_usable;
     if(!unconditional) {
-      if(nottaken1) set_jump_target(nottaken1,(int)out);
-      set_jump_target(nottaken,(int)out);
+      if(nottaken1) set_jump_target(nottaken1,(intptr_t)out);
+      set_jump_target(nottaken,(intptr_t)out);
       assem_debug("2:");
       if(!likely[i]) {
         wb_invalidate(regs[i].regmap,branch_regs[i].regmap,regs[i].dirty,regs[i].is32,
@@ -5551,18 +5595,18 @@ static void cjump_assemble(int i,struct regstat *i_regs)
         // Cycle count isn't in a register, temporarily load it then write it out
         emit_loadreg(CCREG,HOST_CCREG);
         emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),HOST_CCREG);
-        int jaddr=(int)out;
+        intptr_t jaddr=(intptr_t)out;
         emit_jns(0);
-        add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,NOTTAKEN,0);
+        add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,NOTTAKEN,0);
         emit_storereg(CCREG,HOST_CCREG);
       }
       else{
         cc=get_reg(i_regmap,CCREG);
         assert(cc==HOST_CCREG);
         emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),cc);
-        int jaddr=(int)out;
+        intptr_t jaddr=(intptr_t)out;
         emit_jns(0);
-        add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,likely[i]?NULLDS:NOTTAKEN,0);
+        add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,likely[i]?NULLDS:NOTTAKEN,0);
       }
     }
   }
@@ -5662,22 +5706,22 @@ static void sjump_assemble(int i,struct regstat *i_regs)
           ds_assemble_entry(i);
         }
         else {
-          add_to_linker((int)out,ba[i],internal);
+          add_to_linker((intptr_t)out,ba[i],internal);
           emit_jmp(0);
         }
         #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
-        if(((u_int)out)&7) emit_addnop(0);
+        if(((intptr_t)out)&7) emit_addnop(0);
         #endif
       }
     }
     else if(nevertaken) {
       emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),cc);
-      int jaddr=(int)out;
+      intptr_t jaddr=(intptr_t)out;
       emit_jns(0);
-      add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,NOTTAKEN,0);
+      add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,NOTTAKEN,0);
     }
     else {
-      int nottaken=0;
+      intptr_t nottaken=0;
       do_cc(i,branch_regs[i].regmap,&adj,-1,0,invert);
       if(adj&&!invert) emit_addimm(cc,CLOCK_DIVIDER*(ccadj[i]+2-adj),cc);
       if(!only32)
@@ -5687,10 +5731,10 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         {
           emit_test(s1h,s1h);
           if(invert){
-            nottaken=(int)out;
+            nottaken=(intptr_t)out;
             emit_jns(1);
           }else{
-            add_to_linker((int)out,ba[i],internal);
+            add_to_linker((intptr_t)out,ba[i],internal);
             emit_js(0);
           }
         }
@@ -5698,10 +5742,10 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         {
           emit_test(s1h,s1h);
           if(invert){
-            nottaken=(int)out;
+            nottaken=(intptr_t)out;
             emit_js(1);
           }else{
-            add_to_linker((int)out,ba[i],internal);
+            add_to_linker((intptr_t)out,ba[i],internal);
             emit_jns(0);
           }
         }
@@ -5713,10 +5757,10 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         {
           emit_test(s1l,s1l);
           if(invert){
-            nottaken=(int)out;
+            nottaken=(intptr_t)out;
             emit_jns(1);
           }else{
-            add_to_linker((int)out,ba[i],internal);
+            add_to_linker((intptr_t)out,ba[i],internal);
             emit_js(0);
           }
         }
@@ -5724,10 +5768,10 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         {
           emit_test(s1l,s1l);
           if(invert){
-            nottaken=(int)out;
+            nottaken=(intptr_t)out;
             emit_js(1);
           }else{
-            add_to_linker((int)out,ba[i],internal);
+            add_to_linker((intptr_t)out,ba[i],internal);
             emit_jns(0);
           }
         }
@@ -5738,10 +5782,10 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         if(match&&(!internal||!is_ds[(ba[i]-start)>>2])) {
           if(adj) {
             emit_addimm(cc,-CLOCK_DIVIDER*adj,cc);
-            add_to_linker((int)out,ba[i],internal);
+            add_to_linker((intptr_t)out,ba[i],internal);
           }else{
             emit_addnop(13);
-            add_to_linker((int)out,ba[i],internal*2);
+            add_to_linker((intptr_t)out,ba[i],internal*2);
           }
           emit_jmp(0);
         }else
@@ -5758,11 +5802,11 @@ static void sjump_assemble(int i,struct regstat *i_regs)
             ds_assemble_entry(i);
           }
           else {
-            add_to_linker((int)out,ba[i],internal);
+            add_to_linker((intptr_t)out,ba[i],internal);
             emit_jmp(0);
           }
         }
-        set_jump_target(nottaken,(int)out);
+        set_jump_target(nottaken,(intptr_t)out);
       }
 
       if(adj) {
@@ -5774,7 +5818,7 @@ static void sjump_assemble(int i,struct regstat *i_regs)
   {
     // In-order execution (branch first)
     //DebugMessage(M64MSG_VERBOSE, "IOE");
-    int nottaken=0;
+    intptr_t nottaken=0;
     if(!unconditional) {
       //DebugMessage(M64MSG_VERBOSE, "branch(%d): eax=%d ecx=%d edx=%d ebx=%d ebp=%d esi=%d edi=%d",i,branch_regs[i].regmap[0],branch_regs[i].regmap[1],branch_regs[i].regmap[2],branch_regs[i].regmap[3],branch_regs[i].regmap[5],branch_regs[i].regmap[6],branch_regs[i].regmap[7]);
       if(!only32)
@@ -5783,13 +5827,13 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         if((opcode2[i]&0x1d)==0) // BLTZ/BLTZL
         {
           emit_test(s1h,s1h);
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_jns(1);
         }
         if((opcode2[i]&0x1d)==1) // BGEZ/BGEZL
         {
           emit_test(s1h,s1h);
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_js(1);
         }
       } // if(!only32)
@@ -5799,13 +5843,13 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         if((opcode2[i]&0x1d)==0) // BLTZ/BLTZL
         {
           emit_test(s1l,s1l);
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_jns(1);
         }
         if((opcode2[i]&0x1d)==1) // BGEZ/BGEZL
         {
           emit_test(s1l,s1l);
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_js(1);
         }
       }
@@ -5847,14 +5891,14 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         ds_assemble_entry(i);
       }
       else {
-        add_to_linker((int)out,ba[i],internal);
+        add_to_linker((intptr_t)out,ba[i],internal);
         emit_jmp(0);
       }
     }
     // branch not taken
     cop1_usable=prev_cop1_usable;
     if(!unconditional) {
-      set_jump_target(nottaken,(int)out);
+      set_jump_target(nottaken,(intptr_t)out);
       assem_debug("1:");
       if(!likely[i]) {
         wb_invalidate(regs[i].regmap,branch_regs[i].regmap,regs[i].dirty,regs[i].is32,
@@ -5869,18 +5913,18 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         // Cycle count isn't in a register, temporarily load it then write it out
         emit_loadreg(CCREG,HOST_CCREG);
         emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),HOST_CCREG);
-        int jaddr=(int)out;
+        intptr_t jaddr=(intptr_t)out;
         emit_jns(0);
-        add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,NOTTAKEN,0);
+        add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,NOTTAKEN,0);
         emit_storereg(CCREG,HOST_CCREG);
       }
       else{
         cc=get_reg(i_regmap,CCREG);
         assert(cc==HOST_CCREG);
         emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),cc);
-        int jaddr=(int)out;
+        intptr_t jaddr=(intptr_t)out;
         emit_jns(0);
-        add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,likely[i]?NULLDS:NOTTAKEN,0);
+        add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,likely[i]?NULLDS:NOTTAKEN,0);
       }
     }
   }
@@ -5894,7 +5938,7 @@ static void fjump_assemble(int i,struct regstat *i_regs)
   match=match_bt(branch_regs[i].regmap,branch_regs[i].is32,branch_regs[i].dirty,ba[i]);
   assem_debug("fmatch=%d",match);
   int fs,cs;
-  int eaddr;
+  intptr_t eaddr;
   int invert=0;
   int internal=internal_branch(branch_regs[i].is32,ba[i]);
   if(i==(ba[i]-start)>>2) assem_debug("idle loop");
@@ -5916,9 +5960,9 @@ static void fjump_assemble(int i,struct regstat *i_regs)
     cs=get_reg(i_regmap,CSREG);
     assert(cs>=0);
     emit_testimm(cs,0x20000000);
-    eaddr=(int)out;
+    eaddr=(intptr_t)out;
     emit_jeq(0);
-    add_stub(FP_STUB,eaddr,(int)out,i,cs,(int)i_regs,0,0);
+    add_stub(FP_STUB,eaddr,(intptr_t)out,i,cs,(intptr_t)i_regs,0,0);
     cop1_usable=1;
   }
 
@@ -5942,7 +5986,7 @@ static void fjump_assemble(int i,struct regstat *i_regs)
     do_cc(i,branch_regs[i].regmap,&adj,-1,0,invert);
     assem_debug("cycle count (adj)");
     if(1) {
-      int nottaken=0;
+      intptr_t nottaken=0;
       if(adj&&!invert) emit_addimm(cc,CLOCK_DIVIDER*(ccadj[i]+2-adj),cc);
       if(1) {
         assert(fs>=0);
@@ -5950,19 +5994,19 @@ static void fjump_assemble(int i,struct regstat *i_regs)
         if(source[i]&0x10000) // BC1T
         {
           if(invert){
-            nottaken=(int)out;
+            nottaken=(intptr_t)out;
             emit_jeq(1);
           }else{
-            add_to_linker((int)out,ba[i],internal);
+            add_to_linker((intptr_t)out,ba[i],internal);
             emit_jne(0);
           }
         }
         else // BC1F
           if(invert){
-            nottaken=(int)out;
+            nottaken=(intptr_t)out;
             emit_jne(1);
           }else{
-            add_to_linker((int)out,ba[i],internal);
+            add_to_linker((intptr_t)out,ba[i],internal);
             emit_jeq(0);
           }
         {
@@ -5984,10 +6028,10 @@ static void fjump_assemble(int i,struct regstat *i_regs)
           ds_assemble_entry(i);
         }
         else {
-          add_to_linker((int)out,ba[i],internal);
+          add_to_linker((intptr_t)out,ba[i],internal);
           emit_jmp(0);
         }
-        set_jump_target(nottaken,(int)out);
+        set_jump_target(nottaken,(intptr_t)out);
       }
 
       if(adj) {
@@ -5999,7 +6043,7 @@ static void fjump_assemble(int i,struct regstat *i_regs)
   {
     // In-order execution (branch first)
     //DebugMessage(M64MSG_VERBOSE, "IOE");
-    int nottaken=0;
+    intptr_t nottaken=0;
     if(1) {
       //DebugMessage(M64MSG_VERBOSE, "branch(%d): eax=%d ecx=%d edx=%d ebx=%d ebp=%d esi=%d edi=%d",i,branch_regs[i].regmap[0],branch_regs[i].regmap[1],branch_regs[i].regmap[2],branch_regs[i].regmap[3],branch_regs[i].regmap[5],branch_regs[i].regmap[6],branch_regs[i].regmap[7]);
       if(1) {
@@ -6007,12 +6051,12 @@ static void fjump_assemble(int i,struct regstat *i_regs)
         emit_testimm(fs,0x800000);
         if(source[i]&0x10000) // BC1T
         {
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_jeq(1);
         }
         else // BC1F
         {
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_jne(1);
         }
       }
@@ -6053,13 +6097,13 @@ static void fjump_assemble(int i,struct regstat *i_regs)
       ds_assemble_entry(i);
     }
     else {
-      add_to_linker((int)out,ba[i],internal);
+      add_to_linker((intptr_t)out,ba[i],internal);
       emit_jmp(0);
     }
 
     // branch not taken
     if(1) { // <- FIXME (don't need this)
-      set_jump_target(nottaken,(int)out);
+      set_jump_target(nottaken,(intptr_t)out);
       assem_debug("1:");
       if(!likely[i]) {
         wb_invalidate(regs[i].regmap,branch_regs[i].regmap,regs[i].dirty,regs[i].is32,
@@ -6074,18 +6118,18 @@ static void fjump_assemble(int i,struct regstat *i_regs)
         // Cycle count isn't in a register, temporarily load it then write it out
         emit_loadreg(CCREG,HOST_CCREG);
         emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),HOST_CCREG);
-        int jaddr=(int)out;
+        intptr_t jaddr=(intptr_t)out;
         emit_jns(0);
-        add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,NOTTAKEN,0);
+        add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,NOTTAKEN,0);
         emit_storereg(CCREG,HOST_CCREG);
       }
       else{
         cc=get_reg(i_regmap,CCREG);
         assert(cc==HOST_CCREG);
         emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),cc);
-        int jaddr=(int)out;
+        intptr_t jaddr=(intptr_t)out;
         emit_jns(0);
-        add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,likely[i]?NULLDS:NOTTAKEN,0);
+        add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,likely[i]?NULLDS:NOTTAKEN,0);
       }
     }
   }
@@ -6097,8 +6141,8 @@ static void pagespan_assemble(int i,struct regstat *i_regs)
   int s1h=get_reg(i_regs->regmap,rs1[i]|64);
   int s2l=get_reg(i_regs->regmap,rs2[i]);
   int s2h=get_reg(i_regs->regmap,rs2[i]|64);
-  int taken=0;
-  int nottaken=0;
+  intptr_t taken=0;
+  intptr_t nottaken=0;
   int unconditional=0;
   if(rs1[i]==0)
   {
@@ -6113,7 +6157,7 @@ static void pagespan_assemble(int i,struct regstat *i_regs)
     s1h=s2h=-1;
   }
   int hr=0;
-  int addr,alt,ntaddr;
+  int addr=-1,alt=-1,ntaddr=-1;
   if(i_regs->regmap[HOST_BTREG]<0) {addr=HOST_BTREG;}
   else {
     while(hr<HOST_REGS)
@@ -6231,13 +6275,13 @@ static void pagespan_assemble(int i,struct regstat *i_regs)
     if(s1h>=0) {
       if(s2h>=0) emit_cmp(s1h,s2h);
       else emit_test(s1h,s1h);
-      nottaken=(int)out;
+      nottaken=(intptr_t)out;
       emit_jne(0);
     }
     if(s2l>=0) emit_cmp(s1l,s2l);
     else emit_test(s1l,s1l);
-    if(nottaken) set_jump_target(nottaken,(int)out);
-    nottaken=(int)out;
+    if(nottaken) set_jump_target(nottaken,(intptr_t)out);
+    nottaken=(intptr_t)out;
     emit_jne(0);
   }
   if((opcode[i]&0x3f)==0x15) // BNEL
@@ -6245,14 +6289,14 @@ static void pagespan_assemble(int i,struct regstat *i_regs)
     if(s1h>=0) {
       if(s2h>=0) emit_cmp(s1h,s2h);
       else emit_test(s1h,s1h);
-      taken=(int)out;
+      taken=(intptr_t)out;
       emit_jne(0);
     }
     if(s2l>=0) emit_cmp(s1l,s2l);
     else emit_test(s1l,s1l);
-    nottaken=(int)out;
+    nottaken=(intptr_t)out;
     emit_jeq(0);
-    if(taken) set_jump_target(taken,(int)out);
+    if(taken) set_jump_target(taken,(intptr_t)out);
   }
   if((opcode[i]&0x3f)==6) // BLEZ
   {
@@ -6305,13 +6349,13 @@ static void pagespan_assemble(int i,struct regstat *i_regs)
     if((source[i]&0x30000)==0x20000) // BC1FL
     {
       emit_testimm(s1l,0x800000);
-      nottaken=(int)out;
+      nottaken=(intptr_t)out;
       emit_jne(0);
     }
     if((source[i]&0x30000)==0x30000) // BC1TL
     {
       emit_testimm(s1l,0x800000);
-      nottaken=(int)out;
+      nottaken=(intptr_t)out;
       emit_jeq(0);
     }
   }
@@ -6331,27 +6375,27 @@ static void pagespan_assemble(int i,struct regstat *i_regs)
   int target_addr=start+i*4+5;
   void *stub=out;
   void *compiled_target_addr=check_addr(target_addr);
-  emit_extjump_ds((int)branch_addr,target_addr);
+  emit_extjump_ds((intptr_t)branch_addr,target_addr);
   if(compiled_target_addr) {
-    set_jump_target((int)branch_addr,(int)compiled_target_addr);
+    set_jump_target((intptr_t)branch_addr,(intptr_t)compiled_target_addr);
     add_link(target_addr,stub);
   }
-  else set_jump_target((int)branch_addr,(int)stub);
+  else set_jump_target((intptr_t)branch_addr,(intptr_t)stub);
   if(likely[i]) {
     // Not-taken path
-    set_jump_target((int)nottaken,(int)out);
+    set_jump_target((intptr_t)nottaken,(intptr_t)out);
     wb_dirtys(regs[i].regmap,regs[i].is32,regs[i].dirty);
     void *branch_addr=out;
     emit_jmp(0);
     int target_addr=start+i*4+8;
     void *stub=out;
     void *compiled_target_addr=check_addr(target_addr);
-    emit_extjump_ds((int)branch_addr,target_addr);
+    emit_extjump_ds((intptr_t)branch_addr,target_addr);
     if(compiled_target_addr) {
-      set_jump_target((int)branch_addr,(int)compiled_target_addr);
+      set_jump_target((intptr_t)branch_addr,(intptr_t)compiled_target_addr);
       add_link(target_addr,stub);
     }
-    else set_jump_target((int)branch_addr,(int)stub);
+    else set_jump_target((intptr_t)branch_addr,(intptr_t)stub);
   }
 }
 
@@ -6362,9 +6406,9 @@ static void pagespan_ds()
   u_int vaddr=start+1;
   u_int page=(0x80000000^vaddr)>>12;
   u_int vpage=page;
-  if(page>262143&&tlb_LUT_r[vaddr>>12]) page=(tlb_LUT_r[page^0x80000]^0x80000000)>>12;
+  if(page>262143&&tlb_LUT_r(vaddr>>12)) page=(tlb_LUT_r(page^0x80000)^0x80000000)>>12;
   if(page>2048) page=2048+(page&2047);
-  if(vpage>262143&&tlb_LUT_r[vaddr>>12]) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
+  if(vpage>262143&&tlb_LUT_r(vaddr>>12)) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
   if(vpage>2048) vpage=2048+(vpage&2047);
   ll_add(jump_dirty+vpage,vaddr,(void *)out);
   do_dirty_stub_ds();
@@ -6373,7 +6417,7 @@ static void pagespan_ds()
   if(regs[0].regmap[HOST_CCREG]!=CCREG)
     wb_register(CCREG,regs[0].regmap_entry,regs[0].wasdirty,regs[0].was32);
   if(regs[0].regmap[HOST_BTREG]!=BTREG)
-    emit_writeword(HOST_BTREG,(int)&branch_target);
+    emit_writeword(HOST_BTREG,(intptr_t)&branch_target);
   load_regs(regs[0].regmap_entry,regs[0].regmap,regs[0].was32,rs1[0],rs2[0]);
   address_generation(0,&regs[0],regs[0].regmap_entry);
   if(itype[0]==LOAD||itype[0]==LOADLR||itype[0]==STORE||itype[0]==STORELR||itype[0]==C1LS)
@@ -6427,7 +6471,7 @@ static void pagespan_ds()
   int btaddr=get_reg(regs[0].regmap,BTREG);
   if(btaddr<0) {
     btaddr=get_reg(regs[0].regmap,-1);
-    emit_readword((int)&branch_target,btaddr);
+    emit_readword((intptr_t)&branch_target,btaddr);
   }
   assert(btaddr!=HOST_CCREG);
   if(regs[0].regmap[HOST_CCREG]!=CCREG) emit_loadreg(CCREG,HOST_CCREG);
@@ -6437,11 +6481,11 @@ static void pagespan_ds()
 #else
   emit_cmpimm(btaddr,start+4);
 #endif
-  int branch=(int)out;
+  intptr_t branch=(intptr_t)out;
   emit_jeq(0);
   store_regs_bt(regs[0].regmap,regs[0].is32,regs[0].dirty,-1);
   emit_jmp(jump_vaddr_reg[btaddr]);
-  set_jump_target(branch,(int)out);
+  set_jump_target(branch,(intptr_t)out);
   store_regs_bt(regs[0].regmap,regs[0].is32,regs[0].dirty,start+4);
   load_regs_bt(regs[0].regmap,regs[0].is32,regs[0].dirty,start+4);
 }
@@ -7556,7 +7600,7 @@ void new_dynarec_init()
 {
   DebugMessage(M64MSG_INFO, "Init new dynarec");
 
-#if NEW_DYNAREC == NEW_DYNAREC_ARM
+#ifdef BASE_ADDR
   if ((base_addr = mmap ((u_char *)BASE_ADDR, 1<<TARGET_SIZE_2,
             PROT_READ | PROT_WRITE | PROT_EXEC,
             MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS,
@@ -7569,7 +7613,7 @@ void new_dynarec_init()
 #endif
   out=(u_char *)base_addr;
 
-  rdword=&readmem_dword;
+  rdword=(unsigned long long *)&readmem_dword;
   fake_pc.f.r.rs=(long long int *)&readmem_dword;
   fake_pc.f.r.rt=(long long int *)&readmem_dword;
   fake_pc.f.r.rd=(long long int *)&readmem_dword;
@@ -7594,7 +7638,7 @@ void new_dynarec_init()
   for(n=0;n<524288;n++) // 0 .. 0x7FFFFFFF
     memory_map[n]=-1;
   for(n=524288;n<526336;n++) // 0x80000000 .. 0x807FFFFF
-    memory_map[n]=((u_int)rdram-0x80000000)>>2;
+    memory_map[n]=((uintptr_t)rdram-0x80000000)>>2;
   for(n=526336;n<1048576;n++) // 0x80800000 .. 0xFFFFFFFF
     memory_map[n]=-1;
   for(n=0;n<0x8000;n++) { // 0 .. 0x7FFFFFFF
@@ -7613,6 +7657,8 @@ void new_dynarec_init()
     writememh[n] = write_rdramh_new;
     writememd[n] = write_rdramd_new;
   }
+  // RDRAM writes must reach write_rdram_new to invalidate the compiled code
+  fast_memory=0;
   for(n=0xC000;n<0x10000;n++) { // 0xC0000000 .. 0xFFFFFFFF
     writemem[n] = write_nomem_new;
     writememb[n] = write_nomemb_new;
@@ -7650,12 +7696,12 @@ int new_recompile_block(int addr)
   }
 */
   //if(g_cp0_regs[CP0_COUNT_REG]==365117028) tracedebug=1;
-  assem_debug("NOTCOMPILED: addr = %x -> %x", (int)addr, (int)out);
+  assem_debug("NOTCOMPILED: addr = %x -> %x", (int)addr, (intptr_t)out);
 #if defined (COUNT_NOTCOMPILEDS )
   notcompiledCount++;
   log_message( "notcompiledCount=%i", notcompiledCount );
 #endif
-  //DebugMessage(M64MSG_VERBOSE, "NOTCOMPILED: addr = %x -> %x", (int)addr, (int)out);
+  //DebugMessage(M64MSG_VERBOSE, "NOTCOMPILED: addr = %x -> %x", (int)addr, (intptr_t)out);
   //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (compile %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,addr);
   //if(debug) 
   //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (checksum %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,mchecksum());
@@ -7667,25 +7713,25 @@ int new_recompile_block(int addr)
   start = (u_int)addr&~3;
   //assert(((u_int)addr&1)==0);
   if ((int)addr >= 0xa4000000 && (int)addr < 0xa4001000) {
-    source = (u_int *)((u_int)SP_DMEM+start-0xa4000000);
+    source = (u_int *)((uintptr_t)SP_DMEM+start-0xa4000000);
     pagelimit = 0xa4001000;
   }
   else if ((int)addr >= 0x80000000 && (int)addr < 0x80800000) {
-    source = (u_int *)((u_int)rdram+start-0x80000000);
+    source = (u_int *)((uintptr_t)rdram+start-0x80000000);
     pagelimit = 0x80800000;
   }
   else if ((signed int)addr >= (signed int)0xC0000000) {
     //DebugMessage(M64MSG_VERBOSE, "addr=%x mm=%x",(u_int)addr,(memory_map[start>>12]<<2));
-    //if(tlb_LUT_r[start>>12])
-      //source = (u_int *)(((int)rdram)+(tlb_LUT_r[start>>12]&0xFFFFF000)+(((int)addr)&0xFFF)-0x80000000);
-    if((signed int)memory_map[start>>12]>=0) {
-      source = (u_int *)((u_int)(start+(memory_map[start>>12]<<2)));
+    //if(tlb_LUT_r(start>>12))
+      //source = (u_int *)(((int)rdram)+(tlb_LUT_r(start>>12)&0xFFFFF000)+(((int)addr)&0xFFF)-0x80000000);
+    if((intptr_t)memory_map[start>>12]>=0) {
+      source = (u_int *)(start+(memory_map[start>>12]<<2));
       pagelimit=(start+4096)&0xFFFFF000;
-      int map=memory_map[start>>12];
+      uintptr_t map=memory_map[start>>12];
       int i;
       for(i=0;i<5;i++) {
         //DebugMessage(M64MSG_VERBOSE, "start: %x next: %x",map,memory_map[pagelimit>>12]);
-        if((map&0xBFFFFFFF)==(memory_map[pagelimit>>12]&0xBFFFFFFF)) pagelimit+=4096;
+        if((map&~WRITE_PROTECT)==(memory_map[pagelimit>>12]&~WRITE_PROTECT)) pagelimit+=4096;
       }
       assem_debug("pagelimit=%x",pagelimit);
       assem_debug("mapping=%x (%x)",memory_map[start>>12],(memory_map[start>>12]<<2)+start);
@@ -8165,6 +8211,7 @@ int new_recompile_block(int addr)
         rt2[i]=0;
         if(op2<3) rt1[i]=(source[i]>>16)&0x1F; // MFC1/DMFC1/CFC1
         if(op2>3) rs1[i]=(source[i]>>16)&0x1F; // MTC1/DMTC1/CTC1
+        if(op2==2&&((source[i]>>11)&0x1f)==31) rs1[i]=FSREG; // CFC1 FCR31
         if(op2==5) us1[i]=rs1[i]; // DMTC1
         rs2[i]=CSREG;
         break;
@@ -8601,8 +8648,9 @@ int new_recompile_block(int addr)
               if(rs2[i]) alloc_reg64(&current,i,rs2[i]);
             }
             if((rs1[i]&&(rs1[i]==rt1[i+1]||rs1[i]==rt2[i+1]))||
-               (rs2[i]&&(rs2[i]==rt1[i+1]||rs2[i]==rt2[i+1]))) {
-              // The delay slot overwrites one of our conditions.
+               (rs2[i]&&(rs2[i]==rt1[i+1]||rs2[i]==rt2[i+1]))||is_idle_loop(i)) {
+              // The delay slot overwrites one of our conditions,
+              // or the taken path must skip the cycles of an idle loop.
               // Allocate the branch condition registers instead.
               current.isconst=0;
               current.wasconst=0;
@@ -8631,8 +8679,9 @@ int new_recompile_block(int addr)
             {
               alloc_reg64(&current,i,rs1[i]);
             }
-            if(rs1[i]&&(rs1[i]==rt1[i+1]||rs1[i]==rt2[i+1])) {
-              // The delay slot overwrites one of our conditions.
+            if((rs1[i]&&(rs1[i]==rt1[i+1]||rs1[i]==rt2[i+1]))||is_idle_loop(i)) {
+              // The delay slot overwrites one of our conditions,
+              // or the taken path must skip the cycles of an idle loop.
               // Allocate the branch condition registers instead.
               current.isconst=0;
               current.wasconst=0;
@@ -8708,8 +8757,9 @@ int new_recompile_block(int addr)
               //#endif
               //current.is32|=1LL<<rt1[i];
             }
-            if(rs1[i]&&(rs1[i]==rt1[i+1]||rs1[i]==rt2[i+1])) {
-              // The delay slot overwrites the branch condition.
+            if((rs1[i]&&(rs1[i]==rt1[i+1]||rs1[i]==rt2[i+1]))||is_idle_loop(i)) {
+              // The delay slot overwrites the branch condition,
+              // or the taken path must skip the cycles of an idle loop.
               // Allocate the branch condition registers instead.
               current.isconst=0;
               current.wasconst=0;
@@ -8759,8 +8809,9 @@ int new_recompile_block(int addr)
             dirty_reg(&current,CCREG);
             alloc_reg(&current,i,FSREG);
             alloc_reg(&current,i,CSREG);
-            if(itype[i+1]==FCOMP) {
-              // The delay slot overwrites the branch condition.
+            if(itype[i+1]==FCOMP||is_idle_loop(i)) {
+              // The delay slot overwrites the branch condition,
+              // or the taken path must skip the cycles of an idle loop.
               // Allocate the branch condition registers instead.
               alloc_cc(&current,i);
               dirty_reg(&current,CCREG);
@@ -9260,9 +9311,6 @@ int new_recompile_block(int addr)
           }
         }
       }
-      // Don't need stuff which is overwritten
-      if(regs[i].regmap[hr]!=regmap_pre[i][hr]) nr&=~(1<<hr);
-      if(regs[i].regmap[hr]<0) nr&=~(1<<hr);
       // Merge in delay slot
       for(hr=0;hr<HOST_REGS;hr++)
       {
@@ -10558,7 +10606,7 @@ int new_recompile_block(int addr)
   uint64_t is32_pre=0;
   u_int dirty_pre=0;
   #endif
-  u_int beginning=(u_int)out;
+  intptr_t beginning=(intptr_t)out;
   if((u_int)addr&1) {
     ds=1;
     pagespan_ds();
@@ -10594,7 +10642,7 @@ int new_recompile_block(int addr)
         loop_preload(regmap_pre[i],regs[i].regmap_entry);
       }
       // branch target entry point
-      instr_addr[i]=(u_int)out;
+      instr_addr[i]=(intptr_t)out;
       assem_debug("<->");
       // load regs
       if(regs[i].regmap_entry[HOST_CCREG]==CCREG&&regs[i].regmap[HOST_CCREG]!=CCREG)
@@ -10708,7 +10756,7 @@ int new_recompile_block(int addr)
         store_regs_bt(regs[i-2].regmap,regs[i-2].is32,regs[i-2].dirty,start+i*4);
         assert(regs[i-2].regmap[HOST_CCREG]==CCREG);
       }
-      add_to_linker((int)out,start+i*4,0);
+      add_to_linker((intptr_t)out,start+i*4,0);
       emit_jmp(0);
     }
   }
@@ -10720,7 +10768,7 @@ int new_recompile_block(int addr)
     if(regs[i-1].regmap[HOST_CCREG]!=CCREG)
       emit_loadreg(CCREG,HOST_CCREG);
     emit_addimm(HOST_CCREG,CLOCK_DIVIDER*(ccadj[i-1]+1),HOST_CCREG);
-    add_to_linker((int)out,start+i*4,0);
+    add_to_linker((intptr_t)out,start+i*4,0);
     emit_jmp(0);
   }
 
@@ -10764,10 +10812,10 @@ int new_recompile_block(int addr)
       void *addr=check_addr(link_addr[i][1]);
       emit_extjump(link_addr[i][0],link_addr[i][1]);
       if(addr) {
-        set_jump_target(link_addr[i][0],(int)addr);
+        set_jump_target(link_addr[i][0],(intptr_t)addr);
         add_link(link_addr[i][1],stub);
       }
-      else set_jump_target(link_addr[i][0],(int)stub);
+      else set_jump_target(link_addr[i][0],(intptr_t)stub);
     }
     else
     {
@@ -10793,9 +10841,9 @@ int new_recompile_block(int addr)
         u_int vaddr=start+i*4;
         u_int page=(0x80000000^vaddr)>>12;
         u_int vpage=page;
-        if(page>262143&&tlb_LUT_r[vaddr>>12]) page=(tlb_LUT_r[page^0x80000]^0x80000000)>>12;
+        if(page>262143&&tlb_LUT_r(vaddr>>12)) page=(tlb_LUT_r(page^0x80000)^0x80000000)>>12;
         if(page>2048) page=2048+(page&2047);
-        if(vpage>262143&&tlb_LUT_r[vaddr>>12]) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
+        if(vpage>262143&&tlb_LUT_r(vaddr>>12)) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
         if(vpage>2048) vpage=2048+(vpage&2047);
         literal_pool(256);
         //if(!(is32[i]&(~unneeded_reg_upper[i])&~(1LL<<CCREG)))
@@ -10804,13 +10852,13 @@ int new_recompile_block(int addr)
           assem_debug("%8x (%d) <- %8x",instr_addr[i],i,start+i*4);
           assem_debug("jump_in: %x",start+i*4);
           ll_add(jump_dirty+vpage,vaddr,(void *)out);
-          int entry_point=do_dirty_stub(i);
+          intptr_t entry_point=do_dirty_stub(i);
           ll_add(jump_in+page,vaddr,(void *)entry_point);
           // If there was an existing entry in the hash table,
           // replace it with the new address.
           // Don't add new entries.  We'll insert the
           // ones that actually get used in check_addr().
-          u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+          uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
           if(ht_bin[0]==vaddr) {
             ht_bin[1]=entry_point;
           }
@@ -10823,16 +10871,16 @@ int new_recompile_block(int addr)
           u_int r=requires_32bit[i]|!!(requires_32bit[i]>>32);
           assem_debug("%8x (%d) <- %8x",instr_addr[i],i,start+i*4);
           assem_debug("jump_in: %x (restricted - %x)",start+i*4,r);
-          //int entry_point=(int)out;
+          //int entry_point=(intptr_t)out;
           ////assem_debug("entry_point: %x",entry_point);
           //load_regs_entry(i);
-          //if(entry_point==(int)out)
+          //if(entry_point==(intptr_t)out)
           //  entry_point=instr_addr[i];
           //else
           //  emit_jmp(instr_addr[i]);
           //ll_add_32(jump_in+page,vaddr,r,(void *)entry_point);
           ll_add_32(jump_dirty+vpage,vaddr,r,(void *)out);
-          int entry_point=do_dirty_stub(i);
+          intptr_t entry_point=do_dirty_stub(i);
           ll_add_32(jump_in+page,vaddr,r,(void *)entry_point);
         }
       }
@@ -10842,10 +10890,10 @@ int new_recompile_block(int addr)
   literal_pool(0);
   #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
   // Align code
-  if(((u_int)out)&7) emit_addnop(13);
+  if(((intptr_t)out)&7) emit_addnop(13);
   #endif
-  assert((u_int)out-beginning<MAX_OUTPUT_BLOCK_SIZE);
-  //DebugMessage(M64MSG_VERBOSE, "shadow buffer: %x-%x",(int)copy,(int)copy+slen*4);
+  assert((intptr_t)out-beginning<MAX_OUTPUT_BLOCK_SIZE);
+  //DebugMessage(M64MSG_VERBOSE, "shadow buffer: %x-%x",(intptr_t)copy,(intptr_t)copy+slen*4);
   memcpy(copy,source,slen*4);
   copy+=slen*4;
 
@@ -10862,12 +10910,12 @@ int new_recompile_block(int addr)
   // Trap writes to any of the pages we compiled
   for(i=start>>12;i<=(start+slen*4)>>12;i++) {
     invalid_code[i]=0;
-    memory_map[i]|=0x40000000;
+    memory_map[i]|=WRITE_PROTECT;
     if((signed int)start>=(signed int)0xC0000000) {
       assert(using_tlb);
-      j=(((u_int)i<<12)+(memory_map[i]<<2)-(u_int)rdram+(u_int)0x80000000)>>12;
+      j=(((uintptr_t)i<<12)+(memory_map[i]<<2)-(uintptr_t)rdram+0x80000000)>>12;
       invalid_code[j]=0;
-      memory_map[j]|=0x40000000;
+      memory_map[j]|=WRITE_PROTECT;
       //DebugMessage(M64MSG_VERBOSE, "write protect physical page: %x (virtual %x)",j<<12,start);
     }
   }
@@ -10878,7 +10926,7 @@ int new_recompile_block(int addr)
   while(expirep!=end)
   {
     int shift=TARGET_SIZE_2-3; // Divide into 8 blocks
-    int base=(int)base_addr+((expirep>>13)<<shift); // Base address of this block
+    intptr_t base=(intptr_t)base_addr+((expirep>>13)<<shift); // Base address of this block
     inv_debug("EXP: Phase %d\n",expirep);
     switch((expirep>>11)&3)
     {
@@ -10897,14 +10945,14 @@ int new_recompile_block(int addr)
       case 2:
         // Clear hash table
         for(i=0;i<32;i++) {
-          u_int *ht_bin=hash_table[((expirep&2047)<<5)+i];
-          if(((ht_bin[3]-(u_int)base_addr)>>shift)==((base-(u_int)base_addr)>>shift) ||
-             ((ht_bin[3]-(u_int)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((base-(u_int)base_addr)>>shift)) {
+          uintptr_t *ht_bin=hash_table[((expirep&2047)<<5)+i];
+          if(((ht_bin[3]-(uintptr_t)base_addr)>>shift)==((base-(uintptr_t)base_addr)>>shift) ||
+             ((ht_bin[3]-(uintptr_t)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((base-(uintptr_t)base_addr)>>shift)) {
             inv_debug("EXP: Remove hash %x -> %x\n",ht_bin[2],ht_bin[3]);
             ht_bin[2]=ht_bin[3]=-1;
           }
-          if(((ht_bin[1]-(u_int)base_addr)>>shift)==((base-(u_int)base_addr)>>shift) ||
-             ((ht_bin[1]-(u_int)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((base-(u_int)base_addr)>>shift)) {
+          if(((ht_bin[1]-(uintptr_t)base_addr)>>shift)==((base-(uintptr_t)base_addr)>>shift) ||
+             ((ht_bin[1]-(uintptr_t)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((base-(uintptr_t)base_addr)>>shift)) {
             inv_debug("EXP: Remove hash %x -> %x\n",ht_bin[0],ht_bin[1]);
             ht_bin[0]=ht_bin[2];
             ht_bin[1]=ht_bin[3];
@@ -10959,16 +11007,16 @@ void TLBWI_new(void)
      for fast look up. */
   for (i=tlb_e[g_cp0_regs[CP0_INDEX_REG]&0x3F].start_even>>12; i<=tlb_e[g_cp0_regs[CP0_INDEX_REG]&0x3F].end_even>>12; i++)
   {
-    //DebugMessage(M64MSG_VERBOSE, "%x: r:%8x w:%8x",i,tlb_LUT_r[i],tlb_LUT_w[i]);
+    //DebugMessage(M64MSG_VERBOSE, "%x: r:%8x w:%8x",i,tlb_LUT_r(i),tlb_LUT_w(i));
     if(i<0x80000||i>0xBFFFF)
     {
-      if(tlb_LUT_r[i]) {
-        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)rdram-0x80000000)>>2;
+      if(tlb_LUT_r(i)) {
+        memory_map[i]=((uintptr_t)(tlb_LUT_r(i)&0xFFFFF000)-(i<<12)+(uintptr_t)rdram-0x80000000)>>2;
         // FIXME: should make sure the physical page is invalid too
-        if(!tlb_LUT_w[i]||!invalid_code[i]) {
-          memory_map[i]|=0x40000000; // Write protect
+        if(!tlb_LUT_w(i)||!invalid_code[i]) {
+          memory_map[i]|=WRITE_PROTECT; // Write protect
         }else{
-          assert(tlb_LUT_r[i]==tlb_LUT_w[i]);
+          assert(tlb_LUT_r(i)==tlb_LUT_w(i));
         }
         if(!using_tlb) DebugMessage(M64MSG_VERBOSE, "Enabled TLB");
         // Tell the dynamic recompiler to generate tlb lookup code
@@ -10980,16 +11028,16 @@ void TLBWI_new(void)
   }
   for (i=tlb_e[g_cp0_regs[CP0_INDEX_REG]&0x3F].start_odd>>12; i<=tlb_e[g_cp0_regs[CP0_INDEX_REG]&0x3F].end_odd>>12; i++)
   {
-    //DebugMessage(M64MSG_VERBOSE, "%x: r:%8x w:%8x",i,tlb_LUT_r[i],tlb_LUT_w[i]);
+    //DebugMessage(M64MSG_VERBOSE, "%x: r:%8x w:%8x",i,tlb_LUT_r(i),tlb_LUT_w(i));
     if(i<0x80000||i>0xBFFFF)
     {
-      if(tlb_LUT_r[i]) {
-        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)rdram-0x80000000)>>2;
+      if(tlb_LUT_r(i)) {
+        memory_map[i]=((uintptr_t)(tlb_LUT_r(i)&0xFFFFF000)-(i<<12)+(uintptr_t)rdram-0x80000000)>>2;
         // FIXME: should make sure the physical page is invalid too
-        if(!tlb_LUT_w[i]||!invalid_code[i]) {
-          memory_map[i]|=0x40000000; // Write protect
+        if(!tlb_LUT_w(i)||!invalid_code[i]) {
+          memory_map[i]|=WRITE_PROTECT; // Write protect
         }else{
-          assert(tlb_LUT_r[i]==tlb_LUT_w[i]);
+          assert(tlb_LUT_r(i)==tlb_LUT_w(i));
         }
         if(!using_tlb) DebugMessage(M64MSG_VERBOSE, "Enabled TLB");
         // Tell the dynamic recompiler to generate tlb lookup code
@@ -11031,16 +11079,16 @@ void TLBWR_new(void)
      for fast look up. */
   for (i=tlb_e[g_cp0_regs[CP0_RANDOM_REG]&0x3F].start_even>>12; i<=tlb_e[g_cp0_regs[CP0_RANDOM_REG]&0x3F].end_even>>12; i++)
   {
-    //DebugMessage(M64MSG_VERBOSE, "%x: r:%8x w:%8x",i,tlb_LUT_r[i],tlb_LUT_w[i]);
+    //DebugMessage(M64MSG_VERBOSE, "%x: r:%8x w:%8x",i,tlb_LUT_r(i),tlb_LUT_w(i));
     if(i<0x80000||i>0xBFFFF)
     {
-      if(tlb_LUT_r[i]) {
-        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)rdram-0x80000000)>>2;
+      if(tlb_LUT_r(i)) {
+        memory_map[i]=((uintptr_t)(tlb_LUT_r(i)&0xFFFFF000)-(i<<12)+(uintptr_t)rdram-0x80000000)>>2;
         // FIXME: should make sure the physical page is invalid too
-        if(!tlb_LUT_w[i]||!invalid_code[i]) {
-          memory_map[i]|=0x40000000; // Write protect
+        if(!tlb_LUT_w(i)||!invalid_code[i]) {
+          memory_map[i]|=WRITE_PROTECT; // Write protect
         }else{
-          assert(tlb_LUT_r[i]==tlb_LUT_w[i]);
+          assert(tlb_LUT_r(i)==tlb_LUT_w(i));
         }
         if(!using_tlb) DebugMessage(M64MSG_VERBOSE, "Enabled TLB");
         // Tell the dynamic recompiler to generate tlb lookup code
@@ -11052,16 +11100,16 @@ void TLBWR_new(void)
   }
   for (i=tlb_e[g_cp0_regs[CP0_RANDOM_REG]&0x3F].start_odd>>12; i<=tlb_e[g_cp0_regs[CP0_RANDOM_REG]&0x3F].end_odd>>12; i++)
   {
-    //DebugMessage(M64MSG_VERBOSE, "%x: r:%8x w:%8x",i,tlb_LUT_r[i],tlb_LUT_w[i]);
+    //DebugMessage(M64MSG_VERBOSE, "%x: r:%8x w:%8x",i,tlb_LUT_r(i),tlb_LUT_w(i));
     if(i<0x80000||i>0xBFFFF)
     {
-      if(tlb_LUT_r[i]) {
-        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)rdram-0x80000000)>>2;
+      if(tlb_LUT_r(i)) {
+        memory_map[i]=((uintptr_t)(tlb_LUT_r(i)&0xFFFFF000)-(i<<12)+(uintptr_t)rdram-0x80000000)>>2;
         // FIXME: should make sure the physical page is invalid too
-        if(!tlb_LUT_w[i]||!invalid_code[i]) {
-          memory_map[i]|=0x40000000; // Write protect
+        if(!tlb_LUT_w(i)||!invalid_code[i]) {
+          memory_map[i]|=WRITE_PROTECT; // Write protect
         }else{
-          assert(tlb_LUT_r[i]==tlb_LUT_w[i]);
+          assert(tlb_LUT_r(i)==tlb_LUT_w(i));
         }
         if(!using_tlb) DebugMessage(M64MSG_VERBOSE, "Enabled TLB");
         // Tell the dynamic recompiler to generate tlb lookup code
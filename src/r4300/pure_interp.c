@@ -35,6 +35,7 @@
 #include "cached_interp.h"
 #include "ops.h"
 #include "exception.h"
+#include "idle_loop.h"
 #include "macros.h"
 #include "interupt.h"
 #include "tlb.h"
@@ -93,7 +94,11 @@ static void prefetch(void);
       { \
          update_count(); \
          skip = next_interupt - g_cp0_regs[CP0_COUNT_REG]; \
-         if (skip > 3) g_cp0_regs[CP0_COUNT_REG] += (skip & 0xFFFFFFFC); \
+         if (skip > 3) \
+         { \
+            g_cp0_regs[CP0_COUNT_REG] += (skip & 0xFFFFFFFC); \
+            g_IdleLoopCycles += (skip & 0xFFFFFFFC); \
+         } \
          else name(); \
       } \
       else name(); \
@@ -391,7 +396,7 @@ static void prefetch(void)
    unsigned int *mem = fast_mem_access(interp_PC.addr);
    if (mem != NULL)
    {
-      prefetch_opcode(mem[0], mem[1]);
+      prefetch_opcode(mem);
    }
    else
    {
@@ -34,10 +34,14 @@
 #include "cp0.h"
 #include "cp1.h"
 #include "ops.h"
+#include "idle_loop.h"
 #include "interupt.h"
 #include "pure_interp.h"
 #include "recomp.h"
 #include "recomph.h"
+#include "recomp_async.h"
+#include "recomp_cache.h"
+#include "recomp_link.h"
 #include "tlb.h"
 #include "new_dynarec/new_dynarec.h"
 
@@ -115,11 +119,7 @@ void r4300_reset_hard(void)
         tlb_e[i].end_odd=0;
         tlb_e[i].phys_odd=0;
     }
-    for (i=0; i<0x100000; i++)
-    {
-        tlb_LUT_r[i] = 0;
-        tlb_LUT_w[i] = 0;
-    }
+    tlb_LUT_reset();
     llbit=0;
     hi=0;
     lo=0;
@@ -229,7 +229,7 @@ void r4300_reset_soft(void)
     /* ready to execute IPL3 */
 }
 
-#if !defined(NO_ASM)
+#if !defined(NO_ASM) && !defined(NEW_DYNAREC)
 static void dynarec_setup_code(void)
 {
    // The dynarec jumps here after we call dyna_start and it prepares
@@ -262,6 +262,7 @@ void r4300_execute(void)
     last_addr = 0xa4000040;
     next_interupt = 624999;
     init_interupt();
+    idle_loop_open();
 
     if (r4300emu == CORE_PURE_INTERPRETER)
     {
@@ -281,8 +282,14 @@ void r4300_execute(void)
         new_dyna_start();
         new_dynarec_cleanup();
 #else
+        recomp_async_open();
+        recomp_cache_open();
+        recomp_link_open();
         dyna_start(dynarec_setup_code);
         PC++;
+        recomp_link_close();
+        recomp_cache_close();
+        recomp_async_close();
 #endif
 #if defined(PROFILE_R4300)
         pfProfile = fopen("instructionaddrs.dat", "ab");
@@ -333,6 +340,7 @@ void r4300_execute(void)
     }
 
     DebugMessage(M64MSG_INFO, "R4300 emulator finished.");
+    idle_loop_close();
 
     /* print instruction counts */
 #if defined(COUNT_INSTR)
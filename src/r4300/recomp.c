@@ -33,10 +33,13 @@
 #include "api/callbacks.h"
 #include "memory/memory.h"
 #include "main/profile.h"
+#include "main/trace.h"
 
 #include "cached_interp.h"
+#include "idle_loop.h"
 #include "recomp.h"
 #include "recomph.h" //include for function prototypes
+#include "recomp_link.h"
 #include "cp0.h"
 #include "r4300.h"
 #include "ops.h"
@@ -46,25 +49,28 @@ static void *malloc_exec(size_t size);
 static void free_exec(void *ptr, size_t length);
 
 // global variables :
-precomp_instr *dst; // destination structure for the recompiled instruction
-int code_length; // current real recompiled code length
-int max_code_length; // current recompiled code's buffer length
-unsigned char **inst_pointer; // output buffer for recompiled code
-precomp_block *dst_block; // the current block that we are recompiling
-int src; // the current recompiled instruction
+// the state of the recompiler is per thread, so that a page can be compiled in
+// the background while the emulation thread initialises and decodes others
+osal_thread_local precomp_instr *dst; // destination structure for the recompiled instruction
+osal_thread_local int code_length; // current real recompiled code length
+osal_thread_local int max_code_length; // current recompiled code's buffer length
+osal_thread_local unsigned char **inst_pointer; // output buffer for recompiled code
+osal_thread_local precomp_block *dst_block; // the current block that we are recompiling
+osal_thread_local int src; // the current recompiled instruction
 int fast_memory;
 int no_compiled_jump = 0; /* use cached interpreter instead of recompiler for jumps */
+int sse2_fpu = 0; /* use SSE2 instead of x87 code for the FPU in the x86_64 recompiler */
 
-static void (*recomp_func)(void); // pointer to the dynarec's generator
+static osal_thread_local void (*recomp_func)(void); // pointer to the dynarec's generator
                                   // function for the latest decoded opcode
 
 #if defined(PROFILE_R4300)
 FILE *pfProfile;
 #endif
 
-static int *SRC; // currently recompiled instruction in the input stream
-static int check_nop; // next instruction is nop ?
-static int delay_slot_compiled = 0;
+static osal_thread_local int *SRC; // currently recompiled instruction in the input stream
+static osal_thread_local int check_nop; // next instruction is nop ?
+static osal_thread_local int delay_slot_compiled = 0;
 
 
 
@@ -120,6 +126,33 @@ static void recompile_standard_cf_type(void)
    dst->f.cf.fd = (src >>  6) & 0x1F;
 }
 
+/* the branch being decoded is idle if it jumps to itself with a nop in its
+ * delay slot, or if it closes a loop of its page found idle by the analyser */
+static int is_idle_loop(unsigned int target)
+{
+   unsigned int length;
+
+   if (target == dst->addr)
+      return check_nop;
+   if (!g_IdleLoopDetection || target > dst->addr)
+      return 0;
+
+   if (r4300emu == CORE_PURE_INTERPRETER)
+   {
+      if ((target ^ (dst->addr + 4)) & ~0xFFF)
+         return 0;
+   }
+   else if (target < dst_block->start || dst->addr == (dst_block->end-4))
+      return 0;
+
+   length = (dst->addr - target) / 4 + 2;
+   if (length > IDLE_LOOP_MAX_LENGTH)
+      return 0;
+   if (r4300emu == CORE_PURE_INTERPRETER)
+      return idle_loop_analyse_cached(dst->addr, (unsigned int *) SRC - (length - 2), length);
+   return idle_loop_analyse((unsigned int *) SRC - (length - 2), length);
+}
+
 //-------------------------------------------------------------------------
 //                                  SPECIAL                                
 //-------------------------------------------------------------------------
@@ -540,15 +573,12 @@ static void RBLTZ(void)
    recomp_func = genbltz;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BLTZ_IDLE;
-         recomp_func = genbltz_idle;
-      }
+      dst->ops = current_instruction_table.BLTZ_IDLE;
+      recomp_func = genbltz_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BLTZ_OUT;
       recomp_func = genbltz_out;
@@ -562,15 +592,12 @@ static void RBGEZ(void)
    recomp_func = genbgez;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BGEZ_IDLE;
-         recomp_func = genbgez_idle;
-      }
+      dst->ops = current_instruction_table.BGEZ_IDLE;
+      recomp_func = genbgez_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BGEZ_OUT;
       recomp_func = genbgez_out;
@@ -584,15 +611,12 @@ static void RBLTZL(void)
    recomp_func = genbltzl;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BLTZL_IDLE;
-         recomp_func = genbltzl_idle;
-      }
+      dst->ops = current_instruction_table.BLTZL_IDLE;
+      recomp_func = genbltzl_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BLTZL_OUT;
       recomp_func = genbltzl_out;
@@ -606,15 +630,12 @@ static void RBGEZL(void)
    recomp_func = genbgezl;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BGEZL_IDLE;
-         recomp_func = genbgezl_idle;
-      }
+      dst->ops = current_instruction_table.BGEZL_IDLE;
+      recomp_func = genbgezl_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BGEZL_OUT;
       recomp_func = genbgezl_out;
@@ -664,15 +685,12 @@ static void RBLTZAL(void)
    recomp_func = genbltzal;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BLTZAL_IDLE;
-         recomp_func = genbltzal_idle;
-      }
+      dst->ops = current_instruction_table.BLTZAL_IDLE;
+      recomp_func = genbltzal_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BLTZAL_OUT;
       recomp_func = genbltzal_out;
@@ -686,15 +704,12 @@ static void RBGEZAL(void)
    recomp_func = genbgezal;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BGEZAL_IDLE;
-         recomp_func = genbgezal_idle;
-      }
+      dst->ops = current_instruction_table.BGEZAL_IDLE;
+      recomp_func = genbgezal_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BGEZAL_OUT;
       recomp_func = genbgezal_out;
@@ -708,15 +723,12 @@ static void RBLTZALL(void)
    recomp_func = genbltzall;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BLTZALL_IDLE;
-         recomp_func = genbltzall_idle;
-      }
+      dst->ops = current_instruction_table.BLTZALL_IDLE;
+      recomp_func = genbltzall_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BLTZALL_OUT;
       recomp_func = genbltzall_out;
@@ -730,15 +742,12 @@ static void RBGEZALL(void)
    recomp_func = genbgezall;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BGEZALL_IDLE;
-         recomp_func = genbgezall_idle;
-      }
+      dst->ops = current_instruction_table.BGEZALL_IDLE;
+      recomp_func = genbgezall_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BGEZALL_OUT;
       recomp_func = genbgezall_out;
@@ -845,15 +854,12 @@ static void RBC1F(void)
    recomp_func = genbc1f;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BC1F_IDLE;
-         recomp_func = genbc1f_idle;
-      }
+      dst->ops = current_instruction_table.BC1F_IDLE;
+      recomp_func = genbc1f_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BC1F_OUT;
       recomp_func = genbc1f_out;
@@ -867,15 +873,12 @@ static void RBC1T(void)
    recomp_func = genbc1t;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BC1T_IDLE;
-         recomp_func = genbc1t_idle;
-      }
+      dst->ops = current_instruction_table.BC1T_IDLE;
+      recomp_func = genbc1t_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BC1T_OUT;
       recomp_func = genbc1t_out;
@@ -889,15 +892,12 @@ static void RBC1FL(void)
    recomp_func = genbc1fl;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BC1FL_IDLE;
-         recomp_func = genbc1fl_idle;
-      }
+      dst->ops = current_instruction_table.BC1FL_IDLE;
+      recomp_func = genbc1fl_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BC1FL_OUT;
       recomp_func = genbc1fl_out;
@@ -911,15 +911,12 @@ static void RBC1TL(void)
    recomp_func = genbc1tl;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BC1TL_IDLE;
-         recomp_func = genbc1tl_idle;
-      }
+      dst->ops = current_instruction_table.BC1TL_IDLE;
+      recomp_func = genbc1tl_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BC1TL_OUT;
       recomp_func = genbc1tl_out;
@@ -1623,15 +1620,12 @@ static void RJ(void)
    recomp_func = genj;
    recompile_standard_j_type();
    target = (dst->f.j.inst_index<<2) | (dst->addr & 0xF0000000);
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.J_IDLE;
-         recomp_func = genj_idle;
-      }
+      dst->ops = current_instruction_table.J_IDLE;
+      recomp_func = genj_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.J_OUT;
       recomp_func = genj_out;
@@ -1645,15 +1639,12 @@ static void RJAL(void)
    recomp_func = genjal;
    recompile_standard_j_type();
    target = (dst->f.j.inst_index<<2) | (dst->addr & 0xF0000000);
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.JAL_IDLE;
-         recomp_func = genjal_idle;
-      }
+      dst->ops = current_instruction_table.JAL_IDLE;
+      recomp_func = genjal_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.JAL_OUT;
       recomp_func = genjal_out;
@@ -1667,15 +1658,12 @@ static void RBEQ(void)
    recomp_func = genbeq;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BEQ_IDLE;
-         recomp_func = genbeq_idle;
-      }
+      dst->ops = current_instruction_table.BEQ_IDLE;
+      recomp_func = genbeq_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BEQ_OUT;
       recomp_func = genbeq_out;
@@ -1689,15 +1677,12 @@ static void RBNE(void)
    recomp_func = genbne;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BNE_IDLE;
-         recomp_func = genbne_idle;
-      }
+      dst->ops = current_instruction_table.BNE_IDLE;
+      recomp_func = genbne_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BNE_OUT;
       recomp_func = genbne_out;
@@ -1711,15 +1696,12 @@ static void RBLEZ(void)
    recomp_func = genblez;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BLEZ_IDLE;
-         recomp_func = genblez_idle;
-      }
+      dst->ops = current_instruction_table.BLEZ_IDLE;
+      recomp_func = genblez_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BLEZ_OUT;
       recomp_func = genblez_out;
@@ -1733,15 +1715,12 @@ static void RBGTZ(void)
    recomp_func = genbgtz;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BGTZ_IDLE;
-         recomp_func = genbgtz_idle;
-      }
+      dst->ops = current_instruction_table.BGTZ_IDLE;
+      recomp_func = genbgtz_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BGTZ_OUT;
       recomp_func = genbgtz_out;
@@ -1829,15 +1808,12 @@ static void RBEQL(void)
    recomp_func = genbeql;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BEQL_IDLE;
-         recomp_func = genbeql_idle;
-      }
+      dst->ops = current_instruction_table.BEQL_IDLE;
+      recomp_func = genbeql_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BEQL_OUT;
       recomp_func = genbeql_out;
@@ -1851,15 +1827,12 @@ static void RBNEL(void)
    recomp_func = genbnel;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BNEL_IDLE;
-         recomp_func = genbnel_idle;
-      }
+      dst->ops = current_instruction_table.BNEL_IDLE;
+      recomp_func = genbnel_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BNEL_OUT;
       recomp_func = genbnel_out;
@@ -1873,15 +1846,12 @@ static void RBLEZL(void)
    recomp_func = genblezl;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BLEZL_IDLE;
-         recomp_func = genblezl_idle;
-      }
+      dst->ops = current_instruction_table.BLEZL_IDLE;
+      recomp_func = genblezl_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BLEZL_OUT;
       recomp_func = genblezl_out;
@@ -1895,15 +1865,12 @@ static void RBGTZL(void)
    recomp_func = genbgtzl;
    recompile_standard_i_type();
    target = dst->addr + dst->f.i.immediate*4 + 4;
-   if (target == dst->addr)
+   if (is_idle_loop(target))
    {
-      if (check_nop)
-      {
-         dst->ops = current_instruction_table.BGTZL_IDLE;
-         recomp_func = genbgtzl_idle;
-      }
+      dst->ops = current_instruction_table.BGTZL_IDLE;
+      recomp_func = genbgtzl_idle;
    }
-   else if (r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
+   else if (target != dst->addr && r4300emu != CORE_PURE_INTERPRETER && (target < dst_block->start || target >= dst_block->end || dst->addr == (dst_block->end-4)))
    {
       dst->ops = current_instruction_table.BGTZL_OUT;
       recomp_func = genbgtzl_out;
@@ -2157,36 +2124,39 @@ static size_t get_block_memsize(const precomp_block *block)
   return ((length+1)+(length>>2)) * sizeof(precomp_instr);
 }
 
-/**********************************************************************
- ******************** initialize an empty block ***********************
- **********************************************************************/
-void init_block(precomp_block *block)
+static size_t get_block_infosize(const precomp_block *block)
+{
+  int length = get_block_length(block);
+  return ((length+1)+(length>>2)) * sizeof(precomp_instr_info);
+}
+
+static void init_instr_info(const precomp_block *block, const precomp_instr *instr, unsigned int local_addr)
+{
+  precomp_instr_info *info;
+  if (!block->infos)
+    return;
+  info = get_instr_info(block, instr);
+  info->reg_cache_infos.need_map = 0;
+  info->local_addr = local_addr;
+}
+
+/* allocates the buffers of a block and fills it with NOTCOMPILED entries,
+ * returns 0 if the memory couldn't be allocated */
+static int init_block_entries(precomp_block *block)
 {
   int i, length, already_exist = 1;
-  static int init_length;
-  timed_section_start(TIMED_SECTION_COMPILER);
-#ifdef CORE_DBG
-  DebugMessage(M64MSG_INFO, "init block %x - %x", (int) block->start, (int) block->end);
-#endif
+  static osal_thread_local int init_length;
 
   length = get_block_length(block);
+  block->adler32 = 0;
    
   if (!block->block)
   {
     size_t memsize = get_block_memsize(block);
-    if (r4300emu == CORE_DYNAREC) {
-        block->block = (precomp_instr *) malloc_exec(memsize);
-        if (!block->block) {
-            DebugMessage(M64MSG_ERROR, "Memory error: couldn't allocate executable memory for dynamic recompiler. Try to use an interpreter mode.");
-            return;
-        }
-    }
-    else {
-        block->block = (precomp_instr *) malloc(memsize);
-        if (!block->block) {
-            DebugMessage(M64MSG_ERROR, "Memory error: couldn't allocate memory for cached interpreter.");
-            return;
-        }
+    block->block = (precomp_instr *) malloc(memsize);
+    if (!block->block) {
+        DebugMessage(M64MSG_ERROR, "Memory error: couldn't allocate memory for precompiled instructions.");
+        return 0;
     }
 
     memset(block->block, 0, memsize);
@@ -2195,6 +2165,18 @@ void init_block(precomp_block *block)
 
   if (r4300emu == CORE_DYNAREC)
   {
+    /* the jump wrappers are built inside the side table, so it must be executable */
+    if (!block->infos)
+    {
+      size_t infosize = get_block_infosize(block);
+      block->infos = (precomp_instr_info *) malloc_exec(infosize);
+      if (!block->infos) {
+          DebugMessage(M64MSG_ERROR, "Memory error: couldn't allocate executable memory for dynamic recompiler. Try to use an interpreter mode.");
+          return 0;
+      }
+      memset(block->infos, 0, infosize);
+    }
+    dst_block = block;
     if (!block->code)
     {
 #if defined(PROFILE_R4300)
@@ -2222,7 +2204,12 @@ void init_block(precomp_block *block)
       free(block->riprel_table);
       block->riprel_table = NULL;
     }
-    init_assembler(NULL, 0, NULL, 0);
+    if (block->imm64_table)
+    {
+      free(block->imm64_table);
+      block->imm64_table = NULL;
+    }
+    init_assembler(NULL, 0, NULL, 0, NULL, 0);
     init_cache(block->block);
   }
    
@@ -2241,8 +2228,7 @@ void init_block(precomp_block *block)
     {
       dst = block->block + i;
       dst->addr = block->start + i*4;
-      dst->reg_cache_infos.need_map = 0;
-      dst->local_addr = code_length;
+      init_instr_info(block, dst, code_length);
 #ifdef COMPARE_CORE
       if (r4300emu == CORE_DYNAREC) gendebug();
 #endif
@@ -2265,8 +2251,7 @@ void init_block(precomp_block *block)
     for (i=0; i<length; i++)
     {
       dst = block->block + i;
-      dst->reg_cache_infos.need_map = 0;
-      dst->local_addr = i * (init_length / length);
+      init_instr_info(block, dst, i * (init_length / length));
       dst->ops = current_instruction_table.NOTCOMPILED;
     }
   }
@@ -2278,7 +2263,32 @@ void init_block(precomp_block *block)
        gennotcompiled() and gendebug() is position-independent and contains no jumps . */
     block->code_length = code_length;
     block->max_code_length = max_code_length;
-    free_assembler(&block->jumps_table, &block->jumps_number, &block->riprel_table, &block->riprel_number);
+    free_assembler(&block->jumps_table, &block->jumps_number, &block->riprel_table, &block->riprel_number, &block->imm64_table, &block->imm64_number);
+  }
+
+  return 1;
+}
+
+/**********************************************************************
+ ******************** initialize an empty block ***********************
+ **********************************************************************/
+void init_block(precomp_block *block)
+{
+  timed_section_start(TIMED_SECTION_COMPILER);
+  trace_begin("r4300.init_block");
+  if (block->block != NULL)
+    trace_instant("r4300.invalidate", block->start);
+#ifdef CORE_DBG
+  DebugMessage(M64MSG_INFO, "init block %x - %x", (int) block->start, (int) block->end);
+#endif
+
+  /* the code of the block is rewritten */
+  recomp_link_clear(block);
+
+  if (!init_block_entries(block))
+  {
+    trace_end("r4300.init_block");
+    return;
   }
    
   /* here we're marking the block as a valid code even if it's not compiled
@@ -2296,8 +2306,10 @@ void init_block(precomp_block *block)
       blocks[paddr>>12] = (precomp_block *) malloc(sizeof(precomp_block));
       blocks[paddr>>12]->code = NULL;
       blocks[paddr>>12]->block = NULL;
+      blocks[paddr>>12]->infos = NULL;
       blocks[paddr>>12]->jumps_table = NULL;
       blocks[paddr>>12]->riprel_table = NULL;
+      blocks[paddr>>12]->imm64_table = NULL;
       blocks[paddr>>12]->start = paddr & ~0xFFF;
       blocks[paddr>>12]->end = (paddr & ~0xFFF) + 0x1000;
     }
@@ -2310,8 +2322,10 @@ void init_block(precomp_block *block)
       blocks[paddr>>12] = (precomp_block *) malloc(sizeof(precomp_block));
       blocks[paddr>>12]->code = NULL;
       blocks[paddr>>12]->block = NULL;
+      blocks[paddr>>12]->infos = NULL;
       blocks[paddr>>12]->jumps_table = NULL;
       blocks[paddr>>12]->riprel_table = NULL;
+      blocks[paddr>>12]->imm64_table = NULL;
       blocks[paddr>>12]->start = paddr & ~0xFFF;
       blocks[paddr>>12]->end = (paddr & ~0xFFF) + 0x1000;
     }
@@ -2326,8 +2340,10 @@ void init_block(precomp_block *block)
         blocks[(block->start+0x20000000)>>12] = (precomp_block *) malloc(sizeof(precomp_block));
         blocks[(block->start+0x20000000)>>12]->code = NULL;
         blocks[(block->start+0x20000000)>>12]->block = NULL;
+        blocks[(block->start+0x20000000)>>12]->infos = NULL;
         blocks[(block->start+0x20000000)>>12]->jumps_table = NULL;
         blocks[(block->start+0x20000000)>>12]->riprel_table = NULL;
+        blocks[(block->start+0x20000000)>>12]->imm64_table = NULL;
         blocks[(block->start+0x20000000)>>12]->start = (block->start+0x20000000) & ~0xFFF;
         blocks[(block->start+0x20000000)>>12]->end = ((block->start+0x20000000) & ~0xFFF) + 0x1000;
       }
@@ -2340,52 +2356,47 @@ void init_block(precomp_block *block)
         blocks[(block->start-0x20000000)>>12] = (precomp_block *) malloc(sizeof(precomp_block));
         blocks[(block->start-0x20000000)>>12]->code = NULL;
         blocks[(block->start-0x20000000)>>12]->block = NULL;
+        blocks[(block->start-0x20000000)>>12]->infos = NULL;
         blocks[(block->start-0x20000000)>>12]->jumps_table = NULL;
         blocks[(block->start-0x20000000)>>12]->riprel_table = NULL;
+        blocks[(block->start-0x20000000)>>12]->imm64_table = NULL;
         blocks[(block->start-0x20000000)>>12]->start = (block->start-0x20000000) & ~0xFFF;
         blocks[(block->start-0x20000000)>>12]->end = ((block->start-0x20000000) & ~0xFFF) + 0x1000;
       }
       init_block(blocks[(block->start-0x20000000)>>12]);
     }
   }
+  trace_end("r4300.init_block");
   timed_section_end(TIMED_SECTION_COMPILER);
 }
 
 void free_block(precomp_block *block)
 {
-    size_t memsize = get_block_memsize(block);
-
-    if (block->block) {
-        if (r4300emu == CORE_DYNAREC)
-            free_exec(block->block, memsize);
-        else
-            free(block->block);
-        block->block = NULL;
-    }
+    if (block->block) { free(block->block); block->block = NULL; }
+    if (block->infos) { free_exec(block->infos, get_block_infosize(block)); block->infos = NULL; }
     if (block->code) { free_exec(block->code, block->max_code_length); block->code = NULL; }
     if (block->jumps_table) { free(block->jumps_table); block->jumps_table = NULL; }
     if (block->riprel_table) { free(block->riprel_table); block->riprel_table = NULL; }
+    if (block->imm64_table) { free(block->imm64_table); block->imm64_table = NULL; }
 }
 
 /**********************************************************************
  ********************* recompile a block of code **********************
  **********************************************************************/
-void recompile_block(int *source, precomp_block *block, unsigned int func)
+static void recompile_block_entries(int *source, precomp_block *block, unsigned int func, int emit)
 {
    int i, length, finished=0;
    timed_section_start(TIMED_SECTION_COMPILER);
+   trace_begin("r4300.recompile_block");
    length = (block->end-block->start)/4;
    dst_block = block;
    
-   //for (i=0; i<16; i++) block->md5[i] = 0;
-   block->adler32 = 0;
-   
-   if (r4300emu == CORE_DYNAREC)
+   if (emit)
      {
     code_length = block->code_length;
     max_code_length = block->max_code_length;
     inst_pointer = &block->code;
-    init_assembler(block->jumps_table, block->jumps_number, block->riprel_table, block->riprel_number);
+    init_assembler(block->jumps_table, block->jumps_number, block->riprel_table, block->riprel_number, block->imm64_table, block->imm64_number);
     init_cache(block->block + (func & 0xFFF) / 4);
      }
 
@@ -2408,26 +2419,28 @@ void recompile_block(int *source, precomp_block *block, unsigned int func)
     check_nop = source[i+1] == 0;
     dst = block->block + i;
     dst->addr = block->start + i*4;
-    dst->reg_cache_infos.need_map = 0;
-    dst->local_addr = code_length;
+    /* no stale pointer bits may remain next to the smaller operand fields,
+       the translation cache relocates every pointer-sized slot of the block */
+    memset(&dst->f, 0, sizeof(dst->f));
+    init_instr_info(block, dst, code_length);
 #ifdef COMPARE_CORE
-    if (r4300emu == CORE_DYNAREC) gendebug();
+    if (emit) gendebug();
 #endif
 #if defined(PROFILE_R4300)
-    long x86addr = (long) (block->code + block->block[i].local_addr);
+    long x86addr = (long) (block->code + code_length);
     if (fwrite(source + i, 1, 4, pfProfile) != 4 || // write 4-byte MIPS opcode
         fwrite(&x86addr, 1, sizeof(char *), pfProfile) != sizeof(char *)) // write pointer to dynamically generated x86 code for this MIPS instruction
         DebugMessage(M64MSG_ERROR, "Error writing R4300 instruction address profiling data");
 #endif
     recomp_func = NULL;
     recomp_ops[((src >> 26) & 0x3F)]();
-    if (r4300emu == CORE_DYNAREC) recomp_func();
+    if (emit) recomp_func();
     dst = block->block + i;
 
     /*if ((dst+1)->ops != NOTCOMPILED && !delay_slot_compiled &&
         i < length)
       {
-         if (r4300emu == CORE_DYNAREC) genlink_subblock();
+         if (emit) genlink_subblock();
          finished = 2;
       }*/
     if (delay_slot_compiled) 
@@ -2462,37 +2475,35 @@ void recompile_block(int *source, precomp_block *block, unsigned int func)
      {
     dst = block->block + i;
     dst->addr = block->start + i*4;
-    dst->reg_cache_infos.need_map = 0;
-    dst->local_addr = code_length;
+    init_instr_info(block, dst, code_length);
 #ifdef COMPARE_CORE
-    if (r4300emu == CORE_DYNAREC) gendebug();
+    if (emit) gendebug();
 #endif
     RFIN_BLOCK();
-    if (r4300emu == CORE_DYNAREC) recomp_func();
+    if (emit) recomp_func();
     i++;
     if (i < length-1+(length>>2)) // useful when last opcode is a jump
       {
          dst = block->block + i;
          dst->addr = block->start + i*4;
-         dst->reg_cache_infos.need_map = 0;
-         dst->local_addr = code_length;
+         init_instr_info(block, dst, code_length);
 #ifdef COMPARE_CORE
-         if (r4300emu == CORE_DYNAREC) gendebug();
+         if (emit) gendebug();
 #endif
          RFIN_BLOCK();
-         if (r4300emu == CORE_DYNAREC) recomp_func();
+         if (emit) recomp_func();
          i++;
       }
      }
-   else if (r4300emu == CORE_DYNAREC) genlink_subblock();
+   else if (emit) genlink_subblock();
 
-   if (r4300emu == CORE_DYNAREC)
+   if (emit)
      {
     free_all_registers();
     passe2(block->block, (func&0xFFF)/4, i, block);
     block->code_length = code_length;
     block->max_code_length = max_code_length;
-    free_assembler(&block->jumps_table, &block->jumps_number, &block->riprel_table, &block->riprel_number);
+    free_assembler(&block->jumps_table, &block->jumps_number, &block->riprel_table, &block->riprel_number, &block->imm64_table, &block->imm64_number);
      }
 #ifdef CORE_DBG
    DebugMessage(M64MSG_INFO, "block recompiled (%x-%x)", (int)func, (int)(block->start+i*4));
@@ -2501,7 +2512,51 @@ void recompile_block(int *source, precomp_block *block, unsigned int func)
    fclose(pfProfile);
    pfProfile = NULL;
 #endif
+   trace_end("r4300.recompile_block");
+   timed_section_end(TIMED_SECTION_COMPILER);
+}
+
+void recompile_block(int *source, precomp_block *block, unsigned int func)
+{
+   unsigned char *code = block->code;
+
+   recompile_block_entries(source, block, func, r4300emu == CORE_DYNAREC);
+
+   /* the links from and to the block are stale if its code has moved */
+   if (block->code != code)
+     recomp_link_clear(block);
+}
+
+/* Decodes a block for the cached interpreter functions only, as
+ * recompile_block() does in the interpreter mode, while the dynamic
+ * recompiler is running.  The block doesn't need any infos or code. */
+void decode_block(int *source, precomp_block *block, unsigned int func)
+{
+   recompile_block_entries(source, block, func, 0);
+}
+
+/* Compiles the code of a 4 KB page of RDRAM, copied in source, into a new
+ * block which isn't referenced by blocks[] nor invalid_code[], so that it
+ * can be done on another thread.  Returns NULL if it couldn't be allocated. */
+precomp_block *recompile_detached_block(int *source, unsigned int start, unsigned int func)
+{
+   precomp_block *block = (precomp_block *) malloc(sizeof(precomp_block));
+   if (!block)
+     return NULL;
+
+   memset(block, 0, sizeof(precomp_block));
+   block->start = start;
+   block->end = start + 0x1000;
+   timed_section_start(TIMED_SECTION_COMPILER);
+   if (!init_block_entries(block))
+     {
+    free_block(block);
+    free(block);
+    return NULL;
+     }
    timed_section_end(TIMED_SECTION_COMPILER);
+   recompile_block_entries(source, block, func, 1);
+   return block;
 }
 
 static int is_jump(void)
@@ -2587,7 +2642,8 @@ void recompile_opcode(void)
    src = *SRC;
    dst++;
    dst->addr = (dst-1)->addr + 4;
-   dst->reg_cache_infos.need_map = 0;
+   memset(&dst->f, 0, sizeof(dst->f));
+   get_instr_info(dst_block, dst)->reg_cache_infos.need_map = 0;
    if(!is_jump())
    {
 #if defined(PROFILE_R4300)
@@ -2611,11 +2667,12 @@ void recompile_opcode(void)
 /**********************************************************************
  ************** decode one opcode (for the interpreter) ***************
  **********************************************************************/
-void prefetch_opcode(unsigned int op, unsigned int nextop)
+void prefetch_opcode(unsigned int *mem)
 {
    dst = PC;
-   src = op;
-   check_nop = nextop == 0;
+   SRC = (int *) mem;
+   src = mem[0];
+   check_nop = mem[1] == 0;
    recomp_ops[((src >> 26) & 0x3F)]();
 }
 
@@ -23,6 +23,8 @@
 #define M64P_R4300_RECOMP_H
 
 #include <stddef.h>
+
+#include "osal/preproc.h"
 #if defined(__x86_64__)
   #include "x86_64/assemble_struct.h"
 #else
@@ -66,13 +68,20 @@ typedef struct _precomp_instr
       } cf;
      } f;
    unsigned int addr; /* word-aligned instruction address in r4300 address space */
+} precomp_instr;
+
+/* Recompiler-only data of a precomp_instr. It is kept in a side table of the
+ * block so that the interpreters' dispatch loop only walks the fields above. */
+typedef struct _precomp_instr_info
+{
    unsigned int local_addr; /* byte offset to start of corresponding x86_64 instructions, from start of code block */
    reg_cache_struct reg_cache_infos;
-} precomp_instr;
+} precomp_instr_info;
 
 typedef struct _precomp_block
 {
    precomp_instr *block;
+   precomp_instr_info *infos; /* parallel to block, only allocated by the dynarec */
    unsigned int start;
    unsigned int end;
    unsigned char *code;
@@ -82,23 +91,33 @@ typedef struct _precomp_block
    int jumps_number;
    void *riprel_table;
    int riprel_number;
+   void *imm64_table;
+   int imm64_number;
    //unsigned char md5[16];
-   unsigned int adler32;
+   unsigned int adler32; /* hash of the page when its first code was compiled, 0 until then */
 } precomp_block;
 
+static osal_inline precomp_instr_info *get_instr_info(const precomp_block *block, const precomp_instr *instr)
+{
+   return block->infos + (instr - block->block);
+}
+
 void recompile_block(int *source, precomp_block *block, unsigned int func);
+void decode_block(int *source, precomp_block *block, unsigned int func);
+precomp_block *recompile_detached_block(int *source, unsigned int start, unsigned int func);
 void init_block(precomp_block *block);
 void free_block(precomp_block *block);
 void recompile_opcode(void);
-void prefetch_opcode(unsigned int op, unsigned int nextop);
+void prefetch_opcode(unsigned int *mem);
 void dyna_jump(void);
 void dyna_start(void *code);
 void dyna_stop(void);
 void *realloc_exec(void *ptr, size_t oldsize, size_t newsize);
 
-extern precomp_instr *dst; /* precomp_instr structure for instruction being recompiled */
+extern osal_thread_local precomp_instr *dst; /* precomp_instr structure for instruction being recompiled */
 
 extern int no_compiled_jump;
+extern int sse2_fpu;
 
 #if defined(__x86_64__)
   #include "x86_64/assemble.h"
@@ -0,0 +1,44 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - recomp_cache.h                                          *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef M64P_R4300_RECOMP_CACHE_H
+#define M64P_R4300_RECOMP_CACHE_H
+
+#include "osal/preproc.h"
+#include "recomp.h"
+
+/* Persistent translation cache of the x86_64 dynamic recompiler, see
+ * x86_64/recomp_cache.c.  Other builds get empty stubs. */
+#if defined(DYNAREC) && !defined(NEW_DYNAREC) && defined(__x86_64__)
+
+void recomp_cache_open(void);
+void recomp_cache_close(void);
+int recomp_cache_restore(precomp_block *block);
+
+#else
+
+static osal_inline void recomp_cache_open(void) {}
+static osal_inline void recomp_cache_close(void) {}
+static osal_inline int recomp_cache_restore(precomp_block *block) { return 0; }
+
+#endif
+
+#endif /* M64P_R4300_RECOMP_CACHE_H */
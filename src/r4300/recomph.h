@@ -24,12 +24,12 @@
 
 #include "recomp.h"
 
-extern int code_length;
-extern int max_code_length;
-extern unsigned char **inst_pointer;
-extern precomp_block* dst_block;
+extern osal_thread_local int code_length;
+extern osal_thread_local int max_code_length;
+extern osal_thread_local unsigned char **inst_pointer;
+extern osal_thread_local precomp_block* dst_block;
 extern int fast_memory;
-extern int src;   /* opcode of r4300 instruction being recompiled */
+extern osal_thread_local int src;   /* opcode of r4300 instruction being recompiled */
 
 #if defined(PROFILE_R4300)
   #include <stdio.h>
@@ -37,8 +37,8 @@ extern int src;   /* opcode of r4300 instruction being recompiled */
 #endif
 
 void passe2(precomp_instr *dest, int start, int end, precomp_block* block);
-void init_assembler(void *block_jumps_table, int block_jumps_number, void *block_riprel_table, int block_riprel_number);
-void free_assembler(void **block_jumps_table, int *block_jumps_number, void **block_riprel_table, int *block_riprel_number);
+void init_assembler(void *block_jumps_table, int block_jumps_number, void *block_riprel_table, int block_riprel_number, void *block_imm64_table, int block_imm64_number);
+void free_assembler(void **block_jumps_table, int *block_jumps_number, void **block_riprel_table, int *block_riprel_number, void **block_imm64_table, int *block_imm64_number);
 
 void gencallinterp(unsigned long addr, int jump);
 
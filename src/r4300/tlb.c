@@ -19,6 +19,11 @@
  *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
+#include <stdlib.h>
+#include <string.h>
+
+#include "api/m64p_types.h"
+#include "api/callbacks.h"
 #include "tlb.h"
 #include "exception.h"
 
@@ -26,47 +31,138 @@
 
 tlb tlb_e[32];
 
-unsigned int tlb_LUT_r[0x100000];
-unsigned int tlb_LUT_w[0x100000];
+unsigned int *tlb_LUT_dir_r[TLB_LUT_DIR_SIZE];
+unsigned int *tlb_LUT_dir_w[TLB_LUT_DIR_SIZE];
 
-void tlb_unmap(tlb *entry)
+/* the table of the directory entries without any mapping */
+static unsigned int l_EmptyTable[TLB_LUT_TABLE_PAGES];
+
+/* mapped pages of each table, a table is freed when none is left */
+static unsigned short l_Used_r[TLB_LUT_DIR_SIZE];
+static unsigned short l_Used_w[TLB_LUT_DIR_SIZE];
+
+static void tlb_LUT_set(unsigned int **dir, unsigned short *used, unsigned int page, unsigned int value)
+{
+    unsigned int d = page >> TLB_LUT_TABLE_SHIFT;
+    unsigned int *entry;
+
+    if (dir[d] == l_EmptyTable)
+    {
+        if (value == 0)
+            return;
+        dir[d] = (unsigned int *) calloc(TLB_LUT_TABLE_PAGES, sizeof(unsigned int));
+        if (dir[d] == NULL)
+        {
+            DebugMessage(M64MSG_ERROR, "Couldn't allocate a TLB lookup table, the page %05x isn't mapped", page);
+            dir[d] = l_EmptyTable;
+            return;
+        }
+    }
+
+    entry = &dir[d][page & (TLB_LUT_TABLE_PAGES - 1)];
+    used[d] += (value != 0) - (*entry != 0);
+    *entry = value;
+
+    if (used[d] == 0)
+    {
+        free(dir[d]);
+        dir[d] = l_EmptyTable;
+    }
+}
+
+static void tlb_LUT_set_range(unsigned int **dir, unsigned short *used, unsigned int start, unsigned int end,
+                              int map, unsigned int phys)
 {
     unsigned int i;
 
+    for (i = start; i < end; i += 0x1000)
+        tlb_LUT_set(dir, used, i >> 12, map ? 0x80000000 | (phys + (i - start) + 0xFFF) : 0);
+}
+
+static void tlb_LUT_clear(unsigned int **dir, unsigned short *used)
+{
+    unsigned int d;
+
+    for (d = 0; d < TLB_LUT_DIR_SIZE; d++)
+    {
+        if (dir[d] != NULL && dir[d] != l_EmptyTable)
+            free(dir[d]);
+        dir[d] = l_EmptyTable;
+        used[d] = 0;
+    }
+}
+
+static void tlb_LUT_copy_in(unsigned int **dir, unsigned short *used, const unsigned int *lut)
+{
+    unsigned int page;
+
+    tlb_LUT_clear(dir, used);
+    for (page = 0; page < 0x100000; page++)
+    {
+        if (lut[page] != 0)
+            tlb_LUT_set(dir, used, page, lut[page]);
+    }
+}
+
+static void tlb_LUT_copy_out(unsigned int **dir, unsigned int *lut)
+{
+    unsigned int d;
+
+    for (d = 0; d < TLB_LUT_DIR_SIZE; d++)
+        memcpy(lut + (d << TLB_LUT_TABLE_SHIFT), dir[d], TLB_LUT_TABLE_PAGES * sizeof(unsigned int));
+}
+
+/* Global Functions */
+
+/* unmaps every page and frees the tables */
+void tlb_LUT_reset(void)
+{
+    tlb_LUT_clear(tlb_LUT_dir_r, l_Used_r);
+    tlb_LUT_clear(tlb_LUT_dir_w, l_Used_w);
+}
+
+/* copies the lookup tables into flat arrays of 0x100000 entries */
+void tlb_LUT_save(unsigned int *lut_r, unsigned int *lut_w)
+{
+    tlb_LUT_copy_out(tlb_LUT_dir_r, lut_r);
+    tlb_LUT_copy_out(tlb_LUT_dir_w, lut_w);
+}
+
+/* replaces the lookup tables by flat arrays of 0x100000 entries */
+void tlb_LUT_load(const unsigned int *lut_r, const unsigned int *lut_w)
+{
+    tlb_LUT_copy_in(tlb_LUT_dir_r, l_Used_r, lut_r);
+    tlb_LUT_copy_in(tlb_LUT_dir_w, l_Used_w, lut_w);
+}
+
+void tlb_unmap(tlb *entry)
+{
     if (entry->v_even)
     {
-        for (i=entry->start_even; i<entry->end_even; i += 0x1000)
-            tlb_LUT_r[i>>12] = 0;
+        tlb_LUT_set_range(tlb_LUT_dir_r, l_Used_r, entry->start_even, entry->end_even, 0, 0);
         if (entry->d_even)
-            for (i=entry->start_even; i<entry->end_even; i += 0x1000)
-                tlb_LUT_w[i>>12] = 0;
+            tlb_LUT_set_range(tlb_LUT_dir_w, l_Used_w, entry->start_even, entry->end_even, 0, 0);
     }
 
     if (entry->v_odd)
     {
-        for (i=entry->start_odd; i<entry->end_odd; i += 0x1000)
-            tlb_LUT_r[i>>12] = 0;
+        tlb_LUT_set_range(tlb_LUT_dir_r, l_Used_r, entry->start_odd, entry->end_odd, 0, 0);
         if (entry->d_odd)
-            for (i=entry->start_odd; i<entry->end_odd; i += 0x1000)
-                tlb_LUT_w[i>>12] = 0;
+            tlb_LUT_set_range(tlb_LUT_dir_w, l_Used_w, entry->start_odd, entry->end_odd, 0, 0);
     }
 }
 
 void tlb_map(tlb *entry)
 {
-    unsigned int i;
-
     if (entry->v_even)
     {
         if (entry->start_even < entry->end_even &&
             !(entry->start_even >= 0x80000000 && entry->end_even < 0xC0000000) &&
             entry->phys_even < 0x20000000)
         {
-            for (i=entry->start_even;i<entry->end_even;i+=0x1000)
-                tlb_LUT_r[i>>12] = 0x80000000 | (entry->phys_even + (i - entry->start_even) + 0xFFF);
+            tlb_LUT_set_range(tlb_LUT_dir_r, l_Used_r, entry->start_even, entry->end_even, 1, entry->phys_even);
             if (entry->d_even)
-                for (i=entry->start_even;i<entry->end_even;i+=0x1000)
-                    tlb_LUT_w[i>>12] = 0x80000000 | (entry->phys_even + (i - entry->start_even) + 0xFFF);
+                tlb_LUT_set_range(tlb_LUT_dir_w, l_Used_w, entry->start_even, entry->end_even, 1, entry->phys_even);
         }
     }
 
@@ -76,11 +172,9 @@ void tlb_map(tlb *entry)
             !(entry->start_odd >= 0x80000000 && entry->end_odd < 0xC0000000) &&
             entry->phys_odd < 0x20000000)
         {
-            for (i=entry->start_odd;i<entry->end_odd;i+=0x1000)
-                tlb_LUT_r[i>>12] = 0x80000000 | (entry->phys_odd + (i - entry->start_odd) + 0xFFF);
+            tlb_LUT_set_range(tlb_LUT_dir_r, l_Used_r, entry->start_odd, entry->end_odd, 1, entry->phys_odd);
             if (entry->d_odd)
-                for (i=entry->start_odd;i<entry->end_odd;i+=0x1000)
-                    tlb_LUT_w[i>>12] = 0x80000000 | (entry->phys_odd + (i - entry->start_odd) + 0xFFF);
+                tlb_LUT_set_range(tlb_LUT_dir_w, l_Used_w, entry->start_odd, entry->end_odd, 1, entry->phys_odd);
         }
     }
 }
@@ -115,13 +209,15 @@ unsigned int virtual_to_physical_address(unsigned int addresse, int w)
     }
     if (w == 1)
     {
-        if (tlb_LUT_w[addresse>>12])
-            return (tlb_LUT_w[addresse>>12]&0xFFFFF000)|(addresse&0xFFF);
+        unsigned int entry = tlb_LUT_w(addresse>>12);
+        if (entry)
+            return (entry&0xFFFFF000)|(addresse&0xFFF);
     }
     else
     {
-        if (tlb_LUT_r[addresse>>12])
-            return (tlb_LUT_r[addresse>>12]&0xFFFFF000)|(addresse&0xFFF);
+        unsigned int entry = tlb_LUT_r(addresse>>12);
+        if (entry)
+            return (entry&0xFFFFF000)|(addresse&0xFFF);
     }
     //printf("tlb exception !!! @ %x, %x, add:%x\n", addresse, w, PC->addr);
     //getchar();
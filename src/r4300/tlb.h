@@ -22,6 +22,8 @@
 #ifndef M64P_R4300_TLB_H
 #define M64P_R4300_TLB_H
 
+#include "osal/preproc.h"
+
 typedef struct _tlb
 {
    short mask;
@@ -48,8 +50,32 @@ typedef struct _tlb
 } tlb;
 
 extern tlb tlb_e[32];
-extern unsigned int tlb_LUT_r[0x100000];
-extern unsigned int tlb_LUT_w[0x100000];
+
+/* The lookup tables give, for each 4 KB virtual page, 0x80000000 | (physical
+ * address of the page + 0xFFF), or 0 if the page isn't mapped.  They're split
+ * into tables of TLB_LUT_TABLE_PAGES pages reached through a directory; the
+ * directory entries of the ranges without any mapping point to the same
+ * zeroed table, which is never written. */
+#define TLB_LUT_TABLE_SHIFT 10
+#define TLB_LUT_TABLE_PAGES (1 << TLB_LUT_TABLE_SHIFT)
+#define TLB_LUT_DIR_SIZE (0x100000 >> TLB_LUT_TABLE_SHIFT)
+
+extern unsigned int *tlb_LUT_dir_r[TLB_LUT_DIR_SIZE];
+extern unsigned int *tlb_LUT_dir_w[TLB_LUT_DIR_SIZE];
+
+static osal_inline unsigned int tlb_LUT_r(unsigned int page)
+{
+    return tlb_LUT_dir_r[page >> TLB_LUT_TABLE_SHIFT][page & (TLB_LUT_TABLE_PAGES - 1)];
+}
+
+static osal_inline unsigned int tlb_LUT_w(unsigned int page)
+{
+    return tlb_LUT_dir_w[page >> TLB_LUT_TABLE_SHIFT][page & (TLB_LUT_TABLE_PAGES - 1)];
+}
+
+void tlb_LUT_reset(void);
+void tlb_LUT_save(unsigned int *lut_r, unsigned int *lut_w);
+void tlb_LUT_load(const unsigned int *lut_r, const unsigned int *lut_w);
 
 void tlb_unmap(tlb *entry);
 void tlb_map(tlb *entry);
@@ -40,7 +40,7 @@ typedef struct _jump_table
 static jump_table *jumps_table = NULL;
 static int jumps_number, max_jumps_number;
 
-void init_assembler(void *block_jumps_table, int block_jumps_number, void *block_riprel_table, int block_riprel_number)
+void init_assembler(void *block_jumps_table, int block_jumps_number, void *block_riprel_table, int block_riprel_number, void *block_imm64_table, int block_imm64_number)
 {
    if (block_jumps_table)
    {
@@ -56,12 +56,14 @@ void init_assembler(void *block_jumps_table, int block_jumps_number, void *block
    }
 }
 
-void free_assembler(void **block_jumps_table, int *block_jumps_number, void **block_riprel_table, int *block_riprel_number)
+void free_assembler(void **block_jumps_table, int *block_jumps_number, void **block_riprel_table, int *block_riprel_number, void **block_imm64_table, int *block_imm64_number)
 {
    *block_jumps_table = jumps_table;
    *block_jumps_number = jumps_number;
    *block_riprel_table = NULL;  /* RIP-relative addressing is only for x86-64 */
    *block_riprel_number = 0;
+   *block_imm64_table = NULL;   /* only recorded by the x86-64 assembler */
+   *block_imm64_number = 0;
 }
 
 void add_jump(unsigned int pc_addr, unsigned int mi_addr)
@@ -85,15 +87,16 @@ void passe2(precomp_instr *dest, int start, int end, precomp_block *block)
    
    for (i=0; i < jumps_number; i++)
    {
+     precomp_instr_info *jump_info = get_instr_info(block, &dest[(jumps_table[i].mi_addr - dest[0].addr)/4]);
      code_length = jumps_table[i].pc_addr;
-     if (dest[(jumps_table[i].mi_addr - dest[0].addr)/4].reg_cache_infos.need_map)
+     if (jump_info->reg_cache_infos.need_map)
      {
-       addr_dest = (unsigned int)dest[(jumps_table[i].mi_addr - dest[0].addr)/4].reg_cache_infos.jump_wrapper;
+       addr_dest = (unsigned int)jump_info->reg_cache_infos.jump_wrapper;
        put32(addr_dest-((unsigned int)block->code+code_length)-4);
      }
      else
      {
-       addr_dest = dest[(jumps_table[i].mi_addr - dest[0].addr)/4].local_addr;
+       addr_dest = jump_info->local_addr;
        put32(addr_dest-code_length-4);
      }
    }
@@ -179,6 +179,14 @@ static osal_inline void add_m32_reg32(unsigned int *m32, int reg32)
    put32((unsigned int)(m32));
 }
 
+static osal_inline void adc_m32_imm8(unsigned int *m32, unsigned char imm8)
+{
+   put8(0x83);
+   put8(0x15);
+   put32((unsigned int)(m32));
+   put8(imm8);
+}
+
 static osal_inline void sub_reg32_m32(int reg32, unsigned int *m32)
 {
    put8(0x2B);
@@ -29,6 +29,7 @@
 #include "r4300/cached_interp.h"
 #include "r4300/cp0.h"
 #include "r4300/cp1.h"
+#include "r4300/idle_loop.h"
 #include "r4300/interupt.h"
 #include "r4300/ops.h"
 #include "r4300/recomph.h"
@@ -474,10 +475,12 @@ void genj_idle(void)
    mov_eax_memoffs32((unsigned int *)(&next_interupt));
    sub_reg32_m32(EAX, (unsigned int *)(&g_cp0_regs[CP0_COUNT_REG]));
    cmp_reg32_imm8(EAX, 3);
-   jbe_rj(11);
+   jbe_rj(24);
    
    and_eax_imm32(0xFFFFFFFC);  // 5
    add_m32_reg32((unsigned int *)(&g_cp0_regs[CP0_COUNT_REG]), EAX); // 6
+   add_m32_reg32((unsigned int *)(&g_IdleLoopCycles), EAX); // 6
+   adc_m32_imm8((unsigned int *)(&g_IdleLoopCycles) + 1, 0); // 7
   
    genj();
 #endif
@@ -561,10 +564,12 @@ void genjal_idle(void)
    mov_eax_memoffs32((unsigned int *)(&next_interupt));
    sub_reg32_m32(EAX, (unsigned int *)(&g_cp0_regs[CP0_COUNT_REG]));
    cmp_reg32_imm8(EAX, 3);
-   jbe_rj(11);
+   jbe_rj(24);
    
-   and_eax_imm32(0xFFFFFFFC);
-   add_m32_reg32((unsigned int *)(&g_cp0_regs[CP0_COUNT_REG]), EAX);
+   and_eax_imm32(0xFFFFFFFC); // 5
+   add_m32_reg32((unsigned int *)(&g_cp0_regs[CP0_COUNT_REG]), EAX); // 6
+   add_m32_reg32((unsigned int *)(&g_IdleLoopCycles), EAX); // 6
+   adc_m32_imm8((unsigned int *)(&g_IdleLoopCycles) + 1, 0); // 7
   
    genjal();
 #endif
@@ -660,11 +665,13 @@ void gentest_idle(void)
    mov_reg32_m32(reg, (unsigned int *)(&next_interupt));
    sub_reg32_m32(reg, (unsigned int *)(&g_cp0_regs[CP0_COUNT_REG]));
    cmp_reg32_imm8(reg, 5);
-   jbe_rj(18);
+   jbe_rj(31);
    
    sub_reg32_imm32(reg, 2); // 6
    and_reg32_imm32(reg, 0xFFFFFFFC); // 6
    add_m32_reg32((unsigned int *)(&g_cp0_regs[CP0_COUNT_REG]), reg); // 6
+   add_m32_reg32((unsigned int *)(&g_IdleLoopCycles), reg); // 6
+   adc_m32_imm8((unsigned int *)(&g_IdleLoopCycles) + 1, 0); // 7
    
    jump_end_rel32();
 }
@@ -157,13 +157,14 @@ void genjr(void)
 #ifdef INTERPRET_JR
    gencallinterp((unsigned int)cached_interpreter_table.JR, 1);
 #else
-   static unsigned int precomp_instr_size = sizeof(precomp_instr);
+   static unsigned int precomp_instr_info_size = sizeof(precomp_instr_info);
+   precomp_instr_info *dst_info = get_instr_info(dst_block, dst);
    unsigned int diff =
-     (unsigned int)(&dst->local_addr) - (unsigned int)(dst);
+     (unsigned int)(&dst_info->local_addr) - (unsigned int)(dst_info);
    unsigned int diff_need =
-     (unsigned int)(&dst->reg_cache_infos.need_map) - (unsigned int)(dst);
+     (unsigned int)(&dst_info->reg_cache_infos.need_map) - (unsigned int)(dst_info);
    unsigned int diff_wrap =
-     (unsigned int)(&dst->reg_cache_infos.jump_wrapper) - (unsigned int)(dst);
+     (unsigned int)(&dst_info->reg_cache_infos.jump_wrapper) - (unsigned int)(dst_info);
    
    if (((dst->addr & 0xFFF) == 0xFFC && 
        (dst->addr < 0x80000000 || dst->addr >= 0xC0000000))||no_compiled_jump)
@@ -202,16 +203,16 @@ void genjr(void)
    mov_reg32_reg32(EAX, EBX);
    sub_eax_imm32(dst_block->start);
    shr_reg32_imm8(EAX, 2);
-   mul_m32((unsigned int *)(&precomp_instr_size));
+   mul_m32((unsigned int *)(&precomp_instr_info_size));
    
-   mov_reg32_preg32pimm32(EBX, EAX, (unsigned int)(dst_block->block)+diff_need);
+   mov_reg32_preg32pimm32(EBX, EAX, (unsigned int)(dst_block->infos)+diff_need);
    cmp_reg32_imm32(EBX, 1);
    jne_rj(7);
    
-   add_eax_imm32((unsigned int)(dst_block->block)+diff_wrap); // 5
+   add_eax_imm32((unsigned int)(dst_block->infos)+diff_wrap); // 5
    jmp_reg32(EAX); // 2
    
-   mov_reg32_preg32pimm32(EAX, EAX, (unsigned int)(dst_block->block)+diff);
+   mov_reg32_preg32pimm32(EAX, EAX, (unsigned int)(dst_block->infos)+diff);
    add_reg32_m32(EAX, (unsigned int *)(&dst_block->code));
    
    jmp_reg32(EAX);
@@ -223,13 +224,14 @@ void genjalr(void)
 #ifdef INTERPRET_JALR
    gencallinterp((unsigned int)cached_interpreter_table.JALR, 0);
 #else
-   static unsigned int precomp_instr_size = sizeof(precomp_instr);
+   static unsigned int precomp_instr_info_size = sizeof(precomp_instr_info);
+   precomp_instr_info *dst_info = get_instr_info(dst_block, dst);
    unsigned int diff =
-     (unsigned int)(&dst->local_addr) - (unsigned int)(dst);
+     (unsigned int)(&dst_info->local_addr) - (unsigned int)(dst_info);
    unsigned int diff_need =
-     (unsigned int)(&dst->reg_cache_infos.need_map) - (unsigned int)(dst);
+     (unsigned int)(&dst_info->reg_cache_infos.need_map) - (unsigned int)(dst_info);
    unsigned int diff_wrap =
-     (unsigned int)(&dst->reg_cache_infos.jump_wrapper) - (unsigned int)(dst);
+     (unsigned int)(&dst_info->reg_cache_infos.jump_wrapper) - (unsigned int)(dst_info);
    
    if (((dst->addr & 0xFFF) == 0xFFC && 
        (dst->addr < 0x80000000 || dst->addr >= 0xC0000000))||no_compiled_jump)
@@ -274,16 +276,16 @@ void genjalr(void)
    mov_reg32_reg32(EAX, EBX);
    sub_eax_imm32(dst_block->start);
    shr_reg32_imm8(EAX, 2);
-   mul_m32((unsigned int *)(&precomp_instr_size));
+   mul_m32((unsigned int *)(&precomp_instr_info_size));
    
-   mov_reg32_preg32pimm32(EBX, EAX, (unsigned int)(dst_block->block)+diff_need);
+   mov_reg32_preg32pimm32(EBX, EAX, (unsigned int)(dst_block->infos)+diff_need);
    cmp_reg32_imm32(EBX, 1);
    jne_rj(7);
    
-   add_eax_imm32((unsigned int)(dst_block->block)+diff_wrap); // 5
+   add_eax_imm32((unsigned int)(dst_block->infos)+diff_wrap); // 5
    jmp_reg32(EAX); // 2
    
-   mov_reg32_preg32pimm32(EAX, EAX, (unsigned int)(dst_block->block)+diff);
+   mov_reg32_preg32pimm32(EAX, EAX, (unsigned int)(dst_block->infos)+diff);
    add_reg32_m32(EAX, (unsigned int *)(&dst_block->code));
    
    jmp_reg32(EAX);
@@ -34,6 +34,12 @@ static int dirty[8];
 static int r64[8];
 static unsigned int* r0;
 
+/* the needed_registers table of an instruction lives in the side table of the block being recompiled */
+static void **get_needed_registers(precomp_instr *instr)
+{
+   return get_instr_info(dst_block, instr)->reg_cache_infos.needed_registers;
+}
+
 void init_cache(precomp_instr* start)
 {
    int i;
@@ -63,7 +69,7 @@ void free_all_registers(void)
       {
          while (free_since[i] <= dst)
            {
-          free_since[i]->reg_cache_infos.needed_registers[i] = NULL;
+          get_needed_registers(free_since[i])[i] = NULL;
           free_since[i]++;
            }
       }
@@ -101,16 +107,16 @@ void free_register(int reg)
    while (last <= dst)
      {
     if (last_access[reg] != NULL && dirty[reg])
-      last->reg_cache_infos.needed_registers[reg] = reg_content[reg];
+      get_needed_registers(last)[reg] = reg_content[reg];
     else
-      last->reg_cache_infos.needed_registers[reg] = NULL;
+      get_needed_registers(last)[reg] = NULL;
     
     if (last_access[reg] != NULL && r64[reg] != -1)
       {
          if (dirty[r64[reg]])
-           last->reg_cache_infos.needed_registers[r64[reg]] = reg_content[r64[reg]];
+           get_needed_registers(last)[r64[reg]] = reg_content[r64[reg]];
          else
-           last->reg_cache_infos.needed_registers[r64[reg]] = NULL;
+           get_needed_registers(last)[r64[reg]] = NULL;
       }
     
     last++;
@@ -190,7 +196,7 @@ int allocate_register(unsigned int *addr)
           
           while (last <= dst)
             {
-               last->reg_cache_infos.needed_registers[i] = reg_content[i];
+               get_needed_registers(last)[i] = reg_content[i];
                last++;
             }
           last_access[i] = dst;
@@ -200,7 +206,7 @@ int allocate_register(unsigned int *addr)
                
                while (last <= dst)
              {
-                last->reg_cache_infos.needed_registers[r64[i]] = reg_content[r64[i]];
+                get_needed_registers(last)[r64[i]] = reg_content[r64[i]];
                 last++;
              }
                last_access[r64[i]] = dst;
@@ -226,7 +232,7 @@ int allocate_register(unsigned int *addr)
      {
     while (free_since[reg] <= dst)
       {
-         free_since[reg]->reg_cache_infos.needed_registers[reg] = NULL;
+         get_needed_registers(free_since[reg])[reg] = NULL;
          free_since[reg]++;
       }
      }
@@ -357,7 +363,7 @@ int allocate_register_w(unsigned int *addr)
          
          while (last <= dst)
            {
-          last->reg_cache_infos.needed_registers[i] = NULL;
+          get_needed_registers(last)[i] = NULL;
           last++;
            }
          last_access[i] = dst;
@@ -367,7 +373,7 @@ int allocate_register_w(unsigned int *addr)
           last = last_access[r64[i]]+1;
           while (last <= dst)
             {
-               last->reg_cache_infos.needed_registers[r64[i]] = NULL;
+               get_needed_registers(last)[r64[i]] = NULL;
                last++;
             }
           free_since[r64[i]] = dst+1;
@@ -394,7 +400,7 @@ int allocate_register_w(unsigned int *addr)
      {
     while (free_since[reg] <= dst)
       {
-         free_since[reg]->reg_cache_infos.needed_registers[reg] = NULL;
+         get_needed_registers(free_since[reg])[reg] = NULL;
          free_since[reg]++;
       }
      }
@@ -425,7 +431,7 @@ int allocate_64_register1_w(unsigned int *addr)
           {
             while (free_since[reg2] <= dst)
             {
-              free_since[reg2]->reg_cache_infos.needed_registers[reg2] = NULL;
+              get_needed_registers(free_since[reg2])[reg2] = NULL;
               free_since[reg2]++;
             }
           }
@@ -457,7 +463,7 @@ int allocate_64_register1_w(unsigned int *addr)
      {
     while (free_since[reg2] <= dst)
       {
-         free_since[reg2]->reg_cache_infos.needed_registers[reg2] = NULL;
+         get_needed_registers(free_since[reg2])[reg2] = NULL;
          free_since[reg2]++;
       }
      }
@@ -488,7 +494,7 @@ int allocate_64_register2_w(unsigned int *addr)
           {
             while (free_since[reg2] <= dst)
             {
-              free_since[reg2]->reg_cache_infos.needed_registers[reg2] = NULL;
+              get_needed_registers(free_since[reg2])[reg2] = NULL;
               free_since[reg2]++;
             }
           }
@@ -520,7 +526,7 @@ int allocate_64_register2_w(unsigned int *addr)
      {
     while (free_since[reg2] <= dst)
       {
-         free_since[reg2]->reg_cache_infos.needed_registers[reg2] = NULL;
+         get_needed_registers(free_since[reg2])[reg2] = NULL;
          free_since[reg2]++;
       }
      }
@@ -562,14 +568,14 @@ void force_32(int reg)
     while (last <= dst)
       {
          if (dirty[reg])
-           last->reg_cache_infos.needed_registers[reg] = reg_content[reg];
+           get_needed_registers(last)[reg] = reg_content[reg];
          else
-           last->reg_cache_infos.needed_registers[reg] = NULL;
+           get_needed_registers(last)[reg] = NULL;
          
          if (dirty[r64[reg]])
-           last->reg_cache_infos.needed_registers[r64[reg]] = reg_content[r64[reg]];
+           get_needed_registers(last)[r64[reg]] = reg_content[r64[reg]];
          else
-           last->reg_cache_infos.needed_registers[r64[reg]] = NULL;
+           get_needed_registers(last)[r64[reg]] = NULL;
          
          last++;
       }
@@ -596,7 +602,7 @@ void allocate_register_manually(int reg, unsigned int *addr)
          
     while (last <= dst)
       {
-         last->reg_cache_infos.needed_registers[reg] = reg_content[reg];
+         get_needed_registers(last)[reg] = reg_content[reg];
          last++;
       }
     last_access[reg] = dst;
@@ -606,7 +612,7 @@ void allocate_register_manually(int reg, unsigned int *addr)
          
          while (last <= dst)
            {
-          last->reg_cache_infos.needed_registers[r64[reg]] = reg_content[r64[reg]];
+          get_needed_registers(last)[r64[reg]] = reg_content[r64[reg]];
           last++;
            }
          last_access[r64[reg]] = dst;
@@ -619,7 +625,7 @@ void allocate_register_manually(int reg, unsigned int *addr)
      {
     while (free_since[reg] <= dst)
       {
-         free_since[reg]->reg_cache_infos.needed_registers[reg] = NULL;
+         get_needed_registers(free_since[reg])[reg] = NULL;
          free_since[reg]++;
       }
      }
@@ -633,7 +639,7 @@ void allocate_register_manually(int reg, unsigned int *addr)
          
          while (last <= dst)
            {
-          last->reg_cache_infos.needed_registers[i] = reg_content[i];
+          get_needed_registers(last)[i] = reg_content[i];
           last++;
            }
          last_access[i] = dst;
@@ -643,7 +649,7 @@ void allocate_register_manually(int reg, unsigned int *addr)
           
           while (last <= dst)
             {
-               last->reg_cache_infos.needed_registers[r64[i]] = reg_content[r64[i]];
+               get_needed_registers(last)[r64[i]] = reg_content[r64[i]];
                last++;
             }
           last_access[r64[i]] = dst;
@@ -686,7 +692,7 @@ void allocate_register_manually_w(int reg, unsigned int *addr, int load)
          
     while (last <= dst)
       {
-         last->reg_cache_infos.needed_registers[reg] = reg_content[reg];
+         get_needed_registers(last)[reg] = reg_content[reg];
          last++;
       }
     last_access[reg] = dst;
@@ -697,7 +703,7 @@ void allocate_register_manually_w(int reg, unsigned int *addr, int load)
          
          while (last <= dst)
            {
-          last->reg_cache_infos.needed_registers[r64[reg]] = reg_content[r64[reg]];
+          get_needed_registers(last)[r64[reg]] = reg_content[r64[reg]];
           last++;
            }
          last_access[r64[reg]] = NULL;
@@ -713,7 +719,7 @@ void allocate_register_manually_w(int reg, unsigned int *addr, int load)
      {
     while (free_since[reg] <= dst)
       {
-         free_since[reg]->reg_cache_infos.needed_registers[reg] = NULL;
+         get_needed_registers(free_since[reg])[reg] = NULL;
          free_since[reg]++;
       }
      }
@@ -727,7 +733,7 @@ void allocate_register_manually_w(int reg, unsigned int *addr, int load)
          
          while (last <= dst)
            {
-          last->reg_cache_infos.needed_registers[i] = reg_content[i];
+          get_needed_registers(last)[i] = reg_content[i];
           last++;
            }
          last_access[i] = dst;
@@ -736,7 +742,7 @@ void allocate_register_manually_w(int reg, unsigned int *addr, int load)
           last = last_access[r64[i]]+1;
           while (last <= dst)
             {
-               last->reg_cache_infos.needed_registers[r64[i]] = NULL;
+               get_needed_registers(last)[r64[i]] = NULL;
                last++;
             }
           free_since[r64[i]] = dst+1;
@@ -784,7 +790,7 @@ void allocate_register_manually_w(int reg, unsigned int *addr, int load)
 // 0x8B (reg<<3)|5 0xXXXXXXXX mov edi, [XXXXXXXX]
 // 0xC3 ret
 // total : 62 bytes
-static void build_wrapper(precomp_instr *instr, unsigned char* code, precomp_block* block)
+static void build_wrapper(precomp_instr_info *info, unsigned char* code, precomp_block* block)
 {
    int i;
    int j=0;
@@ -808,7 +814,7 @@ static void build_wrapper(precomp_instr *instr, unsigned char* code, precomp_blo
    j+=4;
    
    code[j++] = 0x05;
-   *((unsigned int*)&code[j]) = (unsigned int)instr->local_addr;
+   *((unsigned int*)&code[j]) = (unsigned int)info->local_addr;
    j+=4;
    
    code[j++] = 0x89;
@@ -817,12 +823,12 @@ static void build_wrapper(precomp_instr *instr, unsigned char* code, precomp_blo
    
    for (i=0; i<8; i++)
      {
-    if (instr->reg_cache_infos.needed_registers[i] != NULL)
+    if (info->reg_cache_infos.needed_registers[i] != NULL)
       {
          code[j++] = 0x8B;
          code[j++] = (i << 3) | 5;
          *((unsigned int*)&code[j]) =
-                 (unsigned int)instr->reg_cache_infos.needed_registers[i];
+                 (unsigned int)info->reg_cache_infos.needed_registers[i];
          j+=4;
       }
      }
@@ -835,13 +841,14 @@ void build_wrappers(precomp_instr *instr, int start, int end, precomp_block* blo
    int i, reg;;
    for (i=start; i<end; i++)
      {
-    instr[i].reg_cache_infos.need_map = 0;
+    precomp_instr_info *info = get_instr_info(block, &instr[i]);
+    info->reg_cache_infos.need_map = 0;
     for (reg=0; reg<8; reg++)
       {
-         if (instr[i].reg_cache_infos.needed_registers[reg] != NULL)
+         if (info->reg_cache_infos.needed_registers[reg] != NULL)
            {
-          instr[i].reg_cache_infos.need_map = 1;
-          build_wrapper(&instr[i], instr[i].reg_cache_infos.jump_wrapper, block);
+          info->reg_cache_infos.need_map = 1;
+          build_wrapper(info, info->reg_cache_infos.jump_wrapper, block);
           break;
            }
       }
@@ -851,7 +858,7 @@ void build_wrappers(precomp_instr *instr, int start, int end, precomp_block* blo
 void simplify_access(void)
 {
    int i;
-   dst->local_addr = code_length;
-   for(i=0; i<8; i++) dst->reg_cache_infos.needed_registers[i] = NULL;
+   get_instr_info(dst_block, dst)->local_addr = code_length;
+   for(i=0; i<8; i++) get_needed_registers(dst)[i] = NULL;
 }
 
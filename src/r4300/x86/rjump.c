@@ -48,16 +48,19 @@ static unsigned long *return_address ASM_NAME("return_address");
 
 void dyna_jump()
 {
+    precomp_instr_info *info;
+
     if (stop == 1)
     {
         dyna_stop();
         return;
     }
 
-    if (PC->reg_cache_infos.need_map)
-        *return_address = (unsigned long) (PC->reg_cache_infos.jump_wrapper);
+    info = get_instr_info(actual, PC);
+    if (info->reg_cache_infos.need_map)
+        *return_address = (unsigned long) (info->reg_cache_infos.jump_wrapper);
     else
-        *return_address = (unsigned long) (actual->code + PC->local_addr);
+        *return_address = (unsigned long) (actual->code + info->local_addr);
 }
 
 #if defined(WIN32) && !defined(__GNUC__) /* this warning disable only works if placed outside of the scope of a function */
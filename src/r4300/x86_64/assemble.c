@@ -37,25 +37,16 @@
 */
 #define REL_PLACEHOLDER 0x7fffffff
 
-typedef struct _jump_table
-{
-  unsigned int mi_addr;
-  unsigned int pc_addr;
-  unsigned int absolute64;
-} jump_table;
-
-static jump_table *jumps_table = NULL;
-static int jumps_number = 0, max_jumps_number = 0;
+static osal_thread_local jump_table *jumps_table = NULL;
+static osal_thread_local int jumps_number = 0, max_jumps_number = 0;
 
-typedef struct _riprelative_table
-{
-  unsigned int   pc_addr;     /* index in bytes from start of x86_64 code block to the displacement value to write */
-  unsigned int   extra_bytes; /* number of remaining instruction bytes (immediate data) after 4-byte displacement */
-  unsigned char *global_dst;  /* 64-bit pointer to the data object */
-} riprelative_table;
+static osal_thread_local riprelative_table *riprel_table = NULL;
+static osal_thread_local int riprel_number = 0, max_riprel_number = 0;
 
-static riprelative_table *riprel_table = NULL;
-static int riprel_number = 0, max_riprel_number = 0;
+/* index in bytes from start of x86_64 code block of every 64-bit immediate, so
+ * that the host pointers among them can be relocated by the translation cache */
+static osal_thread_local unsigned int *imm64_table = NULL;
+static osal_thread_local int imm64_number = 0, max_imm64_number = 0;
 
 /* Static Functions */
 
@@ -72,9 +63,19 @@ void add_jump(unsigned int pc_addr, unsigned int mi_addr, unsigned int absolute6
   jumps_number++;
 }
 
+void add_imm64(unsigned int pc_addr)
+{
+  if (imm64_number == max_imm64_number)
+  {
+    max_imm64_number += 512;
+    imm64_table = realloc(imm64_table, max_imm64_number*sizeof(unsigned int));
+  }
+  imm64_table[imm64_number++] = pc_addr;
+}
+
 /* Global Functions */
 
-void init_assembler(void *block_jumps_table, int block_jumps_number, void *block_riprel_table, int block_riprel_number)
+void init_assembler(void *block_jumps_table, int block_jumps_number, void *block_riprel_table, int block_riprel_number, void *block_imm64_table, int block_imm64_number)
 {
   if (block_jumps_table)
   {
@@ -107,14 +108,32 @@ void init_assembler(void *block_jumps_table, int block_jumps_number, void *block
     riprel_number = 0;
     max_riprel_number = 512;
   }
+
+  if (block_imm64_table)
+  {
+    imm64_table = block_imm64_table;
+    imm64_number = block_imm64_number;
+    if (imm64_number <= 512)
+      max_imm64_number = 512;
+    else
+      max_imm64_number = (imm64_number + 511) & 0xfffffe00;
+  }
+  else
+  {
+    imm64_table = malloc(512 * sizeof(unsigned int));
+    imm64_number = 0;
+    max_imm64_number = 512;
+  }
 }
 
-void free_assembler(void **block_jumps_table, int *block_jumps_number, void **block_riprel_table, int *block_riprel_number)
+void free_assembler(void **block_jumps_table, int *block_jumps_number, void **block_riprel_table, int *block_riprel_number, void **block_imm64_table, int *block_imm64_number)
 {
   *block_jumps_table = jumps_table;
   *block_jumps_number = jumps_number;
   *block_riprel_table = riprel_table;
   *block_riprel_number = riprel_number;
+  *block_imm64_table = imm64_table;
+  *block_imm64_number = imm64_number;
 }
 
 void passe2(precomp_instr *dest, int start, int end, precomp_block *block)
@@ -130,17 +149,17 @@ void passe2(precomp_instr *dest, int start, int end, precomp_block *block)
    */
   for (i = 0; i < jumps_number; i++)
   {
-    precomp_instr *jump_instr = dest + ((jumps_table[i].mi_addr - dest[0].addr) / 4);
+    precomp_instr_info *jump_info = get_instr_info(block, dest + ((jumps_table[i].mi_addr - dest[0].addr) / 4));
     unsigned int   jmp_offset_loc = jumps_table[i].pc_addr;
     unsigned char *addr_dest = NULL;
     /* calculate the destination address to jump to */
-    if (jump_instr->reg_cache_infos.need_map)
+    if (jump_info->reg_cache_infos.need_map)
     {
-      addr_dest = jump_instr->reg_cache_infos.jump_wrapper;
+      addr_dest = jump_info->reg_cache_infos.jump_wrapper;
     }
     else
     {
-      addr_dest = block->code + jump_instr->local_addr;
+      addr_dest = block->code + jump_info->local_addr;
     }
     /* write either a 32-bit IP-relative offset or a 64-bit absolute address */
     if (jumps_table[i].absolute64)
@@ -179,8 +198,8 @@ void passe2(precomp_instr *dest, int start, int end, precomp_block *block)
 
 }
 
-static unsigned int g_jump_start8 = 0;
-static unsigned int g_jump_start32 = 0;
+static osal_thread_local unsigned int g_jump_start8 = 0;
+static osal_thread_local unsigned int g_jump_start32 = 0;
 
 void jump_start_rel8(void)
 {
@@ -67,6 +67,15 @@ extern long long int reg[32];
 #define DH 6
 #define BH 7
 
+#define XMM0 0
+#define XMM1 1
+#define XMM2 2
+#define XMM3 3
+#define XMM4 4
+#define XMM5 5
+#define XMM6 6
+#define XMM7 7
+
 extern int branch_taken;
 
 void jump_start_rel8(void);
@@ -74,6 +83,7 @@ void jump_end_rel8(void);
 void jump_start_rel32(void);
 void jump_end_rel32(void);
 void add_jump(unsigned int pc_addr, unsigned int mi_addr, unsigned int absolute64);
+void add_imm64(unsigned int pc_addr);
 
 static inline void put8(unsigned char octet)
 {
@@ -104,6 +114,7 @@ static inline void put64(unsigned long long qword)
     *inst_pointer = realloc_exec(*inst_pointer, max_code_length, max_code_length+8192);
     max_code_length += 8192;
   }
+  add_imm64(code_length);
   *((unsigned long long *) (*inst_pointer + code_length)) = qword;
   code_length += 8;
 }
@@ -327,6 +338,54 @@ static inline void setb_reg8(unsigned int reg8)
    put8(0xC0 | reg8);
 }
 
+static inline void setae_reg8(unsigned int reg8)
+{
+   put8(0x40);  /* we need an REX prefix to use the uniform byte registers */
+   put8(0x0F);
+   put8(0x93);
+   put8(0xC0 | reg8);
+}
+
+static inline void sete_reg8(unsigned int reg8)
+{
+   put8(0x40);  /* we need an REX prefix to use the uniform byte registers */
+   put8(0x0F);
+   put8(0x94);
+   put8(0xC0 | reg8);
+}
+
+static inline void setbe_reg8(unsigned int reg8)
+{
+   put8(0x40);  /* we need an REX prefix to use the uniform byte registers */
+   put8(0x0F);
+   put8(0x96);
+   put8(0xC0 | reg8);
+}
+
+static inline void seta_reg8(unsigned int reg8)
+{
+   put8(0x40);  /* we need an REX prefix to use the uniform byte registers */
+   put8(0x0F);
+   put8(0x97);
+   put8(0xC0 | reg8);
+}
+
+static inline void setp_reg8(unsigned int reg8)
+{
+   put8(0x40);  /* we need an REX prefix to use the uniform byte registers */
+   put8(0x0F);
+   put8(0x9A);
+   put8(0xC0 | reg8);
+}
+
+static inline void setnp_reg8(unsigned int reg8)
+{
+   put8(0x40);  /* we need an REX prefix to use the uniform byte registers */
+   put8(0x0F);
+   put8(0x9B);
+   put8(0xC0 | reg8);
+}
+
 static inline void test_m32rel_imm32(unsigned int *m32, unsigned int imm32)
 {
    int offset = rel_r15_offset(m32, "test_m32rel_imm32");
@@ -348,6 +407,16 @@ static inline void add_m32rel_xreg32(unsigned int *m32, int xreg32)
    put32(offset);
 }
 
+static inline void add_m64rel_xreg64(unsigned long long *m64, int xreg64)
+{
+   int offset = rel_r15_offset(m64, "add_m64rel_xreg64");
+
+   put8(0x49 | ((xreg64 & 8) >> 1));
+   put8(0x01);
+   put8(0x87 | ((xreg64 & 7) << 3));
+   put32(offset);
+}
+
 static inline void sub_xreg32_m32rel(int xreg32, unsigned int *m32)
 {
    int offset = rel_r15_offset(m32, "sub_xreg32_m32rel");
@@ -447,6 +516,20 @@ static inline void jmp_imm_short(char saut)
    put8(saut);
 }
 
+static inline void jmp_imm(int saut)
+{
+   put8(0xE9);
+   put32(saut);
+}
+
+static inline void lea_reg64_rip_imm32(int reg64, int imm32)
+{
+   put8(0x48);
+   put8(0x8D);
+   put8(0x05 | (reg64 << 3));
+   put32(imm32);
+}
+
 static inline void or_m32rel_imm32(unsigned int *m32, unsigned int imm32)
 {
    int offset = rel_r15_offset(m32, "or_m32rel_imm32");
@@ -717,6 +800,13 @@ static inline void mov_reg64_preg64(int reg1, int reg2)
    put8((reg1 << 3) | reg2);
 }
 
+static inline void mov_preg64_reg64(int reg1, int reg2)
+{
+   put8(0x48);
+   put8(0x89);
+   put8((reg2 << 3) | reg1);
+}
+
 static inline void mov_reg32_preg64preg64pimm32(int reg1, int reg2, int reg3, unsigned int imm32)
 {
    put8(0x8B);
@@ -919,6 +1009,16 @@ static inline void mov_xreg8_m8rel(int xreg8, unsigned char *m8)
    put32(offset);
 }
 
+static inline void or_xreg8_m8rel(int xreg8, unsigned char *m8)
+{
+   int offset = rel_r15_offset(m8, "or_xreg8_m8rel");
+
+   put8(0x41 | ((xreg8 & 8) >> 1));
+   put8(0x0A);
+   put8(0x87 | ((xreg8 & 7) << 3));
+   put32(offset);
+}
+
 static inline void and_eax_imm32(unsigned int imm32)
 {
    put8(0x25);
@@ -1179,5 +1279,341 @@ static inline void ffree_fpreg(int fpreg)
    put8(0xC0 + fpreg);
 }
 
+static inline void movss_xmm_preg64(int xmm, int reg64)
+{
+   put8(0xF3);
+   put8(0x0F);
+   put8(0x10);
+   put8((xmm << 3) | reg64);
+}
+
+static inline void movss_preg64_xmm(int reg64, int xmm)
+{
+   put8(0xF3);
+   put8(0x0F);
+   put8(0x11);
+   put8((xmm << 3) | reg64);
+}
+
+static inline void movsd_xmm_preg64(int xmm, int reg64)
+{
+   put8(0xF2);
+   put8(0x0F);
+   put8(0x10);
+   put8((xmm << 3) | reg64);
+}
+
+static inline void movsd_preg64_xmm(int reg64, int xmm)
+{
+   put8(0xF2);
+   put8(0x0F);
+   put8(0x11);
+   put8((xmm << 3) | reg64);
+}
+
+static inline void movaps_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0x0F);
+   put8(0x28);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void addss_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0xF3);
+   put8(0x0F);
+   put8(0x58);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void subss_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0xF3);
+   put8(0x0F);
+   put8(0x5C);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void mulss_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0xF3);
+   put8(0x0F);
+   put8(0x59);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void divss_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0xF3);
+   put8(0x0F);
+   put8(0x5E);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void sqrtss_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0xF3);
+   put8(0x0F);
+   put8(0x51);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void addsd_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0xF2);
+   put8(0x0F);
+   put8(0x58);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void subsd_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0xF2);
+   put8(0x0F);
+   put8(0x5C);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void mulsd_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0xF2);
+   put8(0x0F);
+   put8(0x59);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void divsd_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0xF2);
+   put8(0x0F);
+   put8(0x5E);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void sqrtsd_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0xF2);
+   put8(0x0F);
+   put8(0x51);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void andps_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0x0F);
+   put8(0x54);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void xorps_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0x0F);
+   put8(0x57);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void pcmpeqd_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0x66);
+   put8(0x0F);
+   put8(0x76);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void pslld_xmm_imm8(int xmm, unsigned char imm8)
+{
+   put8(0x66);
+   put8(0x0F);
+   put8(0x72);
+   put8(0xF0 | xmm);
+   put8(imm8);
+}
+
+static inline void psrld_xmm_imm8(int xmm, unsigned char imm8)
+{
+   put8(0x66);
+   put8(0x0F);
+   put8(0x72);
+   put8(0xD0 | xmm);
+   put8(imm8);
+}
+
+static inline void psllq_xmm_imm8(int xmm, unsigned char imm8)
+{
+   put8(0x66);
+   put8(0x0F);
+   put8(0x73);
+   put8(0xF0 | xmm);
+   put8(imm8);
+}
+
+static inline void psrlq_xmm_imm8(int xmm, unsigned char imm8)
+{
+   put8(0x66);
+   put8(0x0F);
+   put8(0x73);
+   put8(0xD0 | xmm);
+   put8(imm8);
+}
+
+static inline void cvtss2sd_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0xF3);
+   put8(0x0F);
+   put8(0x5A);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void cvtsd2ss_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0xF2);
+   put8(0x0F);
+   put8(0x5A);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void cvtsi2ss_xmm_preg64_dword(int xmm, int reg64)
+{
+   put8(0xF3);
+   put8(0x0F);
+   put8(0x2A);
+   put8((xmm << 3) | reg64);
+}
+
+static inline void cvtsi2ss_xmm_preg64_qword(int xmm, int reg64)
+{
+   put8(0xF3);
+   put8(0x48);
+   put8(0x0F);
+   put8(0x2A);
+   put8((xmm << 3) | reg64);
+}
+
+static inline void cvtsi2sd_xmm_preg64_dword(int xmm, int reg64)
+{
+   put8(0xF2);
+   put8(0x0F);
+   put8(0x2A);
+   put8((xmm << 3) | reg64);
+}
+
+static inline void cvtsi2sd_xmm_preg64_qword(int xmm, int reg64)
+{
+   put8(0xF2);
+   put8(0x48);
+   put8(0x0F);
+   put8(0x2A);
+   put8((xmm << 3) | reg64);
+}
+
+static inline void cvtss2si_reg32_xmm(int reg32, int xmm)
+{
+   put8(0xF3);
+   put8(0x0F);
+   put8(0x2D);
+   put8(0xC0 | (reg32 << 3) | xmm);
+}
+
+static inline void cvtss2si_reg64_xmm(int reg64, int xmm)
+{
+   put8(0xF3);
+   put8(0x48);
+   put8(0x0F);
+   put8(0x2D);
+   put8(0xC0 | (reg64 << 3) | xmm);
+}
+
+static inline void cvttss2si_reg32_xmm(int reg32, int xmm)
+{
+   put8(0xF3);
+   put8(0x0F);
+   put8(0x2C);
+   put8(0xC0 | (reg32 << 3) | xmm);
+}
+
+static inline void cvttss2si_reg64_xmm(int reg64, int xmm)
+{
+   put8(0xF3);
+   put8(0x48);
+   put8(0x0F);
+   put8(0x2C);
+   put8(0xC0 | (reg64 << 3) | xmm);
+}
+
+static inline void cvtsd2si_reg32_xmm(int reg32, int xmm)
+{
+   put8(0xF2);
+   put8(0x0F);
+   put8(0x2D);
+   put8(0xC0 | (reg32 << 3) | xmm);
+}
+
+static inline void cvtsd2si_reg64_xmm(int reg64, int xmm)
+{
+   put8(0xF2);
+   put8(0x48);
+   put8(0x0F);
+   put8(0x2D);
+   put8(0xC0 | (reg64 << 3) | xmm);
+}
+
+static inline void cvttsd2si_reg32_xmm(int reg32, int xmm)
+{
+   put8(0xF2);
+   put8(0x0F);
+   put8(0x2C);
+   put8(0xC0 | (reg32 << 3) | xmm);
+}
+
+static inline void cvttsd2si_reg64_xmm(int reg64, int xmm)
+{
+   put8(0xF2);
+   put8(0x48);
+   put8(0x0F);
+   put8(0x2C);
+   put8(0xC0 | (reg64 << 3) | xmm);
+}
+
+static inline void ucomiss_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0x0F);
+   put8(0x2E);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void ucomisd_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0x66);
+   put8(0x0F);
+   put8(0x2E);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void comiss_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0x0F);
+   put8(0x2F);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void comisd_xmm_xmm(int xmm1, int xmm2)
+{
+   put8(0x66);
+   put8(0x0F);
+   put8(0x2F);
+   put8(0xC0 | (xmm1 << 3) | xmm2);
+}
+
+static inline void ldmxcsr_m32rel(unsigned int *m32)
+{
+   int offset = rel_r15_offset(m32, "ldmxcsr_m32rel");
+
+   put8(0x41);
+   put8(0x0F);
+   put8(0xAE);
+   put8(0x97);
+   put32(offset);
+}
+
 #endif /* M64P_R4300_ASSEMBLE_H */
 
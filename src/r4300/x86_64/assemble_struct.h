@@ -31,4 +31,18 @@ typedef struct _reg_cache_struct
    int need_cop1_check;
 } reg_cache_struct;
 
+typedef struct _jump_table
+{
+  unsigned int mi_addr;
+  unsigned int pc_addr;
+  unsigned int absolute64;
+} jump_table;
+
+typedef struct _riprelative_table
+{
+  unsigned int   pc_addr;     /* index in bytes from start of x86_64 code block to the displacement value to write */
+  unsigned int   extra_bytes; /* number of remaining instruction bytes (immediate data) after 4-byte displacement */
+  unsigned char *global_dst;  /* 64-bit pointer to the data object */
+} riprelative_table;
+
 #endif /* M64P_R4300_ASSEMBLE_STRUCT_H */
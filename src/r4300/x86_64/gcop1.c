@@ -153,6 +153,23 @@ void genctc1(void)
    
    mov_m32rel_imm32((unsigned int*)&rounding_mode, 0x73F); // 11
    
+   if (sse2_fpu)
+   {
+      /* the MXCSR rounding control of FCR31 rounding mode m is (-m) & 3,
+       * it is loaded by the rounding COP1 operations only when it differs
+       * from the host one */
+      mov_xreg32_m32rel(EAX, (unsigned int*)&FCR31);
+      neg_reg32(EAX);
+      and_eax_imm32(3);
+      shl_reg32_imm8(EAX, 13);
+      mov_xreg32_m32rel(EDX, &round_mxcsr);
+      or_reg64_reg64(RAX, RDX);
+      mov_m32rel_xreg32(&rounding_mxcsr, EAX);
+      cmp_xreg32_m32rel(EAX, &host_mxcsr);
+      setne_m8rel((unsigned char*)&rounding_mxcsr_differs);
+      return;
+   }
+
    fldcw_m16rel((unsigned short*)&rounding_mode);
 #endif
 }
@@ -34,6 +34,148 @@
 #include "r4300/instr_counters.h"
 #endif
 
+/* SSE2 code generation, used instead of the x87 code when sse2_fpu is set.
+ * The operands are taken from the XMM register cache and the results are
+ * written back to the FPRs and kept cached for the next instructions. */
+
+static void sse_abs_d(int xmm1, int xmm2)
+{
+   pcmpeqd_xmm_xmm(xmm1, xmm1);
+   psrlq_xmm_imm8(xmm1, 1);
+   andps_xmm_xmm(xmm1, xmm2);
+}
+
+static void sse_neg_d(int xmm1, int xmm2)
+{
+   pcmpeqd_xmm_xmm(xmm1, xmm1);
+   psllq_xmm_imm8(xmm1, 63);
+   xorps_xmm_xmm(xmm1, xmm2);
+}
+
+static void gen_sse_arith_d(void (*op)(int, int))
+{
+   int fs, ft, fd;
+
+   begin_xmm_instruction();
+   fs = allocate_xmm_register(dst->f.cf.fs, 1);
+   ft = allocate_xmm_register(dst->f.cf.ft, 1);
+   fd = allocate_xmm_temp();
+   movaps_xmm_xmm(fd, fs);
+   begin_xmm_rounding();
+   op(fd, ft);
+   end_xmm_rounding();
+   bind_xmm_register(fd, dst->f.cf.fd, 1);
+   end_xmm_instruction();
+}
+
+/* the FCR31 rounding mode is only loaded if rounded is set */
+static void gen_sse_unary_d(void (*op)(int, int), int rounded)
+{
+   int fs, fd;
+
+   begin_xmm_instruction();
+   fs = allocate_xmm_register(dst->f.cf.fs, 1);
+   fd = allocate_xmm_temp();
+   if (rounded)
+      begin_xmm_rounding();
+   op(fd, fs);
+   if (rounded)
+      end_xmm_rounding();
+   bind_xmm_register(fd, dst->f.cf.fd, 1);
+   end_xmm_instruction();
+}
+
+static void gen_sse_cvt_s_d(void)
+{
+   int fs, fd;
+
+   begin_xmm_instruction();
+   fs = allocate_xmm_register(dst->f.cf.fs, 1);
+   fd = allocate_xmm_temp();
+   begin_xmm_rounding();
+   cvtsd2ss_xmm_xmm(fd, fs);
+   end_xmm_rounding();
+   bind_xmm_register(fd, dst->f.cf.fd, 0);
+   end_xmm_instruction();
+}
+
+/* converts to a word or long integer, truncating or rounding as given by
+ * mxcsr, or by the FCR31 rounding mode if mxcsr is NULL */
+static void gen_sse_to_int_d(unsigned int *mxcsr, int truncate, int is_long)
+{
+   int fs;
+
+   begin_xmm_instruction();
+   fs = allocate_xmm_register(dst->f.cf.fs, 1);
+   if (mxcsr != NULL)
+      ldmxcsr_m32rel(mxcsr);
+   else if (!truncate)
+      begin_xmm_rounding();
+   if (is_long)
+   {
+      if (truncate)
+         cvttsd2si_reg64_xmm(RDX, fs);
+      else
+         cvtsd2si_reg64_xmm(RDX, fs);
+      mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fd]));
+      mov_preg64_reg64(RAX, RDX);
+   }
+   else
+   {
+      if (truncate)
+         cvttsd2si_reg32_xmm(EDX, fs);
+      else
+         cvtsd2si_reg32_xmm(EDX, fs);
+      mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fd]));
+      mov_preg64_reg32(RAX, EDX);
+   }
+   if (mxcsr != NULL)
+      ldmxcsr_m32rel(&host_mxcsr);
+   else if (!truncate)
+      end_xmm_rounding();
+   free_xmm_fpr(dst->f.cf.fd);
+   end_xmm_instruction();
+}
+
+/* sets the FCR31 condition bit to the flag given by setcc after comparing
+ * fs to ft (or ft to fs if swap is set), and also requires the operands to
+ * be ordered if ordered is set. The condition is always false if setcc is
+ * NULL. The signaling compares only differ by raising the invalid
+ * operation exception on any NaN, which is masked in MXCSR. */
+static void gen_sse_compare_d(void (*setcc)(unsigned int), int swap, int ordered, int signaling)
+{
+   int fs, ft;
+
+   begin_xmm_instruction();
+   if (setcc == NULL)
+   {
+      and_m32rel_imm32((unsigned int*)&FCR31, ~0x800000);
+      end_xmm_instruction();
+      return;
+   }
+
+   fs = allocate_xmm_register(dst->f.cf.fs, 1);
+   ft = allocate_xmm_register(dst->f.cf.ft, 1);
+   xor_reg32_reg32(EDX, EDX);
+   xor_reg32_reg32(ECX, ECX);
+   if (signaling)
+      comisd_xmm_xmm(swap ? ft : fs, swap ? fs : ft);
+   else
+      ucomisd_xmm_xmm(swap ? ft : fs, swap ? fs : ft);
+   setcc(DL);
+   if (ordered)
+   {
+      setnp_reg8(CL);
+      and_reg64_reg64(RDX, RCX);
+   }
+   shl_reg32_imm8(EDX, 23);
+   mov_xreg32_m32rel(EAX, (unsigned int*)&FCR31);
+   and_eax_imm32(~0x800000);
+   or_reg64_reg64(RAX, RDX);
+   mov_m32rel_xreg32((unsigned int*)&FCR31, EAX);
+   end_xmm_instruction();
+}
+
 void genadd_d(void)
 {
 #if defined(COUNT_INSTR)
@@ -42,6 +184,12 @@ void genadd_d(void)
 #ifdef INTERPRET_ADD_D
     gencallinterp((unsigned long long)cached_interpreter_table.ADD_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_arith_d(addsd_xmm_xmm);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg64_qword(RAX);
@@ -60,6 +208,12 @@ void gensub_d(void)
 #ifdef INTERPRET_SUB_D
    gencallinterp((unsigned long long)cached_interpreter_table.SUB_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_arith_d(subsd_xmm_xmm);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg64_qword(RAX);
@@ -78,6 +232,12 @@ void genmul_d(void)
 #ifdef INTERPRET_MUL_D
    gencallinterp((unsigned long long)cached_interpreter_table.MUL_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_arith_d(mulsd_xmm_xmm);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg64_qword(RAX);
@@ -96,6 +256,12 @@ void gendiv_d(void)
 #ifdef INTERPRET_DIV_D
    gencallinterp((unsigned long long)cached_interpreter_table.DIV_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_arith_d(divsd_xmm_xmm);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg64_qword(RAX);
@@ -114,6 +280,12 @@ void gensqrt_d(void)
 #ifdef INTERPRET_SQRT_D
    gencallinterp((unsigned long long)cached_interpreter_table.SQRT_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_unary_d(sqrtsd_xmm_xmm, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg64_qword(RAX);
@@ -131,6 +303,12 @@ void genabs_d(void)
 #ifdef INTERPRET_ABS_D
    gencallinterp((unsigned long long)cached_interpreter_table.ABS_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_unary_d(sse_abs_d, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg64_qword(RAX);
@@ -148,6 +326,12 @@ void genmov_d(void)
 #ifdef INTERPRET_MOV_D
    gencallinterp((unsigned long long)cached_interpreter_table.MOV_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_unary_d(movaps_xmm_xmm, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
    mov_reg32_preg64(EBX, RAX);
@@ -166,6 +350,12 @@ void genneg_d(void)
 #ifdef INTERPRET_NEG_D
    gencallinterp((unsigned long long)cached_interpreter_table.NEG_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_unary_d(sse_neg_d, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg64_qword(RAX);
@@ -183,6 +373,12 @@ void genround_l_d(void)
 #ifdef INTERPRET_ROUND_L_D
    gencallinterp((unsigned long long)cached_interpreter_table.ROUND_L_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_d(&round_mxcsr, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&round_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
@@ -201,6 +397,12 @@ void gentrunc_l_d(void)
 #ifdef INTERPRET_TRUNC_L_D
    gencallinterp((unsigned long long)cached_interpreter_table.TRUNC_L_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_d(NULL, 1, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&trunc_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
@@ -219,6 +421,12 @@ void genceil_l_d(void)
 #ifdef INTERPRET_CEIL_L_D
    gencallinterp((unsigned long long)cached_interpreter_table.CEIL_L_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_d(&ceil_mxcsr, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&ceil_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
@@ -237,6 +445,12 @@ void genfloor_l_d(void)
 #ifdef INTERPRET_FLOOR_L_D
    gencallinterp((unsigned long long)cached_interpreter_table.FLOOR_L_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_d(&floor_mxcsr, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&floor_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
@@ -255,6 +469,12 @@ void genround_w_d(void)
 #ifdef INTERPRET_ROUND_W_D
    gencallinterp((unsigned long long)cached_interpreter_table.ROUND_W_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_d(&round_mxcsr, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&round_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
@@ -273,6 +493,12 @@ void gentrunc_w_d(void)
 #ifdef INTERPRET_TRUNC_W_D
    gencallinterp((unsigned long long)cached_interpreter_table.TRUNC_W_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_d(NULL, 1, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&trunc_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
@@ -291,6 +517,12 @@ void genceil_w_d(void)
 #ifdef INTERPRET_CEIL_W_D
    gencallinterp((unsigned long long)cached_interpreter_table.CEIL_W_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_d(&ceil_mxcsr, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&ceil_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
@@ -309,6 +541,12 @@ void genfloor_w_d(void)
 #ifdef INTERPRET_FLOOR_W_D
    gencallinterp((unsigned long long)cached_interpreter_table.FLOOR_W_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_d(&floor_mxcsr, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&floor_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
@@ -327,6 +565,12 @@ void gencvt_s_d(void)
 #ifdef INTERPRET_CVT_S_D
    gencallinterp((unsigned long long)cached_interpreter_table.CVT_S_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_cvt_s_d();
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg64_qword(RAX);
@@ -343,6 +587,12 @@ void gencvt_w_d(void)
 #ifdef INTERPRET_CVT_W_D
    gencallinterp((unsigned long long)cached_interpreter_table.CVT_W_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_d(NULL, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg64_qword(RAX);
@@ -359,6 +609,12 @@ void gencvt_l_d(void)
 #ifdef INTERPRET_CVT_L_D
    gencallinterp((unsigned long long)cached_interpreter_table.CVT_L_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_d(NULL, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
    fld_preg64_qword(RAX);
@@ -375,6 +631,12 @@ void genc_f_d(void)
 #ifdef INTERPRET_C_F_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_F_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(NULL, 0, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    and_m32rel_imm32((unsigned int*)&FCR31, ~0x800000);
 #endif
@@ -388,6 +650,12 @@ void genc_un_d(void)
 #ifdef INTERPRET_C_UN_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_UN_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(setp_reg8, 0, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -410,6 +678,12 @@ void genc_eq_d(void)
 #ifdef INTERPRET_C_EQ_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_EQ_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(sete_reg8, 0, 1, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -432,6 +706,12 @@ void genc_ueq_d(void)
 #ifdef INTERPRET_C_UEQ_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_UEQ_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(sete_reg8, 0, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -455,6 +735,12 @@ void genc_olt_d(void)
 #ifdef INTERPRET_C_OLT_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_OLT_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(seta_reg8, 1, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -477,6 +763,12 @@ void genc_ult_d(void)
 #ifdef INTERPRET_C_ULT_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_ULT_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(setb_reg8, 0, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -500,6 +792,12 @@ void genc_ole_d(void)
 #ifdef INTERPRET_C_OLE_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_OLE_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(setae_reg8, 1, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -522,6 +820,12 @@ void genc_ule_d(void)
 #ifdef INTERPRET_C_ULE_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_ULE_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(setbe_reg8, 0, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -545,6 +849,12 @@ void genc_sf_d(void)
 #ifdef INTERPRET_C_SF_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_SF_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(NULL, 0, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -564,6 +874,12 @@ void genc_ngle_d(void)
 #ifdef INTERPRET_C_NGLE_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_NGLE_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(setp_reg8, 0, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -586,6 +902,12 @@ void genc_seq_d(void)
 #ifdef INTERPRET_C_SEQ_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_SEQ_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(sete_reg8, 0, 1, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -608,6 +930,12 @@ void genc_ngl_d(void)
 #ifdef INTERPRET_C_NGL_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_NGL_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(sete_reg8, 0, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -631,6 +959,12 @@ void genc_lt_d(void)
 #ifdef INTERPRET_C_LT_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_LT_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(seta_reg8, 1, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -653,6 +987,12 @@ void genc_nge_d(void)
 #ifdef INTERPRET_C_NGE_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_NGE_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(setb_reg8, 0, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -676,6 +1016,12 @@ void genc_le_d(void)
 #ifdef INTERPRET_C_LE_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_LE_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(setae_reg8, 1, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -698,6 +1044,12 @@ void genc_ngt_d(void)
 #ifdef INTERPRET_C_NGT_D
    gencallinterp((unsigned long long)cached_interpreter_table.C_NGT_D, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_d(setbe_reg8, 0, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.ft]));
    fld_preg64_qword(RAX);
@@ -32,6 +32,24 @@
 #include "r4300/instr_counters.h"
 #endif
 
+/* SSE2 conversion, used instead of the x87 code when sse2_fpu is set */
+static void gen_sse_cvt_l(int to_double)
+{
+   int fd;
+
+   begin_xmm_instruction();
+   fd = allocate_xmm_temp();
+   mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
+   begin_xmm_rounding();
+   if (to_double)
+      cvtsi2sd_xmm_preg64_qword(fd, RAX);
+   else
+      cvtsi2ss_xmm_preg64_qword(fd, RAX);
+   end_xmm_rounding();
+   bind_xmm_register(fd, dst->f.cf.fd, to_double);
+   end_xmm_instruction();
+}
+
 void gencvt_s_l(void)
 {
 #if defined(COUNT_INSTR)
@@ -40,6 +58,12 @@ void gencvt_s_l(void)
 #ifdef INTERPRET_CVT_S_L
    gencallinterp((unsigned long long)cached_interpreter_table.CVT_S_L, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_cvt_l(0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
    fild_preg64_qword(RAX);
@@ -56,6 +80,12 @@ void gencvt_d_l(void)
 #ifdef INTERPRET_CVT_D_L
    gencallinterp((unsigned long long)cached_interpreter_table.CVT_D_L, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_cvt_l(1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fs]));
    fild_preg64_qword(RAX);
@@ -35,6 +35,146 @@
 #include "r4300/instr_counters.h"
 #endif
 
+/* SSE2 code generation, used instead of the x87 code when sse2_fpu is set.
+ * The operands are taken from the XMM register cache and the results are
+ * written back to the FPRs and kept cached for the next instructions. */
+
+static void sse_abs_s(int xmm1, int xmm2)
+{
+   pcmpeqd_xmm_xmm(xmm1, xmm1);
+   psrld_xmm_imm8(xmm1, 1);
+   andps_xmm_xmm(xmm1, xmm2);
+}
+
+static void sse_neg_s(int xmm1, int xmm2)
+{
+   pcmpeqd_xmm_xmm(xmm1, xmm1);
+   pslld_xmm_imm8(xmm1, 31);
+   xorps_xmm_xmm(xmm1, xmm2);
+}
+
+static void gen_sse_arith_s(void (*op)(int, int))
+{
+   int fs, ft, fd;
+
+   begin_xmm_instruction();
+   fs = allocate_xmm_register(dst->f.cf.fs, 0);
+   ft = allocate_xmm_register(dst->f.cf.ft, 0);
+   fd = allocate_xmm_temp();
+   movaps_xmm_xmm(fd, fs);
+   begin_xmm_rounding();
+   op(fd, ft);
+   end_xmm_rounding();
+   bind_xmm_register(fd, dst->f.cf.fd, 0);
+   end_xmm_instruction();
+}
+
+/* the FCR31 rounding mode is only loaded if rounded is set */
+static void gen_sse_unary_s(void (*op)(int, int), int rounded)
+{
+   int fs, fd;
+
+   begin_xmm_instruction();
+   fs = allocate_xmm_register(dst->f.cf.fs, 0);
+   fd = allocate_xmm_temp();
+   if (rounded)
+      begin_xmm_rounding();
+   op(fd, fs);
+   if (rounded)
+      end_xmm_rounding();
+   bind_xmm_register(fd, dst->f.cf.fd, 0);
+   end_xmm_instruction();
+}
+
+static void gen_sse_cvt_d_s(void)
+{
+   int fs, fd;
+
+   begin_xmm_instruction();
+   fs = allocate_xmm_register(dst->f.cf.fs, 0);
+   fd = allocate_xmm_temp();
+   cvtss2sd_xmm_xmm(fd, fs);
+   bind_xmm_register(fd, dst->f.cf.fd, 1);
+   end_xmm_instruction();
+}
+
+/* converts to a word or long integer, truncating or rounding as given by
+ * mxcsr, or by the FCR31 rounding mode if mxcsr is NULL */
+static void gen_sse_to_int_s(unsigned int *mxcsr, int truncate, int is_long)
+{
+   int fs;
+
+   begin_xmm_instruction();
+   fs = allocate_xmm_register(dst->f.cf.fs, 0);
+   if (mxcsr != NULL)
+      ldmxcsr_m32rel(mxcsr);
+   else if (!truncate)
+      begin_xmm_rounding();
+   if (is_long)
+   {
+      if (truncate)
+         cvttss2si_reg64_xmm(RDX, fs);
+      else
+         cvtss2si_reg64_xmm(RDX, fs);
+      mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[dst->f.cf.fd]));
+      mov_preg64_reg64(RAX, RDX);
+   }
+   else
+   {
+      if (truncate)
+         cvttss2si_reg32_xmm(EDX, fs);
+      else
+         cvtss2si_reg32_xmm(EDX, fs);
+      mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fd]));
+      mov_preg64_reg32(RAX, EDX);
+   }
+   if (mxcsr != NULL)
+      ldmxcsr_m32rel(&host_mxcsr);
+   else if (!truncate)
+      end_xmm_rounding();
+   free_xmm_fpr(dst->f.cf.fd);
+   end_xmm_instruction();
+}
+
+/* sets the FCR31 condition bit to the flag given by setcc after comparing
+ * fs to ft (or ft to fs if swap is set), and also requires the operands to
+ * be ordered if ordered is set. The condition is always false if setcc is
+ * NULL. The signaling compares only differ by raising the invalid
+ * operation exception on any NaN, which is masked in MXCSR. */
+static void gen_sse_compare_s(void (*setcc)(unsigned int), int swap, int ordered, int signaling)
+{
+   int fs, ft;
+
+   begin_xmm_instruction();
+   if (setcc == NULL)
+   {
+      and_m32rel_imm32((unsigned int*)&FCR31, ~0x800000);
+      end_xmm_instruction();
+      return;
+   }
+
+   fs = allocate_xmm_register(dst->f.cf.fs, 0);
+   ft = allocate_xmm_register(dst->f.cf.ft, 0);
+   xor_reg32_reg32(EDX, EDX);
+   xor_reg32_reg32(ECX, ECX);
+   if (signaling)
+      comiss_xmm_xmm(swap ? ft : fs, swap ? fs : ft);
+   else
+      ucomiss_xmm_xmm(swap ? ft : fs, swap ? fs : ft);
+   setcc(DL);
+   if (ordered)
+   {
+      setnp_reg8(CL);
+      and_reg64_reg64(RDX, RCX);
+   }
+   shl_reg32_imm8(EDX, 23);
+   mov_xreg32_m32rel(EAX, (unsigned int*)&FCR31);
+   and_eax_imm32(~0x800000);
+   or_reg64_reg64(RAX, RDX);
+   mov_m32rel_xreg32((unsigned int*)&FCR31, EAX);
+   end_xmm_instruction();
+}
+
 void genadd_s(void)
 {
 #if defined(COUNT_INSTR)
@@ -43,6 +183,12 @@ void genadd_s(void)
 #ifdef INTERPRET_ADD_S
     gencallinterp((unsigned long long)cached_interpreter_table.ADD_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_arith_s(addss_xmm_xmm);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg64_dword(RAX);
@@ -61,6 +207,12 @@ void gensub_s(void)
 #ifdef INTERPRET_SUB_S
     gencallinterp((unsigned long long)cached_interpreter_table.SUB_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_arith_s(subss_xmm_xmm);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg64_dword(RAX);
@@ -79,6 +231,12 @@ void genmul_s(void)
 #ifdef INTERPRET_MUL_S
     gencallinterp((unsigned long long)cached_interpreter_table.MUL_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_arith_s(mulss_xmm_xmm);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg64_dword(RAX);
@@ -97,6 +255,12 @@ void gendiv_s(void)
 #ifdef INTERPRET_DIV_S
     gencallinterp((unsigned long long)cached_interpreter_table.DIV_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_arith_s(divss_xmm_xmm);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg64_dword(RAX);
@@ -115,6 +279,12 @@ void gensqrt_s(void)
 #ifdef INTERPRET_SQRT_S
    gencallinterp((unsigned long long)cached_interpreter_table.SQRT_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_unary_s(sqrtss_xmm_xmm, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg64_dword(RAX);
@@ -132,6 +302,12 @@ void genabs_s(void)
 #ifdef INTERPRET_ABS_S
    gencallinterp((unsigned long long)cached_interpreter_table.ABS_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_unary_s(sse_abs_s, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg64_dword(RAX);
@@ -149,6 +325,12 @@ void genmov_s(void)
 #ifdef INTERPRET_MOV_S
    gencallinterp((unsigned long long)cached_interpreter_table.MOV_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_unary_s(movaps_xmm_xmm, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
    mov_reg32_preg64(EBX, RAX);
@@ -165,6 +347,12 @@ void genneg_s(void)
 #ifdef INTERPRET_NEG_S
    gencallinterp((unsigned long long)cached_interpreter_table.NEG_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_unary_s(sse_neg_s, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg64_dword(RAX);
@@ -182,6 +370,12 @@ void genround_l_s(void)
 #ifdef INTERPRET_ROUND_L_S
    gencallinterp((unsigned long long)cached_interpreter_table.ROUND_L_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_s(&round_mxcsr, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&round_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
@@ -200,6 +394,12 @@ void gentrunc_l_s(void)
 #ifdef INTERPRET_TRUNC_L_S
    gencallinterp((unsigned long long)cached_interpreter_table.TRUNC_L_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_s(NULL, 1, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&trunc_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
@@ -218,6 +418,12 @@ void genceil_l_s(void)
 #ifdef INTERPRET_CEIL_L_S
    gencallinterp((unsigned long long)cached_interpreter_table.CEIL_L_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_s(&ceil_mxcsr, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&ceil_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
@@ -236,6 +442,12 @@ void genfloor_l_s(void)
 #ifdef INTERPRET_FLOOR_L_S
    gencallinterp((unsigned long long)cached_interpreter_table.FLOOR_L_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_s(&floor_mxcsr, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&floor_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
@@ -254,6 +466,12 @@ void genround_w_s(void)
 #ifdef INTERPRET_ROUND_W_S
    gencallinterp((unsigned long long)cached_interpreter_table.ROUND_W_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_s(&round_mxcsr, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&round_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
@@ -272,6 +490,12 @@ void gentrunc_w_s(void)
 #ifdef INTERPRET_TRUNC_W_S
    gencallinterp((unsigned long long)cached_interpreter_table.TRUNC_W_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_s(NULL, 1, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&trunc_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
@@ -290,6 +514,12 @@ void genceil_w_s(void)
 #ifdef INTERPRET_CEIL_W_S
    gencallinterp((unsigned long long)cached_interpreter_table.CEIL_W_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_s(&ceil_mxcsr, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&ceil_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
@@ -308,6 +538,12 @@ void genfloor_w_s(void)
 #ifdef INTERPRET_FLOOR_W_S
    gencallinterp((unsigned long long)cached_interpreter_table.FLOOR_W_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_s(&floor_mxcsr, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    fldcw_m16rel((unsigned short*)&floor_mode);
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
@@ -326,6 +562,12 @@ void gencvt_d_s(void)
 #ifdef INTERPRET_CVT_D_S
    gencallinterp((unsigned long long)cached_interpreter_table.CVT_D_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_cvt_d_s();
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg64_dword(RAX);
@@ -342,6 +584,12 @@ void gencvt_w_s(void)
 #ifdef INTERPRET_CVT_W_S
    gencallinterp((unsigned long long)cached_interpreter_table.CVT_W_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_s(NULL, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg64_dword(RAX);
@@ -358,6 +606,12 @@ void gencvt_l_s(void)
 #ifdef INTERPRET_CVT_L_S
    gencallinterp((unsigned long long)cached_interpreter_table.CVT_L_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_to_int_s(NULL, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
    fld_preg64_dword(RAX);
@@ -374,6 +628,12 @@ void genc_f_s(void)
 #ifdef INTERPRET_C_F_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_F_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(NULL, 0, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    and_m32rel_imm32((unsigned int*)&FCR31, ~0x800000);
 #endif
@@ -387,6 +647,12 @@ void genc_un_s(void)
 #ifdef INTERPRET_C_UN_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_UN_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(setp_reg8, 0, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -409,6 +675,12 @@ void genc_eq_s(void)
 #ifdef INTERPRET_C_EQ_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_EQ_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(sete_reg8, 0, 1, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -431,6 +703,12 @@ void genc_ueq_s(void)
 #ifdef INTERPRET_C_UEQ_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_UEQ_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(sete_reg8, 0, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -454,6 +732,12 @@ void genc_olt_s(void)
 #ifdef INTERPRET_C_OLT_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_OLT_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(seta_reg8, 1, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -476,6 +760,12 @@ void genc_ult_s(void)
 #ifdef INTERPRET_C_ULT_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_ULT_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(setb_reg8, 0, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -499,6 +789,12 @@ void genc_ole_s(void)
 #ifdef INTERPRET_C_OLE_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_OLE_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(setae_reg8, 1, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -521,6 +817,12 @@ void genc_ule_s(void)
 #ifdef INTERPRET_C_ULE_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_ULE_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(setbe_reg8, 0, 0, 0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -544,6 +846,12 @@ void genc_sf_s(void)
 #ifdef INTERPRET_C_SF_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_SF_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(NULL, 0, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -563,6 +871,12 @@ void genc_ngle_s(void)
 #ifdef INTERPRET_C_NGLE_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_NGLE_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(setp_reg8, 0, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -585,6 +899,12 @@ void genc_seq_s(void)
 #ifdef INTERPRET_C_SEQ_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_SEQ_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(sete_reg8, 0, 1, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -607,6 +927,12 @@ void genc_ngl_s(void)
 #ifdef INTERPRET_C_NGL_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_NGL_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(sete_reg8, 0, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -630,6 +956,12 @@ void genc_lt_s(void)
 #ifdef INTERPRET_C_LT_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_LT_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(seta_reg8, 1, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -652,6 +984,12 @@ void genc_nge_s(void)
 #ifdef INTERPRET_C_NGE_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_NGE_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(setb_reg8, 0, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -675,6 +1013,12 @@ void genc_le_s(void)
 #ifdef INTERPRET_C_LE_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_LE_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(setae_reg8, 1, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
@@ -697,6 +1041,12 @@ void genc_ngt_s(void)
 #ifdef INTERPRET_C_NGT_S
    gencallinterp((unsigned long long)cached_interpreter_table.C_NGT_S, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_compare_s(setbe_reg8, 0, 0, 1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.ft]));
    fld_preg64_dword(RAX);
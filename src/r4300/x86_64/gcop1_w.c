@@ -34,6 +34,26 @@
 #include "r4300/instr_counters.h"
 #endif
 
+/* SSE2 conversion, used instead of the x87 code when sse2_fpu is set */
+static void gen_sse_cvt_w(int to_double)
+{
+   int fd;
+
+   begin_xmm_instruction();
+   fd = allocate_xmm_temp();
+   mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
+   if (to_double)
+      cvtsi2sd_xmm_preg64_dword(fd, RAX);
+   else
+   {
+      begin_xmm_rounding();
+      cvtsi2ss_xmm_preg64_dword(fd, RAX);
+      end_xmm_rounding();
+   }
+   bind_xmm_register(fd, dst->f.cf.fd, to_double);
+   end_xmm_instruction();
+}
+
 void gencvt_s_w(void)
 {
 #if defined(COUNT_INSTR)
@@ -42,6 +62,12 @@ void gencvt_s_w(void)
 #ifdef INTERPRET_CVT_S_W
    gencallinterp((unsigned long long)cached_interpreter_table.CVT_S_W, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_cvt_w(0);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
    fild_preg64_dword(RAX);
@@ -58,6 +84,12 @@ void gencvt_d_w(void)
 #ifdef INTERPRET_CVT_D_W
    gencallinterp((unsigned long long)cached_interpreter_table.CVT_D_W, 0);
 #else
+   if (sse2_fpu)
+   {
+      gen_sse_cvt_w(1);
+      return;
+   }
+
    gencheck_cop1_unusable();
    mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[dst->f.cf.fs]));
    fild_preg64_dword(RAX);
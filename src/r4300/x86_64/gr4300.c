@@ -30,9 +30,11 @@
 #include "r4300/cached_interp.h"
 #include "r4300/cp0.h"
 #include "r4300/cp1.h"
+#include "r4300/idle_loop.h"
 #include "r4300/interupt.h"
 #include "r4300/ops.h"
 #include "r4300/recomph.h"
+#include "r4300/recomp_link.h"
 #include "r4300/exception.h"
 
 #include "memory/memory.h"
@@ -102,6 +104,42 @@ static void gencheck_interupt_out(unsigned int addr)
    jump_end_rel8();
 }
 
+/* jumps to another page through jump_to_func(), or through a link to the code
+   of the target once it's compiled, see x86_64/recomp_link.c */
+static void genjump_out(unsigned int naddr)
+{
+   unsigned int link;
+
+   if (!recomp_link_page(dst_block->start) || !recomp_link_page(naddr))
+     {
+    mov_m32rel_imm32(&jump_to_address, naddr);
+    mov_reg64_imm64(RAX, (unsigned long long) (dst+1));
+    mov_m64rel_xreg64((unsigned long long *)(&PC), RAX);
+    mov_reg64_imm64(RAX, (unsigned long long) jump_to_func);
+    call_reg64(RAX);
+    return;
+     }
+
+   mov_xreg8_m8rel(AL, (unsigned char *) &invalid_code[naddr>>12]);
+   or_xreg8_m8rel(AL, (unsigned char *) &invalid_code[(naddr^0x20000000)>>12]);
+   jne_rj(0);
+   jump_start_rel8();
+
+   mov_xreg64_m64rel(RAX, (unsigned long long *) &blocks[naddr>>12]);
+   mov_m64rel_xreg64((unsigned long long *) &actual, RAX);
+   jmp_imm(0);
+   link = code_length - 4;
+
+   jump_end_rel8();
+
+   lea_reg64_rip_imm32(RDI, link - (code_length + 7));
+   mov_m32rel_imm32(&jump_to_address, naddr);
+   mov_reg64_imm64(RAX, (unsigned long long) (dst+1));
+   mov_m64rel_xreg64((unsigned long long *)(&PC), RAX);
+   mov_reg64_imm64(RAX, (unsigned long long) recomp_link_jump);
+   call_reg64(RAX);
+}
+
 static void genbeq_test(void)
 {
    int rs_64bit = is64((unsigned int *)dst->f.i.rs);
@@ -404,7 +442,7 @@ void genj(void)
    naddr = ((dst-1)->f.j.inst_index<<2) | (dst->addr & 0xF0000000);
    
    mov_m32rel_imm32((void*)(&last_addr), naddr);
-   gencheck_interupt((unsigned long long) &actual->block[(naddr-actual->start)/4]);
+   gencheck_interupt((unsigned long long) &dst_block->block[(naddr-dst_block->start)/4]);
    jmp(naddr);
 #endif
 }
@@ -431,11 +469,7 @@ void genj_out(void)
    
    mov_m32rel_imm32((void*)(&last_addr), naddr);
    gencheck_interupt_out(naddr);
-   mov_m32rel_imm32(&jump_to_address, naddr);
-   mov_reg64_imm64(RAX, (unsigned long long) (dst+1));
-   mov_m64rel_xreg64((unsigned long long *)(&PC), RAX);
-   mov_reg64_imm64(RAX, (unsigned long long)jump_to_func);
-   call_reg64(RAX);
+   genjump_out(naddr);
 #endif
 }
 
@@ -457,10 +491,11 @@ void genj_idle(void)
    mov_xreg32_m32rel(EAX, (unsigned int *)(&next_interupt));
    sub_xreg32_m32rel(EAX, (unsigned int *)(&g_cp0_regs[CP0_COUNT_REG]));
    cmp_reg32_imm8(EAX, 3);
-   jbe_rj(12);
+   jbe_rj(19);
 
    and_eax_imm32(0xFFFFFFFC);  // 5
    add_m32rel_xreg32((unsigned int *)(&g_cp0_regs[CP0_COUNT_REG]), EAX); // 7
+   add_m64rel_xreg64(&g_IdleLoopCycles, EAX); // 7
 
    genj();
 #endif
@@ -494,7 +529,7 @@ void genjal(void)
    naddr = ((dst-1)->f.j.inst_index<<2) | (dst->addr & 0xF0000000);
 
    mov_m32rel_imm32((void*)(&last_addr), naddr);
-   gencheck_interupt((unsigned long long) &actual->block[(naddr-actual->start)/4]);
+   gencheck_interupt((unsigned long long) &dst_block->block[(naddr-dst_block->start)/4]);
    jmp(naddr);
 #endif
 }
@@ -528,11 +563,7 @@ void genjal_out(void)
 
    mov_m32rel_imm32((void*)(&last_addr), naddr);
    gencheck_interupt_out(naddr);
-   mov_m32rel_imm32(&jump_to_address, naddr);
-   mov_reg64_imm64(RAX, (unsigned long long) (dst+1));
-   mov_m64rel_xreg64((unsigned long long *)(&PC), RAX);
-   mov_reg64_imm64(RAX, (unsigned long long) jump_to_func);
-   call_reg64(RAX);
+   genjump_out(naddr);
 #endif
 }
 
@@ -554,10 +585,11 @@ void genjal_idle(void)
    mov_xreg32_m32rel(EAX, (unsigned int *)(&next_interupt));
    sub_xreg32_m32rel(EAX, (unsigned int *)(&g_cp0_regs[CP0_COUNT_REG]));
    cmp_reg32_imm8(EAX, 3);
-   jbe_rj(12);
+   jbe_rj(19);
    
    and_eax_imm32(0xFFFFFFFC);  // 5
    add_m32rel_xreg32((unsigned int *)(&g_cp0_regs[CP0_COUNT_REG]), EAX); // 7
+   add_m64rel_xreg64(&g_IdleLoopCycles, EAX); // 7
   
    genjal();
 #endif
@@ -609,11 +641,7 @@ void gentest_out(void)
 
    mov_m32rel_imm32((void*)(&last_addr), dst->addr + (dst-1)->f.i.immediate*4);
    gencheck_interupt_out(dst->addr + (dst-1)->f.i.immediate*4);
-   mov_m32rel_imm32(&jump_to_address, dst->addr + (dst-1)->f.i.immediate*4);
-   mov_reg64_imm64(RAX, (unsigned long long) (dst+1));
-   mov_m64rel_xreg64((unsigned long long *)(&PC), RAX);
-   mov_reg64_imm64(RAX, (unsigned long long) jump_to_func);
-   call_reg64(RAX);
+   genjump_out(dst->addr + (dst-1)->f.i.immediate*4);
    jump_end_rel32();
 
    mov_m32rel_imm32((void*)(&last_addr), dst->addr + 4);
@@ -661,6 +689,7 @@ void gentest_idle(void)
    
    and_reg32_imm32(reg, 0xFFFFFFFC);
    add_m32rel_xreg32((unsigned int *)(&g_cp0_regs[CP0_COUNT_REG]), reg);
+   add_m64rel_xreg64(&g_IdleLoopCycles, reg);
    
    jump_end_rel8();
    jump_end_rel32();
@@ -1043,12 +1072,7 @@ void gentestl_out(void)
    gendelayslot();
    mov_m32rel_imm32((void*)(&last_addr), dst->addr + (dst-1)->f.i.immediate*4);
    gencheck_interupt_out(dst->addr + (dst-1)->f.i.immediate*4);
-   mov_m32rel_imm32(&jump_to_address, dst->addr + (dst-1)->f.i.immediate*4);
-
-   mov_reg64_imm64(RAX, (unsigned long long) (dst+1));
-   mov_m64rel_xreg64((unsigned long long *)(&PC), RAX);
-   mov_reg64_imm64(RAX, (unsigned long long) jump_to_func);
-   call_reg64(RAX);
+   genjump_out(dst->addr + (dst-1)->f.i.immediate*4);
    
    jump_end_rel32();
 
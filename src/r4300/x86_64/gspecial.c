@@ -187,10 +187,10 @@ void genjr(void)
 #ifdef INTERPRET_JR
    gencallinterp((unsigned long long)cached_interpreter_table.JR, 1);
 #else
-   static unsigned int precomp_instr_size = sizeof(precomp_instr);
-   unsigned int diff = (unsigned int) offsetof(precomp_instr, local_addr);
-   unsigned int diff_need = (unsigned int) offsetof(precomp_instr, reg_cache_infos.need_map);
-   unsigned int diff_wrap = (unsigned int) offsetof(precomp_instr, reg_cache_infos.jump_wrapper);
+   static unsigned int precomp_instr_info_size = sizeof(precomp_instr_info);
+   unsigned int diff = (unsigned int) offsetof(precomp_instr_info, local_addr);
+   unsigned int diff_need = (unsigned int) offsetof(precomp_instr_info, reg_cache_infos.need_map);
+   unsigned int diff_wrap = (unsigned int) offsetof(precomp_instr_info, reg_cache_infos.jump_wrapper);
    
    if (((dst->addr & 0xFFF) == 0xFFC && 
        (dst->addr < 0x80000000 || dst->addr >= 0xC0000000))||no_compiled_jump)
@@ -227,11 +227,11 @@ void genjr(void)
 
    jump_end_rel32();
 
-   mov_reg64_imm64(RSI, (unsigned long long) dst_block->block);
+   mov_reg64_imm64(RSI, (unsigned long long) dst_block->infos);
    mov_reg32_reg32(EAX, EBX);
    sub_eax_imm32(dst_block->start);
    shr_reg32_imm8(EAX, 2);
-   mul_m32rel((unsigned int *)(&precomp_instr_size));
+   mul_m32rel((unsigned int *)(&precomp_instr_info_size));
    
    mov_reg32_preg64preg64pimm32(EBX, RAX, RSI, diff_need);
    cmp_reg32_imm32(EBX, 1);
@@ -256,10 +256,10 @@ void genjalr(void)
 #ifdef INTERPRET_JALR
    gencallinterp((unsigned long long)cached_interpreter_table.JALR, 0);
 #else
-   static unsigned int precomp_instr_size = sizeof(precomp_instr);
-   unsigned int diff = (unsigned int) offsetof(precomp_instr, local_addr);
-   unsigned int diff_need = (unsigned int) offsetof(precomp_instr, reg_cache_infos.need_map);
-   unsigned int diff_wrap = (unsigned int) offsetof(precomp_instr, reg_cache_infos.jump_wrapper);
+   static unsigned int precomp_instr_info_size = sizeof(precomp_instr_info);
+   unsigned int diff = (unsigned int) offsetof(precomp_instr_info, local_addr);
+   unsigned int diff_need = (unsigned int) offsetof(precomp_instr_info, reg_cache_infos.need_map);
+   unsigned int diff_wrap = (unsigned int) offsetof(precomp_instr_info, reg_cache_infos.jump_wrapper);
    
    if (((dst->addr & 0xFFF) == 0xFFC && 
        (dst->addr < 0x80000000 || dst->addr >= 0xC0000000))||no_compiled_jump)
@@ -302,11 +302,11 @@ void genjalr(void)
 
    jump_end_rel32();
 
-   mov_reg64_imm64(RSI, (unsigned long long) dst_block->block);
+   mov_reg64_imm64(RSI, (unsigned long long) dst_block->infos);
    mov_reg32_reg32(EAX, EBX);
    sub_eax_imm32(dst_block->start);
    shr_reg32_imm8(EAX, 2);
-   mul_m32rel((unsigned int *)(&precomp_instr_size));
+   mul_m32rel((unsigned int *)(&precomp_instr_info_size));
 
    mov_reg32_preg64preg64pimm32(EBX, RAX, RSI, diff_need);
    cmp_reg32_imm32(EBX, 1);
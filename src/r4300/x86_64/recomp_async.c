@@ -0,0 +1,425 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - recomp_async.c                                          *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Background compilation of the x86_64 dynamic recompiler.
+ *
+ * When NOTCOMPILED() is reached in an RDRAM page (through KSEG0 or KSEG1)
+ * which doesn't hold any compiled code yet, the words of the page are copied
+ * and the page is compiled from this copy on a thread of the work queue,
+ * into a new block which isn't visible to the emulation thread.  The state of
+ * the recompiler is thread-local, see recomp.c.
+ *
+ * Meanwhile, the page is decoded into a separate block for the cached
+ * interpreter functions, which run it until the emulation leaves the page.
+ * The compiled block replaces the page in blocks[] the next time the page is
+ * entered or between two interpreted instructions, so never in the middle of
+ * a delay slot.  Pages whose code was modified since it was copied are
+ * discarded: no compiled instruction of a page being compiled exists, so the
+ * writes to it don't set invalid_code[], and its words are compared instead.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL.h>
+#include <SDL_thread.h>
+
+#define M64P_CORE_PROTOTYPES 1
+#include "api/m64p_types.h"
+#include "api/m64p_config.h"
+#include "api/callbacks.h"
+#include "api/config.h"
+#include "main/main.h"
+#include "main/workqueue.h"
+#include "memory/memory.h"
+#include "r4300/cached_interp.h"
+#include "r4300/ops.h"
+#include "r4300/r4300.h"
+#include "r4300/recomp.h"
+#include "r4300/recomph.h"
+#include "r4300/recomp_async.h"
+#include "r4300/recomp_link.h"
+
+/* only RDRAM pages reached through KSEG0 and KSEG1 are compiled in the
+   background, their translation doesn't depend on the TLB */
+#define RECOMP_ASYNC_RDRAM_PAGES (0x800000 >> 12)
+#define RECOMP_ASYNC_SLOTS (2 * RECOMP_ASYNC_RDRAM_PAGES)
+
+/* entries of the precomp_instr array of a 4 KB page, see get_block_memsize() */
+#define RECOMP_ASYNC_INSTRS ((0x1000/4 + 1) + (0x1000/4 >> 2))
+
+struct recomp_async_job
+{
+    struct work_struct work;
+    unsigned int start;
+    unsigned int func;
+    int fast_memory;
+    int done;      /* set by the worker, under l_Lock */
+    int discarded; /* set by the emulation thread, under l_Lock */
+    precomp_block *block;
+    int source[RECOMP_ASYNC_INSTRS];
+};
+
+struct recomp_async_slot
+{
+    struct recomp_async_job *job;
+    precomp_block *interp; /* the page decoded for the cached interpreter functions */
+};
+
+static int l_Enabled = 0;
+static SDL_mutex *l_Lock = NULL;
+static SDL_cond *l_Idle = NULL;
+static unsigned int l_Pending = 0; /* jobs which the worker hasn't finished */
+static int l_Interpreting = 0;
+
+static unsigned int l_Queued = 0;
+static unsigned int l_Compiled = 0;
+static unsigned int l_Installed = 0;
+static unsigned int l_Discarded = 0;
+
+static struct recomp_async_slot l_Slots[RECOMP_ASYNC_SLOTS];
+
+static int recomp_async_slot(unsigned int start)
+{
+    if ((start & 0xDF800000) != 0x80000000)
+        return -1;
+    return ((start >> 29) & 1) * RECOMP_ASYNC_RDRAM_PAGES + ((start & 0x7FFFFF) >> 12);
+}
+
+/* the words read by recompile_block(), which may run past the end of the page */
+static size_t recomp_async_source(unsigned int start, const int **source)
+{
+    size_t offset = start & 0x7FFFFF;
+    size_t size = RECOMP_ASYNC_INSTRS * 4;
+
+    *source = (const int *) ((const unsigned char *) rdram + offset);
+    return (offset + size > 0x800000) ? 0x800000 - offset : size;
+}
+
+/* whether the page still holds the code and the memory mode it's compiled from */
+static int recomp_async_current(const struct recomp_async_job *job)
+{
+    const int *source;
+    size_t size = recomp_async_source(job->start, &source);
+
+    return job->fast_memory == fast_memory && memcmp(job->source, source, size) == 0;
+}
+
+/* only a page without any compiled instruction is compiled from scratch */
+static int recomp_async_fresh(const precomp_block *block)
+{
+    int i;
+
+    for (i = 0; i < 0x1000/4; i++)
+    {
+        if (block->block[i].ops != cached_interpreter_table.NOTCOMPILED &&
+            block->block[i].ops != cached_interpreter_table.NOTCOMPILED2)
+            return 0;
+    }
+    return 1;
+}
+
+static void recomp_async_free_block(precomp_block *block)
+{
+    if (block != NULL)
+    {
+        free_block(block);
+        free(block);
+    }
+}
+
+static void recomp_async_compile(struct work_struct *work)
+{
+    struct recomp_async_job *job = container_of(work, struct recomp_async_job, work);
+    precomp_block *block = NULL;
+    int discarded;
+
+    SDL_LockMutex(l_Lock);
+    discarded = job->discarded;
+    SDL_UnlockMutex(l_Lock);
+
+    if (!discarded)
+        block = recompile_detached_block(job->source, job->start, job->func);
+
+    SDL_LockMutex(l_Lock);
+    discarded = job->discarded;
+    if (!discarded)
+    {
+        job->block = block;
+        job->done = 1;
+        if (block != NULL)
+            l_Compiled++;
+    }
+    l_Pending--;
+    SDL_CondSignal(l_Idle);
+    SDL_UnlockMutex(l_Lock);
+
+    /* nobody else refers to a discarded job */
+    if (discarded)
+    {
+        recomp_async_free_block(block);
+        free(job);
+    }
+}
+
+static int recomp_async_done(const struct recomp_async_job *job)
+{
+    int done;
+
+    SDL_LockMutex(l_Lock);
+    done = job->done;
+    SDL_UnlockMutex(l_Lock);
+    return done;
+}
+
+static void recomp_async_discard(struct recomp_async_slot *slot)
+{
+    struct recomp_async_job *job = slot->job;
+    int done;
+
+    SDL_LockMutex(l_Lock);
+    done = job->done;
+    job->discarded = 1;
+    SDL_UnlockMutex(l_Lock);
+
+    /* the worker frees the job when it finishes otherwise */
+    if (done)
+    {
+        recomp_async_free_block(job->block);
+        free(job);
+    }
+    recomp_async_free_block(slot->interp);
+    slot->job = NULL;
+    slot->interp = NULL;
+    l_Discarded++;
+}
+
+static int recomp_async_queue(struct recomp_async_slot *slot, precomp_block *block)
+{
+    struct recomp_async_job *job;
+    precomp_block *interp;
+    const int *source;
+    size_t size;
+    int i;
+
+    job = malloc(sizeof(struct recomp_async_job));
+    interp = malloc(sizeof(precomp_block));
+    if (job == NULL || interp == NULL)
+    {
+        free(job);
+        free(interp);
+        return 0;
+    }
+    memset(interp, 0, sizeof(precomp_block));
+    interp->start = block->start;
+    interp->end = block->end;
+    interp->block = malloc(RECOMP_ASYNC_INSTRS * sizeof(precomp_instr));
+    if (interp->block == NULL)
+    {
+        free(job);
+        free(interp);
+        return 0;
+    }
+    memset(interp->block, 0, RECOMP_ASYNC_INSTRS * sizeof(precomp_instr));
+    for (i = 0; i < RECOMP_ASYNC_INSTRS; i++)
+    {
+        interp->block[i].addr = block->start + i * 4;
+        interp->block[i].ops = cached_interpreter_table.NOTCOMPILED;
+    }
+
+    memset(job, 0, sizeof(struct recomp_async_job));
+    size = recomp_async_source(block->start, &source);
+    memcpy(job->source, source, size);
+    job->start = block->start;
+    job->func = PC->addr;
+    job->fast_memory = fast_memory;
+    init_work(&job->work, recomp_async_compile);
+
+    slot->job = job;
+    slot->interp = interp;
+    l_Queued++;
+
+    SDL_LockMutex(l_Lock);
+    l_Pending++;
+    SDL_UnlockMutex(l_Lock);
+    queue_work(&job->work);
+    return 1;
+}
+
+/* Replaces the page by its compiled block.  PC may point into the page or
+ * into the interpreted copy, the instruction it points to is never a delay
+ * slot here. */
+static void recomp_async_install(struct recomp_async_slot *slot)
+{
+    struct recomp_async_job *job = slot->job;
+    precomp_block *interp = slot->interp;
+    precomp_block *block = blocks[job->start >> 12];
+    precomp_block *compiled = job->block;
+
+    compiled->adler32 = block->adler32;
+    blocks[job->start >> 12] = compiled;
+    if (actual == block || actual == interp)
+    {
+        PC = compiled->block + (PC - actual->block);
+        actual = compiled;
+    }
+
+    recomp_link_clear(block);
+    recomp_async_free_block(block);
+    recomp_async_free_block(interp);
+    free(job);
+    slot->job = NULL;
+    slot->interp = NULL;
+    l_Installed++;
+}
+
+/* runs the interpreted copy of the page until the emulation leaves it */
+static void recomp_async_interpret(struct recomp_async_slot *slot, precomp_block *block)
+{
+    precomp_block *interp = slot->interp;
+    unsigned int interp_flag = dyna_interp;
+
+    PC = interp->block + (PC - block->block);
+    actual = interp;
+    l_Interpreting = 1;
+
+    while (!stop && slot->interp == interp && actual == interp)
+    {
+        if (PC->ops == cached_interpreter_table.NOTCOMPILED)
+            decode_block(slot->job->source, interp, PC->addr);
+
+        /* the jumps set skip_jump if their delay slot raises an exception, as in gencallinterp() */
+        dyna_interp = 1;
+        PC->ops();
+        dyna_interp = 0;
+
+        if (actual == interp && !skip_jump && slot->job != NULL && recomp_async_done(slot->job) &&
+            slot->job->block != NULL && recomp_async_current(slot->job))
+            recomp_async_install(slot);
+    }
+
+    l_Interpreting = 0;
+    dyna_interp = interp_flag;
+}
+
+/* Global Functions */
+
+void recomp_async_open(void)
+{
+    l_Enabled = 0;
+    if (!ConfigGetParamBool(g_CoreConfig, "BackgroundCompilation"))
+        return;
+#if defined(PROFILE_R4300) || defined(COMPARE_CORE)
+    DebugMessage(M64MSG_WARNING, "Background compilation isn't supported by this build");
+    return;
+#endif
+
+    l_Lock = SDL_CreateMutex();
+    l_Idle = SDL_CreateCond();
+    if (l_Lock == NULL || l_Idle == NULL)
+    {
+        DebugMessage(M64MSG_ERROR, "Could not create background compilation lock");
+        if (l_Lock != NULL) SDL_DestroyMutex(l_Lock);
+        if (l_Idle != NULL) SDL_DestroyCond(l_Idle);
+        l_Lock = NULL;
+        l_Idle = NULL;
+        return;
+    }
+
+    memset(l_Slots, 0, sizeof(l_Slots));
+    l_Pending = 0;
+    l_Queued = l_Compiled = l_Installed = l_Discarded = 0;
+    l_Enabled = 1;
+}
+
+void recomp_async_close(void)
+{
+    if (!l_Enabled)
+        return;
+
+    recomp_async_discard_all();
+    l_Enabled = 0;
+
+    /* the worker still refers to l_Lock until it has finished the discarded jobs */
+    SDL_LockMutex(l_Lock);
+    while (l_Pending > 0)
+        SDL_CondWait(l_Idle, l_Lock);
+    SDL_UnlockMutex(l_Lock);
+    SDL_DestroyCond(l_Idle);
+    SDL_DestroyMutex(l_Lock);
+    l_Idle = NULL;
+    l_Lock = NULL;
+
+    DebugMessage(M64MSG_VERBOSE, "Background compilation: %u pages queued, %u compiled, %u installed, %u discarded",
+                 l_Queued, l_Compiled, l_Installed, l_Discarded);
+}
+
+void recomp_async_discard_all(void)
+{
+    int i;
+
+    if (!l_Enabled)
+        return;
+
+    for (i = 0; i < RECOMP_ASYNC_SLOTS; i++)
+    {
+        if (l_Slots[i].job != NULL)
+            recomp_async_discard(&l_Slots[i]);
+    }
+}
+
+/* Called by NOTCOMPILED() in the dynamic recompiler.  Returns 0 if the page
+ * must be compiled right away, or 1 after installing its compiled block or
+ * running it in the interpreter, in which case the caller only has to jump
+ * to PC. */
+int recomp_async_execute(precomp_block *block)
+{
+    struct recomp_async_slot *slot;
+    int index;
+
+    /* the delay slot of a jump to the next page returns to the jump, see FIN_BLOCK(),
+       and the first instruction of the next page is run from the interpreted one */
+    if (!l_Enabled || l_Interpreting || r4300emu != CORE_DYNAREC || delay_slot || skip_jump)
+        return 0;
+    index = recomp_async_slot(block->start);
+    if (index < 0 || block->end - block->start != 0x1000)
+        return 0;
+    slot = &l_Slots[index];
+
+    if (slot->job != NULL && !recomp_async_current(slot->job))
+        recomp_async_discard(slot);
+    if (slot->job != NULL && recomp_async_done(slot->job))
+    {
+        if (slot->job->block == NULL)
+        {
+            recomp_async_discard(slot);
+            return 0;
+        }
+        recomp_async_install(slot);
+        return 1;
+    }
+
+    if (slot->job == NULL && (!recomp_async_fresh(block) || !recomp_async_queue(slot, block)))
+        return 0;
+
+    recomp_async_interpret(slot, block);
+    return 1;
+}
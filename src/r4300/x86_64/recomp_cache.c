@@ -0,0 +1,939 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - recomp_cache.c                                          *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Persistent translation cache of the x86_64 dynamic recompiler.
+ *
+ * When the emulation stops, every page of RDRAM code compiled through KSEG0
+ * or KSEG1 is serialised to <UserCachePath>/recomp/<ROM MD5>.cache: the
+ * source words it was compiled from, the precomp_instr entries and infos
+ * of its compiled instructions, the x86_64 code and its jump, RIP-relative
+ * and 64-bit immediate tables.  The first time a page is about to be compiled in a
+ * later session, NOTCOMPILED() looks for a cached page with the same
+ * address and contents and restores it instead.
+ *
+ * The generated code only refers to the core image (functions and globals)
+ * and to the page's own structures, so every host pointer is stored as an
+ * offset in one of these regions and relocated when the page is restored;
+ * passe2() then rebuilds the jump wrappers and patches the jumps and the
+ * RIP-relative displacements.  A page holding any other pointer is not
+ * cached.  The cache is only valid for the build it was written by, which
+ * is identified by the MD5 of the read-only segments of the core image.
+ *
+ * The cache of each ROM is bounded by TranslationCacheSize megabytes of
+ * uncompressed pages; the pages which have not been used for the most
+ * sessions are evicted first.
+ */
+
+#if !defined(_GNU_SOURCE)
+  #define _GNU_SOURCE  // for dl_iterate_phdr()
+#endif
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#if defined(__ELF__)
+#include <link.h>
+#endif
+
+#define M64P_CORE_PROTOTYPES 1
+#include "api/m64p_types.h"
+#include "api/m64p_config.h"
+#include "api/callbacks.h"
+#include "api/config.h"
+#include "main/main.h"
+#include "main/md5.h"
+#include "main/rom.h"
+#include "main/util.h"
+#include "memory/memory.h"
+#include "osal/files.h"
+#include "r4300/cached_interp.h"
+#include "r4300/idle_loop.h"
+#include "r4300/r4300.h"
+#include "r4300/recomp.h"
+#include "r4300/recomph.h"
+#include "r4300/recomp_cache.h"
+
+#define RECOMP_CACHE_MAGIC "M64PRCC"
+#define RECOMP_CACHE_VERSION 1
+#define RECOMP_CACHE_DIR "recomp"
+
+/* only RDRAM pages reached through KSEG0 and KSEG1 are cached, their
+   translation doesn't depend on the TLB */
+#define RECOMP_CACHE_RDRAM_PAGES (0x800000 >> 12)
+#define RECOMP_CACHE_SLOTS (2 * RECOMP_CACHE_RDRAM_PAGES)
+
+/* entries of the precomp_instr array of a 4 KB page, see get_block_memsize() */
+#define RECOMP_CACHE_INSTRS ((0x1000/4 + 1) + (0x1000/4 >> 2))
+
+#define RECOMP_CACHE_ALIGN(x) (((x) + 7) & ~((size_t) 7))
+
+enum recomp_cache_region
+{
+    REGION_IMAGE,  /* the core library: code and global variables */
+    REGION_BLOCK,  /* block->block */
+    REGION_INFOS,  /* block->infos */
+    REGION_STRUCT, /* the precomp_block itself */
+    REGION_CODE,   /* block->code */
+    NUM_REGIONS
+};
+
+struct recomp_cache_reloc
+{
+    unsigned int offset; /* of the pointer in the precomp_instr array or in the code */
+    unsigned int region;
+};
+
+struct recomp_cache_info
+{
+    unsigned int local_addr;
+    int need_cop1_check;
+    unsigned long long needed_registers[8]; /* offsets in the core image, 0 if unused */
+};
+
+struct recomp_cache_riprel
+{
+    unsigned int pc_addr;
+    unsigned int extra_bytes;
+    unsigned long long global_dst; /* offset in the core image */
+};
+
+/* A cached page is a single allocation, stored as is in the file: this
+ * header, then the source words, the indexes, precomp_instr entries and
+ * infos of the compiled instructions, the code which follows the
+ * NOTCOMPILED stubs of init_block(), its jump, RIP-relative and 64-bit
+ * immediate tables, and the relocations of the entries and of the code,
+ * each part 8-byte aligned.  The rest of the page is the same as a freshly
+ * initialised one, so it isn't stored. */
+struct recomp_cache_page
+{
+    unsigned int size;
+    unsigned int last_used; /* session in which the page was last stored or restored */
+    unsigned int start;
+    unsigned int adler32;
+    unsigned int fast_memory;
+    unsigned int init_length; /* of the stubs, where the stored code starts */
+    unsigned int code_length;
+    unsigned int instr_count;
+    unsigned int jumps_number;
+    unsigned int riprel_number;
+    unsigned int imm64_number;
+    unsigned int block_relocs;
+    unsigned int code_relocs;
+    unsigned int reserved;
+};
+
+struct recomp_cache_file
+{
+    char magic[8];
+    unsigned int version;
+    unsigned int session;
+    md5_byte_t image[16];
+    unsigned int no_compiled_jump;
+    unsigned int sse2_fpu;
+    unsigned int count;
+    unsigned int idle_loops;
+};
+
+struct recomp_cache_node
+{
+    struct recomp_cache_node *next;
+    struct recomp_cache_page *page;
+};
+
+struct recomp_cache_layout
+{
+    size_t source, indexes, instrs, infos, code, jumps, riprel, imm64, block_relocs, code_relocs, size;
+};
+
+static int l_Enabled = 0;
+static char *l_Filename = NULL;
+static size_t l_MaxSize = 0;
+static unsigned int l_Session = 0;
+static unsigned int l_Restored = 0;
+/* code length of a freshly initialised page, the same for every page, see init_block() */
+static unsigned int l_InitLength = 0;
+
+static unsigned char *l_ImageStart = NULL;
+static size_t l_ImageSize = 0;
+static md5_byte_t l_ImageMD5[16];
+
+/* cached pages, chained by RDRAM page and segment */
+static struct recomp_cache_node *l_Slots[RECOMP_CACHE_SLOTS];
+
+static int recomp_cache_slot(unsigned int start)
+{
+    if ((start & 0xDF800000) != 0x80000000)
+        return -1;
+    return ((start >> 29) & 1) * RECOMP_CACHE_RDRAM_PAGES + ((start & 0x7FFFFF) >> 12);
+}
+
+/* the source words read by recompile_block(), which may run past the end of the page */
+static size_t recomp_cache_source(unsigned int start, const unsigned char **source)
+{
+    size_t offset = start & 0x7FFFFF;
+    size_t size = RECOMP_CACHE_INSTRS * 4;
+
+    *source = (const unsigned char *) rdram + offset;
+    return (offset + size > 0x800000) ? 0x800000 - offset : size;
+}
+
+static unsigned int recomp_cache_hash(unsigned int start)
+{
+    const unsigned char *source;
+    size_t size = recomp_cache_source(start, &source);
+
+    return (unsigned int) adler32(adler32(0L, Z_NULL, 0), source, (uInt) size);
+}
+
+static void recomp_cache_layout(const struct recomp_cache_page *page, struct recomp_cache_layout *layout)
+{
+    size_t offset = RECOMP_CACHE_ALIGN(sizeof(struct recomp_cache_page));
+
+    layout->source = offset;       offset += RECOMP_CACHE_ALIGN(RECOMP_CACHE_INSTRS * 4);
+    layout->indexes = offset;      offset += RECOMP_CACHE_ALIGN(page->instr_count * sizeof(unsigned short));
+    layout->instrs = offset;       offset += page->instr_count * sizeof(precomp_instr);
+    layout->infos = offset;        offset += page->instr_count * sizeof(struct recomp_cache_info);
+    layout->code = offset;         offset += RECOMP_CACHE_ALIGN(page->code_length - page->init_length);
+    layout->jumps = offset;        offset += RECOMP_CACHE_ALIGN(page->jumps_number * sizeof(jump_table));
+    layout->riprel = offset;       offset += RECOMP_CACHE_ALIGN(page->riprel_number * sizeof(struct recomp_cache_riprel));
+    layout->imm64 = offset;        offset += RECOMP_CACHE_ALIGN(page->imm64_number * sizeof(unsigned int));
+    layout->block_relocs = offset; offset += page->block_relocs * sizeof(struct recomp_cache_reloc);
+    layout->code_relocs = offset;  offset += page->code_relocs * sizeof(struct recomp_cache_reloc);
+    layout->size = offset;
+}
+
+static const unsigned char *recomp_cache_page_source(const struct recomp_cache_page *page)
+{
+    return (const unsigned char *) page + RECOMP_CACHE_ALIGN(sizeof(struct recomp_cache_page));
+}
+
+/* the tables of the assembler grow by steps of 512 entries, see init_assembler() */
+static void *recomp_cache_table(const void *data, int number, size_t entry_size)
+{
+    int capacity = (number <= 512) ? 512 : (number + 511) & ~511;
+    void *table = malloc(capacity * entry_size);
+
+    if (table != NULL && data != NULL)
+        memcpy(table, data, number * entry_size);
+    return table;
+}
+
+static void recomp_cache_regions(const precomp_block *block, unsigned char *base[NUM_REGIONS], size_t size[NUM_REGIONS])
+{
+    base[REGION_IMAGE] = l_ImageStart;
+    size[REGION_IMAGE] = l_ImageSize;
+    base[REGION_BLOCK] = (unsigned char *) block->block;
+    size[REGION_BLOCK] = RECOMP_CACHE_INSTRS * sizeof(precomp_instr);
+    base[REGION_INFOS] = (unsigned char *) block->infos;
+    size[REGION_INFOS] = RECOMP_CACHE_INSTRS * sizeof(precomp_instr_info);
+    base[REGION_STRUCT] = (unsigned char *) block;
+    size[REGION_STRUCT] = sizeof(precomp_block);
+    base[REGION_CODE] = block->code;
+    size[REGION_CODE] = block->max_code_length;
+}
+
+static int recomp_cache_classify(unsigned char *const base[NUM_REGIONS], const size_t size[NUM_REGIONS], unsigned long long value)
+{
+    int i;
+
+    for (i = 0; i < NUM_REGIONS; i++)
+    {
+        if (value >= (unsigned long long) base[i] && value - (unsigned long long) base[i] < size[i])
+            return i;
+    }
+    return -1;
+}
+
+/* Turns the pointer at data+offset into an offset in its region and records
+ * its relocation.  Returns 0 if it's a host pointer outside of these regions.
+ * Values below 4 GB are operands which share a slot with a pointer field, or
+ * pointers in a non-PIE core, whose image doesn't move between sessions. */
+static int recomp_cache_relocate(unsigned char *data, unsigned int offset, int required,
+                                 unsigned char *const base[NUM_REGIONS], const size_t size[NUM_REGIONS],
+                                 struct recomp_cache_reloc *relocs, unsigned int *count)
+{
+    unsigned long long *slot = (unsigned long long *) (data + offset);
+    int region;
+
+    if (*slot == 0)
+        return 1;
+    region = recomp_cache_classify(base, size, *slot);
+    if (region < 0)
+        return !required && (*slot >> 32) == 0;
+
+    *slot -= (unsigned long long) base[region];
+    relocs[*count].offset = offset;
+    relocs[*count].region = region;
+    (*count)++;
+    return 1;
+}
+
+static unsigned long long recomp_cache_image_offset(const void *ptr, int *ok)
+{
+    unsigned long long offset = (unsigned long long) ((const unsigned char *) ptr - l_ImageStart);
+
+    if (ptr == NULL)
+        return 0;
+    if ((const unsigned char *) ptr < l_ImageStart || offset >= l_ImageSize)
+        *ok = 0;
+    return offset;
+}
+
+/* checks that the indexes and offsets of a page read from the file are in bounds */
+static int recomp_cache_check_page(const struct recomp_cache_page *page)
+{
+    const unsigned char *data = (const unsigned char *) page;
+    const struct recomp_cache_reloc *relocs;
+    const unsigned short *indexes;
+    struct recomp_cache_layout layout;
+    unsigned int i;
+
+    recomp_cache_layout(page, &layout);
+    indexes = (const unsigned short *) (data + layout.indexes);
+    for (i = 0; i < page->instr_count; i++)
+    {
+        if (indexes[i] >= RECOMP_CACHE_INSTRS)
+            return 0;
+    }
+    relocs = (const struct recomp_cache_reloc *) (data + layout.block_relocs);
+    for (i = 0; i < page->block_relocs; i++)
+    {
+        if (relocs[i].region >= NUM_REGIONS || relocs[i].offset % 8 != 0 ||
+            relocs[i].offset >= page->instr_count * sizeof(precomp_instr))
+            return 0;
+    }
+    relocs = (const struct recomp_cache_reloc *) (data + layout.code_relocs);
+    for (i = 0; i < page->code_relocs; i++)
+    {
+        if (relocs[i].region >= NUM_REGIONS || relocs[i].offset < page->init_length ||
+            relocs[i].offset + 8 > page->code_length)
+            return 0;
+    }
+    return 1;
+}
+
+static int recomp_cache_compiled(const precomp_instr *instr)
+{
+    return instr->ops != NULL && instr->ops != cached_interpreter_table.NOTCOMPILED &&
+           instr->ops != cached_interpreter_table.NOTCOMPILED2;
+}
+
+/* serialises a compiled page, or returns NULL if it can't be cached */
+static struct recomp_cache_page *recomp_cache_capture(const precomp_block *block)
+{
+    struct recomp_cache_page header, *page;
+    struct recomp_cache_layout layout;
+    struct recomp_cache_reloc *block_relocs, *code_relocs;
+    unsigned char *base[NUM_REGIONS];
+    size_t size[NUM_REGIONS];
+    const unsigned char *source;
+    size_t source_size;
+    unsigned char *data, *instrs, *code;
+    unsigned short *indexes;
+    const unsigned int *imm64 = (const unsigned int *) block->imm64_table;
+    const jump_table *jumps = (const jump_table *) block->jumps_table;
+    const riprelative_table *riprel = (const riprelative_table *) block->riprel_table;
+    unsigned int i, j, k;
+    int ok = 1;
+
+    if (l_InitLength == 0 || (unsigned int) block->code_length < l_InitLength)
+        return NULL;
+
+    memset(&header, 0, sizeof(header));
+    header.start = block->start;
+    header.adler32 = block->adler32;
+    header.fast_memory = fast_memory;
+    header.init_length = l_InitLength;
+    header.code_length = block->code_length;
+    for (i = 0; i < RECOMP_CACHE_INSTRS; i++)
+        header.instr_count += recomp_cache_compiled(&block->block[i]);
+    header.jumps_number = block->jumps_number;
+    header.riprel_number = block->riprel_number;
+    /* the stubs don't need to be relocated */
+    for (i = 0; i < (unsigned int) block->imm64_number; i++)
+        header.imm64_number += imm64[i] >= l_InitLength;
+    /* upper bounds, the unused relocation entries are trimmed below */
+    header.block_relocs = header.instr_count * sizeof(precomp_instr) / 8;
+    header.code_relocs = header.imm64_number;
+    recomp_cache_layout(&header, &layout);
+
+    data = malloc(layout.size);
+    if (data == NULL)
+        return NULL;
+    memset(data, 0, layout.size);
+    indexes = (unsigned short *) (data + layout.indexes);
+    instrs = data + layout.instrs;
+    code = data + layout.code;
+    block_relocs = (struct recomp_cache_reloc *) (data + layout.block_relocs);
+    code_relocs = (struct recomp_cache_reloc *) (data + layout.code_relocs);
+    header.block_relocs = 0;
+    header.code_relocs = 0;
+    recomp_cache_regions(block, base, size);
+
+    source_size = recomp_cache_source(block->start, &source);
+    memcpy(data + layout.source, source, source_size);
+
+    /* every pointer-sized slot of the entries: the ops, the operand pointers and the small operands */
+    for (i = 0, k = 0; ok && i < RECOMP_CACHE_INSTRS; i++)
+    {
+        struct recomp_cache_info *info = (struct recomp_cache_info *) (data + layout.infos) + k;
+        const precomp_instr_info *instr_info = &block->infos[i];
+        unsigned int offset = k * sizeof(precomp_instr);
+
+        if (!recomp_cache_compiled(&block->block[i]))
+            continue;
+        indexes[k++] = (unsigned short) i;
+
+        memcpy(instrs + offset, &block->block[i], sizeof(precomp_instr));
+        ok = recomp_cache_relocate(instrs, offset, 1, base, size, block_relocs, &header.block_relocs);
+        for (j = 8; ok && j < sizeof(precomp_instr); j += 8)
+            ok = recomp_cache_relocate(instrs, offset + j, 0, base, size, block_relocs, &header.block_relocs);
+
+        info->local_addr = instr_info->local_addr;
+        info->need_cop1_check = instr_info->reg_cache_infos.need_cop1_check;
+        /* passe2() rebuilds the wrappers of the instructions which need a mapping */
+        if (instr_info->reg_cache_infos.need_map)
+        {
+            for (j = 0; j < 8; j++)
+                info->needed_registers[j] = recomp_cache_image_offset(instr_info->reg_cache_infos.needed_registers[j], &ok);
+        }
+    }
+
+    /* jump targets and RIP-relative displacements are patched again by passe2() */
+    memcpy(code, block->code + l_InitLength, block->code_length - l_InitLength);
+    for (i = 0, k = 0; ok && i < (unsigned int) block->imm64_number; i++)
+    {
+        if (imm64[i] < l_InitLength)
+            continue;
+        ((unsigned int *) (data + layout.imm64))[k++] = imm64[i];
+        ok = recomp_cache_relocate(code - l_InitLength, imm64[i], 1, base, size, code_relocs, &header.code_relocs);
+    }
+
+    for (i = 0; ok && i < (unsigned int) block->jumps_number; i++)
+        ok = jumps[i].pc_addr >= l_InitLength;
+    memcpy(data + layout.jumps, jumps, block->jumps_number * sizeof(jump_table));
+    for (i = 0; ok && i < (unsigned int) block->riprel_number; i++)
+    {
+        struct recomp_cache_riprel *entry = (struct recomp_cache_riprel *) (data + layout.riprel) + i;
+        entry->pc_addr = riprel[i].pc_addr;
+        entry->extra_bytes = riprel[i].extra_bytes;
+        entry->global_dst = recomp_cache_image_offset(riprel[i].global_dst, &ok);
+        ok = ok && riprel[i].pc_addr >= l_InitLength;
+    }
+
+    if (!ok)
+    {
+        free(data);
+        return NULL;
+    }
+
+    /* move the code relocations down next to the used entry relocations */
+    memmove(block_relocs + header.block_relocs, code_relocs, header.code_relocs * sizeof(struct recomp_cache_reloc));
+    recomp_cache_layout(&header, &layout);
+    header.size = (unsigned int) layout.size;
+    header.last_used = l_Session;
+
+    page = realloc(data, layout.size);
+    if (page == NULL)
+        page = (struct recomp_cache_page *) data;
+    memcpy(page, &header, sizeof(header));
+    return page;
+}
+
+/* restores a cached page over a page freshly initialised by init_block() */
+static int recomp_cache_restore_page(precomp_block *block, const struct recomp_cache_page *page)
+{
+    const unsigned char *data = (const unsigned char *) page;
+    const struct recomp_cache_reloc *relocs;
+    const struct recomp_cache_riprel *riprel_entries;
+    const unsigned short *indexes;
+    struct recomp_cache_layout layout;
+    unsigned char *base[NUM_REGIONS];
+    size_t size[NUM_REGIONS];
+    riprelative_table *riprel;
+    unsigned int *imm64;
+    void *jumps;
+    unsigned int i, j;
+
+    if ((unsigned int) block->code_length != page->init_length)
+        return 0;
+    recomp_cache_layout(page, &layout);
+    indexes = (const unsigned short *) (data + layout.indexes);
+
+    if (page->code_length >= (unsigned int) block->max_code_length)
+    {
+        int max_code_length = block->max_code_length;
+        while (max_code_length <= (int) page->code_length)
+            max_code_length += 8192;
+        block->code = realloc_exec(block->code, block->max_code_length, max_code_length);
+        if (block->code == NULL)
+            return 0;
+        block->max_code_length = max_code_length;
+    }
+
+    /* the 64-bit immediates of the stubs are kept */
+    jumps = recomp_cache_table(data + layout.jumps, page->jumps_number, sizeof(jump_table));
+    riprel = recomp_cache_table(NULL, page->riprel_number, sizeof(riprelative_table));
+    imm64 = recomp_cache_table(block->imm64_table, block->imm64_number + page->imm64_number, sizeof(unsigned int));
+    if (jumps == NULL || riprel == NULL || imm64 == NULL)
+    {
+        free(jumps);
+        free(riprel);
+        free(imm64);
+        return 0;
+    }
+    memcpy(imm64 + block->imm64_number, data + layout.imm64, page->imm64_number * sizeof(unsigned int));
+    riprel_entries = (const struct recomp_cache_riprel *) (data + layout.riprel);
+    for (i = 0; i < page->riprel_number; i++)
+    {
+        riprel[i].pc_addr = riprel_entries[i].pc_addr;
+        riprel[i].extra_bytes = riprel_entries[i].extra_bytes;
+        riprel[i].global_dst = l_ImageStart + riprel_entries[i].global_dst;
+    }
+
+    recomp_cache_regions(block, base, size);
+
+    relocs = (const struct recomp_cache_reloc *) (data + layout.block_relocs);
+    for (i = 0; i < page->instr_count; i++)
+        memcpy(&block->block[indexes[i]], data + layout.instrs + i * sizeof(precomp_instr), sizeof(precomp_instr));
+    for (i = 0; i < page->block_relocs; i++)
+    {
+        unsigned int k = relocs[i].offset / sizeof(precomp_instr);
+        unsigned char *instr = (unsigned char *) &block->block[indexes[k]];
+        *(unsigned long long *) (instr + relocs[i].offset % sizeof(precomp_instr)) += (unsigned long long) base[relocs[i].region];
+    }
+
+    for (i = 0; i < page->instr_count; i++)
+    {
+        const struct recomp_cache_info *info = (const struct recomp_cache_info *) (data + layout.infos) + i;
+        precomp_instr_info *instr_info = &block->infos[indexes[i]];
+        instr_info->local_addr = info->local_addr;
+        instr_info->reg_cache_infos.need_map = 0;
+        instr_info->reg_cache_infos.need_cop1_check = info->need_cop1_check;
+        for (j = 0; j < 8; j++)
+            instr_info->reg_cache_infos.needed_registers[j] = info->needed_registers[j] ? l_ImageStart + info->needed_registers[j] : NULL;
+    }
+
+    memcpy(block->code + page->init_length, data + layout.code, page->code_length - page->init_length);
+    relocs = (const struct recomp_cache_reloc *) (data + layout.code_relocs);
+    for (i = 0; i < page->code_relocs; i++)
+        *(unsigned long long *) (block->code + relocs[i].offset) += (unsigned long long) base[relocs[i].region];
+    block->code_length = page->code_length;
+
+    if (block->jumps_table) free(block->jumps_table);
+    if (block->riprel_table) free(block->riprel_table);
+    if (block->imm64_table) free(block->imm64_table);
+    init_assembler(jumps, page->jumps_number, riprel, page->riprel_number, imm64, block->imm64_number + page->imm64_number);
+    passe2(block->block, 0, RECOMP_CACHE_INSTRS, block);
+    free_assembler(&block->jumps_table, &block->jumps_number, &block->riprel_table, &block->riprel_number, &block->imm64_table, &block->imm64_number);
+
+    return 1;
+}
+
+static void recomp_cache_insert(struct recomp_cache_page *page)
+{
+    struct recomp_cache_node *node;
+    int slot = recomp_cache_slot(page->start);
+
+    for (node = l_Slots[slot]; node != NULL; node = node->next)
+    {
+        struct recomp_cache_page *other = node->page;
+        if (other->start == page->start && other->adler32 == page->adler32 && other->fast_memory == page->fast_memory &&
+            memcmp(recomp_cache_page_source(other), recomp_cache_page_source(page), RECOMP_CACHE_INSTRS * 4) == 0)
+        {
+            free(other);
+            node->page = page;
+            return;
+        }
+    }
+
+    node = malloc(sizeof(struct recomp_cache_node));
+    if (node == NULL)
+    {
+        free(page);
+        return;
+    }
+    node->page = page;
+    node->next = l_Slots[slot];
+    l_Slots[slot] = node;
+}
+
+static void recomp_cache_drop_all(void)
+{
+    int i;
+
+    for (i = 0; i < RECOMP_CACHE_SLOTS; i++)
+    {
+        while (l_Slots[i] != NULL)
+        {
+            struct recomp_cache_node *node = l_Slots[i];
+            l_Slots[i] = node->next;
+            free(node->page);
+            free(node);
+        }
+    }
+}
+
+#if defined(__ELF__)
+struct recomp_cache_image_search
+{
+    const unsigned char *symbol;
+    unsigned char *start;
+    size_t size;
+    md5_byte_t md5[16];
+};
+
+static int recomp_cache_find_image(struct dl_phdr_info *info, size_t size, void *data)
+{
+    struct recomp_cache_image_search *search = (struct recomp_cache_image_search *) data;
+    uintptr_t low = UINTPTR_MAX, high = 0, symbol = (uintptr_t) search->symbol;
+    md5_state_t state;
+    int i, found = 0;
+
+    for (i = 0; i < info->dlpi_phnum; i++)
+    {
+        const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+        uintptr_t segment = info->dlpi_addr + phdr->p_vaddr;
+        if (phdr->p_type != PT_LOAD)
+            continue;
+        if (segment < low) low = segment;
+        if (segment + phdr->p_memsz > high) high = segment + phdr->p_memsz;
+        if (symbol >= segment && symbol < segment + phdr->p_memsz) found = 1;
+    }
+    if (!found)
+        return 0;
+
+    /* the code and read-only data identify the build, and so the layout of the globals */
+    md5_init(&state);
+    for (i = 0; i < info->dlpi_phnum; i++)
+    {
+        const ElfW(Phdr) *phdr = &info->dlpi_phdr[i];
+        if (phdr->p_type == PT_LOAD && !(phdr->p_flags & PF_W))
+            md5_append(&state, (const md5_byte_t *) (info->dlpi_addr + phdr->p_vaddr), (int) phdr->p_memsz);
+    }
+    md5_finish(&state, search->md5);
+
+    search->start = (unsigned char *) low;
+    search->size = high - low;
+    return 1;
+}
+#endif
+
+static int recomp_cache_locate_image(void)
+{
+#if defined(__ELF__)
+    struct recomp_cache_image_search search;
+
+    memset(&search, 0, sizeof(search));
+    search.symbol = (const unsigned char *) reg;
+    if (dl_iterate_phdr(recomp_cache_find_image, &search) == 0)
+        return 0;
+
+    l_ImageStart = search.start;
+    l_ImageSize = search.size;
+    memcpy(l_ImageMD5, search.md5, 16);
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+static void recomp_cache_set_header(struct recomp_cache_file *header, unsigned int count)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, RECOMP_CACHE_MAGIC, 8);
+    header->version = RECOMP_CACHE_VERSION;
+    header->session = l_Session;
+    memcpy(header->image, l_ImageMD5, 16);
+    header->no_compiled_jump = no_compiled_jump;
+    header->sse2_fpu = sse2_fpu;
+    header->idle_loops = g_IdleLoopDetection;
+    header->count = count;
+}
+
+static unsigned int recomp_cache_read(gzFile f)
+{
+    struct recomp_cache_file header, expected;
+    struct recomp_cache_page page_header;
+    unsigned int i, count = 0;
+
+    if (gzread(f, &header, sizeof(header)) != sizeof(header))
+        return 0;
+    recomp_cache_set_header(&expected, header.count);
+    expected.session = header.session;
+    if (memcmp(&header, &expected, sizeof(header)) != 0)
+    {
+        DebugMessage(M64MSG_VERBOSE, "Translation cache was written by another build or configuration, ignoring it");
+        return 0;
+    }
+    l_Session = header.session + 1;
+
+    for (i = 0; i < header.count; i++)
+    {
+        struct recomp_cache_page *page;
+        struct recomp_cache_layout layout;
+
+        if (gzread(f, &page_header, sizeof(page_header)) != sizeof(page_header))
+            break;
+        /* bound the counts before they size the allocation */
+        if (page_header.init_length > page_header.code_length || page_header.instr_count > RECOMP_CACHE_INSTRS ||
+            page_header.code_length > 0x1000000 || page_header.block_relocs > 0x100000 || page_header.code_relocs > 0x100000 ||
+            page_header.jumps_number > 0x100000 || page_header.riprel_number > 0x100000 || page_header.imm64_number > 0x100000)
+            break;
+        recomp_cache_layout(&page_header, &layout);
+        if (page_header.size != layout.size || recomp_cache_slot(page_header.start) < 0 || (page_header.start & 0xFFF) != 0)
+            break;
+        page = malloc(layout.size);
+        if (page == NULL)
+            break;
+        memcpy(page, &page_header, sizeof(page_header));
+        if (gzread(f, page + 1, (unsigned int) (layout.size - sizeof(page_header))) != (int) (layout.size - sizeof(page_header)) ||
+            !recomp_cache_check_page(page))
+        {
+            free(page);
+            break;
+        }
+        recomp_cache_insert(page);
+        count++;
+    }
+
+    return count;
+}
+
+/* The entries and infos are mostly zeros, so the file is gzip-compressed.  It
+ * is compressed in memory to be written with write_to_file_atomic(). */
+static unsigned char *recomp_cache_compress(const unsigned char *data, size_t size, size_t *compressed_size)
+{
+    unsigned char *buffer;
+    z_stream stream;
+    uLong bound;
+
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return NULL;
+    bound = deflateBound(&stream, (uLong) size);
+    buffer = malloc(bound);
+    if (buffer == NULL)
+    {
+        deflateEnd(&stream);
+        return NULL;
+    }
+
+    stream.next_in = (Bytef *) data;
+    stream.avail_in = (uInt) size;
+    stream.next_out = buffer;
+    stream.avail_out = (uInt) bound;
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+    {
+        deflateEnd(&stream);
+        free(buffer);
+        return NULL;
+    }
+    *compressed_size = stream.total_out;
+    deflateEnd(&stream);
+    return buffer;
+}
+
+static int recomp_cache_compare_use(const void *a, const void *b)
+{
+    const struct recomp_cache_page *page_a = *(const struct recomp_cache_page * const *) a;
+    const struct recomp_cache_page *page_b = *(const struct recomp_cache_page * const *) b;
+
+    if (page_a->last_used != page_b->last_used)
+        return (page_a->last_used > page_b->last_used) ? -1 : 1;
+    return 0;
+}
+
+static void recomp_cache_write(void)
+{
+    struct recomp_cache_page **pages;
+    struct recomp_cache_node *node;
+    struct recomp_cache_file header;
+    unsigned char *buffer, *compressed, *curr;
+    unsigned int count = 0, kept;
+    size_t total, compressed_size = 0;
+    int i;
+
+    for (i = 0; i < RECOMP_CACHE_SLOTS; i++)
+        for (node = l_Slots[i]; node != NULL; node = node->next)
+            count++;
+    pages = malloc((count + 1) * sizeof(struct recomp_cache_page *));
+    if (pages == NULL)
+        return;
+    count = 0;
+    for (i = 0; i < RECOMP_CACHE_SLOTS; i++)
+        for (node = l_Slots[i]; node != NULL; node = node->next)
+            pages[count++] = node->page;
+
+    /* least recently used pages are evicted first */
+    qsort(pages, count, sizeof(struct recomp_cache_page *), recomp_cache_compare_use);
+    total = sizeof(header);
+    for (kept = 0; kept < count && total + pages[kept]->size <= l_MaxSize; kept++)
+        total += pages[kept]->size;
+
+    buffer = malloc(total);
+    if (buffer == NULL)
+    {
+        free(pages);
+        return;
+    }
+    recomp_cache_set_header(&header, kept);
+    memcpy(buffer, &header, sizeof(header));
+    curr = buffer + sizeof(header);
+    for (i = 0; i < (int) kept; i++)
+    {
+        memcpy(curr, pages[i], pages[i]->size);
+        curr += pages[i]->size;
+    }
+
+    compressed = recomp_cache_compress(buffer, total, &compressed_size);
+    if (compressed == NULL || write_to_file_atomic(l_Filename, compressed, compressed_size) != file_ok)
+        DebugMessage(M64MSG_WARNING, "Couldn't write translation cache file '%s'", l_Filename);
+    else
+        DebugMessage(M64MSG_VERBOSE, "Translation cache: %u pages restored, %u written, %u evicted", l_Restored, kept, count - kept);
+
+    free(compressed);
+    free(buffer);
+    free(pages);
+}
+
+/* Global Functions */
+
+void recomp_cache_open(void)
+{
+    const char *cachepath;
+    char *dirpath, *filename;
+    unsigned int count = 0;
+    int size;
+    gzFile f;
+
+    l_Enabled = 0;
+    if (!ConfigGetParamBool(g_CoreConfig, "TranslationCache"))
+        return;
+    size = ConfigGetParamInt(g_CoreConfig, "TranslationCacheSize");
+    if (size <= 0)
+        return;
+    if (!recomp_cache_locate_image())
+    {
+        DebugMessage(M64MSG_WARNING, "Translation cache isn't supported on this platform");
+        return;
+    }
+
+    cachepath = ConfigGetUserCachePath();
+    if (cachepath == NULL)
+        return;
+    dirpath = combinepath(cachepath, RECOMP_CACHE_DIR);
+    if (dirpath == NULL)
+        return;
+    osal_mkdirp(dirpath, 0700);
+    filename = formatstr("%s.cache", ROM_SETTINGS.MD5);
+    if (filename != NULL)
+        l_Filename = combinepath(dirpath, filename);
+    free(filename);
+    free(dirpath);
+    if (l_Filename == NULL)
+        return;
+
+    l_MaxSize = (size_t) size * 1024 * 1024;
+    l_Session = 1;
+    l_Restored = 0;
+    f = gzopen(l_Filename, "rb");
+    if (f != NULL)
+    {
+        count = recomp_cache_read(f);
+        gzclose(f);
+    }
+
+    DebugMessage(M64MSG_INFO, "Translation cache: %u pages loaded", count);
+    l_Enabled = 1;
+}
+
+void recomp_cache_close(void)
+{
+    unsigned int segment, i;
+
+    if (!l_Enabled)
+        return;
+    l_Enabled = 0;
+
+    for (segment = 0x80000000 >> 12; segment <= 0xa0000000 >> 12; segment += 0x20000000 >> 12)
+    {
+        for (i = 0; i < RECOMP_CACHE_RDRAM_PAGES; i++)
+        {
+            precomp_block *block = blocks[segment + i];
+            struct recomp_cache_page *page;
+            int compiled = 0, j;
+
+            if (block == NULL || invalid_code[segment + i] || block->block == NULL || block->infos == NULL ||
+                block->code == NULL || block->adler32 == 0 || block->end - block->start != 0x1000)
+                continue;
+            for (j = 0; j < RECOMP_CACHE_INSTRS && !compiled; j++)
+                compiled = block->block[j].ops != cached_interpreter_table.NOTCOMPILED;
+            if (!compiled || recomp_cache_hash(block->start) != block->adler32)
+                continue;
+
+            page = recomp_cache_capture(block);
+            if (page != NULL)
+                recomp_cache_insert(page);
+        }
+    }
+
+    recomp_cache_write();
+    recomp_cache_drop_all();
+    free(l_Filename);
+    l_Filename = NULL;
+}
+
+int recomp_cache_restore(precomp_block *block)
+{
+    struct recomp_cache_node *node;
+    const unsigned char *source;
+    size_t size;
+    int slot;
+
+    if (!l_Enabled || r4300emu != CORE_DYNAREC || block->adler32 != 0)
+        return 0;
+    slot = recomp_cache_slot(block->start);
+    if (slot < 0 || block->end - block->start != 0x1000)
+        return 0;
+
+    /* the content of the page when its first code is compiled, checked again when it's stored */
+    size = recomp_cache_source(block->start, &source);
+    block->adler32 = recomp_cache_hash(block->start);
+    l_InitLength = block->code_length;
+
+    for (node = l_Slots[slot]; node != NULL; node = node->next)
+    {
+        struct recomp_cache_page *page = node->page;
+        if (page->start == block->start && page->adler32 == block->adler32 && page->fast_memory == (unsigned int) fast_memory &&
+            memcmp(recomp_cache_page_source(page), source, size) == 0)
+        {
+            if (!recomp_cache_restore_page(block, page))
+                return 0;
+            page->last_used = l_Session;
+            l_Restored++;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - recomp_link.c                                           *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Direct linking of the jumps between pages of the x86_64 dynamic recompiler.
+ *
+ * A jump to another page is compiled by genjump_out() (gr4300.c) as:
+ *
+ *       mov  al, invalid_code[target page]
+ *       or   al, invalid_code[target page ^ 0x20000]
+ *       jne  slow
+ *       mov  rax, blocks[target page]
+ *       mov  actual, rax
+ *       jmp  slow                 <- link, rel32 patched here
+ *   slow:
+ *       lea  rdi, [link]
+ *       mov  jump_to_address, target
+ *       mov  PC, next instruction
+ *       call recomp_link_jump
+ *
+ * recomp_link_jump() does the jump with jump_to_func() and, if the target
+ * instruction is already compiled, points the rel32 of the link to its code,
+ * so that the next jumps skip jump_to_func() and dyna_jump().  The check of
+ * invalid_code[] stays in front of the link, as jump_to_func() would do it.
+ *
+ * Each link is recorded in the lists of its source and target pages.  When
+ * the code of a page is rewritten, moved or freed, the links from and to it
+ * are reset to the slow path and their records are dropped.  Every link is
+ * reset while the block profiler runs, as it counts the jump_to_func() calls.
+ */
+
+#include <stdlib.h>
+
+#include "api/m64p_types.h"
+#include "api/callbacks.h"
+#include "main/list.h"
+#include "r4300/block_profiler.h"
+#include "r4300/cached_interp.h"
+#include "r4300/ops.h"
+#include "r4300/r4300.h"
+#include "r4300/recomp.h"
+#include "r4300/recomp_link.h"
+
+#define RECOMP_LINK_RDRAM_PAGES (0x800000 >> 12)
+#define RECOMP_LINK_SLOTS (2 * RECOMP_LINK_RDRAM_PAGES)
+
+struct recomp_link
+{
+    struct list_head from_list;
+    struct list_head to_list;
+    precomp_block *from;
+    precomp_block *to;
+    unsigned int offset; /* of the rel32 of the link in from->code */
+};
+
+static int l_Open = 0;
+static struct list_head l_From[RECOMP_LINK_SLOTS];
+static struct list_head l_To[RECOMP_LINK_SLOTS];
+
+static unsigned int l_Linked = 0;
+static unsigned int l_Unlinked = 0;
+
+static int recomp_link_slot(unsigned int addr)
+{
+    return ((addr >> 29) & 1) * RECOMP_LINK_RDRAM_PAGES + ((addr & 0x7FFFFF) >> 12);
+}
+
+static void recomp_link_free(struct recomp_link *link)
+{
+    list_del(&link->from_list);
+    list_del(&link->to_list);
+    free(link);
+}
+
+static void recomp_link_unlink(precomp_block *block)
+{
+    struct recomp_link *link, *safe;
+    struct list_head *head = &l_To[recomp_link_slot(block->start)];
+
+    list_for_each_entry_safe_t(link, safe, head, struct recomp_link, to_list)
+    {
+        if (link->to != block)
+            continue;
+        *(int *) (link->from->code + link->offset) = 0;
+        recomp_link_free(link);
+        l_Unlinked++;
+    }
+}
+
+static void recomp_link_reset(void)
+{
+    struct recomp_link *link, *safe;
+    int i;
+
+    for (i = 0; i < RECOMP_LINK_SLOTS; i++)
+    {
+        list_for_each_entry_safe_t(link, safe, &l_From[i], struct recomp_link, from_list)
+        {
+            *(int *) (link->from->code + link->offset) = 0;
+            recomp_link_free(link);
+        }
+    }
+}
+
+/* Global Functions */
+
+void recomp_link_open(void)
+{
+    int i;
+
+    for (i = 0; i < RECOMP_LINK_SLOTS; i++)
+    {
+        INIT_LIST_HEAD(&l_From[i]);
+        INIT_LIST_HEAD(&l_To[i]);
+    }
+    l_Linked = l_Unlinked = 0;
+    l_Open = 1;
+}
+
+/* resets every link, so that the code of the pages can be cached */
+void recomp_link_close(void)
+{
+    if (!l_Open)
+        return;
+
+    recomp_link_reset();
+    l_Open = 0;
+
+    DebugMessage(M64MSG_VERBOSE, "Block linking: %u jumps linked, %u unlinked", l_Linked, l_Unlinked);
+}
+
+/* Called by the code of a jump to another page, link points to its rel32. */
+void recomp_link_jump(unsigned char *link)
+{
+    /* PC points to the instruction after the delay slot of the jump */
+    unsigned int jump_addr = (PC - 2)->addr;
+    precomp_block *from, *to;
+    precomp_instr_info *info;
+    unsigned char *target;
+    struct recomp_link *record;
+    long long rel32;
+
+    jump_to_func();
+
+    if (!l_Open || stop || skip_jump || *(int *) link != 0)
+        return;
+
+    /* the block profiler needs every jump to go through jump_to_func() */
+    if (g_BlockProfilerEnabled)
+    {
+        recomp_link_reset();
+        return;
+    }
+
+    /* the source page must be the live one holding the jump */
+    from = blocks[jump_addr >> 12];
+    if (!recomp_link_page(jump_addr) || from == NULL || from->code == NULL ||
+        link < from->code || link + 4 > from->code + from->code_length)
+        return;
+
+    /* and the target instruction must be compiled */
+    to = actual;
+    if (!recomp_link_page(jump_to_address) || to == NULL || to != blocks[jump_to_address >> 12] ||
+        to->infos == NULL || PC < to->block || PC >= to->block + (to->end - to->start) / 4 ||
+        PC->ops == cached_interpreter_table.NOTCOMPILED || PC->ops == cached_interpreter_table.NOTCOMPILED2 ||
+        invalid_code[jump_to_address >> 12] || invalid_code[(jump_to_address ^ 0x20000000) >> 12])
+        return;
+
+    info = get_instr_info(to, PC);
+    if (info->reg_cache_infos.need_map)
+        target = info->reg_cache_infos.jump_wrapper;
+    else
+        target = to->code + info->local_addr;
+    rel32 = (long long) (target - (link + 4));
+    if (rel32 > 0x7FFFFFFF || rel32 < -0x7FFFFFFFLL - 1)
+        return;
+
+    record = malloc(sizeof(struct recomp_link));
+    if (record == NULL)
+        return;
+    record->from = from;
+    record->to = to;
+    record->offset = (unsigned int) (link - from->code);
+    list_add(&record->from_list, &l_From[recomp_link_slot(from->start)]);
+    list_add(&record->to_list, &l_To[recomp_link_slot(to->start)]);
+    *(int *) link = (int) rel32;
+    l_Linked++;
+}
+
+/* resets every link from and to a block whose code is about to be rewritten,
+ * has moved or is about to be freed */
+void recomp_link_clear(precomp_block *block)
+{
+    struct recomp_link *link, *safe;
+    struct list_head *head;
+
+    if (!l_Open || !recomp_link_page(block->start))
+        return;
+
+    recomp_link_unlink(block);
+
+    head = &l_From[recomp_link_slot(block->start)];
+    list_for_each_entry_safe_t(link, safe, head, struct recomp_link, from_list)
+    {
+        if (link->from != block)
+            continue;
+        *(int *) (block->code + link->offset) = 0;
+        recomp_link_free(link);
+    }
+}
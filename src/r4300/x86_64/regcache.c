@@ -29,13 +29,44 @@
 #include "r4300/recomp.h"
 #include "r4300/r4300.h"
 #include "r4300/recomph.h"
+#include "r4300/cp0.h"
+#include "r4300/cp1.h"
+
+static osal_thread_local unsigned long long * reg_content[8];
+static osal_thread_local precomp_instr* last_access[8];
+static osal_thread_local precomp_instr* free_since[8];
+static osal_thread_local int dirty[8];
+static osal_thread_local int is64bits[8];
+static osal_thread_local unsigned long long *r0;
+
+/* the needed_registers table of an instruction lives in the side table of the block being recompiled */
+static void **get_needed_registers(precomp_instr *instr)
+{
+  return get_instr_info(dst_block, instr)->reg_cache_infos.needed_registers;
+}
 
-static unsigned long long * reg_content[8];
-static precomp_instr* last_access[8];
-static precomp_instr* free_since[8];
-static int dirty[8];
-static int is64bits[8];
-static unsigned long long *r0;
+/* XMM register cache of the SSE2 FPU code. The results of COP1 instructions
+ * are always stored to the FPRs, so the cached values never need flushing:
+ * the cache simply starts empty again whenever anything else is recompiled
+ * between two COP1 instructions. */
+static osal_thread_local int xmm_fpr[8];          /* cached FPR number, -1 if the register is free */
+static osal_thread_local int xmm_is_double[8];    /* loaded through reg_cop1_double or reg_cop1_simple */
+static osal_thread_local unsigned int xmm_last_use[8];
+static osal_thread_local unsigned int xmm_instr_number;
+static osal_thread_local precomp_instr *xmm_last_instr;
+static osal_thread_local int xmm_code_end;
+
+static void init_xmm_cache(void)
+{
+  int i;
+  for (i=0; i<8; i++)
+  {
+    xmm_fpr[i] = -1;
+    xmm_last_use[i] = 0;
+  }
+  xmm_instr_number = 0;
+  xmm_last_instr = NULL;
+}
 
 void init_cache(precomp_instr* start)
 {
@@ -49,6 +80,7 @@ void init_cache(precomp_instr* start)
     is64bits[i] = 0;
   }
   r0 = (unsigned long long *) reg;
+  init_xmm_cache();
 }
 
 void free_all_registers(void)
@@ -72,7 +104,7 @@ void free_all_registers(void)
     {
       while (free_since[i] <= dst)
       {
-        free_since[i]->reg_cache_infos.needed_registers[i] = NULL;
+        get_needed_registers(free_since[i])[i] = NULL;
         free_since[i]++;
       }
     }
@@ -97,8 +129,8 @@ void free_all_registers(void)
 static void simplify_access(void)
 {
    int i;
-   dst->local_addr = code_length;
-   for(i=0; i<8; i++) dst->reg_cache_infos.needed_registers[i] = NULL;
+   get_instr_info(dst_block, dst)->local_addr = code_length;
+   for(i=0; i<8; i++) get_needed_registers(dst)[i] = NULL;
 }
 
 void free_registers_move_start(void)
@@ -124,9 +156,9 @@ void free_register(int reg)
   while (last <= dst)
   {
     if (last_access[reg] != NULL && dirty[reg])
-      last->reg_cache_infos.needed_registers[reg] = reg_content[reg];
+      get_needed_registers(last)[reg] = reg_content[reg];
     else
-      last->reg_cache_infos.needed_registers[reg] = NULL;
+      get_needed_registers(last)[reg] = NULL;
     last++;
   }
   if (last_access[reg] == NULL) 
@@ -225,7 +257,7 @@ int allocate_register_32(unsigned int *addr)
 
         while (last <= dst)
         {
-          last->reg_cache_infos.needed_registers[i] = reg_content[i];
+          get_needed_registers(last)[i] = reg_content[i];
           last++;
         }
         last_access[i] = dst;
@@ -244,7 +276,7 @@ int allocate_register_32(unsigned int *addr)
   {
     while (free_since[reg] <= dst)
     {
-      free_since[reg]->reg_cache_infos.needed_registers[reg] = NULL;
+      get_needed_registers(free_since[reg])[reg] = NULL;
       free_since[reg]++;
     }
   }
@@ -282,7 +314,7 @@ int allocate_register_64(unsigned long long *addr)
 
         while (last <= dst)
         {
-          last->reg_cache_infos.needed_registers[i] = reg_content[i];
+          get_needed_registers(last)[i] = reg_content[i];
           last++;
         }
         last_access[i] = dst;
@@ -305,7 +337,7 @@ int allocate_register_64(unsigned long long *addr)
   {
     while (free_since[reg] <= dst)
     {
-      free_since[reg]->reg_cache_infos.needed_registers[reg] = NULL;
+      get_needed_registers(free_since[reg])[reg] = NULL;
       free_since[reg]++;
     }
   }
@@ -356,7 +388,7 @@ int allocate_register_32_w(unsigned int *addr)
          
       while (last <= dst)
       {
-        last->reg_cache_infos.needed_registers[i] = NULL;
+        get_needed_registers(last)[i] = NULL;
         last++;
       }
       last_access[i] = dst;
@@ -375,7 +407,7 @@ int allocate_register_32_w(unsigned int *addr)
   {
     while (free_since[reg] <= dst)
     {
-      free_since[reg]->reg_cache_infos.needed_registers[reg] = NULL;
+      get_needed_registers(free_since[reg])[reg] = NULL;
       free_since[reg]++;
     }
   }
@@ -401,7 +433,7 @@ int allocate_register_64_w(unsigned long long *addr)
 
       while (last <= dst)
       {
-        last->reg_cache_infos.needed_registers[i] = NULL;
+        get_needed_registers(last)[i] = NULL;
         last++;
       }
       last_access[i] = dst;
@@ -420,7 +452,7 @@ int allocate_register_64_w(unsigned long long *addr)
   {
     while (free_since[reg] <= dst)
     {
-      free_since[reg]->reg_cache_infos.needed_registers[reg] = NULL;
+      get_needed_registers(free_since[reg])[reg] = NULL;
       free_since[reg]++;
     }
   }
@@ -443,7 +475,7 @@ void allocate_register_32_manually(int reg, unsigned int *addr)
     precomp_instr *last = last_access[reg] + 1;
     while (last <= dst)
     {
-      last->reg_cache_infos.needed_registers[reg] = reg_content[reg];
+      get_needed_registers(last)[reg] = reg_content[reg];
       last++;
     }
     last_access[reg] = dst;
@@ -458,7 +490,7 @@ void allocate_register_32_manually(int reg, unsigned int *addr)
   {
     while (free_since[reg] <= dst)
     {
-      free_since[reg]->reg_cache_infos.needed_registers[reg] = NULL;
+      get_needed_registers(free_since[reg])[reg] = NULL;
       free_since[reg]++;
     }
   }
@@ -471,7 +503,7 @@ void allocate_register_32_manually(int reg, unsigned int *addr)
       precomp_instr *last = last_access[i]+1;
       while (last <= dst)
       {
-        last->reg_cache_infos.needed_registers[i] = reg_content[i];
+        get_needed_registers(last)[i] = reg_content[i];
         last++;
       }
       last_access[i] = dst;
@@ -512,7 +544,7 @@ void allocate_register_32_manually_w(int reg, unsigned int *addr)
     precomp_instr *last = last_access[reg]+1;
     while (last <= dst)
     {
-      last->reg_cache_infos.needed_registers[reg] = NULL;
+      get_needed_registers(last)[reg] = NULL;
       last++;
     }
     last_access[reg] = dst;
@@ -528,7 +560,7 @@ void allocate_register_32_manually_w(int reg, unsigned int *addr)
   {
     while (free_since[reg] <= dst)
     {
-      free_since[reg]->reg_cache_infos.needed_registers[reg] = NULL;
+      get_needed_registers(free_since[reg])[reg] = NULL;
       free_since[reg]++;
     }
   }
@@ -541,7 +573,7 @@ void allocate_register_32_manually_w(int reg, unsigned int *addr)
       precomp_instr *last = last_access[i] + 1;
       while (last <= dst)
       {
-        last->reg_cache_infos.needed_registers[i] = NULL;
+        get_needed_registers(last)[i] = NULL;
         last++;
       }
       last_access[reg] = dst;
@@ -578,7 +610,7 @@ void allocate_register_32_manually_w(int reg, unsigned int *addr)
 // 0xC3 ret
 // total : 84 bytes
 
-static void build_wrapper(precomp_instr *instr, unsigned char* pCode, precomp_block* block)
+static void build_wrapper(precomp_instr_info *info, unsigned char* pCode, precomp_block* block)
 {
    int i;
 
@@ -602,7 +634,7 @@ static void build_wrapper(precomp_instr *instr, unsigned char* pCode, precomp_bl
    
    *pCode++ = 0x48;
    *pCode++ = 0x05;
-   *((unsigned int *) pCode) = (unsigned int) instr->local_addr;
+   *((unsigned int *) pCode) = (unsigned int) info->local_addr;
    pCode += 4;
    
    *pCode++ = 0x48;
@@ -618,18 +650,18 @@ static void build_wrapper(precomp_instr *instr, unsigned char* pCode, precomp_bl
    for (i=7; i>=0; i--)
    {
      long long riprel;
-     if (instr->reg_cache_infos.needed_registers[i] != NULL)
+     if (info->reg_cache_infos.needed_registers[i] != NULL)
      {
        *pCode++ = 0x48;
        *pCode++ = 0x8B;
        *pCode++ = 0x80 | (i << 3);
-       riprel = (long long) ((unsigned char *) instr->reg_cache_infos.needed_registers[i] - (unsigned char *) &reg[0]);
+       riprel = (long long) ((unsigned char *) info->reg_cache_infos.needed_registers[i] - (unsigned char *) &reg[0]);
        *((int *) pCode) = (int) riprel;
        pCode += 4;
        if (riprel >= 0x7fffffffLL || riprel < -0x80000000LL)
        {
          DebugMessage(M64MSG_ERROR, "build_wrapper error: reg[%i] offset too big for relative address from %p to %p",
-                i, (&reg[0]), instr->reg_cache_infos.needed_registers[i]);
+                i, (&reg[0]), info->reg_cache_infos.needed_registers[i]);
          asm(" int $3; ");
        }
      }
@@ -642,16 +674,206 @@ void build_wrappers(precomp_instr *instr, int start, int end, precomp_block* blo
    int i, reg;
    for (i=start; i<end; i++)
      {
-    instr[i].reg_cache_infos.need_map = 0;
+    precomp_instr_info *info = get_instr_info(block, &instr[i]);
+    info->reg_cache_infos.need_map = 0;
     for (reg=0; reg<8; reg++)
       {
-         if (instr[i].reg_cache_infos.needed_registers[reg] != NULL)
+         if (info->reg_cache_infos.needed_registers[reg] != NULL)
            {
-          instr[i].reg_cache_infos.need_map = 1;
-          build_wrapper(&instr[i], instr[i].reg_cache_infos.jump_wrapper, block);
+          info->reg_cache_infos.need_map = 1;
+          build_wrapper(info, info->reg_cache_infos.jump_wrapper, block);
           break;
            }
       }
      }
 }
 
+
+static void load_xmm_register(int xmm, int fpr, int is_double)
+{
+   if (is_double)
+   {
+      mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[fpr]));
+      movsd_xmm_preg64(xmm, RAX);
+   }
+   else
+   {
+      mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[fpr]));
+      movss_xmm_preg64(xmm, RAX);
+   }
+}
+
+// this function starts the code of a COP1 instruction using the XMM cache.
+// The values cached by the previous instruction are kept only if it
+// falls through to this one. The instruction can also be entered through a
+// jump (a loop, a jump_wrapper or a return from an interrupt), so its entry
+// point is moved to a reload of these values that the fall through skips.
+void begin_xmm_instruction(void)
+{
+   precomp_instr_info *info;
+   unsigned int entry;
+   int i, cached = 0;
+
+   if (xmm_last_instr == NULL || dst != xmm_last_instr + 1 || code_length != xmm_code_end)
+   {
+      for (i = 0; i < 8; i++)
+         xmm_fpr[i] = -1;
+   }
+   xmm_instr_number++;
+
+   free_registers_move_start();
+   info = get_instr_info(dst_block, dst);
+
+   for (i = 0; i < 8; i++)
+   {
+      if (xmm_fpr[i] >= 0)
+         cached = 1;
+   }
+   if (cached)
+   {
+      jmp_imm_short(0);
+      jump_start_rel8();
+
+      info->local_addr = code_length;
+      for (i = 0; i < 8; i++)
+      {
+         if (xmm_fpr[i] >= 0)
+            load_xmm_register(i, xmm_fpr[i], xmm_is_double[i]);
+      }
+
+      jump_end_rel8();
+   }
+   entry = info->local_addr;
+
+   test_m32rel_imm32((unsigned int*)&g_cp0_regs[CP0_STATUS_REG], 0x20000000);
+   jne_rj(0);
+   jump_start_rel8();
+
+   gencallinterp((unsigned long long)check_cop1_unusable, 0);
+
+   jump_end_rel8();
+
+   // gencallinterp moved the entry point to its call
+   info->local_addr = entry;
+}
+
+// the MXCSR holds the host rounding mode outside of the COP1 operations
+// that round their result. These ones are surrounded by these functions,
+// which load the FCR31 rounding mode only when it differs from the host one
+void begin_xmm_rounding(void)
+{
+   test_m32rel_imm32(&rounding_mxcsr_differs, 1);
+   je_rj(0);
+   jump_start_rel8();
+
+   ldmxcsr_m32rel(&rounding_mxcsr);
+
+   jump_end_rel8();
+}
+
+void end_xmm_rounding(void)
+{
+   test_m32rel_imm32(&rounding_mxcsr_differs, 1);
+   je_rj(0);
+   jump_start_rel8();
+
+   ldmxcsr_m32rel(&host_mxcsr);
+
+   jump_end_rel8();
+}
+
+void end_xmm_instruction(void)
+{
+   xmm_last_instr = dst;
+   xmm_code_end = code_length;
+}
+
+// returns an XMM register not used by the current instruction, preferably
+// a free one, otherwise the least recently used
+static int lru_xmm_register(void)
+{
+   unsigned int oldest_use = 0xFFFFFFFF;
+   int i, xmm = -1;
+
+   for (i = 0; i < 8; i++)
+   {
+      if (xmm_last_use[i] == xmm_instr_number)
+         continue;
+      if (xmm_fpr[i] < 0)
+         return i;
+      if (xmm_last_use[i] < oldest_use)
+      {
+         oldest_use = xmm_last_use[i];
+         xmm = i;
+      }
+   }
+   return xmm;
+}
+
+// this function returns an XMM register holding the value of an FPR in
+// single (is_double = 0) or double format, loading it if not cached yet
+int allocate_xmm_register(int fpr, int is_double)
+{
+   int xmm, i;
+
+   for (i = 0; i < 8; i++)
+   {
+      if (xmm_fpr[i] == fpr && xmm_is_double[i] == is_double)
+      {
+         xmm_last_use[i] = xmm_instr_number;
+         return i;
+      }
+   }
+
+   xmm = lru_xmm_register();
+   load_xmm_register(xmm, fpr, is_double);
+   xmm_fpr[xmm] = fpr;
+   xmm_is_double[xmm] = is_double;
+   xmm_last_use[xmm] = xmm_instr_number;
+   return xmm;
+}
+
+// returns a scratch XMM register, it stays reserved until the end of the
+// current instruction
+int allocate_xmm_temp(void)
+{
+   int xmm = lru_xmm_register();
+
+   xmm_fpr[xmm] = -1;
+   xmm_last_use[xmm] = xmm_instr_number;
+   return xmm;
+}
+
+// forgets the cached values overlapping an FPR: with the FR bit cleared, an
+// even/odd pair of FPRs shares one 64-bit register
+void free_xmm_fpr(int fpr)
+{
+   int i;
+
+   for (i = 0; i < 8; i++)
+   {
+      if (xmm_fpr[i] >= 0 && (xmm_fpr[i] >> 1) == (fpr >> 1))
+         xmm_fpr[i] = -1;
+   }
+}
+
+// stores an XMM register to an FPR and keeps it cached as its new value
+void bind_xmm_register(int xmm, int fpr, int is_double)
+{
+   free_xmm_fpr(fpr);
+
+   if (is_double)
+   {
+      mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_double[fpr]));
+      movsd_preg64_xmm(RAX, xmm);
+   }
+   else
+   {
+      mov_xreg64_m64rel(RAX, (unsigned long long *)(&reg_cop1_simple[fpr]));
+      movss_preg64_xmm(RAX, xmm);
+   }
+
+   xmm_fpr[xmm] = fpr;
+   xmm_is_double[xmm] = is_double;
+   xmm_last_use[xmm] = xmm_instr_number;
+}
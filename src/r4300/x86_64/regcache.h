@@ -43,5 +43,14 @@ void allocate_register_32_manually(int reg, unsigned int *addr);
 void allocate_register_32_manually_w(int reg, unsigned int *addr);
 void build_wrappers(precomp_instr*, int, int, precomp_block*);
 
+void begin_xmm_instruction(void);
+void end_xmm_instruction(void);
+void begin_xmm_rounding(void);
+void end_xmm_rounding(void);
+int allocate_xmm_register(int fpr, int is_double);
+int allocate_xmm_temp(void);
+void bind_xmm_register(int xmm, int fpr, int is_double);
+void free_xmm_fpr(int fpr);
+
 #endif /* M64P_R4300_REGCACHE_H */
 
@@ -36,16 +36,19 @@ static unsigned long long *return_address;
 
 void dyna_jump(void)
 {
+    precomp_instr_info *info;
+
     if (stop == 1)
     {
         dyna_stop();
         return;
     }
 
-    if (PC->reg_cache_infos.need_map)
-        *return_address = (unsigned long long) (PC->reg_cache_infos.jump_wrapper);
+    info = get_instr_info(actual, PC);
+    if (info->reg_cache_infos.need_map)
+        *return_address = (unsigned long long) (info->reg_cache_infos.jump_wrapper);
     else
-        *return_address = (unsigned long long) (actual->code + PC->local_addr);
+        *return_address = (unsigned long long) (actual->code + info->local_addr);
 }
 
 static long long save_rsp = 0;
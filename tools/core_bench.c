@@ -0,0 +1,268 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - core_bench.c                                            *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Headless throughput benchmark of the core.
+ *
+ * The core objects are linked statically with this driver, and the dummy
+ * video, audio, input and rsp plugins are attached, so no GPU or audio
+ * device is needed.  For each requested R4300Emulator mode a child process
+ * boots the ROM (optionally loading a savestate), runs it with the speed
+ * limiter off for a fixed number of vertical interrupts, and prints one
+ * JSON object on stdout:
+ *
+ *   {"mode":2,"vi":600,"seconds":1.234,"vi_per_sec":486.2,
+ *    "instructions":56250000,"instructions_per_sec":45583468.4,
+ *    "gfx_ns":0,"audio_ns":1234,"compiler_ns":5678,"idle_ns":910,
+ *    "peak_rss_kb":51234,"timed_out":false}
+ *
+ * The run is stopped from a polling thread, so 'vi' may slightly exceed the
+ * requested count; all rates are computed over the same sampled interval.
+ * The instruction count is derived from the CP0 Count register and
+ * CountPerOp, so it includes idle loops which the core fast-forwards.
+ * The *_ns fields are the timed sections of src/main/profile.c.
+ *
+ * To build it, go to projects/unix and type:
+ *
+ * make bench
+ *
+ * Usage: mupen64plus-bench [-n vis] [-m modes] [-s savestate] [-c configdir]
+ *                          [-d datadir] [-t timeout] [-v] rom
+ *
+ * 'modes' is a comma separated list of R4300Emulator values (default 0,1,2).
+ */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define M64P_CORE_PROTOTYPES 1
+#include "api/m64p_types.h"
+#include "api/m64p_frontend.h"
+#include "api/m64p_config.h"
+#include "main/main.h"
+#include "main/profile.h"
+#include "main/version.h"
+#include "r4300/cp0.h"
+#include "r4300/r4300.h"
+
+static const char *l_StateFile = NULL;
+static unsigned int l_ViTarget = 600;
+static int l_Timeout = 300;
+static int l_Verbose = 0;
+
+static volatile int l_StateLoaded = -1;
+
+struct bench_result
+{
+    unsigned int vi;
+    double seconds;
+    unsigned long long counts;
+    long long int section_ns[NUM_TIMED_SECTIONS];
+    int timed_out;
+};
+
+static double get_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void debug_callback(void *context, int level, const char *message)
+{
+    if (level <= M64MSG_WARNING || l_Verbose)
+        fprintf(stderr, "core: %s\n", message);
+}
+
+static void state_callback(void *context, m64p_core_param param, int value)
+{
+    if (param == M64CORE_STATE_LOADCOMPLETE)
+        l_StateLoaded = value;
+}
+
+static void *watch_thread(void *arg)
+{
+    struct bench_result *result = (struct bench_result *) arg;
+    unsigned int first_vi, last_count, count;
+    double start, now;
+    int i;
+
+    while (!g_EmulatorRunning)
+        usleep(1000);
+
+    if (l_StateFile != NULL)
+    {
+        CoreDoCommand(M64CMD_STATE_LOAD, 0, (void *) l_StateFile);
+        while (l_StateLoaded < 0)
+            usleep(1000);
+        if (l_StateLoaded == 0)
+        {
+            fprintf(stderr, "couldn't load savestate '%s'\n", l_StateFile);
+            result->timed_out = 1;
+            CoreDoCommand(M64CMD_STOP, 0, NULL);
+            return NULL;
+        }
+    }
+
+    /* sample everything from here, after boot or savestate loading */
+    first_vi = g_ViCount;
+    last_count = g_cp0_regs[CP0_COUNT_REG];
+    for (i = 0; i < NUM_TIMED_SECTIONS; i++)
+        result->section_ns[i] = timed_section_get_total((enum timed_section) i);
+    start = get_seconds();
+
+    for (;;)
+    {
+        usleep(100);
+
+        /* Count wraps around in a few seconds at full speed, so accumulate deltas */
+        count = g_cp0_regs[CP0_COUNT_REG];
+        result->counts += count - last_count;
+        last_count = count;
+
+        now = get_seconds();
+        if (g_ViCount - first_vi >= l_ViTarget)
+            break;
+        if (now - start >= l_Timeout)
+        {
+            result->timed_out = 1;
+            break;
+        }
+    }
+
+    result->vi = g_ViCount - first_vi;
+    result->seconds = now - start;
+    for (i = 0; i < NUM_TIMED_SECTIONS; i++)
+        result->section_ns[i] = timed_section_get_total((enum timed_section) i) - result->section_ns[i];
+
+    CoreDoCommand(M64CMD_STOP, 0, NULL);
+    return NULL;
+}
+
+static int run_mode(int mode, const char *romfile, const char *configdir, const char *datadir)
+{
+    struct bench_result result;
+    struct rusage usage;
+    m64p_handle core;
+    pthread_t thread;
+    double instructions;
+    int zero = 0;
+
+    memset(&result, 0, sizeof(result));
+
+    if (CoreStartup(FRONTEND_API_VERSION, configdir, datadir, NULL, debug_callback, NULL, state_callback) != M64ERR_SUCCESS)
+        return 1;
+    ConfigOpenSection("Core", &core);
+    ConfigSetParameter(core, "R4300Emulator", M64TYPE_INT, &mode);
+    ConfigSetParameter(core, "OnScreenDisplay", M64TYPE_BOOL, &zero);
+
+    if (CoreDoCommand(M64CMD_ROM_OPEN_FILE, 0, (void *) romfile) != M64ERR_SUCCESS)
+    {
+        CoreShutdown();
+        return 1;
+    }
+
+    /* a NULL plugin handle attaches the dummy plugin */
+    CoreAttachPlugin(M64PLUGIN_GFX, NULL);
+    CoreAttachPlugin(M64PLUGIN_AUDIO, NULL);
+    CoreAttachPlugin(M64PLUGIN_INPUT, NULL);
+    CoreAttachPlugin(M64PLUGIN_RSP, NULL);
+
+    /* disable the speed limiter in new_vi() */
+    CoreDoCommand(M64CMD_CORE_STATE_SET, M64CORE_SPEED_LIMITER, &zero);
+
+    pthread_create(&thread, NULL, watch_thread, &result);
+    CoreDoCommand(M64CMD_EXECUTE, 0, NULL);
+    pthread_join(thread, NULL);
+
+    instructions = count_per_op > 0 ? (double) result.counts / count_per_op : 0.0;
+    getrusage(RUSAGE_SELF, &usage);
+
+    printf("{\"mode\":%d,\"vi\":%u,\"seconds\":%.6f,\"vi_per_sec\":%.2f,"
+           "\"instructions\":%.0f,\"instructions_per_sec\":%.0f,"
+           "\"gfx_ns\":%lld,\"audio_ns\":%lld,\"compiler_ns\":%lld,\"idle_ns\":%lld,"
+           "\"peak_rss_kb\":%ld,\"timed_out\":%s}\n",
+           mode, result.vi, result.seconds,
+           result.seconds > 0 ? result.vi / result.seconds : 0.0,
+           instructions, result.seconds > 0 ? instructions / result.seconds : 0.0,
+           result.section_ns[TIMED_SECTION_GFX], result.section_ns[TIMED_SECTION_AUDIO],
+           result.section_ns[TIMED_SECTION_COMPILER], result.section_ns[TIMED_SECTION_IDLE],
+           usage.ru_maxrss, result.timed_out ? "true" : "false");
+    fflush(stdout);
+
+    CoreDoCommand(M64CMD_ROM_CLOSE, 0, NULL);
+    CoreShutdown();
+    return result.timed_out;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-n vis] [-m modes] [-s savestate] [-c configdir] [-d datadir] [-t timeout] [-v] rom\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    const char *modes = "0,1,2", *configdir = NULL, *datadir = NULL;
+    const char *p;
+    int opt, status, failed = 0;
+    pid_t pid;
+
+    while ((opt = getopt(argc, argv, "n:m:s:c:d:t:v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': l_ViTarget = (unsigned int) atoi(optarg); break;
+            case 'm': modes = optarg; break;
+            case 's': l_StateFile = optarg; break;
+            case 'c': configdir = optarg; break;
+            case 'd': datadir = optarg; break;
+            case 't': l_Timeout = atoi(optarg); break;
+            case 'v': l_Verbose = 1; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (optind != argc - 1 || l_ViTarget == 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    /* run every mode in its own process so that peak RSS and core state are per-mode */
+    for (p = modes; *p != '\0'; p += strcspn(p, ","), p += (*p == ','))
+    {
+        pid = fork();
+        if (pid == 0)
+            return run_mode(atoi(p), argv[optind], configdir, datadir);
+        if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            fprintf(stderr, "benchmark of mode %d failed\n", atoi(p));
+            failed = 1;
+        }
+    }
+
+    return failed;
+}
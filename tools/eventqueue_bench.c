@@ -0,0 +1,449 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - eventqueue_bench.c                                      *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *   Copyright (C) 2014 Mupen64plus development team                       *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Micro-benchmark of the interrupt event scheduler.
+ *
+ * Runs the same synthetic interrupt workload against the former sorted
+ * linked list queue (copied below) and against src/r4300/eventqueue.c,
+ * checks that both dispatch the same events at the same counts and reports
+ * the time spent in each.
+ *
+ * To build it, go to the root of the Mupen64Plus source code and type:
+ *
+ * gcc -O2 -Isrc -o eventqueue_bench tools/eventqueue_bench.c src/r4300/eventqueue.c
+ *
+ * Usage: eventqueue_bench [iterations]
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "r4300/cp0.h"
+#include "r4300/eventqueue.h"
+#include "r4300/interupt.h"
+
+/* symbols normally provided by the core */
+unsigned int g_cp0_regs[CP0_REGS_COUNT];
+unsigned int next_interupt;
+
+void DebugMessage(int level, const char *message, ...)
+{
+    va_list args;
+    va_start(args, message);
+    vfprintf(stderr, message, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+/***************************************************************************
+ * Former list based queue
+ **************************************************************************/
+#define POOL_CAPACITY 16
+
+struct interrupt_event
+{
+    int type;
+    unsigned int count;
+};
+
+struct node
+{
+    struct interrupt_event data;
+    struct node *next;
+};
+
+struct pool
+{
+    struct node nodes[POOL_CAPACITY];
+    struct node* stack[POOL_CAPACITY];
+    size_t index;
+};
+
+static struct node* alloc_node(struct pool* p)
+{
+    if (p->index >= POOL_CAPACITY)
+        return NULL;
+
+    return p->stack[p->index++];
+}
+
+static void free_node(struct pool* p, struct node* node)
+{
+    if (p->index == 0 || node == NULL)
+        return;
+
+    p->stack[--p->index] = node;
+}
+
+static void clear_pool(struct pool* p)
+{
+    size_t i;
+
+    for(i = 0; i < POOL_CAPACITY; ++i)
+        p->stack[i] = &p->nodes[i];
+
+    p->index = 0;
+}
+
+struct interrupt_queue
+{
+    struct pool pool;
+    struct node* first;
+};
+
+static struct interrupt_queue q;
+
+static int SPECIAL_done = 0;
+
+static void list_clear_queue(void)
+{
+    q.first = NULL;
+    clear_pool(&q.pool);
+}
+
+static int before_event(unsigned int evt1, unsigned int evt2, int type2)
+{
+    if(evt1 - g_cp0_regs[CP0_COUNT_REG] < 0x80000000)
+    {
+        if(evt2 - g_cp0_regs[CP0_COUNT_REG] < 0x80000000)
+        {
+            if((evt1 - g_cp0_regs[CP0_COUNT_REG]) < (evt2 - g_cp0_regs[CP0_COUNT_REG])) return 1;
+            else return 0;
+        }
+        else
+        {
+            if((g_cp0_regs[CP0_COUNT_REG] - evt2) < 0x10000000)
+            {
+                switch(type2)
+                {
+                    case SPECIAL_INT:
+                        if(SPECIAL_done) return 1;
+                        else return 0;
+                        break;
+                    default:
+                        return 0;
+                }
+            }
+            else return 1;
+        }
+    }
+    else return 0;
+}
+
+static unsigned int list_get_event(int type)
+{
+    struct node* e = q.first;
+
+    if (e == NULL)
+        return 0;
+
+    if (e->data.type == type)
+        return e->data.count;
+
+    for(; e->next != NULL && e->next->data.type != type; e = e->next);
+
+    return (e->next != NULL)
+        ? e->next->data.count
+        : 0;
+}
+
+static void list_add_interupt_event_count(int type, unsigned int count)
+{
+    struct node* event;
+    struct node* e;
+    int special;
+
+    special = (type == SPECIAL_INT);
+
+    if(g_cp0_regs[CP0_COUNT_REG] > 0x80000000) SPECIAL_done = 0;
+
+    if (list_get_event(type))
+        return;
+
+    event = alloc_node(&q.pool);
+    if (event == NULL)
+        return;
+
+    event->data.count = count;
+    event->data.type = type;
+
+    if (q.first == NULL)
+    {
+        q.first = event;
+        event->next = NULL;
+        next_interupt = q.first->data.count;
+    }
+    else if (before_event(count, q.first->data.count, q.first->data.type) && !special)
+    {
+        event->next = q.first;
+        q.first = event;
+        next_interupt = q.first->data.count;
+    }
+    else
+    {
+        for(e = q.first;
+            e->next != NULL &&
+            (!before_event(count, e->next->data.count, e->next->data.type) || special);
+            e = e->next);
+
+        if (e->next == NULL)
+        {
+            e->next = event;
+            event->next = NULL;
+        }
+        else
+        {
+            if (!special)
+                for(; e->next != NULL && e->next->data.count == count; e = e->next);
+
+            event->next = e->next;
+            e->next = event;
+        }
+    }
+}
+
+static void list_add_interupt_event(int type, unsigned int delay)
+{
+    list_add_interupt_event_count(type, g_cp0_regs[CP0_COUNT_REG] + delay);
+}
+
+static void list_remove_interupt_event(void)
+{
+    struct node* e;
+
+    if (q.first->data.type == SPECIAL_INT)
+        SPECIAL_done = 1;
+
+    e = q.first;
+    q.first = e->next;
+    free_node(&q.pool, e);
+
+    next_interupt = (q.first != NULL
+         && (q.first->data.count > g_cp0_regs[CP0_COUNT_REG]
+         || (g_cp0_regs[CP0_COUNT_REG] - q.first->data.count) < 0x80000000))
+        ? q.first->data.count
+        : 0;
+}
+
+static int list_get_next_event_type(void)
+{
+    return (q.first == NULL)
+        ? 0
+        : q.first->data.type;
+}
+
+static void list_remove_event(int type)
+{
+    struct node* to_del;
+    struct node* e = q.first;
+
+    if (e == NULL)
+        return;
+
+    if (e->data.type == type)
+    {
+        q.first = e->next;
+        free_node(&q.pool, e);
+    }
+    else
+    {
+        for(; e->next != NULL && e->next->data.type != type; e = e->next);
+
+        if (e->next != NULL)
+        {
+            to_del = e->next;
+            e->next = to_del->next;
+            free_node(&q.pool, to_del);
+        }
+    }
+}
+
+static void list_check_interupt(void)
+{
+    struct node* event;
+
+    event = alloc_node(&q.pool);
+
+    if (event == NULL)
+        return;
+
+    event->data.count = next_interupt = g_cp0_regs[CP0_COUNT_REG];
+    event->data.type = CHECK_INT;
+
+    if (q.first == NULL)
+    {
+        q.first = event;
+        event->next = NULL;
+    }
+    else
+    {
+        event->next = q.first;
+        q.first = event;
+
+    }
+}
+
+/***************************************************************************
+ * Workload
+ **************************************************************************/
+struct queue_ops
+{
+    const char *name;
+    void (*clear)(void);
+    void (*add)(int type, unsigned int delay);
+    void (*add_count)(int type, unsigned int count);
+    void (*remove_first)(void);
+    void (*remove)(int type);
+    unsigned int (*get)(int type);
+    int (*next_type)(void);
+    void (*check)(void);
+};
+
+static const struct queue_ops list_ops =
+{
+    "list", list_clear_queue, list_add_interupt_event, list_add_interupt_event_count,
+    list_remove_interupt_event, list_remove_event, list_get_event, list_get_next_event_type,
+    list_check_interupt
+};
+
+static const struct queue_ops slot_ops =
+{
+    "slots", clear_queue, add_interupt_event, add_interupt_event_count,
+    remove_interupt_event, remove_event, get_event, get_next_event_type,
+    schedule_check_event
+};
+
+/* interrupt sources rescheduled after they fire, with their typical delays */
+static const int bench_types[] = { AI_INT, PI_INT, SI_INT, SP_INT, DP_INT, COMPARE_INT };
+static const unsigned int bench_delays[] = { 0x8000, 0x1000, 0x900, 1000, 1000, 0x40000 };
+#define BENCH_TYPES (sizeof(bench_types) / sizeof(bench_types[0]))
+
+static unsigned int rng_state;
+
+static unsigned int rng(void)
+{
+    rng_state = rng_state * 1103515245 + 12345;
+    return rng_state >> 8;
+}
+
+/* returns a checksum of the dispatched (type, count) sequence */
+static unsigned int run(const struct queue_ops* ops, unsigned long iterations, double* seconds)
+{
+    unsigned int vi_delay = 1500 * 525;
+    unsigned int checksum = 0;
+    unsigned long i;
+    size_t t;
+    clock_t start;
+
+    rng_state = 42;
+    SPECIAL_done = 1;
+    g_cp0_regs[CP0_COUNT_REG] = 0x5000;
+    next_interupt = 5000;
+
+    ops->clear();
+    ops->add_count(VI_INT, 5000);
+    ops->add_count(SPECIAL_INT, 0);
+    for (t = 0; t < BENCH_TYPES; ++t)
+        ops->add(bench_types[t], bench_delays[t] + rng() % bench_delays[t]);
+
+    start = clock();
+
+    for (i = 0; i < iterations; ++i)
+    {
+        int type;
+
+        /* run until the next event is due, then dispatch it */
+        g_cp0_regs[CP0_COUNT_REG] += 1 + rng() % 64;
+        if (next_interupt > g_cp0_regs[CP0_COUNT_REG])
+            g_cp0_regs[CP0_COUNT_REG] = next_interupt;
+
+        {
+            type = ops->next_type();
+            checksum = checksum * 31 + type;
+            checksum = checksum * 31 + g_cp0_regs[CP0_COUNT_REG];
+
+            if (type == SPECIAL_INT)
+            {
+                if (g_cp0_regs[CP0_COUNT_REG] <= 0x10000000)
+                {
+                    ops->remove_first();
+                    ops->add_count(SPECIAL_INT, 0);
+                }
+            }
+            else if (type == VI_INT)
+            {
+                unsigned int next_vi = ops->get(VI_INT) + vi_delay;
+                ops->remove_first();
+                ops->add_count(VI_INT, next_vi);
+            }
+            else
+            {
+                ops->remove_first();
+                for (t = 0; t < BENCH_TYPES && bench_types[t] != type; ++t);
+                if (t < BENCH_TYPES)
+                    ops->add(type, bench_delays[t] / 2 + rng() % bench_delays[t]);
+            }
+        }
+
+        /* AI_LEN polling */
+        checksum += ops->get(AI_INT);
+
+        /* interrupt checks after MI/SP/CP0 status writes; the cores never
+         * let two of them pend at the same time */
+        if ((rng() & 7) == 0 && ops->next_type() != CHECK_INT)
+            ops->check();
+
+        /* occasional reprogramming of a pending event (e.g. MTC0 COMPARE) */
+        if ((rng() & 0xff) == 0)
+        {
+            t = rng() % BENCH_TYPES;
+            ops->remove(bench_types[t]);
+            ops->add(bench_types[t], rng() % (2 * bench_delays[t]));
+        }
+    }
+
+    *seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    return checksum;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long iterations = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100000000UL;
+    double list_time, slot_time;
+    unsigned int list_sum, slot_sum;
+
+    list_sum = run(&list_ops, iterations, &list_time);
+    slot_sum = run(&slot_ops, iterations, &slot_time);
+
+    printf("%-6s %8.3f s (checksum %08x)\n", list_ops.name, list_time, list_sum);
+    printf("%-6s %8.3f s (checksum %08x)\n", slot_ops.name, slot_time, slot_sum);
+
+    if (list_sum != slot_sum)
+    {
+        printf("dispatch sequences differ!\n");
+        return 1;
+    }
+
+    printf("speedup: %.2fx\n", list_time / slot_time);
+    return 0;
+}